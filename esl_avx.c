@@ -3,10 +3,11 @@
  * Most speed-critical code is in the .h file, to facilitate inlining.
  * 
  * Contents:
- *    1. Debugging/development routines
- *    2. Benchmark
- *    3. Unit tests
- *    4. Test driver
+ *    1. SIMD logf(), expf()
+ *    2. Debugging/development routines
+ *    3. Benchmark
+ *    4. Unit tests
+ *    5. Test driver
  *    
  * This code is conditionally compiled, only when <eslENABLE_AVX> was
  * set in <esl_config.h> by the configure script, and that will only
@@ -14,6 +15,10 @@
  * include some dummy code to silence compiler and ranlib warnings
  * about empty translation units and no symbols, and dummy drivers
  * that do nothing but declare success.
+ *
+ * The logf() and expf() routines are ports of esl_sse.c's, which
+ * derive from Julien Pommier's SSE versions of the Cephes library
+ * routines; see esl_sse.c for credits and license.
  */
 #include "esl_config.h"
 #ifdef eslENABLE_AVX
@@ -26,9 +31,167 @@
 
 
 /*****************************************************************
- * 1. Debugging/development routines
+ * 1. SIMD logf(), expf()
  *****************************************************************/
 
+/* Function:  esl_avx_logf()
+ * Synopsis:  <r[z] = log x[z]>
+ *
+ * Purpose:   Given a vector <x> containing eight floats, returns a
+ *            vector <r> in which each element <r[z] = logf(x[z])>.
+ *
+ *            Valid in the domain $x_z > 0$ for normalized IEEE754
+ *            $x_z$. IEEE754 specials are handled as in
+ *            <esl_sse_logf()>: <x> $< 0$ (including -0) gives <NaN>;
+ *            <x> $== 0$ or subnormal gives <-inf>; <inf> gives <inf>
+ *            and <NaN> gives <NaN>.
+ *
+ * Note:      An AVX2 port of <esl_sse_logf()>, with the same Cephes
+ *            polynomial, so results agree with it to roundoff.
+ */
+__m256
+esl_avx_logf(__m256 x)
+{
+  static float cephes_p[9] = {  7.0376836292E-2f, -1.1514610310E-1f,  1.1676998740E-1f,
+				-1.2420140846E-1f, 1.4249322787E-1f, -1.6668057665E-1f,
+				2.0000714765E-1f, -2.4999993993E-1f,  3.3333331174E-1f };
+  __m256  onev = _mm256_set1_ps(1.0f);          /* all elem = 1.0 */
+  __m256  v0p5 = _mm256_set1_ps(0.5f);          /* all elem = 0.5 */
+  __m256i vneg = _mm256_set1_epi32(0x80000000); /* all elem have IEEE sign bit up */
+  __m256i vexp = _mm256_set1_epi32(0x7f800000); /* all elem have IEEE exponent bits up */
+  __m256i ei;
+  __m256  e;
+  __m256  invalid_mask, zero_mask, inf_mask;    /* masks used to handle special IEEE754 inputs */
+  __m256  mask;
+  __m256  origx;
+  __m256  tmp;
+  __m256  y;
+  __m256  z;
+
+  /* first, split x apart: x = frexpf(x, &e); see esl_sse_logf() */
+  ei           = _mm256_srli_epi32( _mm256_castps_si256(x), 23);
+  invalid_mask = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256(_mm256_castps_si256(x), vneg), vneg));
+  zero_mask    = _mm256_castsi256_ps( _mm256_cmpeq_epi32(ei, _mm256_setzero_si256()));
+  inf_mask     = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256(_mm256_castps_si256(x), vexp), vexp));
+  origx        = x;
+
+  x  = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000)));
+  x  = _mm256_or_ps (x, v0p5);
+
+  ei = _mm256_sub_epi32(ei, _mm256_set1_epi32(126));
+  e  = _mm256_cvtepi32_ps(ei);
+
+  /* now, calculate the log */
+  mask = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OS);
+  tmp  = _mm256_and_ps(x, mask);
+  x    = _mm256_sub_ps(x, onev);
+  e    = _mm256_sub_ps(e, _mm256_and_ps(onev, mask));
+  x    = _mm256_add_ps(x, tmp);
+  z    = _mm256_mul_ps(x,x);
+
+  y =                  _mm256_set1_ps(cephes_p[0]);    y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[1]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[2]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[3]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[4]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[5]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[6]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[7]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[8]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_mul_ps(y, z);
+
+  tmp = _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f));
+  y   = _mm256_add_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(z, v0p5);
+  y   = _mm256_sub_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f));
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, tmp);
+
+  /* IEEE754 cleanup: */
+  x = _mm256_blendv_ps(x, origx,                        inf_mask);  /* log(inf)=inf; log(NaN)      = NaN  */
+  x = _mm256_or_ps(x, invalid_mask);                                /* log(x<0, including -0,-inf) = NaN  */
+  x = _mm256_blendv_ps(x, _mm256_set1_ps(-eslINFINITY), zero_mask); /* x zero or subnormal         = -inf */
+  return x;
+}
+
+/* Function:  esl_avx_expf()
+ * Synopsis:  <r[z] = exp x[z]>
+ *
+ * Purpose:   Given a vector <x> containing eight floats, returns a
+ *            vector <r> in which each element <r[z] = expf(x[z])>.
+ *
+ *            Valid for all IEEE754 floats $x_z$.
+ *
+ * Note:      An AVX2 port of <esl_sse_expf()>; see there for the
+ *            range reduction and the choice of <minlogf>, <maxlogf>.
+ *            <floorf()> is a single rounding instruction here.
+ */
+__m256
+esl_avx_expf(__m256 x)
+{
+  static float cephes_p[6] = { 1.9875691500E-4f, 1.3981999507E-3f, 8.3334519073E-3f,
+			       4.1665795894E-2f, 1.6666665459E-1f, 5.0000001201E-1f };
+  static float cephes_c[2] = { 0.693359375f,    -2.12194440e-4f };
+  static float maxlogf     =  88.3762626647949f;  /* 127.5 log(2) - epsilon */
+  static float minlogf     = -88.3762626647949f;  /*-127.5 log(2) + epsilon */
+  __m256i k;
+  __m256  tmp, fx, z, y, minmask, maxmask;
+
+  /* handle out-of-range and special conditions */
+  maxmask = _mm256_cmp_ps(x, _mm256_set1_ps(maxlogf), _CMP_GT_OS);
+  minmask = _mm256_cmp_ps(x, _mm256_set1_ps(minlogf), _CMP_LE_OS);
+
+  /* range reduction: exp(x) = 2^k e^f = exp(f + k log 2); k = floorf(0.5 + x / log2): */
+  fx = _mm256_mul_ps(x,  _mm256_set1_ps(eslCONST_LOG2R));
+  fx = _mm256_add_ps(fx, _mm256_set1_ps(0.5f));
+  fx = _mm256_floor_ps(fx);
+  k  = _mm256_cvttps_epi32(fx);
+
+  /* polynomial approx for e^f for f in range [-0.5, 0.5] */
+  tmp = _mm256_mul_ps(fx, _mm256_set1_ps(cephes_c[0]));
+  z   = _mm256_mul_ps(fx, _mm256_set1_ps(cephes_c[1]));
+  x   = _mm256_sub_ps(x, tmp);
+  x   = _mm256_sub_ps(x, z);
+  z   = _mm256_mul_ps(x, x);
+
+  y =                  _mm256_set1_ps(cephes_p[0]);    y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[1]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[2]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[3]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[4]));   y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(cephes_p[5]));   y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, x);
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+  /* build 2^k by hand, by creating a IEEE754 float */
+  k  = _mm256_add_epi32(k, _mm256_set1_epi32(127));
+  k  = _mm256_slli_epi32(k, 23);
+  fx = _mm256_castsi256_ps(k);
+
+  /* put 2^k e^f together (fx = 2^k,  y = e^f) and we're done */
+  y = _mm256_mul_ps(y, fx);
+
+  /* special/range cleanup */
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(eslINFINITY), maxmask); /* exp(x) = inf for x > log(2^128)  */
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(0.0f),        minmask); /* exp(x) = 0   for x < log(2^-149) */
+  return y;
+}
+
+
+/*****************************************************************
+ * 2. Debugging/development routines
+ *****************************************************************/
+
+void
+esl_avx_dump_ps(FILE *fp, __m256 v)
+{
+  float *p = (float *)&v;
+  fprintf(fp, "[%13.8g, %13.8g, %13.8g, %13.8g, %13.8g, %13.8g, %13.8g, %13.8g]", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+}
+
 void 
 esl_avx_dump_256i_hex4(__m256i v)
 {
@@ -39,7 +202,7 @@ esl_avx_dump_256i_hex4(__m256i v)
 
 
 /*****************************************************************
- * 2. Benchmark
+ * 3. Benchmark
  *****************************************************************/
 #ifdef eslAVX_BENCHMARK
 
@@ -110,6 +273,13 @@ main(int argc, char **argv)
         { r_i16  = esl_avx_hmax_epi16(v[i]); max_i16 = ESL_MAX(max_i16, r_i16); }
       printf("max_i16 = %" PRIi16 "\n", max_i16);
     }
+  else if (strcmp(fname, "logf") == 0 || strcmp(fname, "expf") == 0)
+    {
+      __m256 xv = _mm256_set1_ps(2.0f);
+      for (i = 0; i < N; i++) { xv = esl_avx_logf(xv); xv = esl_avx_expf(xv); }
+      printf("2.0 => many vector logf,expf cycles => ");
+      esl_avx_dump_ps(stdout, xv); printf("\n");
+    }
   else 
     esl_fatal("No such esl_avx_* function %s\n", fname);
 
@@ -126,12 +296,162 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 3. Unit tests
+ * 4. Unit tests
  *****************************************************************/
 #ifdef eslAVX_TESTDRIVE
 
+#include <float.h>
+#include <math.h>
+
+#include "esl_getopts.h"
 #include "esl_random.h"
 
+/* utest_logf():  Test range/domain of logf */
+static void
+utest_logf(ESL_GETOPTS *go)
+{
+  __m256 x;                            /* test input  */
+  union { __m256 v; float x[8]; } r;   /* test output */
+
+  /* Test IEEE754 specials:
+   *    log(-inf) = NaN     log(x<0)  = NaN  log(-0)   = NaN
+   *    log(0)    = -inf    log(inf)  = inf  log(NaN)  = NaN
+   */
+  x   = _mm256_set_ps(FLT_MAX, FLT_MIN, eslNaN, eslINFINITY, 0.0, -0.0, -1.0, -eslINFINITY); /* set_ps() is in order 7..0 */
+  r.v = esl_avx_logf(x);
+  if (esl_opt_GetBoolean(go, "-v")) {
+    printf("logf");
+    esl_avx_dump_ps(stdout, x);    printf(" ==> ");
+    esl_avx_dump_ps(stdout, r.v);  printf("\n");
+  }
+  if (! isnan(r.x[0]))                 esl_fatal("logf(-inf) should be NaN");
+  if (! isnan(r.x[1]))                 esl_fatal("logf(-1)   should be NaN");
+  if (! isnan(r.x[2]))                 esl_fatal("logf(-0)   should be NaN");
+  if (! (r.x[3] < 0 && isinf(r.x[3]))) esl_fatal("logf(0)    should be -inf");
+  if (! isinf(r.x[4]))                 esl_fatal("logf(inf)  should be inf");
+  if (! isnan(r.x[5]))                 esl_fatal("logf(NaN)  should be NaN");
+  if (esl_FCompare(r.x[6], logf(FLT_MIN), 1e-6) != eslOK) esl_fatal("logf(FLT_MIN) wrong");
+  if (esl_FCompare(r.x[7], logf(FLT_MAX), 1e-6) != eslOK) esl_fatal("logf(FLT_MAX) wrong");
+}
+
+/* utest_expf():  Test range/domain of expf */
+static void
+utest_expf(ESL_GETOPTS *go)
+{
+  __m256 x;                            /* test input  */
+  union { __m256 v; float x[8]; } r;   /* test output */
+
+  /* exp(-inf) = 0    exp(-0)  = 1   exp(0) = 1  exp(inf) = inf
+   * exp(NaN) = NaN   exp(large) = inf  exp(-large) = 0  exp(1) = e
+   */
+  x   = _mm256_set_ps(1.0f, -666.0f, 666.0f, eslNaN, eslINFINITY, 0.0, -0.0, -eslINFINITY);
+  r.v = esl_avx_expf(x);
+  if (esl_opt_GetBoolean(go, "-v")) {
+    printf("expf");
+    esl_avx_dump_ps(stdout, x);    printf(" ==> ");
+    esl_avx_dump_ps(stdout, r.v);  printf("\n");
+  }
+  if (r.x[0] != 0.0f)   esl_fatal("expf(-inf) should be 0");
+  if (r.x[1] != 1.0f)   esl_fatal("expf(-0)   should be 1");
+  if (r.x[2] != 1.0f)   esl_fatal("expf(0)    should be 1");
+  if (! isinf(r.x[3]))  esl_fatal("expf(inf)  should be inf");
+  if (! isnan(r.x[4]))  esl_fatal("expf(NaN)      should be NaN");
+  if (! isinf(r.x[5]))  esl_fatal("expf(large x)  should be inf");
+  if (r.x[6] != 0.0f)   esl_fatal("expf(-large x) should be 0");
+  if (esl_FCompare(r.x[7], eslCONST_E, 1e-6) != eslOK) esl_fatal("expf(1) should be e");
+
+  /* around the minlogf boundary; see esl_sse.c::utest_expf() */
+  x   = _mm256_set_ps(-88.3763, -88.3762, -87.6832, -87.6831, -88.3763, -88.3762, -87.6832, -87.6831);
+  r.v = esl_avx_expf(x);
+  if (esl_opt_GetBoolean(go, "-v")) {
+    printf("expf");
+    esl_avx_dump_ps(stdout, x);    printf(" ==> ");
+    esl_avx_dump_ps(stdout, r.v);  printf("\n");
+  }
+  if ( r.x[0] >= FLT_MIN) esl_fatal("expf( -126.5 log2 + eps) should be around FLT_MIN");
+  if ( r.x[1] != 0.0f)    esl_fatal("expf( -126.5 log2 - eps) should be 0.0 (by calculation)");
+  if ( r.x[2] != 0.0f)    esl_fatal("expf( -127.5 log2 + eps) should be 0.0 (by calculation)");
+  if ( r.x[3] != 0.0f)    esl_fatal("expf( -127.5 log2 - eps) should be 0.0 (by min bound)");
+}
+
+/* utest_odds():  test accuracy of logf, expf on odds ratios,
+ * our main intended use; each lane gets a different ratio.
+ * Same tolerances as esl_sse.c's test.
+ */
+static void
+utest_odds(ESL_GETOPTS *go, ESL_RANDOMNESS *rng)
+{
+  int     N            = esl_opt_GetInteger(go, "-N");
+  int     verbose      = esl_opt_GetBoolean(go, "-v");
+  int     very_verbose = esl_opt_GetBoolean(go, "--vv");
+  union { __m256 v; float x[8]; } odds, r1, r2;
+  double  err1, maxerr1 = 0.0, avgerr1 = 0.0; /* errors on logf() */
+  double  err2, maxerr2 = 0.0, avgerr2 = 0.0; /* errors on expf() */
+  float   scalar_r1, scalar_r2;
+  int     i, z;
+
+  for (i = 0; i < N; i += 8)
+    {
+      for (z = 0; z < 8; z++)
+	odds.x[z] = esl_rnd_UniformPositive(rng) / esl_rnd_UniformPositive(rng);
+
+      r1.v = esl_avx_logf(odds.v);
+      r2.v = esl_avx_expf(r1.v);
+
+      for (z = 0; z < 8; z++)
+	{
+	  scalar_r1 = log(odds.x[z]);
+	  scalar_r2 = exp(r1.x[z]);
+
+	  err1     = (r1.x[z] == 0. && scalar_r1 == 0.) ? 0.0 : 2 * fabs(r1.x[z] - scalar_r1) / fabs(r1.x[z] + scalar_r1);
+	  err2     = (r2.x[z] == 0. && scalar_r2 == 0.) ? 0.0 : 2 * fabs(r2.x[z] - scalar_r2) / fabs(r2.x[z] + scalar_r2);
+	  maxerr1  = ESL_MAX(maxerr1, err1);
+	  maxerr2  = ESL_MAX(maxerr2, err2);
+	  avgerr1 += err1 / (double) N;
+	  avgerr2 += err2 / (double) N;
+
+	  if (very_verbose)
+	    printf("%13.7g  %13.7g  %13.7g  %13.7g  %13.7g  %13.7g  %13.7g\n", odds.x[z], scalar_r1, r1.x[z], scalar_r2, r2.x[z], err1, err2);
+	}
+    }
+
+  if (verbose) {
+    printf("Average [max] logf() relative error in %d odds trials:  %13.8g  [%13.8g]\n", N, avgerr1, maxerr1);
+    printf("Average [max] expf() relative error in %d odds trials:  %13.8g  [%13.8g]\n", N, avgerr2, maxerr2);
+  }
+
+  if (avgerr1 > 1e-8) esl_fatal("average error on logf() is intolerable\n");
+  if (maxerr1 > 1e-6) esl_fatal("maximum error on logf() is intolerable\n");
+  if (avgerr2 > 1e-8) esl_fatal("average error on expf() is intolerable\n");
+  if (maxerr2 > 1e-6) esl_fatal("maximum error on expf() is intolerable\n");
+}
+
+/* utest_hreduce_ps():  horizontal sum, max, min of float vectors */
+static void
+utest_hreduce_ps(ESL_RANDOMNESS *rng)
+{
+  union { __m256 v; float x[8]; } u;
+  float  sum, max, min, r;
+  int    i,z;
+
+  for (i = 0; i < 100; i++)
+    {
+      sum = 0.;
+      max = -eslINFINITY;
+      min =  eslINFINITY;
+      for (z = 0; z < 8; z++)
+	{
+	  u.x[z] = esl_random(rng) * 200. - 100.;
+	  sum   += u.x[z];
+	  max    = ESL_MAX(max, u.x[z]);
+	  min    = ESL_MIN(min, u.x[z]);
+	}
+      esl_avx_hsum_ps(u.v, &r);  if (esl_FCompareAbs(r, sum, 1e-3) != eslOK) esl_fatal("hsum_ps utest failed: %f != %f", r, sum);
+      esl_avx_hmax_ps(u.v, &r);  if (r != max)                               esl_fatal("hmax_ps utest failed");
+      esl_avx_hmin_ps(u.v, &r);  if (r != min)                               esl_fatal("hmin_ps utest failed");
+    }
+}
+
 static void
 utest_hmax_epu8(ESL_RANDOMNESS *rng)
 {
@@ -196,7 +516,7 @@ utest_hmax_epi16(ESL_RANDOMNESS *rng)
 #endif /*eslAVX_TESTDRIVE*/
 
 /*****************************************************************
- * 4. Test driver
+ * 5. Test driver
  *****************************************************************/
 
 #ifdef eslAVX_TESTDRIVE
@@ -213,11 +533,14 @@ utest_hmax_epi16(ESL_RANDOMNESS *rng)
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
   { "-h",        eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-N",        eslARG_INT,  "10000",  NULL, NULL,  NULL,  NULL, NULL, "number of random test points",                     0 },
   { "-s",        eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-v",        eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "be verbose: show test report",                     0 },
+  { "--vv",      eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "be very verbose: show individual test samples",    0 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options]";
-static char banner[] = "test driver for avx512 module";
+static char banner[] = "test driver for avx module";
 
 int
 main(int argc, char **argv)
@@ -228,6 +551,10 @@ main(int argc, char **argv)
   fprintf(stderr, "## %s\n", argv[0]);
   fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
+  utest_logf(go);
+  utest_expf(go);
+  utest_odds(go, rng);
+  utest_hreduce_ps(rng);
   utest_hmax_epu8(rng);
   utest_hmax_epi8(rng);
   utest_hmax_epi16(rng);
@@ -5,7 +5,7 @@
  * 
  * Contents:
  *    1. Function declarations for esl_avx.c
- *    2. Inlined functions: horizontal max, sum
+ *    2. Inlined functions: horizontal max, min, sum
  *    3. Inlined functions: left and right shifts
  *    4. Inlined functions: any_gt
  */
@@ -24,12 +24,15 @@
  * 1. Function declarations for esl_avx.c
  *****************************************************************/
 
-extern void esl_avx_dump_256i_hex4(__m256i v);
+extern __m256 esl_avx_logf(__m256 x);
+extern __m256 esl_avx_expf(__m256 x);
+extern void   esl_avx_dump_ps(FILE *fp, __m256 v);
+extern void   esl_avx_dump_256i_hex4(__m256i v);
 
 
 
 /*****************************************************************
- * 2. Inlined functions: horizontal max, sum
+ * 2. Inlined functions: horizontal max, min, sum
  *****************************************************************/
 
 /* Function:  esl_avx_hmax_epu8()
@@ -83,7 +86,7 @@ esl_avx_hmax_epi16(__m256i a)
 /* Function:  esl_avx_hsum_ps()
  * Synopsis:  Takes the horizontal sum of elements in a vector.
  *
- * Purpose:   Add the four float elements in vector <a>; return
+ * Purpose:   Add the eight float elements in vector <a>; return
  *            that sum in <*ret_sum>.
  */
 static inline void
@@ -108,6 +111,38 @@ esl_avx_hsum_ps(__m256 a, float *ret_sum)
    *retint_ptr = _mm256_extract_epi32((__m256i) temp2_AVX, 0);
 }
 
+/* Function:  esl_avx_hmax_ps()
+ * Synopsis:  Find the maximum of elements in a vector.
+ *
+ * Purpose:   Find the maximum valued element in the eight float
+ *            elements in <a>; return that maximum in <*ret_max>.
+ */
+static inline void
+esl_avx_hmax_ps(__m256 a, float *ret_max)
+{
+  __m128 b = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+
+  b = _mm_max_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 2, 1)));
+  b = _mm_max_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)));
+  _mm_store_ss(ret_max, b);
+}
+
+/* Function:  esl_avx_hmin_ps()
+ * Synopsis:  Find the minimum of elements in a vector.
+ *
+ * Purpose:   Find the minimum valued element in the eight float
+ *            elements in <a>; return that minimum in <*ret_min>.
+ */
+static inline void
+esl_avx_hmin_ps(__m256 a, float *ret_min)
+{
+  __m128 b = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+
+  b = _mm_min_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 2, 1)));
+  b = _mm_min_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)));
+  _mm_store_ss(ret_min, b);
+}
+
 
 /****************************************************************** 
  * 3. Inlined functions: left and right shift 
@@ -163,6 +198,17 @@ esl_avx_leftshiftz_float(__m256 v)
  * 4. Inlined functions: any_gt
  ******************************************************************/
 
+/* Function:  esl_avx_any_gt_epu8()
+ * Synopsis:  Returns TRUE if any a[z] > b[z].
+ * See:       esl_sse.h::esl_sse_any_gt_epu8()
+ */
+static inline int 
+esl_avx_any_gt_epu8(__m256i a, __m256i b)
+{
+  __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(a,b), b); /* anywhere a>b, mask[z] = 0x0; elsewhere 0xff */
+  return (_mm256_movemask_epi8(mask) != -1);
+}
+
 /* Function:  esl_avx_any_gt_epi16()
  * Synopsis:  Return >0 if any a[z] > b[z]
  */
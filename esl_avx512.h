@@ -5,7 +5,7 @@
  * 
  * Contents:
  *    1. Function declarations for esl_avx512.c
- *    2. Inlined functions: horizontal max, sum
+ *    2. Inlined functions: horizontal max, min, sum
  *    3. Inlined functions: left, right shift
  */
 #ifndef eslAVX512_INCLUDED
@@ -22,11 +22,14 @@
  * 1. Function declarations for esl_avx512.c
  *****************************************************************/
 
-extern void esl_avx512_dump_512i_hex8(__m512i v);
+extern __m512 esl_avx512_logf(__m512 x);
+extern __m512 esl_avx512_expf(__m512 x);
+extern void   esl_avx512_dump_ps(FILE *fp, __m512 v);
+extern void   esl_avx512_dump_512i_hex8(__m512i v);
 
 
 /*****************************************************************
- * 2. Inlined functions: horizontal max, sum
+ * 2. Inlined functions: horizontal max, min, sum
  *****************************************************************/
 
 /* Function:  esl_avx512_hmax_epu8()
@@ -106,6 +109,40 @@ esl_avx512_hsum_ps(__m512 a, float *ret_sum)
   *retint_ptr = _mm256_extract_epi32((__m256i) temp3_AVX, 0);
 }
 
+/* Function:  esl_avx512_hmax_ps()
+ * Synopsis:  Find the maximum of elements in a vector.
+ *
+ * Purpose:   Find the maximum valued element in the sixteen float
+ *            elements in <a>; return that maximum in <*ret_max>.
+ */
+static inline void
+esl_avx512_hmax_ps(__m512 a, float *ret_max)
+{
+  __m256 b = _mm256_max_ps(_mm512_castps512_ps256(a), _mm512_extractf32x8_ps(a, 1));
+  __m128 c = _mm_max_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1));
+
+  c = _mm_max_ps(c, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 2, 1)));
+  c = _mm_max_ps(c, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 0, 3, 2)));
+  _mm_store_ss(ret_max, c);
+}
+
+/* Function:  esl_avx512_hmin_ps()
+ * Synopsis:  Find the minimum of elements in a vector.
+ *
+ * Purpose:   Find the minimum valued element in the sixteen float
+ *            elements in <a>; return that minimum in <*ret_min>.
+ */
+static inline void
+esl_avx512_hmin_ps(__m512 a, float *ret_min)
+{
+  __m256 b = _mm256_min_ps(_mm512_castps512_ps256(a), _mm512_extractf32x8_ps(a, 1));
+  __m128 c = _mm_min_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1));
+
+  c = _mm_min_ps(c, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 2, 1)));
+  c = _mm_min_ps(c, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 0, 3, 2)));
+  _mm_store_ss(ret_min, c);
+}
+
 
 /*****************************************************************
  * 3. Inlined functions: left and right shifts
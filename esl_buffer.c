@@ -32,6 +32,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #endif /* _POSIX_VERSION */
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "easel.h"
 #include "esl_mem.h"
@@ -42,11 +45,45 @@
 
 
 /*::cexcerpt::statics_example::begin::*/
+#ifdef HAVE_PTHREAD
+/* State shared between an ESL_BUFFER and its prefetch thread:
+ * a ring buffer of <nalloc> bytes, with <nfull> bytes of input
+ * waiting to be consumed starting at <ring[head]>. The thread
+ * fills the free space after them, one <blocksize> read at a time.
+ */
+struct esl_buffer_prefetch_s {
+  pthread_t       thread;
+  pthread_mutex_t mutex;      /* protects all fields below, except <ring> contents */
+  pthread_cond_t  cv;         /* signals any change in <nfull>, or a stop request  */
+  FILE           *fp;         /* the stream we're reading (a copy of <bf->fp>)     */
+  char           *ring;       /* readahead ring buffer, ring[0..nalloc-1]          */
+  esl_pos_t       nalloc;
+  esl_pos_t       head;       /* next byte for the parser is ring[head]            */
+  esl_pos_t       nfull;      /* # of bytes waiting for the parser                 */
+  esl_pos_t       blocksize;  /* size of each fread() by the thread                */
+  int             is_eof;     /* TRUE once the thread has seen EOF on <fp>         */
+  int             is_error;   /* TRUE if the thread's fread() failed               */
+  int             do_stop;    /* TRUE when esl_buffer_Close() wants thread to quit */
+  int             is_running; /* TRUE once pthread_create() has succeeded          */
+};
+#endif /*HAVE_PTHREAD*/
+
 static int buffer_create           (ESL_BUFFER **ret_bf);
 static int buffer_init_file_mmap   (ESL_BUFFER *bf, esl_pos_t filesize);
 static int buffer_init_file_slurped(ESL_BUFFER *bf, esl_pos_t filesize);
 static int buffer_init_file_basic  (ESL_BUFFER *bf);
 
+static void buffer_advise_file(ESL_BUFFER *bf, esl_pos_t filesize);
+static void buffer_advise_mmap(ESL_BUFFER *bf, esl_pos_t offset);
+
+static esl_pos_t buffer_fread(ESL_BUFFER *bf, char *p, esl_pos_t n);
+static int       buffer_feof (ESL_BUFFER *bf);
+static int       buffer_ferror(ESL_BUFFER *bf);
+#ifdef HAVE_PTHREAD
+static void *prefetch_thread (void *arg);
+static void  prefetch_destroy(struct esl_buffer_prefetch_s *pf);
+#endif
+
 static int buffer_refill   (ESL_BUFFER *bf, esl_pos_t nmin);
 static int buffer_countline(ESL_BUFFER *bf, esl_pos_t *opt_nc, esl_pos_t *opt_nskip);
 static int buffer_skipsep  (ESL_BUFFER *bf, const char *sep);
@@ -192,6 +229,35 @@ esl_buffer_Open(const char *filename, const char *envvar, ESL_BUFFER **ret_bf)
  */
 int 
 esl_buffer_OpenFile(const char *filename, ESL_BUFFER **ret_bf)
+{
+  return esl_buffer_OpenFile_adv(filename, eslBUFFER_SLURPSIZE, ret_bf);
+}
+
+/* Function:  esl_buffer_OpenFile_adv()
+ * Synopsis:  Open a file, with a custom slurp/mmap threshold.
+ *
+ * Purpose:   Same as <esl_buffer_OpenFile()>, except that the caller
+ *            sets the switchover point between slurping and memory
+ *            mapping: files of up to <slurpsize> bytes are slurped,
+ *            and larger ones are <mmap()>'ed. <esl_buffer_OpenFile()>
+ *            uses <eslBUFFER_SLURPSIZE> (4 MB). A <slurpsize> of 0
+ *            mmap's any nonempty file; a very large one (e.g. 
+ *            <eslINT64_MAX>) slurps everything.
+ *            
+ *            Where the system supports them, access pattern hints
+ *            (<posix_fadvise()>, <madvise()>) tell the kernel that we
+ *            read the file sequentially, so it can read ahead.
+ *
+ * Args:      filename  - name of (or path to) file to open
+ *            slurpsize - files <= this size (in bytes) are slurped
+ *           *ret_bf    - RETURN: new ESL_BUFFER
+ *
+ * Returns:   (same as <esl_buffer_OpenFile()>)
+ *
+ * Throws:    (same as <esl_buffer_OpenFile()>)
+ */
+int 
+esl_buffer_OpenFile_adv(const char *filename, esl_pos_t slurpsize, ESL_BUFFER **ret_bf)
 {
   ESL_BUFFER *bf = NULL;
 #ifdef _POSIX_VERSION
@@ -220,10 +286,12 @@ esl_buffer_OpenFile(const char *filename, ESL_BUFFER **ret_bf)
   if (bf->pagesize > 4194304) bf->pagesize = 4194304;
 #endif  
 
-  if      (filesize != -1 && filesize <= eslBUFFER_SLURPSIZE)  
+  buffer_advise_file(bf, filesize);
+
+  if      (filesize != -1 && (filesize <= slurpsize || filesize == 0))
     { if ((status = buffer_init_file_slurped(bf, filesize)) != eslOK) goto ERROR; }
 #ifdef _POSIX_VERSION
-  else if (filesize > eslBUFFER_SLURPSIZE) 
+  else if (filesize > slurpsize) 
     { if ((status = buffer_init_file_mmap(bf, filesize))    != eslOK) goto ERROR; }
 #endif
   else
@@ -495,6 +563,88 @@ esl_buffer_OpenStream(FILE *fp, ESL_BUFFER **ret_bf)
   return status;
 }
 
+/* Function:  esl_buffer_SetPrefetch()
+ * Synopsis:  Read ahead of the parser in a background thread.
+ *
+ * Purpose:   For an input <bf> that's reading a nonrewindable stream
+ *            (STREAM or CMDPIPE mode; standard input, or the output
+ *            of <gzip -dc>, for example), start a prefetch thread
+ *            that reads up to <nblocks> blocks of <bf->pagesize>
+ *            bytes ahead of the parser, so that waiting for input
+ *            overlaps with parsing. Pass <eslBUFFER_PREFETCH> for
+ *            <nblocks> to get a reasonable default.
+ *            
+ *            Parsing results are unaffected; the prefetch thread only
+ *            changes when the bytes are read from the stream, not
+ *            what the parser sees.
+ *            
+ *            For other modes, this is a no-op: the input is either
+ *            already in memory (ALLFILE, MMAP, STRING), or is a file
+ *            that the kernel reads ahead of us anyway (FILE), and
+ *            which may need to be repositioned with <fseeko()>. It
+ *            is also a no-op if the stream is already at EOF, if
+ *            prefetching is already on, or if Easel was compiled
+ *            without POSIX threads support. So the caller can call
+ *            this unconditionally, right after opening <bf>.
+ *            
+ *            The prefetch thread stops when <bf> is closed. Because
+ *            it may be blocked waiting for input, <esl_buffer_Close()>
+ *            may have to wait until the stream produces more data (or
+ *            EOF); don't prefetch from an interactive stream.
+ *
+ * Args:      bf      - open input buffer
+ *            nblocks - max number of <pagesize> blocks to read ahead; >0
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <nblocks> is < 1.
+ *            <eslEMEM> on allocation failure.
+ *            <eslESYS> if a pthread call fails.
+ *            On exceptions, prefetching is off, and <bf> remains 
+ *            usable.
+ */
+int
+esl_buffer_SetPrefetch(ESL_BUFFER *bf, int nblocks)
+{
+#ifdef HAVE_PTHREAD
+  struct esl_buffer_prefetch_s *pf = NULL;
+  int                           status;
+
+  if (nblocks < 1) ESL_EXCEPTION(eslEINVAL, "need at least one prefetch block");
+  if (bf->mode_is != eslBUFFER_STREAM && bf->mode_is != eslBUFFER_CMDPIPE) return eslOK;
+  if (bf->pf || ! bf->fp || feof(bf->fp) || ferror(bf->fp))                return eslOK;
+
+  ESL_ALLOC(pf, sizeof(struct esl_buffer_prefetch_s));
+  pf->ring       = NULL;
+  pf->fp         = bf->fp;
+  pf->blocksize  = bf->pagesize;
+  pf->nalloc     = bf->pagesize * nblocks;
+  pf->head       = 0;
+  pf->nfull      = 0;
+  pf->is_eof     = FALSE;
+  pf->is_error   = FALSE;
+  pf->do_stop    = FALSE;
+  pf->is_running = FALSE;
+  ESL_ALLOC(pf->ring, sizeof(char) * pf->nalloc);
+
+  if (pthread_mutex_init(&pf->mutex, NULL) != 0) { free(pf->ring); free(pf); ESL_EXCEPTION(eslESYS, "pthread_mutex_init() failed"); }
+  if (pthread_cond_init (&pf->cv,    NULL) != 0) { pthread_mutex_destroy(&pf->mutex); free(pf->ring); free(pf); ESL_EXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+  if (pthread_create(&pf->thread, NULL, prefetch_thread, pf) != 0) { prefetch_destroy(pf); ESL_EXCEPTION(eslESYS, "pthread_create() failed"); }
+  pf->is_running = TRUE;
+
+  bf->pf = pf;
+  return eslOK;
+
+ ERROR:
+  if (pf) { free(pf->ring); free(pf); }
+  return status;
+#else
+  if (nblocks < 1) ESL_EXCEPTION(eslEINVAL, "need at least one prefetch block");
+  return eslOK;
+#endif /*HAVE_PTHREAD*/
+}
+
+
 /* Function:  esl_buffer_Close()
  * Synopsis:  Close an input buffer.
  * Incept:    SRE, Mon Feb 14 09:09:04 2011 [Janelia]
@@ -517,6 +667,9 @@ esl_buffer_Close(ESL_BUFFER *bf)
 {
   if (bf) 
     {
+#ifdef HAVE_PTHREAD
+      if (bf->pf) { prefetch_destroy(bf->pf); bf->pf = NULL; }  /* stop reading <fp> before we close it */
+#endif
       if (bf->mem) 
 	{
 	  switch (bf->mode_is) {
@@ -619,6 +772,7 @@ esl_buffer_SetOffset(ESL_BUFFER *bf, esl_pos_t offset)
     {
       bf->baseoffset = 0;  	/* (redundant: just to assure you that state is correctly set) */
       bf->pos        = offset;
+      if (bf->mode_is == eslBUFFER_MMAP) buffer_advise_mmap(bf, offset); /* e.g. an SSI jump: start kernel readahead here */
     }
 
   /* Case 2. We have an open stream.
@@ -1538,6 +1692,7 @@ buffer_create(ESL_BUFFER **ret_bf)
   bf->filename   = NULL;
   bf->cmdline    = NULL;
   bf->pagesize   = eslBUFFER_PAGESIZE;
+  bf->pf         = NULL;
   bf->errmsg[0]  = '\0';
   bf->mode_is    = eslBUFFER_UNSET;
 
@@ -1579,6 +1734,7 @@ buffer_init_file_mmap(ESL_BUFFER *bf, esl_pos_t filesize)
 
   bf->n       = filesize;
   bf->mode_is = eslBUFFER_MMAP;
+  buffer_advise_mmap(bf, 0);
 
   /* open fp no longer needed - close it. */
   fclose(bf->fp);
@@ -1644,6 +1800,187 @@ buffer_init_file_basic(ESL_BUFFER *bf)
   return status;
 }
 
+/* buffer_advise_file()
+ * Tell the kernel that we're going to read the file open in <bf->fp>
+ * sequentially, from start to end, so it can read ahead aggressively.
+ * Small files that we're about to slurp anyway are requested in full.
+ * These are only hints; failure is harmless, and ignored.
+ */
+static void
+buffer_advise_file(ESL_BUFFER *bf, esl_pos_t filesize)
+{
+#ifdef HAVE_POSIX_FADVISE
+  int fd = fileno(bf->fp);
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  if (filesize > 0 && filesize <= eslBUFFER_WILLNEED) posix_fadvise(fd, 0, filesize, POSIX_FADV_WILLNEED);
+#endif
+}
+
+/* buffer_advise_mmap()
+ * For an mmap()'ed input, tell the kernel we'll be reading the mapping
+ * sequentially, and ask it to start paging in the next
+ * <eslBUFFER_WILLNEED> bytes starting at <offset>. madvise() wants a
+ * page-aligned address, so <offset> is rounded down to a page
+ * boundary. As above, these are only hints.
+ */
+static void
+buffer_advise_mmap(ESL_BUFFER *bf, esl_pos_t offset)
+{
+#if defined (HAVE_MADVISE) && defined (HAVE_SYSCONF)
+  esl_pos_t pgsz = (esl_pos_t) sysconf(_SC_PAGESIZE);
+  esl_pos_t n;
+
+  if (pgsz <= 0 || offset < 0 || offset >= bf->n) return;
+  offset -= offset % pgsz;
+  n       = ESL_MIN(bf->n - offset, eslBUFFER_WILLNEED);
+
+  if (offset == 0) madvise(bf->mem, bf->n, MADV_SEQUENTIAL);
+  madvise(bf->mem + offset, n, MADV_WILLNEED);
+#endif
+}
+
+
+/* buffer_fread()
+ * Read up to <n> bytes from the input stream into <p>, either directly
+ * with fread(), or from the readahead ring of a prefetch thread if
+ * there is one. Like fread(), it returns fewer than <n> bytes only at
+ * EOF or on a read error; check buffer_feof() and buffer_ferror().
+ */
+static esl_pos_t
+buffer_fread(ESL_BUFFER *bf, char *p, esl_pos_t n)
+{
+#ifdef HAVE_PTHREAD
+  struct esl_buffer_prefetch_s *pf = bf->pf;
+  esl_pos_t                     nread = 0;
+  esl_pos_t                     ncopy;
+
+  if (! pf) return fread(p, sizeof(char), n, bf->fp);
+
+  while (nread < n)
+    {
+      pthread_mutex_lock(&pf->mutex);
+      while (pf->nfull == 0 && ! pf->is_eof && ! pf->is_error)
+	pthread_cond_wait(&pf->cv, &pf->mutex);
+      ncopy = ESL_MIN(n - nread, ESL_MIN(pf->nfull, pf->nalloc - pf->head));
+      pthread_mutex_unlock(&pf->mutex);
+      if (ncopy == 0) break;	/* ring is empty, and will stay that way: EOF or error */
+
+      /* ring[head..head+ncopy-1] belongs to us until we release it; copy outside the lock */
+      memcpy(p + nread, pf->ring + pf->head, ncopy);
+      nread += ncopy;
+
+      pthread_mutex_lock(&pf->mutex);
+      pf->head   = (pf->head + ncopy) % pf->nalloc;
+      pf->nfull -= ncopy;
+      pthread_cond_signal(&pf->cv);
+      pthread_mutex_unlock(&pf->mutex);
+    }
+  return nread;
+#else
+  return fread(p, sizeof(char), n, bf->fp);
+#endif
+}
+
+/* buffer_feof(), buffer_ferror()
+ * The EOF or error state of the input stream, as the parser sees it.
+ * With a prefetch thread, the stream itself may already be at EOF
+ * while we still have unconsumed data in the readahead ring.
+ */
+static int
+buffer_feof(ESL_BUFFER *bf)
+{
+#ifdef HAVE_PTHREAD
+  int is_eof;
+  if (bf->pf)
+    {
+      pthread_mutex_lock(&bf->pf->mutex);
+      is_eof = (bf->pf->is_eof && bf->pf->nfull == 0);
+      pthread_mutex_unlock(&bf->pf->mutex);
+      return is_eof;
+    }
+#endif
+  return feof(bf->fp);
+}
+
+static int
+buffer_ferror(ESL_BUFFER *bf)
+{
+#ifdef HAVE_PTHREAD
+  int is_error;
+  if (bf->pf)
+    {
+      pthread_mutex_lock(&bf->pf->mutex);
+      is_error = (bf->pf->is_error && bf->pf->nfull == 0);
+      pthread_mutex_unlock(&bf->pf->mutex);
+      return is_error;
+    }
+#endif
+  return (!feof(bf->fp) && ferror(bf->fp));
+}
+
+
+#ifdef HAVE_PTHREAD
+/* prefetch_thread()
+ * The readahead thread started by esl_buffer_SetPrefetch(). 
+ * Reads <blocksize> chunks of the stream into free space in the ring
+ * buffer, as long as there's room, until EOF, a read error, or
+ * until the buffer is closed.
+ */
+static void *
+prefetch_thread(void *arg)
+{
+  struct esl_buffer_prefetch_s *pf = (struct esl_buffer_prefetch_s *) arg;
+  esl_pos_t tail, nwant, nread;
+  int       is_eof, is_error;
+
+  pthread_mutex_lock(&pf->mutex);
+  while (! pf->do_stop)
+    {
+      if (pf->nalloc - pf->nfull < pf->blocksize) { pthread_cond_wait(&pf->cv, &pf->mutex); continue; }
+
+      tail  = (pf->head + pf->nfull) % pf->nalloc;
+      nwant = ESL_MIN(pf->blocksize, pf->nalloc - tail);	/* don't wrap around the end of the ring in one read */
+      pthread_mutex_unlock(&pf->mutex);
+
+      /* ring[tail..tail+nwant-1] is free space; the consumer won't touch it */
+      nread    = fread(pf->ring + tail, sizeof(char), nwant, pf->fp);
+      is_eof   = (nread < nwant && feof(pf->fp));
+      is_error = (nread < nwant && ! is_eof && ferror(pf->fp));
+
+      pthread_mutex_lock(&pf->mutex);
+      pf->nfull   += nread;
+      pf->is_eof   = is_eof;
+      pf->is_error = is_error;
+      pthread_cond_signal(&pf->cv);
+      if (is_eof || is_error) break;
+    }
+  pthread_mutex_unlock(&pf->mutex);
+  return NULL;
+}
+
+/* prefetch_destroy()
+ * Stop the prefetch thread (if it's running), and free its resources.
+ */
+static void
+prefetch_destroy(struct esl_buffer_prefetch_s *pf)
+{
+  if (pf->is_running)
+    {
+      pthread_mutex_lock(&pf->mutex);
+      pf->do_stop = TRUE;
+      pthread_cond_signal(&pf->cv);
+      pthread_mutex_unlock(&pf->mutex);
+      pthread_join(pf->thread, NULL);
+    }
+  pthread_cond_destroy(&pf->cv);
+  pthread_mutex_destroy(&pf->mutex);
+  free(pf->ring);
+  free(pf);
+}
+#endif /*HAVE_PTHREAD*/
+
+
 /* buffer_refill()      
  * For current buffer position bf->pos, try to assure that
  * we have at least <bf->pagesize> bytes loaded in <bf->mem> to parse.
@@ -1683,7 +2020,7 @@ buffer_refill(ESL_BUFFER *bf, esl_pos_t nmin)
   esl_pos_t nread;
   int       status;
 
-  if (! bf->fp || feof(bf->fp)) return ( (bf->pos < bf->n) ? eslOK : eslEOF); /* without an active fp, we have whole buffer in memory; either no-op OK, or EOF */
+  if (! bf->fp || buffer_feof(bf)) return ( (bf->pos < bf->n) ? eslOK : eslEOF); /* without an active fp, we have whole buffer in memory; either no-op OK, or EOF */
   if (bf->n - bf->pos >= nmin + bf->pagesize) return eslOK;                   /* if we already have enough data in buffer window, no-op       w  */
 
   if (bf->pos > bf->n) ESL_EXCEPTION(eslEINCONCEIVABLE, "impossible position for buffer <pos>"); 
@@ -1708,8 +2045,8 @@ buffer_refill(ESL_BUFFER *bf, esl_pos_t nmin)
       bf->balloc = bf->n + bf->pagesize;
     }
 
-  nread = fread(bf->mem+bf->n, sizeof(char), bf->pagesize, bf->fp);
-  if (nread == 0 && !feof(bf->fp) && ferror(bf->fp)) ESL_EXCEPTION(eslESYS, "fread() failure");
+  nread = buffer_fread(bf, bf->mem+bf->n, bf->pagesize);
+  if (nread == 0 && buffer_ferror(bf)) ESL_EXCEPTION(eslESYS, "fread() failure");
 
   bf->n += nread;
   if (nread == 0 && bf->pos == bf->n) return eslEOF; else return eslOK;
@@ -1807,8 +2144,8 @@ buffer_skipsep(ESL_BUFFER *bf, const char *sep)
 
   /* skip characters in sep[], or hit EOF. */
   do {
-    for ( ; bf->pos < bf->n; bf->pos++)
-      if (strchr(sep, bf->mem[bf->pos]) == NULL) goto DONE;
+    bf->pos += esl_memspn(bf->mem + bf->pos, bf->n - bf->pos, sep);
+    if (bf->pos < bf->n) goto DONE;
     if ( (status = buffer_refill(bf, 0)) != eslOK && status != eslEOF) return status; 
   } while (bf->n > bf->pos);
 
@@ -1849,16 +2186,19 @@ buffer_newline(ESL_BUFFER *bf)
 static int
 buffer_counttok(ESL_BUFFER *bf, const char *sep, esl_pos_t *ret_nc)
 {
-  esl_pos_t nc;
+  esl_pos_t nc, nc0;
+  char     *nl;
   int       status;
 
   /* skip chars NOT in sep[]. */
   nc = 1;
   do {
-    for ( ; nc < bf->n-bf->pos; nc++)
+    if (nc < bf->n-bf->pos)
       {
-	if (strchr(sep, bf->mem[bf->pos+nc]) != NULL) break; /* token ends on any char in sep       */
-	if (bf->mem[bf->pos+nc] == '\n')              break; /* token also always ends on a newline */
+	nc0 = nc;
+	nc += esl_memcspn(bf->mem + bf->pos + nc, bf->n - bf->pos - nc, sep);           /* token ends on any char in sep       */
+	if ((nl = memchr(bf->mem + bf->pos + nc0, '\n', nc - nc0)) != NULL)              /* token also always ends on a newline */
+	  nc = nl - (bf->mem + bf->pos);
       }
     if (nc < bf->n-bf->pos) break; /* token ended in our current buffer */
     
@@ -2832,7 +3172,7 @@ main(int argc, char **argv)
 
   utest_halfnewline();
 
-  nbuftypes  = 7;
+  nbuftypes  = 10;
   ntesttypes = 8;
   for (bufidx = 0; bufidx < nbuftypes; bufidx++)
     for (testidx = 0; testidx < ntesttypes; testidx++)
@@ -2857,6 +3197,16 @@ main(int argc, char **argv)
 	  /* now bftmp->mem is a slurped file */
 	  if (esl_buffer_OpenMem(bftmp->mem, bftmp->n, &bf) != eslOK) esl_fatal(msg);
 	  break;
+	case 7:  if (esl_buffer_OpenFile_adv(tmpfile, 0,           &bf) != eslOK) esl_fatal(msg);  break; /* slurpsize 0 forces mmap() */
+	case 8: 
+	  if ((fp = fopen(tmpfile, "rb"))    == NULL)  esl_fatal(msg);
+	  if (esl_buffer_OpenStream(fp, &bf) != eslOK) esl_fatal(msg);
+	  if (esl_buffer_SetPrefetch(bf, 2)  != eslOK) esl_fatal(msg);
+	  break;
+	case 9:
+	  if (esl_buffer_OpenPipe(tmpfile, cmdfmt, &bf) != eslOK) esl_fatal(msg);
+	  if (esl_buffer_SetPrefetch(bf, eslBUFFER_PREFETCH) != eslOK) esl_fatal(msg);
+	  break;
 	default: esl_fatal(msg);
 	}
 	
@@ -7,7 +7,9 @@
 #include <stdio.h>
 
 #define eslBUFFER_PAGESIZE      4096    /* default for b->pagesize                       */
-#define eslBUFFER_SLURPSIZE  4194304	/* switchover from slurping whole file to mmap() */
+#define eslBUFFER_SLURPSIZE  4194304	/* default switchover from slurping whole file to mmap() */
+#define eslBUFFER_WILLNEED  16777216    /* readahead hint window for mmap()'ed input, in bytes  */
+#define eslBUFFER_PREFETCH         8    /* default # of <pagesize> blocks read ahead by prefetch thread */
 
 enum esl_buffer_mode_e {
   eslBUFFER_UNSET   = 0,
@@ -34,6 +36,7 @@ typedef struct {
   char      *cmdline;		  /* for diagnostics. NULL, or cmd for CMDPIPE             */
 
   esl_pos_t  pagesize;	          /* size of new <fp> reads. Guarantee: n-pos >= pagesize  */
+  struct esl_buffer_prefetch_s *pf; /* readahead thread reading <fp> for us; or NULL       */
 
   char     errmsg[eslERRBUFSIZE]; /* error message storage                                 */
   enum esl_buffer_mode_e mode_is; /* mode (stdin, cmdpipe, file, allfile, mmap, string)    */
@@ -43,9 +46,11 @@ typedef struct {
 /* 1. The ESL_BUFFER object: opening/closing.  */
 extern int esl_buffer_Open      (const char *filename, const char *envvar, ESL_BUFFER **ret_bf);
 extern int esl_buffer_OpenFile  (const char *filename,                     ESL_BUFFER **ret_bf);
+extern int esl_buffer_OpenFile_adv(const char *filename, esl_pos_t slurpsize, ESL_BUFFER **ret_bf);
 extern int esl_buffer_OpenPipe  (const char *filename, const char *cmdfmt, ESL_BUFFER **ret_bf);
 extern int esl_buffer_OpenMem   (const char *p,         esl_pos_t  n,      ESL_BUFFER **ret_bf);
 extern int esl_buffer_OpenStream(FILE *fp,                                 ESL_BUFFER **ret_bf);
+extern int esl_buffer_SetPrefetch(ESL_BUFFER *bf, int nblocks);
 extern int esl_buffer_Close(ESL_BUFFER *bf);
 
 /* 2. Positioning and anchoring an ESL_BUFFER. */
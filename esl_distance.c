@@ -16,17 +16,47 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "easel.h"
 #include "esl_alphabet.h"
+#include "esl_cpu.h"
 #include "esl_dmatrix.h"
 #include "esl_random.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
 
 #include "esl_distance.h"
 
+/* <which> distance xdist_matrix() computes */
+#define XDIST_PAIRID       0
+#define XDIST_DIFF         1
+#define XDIST_JUKESCANTOR  2
+
 /* Forward declaration of our static functions.
  */
-static int jukescantor(int n1, int n2, int alphabet_size, double *opt_distance, double *opt_variance);
+static int  jukescantor(int n1, int n2, int alphabet_size, double *opt_distance, double *opt_variance);
+static void xcount_select(void);
+static void xcount_dispatcher(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid);
+static void xcount_serial    (ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid);
+static void xbitcount_dispatcher(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid);
+static void xbitcount_serial    (const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid);
+static int  xdist_matrix(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, int which, ESL_DMATRIX *D, ESL_DMATRIX *V, int *ret_i, int *ret_j);
+
+/* xcount() counts canonical residues and identities in two aligned
+ * digital rows. It starts out pointing at the dispatcher, which
+ * resets it to the best implementation the processor supports on
+ * the first call. (Threads racing on that first call all store the
+ * same value.)
+ */
+static void (*xcount)(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid) = xcount_dispatcher;
+
+/* xbitcount() is the same thing for two ESL_DST_BITS rows.
+ */
+static void (*xbitcount)(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid) = xbitcount_dispatcher;
 
 
 /*****************************************************************
@@ -279,29 +309,12 @@ esl_dst_XPairId(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2,
 		double *opt_distance, int *opt_nid, int *opt_n)
 {
   int     status;
-  int     idents;               /* total identical positions  */
-  int     len1, len2;           /* lengths of seqs            */
-  int     i;                    /* position in aligned seqs   */
+  int64_t n;                    /* aligned length             */
 
-  idents = len1 = len2 = 0;
-  for (i = 1; ax1[i] != eslDSQ_SENTINEL && ax2[i] != eslDSQ_SENTINEL; i++) 
-    {
-      if (esl_abc_XIsCanonical(abc, ax1[i])) len1++;
-      if (esl_abc_XIsCanonical(abc, ax2[i])) len2++;
+  n = esl_abc_dsqlen(ax1);
+  if (esl_abc_dsqlen(ax2) != n) ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
 
-      if (esl_abc_XIsCanonical(abc, ax1[i]) && esl_abc_XIsCanonical(abc, ax2[i])
-	  && ax1[i] == ax2[i])
-	idents++;
-    }
-  if (len2 < len1) len1 = len2;
-
-  if (ax1[i] != eslDSQ_SENTINEL || ax2[i] != eslDSQ_SENTINEL) 
-    ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
-
-  if (opt_distance != NULL)  *opt_distance = ( len1==0 ? 0. : (double) idents / (double) len1 );
-  if (opt_nid      != NULL)  *opt_nid      = idents;
-  if (opt_n        != NULL)  *opt_n        = len1;
-  return eslOK;
+  return esl_dst_XPairIdL(abc, ax1, ax2, n, opt_distance, opt_nid, opt_n);
 
  ERROR:
   if (opt_distance != NULL)  *opt_distance = 0.;
@@ -310,6 +323,36 @@ esl_dst_XPairId(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2,
   return status;
 }
 
+/* Function:  esl_dst_XPairIdL()
+ * Synopsis:  Pairwise identity of two aligned digital seqs of known length.
+ *
+ * Purpose:   Same as <esl_dst_XPairId()>, for two rows <ax1> and
+ *            <ax2> that the caller already knows both have aligned
+ *            length <L>, such as two rows of a digital MSA with
+ *            <L = msa->alen>. This skips the scans for the sentinels
+ *            that <esl_dst_XPairId()> uses to check the lengths. In
+ *            loops over many pairs of short rows, those scans can
+ *            take longer than the comparison itself.
+ *
+ * Returns:   <eslOK> on success. <opt_pid>, <opt_nid>, <opt_n>
+ *            contain the answers, for any of these that were passed
+ *            non-<NULL> pointers.
+ */
+int
+esl_dst_XPairIdL(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t L,
+		 double *opt_pid, int *opt_nid, int *opt_n)
+{
+  int idents, len1, len2, nboth;
+
+  xcount(abc->K, ax1+1, ax2+1, L, &len1, &len2, &nboth, &idents);
+  if (len2 < len1) len1 = len2;
+
+  if (opt_pid != NULL)  *opt_pid = ( len1==0 ? 0. : (double) idents / (double) len1 );
+  if (opt_nid != NULL)  *opt_nid = idents;
+  if (opt_n   != NULL)  *opt_n   = len1;
+  return eslOK;
+}
+
 /* Function:  esl_dst_XPairMatch()
  * Synopsis:  Pairwise matches of two aligned digital seqs.
  * Incept:    ER, Wed Oct 29 09:09:07 EDT 2014 [janelia]
@@ -342,17 +385,15 @@ esl_dst_XPairMatch(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *a
   int     status;
   int     match;                /* total matched positions              */
   int     len;                  /* length of alignment (no double gaps) */
-  int     i;                    /* position in aligned seqs             */
+  int     len1, len2;           /* # of canonical residues in each seq  */
+  int     idents;               /* # of identities (unused here)        */
+  int64_t n;                    /* aligned length                       */
 
-  match = len = 0;
-  for (i = 1; ax1[i] != eslDSQ_SENTINEL && ax2[i] != eslDSQ_SENTINEL; i++) 
-    {
-      if (esl_abc_XIsCanonical(abc, ax1[i]) || esl_abc_XIsCanonical(abc, ax2[i])) len ++;
-      if (esl_abc_XIsCanonical(abc, ax1[i]) && esl_abc_XIsCanonical(abc, ax2[i])) match++;
-    }
+  n = esl_abc_dsqlen(ax1);
+  if (esl_abc_dsqlen(ax2) != n) ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
 
-  if (ax1[i] != eslDSQ_SENTINEL || ax2[i] != eslDSQ_SENTINEL) 
-    ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
+  xcount(abc->K, ax1+1, ax2+1, n, &len1, &len2, &match, &idents);
+  len = len1 + len2 - match;
 
   if (opt_distance != NULL)  *opt_distance = ( len==0 ? 0. : (double)match / (double)len );
   if (opt_nmatch   != NULL)  *opt_nmatch   = match;
@@ -402,22 +443,15 @@ esl_dst_XJukesCantor(const ESL_ALPHABET *abc, const ESL_DSQ *ax, const ESL_DSQ *
 		     double *opt_distance, double *opt_variance)
 {
   int     status;
-  int     n1, n2;               /* number of observed identities, substitutions */
-  int     i;                    /* position in aligned seqs   */
+  int     c1, c2;               /* number of canonical residues in each seq       */
+  int     nboth, nid;           /* number of aligned canonical pairs, identities */
+  int64_t n;                    /* aligned length                                */
 
-  n1 = n2 = 0;
-  for (i = 1; ax[i] != eslDSQ_SENTINEL && ay[i] != eslDSQ_SENTINEL; i++) 
-    {
-      if (esl_abc_XIsCanonical(abc, ax[i]) && esl_abc_XIsCanonical(abc, ay[i]))
-	{
-	  if (ax[i] == ay[i]) n1++;
-	  else                n2++;
-	}
-    }
-  if (ax[i] != eslDSQ_SENTINEL || ay[i] != eslDSQ_SENTINEL) 
-    ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
-  
-  return jukescantor(n1, n2, abc->K, opt_distance, opt_variance);
+  n = esl_abc_dsqlen(ax);
+  if (esl_abc_dsqlen(ay) != n) ESL_XEXCEPTION(eslEINVAL, "strings not same length, not aligned");
+
+  xcount(abc->K, ax+1, ay+1, n, &c1, &c2, &nboth, &nid);
+  return jukescantor(nid, nboth-nid, abc->K, opt_distance, opt_variance);
 
  ERROR:
   if (opt_distance != NULL)  *opt_distance = HUGE_VAL;
@@ -654,17 +688,10 @@ esl_dst_XPairIdMx(const ESL_ALPHABET *abc,  ESL_DSQ **ax, int N, ESL_DMATRIX **r
 
   if (( S = esl_dmatrix_Create(N,N) ) == NULL) { status = eslEMEM; goto ERROR; }
   
-  for (i = 0; i < N; i++)
-    {
-      S->mx[i][i] = 1.;
-      for (j = i+1; j < N; j++)
-	{
-	  status = esl_dst_XPairId(abc, ax[i], ax[j], &(S->mx[i][j]), NULL, NULL);
-	  if (status != eslOK)
-	    ESL_XEXCEPTION(status, "Pairwise identity calculation failed at seqs %d,%d\n", i,j);
-	  S->mx[j][i] =  S->mx[i][j];
-	}
-    }
+  status = xdist_matrix(abc, ax, N, 1, XDIST_PAIRID, S, NULL, &i, &j);
+  if (status != eslOK)
+    ESL_XEXCEPTION(status, "Pairwise identity calculation failed at seqs %d,%d\n", i,j);
+
   if (ret_S != NULL) *ret_S = S; else esl_dmatrix_Destroy(S);
   return eslOK;
 
@@ -703,18 +730,12 @@ esl_dst_XDiffMx(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, ESL_DMATRIX **ret_
   ESL_DMATRIX *D = NULL;
   int i,j;
 
-  status = esl_dst_XPairIdMx(abc, ax, N, &D);
-  if (status != eslOK) goto ERROR;
+  if (( D = esl_dmatrix_Create(N,N) ) == NULL) { status = eslEMEM; goto ERROR; }
+
+  status = xdist_matrix(abc, ax, N, 1, XDIST_DIFF, D, NULL, &i, &j);
+  if (status != eslOK)
+    ESL_XEXCEPTION(status, "Pairwise identity calculation failed at seqs %d,%d\n", i,j);
 
-  for (i = 0; i < N; i++)
-    {
-      D->mx[i][i] = 0.;
-      for (j = i+1; j < N; j++) 
-	{
-	  D->mx[i][j] = 1. - D->mx[i][j];
-	  D->mx[j][i] = D->mx[i][j];
-	}
-    }
   if (ret_D != NULL) *ret_D = D; else esl_dmatrix_Destroy(D);
   return eslOK;
 
@@ -770,21 +791,10 @@ esl_dst_XJukesCantorMx(const ESL_ALPHABET *abc, ESL_DSQ **ax, int nseq,
   if (( D = esl_dmatrix_Create(nseq, nseq) ) == NULL) { status = eslEMEM; goto ERROR; }
   if (( V = esl_dmatrix_Create(nseq, nseq) ) == NULL) { status = eslEMEM; goto ERROR; }
 
-  for (i = 0; i < nseq; i++)
-    {
-      D->mx[i][i] = 0.;
-      V->mx[i][i] = 0.;
-      for (j = i+1; j < nseq; j++)
-	{
-	  status = esl_dst_XJukesCantor(abc, ax[i], ax[j], 
-					&(D->mx[i][j]), &(V->mx[i][j]));
-	  if (status != eslOK) 
-	    ESL_XEXCEPTION(status, "J/C calculation failed at digital aseqs %d,%d", i,j);
+  status = xdist_matrix(abc, ax, nseq, 1, XDIST_JUKESCANTOR, D, V, &i, &j);
+  if (status != eslOK) 
+    ESL_XEXCEPTION(status, "J/C calculation failed at digital aseqs %d,%d", i,j);
 
-	  D->mx[j][i] = D->mx[i][j];
-	  V->mx[j][i] = V->mx[i][j];
-	}
-    }
   if (opt_D != NULL) *opt_D = D;  else esl_dmatrix_Destroy(D);
   if (opt_V != NULL) *opt_V = V;  else esl_dmatrix_Destroy(V);
   return eslOK;
@@ -796,6 +806,279 @@ esl_dst_XJukesCantorMx(const ESL_ALPHABET *abc, ESL_DSQ **ax, int nseq,
   if (opt_V != NULL) *opt_V = NULL;
   return status;
 }
+
+
+/* Function:  esl_dst_XPairIdUpper()
+ * Synopsis:  Packed upper triangle identity matrix for N digital seqs, threaded.
+ *
+ * Purpose:   Same as <esl_dst_XPairIdMx()>, except that the result
+ *            <S> is a packed upper triangular matrix
+ *            (<esl_dmatrix_CreateUpper()>), holding only cells
+ *            $i \leq j$ in about half the memory; and the work is
+ *            done by <ncpu> worker threads.
+ *
+ *            The upper triangle is cut into square tiles of a few
+ *            hundred sequences at most (fewer, for longer
+ *            alignments) so each tile's rows stay in cache while
+ *            they're compared; workers take tiles from a shared
+ *            counter. If <ncpu> is $\leq 1$, or Easel was built
+ *            without POSIX threads, the tiles are computed in the
+ *            caller's thread. The result is identical for any
+ *            <ncpu>, and identical to <esl_dst_XPairIdMx()>.
+ *
+ * Args:      abc   - digital alphabet in use
+ *            ax    - aligned dsq's, [0..N-1][1..alen]
+ *            N     - number of aligned sequences
+ *            ncpu  - number of worker threads
+ *            ret_S - RETURN: packed upper NxN matrix of fractional identities
+ *
+ * Returns:   <eslOK> on success, and <ret_S> contains the identity
+ *            matrix; caller frees it with <esl_dmatrix_Destroy()>.
+ *
+ * Throws:    <eslEINVAL> if a seq has a different length than others.
+ *            <eslEMEM> on allocation failure; <eslESYS> if a thread
+ *            can't be started. On failure, <ret_S> is returned <NULL>.
+ */
+int
+esl_dst_XPairIdUpper(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, ESL_DMATRIX **ret_S)
+{
+  ESL_DMATRIX *S = NULL;
+  int          status;
+  int          i,j;
+
+  if (( S = esl_dmatrix_CreateUpper(N) ) == NULL) { status = eslEMEM; goto ERROR; }
+
+  status = xdist_matrix(abc, ax, N, ncpu, XDIST_PAIRID, S, NULL, &i, &j);
+  if (status != eslOK)
+    ESL_XEXCEPTION(status, "Pairwise identity calculation failed at seqs %d,%d\n", i,j);
+
+  *ret_S = S;
+  return eslOK;
+
+ ERROR:
+  esl_dmatrix_Destroy(S);
+  *ret_S = NULL;
+  return status;
+}
+
+/* Function:  esl_dst_XDiffUpper()
+ * Synopsis:  Packed upper triangle difference matrix for N digital seqs, threaded.
+ *
+ * Purpose:   Same as <esl_dst_XPairIdUpper()>, but calculates
+ *            fractional difference <1-s> instead of fractional
+ *            identity <s> for each pair, as <esl_dst_XDiffMx()>
+ *            does.
+ *
+ * Args:      abc   - digital alphabet in use
+ *            ax    - aligned dsq's, [0..N-1][1..alen]
+ *            N     - number of aligned sequences
+ *            ncpu  - number of worker threads
+ *            ret_D - RETURN: packed upper NxN matrix of fractional differences
+ *
+ * Returns:   <eslOK> on success, and <ret_D> contains the difference
+ *            matrix; caller frees it with <esl_dmatrix_Destroy()>.
+ *
+ * Throws:    <eslEINVAL> if a seq has a different length than others.
+ *            <eslEMEM> on allocation failure; <eslESYS> if a thread
+ *            can't be started. On failure, <ret_D> is returned <NULL>.
+ */
+int
+esl_dst_XDiffUpper(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, ESL_DMATRIX **ret_D)
+{
+  ESL_DMATRIX *D = NULL;
+  int          status;
+  int          i,j;
+
+  if (( D = esl_dmatrix_CreateUpper(N) ) == NULL) { status = eslEMEM; goto ERROR; }
+
+  status = xdist_matrix(abc, ax, N, ncpu, XDIST_DIFF, D, NULL, &i, &j);
+  if (status != eslOK)
+    ESL_XEXCEPTION(status, "Pairwise identity calculation failed at seqs %d,%d\n", i,j);
+
+  *ret_D = D;
+  return eslOK;
+
+ ERROR:
+  esl_dmatrix_Destroy(D);
+  *ret_D = NULL;
+  return status;
+}
+
+/* Function:  esl_dst_XJukesCantorUpper()
+ * Synopsis:  Packed upper triangle Jukes/Cantor distance matrix for N digital seqs, threaded.
+ *
+ * Purpose:   Same as <esl_dst_XJukesCantorMx()>, except that <D> and
+ *            <V> are packed upper triangular matrices, and the work
+ *            is done by <ncpu> worker threads, as in
+ *            <esl_dst_XPairIdUpper()>.
+ *
+ * Args:      abc    - bioalphabet for <aseq>
+ *            ax     - aligned digital sequences [0.nseq-1][1..L]
+ *            nseq   - number of aseqs
+ *            ncpu   - number of worker threads
+ *            opt_D  - optRETURN: packed upper distance mx
+ *            opt_V  - optRETURN: packed upper matrix of variances.
+ *
+ * Returns:   <eslOK> on success. <D> (and optionally <V>) contain the
+ *            distance matrix (and variances). Caller frees these with
+ *            <esl_dmatrix_Destroy()>. 
+ *
+ * Throws:    <eslEINVAL> if any pair of sequences have differing lengths.
+ *            <eslEDIVZERO> if some pair of sequences had no aligned
+ *            residues. <eslEMEM> on allocation failure; <eslESYS> if
+ *            a thread can't be started. On failure, <D> and <V> are
+ *            both returned <NULL>.
+ */
+int
+esl_dst_XJukesCantorUpper(const ESL_ALPHABET *abc, ESL_DSQ **ax, int nseq, int ncpu,
+			  ESL_DMATRIX **opt_D, ESL_DMATRIX **opt_V)
+{
+  ESL_DMATRIX *D = NULL;
+  ESL_DMATRIX *V = NULL;
+  int          status;
+  int          i,j;
+
+  if (( D = esl_dmatrix_CreateUpper(nseq) ) == NULL) { status = eslEMEM; goto ERROR; }
+  if (( V = esl_dmatrix_CreateUpper(nseq) ) == NULL) { status = eslEMEM; goto ERROR; }
+
+  status = xdist_matrix(abc, ax, nseq, ncpu, XDIST_JUKESCANTOR, D, V, &i, &j);
+  if (status != eslOK) 
+    ESL_XEXCEPTION(status, "J/C calculation failed at digital aseqs %d,%d", i,j);
+
+  if (opt_D != NULL) *opt_D = D;  else esl_dmatrix_Destroy(D);
+  if (opt_V != NULL) *opt_V = V;  else esl_dmatrix_Destroy(V);
+  return eslOK;
+
+ ERROR:
+  if (D     != NULL) esl_dmatrix_Destroy(D);
+  if (V     != NULL) esl_dmatrix_Destroy(V);
+  if (opt_D != NULL) *opt_D = NULL;
+  if (opt_V != NULL) *opt_V = NULL;
+  return status;
+}
+
+
+/* Function:  esl_dst_XBitEncode()
+ * Synopsis:  Bit-slice a digital nucleic acid alignment for fast identity calculations.
+ *
+ * Purpose:   Encode the <N> aligned digital sequences <ax> in
+ *            nucleic acid alphabet <abc> (alphabet size K=4) as an
+ *            <ESL_DST_BITS>: for each block of 64 columns, one word
+ *            each for the low bit and the high bit of canonical
+ *            residue codes, and one canonical residue mask. A pair of
+ *            rows can then be compared 64 columns at a time with
+ *            XOR, AND, and popcount, as <esl_dst_BitPairId()> does.
+ *
+ *            <esl_dst_X{PairId,Diff,JukesCantor}{Mx,Upper}()> do
+ *            this themselves for nucleic alphabets. Use this
+ *            directly when you're going to compare the same rows
+ *            many times yourself.
+ *
+ * Args:      abc    - digital alphabet in use; must have K=4
+ *            ax     - aligned dsq's, [0..N-1][1..alen]
+ *            N      - number of aligned sequences
+ *            ret_bx - RETURN: bit-sliced alignment
+ *
+ * Returns:   <eslOK> on success, and <*ret_bx> is the new
+ *            <ESL_DST_BITS>. Caller frees it with <esl_dst_bits_Destroy()>.
+ *
+ * Throws:    <eslEINCOMPAT> if <abc> isn't a K=4 alphabet.
+ *            <eslEINVAL> if the seqs aren't all the same length.
+ *            <eslEMEM> on allocation failure.
+ *            On any exception, <*ret_bx> is <NULL>.
+ */
+int
+esl_dst_XBitEncode(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, ESL_DST_BITS **ret_bx)
+{
+  ESL_DST_BITS *bx = NULL;
+  uint64_t     *r;
+  uint64_t      bit;
+  int64_t       pos;
+  int           idx;
+  int           status;
+
+  if (abc->K != 4) ESL_XEXCEPTION(eslEINCOMPAT, "bit-sliced rows need a K=4 (nucleic) alphabet");
+
+  ESL_ALLOC(bx, sizeof(ESL_DST_BITS));
+  bx->N    = N;
+  bx->L    = (N > 0 ? esl_abc_dsqlen(ax[0]) : 0);
+  bx->W    = (bx->L + 63) / 64;
+  bx->b    = NULL;
+  bx->nres = NULL;
+  ESL_ALLOC(bx->b,    sizeof(uint64_t) * ESL_MAX(1, (int64_t) N * 3 * bx->W));
+  ESL_ALLOC(bx->nres, sizeof(int)      * ESL_MAX(1, N));
+  memset(bx->b, 0, sizeof(uint64_t) * (int64_t) N * 3 * bx->W);
+
+  for (idx = 0; idx < N; idx++)
+    {
+      if (esl_abc_dsqlen(ax[idx]) != bx->L) ESL_XEXCEPTION(eslEINVAL, "seq %d isn't the same length as seq 0, not aligned", idx);
+
+      r              = bx->b + (int64_t) idx * 3 * bx->W;
+      bx->nres[idx]  = 0;
+      for (pos = 0; pos < bx->L; pos++)
+	if (ax[idx][pos+1] < 4)
+	  {
+	    bit = 1ULL << (pos % 64);
+	    if (ax[idx][pos+1] & 1) r[3*(pos/64)]   |= bit;
+	    if (ax[idx][pos+1] & 2) r[3*(pos/64)+1] |= bit;
+	    r[3*(pos/64)+2] |= bit;
+	    bx->nres[idx]++;
+	  }
+    }
+
+  *ret_bx = bx;
+  return eslOK;
+
+ ERROR:
+  esl_dst_bits_Destroy(bx);
+  *ret_bx = NULL;
+  return status;
+}
+
+/* Function:  esl_dst_BitPairId()
+ * Synopsis:  Pairwise identity of two rows of a bit-sliced alignment.
+ *
+ * Purpose:   Same as <esl_dst_XPairId()>, for rows <i> and <j> of
+ *            bit-sliced nucleic acid alignment <bx>, and gives
+ *            identical results.
+ *
+ * Args:      bx       - bit-sliced alignment, from <esl_dst_XBitEncode()>
+ *            i,j      - indices of the two rows, 0..N-1
+ *            opt_pid  - optRETURN: pairwise identity, 0<=x<=1
+ *            opt_nid  - optRETURN: # of identities
+ *            opt_n    - optRETURN: denominator MIN(len1,len2)
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+esl_dst_BitPairId(const ESL_DST_BITS *bx, int i, int j, double *opt_pid, int *opt_nid, int *opt_n)
+{
+  int nboth, nid;
+  int len = ESL_MIN(bx->nres[i], bx->nres[j]);
+
+  ESL_DASSERT1(( i >= 0 && i < bx->N && j >= 0 && j < bx->N ));
+
+  xbitcount(bx->b + (int64_t) i * 3 * bx->W, bx->b + (int64_t) j * 3 * bx->W, bx->W, &nboth, &nid);
+
+  if (opt_pid != NULL) *opt_pid = ( len==0 ? 0. : (double) nid / (double) len );
+  if (opt_nid != NULL) *opt_nid = nid;
+  if (opt_n   != NULL) *opt_n   = len;
+  return eslOK;
+}
+
+/* Function:  esl_dst_bits_Destroy()
+ * Synopsis:  Free an <ESL_DST_BITS>.
+ */
+void
+esl_dst_bits_Destroy(ESL_DST_BITS *bx)
+{
+  if (bx)
+    {
+      free(bx->b);
+      free(bx->nres);
+      free(bx);
+    }
+}
 /*------- end, distance matrices for digital alignments ---------*/
 
 
@@ -1138,6 +1421,302 @@ jukescantor(int n1, int n2, int alphabet_size, double *opt_distance, double *opt
   if (opt_variance != NULL)  *opt_variance = HUGE_VAL;
   return status;
 }
+
+/* xcount_select()
+ * Set xcount() and xbitcount() to the fastest implementations the
+ * processor supports.
+ */
+static void
+xcount_select(void)
+{
+  xcount    = xcount_serial;
+  xbitcount = xbitcount_serial;
+#ifdef eslENABLE_SSE
+  if (esl_cpu_has_sse())    xcount = esl_dst_xcount_sse;
+#endif
+#ifdef eslENABLE_AVX
+  if (esl_cpu_has_avx())    { xcount = esl_dst_xcount_avx; xbitcount = esl_dst_xbitcount_avx; }
+#endif
+#ifdef eslENABLE_AVX512
+  if (esl_cpu_has_avx512()) xcount = esl_dst_xcount_avx512;
+#endif
+}
+
+/* xcount_dispatcher()
+ * Select the xcount() implementation on first call, then run it.
+ */
+static void
+xcount_dispatcher(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid)
+{
+  xcount_select();
+  xcount(K, ax1, ax2, n, ret_c1, ret_c2, ret_cboth, ret_cid);
+}
+
+/* xcount_serial()
+ * Reference implementation of xcount(), for processors without
+ * vector support. <ax1>, <ax2> are indexed 0..n-1: the caller
+ * passes <ax+1>. Residue <x> is canonical iff <x < K>, as in
+ * <esl_abc_XIsCanonical()>.
+ */
+static void
+xcount_serial(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid)
+{
+  int     c1 = 0, c2 = 0, cb = 0, cid = 0;
+  int64_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (ax1[i] < K) c1++;
+      if (ax2[i] < K) c2++;
+      if (ax1[i] < K && ax2[i] < K) { cb++; if (ax1[i] == ax2[i]) cid++; }
+    }
+  *ret_c1    = c1;
+  *ret_c2    = c2;
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+/* xbitcount_dispatcher()
+ * Select the xbitcount() implementation on first call, then run it.
+ */
+static void
+xbitcount_dispatcher(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid)
+{
+  xcount_select();
+  xbitcount(r1, r2, W, ret_cboth, ret_cid);
+}
+
+/* popcount64()
+ * Number of 1 bits in <x>.
+ */
+static inline int
+popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (int) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* xbitcount_serial()
+ * Reference implementation of xbitcount(). <r1>, <r2> are two rows
+ * of an <ESL_DST_BITS>, <W> (lo, hi, canonical) word triplets each.
+ * Count columns where both residues are canonical (<*ret_cboth>) and
+ * where they are also identical: both bits of the code match
+ * (<*ret_cid>).
+ */
+static void
+xbitcount_serial(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid)
+{
+  uint64_t both;
+  int      cb = 0, cid = 0;
+  int64_t  w;
+
+  for (w = 0; w < 3*W; w += 3)
+    {
+      both = r1[w+2] & r2[w+2];
+      cb  += popcount64(both);
+      cid += popcount64(both & ~((r1[w] ^ r2[w]) | (r1[w+1] ^ r2[w+1])));
+    }
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+
+/* xdist_matrix()
+ * The all-vs-all engine for esl_dst_X{PairId,Diff,JukesCantor}{Mx,Upper}().
+ *
+ * Fills <D> (and <V>, for Jukes/Cantor) for all pairs of the <N>
+ * aligned digital seqs <ax>. <which> is XDIST_PAIRID, XDIST_DIFF, or
+ * XDIST_JUKESCANTOR. Cells $i<j$ and the diagonal are always set;
+ * if <D> is a full (<eslGENERAL>) matrix, cells $j>i$ are set too.
+ *
+ * The upper triangle is cut into <B>x<B> tiles, and each tile is
+ * done by one of <ncpu> threads (or by the caller, if <ncpu> <= 1 or
+ * we have no pthreads). A tile's <2B> rows are reused <B> times
+ * each, so <B> is chosen to keep them in cache.
+ *
+ * For nucleic alphabets (K=4), rows are first bit-sliced into an
+ * <ESL_DST_BITS>, three bits per column instead of eight, and
+ * compared 64 columns at a time with xbitcount().
+ *
+ * Returns <eslOK> on success. Returns <eslEINVAL> if the seqs have
+ * different lengths, <eslEDIVZERO> if a Jukes/Cantor pair has no
+ * aligned residues, and in either case <*ret_i>,<*ret_j> are the
+ * first (lowest <i>, then <j>) pair that failed. Returns <eslEMEM> or
+ * <eslESYS> (not thrown; caller throws) if threads can't be started.
+ */
+typedef struct {
+  const ESL_ALPHABET *abc;
+  ESL_DSQ           **ax;
+  int                 N;
+  int64_t             L;        // aligned length of all seqs
+  int                 which;    // XDIST_PAIRID | XDIST_DIFF | XDIST_JUKESCANTOR
+  ESL_DMATRIX        *D;
+  ESL_DMATRIX        *V;        // J/C variances, or NULL
+  ESL_DST_BITS       *bx;       // bit-sliced rows, for K=4; else NULL
+  int                 B;        // tile width, in seqs
+  int                 nb;       // number of tiles per side: ceil(N/B)
+  int                 ntiles;   // nb*(nb+1)/2 tiles in the upper triangle
+  int                 next;     // next tile to do, 0..ntiles-1
+  int                 fail_i;   // first failed pair (i,j), or -1
+  int                 fail_j;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t     mutex;    // protects <next>, <fail_i>, <fail_j>
+#endif
+} XDIST_JOB;
+
+static void
+xdist_tile(XDIST_JOB *job, int t)
+{
+  ESL_DSQ K = (ESL_DSQ) job->abc->K;
+  int     bi, bj;
+  int     i, j, iend, jend;
+  int     c1, c2, nboth, nid;
+  int     fail_i = -1, fail_j = -1;
+  double  pid;
+
+  /* tile <t> -> (bi,bj), bi <= bj, in row-major order */
+  for (bi = 0; t >= job->nb - bi; bi++) t -= job->nb - bi;
+  bj = bi + t;
+
+  iend = ESL_MIN(job->N, (bi+1) * job->B);
+  jend = ESL_MIN(job->N, (bj+1) * job->B);
+  for (i = bi * job->B; i < iend; i++)
+    for (j = ESL_MAX(i+1, bj * job->B); j < jend; j++)
+      {
+	if (job->bx)
+	  {
+	    xbitcount(job->bx->b + (int64_t) i * 3 * job->bx->W, job->bx->b + (int64_t) j * 3 * job->bx->W, job->bx->W, &nboth, &nid);
+	    c1 = job->bx->nres[i];
+	    c2 = job->bx->nres[j];
+	  }
+	else
+	  xcount(K, job->ax[i]+1, job->ax[j]+1, job->L, &c1, &c2, &nboth, &nid);
+	if (job->which == XDIST_JUKESCANTOR)
+	  {
+	    if (jukescantor(nid, nboth-nid, job->abc->K, &(job->D->mx[i][j]), &(job->V->mx[i][j])) != eslOK && fail_i == -1)
+	      { fail_i = i; fail_j = j; }
+	    if (job->V->type == eslGENERAL) job->V->mx[j][i] = job->V->mx[i][j];
+	  }
+	else
+	  {
+	    c1  = ESL_MIN(c1, c2);
+	    pid = (c1 == 0 ? 0. : (double) nid / (double) c1);
+	    job->D->mx[i][j] = (job->which == XDIST_DIFF ? 1. - pid : pid);
+	  }
+	if (job->D->type == eslGENERAL) job->D->mx[j][i] = job->D->mx[i][j];
+      }
+
+  if (fail_i != -1)
+    {
+#ifdef HAVE_PTHREAD
+      pthread_mutex_lock(&job->mutex);
+#endif
+      if (job->fail_i == -1 || fail_i < job->fail_i || (fail_i == job->fail_i && fail_j < job->fail_j))
+	{ job->fail_i = fail_i; job->fail_j = fail_j; }
+#ifdef HAVE_PTHREAD
+      pthread_mutex_unlock(&job->mutex);
+#endif
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static void
+xdist_thread(void *data)
+{
+  ESL_THREADS *thr = (ESL_THREADS *) data;
+  XDIST_JOB   *job;
+  int          w, t;
+
+  esl_threads_Started(thr, &w);
+  job = (XDIST_JOB *) esl_threads_GetData(thr, w);
+  while (1)
+    {
+      pthread_mutex_lock(&job->mutex);
+      t = job->next++;
+      pthread_mutex_unlock(&job->mutex);
+      if (t >= job->ntiles) break;
+      xdist_tile(job, t);
+    }
+  esl_threads_Finished(thr, w);
+}
+#endif
+
+static int
+xdist_matrix(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, int which, ESL_DMATRIX *D, ESL_DMATRIX *V, int *ret_i, int *ret_j)
+{
+  XDIST_JOB    job;
+#ifdef HAVE_PTHREAD
+  ESL_THREADS *thr = NULL;
+  int          w;
+#endif
+  int          i, t;
+  int64_t      rowbytes;
+  int          status;
+
+  *ret_i = *ret_j = -1;
+  job.abc    = abc;
+  job.ax     = ax;
+  job.N      = N;
+  job.L      = (N > 0 ? esl_abc_dsqlen(ax[0]) : 0);
+  job.which  = which;
+  job.D      = D;
+  job.V      = V;
+  job.bx     = NULL;
+  job.next   = 0;
+  job.fail_i = job.fail_j = -1;
+
+  for (i = 1; i < N; i++)
+    if (esl_abc_dsqlen(ax[i]) != job.L) { *ret_i = 0; *ret_j = i; return eslEINVAL; }
+
+  if (abc->K == 4 && N > 1 && (status = esl_dst_XBitEncode(abc, ax, N, &(job.bx))) != eslOK) return status;
+  rowbytes   = (job.bx ? job.bx->W * 3 * sizeof(uint64_t) : job.L);
+  job.B      = ESL_MAX(16, ESL_MIN(256, (int) (65536 / ESL_MAX(1, rowbytes))));
+  job.nb     = (N + job.B - 1) / job.B;
+  job.ntiles = job.nb * (job.nb + 1) / 2;
+
+  if (xcount == xcount_dispatcher) xcount_select();  // before any worker threads call it
+
+  for (i = 0; i < N; i++)
+    {
+      D->mx[i][i] = (which == XDIST_PAIRID ? 1. : 0.);
+      if (V) V->mx[i][i] = 0.;
+    }
+
+#ifdef HAVE_PTHREAD
+  if (ncpu > 1 && job.ntiles > 1)
+    {
+      if (pthread_mutex_init(&job.mutex, NULL) != 0) { esl_dst_bits_Destroy(job.bx); return eslESYS; }
+      if ((thr = esl_threads_Create(&xdist_thread)) == NULL) { pthread_mutex_destroy(&job.mutex); esl_dst_bits_Destroy(job.bx); return eslEMEM; }
+      for (w = 0; w < ESL_MIN(ncpu, job.ntiles); w++)
+	if (esl_threads_AddThread(thr, &job) != eslOK) break;
+      if (w == 0) { esl_threads_Destroy(thr); pthread_mutex_destroy(&job.mutex); esl_dst_bits_Destroy(job.bx); return eslESYS; }
+      esl_threads_WaitForStart (thr);
+      esl_threads_WaitForFinish(thr);
+      esl_threads_Destroy(thr);
+      pthread_mutex_destroy(&job.mutex);
+    }
+  else
+#endif
+    {
+#ifdef HAVE_PTHREAD
+      pthread_mutex_init(&job.mutex, NULL);
+#endif
+      for (t = 0; t < job.ntiles; t++) xdist_tile(&job, t);
+#ifdef HAVE_PTHREAD
+      pthread_mutex_destroy(&job.mutex);
+#endif
+    }
+
+  esl_dst_bits_Destroy(job.bx);
+  if (job.fail_i != -1) { *ret_i = job.fail_i; *ret_j = job.fail_j; return eslEDIVZERO; }
+  return eslOK;
+}
 /*--------------- end of private functions ----------------------*/
 
 
@@ -1402,6 +1981,217 @@ utest_XJukesCantorMx(ESL_ALPHABET *abc, char **as, ESL_DSQ **ax, int N)
   esl_dmatrix_Destroy(V2);
   return eslOK;
 }
+
+/* utest_XUpper()
+ * The tiled, threaded packed-upper versions must give exactly the
+ * same cells as the full serial matrices. Uses its own alignment,
+ * big enough to span several tiles.
+ */
+static void
+utest_XUpper(ESL_RANDOMNESS *r, int abctype, int N, int L)
+{
+  char          msg[] = "XUpper unit test failed";
+  ESL_ALPHABET *abc   = esl_alphabet_Create(abctype);
+  ESL_DSQ     **ax    = malloc(sizeof(ESL_DSQ *) * N);
+  ESL_DMATRIX  *S = NULL, *D = NULL, *V = NULL;
+  ESL_DMATRIX  *S2, *D2, *V2;
+  int           ncpu[2] = { 1, 4 };
+  int           i, j, c, pos;
+
+  if (!abc || !ax) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    {
+      if ((ax[i] = malloc(sizeof(ESL_DSQ) * (L+2))) == NULL) esl_fatal(msg);
+      ax[i][0] = ax[i][L+1] = eslDSQ_SENTINEL;
+      for (pos = 1; pos <= L; pos++)
+	ax[i][pos] = (i > 0 && esl_rnd_Roll(r, 2) ? ax[i-1][pos] : esl_rnd_Roll(r, abc->K+1));  // canonicals or gap
+    }
+
+  if (esl_dst_XPairIdMx     (abc, ax, N, &S)     != eslOK) esl_fatal(msg);
+  if (esl_dst_XDiffMx       (abc, ax, N, &D)     != eslOK) esl_fatal(msg);
+  if (esl_dst_XJukesCantorMx(abc, ax, N, NULL, &V) != eslOK) esl_fatal(msg);
+
+  for (c = 0; c < 2; c++)
+    {
+      if (esl_dst_XPairIdUpper     (abc, ax, N, ncpu[c], &S2)     != eslOK) esl_fatal(msg);
+      if (esl_dst_XDiffUpper       (abc, ax, N, ncpu[c], &D2)     != eslOK) esl_fatal(msg);
+      if (esl_dst_XJukesCantorUpper(abc, ax, N, ncpu[c], NULL, &V2) != eslOK) esl_fatal(msg);
+      if (S2->type != eslUPPER || D2->type != eslUPPER || V2->type != eslUPPER) esl_fatal(msg);
+
+      for (i = 0; i < N; i++)
+	for (j = i; j < N; j++)
+	  {
+	    if (S2->mx[i][j] != S->mx[i][j] || S->mx[j][i] != S->mx[i][j]) esl_fatal(msg);
+	    if (D2->mx[i][j] != D->mx[i][j] || D->mx[j][i] != D->mx[i][j]) esl_fatal(msg);
+	    if (V2->mx[i][j] != V->mx[i][j] || V->mx[j][i] != V->mx[i][j]) esl_fatal(msg);
+	  }
+      esl_dmatrix_Destroy(S2);
+      esl_dmatrix_Destroy(D2);
+      esl_dmatrix_Destroy(V2);
+    }
+
+  esl_dmatrix_Destroy(S);
+  esl_dmatrix_Destroy(D);
+  esl_dmatrix_Destroy(V);
+  for (i = 0; i < N; i++) free(ax[i]);
+  free(ax);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_bits()
+ * Bit-sliced rows must give exactly the same identities as
+ * esl_dst_XPairId(), including rows with degenerate residues and
+ * lengths that aren't a multiple of 64; and the matrix functions,
+ * which use bit-slicing internally for K=4, must match the pairwise
+ * functions.
+ */
+static void
+utest_bits(ESL_RANDOMNESS *r, int abctype)
+{
+  char          msg[] = "bits unit test failed";
+  ESL_ALPHABET *abc   = esl_alphabet_Create(abctype);
+  int           N     = 20;
+  int           L     = 64 + esl_rnd_Roll(r, 300);
+  ESL_DSQ     **ax    = malloc(sizeof(ESL_DSQ *) * N);
+  ESL_DST_BITS *bx    = NULL;
+  ESL_DMATRIX  *S     = NULL;
+  ESL_DMATRIX  *D     = NULL;
+  double        pid, pid2, jc;
+  int           nid, nid2, n, n2;
+  int           cb, cb2, ci, ci2;
+  int           i, j, pos;
+
+  if (!abc || !ax) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    {
+      if ((ax[i] = malloc(sizeof(ESL_DSQ) * (L+2))) == NULL) esl_fatal(msg);
+      ax[i][0] = ax[i][L+1] = eslDSQ_SENTINEL;
+      for (pos = 1; pos <= L; pos++)
+	ax[i][pos] = (i > 0 && esl_rnd_Roll(r, 2) ? ax[i-1][pos] : (esl_rnd_Roll(r, 4) ? esl_rnd_Roll(r, abc->K) : esl_rnd_Roll(r, abc->Kp)));
+    }
+
+  if (esl_dst_XBitEncode(abc, ax, N, &bx)             != eslOK) esl_fatal(msg);
+  if (esl_dst_XPairIdMx(abc, ax, N, &S)               != eslOK) esl_fatal(msg);
+  if (esl_dst_XJukesCantorUpper(abc, ax, N, 1, &D, NULL) != eslOK) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      {
+	if (esl_dst_XPairId  (abc, ax[i], ax[j], &pid, &nid, &n) != eslOK) esl_fatal(msg);
+	if (esl_dst_BitPairId(bx, i, j, &pid2, &nid2, &n2)       != eslOK) esl_fatal(msg);
+	if (pid != pid2 || nid != nid2 || n != n2)                         esl_fatal(msg);
+	if (i != j && S->mx[i][j] != pid)                                  esl_fatal(msg);
+	if (i < j) {
+	  if (esl_dst_XJukesCantor(abc, ax[i], ax[j], &jc, NULL) != eslOK) esl_fatal(msg);
+	  if (D->mx[i][j] != jc)                                           esl_fatal(msg);
+	}
+
+	xbitcount_serial(bx->b + i*3*bx->W, bx->b + j*3*bx->W, bx->W, &cb, &ci);
+#ifdef eslENABLE_AVX
+	if (esl_cpu_has_avx()) {
+	  esl_dst_xbitcount_avx(bx->b + i*3*bx->W, bx->b + j*3*bx->W, bx->W, &cb2, &ci2);
+	  if (cb != cb2 || ci != ci2) esl_fatal(msg);
+	}
+#endif
+	if (ci != nid) esl_fatal(msg);
+      }
+
+  esl_dmatrix_Destroy(S);
+  esl_dmatrix_Destroy(D);
+  esl_dst_bits_Destroy(bx);
+  for (i = 0; i < N; i++) free(ax[i]);
+  free(ax);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_xcount()
+ * The vector xcount() kernels must give exactly the same counts as
+ * xcount_serial(), and XPairId()/XPairMatch() the same answers as the
+ * original column-by-column loops, on rows of any length containing
+ * any residue codes (gaps, degeneracies, '*', '~'). XPairIdL() must
+ * agree with XPairId().
+ */
+static void
+utest_xcount(ESL_RANDOMNESS *r, int abctype)
+{
+  char          msg[] = "xcount unit test failed";
+  ESL_ALPHABET *abc   = esl_alphabet_Create(abctype);
+  int           maxn  = 300;
+  ESL_DSQ      *ax1   = malloc(sizeof(ESL_DSQ) * (maxn+2));
+  ESL_DSQ      *ax2   = malloc(sizeof(ESL_DSQ) * (maxn+2));
+  int           c[4], c0[4];
+  int           nid, nid0, nmatch, nmatch0, len, len1, len2;
+  double        pid, pid2;
+  int           n, n2, i, trial;
+
+  if (!abc || !ax1 || !ax2) esl_fatal(msg);
+
+  for (trial = 0; trial < 200; trial++)
+    {
+      n = esl_rnd_Roll(r, maxn+1);
+      ax1[0] = ax2[0] = ax1[n+1] = ax2[n+1] = eslDSQ_SENTINEL;
+      for (i = 1; i <= n; i++)
+        {
+          ax1[i] = (esl_rnd_Roll(r, 2) ? esl_rnd_Roll(r, abc->K) : esl_rnd_Roll(r, abc->Kp));
+          ax2[i] = (esl_rnd_Roll(r, 2) ? ax1[i]                  : esl_rnd_Roll(r, abc->Kp));
+        }
+
+      xcount_serial(abc->K, ax1+1, ax2+1, n, &c0[0], &c0[1], &c0[2], &c0[3]);
+#ifdef eslENABLE_SSE
+      if (esl_cpu_has_sse()) {
+        esl_dst_xcount_sse(abc->K, ax1+1, ax2+1, n, &c[0], &c[1], &c[2], &c[3]);
+        if (memcmp(c, c0, sizeof(int) * 4) != 0) esl_fatal(msg);
+      }
+#endif
+#ifdef eslENABLE_AVX
+      if (esl_cpu_has_avx()) {
+        esl_dst_xcount_avx(abc->K, ax1+1, ax2+1, n, &c[0], &c[1], &c[2], &c[3]);
+        if (memcmp(c, c0, sizeof(int) * 4) != 0) esl_fatal(msg);
+      }
+#endif
+#ifdef eslENABLE_AVX512
+      if (esl_cpu_has_avx512()) {
+        esl_dst_xcount_avx512(abc->K, ax1+1, ax2+1, n, &c[0], &c[1], &c[2], &c[3]);
+        if (memcmp(c, c0, sizeof(int) * 4) != 0) esl_fatal(msg);
+      }
+#endif
+
+      nid0 = nmatch0 = len1 = len2 = len = 0;
+      for (i = 1; i <= n; i++)
+        {
+          if (esl_abc_XIsCanonical(abc, ax1[i])) len1++;
+          if (esl_abc_XIsCanonical(abc, ax2[i])) len2++;
+          if (esl_abc_XIsCanonical(abc, ax1[i]) || esl_abc_XIsCanonical(abc, ax2[i])) len++;
+          if (esl_abc_XIsCanonical(abc, ax1[i]) && esl_abc_XIsCanonical(abc, ax2[i])) {
+            nmatch0++;
+            if (ax1[i] == ax2[i]) nid0++;
+          }
+        }
+
+      if (esl_dst_XPairId(abc, ax1, ax2, &pid, &nid, &i) != eslOK)         esl_fatal(msg);
+      if (nid != nid0 || i != ESL_MIN(len1, len2))                          esl_fatal(msg);
+      if (pid != (i == 0 ? 0. : (double) nid0 / (double) i))                esl_fatal(msg);
+      if (esl_dst_XPairIdL(abc, ax1, ax2, n, &pid2, &nid, &n2) != eslOK)   esl_fatal(msg);
+      if (pid2 != pid || nid != nid0 || n2 != i)                            esl_fatal(msg);
+      if (esl_dst_XPairMatch(abc, ax1, ax2, &pid, &nmatch, &i) != eslOK)   esl_fatal(msg);
+      if (nmatch != nmatch0 || i != len)                                    esl_fatal(msg);
+    }
+
+  /* Unaligned (different length) rows are still an error. */
+  if (n > 0) {
+    ax1[n] = eslDSQ_SENTINEL;
+#ifdef eslTEST_THROWING
+    esl_exception_SetHandler(&esl_nonfatal_handler);
+    if (esl_dst_XPairId   (abc, ax1, ax2, &pid, &nid, &i)    != eslEINVAL) esl_fatal(msg);
+    if (esl_dst_XPairMatch(abc, ax1, ax2, &pid, &nmatch, &i) != eslEINVAL) esl_fatal(msg);
+    esl_exception_ResetDefaultHandler();
+#endif
+  }
+
+  free(ax1);
+  free(ax2);
+  esl_alphabet_Destroy(abc);
+}
+
 #endif /* eslDISTANCE_TESTDRIVE */
 /*------------------ end of unit tests --------------------------*/
 
@@ -1503,6 +2293,12 @@ main(int argc, char **argv)
   if (utest_XPairIdMx(abc, as, ax, N)       != eslOK) return eslFAIL;
   if (utest_XDiffMx(abc, as, ax, N)         != eslOK) return eslFAIL;
   if (utest_XJukesCantorMx(abc, as, ax, N)  != eslOK) return eslFAIL;
+  utest_xcount(r, eslDNA);
+  utest_XUpper(r, eslDNA,   600, 400);
+  utest_XUpper(r, eslAMINO, 300, 200);
+  utest_bits(r, eslDNA);
+  utest_bits(r, eslRNA);
+  utest_xcount(r, eslAMINO);
 
 
   esl_randomness_Destroy(r);
@@ -12,6 +12,21 @@
 #include "esl_dmatrix.h"	
 #include "esl_random.h"  
 
+/* ESL_DST_BITS
+ * Bit-sliced encoding of an aligned digital nucleic acid alignment
+ * (alphabet size K=4), for fast pairwise identity. Each row is W
+ * triplets of 64-bit words, one triplet per 64 columns: low bit of
+ * the residue code, high bit, and a mask of canonical residues.
+ * Noncanonical columns (gaps, degeneracies) are 0 in all three.
+ */
+typedef struct {
+  int       N;         // number of rows (seqs)
+  int64_t   L;         // aligned length
+  int64_t   W;         // 64-column words per row: ceil(L/64)
+  uint64_t *b;         // row <idx> is b[idx*3*W .. (idx+1)*3*W - 1]
+  int      *nres;      // number of canonical residues in each row, [0..N-1]
+} ESL_DST_BITS;
+
 /* 1. Pairwise distances for aligned text sequences.
  */
 extern int esl_dst_CPairId(const char *asq1, const char *asq2, 
@@ -25,6 +40,8 @@ extern int esl_dst_CJukesCantor(int K, const char *as1, const char *as2,
  */
 extern int esl_dst_XPairId(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2, 
 			   double *opt_pid, int *opt_nid, int *opt_n);
+extern int esl_dst_XPairIdL(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t L,
+			    double *opt_pid, int *opt_nid, int *opt_n);
 extern int esl_dst_XPairMatch(const ESL_ALPHABET *abc, const ESL_DSQ *ax1, const ESL_DSQ *ax2, 
 			      double *opt_distance, int *opt_nmatch, int *opt_n);
 extern int esl_dst_XJukesCantor(const ESL_ALPHABET *abc, const ESL_DSQ *ax, const ESL_DSQ *ay, 
@@ -44,6 +61,15 @@ extern int esl_dst_XDiffMx  (const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, ESL_D
 extern int esl_dst_XJukesCantorMx(const ESL_ALPHABET *abc, ESL_DSQ **ax, int nseq, 
 				  ESL_DMATRIX **opt_D, ESL_DMATRIX **opt_V);
 
+extern int esl_dst_XPairIdUpper     (const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, ESL_DMATRIX **ret_S);
+extern int esl_dst_XDiffUpper       (const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int ncpu, ESL_DMATRIX **ret_D);
+extern int esl_dst_XJukesCantorUpper(const ESL_ALPHABET *abc, ESL_DSQ **ax, int nseq, int ncpu,
+				     ESL_DMATRIX **opt_D, ESL_DMATRIX **opt_V);
+
+extern int  esl_dst_XBitEncode(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, ESL_DST_BITS **ret_bx);
+extern int  esl_dst_BitPairId (const ESL_DST_BITS *bx, int i, int j, double *opt_pid, int *opt_nid, int *opt_n);
+extern void esl_dst_bits_Destroy(ESL_DST_BITS *bx);
+
 /*  5. Average pairwise identity for multiple alignments.
  */
 extern int esl_dst_CAverageId   (char **as, int nseq, int max_comparisons, double *ret_id);
@@ -52,5 +78,20 @@ extern int esl_dst_CAverageMatch(char **as, int N, int max_comparisons, double *
 extern int esl_dst_XAverageId   (const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int max_comparisons, double *ret_id);
 extern int esl_dst_XAverageMatch(const ESL_ALPHABET *abc, ESL_DSQ **ax, int N, int max_comparisons, double *ret_match);
 
+/* Vectorized residue/identity counting kernels, selected at runtime
+ * by esl_dst_XPairId() and esl_dst_XPairMatch(), and for ESL_DST_BITS
+ * rows: esl_distance_{sse,avx,avx512}.c
+ */
+#ifdef eslENABLE_SSE
+extern void esl_dst_xcount_sse   (ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid);
+#endif
+#ifdef eslENABLE_AVX
+extern void esl_dst_xcount_avx   (ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid);
+extern void esl_dst_xbitcount_avx(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid);
+#endif
+#ifdef eslENABLE_AVX512
+extern void esl_dst_xcount_avx512(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n, int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid);
+#endif
+
 #endif /*eslDISTANCE_INCLUDED*/
 
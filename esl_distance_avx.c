@@ -0,0 +1,93 @@
+/* Pairwise identity counting for aligned digital seqs: AVX2 implementation.
+ *
+ * The dispatcher in esl_distance.c calls these for <esl_dst_XPairId()>,
+ * <esl_dst_XPairMatch()>, and bit-sliced <ESL_DST_BITS> rows when the
+ * processor supports AVX2.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_distance.h"
+
+/* Function:  esl_dst_xcount_avx()
+ * Synopsis:  Count canonical residues and identities in two aligned rows, AVX2 version.
+ *
+ * Purpose:   Same as <esl_dst_xcount_sse()>, 32 columns at a time.
+ */
+void
+esl_dst_xcount_avx(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n,
+                   int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid)
+{
+  __m256i Km1 = _mm256_set1_epi8((char) (K-1));
+  __m256i x1, x2, m1, m2, mb;
+  int     c1 = 0, c2 = 0, cb = 0, cid = 0;
+  int64_t i;
+
+  for (i = 0; i + 32 <= n; i += 32)
+    {
+      x1 = _mm256_loadu_si256((const __m256i *) (ax1+i));
+      x2 = _mm256_loadu_si256((const __m256i *) (ax2+i));
+      m1 = _mm256_cmpeq_epi8(_mm256_min_epu8(x1, Km1), x1);
+      m2 = _mm256_cmpeq_epi8(_mm256_min_epu8(x2, Km1), x2);
+      mb = _mm256_and_si256(m1, m2);
+
+      c1  += __builtin_popcount((unsigned int) _mm256_movemask_epi8(m1));
+      c2  += __builtin_popcount((unsigned int) _mm256_movemask_epi8(m2));
+      cb  += __builtin_popcount((unsigned int) _mm256_movemask_epi8(mb));
+      cid += __builtin_popcount((unsigned int) _mm256_movemask_epi8(_mm256_and_si256(mb, _mm256_cmpeq_epi8(x1, x2))));
+    }
+
+  for ( ; i < n; i++)
+    {
+      if (ax1[i] < K) c1++;
+      if (ax2[i] < K) c2++;
+      if (ax1[i] < K && ax2[i] < K) { cb++; if (ax1[i] == ax2[i]) cid++; }
+    }
+
+  *ret_c1    = c1;
+  *ret_c2    = c2;
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+
+/* Function:  esl_dst_xbitcount_avx()
+ * Synopsis:  Count aligned canonical pairs and identities in two bit-sliced rows.
+ *
+ * Purpose:   Given two <ESL_DST_BITS> rows <r1>, <r2> of <W> 64-column
+ *            (lo, hi, canonical) word triplets, count the columns
+ *            where both residues are canonical (<*ret_cboth>), and
+ *            where they are also identical (<*ret_cid>).
+ *
+ *            Same code as xbitcount_serial() in esl_distance.c. It's
+ *            here because every AVX2 processor has the POPCNT
+ *            instruction, and these compiler flags let us use it.
+ */
+void
+esl_dst_xbitcount_avx(const uint64_t *r1, const uint64_t *r2, int64_t W, int *ret_cboth, int *ret_cid)
+{
+  uint64_t both;
+  int      cb = 0, cid = 0;
+  int64_t  w;
+
+  for (w = 0; w < 3*W; w += 3)
+    {
+      both = r1[w+2] & r2[w+2];
+      cb  += __builtin_popcountll(both);
+      cid += __builtin_popcountll(both & ~((r1[w] ^ r2[w]) | (r1[w+1] ^ r2[w+1])));
+    }
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+#else // ! eslENABLE_AVX
+void esl_distance_avx_silence_hack(void) { return; }
+#endif // eslENABLE_AVX or not
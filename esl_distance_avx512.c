@@ -0,0 +1,61 @@
+/* Pairwise identity counting for aligned digital seqs: AVX-512 implementation.
+ *
+ * The dispatcher in esl_distance.c calls this for <esl_dst_XPairId()>
+ * and <esl_dst_XPairMatch()> when the processor supports AVX-512BW.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX512>
+ * was set in <esl_config.h> by the configure script. Otherwise we
+ * include dummy code to silence compiler and ranlib warnings about
+ * empty translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX512
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_distance.h"
+
+/* Function:  esl_dst_xcount_avx512()
+ * Synopsis:  Count canonical residues and identities in two aligned rows, AVX-512 version.
+ *
+ * Purpose:   Same as <esl_dst_xcount_sse()>, 64 columns at a time.
+ *            AVX-512BW compares produce bit masks directly, so no
+ *            movemask is needed, and the ragged end is done with a
+ *            masked load (which can't fault on bytes past <n>)
+ *            instead of a serial loop.
+ */
+void
+esl_dst_xcount_avx512(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n,
+                      int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid)
+{
+  __m512i   Kv = _mm512_set1_epi8((char) K);
+  __m512i   x1, x2;
+  __mmask64 live, m1, m2, mb;
+  int       c1 = 0, c2 = 0, cb = 0, cid = 0;
+  int64_t   i;
+
+  for (i = 0; i < n; i += 64)
+    {
+      live = (n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1);
+      x1   = _mm512_maskz_loadu_epi8(live, ax1+i);
+      x2   = _mm512_maskz_loadu_epi8(live, ax2+i);
+      m1   = _mm512_mask_cmplt_epu8_mask(live, x1, Kv);
+      m2   = _mm512_mask_cmplt_epu8_mask(live, x2, Kv);
+      mb   = m1 & m2;
+
+      c1  += __builtin_popcountll(m1);
+      c2  += __builtin_popcountll(m2);
+      cb  += __builtin_popcountll(mb);
+      cid += __builtin_popcountll(_mm512_mask_cmpeq_epi8_mask(mb, x1, x2));
+    }
+
+  *ret_c1    = c1;
+  *ret_c2    = c2;
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+#else // ! eslENABLE_AVX512
+void esl_distance_avx512_silence_hack(void) { return; }
+#endif // eslENABLE_AVX512 or not
@@ -0,0 +1,73 @@
+/* Pairwise identity counting for aligned digital seqs: SSE implementation.
+ *
+ * The dispatcher in esl_distance.c calls this for <esl_dst_XPairId()>
+ * and <esl_dst_XPairMatch()> when the processor supports SSE2.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_SSE> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_SSE
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_distance.h"
+
+/* Function:  esl_dst_xcount_sse()
+ * Synopsis:  Count canonical residues and identities in two aligned rows, SSE version.
+ *
+ * Purpose:   Given two aligned digital rows <ax1>, <ax2> of <n>
+ *            residues each, indexed <0..n-1> (i.e. the caller passes
+ *            <ax+1>), in an alphabet with <K> canonical residues,
+ *            count the columns where <ax1> is canonical (<*ret_c1>),
+ *            where <ax2> is canonical (<*ret_c2>), where both are
+ *            (<*ret_cboth>), and where both are canonical and
+ *            identical (<*ret_cid>).
+ *
+ *            16 columns are compared at a time. A residue code <x> is
+ *            canonical iff <x < K>, i.e. iff <min(x, K-1) == x>
+ *            (unsigned); each compare mask is reduced with movemask
+ *            and popcount.
+ */
+void
+esl_dst_xcount_sse(ESL_DSQ K, const ESL_DSQ *ax1, const ESL_DSQ *ax2, int64_t n,
+                   int *ret_c1, int *ret_c2, int *ret_cboth, int *ret_cid)
+{
+  __m128i Km1 = _mm_set1_epi8((char) (K-1));
+  __m128i x1, x2, m1, m2, mb;
+  int     c1 = 0, c2 = 0, cb = 0, cid = 0;
+  int64_t i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      x1 = _mm_loadu_si128((const __m128i *) (ax1+i));
+      x2 = _mm_loadu_si128((const __m128i *) (ax2+i));
+      m1 = _mm_cmpeq_epi8(_mm_min_epu8(x1, Km1), x1);
+      m2 = _mm_cmpeq_epi8(_mm_min_epu8(x2, Km1), x2);
+      mb = _mm_and_si128(m1, m2);
+
+      c1  += __builtin_popcount(_mm_movemask_epi8(m1));
+      c2  += __builtin_popcount(_mm_movemask_epi8(m2));
+      cb  += __builtin_popcount(_mm_movemask_epi8(mb));
+      cid += __builtin_popcount(_mm_movemask_epi8(_mm_and_si128(mb, _mm_cmpeq_epi8(x1, x2))));
+    }
+
+  for ( ; i < n; i++)
+    {
+      if (ax1[i] < K) c1++;
+      if (ax2[i] < K) c2++;
+      if (ax1[i] < K && ax2[i] < K) { cb++; if (ax1[i] == ax2[i]) cid++; }
+    }
+
+  *ret_c1    = c1;
+  *ret_c2    = c2;
+  *ret_cboth = cb;
+  *ret_cid   = cid;
+}
+
+#else // ! eslENABLE_SSE
+void esl_distance_sse_silence_hack(void) { return; }
+#endif // eslENABLE_SSE or not
@@ -7,12 +7,26 @@
 #include <string.h>
 
 #include "easel.h"
+#include "esl_alloc.h"
 #include "esl_alphabet.h"
+#include "esl_cpu.h"
+#include "esl_quicksort.h"
 #include "esl_random.h"
 #include "esl_vectorops.h"
 
 #include "esl_hmm.h"
 
+static int hmm_configure(ESL_HMM *hmm, float *fq, int simd);
+static int hmm_vectorize(ESL_HMM *hmm, int simd);
+static int hmx_vscratch(ESL_HMX *mx, uint64_t need, float **ret_mem);
+static int hmx_vrows(ESL_HMX *mx, const ESL_HMM *hmm, int n, float **row);
+static int hmm_batch_grow (ESL_HMM_BATCH *bat, int n);
+static int hmm_batch_score(ESL_HMM_BATCH *bat, float *opt_sc);
+static int hmm_batch_range(ESL_HMM_BATCH *bat, ESL_HMX *mx, int p0, int p1);
+#ifdef HAVE_PTHREAD
+static void hmm_batch_thread(void *arg);
+#endif
+
 
 /* Function:  esl_hmm_Create()
  * Synopsis:  Allocates a new HMM.
@@ -38,6 +52,16 @@ esl_hmm_Create(const ESL_ALPHABET *abc, int M)
   hmm->eo = NULL;
   hmm->pi = NULL;
 
+  hmm->simd = eslHMM_SERIAL;
+  hmm->V    = 0;
+  hmm->Mp   = 0;
+  hmm->nd   = 0;
+  hmm->dlo  = hmm->dhi = 0;
+  hmm->pad  = 0;
+  hmm->tv   = NULL;
+  hmm->tvT  = NULL;
+  hmm->eov  = NULL;
+
   ESL_ALLOC(hmm->t,  sizeof(float *) * M);           hmm->t[0]  = NULL;
   ESL_ALLOC(hmm->e,  sizeof(float *) * M);           hmm->e[0]  = NULL;
   ESL_ALLOC(hmm->eo, sizeof(float *) * abc->Kp);     hmm->eo[0] = NULL;
@@ -70,7 +94,8 @@ esl_hmm_Create(const ESL_ALPHABET *abc, int M)
  * Synopsis:  Duplicate an HMM.
  *
  * Purpose:   Make a newly allocated duplicate of the HMM <hmm>,
- *            and return a pointer to the duplicate.
+ *            and return a pointer to the duplicate, including its
+ *            vector layout, if it has one.
  *
  * Throws:    <NULL> on allocation failure.
  */
@@ -92,6 +117,8 @@ esl_hmm_Clone(const ESL_HMM *hmm)
       memcpy(dup->eo[x], hmm->eo[x], sizeof(float) * (hmm->M));
     }
   memcpy(dup->pi, hmm->pi, sizeof(float) * (hmm->M+1));
+
+  if (hmm_vectorize(dup, hmm->simd) != eslOK) { esl_hmm_Destroy(dup); return NULL; }
   return dup;
 }
 
@@ -110,12 +137,40 @@ esl_hmm_Clone(const ESL_HMM *hmm)
  *            If <fq> is <NULL>, uniform background frequencies are
  *            used ($\frac{1}{K}$, for alphabet size $K$).
  *
+ *            Also lay out the transitions and emission odds for the
+ *            best vector implementation of Forward/Backward that
+ *            this processor supports (AVX2 or SSE), if any: padded,
+ *            aligned, and transposed for Backward. If the nonzero
+ *            transitions among states lie on few diagonals (a
+ *            left-right or banded model), only those diagonals are
+ *            stored and computed. Because of these copies, the
+ *            <hmm> must be configured again after its transitions
+ *            or emissions change.
+ *
  * Returns:   <eslOK> on success.
  *
- * Throws:    (no abnormal error conditions)
+ * Throws:    <eslEMEM> on allocation failure.
  */
 int
 esl_hmm_Configure(ESL_HMM *hmm, float *fq)
+{
+  int simd = eslHMM_SERIAL;
+
+#ifdef eslENABLE_SSE
+  if (esl_cpu_has_sse()) simd = eslHMM_SSE;
+#endif
+#ifdef eslENABLE_AVX
+  if (esl_cpu_has_avx()) simd = eslHMM_AVX;
+#endif
+  return hmm_configure(hmm, fq, simd);
+}
+
+/* hmm_configure()
+ * esl_hmm_Configure(), with the vector implementation <simd>
+ * chosen by the caller (the unit tests try each one).
+ */
+static int
+hmm_configure(ESL_HMM *hmm, float *fq, int simd)
 {
   int   Kp = hmm->abc->Kp;
   int   K  = hmm->abc->K;
@@ -151,7 +206,82 @@ esl_hmm_Configure(ESL_HMM *hmm, float *fq)
 	hmm->eo[x][k] = ((denom > 0.0f) ? hmm->eo[x][k] / denom : 0.0f);
       }
   }
+  return hmm_vectorize(hmm, simd);
+}
+
+/* hmm_vectorize()
+ * Make <hmm>'s vector layout for implementation <simd>, replacing
+ * any previous one; see ESL_HMM in esl_hmm.h. The transitions are
+ * stored by diagonal if their nonzero entries fall on no more than
+ * M/2 diagonals, else as dense rows.
+ */
+static int
+hmm_vectorize(ESL_HMM *hmm, int simd)
+{
+  int M  = hmm->M;
+  int Kp = hmm->abc->Kp;
+  int V, Mp, dlo, dhi, nd;
+  int d, k, m, x;
+  int status;
+
+  esl_alloc_free(hmm->tv);   hmm->tv  = NULL;
+  esl_alloc_free(hmm->tvT);  hmm->tvT = NULL;
+  esl_alloc_free(hmm->eov);  hmm->eov = NULL;
+  hmm->simd = eslHMM_SERIAL;
+  hmm->V    = hmm->Mp  = 0;
+  hmm->nd   = hmm->pad = 0;
+  hmm->dlo  = hmm->dhi = 0;
+  if (simd == eslHMM_SERIAL) return eslOK;
+
+  V   = (simd == eslHMM_AVX ? 8 : 4);
+  Mp  = ESL_UPROUND(M, V);
+  dlo = M;
+  dhi = -M;
+  for (m = 0; m < M; m++)
+    for (k = 0; k < M; k++)
+      if (hmm->t[m][k] != 0.0f) { dlo = ESL_MIN(dlo, k-m); dhi = ESL_MAX(dhi, k-m); }
+  if (dlo > dhi) dlo = dhi = 0;
+  nd = (2 * (dhi-dlo+1) <= M ? dhi-dlo+1 : 0);
+
+  if ((hmm->tv  = esl_alloc_aligned(sizeof(float) * (nd ? nd : M) * Mp, 32)) == NULL) ESL_XEXCEPTION(eslEMEM, "allocation failed");
+  if ((hmm->tvT = esl_alloc_aligned(sizeof(float) * (nd ? nd : M) * Mp, 32)) == NULL) ESL_XEXCEPTION(eslEMEM, "allocation failed");
+  if ((hmm->eov = esl_alloc_aligned(sizeof(float) * Kp * Mp,            32)) == NULL) ESL_XEXCEPTION(eslEMEM, "allocation failed");
+  esl_vec_FSet(hmm->tv,  (nd ? nd : M) * Mp, 0.0f);
+  esl_vec_FSet(hmm->tvT, (nd ? nd : M) * Mp, 0.0f);
+  esl_vec_FSet(hmm->eov, Kp * Mp,            0.0f);
+
+  if (nd)
+    {
+      for (d = dlo; d <= dhi; d++)
+	for (k = 0; k < M; k++)
+	  {
+	    if (k-d >= 0 && k-d < M) hmm->tv [(d-dlo)*Mp + k] = hmm->t[k-d][k];
+	    if (k+d >= 0 && k+d < M) hmm->tvT[(d-dlo)*Mp + k] = hmm->t[k][k+d];
+	  }
+    }
+  else
+    {
+      for (m = 0; m < M; m++)
+	for (k = 0; k < M; k++)
+	  {
+	    hmm->tv [m*Mp + k] = hmm->t[m][k];
+	    hmm->tvT[m*Mp + k] = hmm->t[k][m];
+	  }
+    }
+  for (x = 0; x < Kp; x++)
+    esl_vec_FCopy(hmm->eo[x], M, hmm->eov + x*Mp);
+
+  hmm->simd = simd;
+  hmm->V    = V;
+  hmm->Mp   = Mp;
+  hmm->nd   = nd;
+  hmm->dlo  = (nd ? dlo : 0);
+  hmm->dhi  = (nd ? dhi : 0);
+  hmm->pad  = (nd ? ESL_UPROUND(ESL_MAX(dhi, -dlo), V) : 0);
   return eslOK;
+
+ ERROR:
+  return status;
 }
 
 
@@ -178,6 +308,9 @@ esl_hmm_Destroy(ESL_HMM *hmm)
     free(hmm->eo);
   }
   if (hmm->pi != NULL) free(hmm->pi);
+  esl_alloc_free(hmm->tv);
+  esl_alloc_free(hmm->tvT);
+  esl_alloc_free(hmm->eov);
   free(hmm);
   return;
 }
@@ -194,6 +327,8 @@ esl_hmx_Create(int allocL, int allocM)
   mx->dp_mem = NULL;
   mx->dp     = NULL;
   mx->sc     = NULL;
+  mx->vmem   = NULL;
+  mx->nvcells = 0;
 
   ESL_ALLOC(mx->dp_mem, sizeof(float) * (allocL+1) * allocM);
   mx->ncells = (allocL+1) * allocM;
@@ -282,11 +417,53 @@ esl_hmx_Destroy(ESL_HMX *mx)
   if (mx->dp_mem != NULL) free(mx->dp_mem);
   if (mx->dp     != NULL) free(mx->dp);
   if (mx->sc     != NULL) free(mx->sc);
+  esl_alloc_free(mx->vmem);
   free(mx);
   return;
 }
 
 
+/* hmx_vscratch()
+ * Return <mx>'s vector scratch space in <*ret_mem>: at least <need>
+ * floats, 32-byte aligned, contents undefined. Reallocates if needed.
+ */
+static int
+hmx_vscratch(ESL_HMX *mx, uint64_t need, float **ret_mem)
+{
+  if (need > mx->nvcells)
+    {
+      esl_alloc_free(mx->vmem);
+      mx->nvcells = 0;
+      if ((mx->vmem = esl_alloc_aligned(sizeof(float) * need, 32)) == NULL) ESL_EXCEPTION(eslEMEM, "allocation failed");
+      mx->nvcells = need;
+    }
+  *ret_mem = mx->vmem;
+  return eslOK;
+}
+
+/* hmx_vrows()
+ * Set <row[0..n-1]> to <n> zeroed DP rows in <mx>'s vector scratch
+ * space, laid out for <hmm>: <hmm->Mp> floats each, aligned, with
+ * <hmm->pad> zeros on both sides; or <hmm->M> floats, if <hmm> has
+ * no vector layout. Reallocates if needed.
+ */
+static int
+hmx_vrows(ESL_HMX *mx, const ESL_HMM *hmm, int n, float **row)
+{
+  int      rowlen = (hmm->simd == eslHMM_SERIAL ? hmm->M : hmm->Mp + 2 * hmm->pad);
+  uint64_t need   = (uint64_t) n * rowlen;
+  float   *mem;
+  int      j;
+  int      status;
+
+  if ((status = hmx_vscratch(mx, need, &mem)) != eslOK) return status;
+  memset(mem, 0, sizeof(float) * need);
+  for (j = 0; j < n; j++)
+    row[j] = mem + (uint64_t) j * rowlen + hmm->pad;
+  return eslOK;
+}
+
+
 /* Function:  esl_hmm_Emit()
  * Synopsis:  Emit a sequence from an HMM.
  *
@@ -349,13 +526,154 @@ esl_hmm_Emit(ESL_RANDOMNESS *r, const ESL_HMM *hmm, ESL_DSQ **opt_dsq, int **opt
 }
 
 
+/* Function pointer types for calculating one scaled DP row: the
+ * serial versions below, or the SSE/AVX2 kernels in esl_hmm_{sse,avx}.c.
+ */
+typedef float (*hmm_fwdrow_f)(const ESL_HMM *hmm, ESL_DSQ x, const float *prv, float *cur);
+typedef float (*hmm_bckrow_f)(const ESL_HMM *hmm, ESL_DSQ x, const float *nxt, float *tmp, float *cur);
+
+/* hmm_fwdrow_serial()
+ * Calculate Forward row <cur> from the previous row <prv> and residue
+ * <x>; scale it by its maximum, and return that maximum. Serial
+ * version of esl_hmm_fwdrow_{sse,avx}(), on rows of M floats.
+ */
+static float
+hmm_fwdrow_serial(const ESL_HMM *hmm, ESL_DSQ x, const float *prv, float *cur)
+{
+  int   M   = hmm->M;
+  float max = 0.0;
+  int   k, m;
+
+  for (k = 0; k < M; k++)
+    {
+      cur[k] = 0.0;
+      for (m = 0; m < M; m++)
+	cur[k] += prv[m] * hmm->t[m][k];
+
+      cur[k] *= hmm->eo[x][k];
+      max = ESL_MAX(cur[k], max);
+    }
+  for (k = 0; k < M; k++)
+    cur[k] /= max;
+  return max;
+}
+
+/* hmm_bckrow_serial()
+ * Calculate Backward row <cur> from the next row <nxt> and the
+ * residue <x> emitted there, using scratch row <tmp>; scale it, and
+ * return the maximum. Serial version of esl_hmm_bckrow_{sse,avx}().
+ */
+static float
+hmm_bckrow_serial(const ESL_HMM *hmm, ESL_DSQ x, const float *nxt, float *tmp, float *cur)
+{
+  int   M   = hmm->M;
+  float max = 0.0;
+  int   k, m;
+
+  for (m = 0; m < M; m++)
+    tmp[m] = nxt[m] * hmm->eo[x][m];
+
+  for (k = 0; k < M; k++)
+    {
+      cur[k] = 0.0;
+      for (m = 0; m < M; m++)
+	cur[k] += tmp[m] * hmm->t[k][m];
+      max = ESL_MAX(cur[k], max);
+    }
+  for (k = 0; k < M; k++)
+    cur[k] /= max;
+  return max;
+}
+
+/* hmm_fwdrow(), hmm_bckrow()
+ * Return the row function for <hmm>'s implementation.
+ */
+static hmm_fwdrow_f
+hmm_fwdrow(const ESL_HMM *hmm)
+{
+#ifdef eslENABLE_SSE
+  if (hmm->simd == eslHMM_SSE) return esl_hmm_fwdrow_sse;
+#endif
+#ifdef eslENABLE_AVX
+  if (hmm->simd == eslHMM_AVX) return esl_hmm_fwdrow_avx;
+#endif
+  return hmm_fwdrow_serial;
+}
+
+static hmm_bckrow_f
+hmm_bckrow(const ESL_HMM *hmm)
+{
+#ifdef eslENABLE_SSE
+  if (hmm->simd == eslHMM_SSE) return esl_hmm_bckrow_sse;
+#endif
+#ifdef eslENABLE_AVX
+  if (hmm->simd == eslHMM_AVX) return esl_hmm_bckrow_avx;
+#endif
+  return hmm_bckrow_serial;
+}
+
+/* hmm_fwdinit(), hmm_bckinit()
+ * Calculate the first Forward row (i=1, residue <x>), or the last
+ * Backward row (i=L), in <cur>; scale it, and return the maximum.
+ */
+static float
+hmm_fwdinit(const ESL_HMM *hmm, ESL_DSQ x, float *cur)
+{
+  float max = 0.0;
+  int   k;
+
+  for (k = 0; k < hmm->M; k++) {
+    cur[k] = hmm->eo[x][k] * hmm->pi[k];
+    max = ESL_MAX(cur[k], max);
+  }
+  for (k = 0; k < hmm->M; k++) 
+    cur[k] /= max;
+  return max;
+}
+
+static float
+hmm_bckinit(const ESL_HMM *hmm, float *cur)
+{
+  float max = 0.0;
+  int   k;
+
+  for (k = 0; k < hmm->M; k++) {
+    cur[k] = hmm->t[k][hmm->M];
+    max = ESL_MAX(cur[k], max);
+  }
+  for (k = 0; k < hmm->M; k++)
+    cur[k] /= max;
+  return max;
+}
+
+
+/* Function:  esl_hmm_Forward()
+ * Synopsis:  Forward algorithm, with scaled DP rows.
+ *
+ * Purpose:   Calculate the Forward matrix for digital sequence <dsq>
+ *            of length <L> and the configured model <hmm>, in <fwd>,
+ *            and (optionally) return the log likelihood in <*opt_sc>.
+ *            Each row <fwd->dp[i]> is scaled to a maximum of 1, with
+ *            the log of its scale factor in <fwd->sc[i]>.
+ *
+ *            If <hmm> has a vector layout (see
+ *            <esl_hmm_Configure()>), rows 2..L are calculated by the
+ *            SSE or AVX2 implementation, which gets the same results
+ *            as the serial one.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
 int
 esl_hmm_Forward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *fwd, float *opt_sc)
 {
-  int   i, k, m;
-  int   M     = hmm->M;
-  float logsc = 0;
-  float max;
+  hmm_fwdrow_f fwdrow = hmm_fwdrow(hmm);
+  int          i, m;
+  int          M      = hmm->M;
+  float        logsc  = 0;
+  float       *vrow[2];
+  int          status;
 
   fwd->sc[0] = 0.0;
 
@@ -365,35 +683,23 @@ esl_hmm_Forward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *fwd, flo
     return eslOK;
   }
 
-  max = 0.0;
-  for (k = 0; k < M; k++) {
-    fwd->dp[1][k] = hmm->eo[dsq[1]][k] * hmm->pi[k];
-    max = ESL_MAX(fwd->dp[1][k], max);
-  }
-  for (k = 0; k < M; k++) {
-    fwd->dp[1][k] /= max;
-  }
-  fwd->sc[1] = log(max);
+  fwd->sc[1] = log(hmm_fwdinit(hmm, dsq[1], fwd->dp[1]));
 
-  for (i = 2; i <= L; i++)
+  if (hmm->simd == eslHMM_SERIAL)
     {
-      max = 0.0;
-      for (k = 0; k < M; k++)
+      for (i = 2; i <= L; i++)
+	fwd->sc[i] = log(hmm_fwdrow_serial(hmm, dsq[i], fwd->dp[i-1], fwd->dp[i]));
+    }
+  else
+    {				/* vector rows are padded: work in scratch, copy to dp */
+      if ((status = hmx_vrows(fwd, hmm, 2, vrow)) != eslOK) return status;
+      esl_vec_FCopy(fwd->dp[1], M, vrow[1]);
+      for (i = 2; i <= L; i++)
 	{
-	  fwd->dp[i][k] = 0.0;
-	  for (m = 0; m < M; m++)
-	    fwd->dp[i][k] += fwd->dp[i-1][m] * hmm->t[m][k];
-
-	  fwd->dp[i][k] *= hmm->eo[dsq[i]][k];
-	  
-	  max = ESL_MAX(fwd->dp[i][k], max);
+	  fwd->sc[i] = log((*fwdrow)(hmm, dsq[i], vrow[(i-1)%2], vrow[i%2]));
+	  esl_vec_FCopy(vrow[i%2], M, fwd->dp[i]);
 	}
-      
-      for (k = 0; k < M; k++)
-	fwd->dp[i][k] /= max;
-      fwd->sc[i] = log(max);
     }
-	  
   
   fwd->sc[L+1] = 0.0;
   for (m = 0; m < M; m++) 
@@ -411,13 +717,28 @@ esl_hmm_Forward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *fwd, flo
 }
 
 
+/* Function:  esl_hmm_Backward()
+ * Synopsis:  Backward algorithm, with scaled DP rows.
+ *
+ * Purpose:   Calculate the Backward matrix for digital sequence <dsq>
+ *            of length <L> and the configured model <hmm>, in <bck>,
+ *            and (optionally) return the log likelihood in <*opt_sc>.
+ *            Rows are scaled as in <esl_hmm_Forward()>, and rows
+ *            L-1..1 use the vector implementation, if <hmm> has one.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
 int
 esl_hmm_Backward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *bck, float *opt_sc)
 {
-  int   i,k,m;
-  int   M     = hmm->M;
-  float logsc = 0.0;
-  float max;
+  hmm_bckrow_f bckrow = hmm_bckrow(hmm);
+  int          i, m;
+  int          M      = hmm->M;
+  float        logsc  = 0.0;
+  float       *vrow[3];
+  int          status;
   
   bck->sc[L+1] = 0.0;
 
@@ -427,31 +748,23 @@ esl_hmm_Backward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *bck, fl
     return eslOK;
   }
   
-  max = 0.0;
-  for (k = 0; k < M; k++)
-    {
-      bck->dp[L][k] = hmm->t[k][M];
-      max = ESL_MAX(bck->dp[L][k], max);
-    }
-  for (k = 0; k < M; k++)
-    bck->dp[L][k] /= max;
-  bck->sc[L] = log(max);
+  bck->sc[L] = log(hmm_bckinit(hmm, bck->dp[L]));
 
-  for (i = L-1; i >= 1; i--)
-    {
-      max = 0.0;
-      for (k = 0; k < M; k++)
+  if (hmm->simd == eslHMM_SERIAL)
+    {				/* vrow[0] is bckrow()'s scratch */
+      if ((status = hmx_vrows(bck, hmm, 1, vrow)) != eslOK) return status;
+      for (i = L-1; i >= 1; i--)
+	bck->sc[i] = log(hmm_bckrow_serial(hmm, dsq[i+1], bck->dp[i+1], vrow[0], bck->dp[i]));
+    }
+  else
+    {				/* vrow[2] is bckrow()'s scratch */
+      if ((status = hmx_vrows(bck, hmm, 3, vrow)) != eslOK) return status;
+      esl_vec_FCopy(bck->dp[L], M, vrow[L%2]);
+      for (i = L-1; i >= 1; i--)
 	{
-	  bck->dp[i][k] = 0.0;
-	  for (m = 0; m < M; m++)
-	    bck->dp[i][k] += bck->dp[i+1][m] * hmm->eo[dsq[i+1]][m] * hmm->t[k][m];
-	  
-	  max = ESL_MAX(bck->dp[i][k], max);
+	  bck->sc[i] = log((*bckrow)(hmm, dsq[i+1], vrow[(i+1)%2], vrow[2], vrow[i%2]));
+	  esl_vec_FCopy(vrow[i%2], M, bck->dp[i]);
 	}
-
-      for (k = 0; k < M; k++)
-	bck->dp[i][k] /= max;
-      bck->sc[i] = log(max);
     }
 
   bck->sc[0] = 0.0;
@@ -485,6 +798,713 @@ esl_hmm_PosteriorDecoding(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX
 }
 
 
+/* hmm_fwdpass()
+ * Forward pass over <dsq[1..L]> in two rows, <roll[0..1]>; return
+ * the log likelihood in <*ret_sc>, summing the log scale factors in
+ * double precision. If <ck> is non-NULL, rows 1, K+1, 2K+1... are
+ * calculated in checkpoint rows <ck[0..]> instead, and kept.
+ */
+static void
+hmm_fwdpass(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, float **roll, float **ck, int K, float *ret_sc)
+{
+  hmm_fwdrow_f fwdrow = hmm_fwdrow(hmm);
+  float       *prv    = NULL;
+  float       *cur;
+  double       logsc  = 0.0;
+  float        endsc  = 0.0;
+  int64_t      i;
+  int          m;
+
+  for (i = 1; i <= L; i++)
+    {
+      cur    = (ck && (i-1) % K == 0) ? ck[(i-1) / K] : roll[i%2];
+      logsc += log(i == 1 ? hmm_fwdinit(hmm, dsq[1], cur) : (*fwdrow)(hmm, dsq[i], prv, cur));
+      prv    = cur;
+    }
+  for (m = 0; m < hmm->M; m++)
+    endsc += prv[m] * hmm->t[m][hmm->M];
+  *ret_sc = logsc + log(endsc);
+}
+
+
+/* Function:  esl_hmm_ForwardScore()
+ * Synopsis:  Forward log likelihood, in O(M) memory.
+ *
+ * Purpose:   Calculate the Forward log likelihood of digital sequence
+ *            <dsq> of length <L> given the configured <hmm>, keeping
+ *            only two DP rows, and return it in <*ret_sc>. This is
+ *            the <esl_hmm_Forward()> score, for sequences too long
+ *            for a full DP matrix; the log scale factors are summed
+ *            in double precision.
+ *
+ *            <mx> is only used for its scratch rows, and can be
+ *            small: <esl_hmx_Create(0, hmm->M)>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_hmm_ForwardScore(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, ESL_HMX *mx, float *ret_sc)
+{
+  float *roll[2];
+  int    status;
+
+  if (L == 0) { *ret_sc = log(hmm->pi[hmm->M]); return eslOK; }
+
+  if ((status = hmx_vrows(mx, hmm, 2, roll)) != eslOK) return status;
+  hmm_fwdpass(dsq, L, hmm, roll, NULL, 0, ret_sc);
+  return eslOK;
+}
+
+
+/* Function:  esl_hmm_PosteriorDecodingCkpt()
+ * Synopsis:  Posterior decoding, in O(M \sqrt{L}) memory.
+ *
+ * Purpose:   Posterior decoding of digital sequence <dsq> of length
+ *            <L> with the configured <hmm>, without full <L> by <M>
+ *            Forward and Backward matrices: for a chromosome, say.
+ *
+ *            A first Forward pass keeps every K'th row as a
+ *            checkpoint, for $K = \lceil \sqrt{L} \rceil$. Then the
+ *            Backward pass runs one segment of K rows at a time, from
+ *            the end, recalculating each segment's Forward rows from
+ *            its checkpoint. The DP needs about $2\sqrt{L}$ rows, in
+ *            <mx>'s scratch space, at the cost of a second Forward
+ *            pass. <mx> can be small: <esl_hmx_Create(0, hmm->M)>.
+ *
+ *            Optionally, return the most probable state for each
+ *            residue in <opt_path[1..L]> (0..M-1), its posterior
+ *            probability in <opt_pp[1..L]>, and the Forward log
+ *            likelihood in <*opt_sc>. Caller provides <opt_path> and
+ *            <opt_pp>, with room for <L+1> elements. Ties go to the
+ *            lowest numbered state.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_hmm_PosteriorDecodingCkpt(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, ESL_HMX *mx, int *opt_path, float *opt_pp, float *opt_sc)
+{
+  hmm_fwdrow_f fwdrow = hmm_fwdrow(hmm);
+  hmm_bckrow_f bckrow = hmm_bckrow(hmm);
+  int          M      = hmm->M;
+  int          W      = (hmm->simd == eslHMM_SERIAL ? M : hmm->Mp);
+  float      **row    = NULL;
+  float      **ck, **seg;
+  float       *nxt, *cur, *tmp, *swap;
+  int          K, nck, c, k, kmax;
+  int64_t      a, b, i;
+  float        fsc, pp, ppmax, ppsum;
+  int          status;
+
+  if (L == 0) { if (opt_sc) *opt_sc = log(hmm->pi[M]); return eslOK; }
+
+  K   = (int) ceil(sqrt((double) L));
+  nck = (int) ((L + K - 1) / K);
+  ESL_ALLOC(row, sizeof(float *) * (nck + K + 3));
+  if ((status = hmx_vrows(mx, hmm, nck + K + 3, row)) != eslOK) goto ERROR;
+  ck  = row;
+  seg = row + nck;
+  nxt = row[nck+K];
+  cur = row[nck+K+1];
+  tmp = row[nck+K+2];
+
+  hmm_fwdpass(dsq, L, hmm, row + nck + K, ck, K, &fsc);
+
+  for (c = nck-1; c >= 0; c--)
+    {
+      a = (int64_t) c * K + 1;	/* segment is rows a..b; seg[i-a] is Forward row i */
+      b = ESL_MIN(L, a + K - 1);
+      esl_vec_FCopy(ck[c], W, seg[0]);
+      for (i = a+1; i <= b; i++)
+	(*fwdrow)(hmm, dsq[i], seg[i-a-1], seg[i-a]);
+
+      for (i = b; i >= a; i--)
+	{
+	  if (i == L) hmm_bckinit(hmm, cur);
+	  else        (*bckrow)(hmm, dsq[i+1], nxt, tmp, cur);
+
+	  ppsum = ppmax = 0.0;
+	  kmax  = 0;
+	  for (k = 0; k < M; k++)
+	    {
+	      pp     = seg[i-a][k] * cur[k];
+	      ppsum += pp;
+	      if (pp > ppmax) { ppmax = pp; kmax = k; }
+	    }
+	  if (opt_path) opt_path[i] = kmax;
+	  if (opt_pp)   opt_pp[i]   = ppmax / ppsum;
+
+	  swap = nxt; nxt = cur; cur = swap;
+	}
+    }
+
+  free(row);
+  if (opt_sc) *opt_sc = fsc;
+  return eslOK;
+
+ ERROR:
+  free(row);
+  return status;
+}
+
+
+/* hmm_vtrace()
+ * Streaming Viterbi traceback through ring <bp> of the last <D> rows
+ * of backpointers (row r at <bp + (r%D)*M>), from state <c> at row
+ * <i> down to row <lo>, setting <path[r]> for rows <r = lo..hi>.
+ *
+ * If <v> is non-NULL, it is scaled Viterbi row <i>, and we also
+ * trace the set of all its live states (<v[k] > 0>), to see where
+ * their tracebacks coalesce into one; states above that row weren't
+ * certain, and their number in <lo..hi> is returned. <set> and
+ * <mark> are <M>-element scratch, and <*stamp> a counter for <mark>.
+ */
+static int64_t
+hmm_vtrace(const int *bp, int D, int M, int64_t i, int c, const float *v, int64_t lo, int64_t hi, int *path, int *set, int64_t *mark, int64_t *stamp)
+{
+  int64_t r;
+  int64_t rc = (v ? -1 : i);	/* row where all tracebacks have coalesced */
+  int     n  = 0;
+  int     j, nn, s;
+
+  if (v) {
+    for (s = 0; s < M; s++) if (v[s] > 0.) set[n++] = s;
+    if (n <= 1) rc = i;
+  }
+
+  for (r = i; r >= lo; r--)
+    {
+      if (r <= hi) path[r] = c;
+      if (r == lo) break;
+      c = bp[(r%D)*M + c];
+
+      if (rc < 0)
+	{
+	  (*stamp)++;
+	  for (j = nn = 0; j < n; j++)
+	    {
+	      s = bp[(r%D)*M + set[j]];
+	      if (mark[s] != *stamp) { mark[s] = *stamp; set[nn++] = s; }
+	    }
+	  n = nn;
+	  if (n == 1) rc = r-1;
+	}
+    }
+  return (rc < 0 ? hi - lo + 1 : ESL_MAX(0, hi - rc));
+}
+
+
+/* Function:  esl_hmm_ViterbiStream()
+ * Synopsis:  Viterbi decoding, with bounded traceback memory.
+ *
+ * Purpose:   Find the Viterbi (most probable) state path for digital
+ *            sequence <dsq> of length <L> given the configured <hmm>,
+ *            keeping traceback pointers only for the last <D> rows,
+ *            in O(MD) memory, and store it in caller-provided
+ *            <path[1..L]> (states 0..M-1).
+ *
+ *            States are decided as the DP streams along the sequence.
+ *            Each time the traceback window fills, the path is traced
+ *            back from the current best state, and the states of the
+ *            oldest half of the window are decided. They're certain
+ *            to be on the Viterbi path if the tracebacks from all live
+ *            states at the current row have coalesced by then; if not,
+ *            the decision was forced, and those residues are counted
+ *            in <*opt_nforced>. If that count is 0 (for instance,
+ *            whenever <D >= L>), <path> is the Viterbi path. A window
+ *            a few times longer than the model's typical state
+ *            durations rarely forces anything.
+ *
+ *            Optionally return the Viterbi log probability in
+ *            <*opt_sc>, which is exact even if states were forced.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <D> < 2.
+ *            <eslEMEM> on allocation failure.
+ */
+int
+esl_hmm_ViterbiStream(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, int D, int *path, float *opt_sc, int64_t *opt_nforced)
+{
+  int       M       = hmm->M;
+  float    *prv     = NULL;
+  float    *cur     = NULL;
+  float    *swap;
+  int      *bp      = NULL;
+  int      *set     = NULL;
+  int64_t  *mark    = NULL;
+  int64_t   stamp   = 0;
+  int64_t   ndone   = 0;	/* path[1..ndone] are decided */
+  int64_t   nforced = 0;
+  double    logsc   = 0.0;
+  float     max, v, endsc;
+  int64_t   i;
+  int       k, m, c;
+  int       status;
+
+  if (D < 2) ESL_EXCEPTION(eslEINVAL, "traceback window D must be >= 2");
+  if (L == 0) {
+    if (opt_sc)      *opt_sc      = log(hmm->pi[M]);
+    if (opt_nforced) *opt_nforced = 0;
+    return eslOK;
+  }
+
+  ESL_ALLOC(prv,  sizeof(float)   * M);
+  ESL_ALLOC(cur,  sizeof(float)   * M);
+  ESL_ALLOC(bp,   sizeof(int)     * M * D);
+  ESL_ALLOC(set,  sizeof(int)     * M);
+  ESL_ALLOC(mark, sizeof(int64_t) * M);
+  esl_vec_ISet(bp, M*D, 0);
+  for (k = 0; k < M; k++) mark[k] = 0;
+
+  for (i = 1; i <= L; i++)
+    {
+      max = 0.0;
+      for (k = 0; k < M; k++)
+	{
+	  if (i == 1) 
+	    cur[k] = hmm->pi[k];
+	  else
+	    {
+	      cur[k] = 0.0;
+	      c      = 0;
+	      for (m = 0; m < M; m++)
+		if ((v = prv[m] * hmm->t[m][k]) > cur[k]) { cur[k] = v; c = m; }
+	      bp[(i%D)*M + k] = c;
+	    }
+	  cur[k] *= hmm->eo[dsq[i]][k];
+	  max     = ESL_MAX(cur[k], max);
+	}
+      for (k = 0; k < M; k++)
+	cur[k] /= max;
+      logsc += log(max);
+
+      if (i - ndone == D && i < L)
+	{			/* window full: decide its oldest D/2 rows */
+	  c        = esl_vec_FArgMax(cur, M);
+	  nforced += hmm_vtrace(bp, D, M, i, c, cur, ndone+1, ndone + D/2, path, set, mark, &stamp);
+	  ndone   += D/2;
+	}
+      swap = prv; prv = cur; cur = swap;
+    }
+
+  /* prv is now row L */
+  c     = 0;
+  endsc = 0.0;
+  for (k = 0; k < M; k++)
+    if (prv[k] * hmm->t[k][M] > endsc) { endsc = prv[k] * hmm->t[k][M]; c = k; }
+  hmm_vtrace(bp, D, M, L, c, NULL, ndone+1, L, path, NULL, NULL, NULL);
+
+  if (opt_sc)      *opt_sc      = logsc + log(endsc);
+  if (opt_nforced) *opt_nforced = nforced;
+  free(prv);  free(cur);  free(bp);  free(set);  free(mark);
+  return eslOK;
+
+ ERROR:
+  free(prv);  free(cur);  free(bp);  free(set);  free(mark);
+  return status;
+}
+
+
+/*****************************************************************
+ * x. ESL_HMM_BATCH: scoring many sequences
+ *****************************************************************/
+
+/* Function:  esl_hmm_batch_Create()
+ * Synopsis:  Create an engine to score many sequences with an HMM.
+ *
+ * Purpose:   Create an engine for calculating the Forward log
+ *            likelihoods of many digital sequences, given the
+ *            configured model <hmm>: as a stream of <ESL_SQ_BLOCK>s
+ *            (<esl_hmm_batch_ScoreBlock()>) or <ESL_DSQDATA_CHUNK>s
+ *            (<esl_hmm_batch_ScoreChunk()>).
+ *
+ *            <ncpu> worker threads are started, and persist until
+ *            the engine is destroyed, each with its own DP
+ *            workspace. With <ncpu> 0, or without POSIX threads,
+ *            sequences are scored in the caller's thread.
+ *
+ *            If <hmm> has a vector layout, sequences may be scored
+ *            inter-sequence: each block is sorted by length, and
+ *            sequences of similar length are scored together, one
+ *            per vector lane (4 with SSE, 8 with AVX2). This is much
+ *            faster than <esl_hmm_ForwardScore()> for models of few
+ *            states, where one sequence's DP row is only a vector or
+ *            two, and for sparse (banded) ones; it's the default
+ *            unless <hmm> is dense with at least four vectors of
+ *            states. Rows are scaled by powers of two instead of by
+ *            their maximum, so scores may differ from
+ *            <esl_hmm_ForwardScore()>'s in the last few bits. The
+ *            caller may change <bat->inter> between blocks.
+ *
+ *            The engine keeps a pointer to <hmm>, which the caller
+ *            must keep until the engine is destroyed, and a copy of
+ *            its transitions: if they change, create a new engine.
+ *
+ * Returns:   ptr to the new engine.
+ *
+ * Throws:    <NULL> on allocation or thread creation failure.
+ */
+ESL_HMM_BATCH *
+esl_hmm_batch_Create(const ESL_HMM *hmm, int ncpu)
+{
+  ESL_HMM_BATCH *bat = NULL;
+  int            M   = hmm->M;
+  int            j, k, m, w;
+  int            status;
+
+#ifndef HAVE_PTHREAD
+  ncpu = 0;
+#endif
+
+  ESL_ALLOC(bat, sizeof(ESL_HMM_BATCH));
+  bat->hmm    = hmm;
+  bat->ncpu   = ncpu;
+  bat->inter  = (hmm->simd != eslHMM_SERIAL && (hmm->nd > 0 || hmm->M < 4 * hmm->V));
+  bat->nseq   = 0;
+  bat->tp     = NULL;
+  bat->tm     = NULL;
+  bat->tv     = NULL;
+  bat->dsq    = NULL;
+  bat->L      = NULL;
+  bat->sc     = NULL;
+  bat->ord    = NULL;
+  bat->n      = 0;
+  bat->nalloc = 0;
+  bat->mx     = NULL;
+#ifdef HAVE_PTHREAD
+  bat->thr    = NULL;
+  bat->next   = 0;
+  bat->nbusy  = 0;
+  bat->block  = 0;
+  bat->done   = FALSE;
+  bat->status = eslOK;
+#endif
+
+  /* Sparse transitions, by destination state. */
+  ESL_ALLOC(bat->tp, sizeof(int) * (M+1));
+  for (k = 0, j = 0; k < M; k++)
+    {
+      bat->tp[k] = j;
+      for (m = 0; m < M; m++)
+	if (hmm->t[m][k] != 0.0f) j++;
+    }
+  bat->tp[M] = j;
+  ESL_ALLOC(bat->tm, sizeof(int)   * ESL_MAX(1, j));
+  ESL_ALLOC(bat->tv, sizeof(float) * ESL_MAX(1, j));
+  for (k = 0, j = 0; k < M; k++)
+    for (m = 0; m < M; m++)
+      if (hmm->t[m][k] != 0.0f) { bat->tm[j] = m; bat->tv[j] = hmm->t[m][k]; j++; }
+
+  ESL_ALLOC(bat->mx, sizeof(ESL_HMX *) * (ncpu+1));
+  for (w = 0; w <= ncpu; w++) bat->mx[w] = NULL;
+  for (w = 0; w <= ncpu; w++)
+    if ((bat->mx[w] = esl_hmx_Create(0, M)) == NULL) { status = eslEMEM; goto ERROR; }
+
+#ifdef HAVE_PTHREAD
+  if (ncpu > 0)
+    {
+      if (pthread_mutex_init(&bat->mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+      if (pthread_cond_init (&bat->cv,    NULL) != 0) { pthread_mutex_destroy(&bat->mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+      if ((bat->thr = esl_threads_Create(&hmm_batch_thread)) == NULL) { status = eslEMEM; goto ERROR; }
+      for (w = 0; w < ncpu; w++)
+	if ((status = esl_threads_AddThread(bat->thr, bat)) != eslOK) goto ERROR;
+      esl_threads_WaitForStart(bat->thr);
+    }
+#endif
+  return bat;
+
+ ERROR:
+  esl_hmm_batch_Destroy(bat);
+  return NULL;
+}
+
+
+/* Function:  esl_hmm_batch_ScoreBlock()
+ * Synopsis:  Score a block of sequences, from an <ESL_SQ_BLOCK>.
+ *
+ * Purpose:   Calculate the Forward log likelihoods of all
+ *            <sqblock->count> digital sequences in <sqblock>, and
+ *            return them in <opt_sc[0..sqblock->count-1]>, allocated
+ *            by the caller. (<opt_sc> may be <NULL>, for benchmarking.)
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <sqblock> isn't digital.
+ *            <eslEMEM> on allocation failure; <eslESYS> on a thread
+ *            failure. The block's scores are then undefined.
+ */
+int
+esl_hmm_batch_ScoreBlock(ESL_HMM_BATCH *bat, const ESL_SQ_BLOCK *sqblock, float *opt_sc)
+{
+  int i;
+  int status;
+
+  if ((status = hmm_batch_grow(bat, sqblock->count)) != eslOK) return status;
+  for (i = 0; i < sqblock->count; i++)
+    {
+      if (sqblock->list[i].dsq == NULL) ESL_EXCEPTION(eslEINVAL, "sequence block must be digital");
+      bat->dsq[i] = sqblock->list[i].dsq;
+      bat->L[i]   = sqblock->list[i].n;
+    }
+  bat->n = sqblock->count;
+  return hmm_batch_score(bat, opt_sc);
+}
+
+
+/* Function:  esl_hmm_batch_ScoreChunk()
+ * Synopsis:  Score a block of sequences, from an <ESL_DSQDATA_CHUNK>.
+ *
+ * Purpose:   Same as <esl_hmm_batch_ScoreBlock()>, for the
+ *            <chu->N> sequences in <ESL_DSQDATA> chunk <chu>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> on a thread
+ *            failure.
+ */
+int
+esl_hmm_batch_ScoreChunk(ESL_HMM_BATCH *bat, const ESL_DSQDATA_CHUNK *chu, float *opt_sc)
+{
+  int i;
+  int status;
+
+  if ((status = hmm_batch_grow(bat, chu->N)) != eslOK) return status;
+  for (i = 0; i < chu->N; i++)
+    {
+      bat->dsq[i] = chu->dsq[i];
+      bat->L[i]   = chu->L[i];
+    }
+  bat->n = chu->N;
+  return hmm_batch_score(bat, opt_sc);
+}
+
+
+/* Function:  esl_hmm_batch_Reuse()
+ * Synopsis:  Reinitialize a batch, to score a new database.
+ *
+ * Purpose:   Reset the count of sequences scored, keeping the model,
+ *            the worker threads, and all allocations.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_hmm_batch_Reuse(ESL_HMM_BATCH *bat)
+{
+  bat->nseq = 0;
+  bat->n    = 0;
+  return eslOK;
+}
+
+
+/* Function:  esl_hmm_batch_Destroy()
+ * Synopsis:  Stop the worker threads and free an <ESL_HMM_BATCH>.
+ */
+void
+esl_hmm_batch_Destroy(ESL_HMM_BATCH *bat)
+{
+  int w;
+
+  if (bat)
+    {
+#ifdef HAVE_PTHREAD
+      if (bat->thr)
+	{
+	  pthread_mutex_lock(&bat->mutex);
+	  bat->done = TRUE;
+	  pthread_cond_broadcast(&bat->cv);
+	  pthread_mutex_unlock(&bat->mutex);
+	  esl_threads_WaitForFinish(bat->thr);
+	  esl_threads_Destroy(bat->thr);
+	  pthread_cond_destroy(&bat->cv);
+	  pthread_mutex_destroy(&bat->mutex);
+	}
+#endif
+      if (bat->mx)
+	for (w = 0; w <= bat->ncpu; w++) esl_hmx_Destroy(bat->mx[w]);
+      free(bat->mx);
+      free(bat->tp);
+      free(bat->tm);
+      free(bat->tv);
+      free(bat->dsq);
+      free(bat->L);
+      free(bat->sc);
+      free(bat->ord);
+      free(bat);
+    }
+}
+
+
+/* hmm_batch_grow()
+ * Make room for <n> sequences in the batch's current block.
+ */
+static int
+hmm_batch_grow(ESL_HMM_BATCH *bat, int n)
+{
+  int status;
+
+  if (n > bat->nalloc)
+    {
+      ESL_REALLOC(bat->dsq, sizeof(ESL_DSQ *) * n);
+      ESL_REALLOC(bat->L,   sizeof(int64_t)   * n);
+      ESL_REALLOC(bat->sc,  sizeof(float)     * n);
+      ESL_REALLOC(bat->ord, sizeof(int)       * n);
+      bat->nalloc = n;
+    }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* hmm_batch_bylength()
+ * esl_quicksort() comparison: longest sequences first, then by
+ * index, so the order is deterministic.
+ */
+static int
+hmm_batch_bylength(const void *data, int o1, int o2)
+{
+  const ESL_HMM_BATCH *bat = (const ESL_HMM_BATCH *) data;
+
+  if      (bat->L[o1] > bat->L[o2]) return -1;
+  else if (bat->L[o1] < bat->L[o2]) return  1;
+  else if (o1 < o2)                 return -1;
+  else if (o1 > o2)                 return  1;
+  else                              return  0;
+}
+
+
+/* hmm_batch_score()
+ * Score the batch's current block of <bat->n> sequences, longest
+ * first, by worker threads if there are any and the block is big
+ * enough to share; then copy the scores to <opt_sc>, if it's
+ * non-NULL.
+ */
+static int
+hmm_batch_score(ESL_HMM_BATCH *bat, float *opt_sc)
+{
+  int status;
+
+  if (bat->n == 0) return eslOK;
+  esl_quicksort(bat, bat->n, hmm_batch_bylength, bat->ord);
+
+#ifdef HAVE_PTHREAD
+  if (bat->thr && bat->n > eslHMM_BATCH_B)
+    {
+      pthread_mutex_lock(&bat->mutex);
+      bat->next   = 0;
+      bat->nbusy  = bat->ncpu;
+      bat->status = eslOK;
+      bat->block++;
+      pthread_cond_broadcast(&bat->cv);
+      while (bat->nbusy > 0) pthread_cond_wait(&bat->cv, &bat->mutex);
+      status = bat->status;
+      pthread_mutex_unlock(&bat->mutex);
+      if (status != eslOK) return status;
+    }
+  else
+#endif
+    {
+      if ((status = hmm_batch_range(bat, bat->mx[bat->ncpu], 0, bat->n)) != eslOK) return status;
+    }
+
+  if (opt_sc) memcpy(opt_sc, bat->sc, sizeof(float) * bat->n);
+  bat->nseq += bat->n;
+  return eslOK;
+}
+
+
+/* hmm_batch_range()
+ * Score the sequences <ord[p0..p1-1]> of the current block, using
+ * DP workspace <mx>. If the batch is scoring inter-sequence, and
+ * there's a kernel for the model's vector layout, consecutive
+ * sequences (of similar length, since <ord> is sorted) are scored a
+ * vector's worth at a time.
+ */
+static int
+hmm_batch_range(ESL_HMM_BATCH *bat, ESL_HMX *mx, int p0, int p1)
+{
+  void  (*kinter)(const ESL_HMM_BATCH *, const int *, int, float *) = NULL;
+  int     lanes = 0;
+  float  *dp;
+  int     i, n, p;
+  int     status;
+
+  if (bat->inter)
+    switch (bat->hmm->simd) {
+#ifdef eslENABLE_SSE
+    case eslHMM_SSE: kinter = esl_hmm_inter_sse; lanes = 4; break;
+#endif
+#ifdef eslENABLE_AVX
+    case eslHMM_AVX: kinter = esl_hmm_inter_avx; lanes = 8; break;
+#endif
+    default: break;
+    }
+
+  for (p = p0; p < p1; p += n)
+    {
+      i = bat->ord[p];
+      if (kinter && bat->L[i] > 0)
+	{
+	  n = ESL_MIN(lanes, p1-p);
+	  if ((status = hmx_vscratch(mx, (uint64_t) 2 * bat->hmm->M * lanes, &dp)) != eslOK) return status;
+	  (*kinter)(bat, bat->ord + p, n, dp);
+	}
+      else
+	{
+	  n = 1;
+	  if ((status = esl_hmm_ForwardScore(bat->dsq[i], bat->L[i], bat->hmm, mx, &(bat->sc[i]))) != eslOK) return status;
+	}
+    }
+  return eslOK;
+}
+
+
+#ifdef HAVE_PTHREAD
+/* hmm_batch_thread()
+ * A worker: waits for a new block, then takes eslHMM_BATCH_B
+ * sequences at a time from it until it's all taken.
+ */
+static void
+hmm_batch_thread(void *arg)
+{
+  ESL_THREADS   *thr  = (ESL_THREADS *) arg;
+  ESL_HMM_BATCH *bat;
+  int            w, p0, p1, status;
+  int            seen = 0;
+
+  esl_threads_Started(thr, &w);
+  bat = (ESL_HMM_BATCH *) esl_threads_GetData(thr, w);
+
+  pthread_mutex_lock(&bat->mutex);
+  while (1)
+    {
+      while (bat->block == seen && ! bat->done) pthread_cond_wait(&bat->cv, &bat->mutex);
+      if (bat->done) break;
+      seen = bat->block;
+
+      while (bat->next < bat->n && bat->status == eslOK)
+	{
+	  p0        = bat->next;
+	  p1        = ESL_MIN(bat->n, p0 + eslHMM_BATCH_B);
+	  bat->next = p1;
+	  pthread_mutex_unlock(&bat->mutex);
+	  status = hmm_batch_range(bat, bat->mx[w], p0, p1);
+	  pthread_mutex_lock(&bat->mutex);
+	  if (status != eslOK && bat->status == eslOK) bat->status = status;
+	}
+      if (--bat->nbusy == 0) pthread_cond_broadcast(&bat->cv);
+    }
+  pthread_mutex_unlock(&bat->mutex);
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+
 
 
 /*****************************************************************
@@ -526,6 +1546,466 @@ make_occasionally_dishonest_casino(ESL_HMM **ret_hmm, ESL_ALPHABET **ret_abc)
 }
 #endif /*eslHMM_TESTDRIVE*/
 
+#if defined(eslHMM_TESTDRIVE) || defined(eslHMM_BENCHMARK)
+/* make_random_hmm()
+ * A random <M>-state HMM over <abc>. If <do_band> is TRUE, it's a
+ * left-right model: state m only goes to m, m+1, m+2, or the end.
+ */
+static ESL_HMM *
+make_random_hmm(ESL_RANDOMNESS *r, const ESL_ALPHABET *abc, int M, int do_band)
+{
+  ESL_HMM *hmm = esl_hmm_Create(abc, M);
+  int      k, m, x;
+
+  for (k = 0; k < M; k++) hmm->pi[k] = esl_rnd_UniformPositive(r);
+  hmm->pi[M] = 0.0;
+  esl_vec_FNorm(hmm->pi, M+1);
+
+  for (m = 0; m < M; m++)
+    {
+      for (k = 0; k <= M; k++)
+	hmm->t[m][k] = (! do_band || k == M || (k >= m && k <= m+2)) ? esl_rnd_UniformPositive(r) : 0.0;
+      hmm->t[m][M] *= 0.01;
+      esl_vec_FNorm(hmm->t[m], M+1);
+
+      for (x = 0; x < abc->K; x++)
+	hmm->e[m][x] = esl_rnd_UniformPositive(r);
+      esl_vec_FNorm(hmm->e[m], abc->K);
+    }
+  return hmm;
+}
+#endif /*eslHMM_TESTDRIVE || eslHMM_BENCHMARK*/
+
+#ifdef eslHMM_TESTDRIVE
+/* hmm_is_available()
+ * TRUE if we can run the <simd> implementation on this processor.
+ */
+static int
+hmm_is_available(int simd)
+{
+  switch (simd) {
+  case eslHMM_SERIAL: return TRUE;
+#ifdef eslENABLE_SSE
+  case eslHMM_SSE:    return esl_cpu_has_sse();
+#endif
+#ifdef eslENABLE_AVX
+  case eslHMM_AVX:    return esl_cpu_has_avx();
+#endif
+  default:            return FALSE;
+  }
+}
+
+/* viterbi_oracle()
+ * Full O(LM) log-space Viterbi; return the optimal log probability.
+ */
+static double
+viterbi_oracle(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm)
+{
+  int     M  = hmm->M;
+  double *v  = malloc(sizeof(double) * M);
+  double *v2 = malloc(sizeof(double) * M);
+  double *swap;
+  double  best;
+  int     i, k, m;
+
+  if (! v || ! v2) esl_fatal("malloc failed");
+  for (k = 0; k < M; k++) v[k] = log(hmm->pi[k]) + log(hmm->eo[dsq[1]][k]);
+  for (i = 2; i <= L; i++)
+    {
+      for (k = 0; k < M; k++)
+	{
+	  best = -eslINFINITY;
+	  for (m = 0; m < M; m++) best = ESL_MAX(best, v[m] + log(hmm->t[m][k]));
+	  v2[k] = best + log(hmm->eo[dsq[i]][k]);
+	}
+      swap = v; v = v2; v2 = swap;
+    }
+  best = -eslINFINITY;
+  for (k = 0; k < M; k++) best = ESL_MAX(best, v[k] + log(hmm->t[k][M]));
+  free(v);
+  free(v2);
+  return best;
+}
+
+/* path_logp()
+ * Log probability of state path <path[1..L]> for <dsq>.
+ */
+static double
+path_logp(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, const int *path)
+{
+  double sc = log(hmm->pi[path[1]]);
+  int    i;
+
+  for (i = 1; i <= L; i++)
+    {
+      sc += log(hmm->eo[dsq[i]][path[i]]);
+      sc += log(hmm->t[path[i]][i < L ? path[i+1] : hmm->M]);
+    }
+  return sc;
+}
+#endif /*eslHMM_TESTDRIVE*/
+
+
+/*****************************************************************
+ * x. Benchmark
+ *****************************************************************/
+#ifdef eslHMM_BENCHMARK
+/* gcc -O3 -I. -L. -o esl_hmm_benchmark -DeslHMM_BENCHMARK esl_hmm.c -leasel -lm
+ * ./esl_hmm_benchmark              # dense 8-state model
+ * ./esl_hmm_benchmark -b -M 64     # left-right 64-state model
+ *
+ * Also times an ESL_HMM_BATCH scoring the N seqs as one block, with
+ * and without inter-sequence scoring, with --cpu worker threads.
+ */
+#include "esl_config.h"
+
+#include <stdio.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_hmm.h"
+#include "esl_random.h"
+#include "esl_stopwatch.h"
+
+static ESL_OPTIONS options[] = {
+  /* name  type         default  env   range togs  reqs  incomp  help                                  docgrp */
+  {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                      0},
+  {"-b",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "left-right (banded) model, not dense",     0},
+  {"-s",  eslARG_INT,      "42", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",            0},
+  {"-L",  eslARG_INT,     "400", NULL,"n>0", NULL, NULL, NULL, "length of random target seqs",             0},
+  {"-M",  eslARG_INT,       "8", NULL,"n>0", NULL, NULL, NULL, "number of model states",                   0},
+  {"-N",  eslARG_INT,   "20000", NULL,"n>0", NULL, NULL, NULL, "number of random target seqs",             0},
+  {"--cpu",eslARG_INT,      "0", NULL,"n>=0",NULL, NULL, NULL, "number of batch worker threads",           0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options]";
+static char banner[] = "benchmark driver for hmm module";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r       = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc     = esl_alphabet_Create(eslAMINO);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  int             M       = esl_opt_GetInteger(go, "-M");
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_HMM        *hmm     = make_random_hmm(r, abc, M, esl_opt_GetBoolean(go, "-b"));
+  ESL_HMX        *fwd     = esl_hmx_Create(L, M);
+  ESL_HMX        *bck     = esl_hmx_Create(L, M);
+  ESL_HMX        *ckx     = esl_hmx_Create(0, M);
+  ESL_DSQ        *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  int            *path    = malloc(sizeof(int)     * (L+1));
+  float          *pp      = malloc(sizeof(float)   * (L+1));
+  float          *sc      = malloc(sizeof(float)   * N);
+  ESL_HMM_BATCH  *bat     = NULL;
+  ESL_DSQDATA_CHUNK chu;
+  double          ncells  = (double) N * L * M;
+  int             pass, n, i;
+  float           fsc, bsc;
+
+  dsq[0] = dsq[L+1] = eslDSQ_SENTINEL;
+  for (i = 1; i <= L; i++) dsq[i] = esl_rnd_Roll(r, abc->K);
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      if (pass == 0) hmm_configure(hmm, NULL, eslHMM_SERIAL);
+      else           esl_hmm_Configure(hmm, NULL);
+
+      esl_stopwatch_Start(w);
+      for (n = 0; n < N; n++)
+	esl_hmm_Forward (dsq, L, hmm, fwd, &fsc);
+      esl_stopwatch_Stop(w);
+      printf("# Forward  (simd %d, nd %2d): %8.1f Mcells/s  sc %.4f\n", hmm->simd, hmm->nd, ncells / 1e6 / w->elapsed, fsc);
+
+      esl_stopwatch_Start(w);
+      for (n = 0; n < N; n++)
+	esl_hmm_Backward(dsq, L, hmm, bck, &bsc);
+      esl_stopwatch_Stop(w);
+      printf("# Backward (simd %d, nd %2d): %8.1f Mcells/s  sc %.4f\n", hmm->simd, hmm->nd, ncells / 1e6 / w->elapsed, bsc);
+
+      esl_stopwatch_Start(w);
+      for (n = 0; n < N; n++)
+	esl_hmm_PosteriorDecodingCkpt(dsq, L, hmm, ckx, path, pp, &fsc);
+      esl_stopwatch_Stop(w);
+      printf("# Ckpt dec (simd %d, nd %2d): %8.1f Mcells/s  sc %.4f\n", hmm->simd, hmm->nd, ncells / 1e6 / w->elapsed, fsc);
+    }
+
+  chu.N   = N;
+  chu.dsq = malloc(sizeof(ESL_DSQ *) * N);
+  chu.L   = malloc(sizeof(int64_t)   * N);
+  for (n = 0; n < N; n++) { chu.dsq[n] = dsq; chu.L[n] = L; }
+  bat = esl_hmm_batch_Create(hmm, esl_opt_GetInteger(go, "--cpu"));
+  for (pass = 0; pass < 2; pass++)
+    {
+      bat->inter = (pass == 1);
+      esl_stopwatch_Start(w);
+      esl_hmm_batch_ScoreChunk(bat, &chu, sc);
+      esl_stopwatch_Stop(w);
+      printf("# Batch    (simd %d, inter %d): %8.1f Mcells/s  sc %.4f\n", hmm->simd, bat->inter, ncells / 1e6 / w->elapsed, sc[N-1]);
+    }
+
+  esl_hmm_batch_Destroy(bat);
+  free(chu.dsq);
+  free(chu.L);
+  free(sc);
+  free(pp);
+  free(path);
+  free(dsq);
+  esl_hmx_Destroy(ckx);
+  esl_hmx_Destroy(bck);
+  esl_hmx_Destroy(fwd);
+  esl_hmm_Destroy(hmm);
+  esl_stopwatch_Destroy(w);
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*eslHMM_BENCHMARK*/
+
+
+/*****************************************************************
+ * x. Unit tests
+ *****************************************************************/
+#ifdef eslHMM_TESTDRIVE
+
+/* utest_vector()
+ * Forward and Backward for random dense and left-right HMMs, in each
+ * vector implementation (and a clone of it) must agree with the
+ * serial implementation: scores and every scaled DP row.
+ */
+static void
+utest_vector(ESL_RANDOMNESS *r, const ESL_ALPHABET *abc, int M, int L, int do_band)
+{
+  char     msg[] = "hmm vector utest failed";
+  ESL_HMM *hmm   = make_random_hmm(r, abc, M, do_band);
+  ESL_HMM *dup   = NULL;
+  ESL_DSQ *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  ESL_HMX *fwd0  = esl_hmx_Create(L, M);
+  ESL_HMX *bck0  = esl_hmx_Create(L, M);
+  ESL_HMX *fwd   = esl_hmx_Create(L, M);
+  ESL_HMX *bck   = esl_hmx_Create(L, M);
+  float    fsc0, bsc0, fsc, bsc;
+  int      simd, i, k;
+
+  if (! dsq) esl_fatal(msg);
+  dsq[0] = dsq[L+1] = eslDSQ_SENTINEL;
+  for (i = 1; i <= L; i++) dsq[i] = esl_rnd_Roll(r, abc->Kp);
+
+  if (hmm_configure(hmm, NULL, eslHMM_SERIAL) != eslOK) esl_fatal(msg);
+  esl_hmm_Forward (dsq, L, hmm, fwd0, &fsc0);
+  esl_hmm_Backward(dsq, L, hmm, bck0, &bsc0);
+  if (esl_FCompareAbs(fsc0, bsc0, 1e-3) != eslOK) esl_fatal(msg);
+
+  for (simd = eslHMM_SSE; simd <= eslHMM_AVX; simd++)
+    if (hmm_is_available(simd))
+      {
+	if (hmm_configure(hmm, NULL, simd) != eslOK) esl_fatal(msg);
+	if (hmm->simd != simd)                        esl_fatal(msg);
+	if ((hmm->nd > 0) != (do_band && M >= 6))     esl_fatal(msg);
+	if ((dup = esl_hmm_Clone(hmm)) == NULL)       esl_fatal(msg);
+
+	if (esl_hmm_Forward (dsq, L, dup, fwd, &fsc) != eslOK) esl_fatal(msg);
+	if (esl_hmm_Backward(dsq, L, dup, bck, &bsc) != eslOK) esl_fatal(msg);
+	if (esl_FCompare(fsc, fsc0, 1e-5) != eslOK) esl_fatal("%s: simd %d, fwd %f != %f", msg, simd, fsc, fsc0);
+	if (esl_FCompare(bsc, bsc0, 1e-5) != eslOK) esl_fatal("%s: simd %d, bck %f != %f", msg, simd, bsc, bsc0);
+	for (i = 1; i <= L; i++)
+	  {
+	    if (esl_FCompare(fwd->sc[i], fwd0->sc[i], 1e-5) != eslOK) esl_fatal(msg);
+	    if (esl_FCompare(bck->sc[i], bck0->sc[i], 1e-5) != eslOK) esl_fatal(msg);
+	    for (k = 0; k < M; k++)
+	      {
+		if (esl_FCompareAbs(fwd->dp[i][k], fwd0->dp[i][k], 1e-6) != eslOK) esl_fatal(msg);
+		if (esl_FCompareAbs(bck->dp[i][k], bck0->dp[i][k], 1e-6) != eslOK) esl_fatal(msg);
+	      }
+	  }
+	esl_hmm_Destroy(dup);
+      }
+
+  esl_hmx_Destroy(fwd0);
+  esl_hmx_Destroy(bck0);
+  esl_hmx_Destroy(fwd);
+  esl_hmx_Destroy(bck);
+  esl_hmm_Destroy(hmm);
+  free(dsq);
+}
+
+/* utest_ckpt()
+ * Checkpointed posterior decoding and O(M) Forward scoring agree
+ * with the full Forward/Backward matrices, in each implementation.
+ */
+static void
+utest_ckpt(ESL_RANDOMNESS *r, const ESL_ALPHABET *abc, int M, int L, int do_band)
+{
+  char     msg[] = "hmm ckpt utest failed";
+  ESL_HMM *hmm   = make_random_hmm(r, abc, M, do_band);
+  ESL_DSQ *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  int     *path  = malloc(sizeof(int)     * (L+1));
+  float   *pp    = malloc(sizeof(float)   * (L+1));
+  ESL_HMX *fwd   = esl_hmx_Create(L, M);
+  ESL_HMX *bck   = esl_hmx_Create(L, M);
+  ESL_HMX *mx    = esl_hmx_Create(0, M);
+  float    fsc, csc, osc, p, pmax, psum;
+  int      simd, i, k, kmax;
+
+  if (! dsq || ! path || ! pp) esl_fatal(msg);
+  dsq[0] = dsq[L+1] = eslDSQ_SENTINEL;
+  for (i = 1; i <= L; i++) dsq[i] = esl_rnd_Roll(r, abc->Kp);
+
+  for (simd = eslHMM_SERIAL; simd <= eslHMM_AVX; simd++)
+    if (hmm_is_available(simd))
+      {
+	if (hmm_configure(hmm, NULL, simd) != eslOK) esl_fatal(msg);
+	esl_hmm_Forward (dsq, L, hmm, fwd, &fsc);
+	esl_hmm_Backward(dsq, L, hmm, bck, NULL);
+
+	if (esl_hmm_PosteriorDecodingCkpt(dsq, L, hmm, mx, path, pp, &csc) != eslOK) esl_fatal(msg);
+	if (esl_hmm_ForwardScore(dsq, L, hmm, mx, &osc)                      != eslOK) esl_fatal(msg);
+	if (esl_FCompare(csc, fsc, 1e-4) != eslOK) esl_fatal("%s: simd %d, ckpt sc %f != %f", msg, simd, csc, fsc);
+	if (esl_FCompare(osc, fsc, 1e-4) != eslOK) esl_fatal("%s: simd %d, fwd sc %f != %f",  msg, simd, osc, fsc);
+
+	for (i = 1; i <= L; i++)
+	  {
+	    pmax = psum = 0.;
+	    kmax = 0;
+	    for (k = 0; k < M; k++)
+	      {
+		p     = fwd->dp[i][k] * bck->dp[i][k];
+		psum += p;
+		if (p > pmax) { pmax = p; kmax = k; }
+	      }
+	    if (path[i] != kmax)                                esl_fatal("%s: simd %d, row %d", msg, simd, i);
+	    if (esl_FCompareAbs(pp[i], pmax / psum, 1e-5) != eslOK) esl_fatal(msg);
+	  }
+      }
+
+  esl_hmx_Destroy(mx);
+  esl_hmx_Destroy(bck);
+  esl_hmx_Destroy(fwd);
+  esl_hmm_Destroy(hmm);
+  free(pp);
+  free(path);
+  free(dsq);
+}
+
+/* utest_viterbi_stream()
+ * Streaming Viterbi gets the optimal score; with no forced decisions
+ * (which a window D >= L guarantees), its path has that score.
+ */
+static void
+utest_viterbi_stream(ESL_RANDOMNESS *r, const ESL_HMM *hmm, int L, int D)
+{
+  char     msg[] = "hmm viterbi stream utest failed";
+  ESL_DSQ *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  int     *path  = malloc(sizeof(int)     * (L+1));
+  int64_t  nforced;
+  double   osc;
+  float    sc;
+  int      i;
+
+  if (! dsq || ! path) esl_fatal(msg);
+  dsq[0] = dsq[L+1] = eslDSQ_SENTINEL;
+  for (i = 1; i <= L; i++) dsq[i] = esl_rnd_Roll(r, hmm->abc->K);
+
+  if (esl_hmm_ViterbiStream(dsq, L, hmm, D, path, &sc, &nforced) != eslOK) esl_fatal(msg);
+  osc = viterbi_oracle(dsq, L, hmm);
+
+  if (esl_DCompare(sc, osc, 1e-4)     != eslOK)     esl_fatal("%s: sc %f != %f", msg, sc, osc);
+  if (nforced < 0 || nforced > L)                   esl_fatal(msg);
+  if (D >= L && nforced != 0)                       esl_fatal(msg);
+  for (i = 1; i <= L; i++)
+    if (path[i] < 0 || path[i] >= hmm->M)           esl_fatal(msg);
+  if (nforced == 0 && esl_DCompare(path_logp(dsq, L, hmm, path), osc, 1e-4) != eslOK) esl_fatal(msg);
+
+  free(path);
+  free(dsq);
+}
+
+/* utest_batch()
+ * Score a few blocks of random sequences with an ESL_HMM_BATCH with
+ * <ncpu> workers, given alternately as ESL_SQ_BLOCKs and
+ * ESL_DSQDATA_CHUNKs, for each vector layout; the third block is
+ * scored with inter-sequence scoring turned off. Scores must match
+ * esl_hmm_ForwardScore(). Lengths vary widely, including 0 and 1, so
+ * lanes of the inter-sequence kernels end at different rows.
+ */
+static void
+utest_batch(ESL_RANDOMNESS *r, const ESL_ALPHABET *abc, int M, int do_band, int ncpu)
+{
+  char               msg[]   = "hmm batch utest failed";
+  ESL_HMM           *hmm     = make_random_hmm(r, abc, M, do_band);
+  ESL_HMX           *mx      = esl_hmx_Create(0, M);
+  ESL_HMM_BATCH     *bat     = NULL;
+  ESL_SQ_BLOCK      *sqblock = NULL;
+  ESL_DSQDATA_CHUNK  chu;
+  float             *sc      = NULL;
+  float              sc0;
+  int                N       = 600;      // > eslHMM_BATCH_B, so workers share blocks
+  int                nblocks = 3;
+  int                b, i, j, simd;
+  int                status;
+
+  ESL_ALLOC(sc,      sizeof(float)     * N);
+  ESL_ALLOC(chu.dsq, sizeof(ESL_DSQ *) * N);
+  ESL_ALLOC(chu.L,   sizeof(int64_t)   * N);
+  if ((sqblock = esl_sq_CreateDigitalBlock(N, abc)) == NULL) esl_fatal(msg);
+
+  for (simd = eslHMM_SERIAL; simd <= eslHMM_AVX; simd++)
+    if (hmm_is_available(simd))
+      {
+	if (hmm_configure(hmm, NULL, simd)            != eslOK) esl_fatal(msg);
+	if ((bat = esl_hmm_batch_Create(hmm, ncpu)) == NULL)  esl_fatal(msg);
+
+	for (b = 0; b < nblocks; b++)
+	  {
+	    for (i = 0; i < N; i++)
+	      {
+		ESL_SQ *sq = &(sqblock->list[i]);
+		int     L  = (esl_rnd_Roll(r, 10) ? esl_rnd_Roll(r, 300) : esl_rnd_Roll(r, 2));
+
+		if (esl_sq_GrowTo(sq, 300) != eslOK) esl_fatal(msg);
+		sq->dsq[0] = sq->dsq[L+1] = eslDSQ_SENTINEL;
+		for (j = 1; j <= L; j++) sq->dsq[j] = esl_rnd_Roll(r, abc->Kp);
+		sq->n = L;
+
+		chu.dsq[i] = sq->dsq;
+		chu.L[i]   = L;
+	      }
+	    sqblock->count = chu.N = N;
+
+	    bat->inter = (b < 2);
+	    if (b % 2 == 0) { if (esl_hmm_batch_ScoreBlock(bat, sqblock, sc) != eslOK) esl_fatal(msg); }
+	    else            { if (esl_hmm_batch_ScoreChunk(bat, &chu,    sc) != eslOK) esl_fatal(msg); }
+
+	    for (i = 0; i < N; i++)
+	      {
+		if (esl_hmm_ForwardScore(chu.dsq[i], chu.L[i], hmm, mx, &sc0) != eslOK) esl_fatal(msg);
+		if (b == 2 && sc[i] != sc0)                                          esl_fatal("%s: simd %d, seq %d: %f != %f", msg, simd, i, sc[i], sc0);
+		if (esl_FCompareAbs(sc[i], sc0, 1e-3) != eslOK)                      esl_fatal("%s: simd %d, seq %d: %f != %f", msg, simd, i, sc[i], sc0);
+	      }
+	  }
+	if (bat->nseq != N * nblocks) esl_fatal(msg);
+	esl_hmm_batch_Reuse(bat);
+	if (bat->nseq != 0)           esl_fatal(msg);
+	esl_hmm_batch_Destroy(bat);
+      }
+
+  esl_sq_DestroyBlock(sqblock);
+  free(chu.dsq);
+  free(chu.L);
+  free(sc);
+  esl_hmx_Destroy(mx);
+  esl_hmm_Destroy(hmm);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+#endif /*eslHMM_TESTDRIVE*/
+
   
 /*****************************************************************
  * x. Test driver.
@@ -540,6 +2020,7 @@ make_occasionally_dishonest_casino(ESL_HMM **ret_hmm, ESL_ALPHABET **ret_abc)
 #include "esl_alphabet.h"
 #include "esl_getopts.h"
 #include "esl_hmm.h"
+#include "esl_random.h"
 
 static ESL_OPTIONS options[] = {
   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
@@ -557,7 +2038,9 @@ main(int argc, char **argv)
   ESL_GETOPTS    *go         = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
   ESL_RANDOMNESS *r          = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
   ESL_ALPHABET   *abc        = NULL;
+  ESL_ALPHABET   *dna        = esl_alphabet_Create(eslDNA);
   ESL_HMM        *hmm        = NULL;
+  ESL_HMM        *rhm        = NULL;
   ESL_DSQ        *dsq        = NULL;
   int            *path       = NULL;
   ESL_HMX        *fwd        = NULL;
@@ -569,8 +2052,39 @@ main(int argc, char **argv)
   int             i;
   float           fsum, bsum;
 
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(r));
+
+  utest_vector(r, dna,  2,  100, FALSE);
+  utest_vector(r, dna,  7,  100, FALSE);
+  utest_vector(r, dna,  40,  50, FALSE);
+  utest_vector(r, dna,  7,  100, TRUE);
+  utest_vector(r, dna,  37, 100, TRUE);
+  utest_vector(r, dna,  1,   20, FALSE);
+  utest_vector(r, dna,  5,    1, TRUE);
+
+  utest_ckpt(r, dna,  1,  50, FALSE);
+  utest_ckpt(r, dna,  7,   1, FALSE);
+  utest_ckpt(r, dna,  7, 200, FALSE);
+  utest_ckpt(r, dna, 20, 143, TRUE);
+
+  utest_batch(r, dna,  3, FALSE, 0);
+  utest_batch(r, dna, 12, FALSE, 2);
+  utest_batch(r, dna, 30, TRUE,  0);
+
   make_occasionally_dishonest_casino(&hmm, &abc);
 
+  utest_viterbi_stream(r, hmm, 1,    2);
+  utest_viterbi_stream(r, hmm, 300, 300);
+  utest_viterbi_stream(r, hmm, 300,  8);
+  utest_viterbi_stream(r, hmm, 1000, 64);
+
+  rhm = make_random_hmm(r, dna, 6, TRUE);
+  esl_hmm_Configure(rhm, NULL);
+  utest_viterbi_stream(r, rhm, 200, 200);
+  utest_viterbi_stream(r, rhm, 200, 16);
+  esl_hmm_Destroy(rhm);
+
   esl_hmm_Emit(r, hmm, &dsq, &path, &L);
 
   fwd = esl_hmx_Create(L, hmm->M);
@@ -612,9 +2126,12 @@ main(int argc, char **argv)
   esl_hmx_Destroy(bck);
   esl_hmx_Destroy(fwd);
   esl_alphabet_Destroy(abc);
+  esl_alphabet_Destroy(dna);
   esl_hmm_Destroy(hmm);
   esl_randomness_Destroy(r);
   esl_getopts_Destroy(go);
+
+  fprintf(stderr, "#  status = ok\n");
   return 0;
 }
 #endif /*eslHMM_TESTDRIVE*/
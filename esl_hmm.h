@@ -6,9 +6,24 @@
 #define eslHMM_INCLUDED
 #include "esl_config.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "esl_alphabet.h"
+#include "esl_dsqdata.h"
 #include "esl_random.h"
+#include "esl_sq.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
 
+/* Which implementation esl_hmm_Configure() laid an HMM out for:
+ * ESL_HMM.simd
+ */
+#define eslHMM_SERIAL  0
+#define eslHMM_SSE     1
+#define eslHMM_AVX     2
 
 typedef struct {
   int     M;                    /* number of states in the model          */
@@ -19,6 +34,22 @@ typedef struct {
 
   float **eo;			/* K'xM emission odds ratios              */
   const ESL_ALPHABET *abc;      /* ptr to alphabet                        */
+
+  /* Vector layouts, made by esl_hmm_Configure(). Rows are padded to
+   * Mp floats with zeros and aligned. Dense: tv[m*Mp+k] = t[m][k] for
+   * Forward, and the transpose tvT[m*Mp+k] = t[k][m] for Backward.
+   * Banded (nd > 0; t[m][k] = 0 unless dlo <= k-m <= dhi): diagonals,
+   * tv[(d-dlo)*Mp+k] = t[k-d][k] and tvT[(d-dlo)*Mp+k] = t[k][k+d].
+   */
+  int     simd;                 /* eslHMM_SERIAL | eslHMM_SSE | eslHMM_AVX */
+  int     V;                    /* floats per vector (4, 8); 0 for serial */
+  int     Mp;                   /* M rounded up to a multiple of V        */
+  int     nd;                   /* # of diagonals if banded; 0 if dense   */
+  int     dlo, dhi;             /* band of nonzero transitions, k-m       */
+  int     pad;                  /* zero margin for DP rows, for the band  */
+  float  *tv;                   /* Forward transitions, dense or banded   */
+  float  *tvT;                  /* Backward transitions, dense or banded  */
+  float  *eov;                  /* K'xMp padded emission odds ratios      */
 } ESL_HMM;
 
 typedef struct {
@@ -32,8 +63,56 @@ typedef struct {
   int       validR; 		/* # of dp rows actually pointing at DP memory           */
   int       allocM;		/* current set row width; M <= allocM                    */
   uint64_t  ncells;		/* total allocation of dp_mem; ncells >= (validR)(allocM)*/
+
+  float    *vmem;		/* scratch DP rows: vector and low-memory implementations*/
+  uint64_t  nvcells;		/* allocation of vmem, in floats                         */
 } ESL_HMX;
 
+/* ESL_HMM_BATCH
+ * Scores many sequences against one HMM (Forward log likelihoods),
+ * given in blocks (ESL_SQ_BLOCK or ESL_DSQDATA_CHUNK), across a pool
+ * of worker threads, each with its own ESL_HMX.
+ *
+ * If <inter> is TRUE, sequences are scored inter-sequence: a block is
+ * sorted by length, and runs of sequences of similar length are
+ * scored together, one per vector lane. Otherwise each is scored by
+ * esl_hmm_ForwardScore().
+ */
+#define eslHMM_BATCH_B  256     // number of sequences a worker takes at a time
+
+typedef struct {
+  const ESL_HMM *hmm;           // the model (a copy of the ptr)
+  int       ncpu;               // number of worker threads; 0 = do everything in the caller's thread
+  int       inter;              // TRUE to score inter-sequence, if hmm->simd has a kernel for it
+  int64_t   nseq;               // number of sequences scored so far
+
+  /* nonzero transitions among states, by destination state k:
+   * t[tm[j]][k] = tv[j], for j = tp[k]..tp[k+1]-1, in increasing tm */
+  int      *tp;                 // [0..M]
+  int      *tm;                 // [0..tp[M]-1]
+  float    *tv;                 // [0..tp[M]-1]
+
+  /* sequences in the block being scored */
+  const ESL_DSQ **dsq;          // dsq[0..n-1][1..L[i]]
+  int64_t  *L;                  // lengths [0..n-1]
+  float    *sc;                 // scores [0..n-1]
+  int      *ord;                // [0..n-1], indices sorted by length
+  int       n;                  // number of sequences in the block
+  int       nalloc;             // allocation of <dsq>, <L>, <sc>, <ord>
+
+  ESL_HMX **mx;                 // mx[0..ncpu-1] for workers; mx[ncpu] for the caller
+#ifdef HAVE_PTHREAD
+  ESL_THREADS     *thr;         // worker pool; NULL if ncpu == 0
+  pthread_mutex_t  mutex;       // protects the rest of these:
+  pthread_cond_t   cv;          // signals a new block, or finished workers
+  int              next;        // next position in <ord> for a worker to take
+  int              nbusy;       // number of workers still on this block
+  int              block;       // block number, so workers know there's a new one
+  int              done;        // TRUE when workers should exit
+  int              status;      // first error status from a worker, or eslOK
+#endif
+} ESL_HMM_BATCH;
+
 
 
 extern ESL_HMM *esl_hmm_Create(const ESL_ALPHABET *abc, int M);
@@ -49,6 +128,32 @@ extern void     esl_hmx_Destroy(ESL_HMX *mx);
 extern int      esl_hmm_Emit(ESL_RANDOMNESS *r, const ESL_HMM *hmm, ESL_DSQ **opt_dsq, int **opt_path, int *opt_L);
 extern int      esl_hmm_Forward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *fwd, float *opt_sc);
 extern int      esl_hmm_Backward(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *bck, float *opt_sc);
+extern int      esl_hmm_PosteriorDecoding(const ESL_DSQ *dsq, int L, const ESL_HMM *hmm, ESL_HMX *fwd, ESL_HMX *bck, ESL_HMX *pp);
+extern int      esl_hmm_ForwardScore(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, ESL_HMX *mx, float *ret_sc);
+extern int      esl_hmm_PosteriorDecodingCkpt(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, ESL_HMX *mx, int *opt_path, float *opt_pp, float *opt_sc);
+extern int      esl_hmm_ViterbiStream(const ESL_DSQ *dsq, int64_t L, const ESL_HMM *hmm, int D, int *path, float *opt_sc, int64_t *opt_nforced);
+
+extern ESL_HMM_BATCH *esl_hmm_batch_Create(const ESL_HMM *hmm, int ncpu);
+extern int            esl_hmm_batch_ScoreBlock(ESL_HMM_BATCH *bat, const ESL_SQ_BLOCK *sqblock, float *opt_sc);
+extern int            esl_hmm_batch_ScoreChunk(ESL_HMM_BATCH *bat, const ESL_DSQDATA_CHUNK *chu, float *opt_sc);
+extern int            esl_hmm_batch_Reuse(ESL_HMM_BATCH *bat);
+extern void           esl_hmm_batch_Destroy(ESL_HMM_BATCH *bat);
+
+/* Vector kernels: esl_hmm_{sse,avx}.c. The row kernels calculate one
+ * scaled Forward or Backward DP row; the inter kernels score
+ * <n> (up to 4 or 8) sequences <idx[0..n-1]> of a batch's block
+ * together, using <dp>, 2*M vectors of aligned workspace.
+ */
+#ifdef eslENABLE_SSE
+extern float esl_hmm_fwdrow_sse(const ESL_HMM *hmm, ESL_DSQ x, const float *prv, float *cur);
+extern float esl_hmm_bckrow_sse(const ESL_HMM *hmm, ESL_DSQ x, const float *nxt, float *tmp, float *cur);
+extern void  esl_hmm_inter_sse (const ESL_HMM_BATCH *bat, const int *idx, int n, float *dp);
+#endif
+#ifdef eslENABLE_AVX
+extern float esl_hmm_fwdrow_avx(const ESL_HMM *hmm, ESL_DSQ x, const float *prv, float *cur);
+extern float esl_hmm_bckrow_avx(const ESL_HMM *hmm, ESL_DSQ x, const float *nxt, float *tmp, float *cur);
+extern void  esl_hmm_inter_avx (const ESL_HMM_BATCH *bat, const int *idx, int n, float *dp);
+#endif
 
 
 #endif /*eslHMM_INCLUDED*/
@@ -0,0 +1,292 @@
+/* Forward/Backward DP rows for discrete HMMs: AVX2 implementation.
+ *
+ * esl_hmm_Forward() and esl_hmm_Backward() call these for an ESL_HMM
+ * that esl_hmm_Configure() laid out for AVX2 (<hmm->simd ==
+ * eslHMM_AVX>). See esl_hmm_sse.c for notes; this is the same code,
+ * eight states at a time, and esl_hmm_inter_avx() scores eight
+ * sequences at a time, gathering their emission odds.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX
+
+#include <math.h>
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_hmm.h"
+#include "esl_avx.h"
+
+/* matvec_dense()
+ * out[k] = ev[k] \sum_{m=0}^{M-1} in[m] A[m*Mp+k], for k = 0..Mp-1;
+ * <ev> is optional (NULL: don't multiply). Returns max_k out[k].
+ */
+static float
+matvec_dense(const float *in, const float *A, int M, int Mp, const float *ev, float *out)
+{
+  __m256 maxv = _mm256_setzero_ps();
+  __m256 a0, a1, a2, a3, p;
+  float  max;
+  int    k, m;
+
+  for (k = 0; k + 32 <= Mp; k += 32)
+    {
+      a0 = a1 = a2 = a3 = _mm256_setzero_ps();
+      for (m = 0; m < M; m++)
+	{
+	  p  = _mm256_set1_ps(in[m]);
+	  a0 = _mm256_add_ps(a0, _mm256_mul_ps(p, _mm256_load_ps(A + m*Mp + k)));
+	  a1 = _mm256_add_ps(a1, _mm256_mul_ps(p, _mm256_load_ps(A + m*Mp + k + 8)));
+	  a2 = _mm256_add_ps(a2, _mm256_mul_ps(p, _mm256_load_ps(A + m*Mp + k + 16)));
+	  a3 = _mm256_add_ps(a3, _mm256_mul_ps(p, _mm256_load_ps(A + m*Mp + k + 24)));
+	}
+      if (ev) {
+	a0 = _mm256_mul_ps(a0, _mm256_load_ps(ev + k));
+	a1 = _mm256_mul_ps(a1, _mm256_load_ps(ev + k + 8));
+	a2 = _mm256_mul_ps(a2, _mm256_load_ps(ev + k + 16));
+	a3 = _mm256_mul_ps(a3, _mm256_load_ps(ev + k + 24));
+      }
+      _mm256_store_ps(out + k,      a0);
+      _mm256_store_ps(out + k + 8,  a1);
+      _mm256_store_ps(out + k + 16, a2);
+      _mm256_store_ps(out + k + 24, a3);
+      maxv = _mm256_max_ps(maxv, _mm256_max_ps(_mm256_max_ps(a0, a1), _mm256_max_ps(a2, a3)));
+    }
+  for (; k < Mp; k += 8)
+    {
+      a0 = _mm256_setzero_ps();
+      for (m = 0; m < M; m++)
+	a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_set1_ps(in[m]), _mm256_load_ps(A + m*Mp + k)));
+      if (ev) a0 = _mm256_mul_ps(a0, _mm256_load_ps(ev + k));
+      _mm256_store_ps(out + k, a0);
+      maxv = _mm256_max_ps(maxv, a0);
+    }
+  esl_avx_hmax_ps(maxv, &max);
+  return max;
+}
+
+/* matvec_band()
+ * out[k] = ev[k] \sum_{c=0}^{nd-1} in[k+c] A[c*astride+k], for k = 0..Mp-1;
+ * <ev> is optional. <in> is unaligned, offset by the caller to the
+ * first diagonal, and must be readable from in[0] to in[Mp+nd-2].
+ * Returns max_k out[k].
+ */
+static float
+matvec_band(const float *in, const float *A, int nd, int astride, int Mp, const float *ev, float *out)
+{
+  __m256 maxv = _mm256_setzero_ps();
+  __m256 a0, a1, a2, a3;
+  float  max;
+  int    k, c;
+
+  for (k = 0; k + 32 <= Mp; k += 32)
+    {
+      a0 = a1 = a2 = a3 = _mm256_setzero_ps();
+      for (c = 0; c < nd; c++)
+	{
+	  a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_loadu_ps(in + k + c),      _mm256_load_ps(A + c*astride + k)));
+	  a1 = _mm256_add_ps(a1, _mm256_mul_ps(_mm256_loadu_ps(in + k + c + 8),  _mm256_load_ps(A + c*astride + k + 8)));
+	  a2 = _mm256_add_ps(a2, _mm256_mul_ps(_mm256_loadu_ps(in + k + c + 16),  _mm256_load_ps(A + c*astride + k + 16)));
+	  a3 = _mm256_add_ps(a3, _mm256_mul_ps(_mm256_loadu_ps(in + k + c + 24), _mm256_load_ps(A + c*astride + k + 24)));
+	}
+      if (ev) {
+	a0 = _mm256_mul_ps(a0, _mm256_load_ps(ev + k));
+	a1 = _mm256_mul_ps(a1, _mm256_load_ps(ev + k + 8));
+	a2 = _mm256_mul_ps(a2, _mm256_load_ps(ev + k + 16));
+	a3 = _mm256_mul_ps(a3, _mm256_load_ps(ev + k + 24));
+      }
+      _mm256_store_ps(out + k,      a0);
+      _mm256_store_ps(out + k + 8,  a1);
+      _mm256_store_ps(out + k + 16, a2);
+      _mm256_store_ps(out + k + 24, a3);
+      maxv = _mm256_max_ps(maxv, _mm256_max_ps(_mm256_max_ps(a0, a1), _mm256_max_ps(a2, a3)));
+    }
+  for (; k < Mp; k += 8)
+    {
+      a0 = _mm256_setzero_ps();
+      for (c = 0; c < nd; c++)
+	a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_loadu_ps(in + k + c), _mm256_load_ps(A + c*astride + k)));
+      if (ev) a0 = _mm256_mul_ps(a0, _mm256_load_ps(ev + k));
+      _mm256_store_ps(out + k, a0);
+      maxv = _mm256_max_ps(maxv, a0);
+    }
+  esl_avx_hmax_ps(maxv, &max);
+  return max;
+}
+
+/* rescale()
+ * Divide row <v[0..Mp-1]> by <max>.
+ */
+static void
+rescale(float *v, int Mp, float max)
+{
+  __m256 d = _mm256_set1_ps(max);
+  int    k;
+
+  for (k = 0; k < Mp; k += 8)
+    _mm256_store_ps(v + k, _mm256_div_ps(_mm256_load_ps(v + k), d));
+}
+
+
+/* Function:  esl_hmm_fwdrow_avx()
+ * Synopsis:  One Forward DP row, AVX2 version.
+ *
+ * Purpose:   Given the previous scaled Forward row <prv> and residue
+ *            <x>, calculate the next row <cur>, scale it by its maximum
+ *            value, and return that maximum (for the row's scale
+ *            factor, <log(max)>).
+ *
+ *            Rows are <hmm->Mp> floats, 32-byte aligned, with
+ *            elements <M..Mp-1> zero. For a banded model, <prv> must
+ *            also have <hmm->pad> zeros on each side.
+ */
+float
+esl_hmm_fwdrow_avx(const ESL_HMM *hmm, ESL_DSQ x, const float *prv, float *cur)
+{
+  const float *ev = hmm->eov + (size_t) x * hmm->Mp;
+  float        max;
+
+  /* Banded: diagonal d = k-m runs dhi..dlo, so m = k-d is increasing. */
+  if (hmm->nd) max = matvec_band (prv - hmm->dhi, hmm->tv + (hmm->nd-1) * hmm->Mp, hmm->nd, -hmm->Mp, hmm->Mp, ev, cur);
+  else         max = matvec_dense(prv, hmm->tv, hmm->M, hmm->Mp, ev, cur);
+  rescale(cur, hmm->Mp, max);
+  return max;
+}
+
+
+/* Function:  esl_hmm_bckrow_avx()
+ * Synopsis:  One Backward DP row, AVX2 version.
+ *
+ * Purpose:   Given the next scaled Backward row <nxt> and the residue
+ *            <x> emitted there, calculate row <cur>, scale it by its
+ *            maximum value, and return that maximum. <tmp> is a
+ *            scratch row, which gets <nxt> times the emission odds.
+ *
+ *            Rows are as for <esl_hmm_fwdrow_avx()>; for a banded
+ *            model, it's <tmp> that needs the zeroed margins.
+ */
+float
+esl_hmm_bckrow_avx(const ESL_HMM *hmm, ESL_DSQ x, const float *nxt, float *tmp, float *cur)
+{
+  const float *ev = hmm->eov + (size_t) x * hmm->Mp;
+  float        max;
+  int          k;
+
+  for (k = 0; k < hmm->Mp; k += 8)
+    _mm256_store_ps(tmp + k, _mm256_mul_ps(_mm256_load_ps(nxt + k), _mm256_load_ps(ev + k)));
+
+  if (hmm->nd) max = matvec_band (tmp + hmm->dlo, hmm->tvT, hmm->nd, hmm->Mp, hmm->Mp, NULL, cur);
+  else         max = matvec_dense(tmp, hmm->tvT, hmm->M, hmm->Mp, NULL, cur);
+  rescale(cur, hmm->Mp, max);
+  return max;
+}
+
+
+/* Function:  esl_hmm_inter_avx()
+ * Synopsis:  Forward scores of eight sequences at once, AVX2 version.
+ *
+ * Purpose:   Calculate the Forward log likelihoods of up to eight
+ *            sequences <idx[0..n-1]> of batch <bat>'s current block,
+ *            one per vector lane, and store them in <bat->sc>. <dp>
+ *            is workspace for two rows of <M> vectors, 32-byte
+ *            aligned.
+ *
+ *            The model's transitions are taken from the batch's
+ *            sparse copy, by destination state. Lanes whose sequence
+ *            has ended (or that have none) see missing data, with
+ *            emission odds 1, and go on harmlessly until the longest
+ *            sequence ends; the batch groups sequences of similar
+ *            length to keep that waste small.
+ *
+ *            Each lane's row is scaled by a power of two, $2^{-e}$
+ *            for the binary exponent $e$ of its maximum, so scaling
+ *            costs one multiply per state and no <log()>; the
+ *            exponents are summed as integers.
+ */
+void
+esl_hmm_inter_avx(const ESL_HMM_BATCH *bat, const int *idx, int n, float *dp)
+{
+  const ESL_HMM *hmm   = bat->hmm;
+  int            M     = hmm->M;
+  ESL_DSQ        xmiss = hmm->abc->Kp - 1;
+  const ESL_DSQ *dsq[8];
+  int32_t        xo[8];
+  int64_t        L[8];
+  int64_t        Lmax  = 0;
+  __m256        *prv   = (__m256 *) dp;
+  __m256        *cur   = prv + M;
+  __m256        *swp;
+  __m256i        E     = _mm256_setzero_si256();
+  __m256i        ebits, xoff;
+  __m256         sv, mv;
+  float          endsc[8];
+  int32_t        e[8];
+  int64_t        i;
+  int            j, k, z, nend;
+
+  for (z = 0; z < 8; z++)
+    {
+      dsq[z] = (z < n ? bat->dsq[idx[z]] : NULL);
+      L[z]   = (z < n ? bat->L[idx[z]]   : 0);
+      Lmax   = ESL_MAX(Lmax, L[z]);
+      if (z < n && L[z] == 0) bat->sc[idx[z]] = log(hmm->pi[M]);
+    }
+
+  for (i = 1; i <= Lmax; i++)
+    {
+      for (z = 0, nend = 0; z < 8; z++)
+	{
+	  xo[z] = (int32_t) (i <= L[z] ? dsq[z][i] : xmiss) * M;
+	  if (L[z] == i) nend++;
+	}
+
+      xoff = _mm256_loadu_si256((__m256i *) xo);
+      mv   = _mm256_setzero_ps();
+      for (k = 0; k < M; k++)
+	{
+	  if (i == 1) sv = _mm256_set1_ps(hmm->pi[k]);
+	  else
+	    {
+	      sv = _mm256_setzero_ps();
+	      for (j = bat->tp[k]; j < bat->tp[k+1]; j++)
+		sv = _mm256_add_ps(sv, _mm256_mul_ps(prv[bat->tm[j]], _mm256_set1_ps(bat->tv[j])));
+	    }
+	  cur[k] = _mm256_mul_ps(sv, _mm256_i32gather_ps(hmm->eo[0] + k, xoff, 4));
+	  mv     = _mm256_max_ps(mv, cur[k]);
+	}
+
+      /* Scale each lane by 2^(127-ebits), for its max's biased
+       * exponent <ebits>; a lane of zeros (or denormals) isn't
+       * scaled, and huge ones are capped so the factor stays normal.
+       */
+      ebits = _mm256_and_si256(_mm256_srli_epi32(_mm256_castps_si256(mv), 23), _mm256_set1_epi32(0xff));
+      ebits = _mm256_blendv_epi8(ebits, _mm256_set1_epi32(127), _mm256_cmpeq_epi32(ebits, _mm256_setzero_si256()));
+      ebits = _mm256_min_epi32(ebits, _mm256_set1_epi32(253));
+      sv    = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(254), ebits), 23));
+      for (k = 0; k < M; k++)
+	cur[k] = _mm256_mul_ps(cur[k], sv);
+      E = _mm256_add_epi32(E, _mm256_sub_epi32(ebits, _mm256_set1_epi32(127)));
+
+      if (nend)
+	{
+	  sv = _mm256_setzero_ps();
+	  for (k = 0; k < M; k++)
+	    sv = _mm256_add_ps(sv, _mm256_mul_ps(cur[k], _mm256_set1_ps(hmm->t[k][M])));
+	  _mm256_storeu_ps(endsc, sv);
+	  _mm256_storeu_si256((__m256i *) e, E);
+	  for (z = 0; z < n; z++)
+	    if (L[z] == i) bat->sc[idx[z]] = (double) e[z] * eslCONST_LOG2 + log(endsc[z]);
+	}
+
+      swp = prv; prv = cur; cur = swp;
+    }
+}
+
+
+#else // ! eslENABLE_AVX
+void esl_hmm_avx_silence_hack(void) { return; }
+#endif // eslENABLE_AVX or not
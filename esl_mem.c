@@ -13,10 +13,29 @@
 #include <limits.h>
 #include <string.h>
 #include <ctype.h>
+#if defined(eslENABLE_SSE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "easel.h"
 #include "esl_mem.h"
 
+/* A delimiter class, for esl_memtok(), esl_memspn(), esl_memcspn().
+ * <bits> is a 256-bit membership bitmap; <c[0..nc-1]> are the distinct
+ * members, used by the SIMD scan when there are few of them (as
+ * there almost always are: " \t", " \t\r\n"...).
+ */
+#define eslMEM_SIMDSET 8   // max # of distinct chars in a class that we scan with SIMD compares
+
+typedef struct {
+  uint64_t bits[4];
+  int      nc;
+  char     c[eslMEM_SIMDSET];
+} ESL_MEM_CHARSET;
+
+static void      mem_charset_init(ESL_MEM_CHARSET *cs, const char *set);
+static esl_pos_t mem_charset_span(const char *p, esl_pos_t n, const ESL_MEM_CHARSET *cs, int in_set);
+
 /*****************************************************************
  *# 1. The esl_mem*() API.
  *****************************************************************/
@@ -525,12 +544,14 @@ esl_memnewline(const char *m, esl_pos_t n, esl_pos_t *ret_nline, int *ret_nterm)
 int
 esl_memtok(char **p, esl_pos_t *n, const char *delim, char **ret_tok, esl_pos_t *ret_toklen)
 {
-  char     *s   = *p;
-  esl_pos_t so, xo, eo;
-
-  for (so = 0;  so < *n; so++) if (strchr(delim, s[so]) == NULL)  break;
-  for (xo = so; xo < *n; xo++) if (strchr(delim, s[xo]) != NULL)  break; 
-  for (eo = xo; eo < *n; eo++) if (strchr(delim, s[eo]) == NULL)  break; 
+  char          *s   = *p;
+  ESL_MEM_CHARSET cs;
+  esl_pos_t      so, xo, eo;
+
+  mem_charset_init(&cs, delim);
+  so =      mem_charset_span(s,      *n,      &cs, TRUE);
+  xo = so + mem_charset_span(s + so, *n - so, &cs, FALSE);
+  eo = xo + mem_charset_span(s + xo, *n - xo, &cs, TRUE);
   
   if (so == *n) {                     *ret_tok = NULL;   *ret_toklen = 0;       return eslEOL; }
   else          { *p += eo; *n -= eo; *ret_tok = s + so; *ret_toklen = xo - so; return eslOK;  }
@@ -550,9 +571,9 @@ esl_memtok(char **p, esl_pos_t *n, const char *delim, char **ret_tok, esl_pos_t
 esl_pos_t
 esl_memspn(char *p, esl_pos_t n, const char *allow)
 {
-  esl_pos_t so;
-  for (so = 0; so < n; so++) if (strchr(allow, p[so]) == NULL) break;
-  return so;
+  ESL_MEM_CHARSET cs;
+  mem_charset_init(&cs, allow);
+  return mem_charset_span(p, n, &cs, TRUE);
 }
 
 /* Function:  esl_memcspn()
@@ -565,9 +586,9 @@ esl_memspn(char *p, esl_pos_t n, const char *allow)
 esl_pos_t
 esl_memcspn(char *p, esl_pos_t n, const char *disallow)
 {
-  esl_pos_t so;
-  for (so = 0; so < n; so++) if (strchr(disallow, p[so]) != NULL) break;
-  return so;
+  ESL_MEM_CHARSET cs;
+  mem_charset_init(&cs, disallow);
+  return mem_charset_span(p, n, &cs, FALSE);
 }
 
 /* Function:  esl_memstrcmp()
@@ -875,6 +896,84 @@ esl_mem_IsReal(const char *p, esl_pos_t n)
 /*----------------- end, esl_mem*() API  ------------------------*/
 
 
+/*****************************************************************
+ * (private) delimiter class scanning
+ *****************************************************************/
+
+/* mem_charset_init()
+ * Set up delimiter class <cs> for the chars in string <set>.
+ * 
+ * The NUL byte is always a member. The original
+ * <strchr(set, c)> implementations of esl_memtok(), esl_memspn(),
+ * and esl_memcspn() matched a NUL in the input against <set>'s
+ * own terminator, and we preserve that behavior exactly.
+ */
+static void
+mem_charset_init(ESL_MEM_CHARSET *cs, const char *set)
+{
+  unsigned char c;
+
+  cs->bits[0] = cs->bits[1] = cs->bits[2] = cs->bits[3] = 0;
+  cs->bits[0] = 1;   // '\0'
+  cs->c[0]    = '\0';
+  cs->nc      = 1;
+  for (; *set; set++)
+    {
+      c = (unsigned char) *set;
+      if (cs->bits[c >> 6] & ((uint64_t) 1 << (c & 63))) continue;  // duplicate
+      cs->bits[c >> 6] |= ((uint64_t) 1 << (c & 63));
+      if (cs->nc < eslMEM_SIMDSET) cs->c[cs->nc] = c;
+      cs->nc++;
+    }
+}
+
+/* mem_charset_span()
+ * If <in_set> is TRUE, return the length of the prefix of <p[0..n-1]>
+ * consisting only of members of <cs> (like strspn()); else, of
+ * nonmembers (like strcspn()).
+ * 
+ * With SSE2, classes of up to <eslMEM_SIMDSET> chars are scanned 16
+ * bytes at a time: compare against each member, OR the results, and
+ * take a movemask. When a 16-byte block contains the stopping
+ * character, or for the ragged end, we fall through to the scalar
+ * bitmap lookup to find exactly where.
+ */
+static esl_pos_t
+mem_charset_span(const char *p, esl_pos_t n, const ESL_MEM_CHARSET *cs, int in_set)
+{
+  esl_pos_t i = 0;
+  unsigned char c;
+
+#if defined(eslENABLE_SSE) && defined(__SSE2__)
+  if (cs->nc <= eslMEM_SIMDSET)
+    {
+      __m128i vc[eslMEM_SIMDSET];
+      __m128i x, m;
+      int     k, mask;
+
+      for (k = 0; k < cs->nc; k++) vc[k] = _mm_set1_epi8(cs->c[k]);
+      for (; i + 16 <= n; i += 16)
+	{
+	  x = _mm_loadu_si128((const __m128i *) (p + i));
+	  m = _mm_cmpeq_epi8(x, vc[0]);
+	  for (k = 1; k < cs->nc; k++) m = _mm_or_si128(m, _mm_cmpeq_epi8(x, vc[k]));
+	  mask = _mm_movemask_epi8(m);
+	  if (in_set ? (mask != 0xffff) : (mask != 0)) break;
+	}
+    }
+#endif
+
+  for (; i < n; i++)
+    {
+      c = (unsigned char) p[i];
+      if ( ((cs->bits[c >> 6] >> (c & 63)) & 1) != (uint64_t) in_set) break;
+    }
+  return i;
+}
+/*------------- end, delimiter class scanning -------------------*/
+
+
+
 /*****************************************************************
  * 2. Benchmark driver.
  *****************************************************************/
@@ -1211,6 +1310,58 @@ utest_memspn_memcspn(void)
   if (esl_memcspn(p, n, " \t\n\r") != 4) esl_fatal(msg);
 }
 
+/* utest_charset_scans()
+ * The vectorized/bitmap scans in esl_memspn(), esl_memcspn(), and
+ * esl_memtok() must give exactly the same results as the original
+ * strchr()-based loops, including on NUL bytes, on high-bit chars,
+ * on long delimiter sets that can't use SIMD, and on every alignment
+ * of the ragged end of a buffer.
+ */
+static void
+utest_charset_scans(ESL_RANDOMNESS *rng)
+{
+  char      msg[]    = "delimiter class scan unit test failed";
+  char      alph[]   = " \t\r\nab|#=/\0\377";   // small alphabet, so runs of members/nonmembers are common
+  char      buf[256];
+  char      set[32];
+  char     *s, *tok;
+  esl_pos_t n, n2, toklen, so, xo, eo, i;
+  int       nset, k, trial;
+
+  for (trial = 0; trial < 2000; trial++)
+    {
+      n = esl_rnd_Roll(rng, sizeof(buf)+1);
+      for (i = 0; i < n; i++) 
+	buf[i] = (esl_rnd_Roll(rng, 4) == 0 ? (char) esl_rnd_Roll(rng, 256) : alph[esl_rnd_Roll(rng, sizeof(alph)-1)]);
+
+      nset = esl_rnd_Roll(rng, (trial % 2) ? 5 : 20);   // half the time a short SIMD-able set, half the time possibly long
+      for (k = 0; k < nset; k++) 
+	do { set[k] = (char) (1 + esl_rnd_Roll(rng, 255)); } while (set[k] == '\0');
+      set[nset] = '\0';
+      
+      for (so = 0; so < n; so++) if (strchr(set, buf[so]) == NULL) break;
+      if (esl_memspn(buf, n, set) != so) esl_fatal(msg);
+      for (xo = 0; xo < n; xo++) if (strchr(set, buf[xo]) != NULL) break;
+      if (esl_memcspn(buf, n, set) != xo) esl_fatal(msg);
+
+      for (so = 0;  so < n; so++) if (strchr(set, buf[so]) == NULL) break;
+      for (xo = so; xo < n; xo++) if (strchr(set, buf[xo]) != NULL) break;
+      for (eo = xo; eo < n; eo++) if (strchr(set, buf[eo]) == NULL) break;
+      s  = buf;
+      n2 = n;
+      if (so == n) 
+	{
+	  if (esl_memtok(&s, &n2, set, &tok, &toklen) != eslEOL)    esl_fatal(msg);
+	}
+      else
+	{
+	  if (esl_memtok(&s, &n2, set, &tok, &toklen) != eslOK)     esl_fatal(msg);
+	  if (tok != buf + so || toklen != xo - so)                 esl_fatal(msg);
+	  if (s   != buf + eo || n2     != n - eo)                  esl_fatal(msg);
+	}
+    }
+}
+
 /* memstrcmp/memstrpfx */
 static void
 utest_memstrcmp_memstrpfx(void)
@@ -1305,6 +1456,7 @@ main(int argc, char **argv)
   utest_mem_strtof();
   utest_memtok();
   utest_memspn_memcspn();
+  utest_charset_scans(rng);
   utest_memstrcmp_memstrpfx();
   utest_memstrcontains();
 
@@ -2,7 +2,7 @@
  *
  * Table of contents:
  *    1. Single linkage clustering an MSA by %id
- *    2. Internal functions, interface to the clustering API
+ *    2. Internal functions
  *    3. Some internal functions needed for regression tests
  *    4. Unit tests
  *    5. Test driver
@@ -16,11 +16,19 @@
  */
 #include "esl_config.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "easel.h"
 #include "esl_alphabet.h"
 #include "esl_cluster.h"
 #include "esl_distance.h"
 #include "esl_msa.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
+#include "esl_vectorops.h"
 
 #include "esl_msacluster.h"
 
@@ -33,19 +41,14 @@ static double squid_distance(char *s1, char *s2);
 static double squid_xdistance(ESL_ALPHABET *a, ESL_DSQ *x1, ESL_DSQ *x2);
 #endif
 
-/* These functions will define linkage between a pair of text or
- *  digital aseq's: 
+/* Text-mode aligned seqs are clustered through the general
+ * esl_cluster API, with this linkage callback:
  */
 static int msacluster_clinkage(const void *v1, const void *v2, const void *p, int *ret_link);
-static int msacluster_xlinkage(const void *v1, const void *v2, const void *p, int *ret_link);
 
-/* In digital mode, we'll need to pass the clustering routine two parameters -
- * %id threshold and alphabet ptr - so make a structure that bundles them.
- */
-struct msa_param_s {
-  double        maxid;
-  ESL_ALPHABET *abc;
-};
+/* Digital aligned seqs have their own union-find engine: */
+static int msacluster_xslc(const ESL_MSA *msa, double maxid, int ncpu, int *assignment, int *ret_nc);
+static int msacluster_renumber(int *c, int n, int *workspace);
 
 
 /*****************************************************************
@@ -68,6 +71,8 @@ struct msa_param_s {
  *            means that sequence 4 is assigned to cluster 1.  The
  *            <opt_nin[0..nc-1]> array is the number of sequences
  *            in each cluster. <opt_nc> is the number of clusters.
+ *            Clusters are numbered in order of their lowest-numbered
+ *            sequence: sequence 0 is in cluster 0, and so on.
  *
  *            Importantly, this algorithm runs in $O(N)$ memory, and
  *            produces one discrete clustering. Compare to
@@ -82,6 +87,9 @@ struct msa_param_s {
  *            $LN$, when there is just one cluster in a completely
  *            connected graph.
  *            
+ *            To use multiple threads on a digital <msa>, see
+ *            <esl_msacluster_SingleLinkage_adv()>.
+ *
  * Args:      msa     - multiple alignment to cluster
  *            maxid   - pairwise identity threshold: cluster if $\geq$ <maxid>
  *            opt_c   - optRETURN: cluster assignments for each sequence, [0..nseq-1]
@@ -108,7 +116,47 @@ struct msa_param_s {
 int
 esl_msacluster_SingleLinkage(const ESL_MSA *msa, double maxid, 
 			     int **opt_c, int **opt_nin, int *opt_nc)
+{
+  return esl_msacluster_SingleLinkage_adv(msa, maxid, 0, opt_c, opt_nin, opt_nc);
+}
+
 
+/* Function:  esl_msacluster_SingleLinkage_adv()
+ * Synopsis:  Single linkage clustering by percent identity, multithreaded.
+ *
+ * Purpose:   Same as <esl_msacluster_SingleLinkage()>, but for a
+ *            digital <msa>, use <ncpu> worker threads to compare
+ *            pairs of sequences. <ncpu> of 0 or 1 means to do
+ *            everything in the caller's thread. The clustering is the
+ *            same for any <ncpu>. A text mode <msa> is clustered
+ *            without threads.
+ *
+ *            A digital <msa> is clustered by building up the
+ *            connected components of the linkage graph in a union-find
+ *            forest, comparing each pair $i<j$ of sequences in order.
+ *            A pair that's already connected through other links
+ *            doesn't need to be compared, and neither does a pair
+ *            whose overlap of aligned residues is too short for it to
+ *            reach <maxid> identity. Only the remaining pairs are
+ *            compared with the vectorized <esl_dst_XPairIdL()>.
+ *
+ * Args:      msa     - multiple alignment to cluster
+ *            maxid   - pairwise identity threshold: cluster if $\geq$ <maxid>
+ *            ncpu    - number of worker threads (0 = none)
+ *            opt_c   - optRETURN: cluster assignments for each sequence, [0..nseq-1]
+ *            opt_nin - optRETURN: number of seqs in each cluster, [0..nc-1] 
+ *            opt_nc  - optRETURN: number of clusters        
+ *
+ * Returns:   <eslOK> on success; results as for <esl_msacluster_SingleLinkage()>.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> if threads can't
+ *            be started; <eslEINVAL> if a pairwise comparison is invalid.
+ *            Now <opt_c> and <opt_nin> are set to <NULL>, <opt_nc> is set
+ *            to 0, and the <msa> is unmodified.
+ */
+int
+esl_msacluster_SingleLinkage_adv(const ESL_MSA *msa, double maxid, int ncpu,
+				 int **opt_c, int **opt_nin, int *opt_nc)
 {
   int   status;
   int  *workspace  = NULL;
@@ -116,24 +164,21 @@ esl_msacluster_SingleLinkage(const ESL_MSA *msa, double maxid,
   int  *nin        = NULL;
   int   nc;
   int   i;
-  struct msa_param_s param;
 
   /* Allocations */
   ESL_ALLOC(workspace,  sizeof(int) * msa->nseq * 2);
   ESL_ALLOC(assignment, sizeof(int) * msa->nseq);
 
-  /* call to SLC API: */
+  /* Text mode: call to SLC API; digital mode: our own engine. */
   if (! (msa->flags & eslMSA_DIGITAL))
-    status = esl_cluster_SingleLinkage((void *) msa->aseq, (size_t) msa->nseq, sizeof(char *),
-				       msacluster_clinkage, (void *) &maxid, 
-				       workspace, assignment, &nc);
-  else {
-    param.maxid = maxid;
-    param.abc   = msa->abc;
-    status = esl_cluster_SingleLinkage((void *) msa->ax, (size_t) msa->nseq, sizeof(ESL_DSQ *),
-				       msacluster_xlinkage, (void *) &param, 
-				       workspace, assignment, &nc);
-  }
+    {
+      status = esl_cluster_SingleLinkage((void *) msa->aseq, (size_t) msa->nseq, sizeof(char *),
+					 msacluster_clinkage, (void *) &maxid, 
+					 workspace, assignment, &nc);
+      if (status == eslOK) status = msacluster_renumber(assignment, msa->nseq, workspace);
+    }
+  else
+    status = msacluster_xslc(msa, maxid, ncpu, assignment, &nc);
   if (status != eslOK) goto ERROR;
 
 
@@ -156,8 +201,9 @@ esl_msacluster_SingleLinkage(const ESL_MSA *msa, double maxid,
   if (workspace  != NULL) free(workspace);
   if (assignment != NULL) free(assignment);
   if (nin        != NULL) free(nin);
-  if (opt_c  != NULL) *opt_c  = NULL;
-  if (opt_nc != NULL) *opt_nc = 0;
+  if (opt_c   != NULL) *opt_c   = NULL;
+  if (opt_nin != NULL) *opt_nin = NULL;
+  if (opt_nc  != NULL) *opt_nc  = 0;
   return status;
 }
 
@@ -166,7 +212,7 @@ esl_msacluster_SingleLinkage(const ESL_MSA *msa, double maxid,
 
 
 /*****************************************************************
- * 2. Internal functions, interface to the clustering API
+ * 2. Internal functions
  *****************************************************************/
 
 /* Definition of %id linkage in text-mode aligned seqs (>= maxid): */
@@ -188,24 +234,306 @@ msacluster_clinkage(const void *v1, const void *v2, const void *p, int *ret_link
   *ret_link = (pid >= maxid ? TRUE : FALSE); 
   return status;
 }
-  
-/* Definition of % id linkage in digital aligned seqs (>= maxid) */
+
+
+/* msacluster_renumber()
+ * Renumber cluster indices <c[0..n-1]> (each < n) in order of each
+ * cluster's lowest-numbered member, using <workspace[0..n-1]>.
+ */
+static int
+msacluster_renumber(int *c, int n, int *workspace)
+{
+  int nc = 0;
+  int i;
+
+  for (i = 0; i < n; i++) workspace[i] = -1;
+  for (i = 0; i < n; i++)
+    {
+      if (workspace[c[i]] == -1) workspace[c[i]] = nc++;
+      c[i] = workspace[c[i]];
+    }
+  return eslOK;
+}
+
+
+/* msacluster_xslc()
+ * Single linkage clustering of a digital MSA; see
+ * esl_msacluster_SingleLinkage_adv(). The clusters are the connected
+ * components of the linkage graph, kept in a union-find forest
+ * (<parent>, with union by <size> and path halving). Pairs i<j are
+ * compared a block of MSACLUSTER_B rows i at a time, so each row j
+ * is read from memory once per block instead of once per pair,
+ * skipping pairs already in the same component.
+ *
+ * With <ncpu> > 1, blocks are taken in batches of one per worker.
+ * Workers claim blocks of the batch, compare their rows i to all j>i
+ * that weren't in the same component as i when the batch started
+ * (<comp>), and merge the components of linked pairs in the forest,
+ * which is shared and mutex-protected. The forest ends up with the
+ * same components however the work is divided: only the number of
+ * comparisons that turn out to be redundant changes.
+ */
+#define MSACLUSTER_B 32
+
+typedef struct {
+  const ESL_MSA *msa;
+  double         maxid;
+  int           *nres;     // number of canonical residues in each seq [0..nseq-1]
+  int64_t       *lpos;     // column of first canonical residue (1..alen); alen+1 if none
+  int64_t       *rpos;     // column of last canonical residue; 0 if none
+  int           *parent;   // union-find forest [0..nseq-1]
+  int           *size;     // size of the tree rooted at each root [0..nseq-1]
+
+  /* Batch of rows, for worker threads: */
+  int           *comp;     // root of each seq's component when the batch started [0..nseq-1]
+  int            iend;     // batch is rows next..iend-1
+  int            next;     // first row of the next block to claim
+  int            nbusy;    // number of workers still on this batch
+  int            batch;    // batch number; workers wake up when it changes
+  int            done;     // TRUE when workers should exit
+  int            status;   // eslOK, or first error from a worker
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mutex;
+  pthread_cond_t  cv;
+#endif
+} MSACLUSTER_DATA;
+
 static int
-msacluster_xlinkage(const void *v1, const void *v2, const void *p, int *ret_link)
+msacluster_find(int *parent, int x)
 {
-  ESL_DSQ *ax1              = *(ESL_DSQ **) v1;
-  ESL_DSQ *ax2              = *(ESL_DSQ **) v2;
-  struct msa_param_s *param = (struct msa_param_s *) p;
-  double   pid;
-  int      status = eslOK;
+  while (parent[x] != x) { parent[x] = parent[parent[x]]; x = parent[x]; }
+  return x;
+}
+
+static void
+msacluster_union(int *parent, int *size, int x, int y)
+{
+  x = msacluster_find(parent, x);
+  y = msacluster_find(parent, y);
+  if (x == y) return;
+  if (size[x] < size[y]) ESL_SWAP(x, y, int);
+  parent[y] = x;
+  size[x]  += size[y];
+}
+
+/* msacluster_xlink()
+ * Definition of %id linkage in digital aligned seqs (>= maxid). The
+ * identity of seqs i,j is nid/MIN(ni,nj) for ni,nj canonical residues
+ * in each; nid can't exceed the overlap of their residue spans, so
+ * if that bound is already < maxid, they aren't linked.
+ */
+static int
+msacluster_xlink(const MSACLUSTER_DATA *d, int i, int j, int *ret_link)
+{
+  double  pid;
+#if !defined(eslMSACLUSTER_REGRESSION) && !defined(eslMSAWEIGHT_REGRESSION)
+  int     len = ESL_MIN(d->nres[i], d->nres[j]);
+  int64_t ovl;
+  int     status;
+#endif
 
 #if defined(eslMSACLUSTER_REGRESSION) || defined(eslMSAWEIGHT_REGRESSION)
-  pid = 1. - squid_xdistance(param->abc, ax1, ax2);
-#else  
-  if ( (status = esl_dst_XPairId(param->abc, ax1, ax2, &pid, NULL, NULL)) != eslOK) return status;
+  pid = 1. - squid_xdistance((ESL_ALPHABET *) d->msa->abc, d->msa->ax[i], d->msa->ax[j]);
+#else
+  if (len > 0)
+    {
+      ovl = ESL_MAX(0, ESL_MIN(d->rpos[i], d->rpos[j]) - ESL_MAX(d->lpos[i], d->lpos[j]) + 1);
+      if (ovl < len && (double) ovl / (double) len < d->maxid) { *ret_link = FALSE; return eslOK; }
+    }
+  if ((status = esl_dst_XPairIdL(d->msa->abc, d->msa->ax[i], d->msa->ax[j], d->msa->alen, &pid, NULL, NULL)) != eslOK) return status;
+#endif
+
+  *ret_link = (pid >= d->maxid ? TRUE : FALSE);
+  return eslOK;
+}
+
+/* msacluster_block()
+ * Compare rows i0..i1-1 to all rows j>i, merging the components of
+ * linked pairs. In a worker thread (<in_thread> TRUE), skip pairs
+ * that were in the same component when the batch started, and lock
+ * the forest to update it; else use the forest directly.
+ */
+static int
+msacluster_block(MSACLUSTER_DATA *d, int i0, int i1, int in_thread)
+{
+  int i, j, rj, do_link;
+  int status;
+
+  for (j = i0+1; j < d->msa->nseq; j++)
+    {
+      rj = (in_thread ? d->comp[j] : msacluster_find(d->parent, j));
+      for (i = i0; i < ESL_MIN(i1, j); i++)
+	{
+	  if ((in_thread ? d->comp[i] : msacluster_find(d->parent, i)) == rj) continue;
+	  if ((status = msacluster_xlink(d, i, j, &do_link)) != eslOK) return status;
+	  if (! do_link) continue;
+#ifdef HAVE_PTHREAD
+	  if (in_thread) pthread_mutex_lock(&d->mutex);
 #endif
+	  msacluster_union(d->parent, d->size, i, j);
+#ifdef HAVE_PTHREAD
+	  if (in_thread) pthread_mutex_unlock(&d->mutex);
+#endif
+	  if (! in_thread) rj = msacluster_find(d->parent, j);
+	}
+    }
+  return eslOK;
+}
+
+#ifdef HAVE_PTHREAD
+static void
+msacluster_thread(void *arg)
+{
+  ESL_THREADS     *thr = (ESL_THREADS *) arg;
+  MSACLUSTER_DATA *d;
+  int              w, i0, i1, status;
+  int              seen = 0;
+
+  esl_threads_Started(thr, &w);
+  d = (MSACLUSTER_DATA *) esl_threads_GetData(thr, w);
+
+  pthread_mutex_lock(&d->mutex);
+  while (1)
+    {
+      while (d->batch == seen && ! d->done) pthread_cond_wait(&d->cv, &d->mutex);
+      if (d->done) break;
+      seen = d->batch;
+
+      while (d->next < d->iend && d->status == eslOK)
+	{
+	  i0       = d->next;
+	  i1       = ESL_MIN(d->iend, i0 + MSACLUSTER_B);
+	  d->next  = i1;
+	  pthread_mutex_unlock(&d->mutex);
+	  status = msacluster_block(d, i0, i1, TRUE);
+	  pthread_mutex_lock(&d->mutex);
+	  if (status != eslOK && d->status == eslOK) d->status = status;
+	}
+      if (--d->nbusy == 0) pthread_cond_broadcast(&d->cv);
+    }
+  pthread_mutex_unlock(&d->mutex);
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+static int
+msacluster_xslc(const ESL_MSA *msa, double maxid, int ncpu, int *assignment, int *ret_nc)
+{
+  MSACLUSTER_DATA d;
+#ifdef HAVE_PTHREAD
+  ESL_THREADS    *thr     = NULL;
+  int             nworker = 0;
+  int             j;
+#endif
+  int             nseq    = msa->nseq;
+  int             i;
+  int64_t         apos;
+  int             status;
+
+  d.msa    = msa;
+  d.maxid  = maxid;
+  d.nres   = NULL;
+  d.lpos   = NULL;
+  d.rpos   = NULL;
+  d.parent = NULL;
+  d.size   = NULL;
+  d.comp   = NULL;
+  d.status = eslOK;
+
+  ESL_ALLOC(d.nres,   sizeof(int)     * nseq);
+  ESL_ALLOC(d.lpos,   sizeof(int64_t) * nseq);
+  ESL_ALLOC(d.rpos,   sizeof(int64_t) * nseq);
+  ESL_ALLOC(d.parent, sizeof(int)     * nseq);
+  ESL_ALLOC(d.size,   sizeof(int)     * nseq);
+  for (i = 0; i < nseq; i++)
+    {
+      d.parent[i] = i;
+      d.size[i]   = 1;
+      d.nres[i]   = 0;
+      d.lpos[i]   = msa->alen+1;
+      d.rpos[i]   = 0;
+      for (apos = 1; apos <= msa->alen; apos++)
+	if (esl_abc_XIsCanonical(msa->abc, msa->ax[i][apos]))
+	  {
+	    if (d.nres[i]++ == 0) d.lpos[i] = apos;
+	    d.rpos[i] = apos;
+	  }
+    }
 
-  *ret_link = (pid >= param->maxid ? TRUE : FALSE); 
+#ifdef HAVE_PTHREAD
+  if (ncpu > 1 && nseq > MSACLUSTER_B * ncpu)
+    {
+      ESL_ALLOC(d.comp, sizeof(int) * nseq);
+      d.done  = FALSE;
+      d.batch = 0;
+      d.next  = d.iend = 0;
+      if (pthread_mutex_init(&d.mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+      if (pthread_cond_init (&d.cv,    NULL) != 0) { pthread_mutex_destroy(&d.mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+      if ((thr = esl_threads_Create(&msacluster_thread)) == NULL) { status = eslEMEM; goto THREADFAIL; }
+      for (nworker = 0; nworker < ncpu; nworker++)
+	if (esl_threads_AddThread(thr, &d) != eslOK) break;
+      if (nworker == 0) { status = eslESYS; goto THREADFAIL; }
+      esl_threads_WaitForStart(thr);
+
+      for (i = 0; i < nseq-1; i = d.iend)
+	{
+	  pthread_mutex_lock(&d.mutex);
+	  for (j = 0; j < nseq; j++) d.comp[j] = msacluster_find(d.parent, j);
+	  d.next  = i;
+	  d.iend  = ESL_MIN(nseq-1, i + MSACLUSTER_B * nworker);
+	  d.nbusy = nworker;
+	  d.batch++;
+	  pthread_cond_broadcast(&d.cv);
+	  while (d.nbusy > 0) pthread_cond_wait(&d.cv, &d.mutex);
+	  pthread_mutex_unlock(&d.mutex);
+	  if (d.status != eslOK) break;
+	}
+      status = d.status;
+
+      pthread_mutex_lock(&d.mutex);
+      d.done = TRUE;
+      pthread_cond_broadcast(&d.cv);
+      pthread_mutex_unlock(&d.mutex);
+      esl_threads_WaitForFinish(thr);
+      esl_threads_Destroy(thr);
+      pthread_cond_destroy(&d.cv);
+      pthread_mutex_destroy(&d.mutex);
+      if (status != eslOK) goto ERROR;
+    }
+  else
+#endif /*HAVE_PTHREAD*/
+    {
+      for (i = 0; i < nseq-1; i += MSACLUSTER_B)
+	if ((status = msacluster_block(&d, i, ESL_MIN(nseq-1, i + MSACLUSTER_B), FALSE)) != eslOK) goto ERROR;
+    }
+
+  /* Number the components in order of their lowest-numbered member. */
+  for (i = 0; i < nseq; i++) assignment[i] = msacluster_find(d.parent, i);
+  msacluster_renumber(assignment, nseq, d.size);
+  *ret_nc = (nseq > 0 ? esl_vec_IMax(assignment, nseq) + 1 : 0);
+
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  free(d.parent);
+  free(d.size);
+  free(d.comp);
+  return eslOK;
+
+#ifdef HAVE_PTHREAD
+ THREADFAIL:
+  if (thr) esl_threads_Destroy(thr);
+  pthread_cond_destroy(&d.cv);
+  pthread_mutex_destroy(&d.mutex);
+#endif
+ ERROR:
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  free(d.parent);
+  free(d.size);
+  free(d.comp);
+  *ret_nc = 0;
   return status;
 }
 
@@ -254,7 +582,9 @@ squid_xdistance(ESL_ALPHABET *a, ESL_DSQ *x1, ESL_DSQ *x2)
  * 4. Unit tests
  *****************************************************************/
 #ifdef eslMSACLUSTER_TESTDRIVE
+#include <string.h>
 #include "esl_getopts.h"
+#include "esl_random.h"
 
 static void
 utest_SingleLinkage(ESL_GETOPTS *go, const ESL_MSA *msa, double maxid, int expected_nc, int last_assignment)
@@ -270,6 +600,111 @@ utest_SingleLinkage(ESL_GETOPTS *go, const ESL_MSA *msa, double maxid, int expec
   free(assignment);
   free(nin);
 }
+
+/* utest_family_msa()
+ * Sample a digital alignment of <nseq> seqs named seq<idx>, <alen>
+ * columns: seqs <0..ntmpl-1> are random templates, and each later
+ * seq <idx> is a copy of template <idx % ntmpl>, with each position
+ * mutated (to a residue, degeneracy, or gap) with probability
+ * 1/<nmut>; <nmut> = 0 means no mutations. With <do_ragged>, each
+ * end of a seq is gapped out up to alen/2 with probability 1/3.
+ */
+static ESL_MSA *
+utest_family_msa(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, int nseq, int alen, int ntmpl, int nmut, int do_ragged)
+{
+  ESL_MSA *msa = esl_msa_CreateDigital(abc, nseq, alen);
+  int      idx, apos;
+  int      lpos = 1;
+  int      rpos = alen;
+  char     name[32];
+
+  if (! msa) esl_fatal("utest_family_msa() failed");
+  for (idx = 0; idx < nseq; idx++)
+    {
+      if (do_ragged)
+	{
+	  lpos = 1    + (esl_rnd_Roll(rng, 3) == 0 ? esl_rnd_Roll(rng, alen/2) : 0);
+	  rpos = alen - (esl_rnd_Roll(rng, 3) == 0 ? esl_rnd_Roll(rng, alen/2) : 0);
+	}
+      for (apos = 1; apos <= alen; apos++)
+	{
+	  if      (apos < lpos || apos > rpos)              msa->ax[idx][apos] = abc->K;  // gap
+	  else if (idx < ntmpl)                             msa->ax[idx][apos] = esl_rnd_Roll(rng, abc->K);
+	  else if (nmut && esl_rnd_Roll(rng, nmut) == 0)    msa->ax[idx][apos] = esl_rnd_Roll(rng, abc->Kp - 2);
+	  else                                              msa->ax[idx][apos] = msa->ax[idx % ntmpl][apos];
+	}
+      snprintf(name, 32, "seq%d", idx);
+      esl_msa_SetSeqName(msa, idx, name, -1);
+    }
+  return msa;
+}
+
+/* utest_xslc()
+ * The union-find engine for digital MSAs, with and without threads,
+ * must find the same clusters, numbered the same way, as a brute
+ * force flood fill over all pairs. Use mutated copies of a few
+ * templates with ragged ends, so there are clusters to find and
+ * pairs for span pruning to skip.
+ */
+static void
+utest_xslc(ESL_RANDOMNESS *rng, int abctype)
+{
+  char          msg[]  = "utest_xslc() failed";
+  ESL_ALPHABET *abc    = esl_alphabet_Create(abctype);
+  int           nseq   = 300;
+  int           alen   = 80;
+  int           ntmpl  = 10;
+  double        maxid[3] = { 0.0, 0.5, 0.8 };
+  ESL_MSA      *msa    = utest_family_msa(rng, abc, nseq, alen, ntmpl, 4, TRUE);
+  int          *c0     = malloc(sizeof(int) * nseq);
+  int          *stk    = malloc(sizeof(int) * nseq);
+  int          *c      = NULL;
+  int          *nin    = NULL;
+  int           idx, i, j, k, nstk, nc0, nc, ncpu;
+  double        pid;
+
+  if (!abc || !c0 || !stk) esl_fatal(msg);
+
+  for (k = 0; k < 3; k++)
+    {
+      /* Reference: flood fill from each unassigned seq, in order */
+      for (i = 0; i < nseq; i++) c0[i] = -1;
+      for (nc0 = 0, i = 0; i < nseq; i++)
+	{
+	  if (c0[i] != -1) continue;
+	  c0[i] = nc0;
+	  stk[0] = i; nstk = 1;
+	  while (nstk > 0)
+	    {
+	      idx = stk[--nstk];
+	      for (j = 0; j < nseq; j++)
+		{
+		  if (c0[j] != -1) continue;
+		  if (esl_dst_XPairId(abc, msa->ax[idx], msa->ax[j], &pid, NULL, NULL) != eslOK) esl_fatal(msg);
+		  if (pid >= maxid[k]) { c0[j] = nc0; stk[nstk++] = j; }
+		}
+	    }
+	  nc0++;
+	}
+      if (k == 0 && nc0 != 1) esl_fatal(msg);
+
+      for (ncpu = 0; ncpu <= 4; ncpu += 2)
+	{
+	  if (esl_msacluster_SingleLinkage_adv(msa, maxid[k], ncpu, &c, &nin, &nc) != eslOK) esl_fatal(msg);
+	  if (nc != nc0)                                                                    esl_fatal(msg);
+	  if (memcmp(c, c0, sizeof(int) * nseq) != 0)                                       esl_fatal(msg);
+	  for (i = 0; i < nseq; i++) nin[c[i]]--;
+	  for (i = 0; i < nc;   i++) if (nin[i] != 0)                                       esl_fatal(msg);
+	  free(c);
+	  free(nin);
+	}
+    }
+
+  free(c0);
+  free(stk);
+  esl_msa_Destroy(msa);
+  esl_alphabet_Destroy(abc);
+}
 #endif /*eslMSACLUSTER_TESTDRIVE*/
 
 /*****************************************************************
@@ -289,10 +724,12 @@ utest_SingleLinkage(ESL_GETOPTS *go, const ESL_MSA *msa, double maxid, int expec
 #include "esl_msa.h"
 #include "esl_msacluster.h"
 #include "esl_msafile.h"
+#include "esl_random.h"
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
   { "-h",        eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options]";
@@ -302,6 +739,7 @@ int
 main(int argc, char **argv)
 {
   ESL_GETOPTS    *go      = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng     = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
   ESL_ALPHABET   *abc     = esl_alphabet_Create(eslAMINO);
   ESL_MSA        *msa     = esl_msa_CreateFromString("\
 # STOCKHOLM 1.0\n\
@@ -320,6 +758,8 @@ seq10 ALLLLLLLLL\n\
 seq11 MMMMMMMMMM\n\
 //",   eslMSAFILE_STOCKHOLM);
 
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
   utest_SingleLinkage(go, msa, 1.0, 11, 10);    /* at 100% id, only seq0/seq1 cluster */
   utest_SingleLinkage(go, msa, 0.5,  6,  5);    /* at 50% id, seq0-seq6 cluster       */
@@ -331,8 +771,14 @@ seq11 MMMMMMMMMM\n\
   utest_SingleLinkage(go, msa, 0.5,  6,  5);    /* at 50% id, seq0-seq6 cluster       */
   utest_SingleLinkage(go, msa, 0.0,  1,  0);    /* at 0% id, everything clusters      */
 
+  utest_xslc(rng, eslAMINO);
+  utest_xslc(rng, eslDNA);
+
+  fprintf(stderr, "#  status = ok\n");
+
   esl_msa_Destroy(msa);
   esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
   return 0;
 }
@@ -7,5 +7,7 @@
 
 extern int esl_msacluster_SingleLinkage(const ESL_MSA *msa, double maxid, 
 					int **opt_c, int **opt_nin, int *opt_nc);
+extern int esl_msacluster_SingleLinkage_adv(const ESL_MSA *msa, double maxid, int ncpu,
+					    int **opt_c, int **opt_nin, int *opt_nc);
 
 #endif /*eslMSACLUSTER_INCLUDED*/
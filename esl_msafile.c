@@ -1066,6 +1066,154 @@ esl_msafile_ReadFailure(ESL_MSAFILE *afp, int status)
   esl_msafile_Close(afp);
   exit(status);
 }
+
+
+/* Function:  esl_msafile_ReadRow()
+ * Synopsis:  Read next aligned sequence, in bounded memory.
+ *
+ * Purpose:   Read the next aligned sequence (row) from open MSA input
+ *            <afp> into <row>, without holding the rest of the
+ *            alignment in memory. This lets applications deal with
+ *            alignments of millions of sequences, so long as what
+ *            they need can be collected one sequence at a time; for
+ *            example, residue counts per column.
+ *
+ *            Each call returns <eslOK> and the next row of the
+ *            current alignment; or <eslEOD> at the end of each
+ *            alignment; or <eslEOF> when there are no more
+ *            alignments. So a typical loop looks like:
+ *            
+ *            while ((status = esl_msafile_ReadRow(afp, row)) == eslOK || status == eslEOD)
+ *               {
+ *                 if (status == eslOK) { ...use row->name, row->ax, row->pp... }
+ *                 else                 { ...alignment is done; use row->msa, row->nseq, row->alen... }
+ *               }
+ *            if (status != eslEOF) esl_msafile_ReadFailure(afp, status);
+ *
+ *            For each row, <row->name> is the name, and the aligned
+ *            sequence is in <row->ax[1..alen]> if <afp> is in digital
+ *            mode, else <row->aseq[0..alen-1]>. Sequence-specific
+ *            <#=GR SS> and <#=GR PP> annotation in Stockholm input is
+ *            in <row->ss> and <row->pp>; these are <NULL> if the
+ *            sequence doesn't have them. Other per-sequence
+ *            annotation (<#=GS> lines, other <#=GR> tags, AFA
+ *            descriptions) is skipped, because keeping it would make
+ *            memory scale with the number of sequences.
+ *            <row->idx> is the index of the row in its alignment
+ *            (<0..nseq-1>), so <row->idx == 0> signals the start of
+ *            a new alignment.
+ *            
+ *            Per-alignment annotation (name, accession, <#=GF>,
+ *            <#=GC>, comments) is collected in <row->msa>, which
+ *            holds no sequences. It isn't complete until <eslEOD>,
+ *            because in Pfam format <#=GC> lines follow the sequences.
+ *            At <eslEOD>, <row->nseq> and <row->alen> are the number
+ *            of sequences and columns, and <row->msa->alen> is set too
+ *            (<row->msa->nseq> is left at 0). The row keeps ownership
+ *            of <row->msa> and frees it when the next alignment
+ *            starts; a caller that wants to keep it can take it at
+ *            <eslEOD> by setting <row->msa> to <NULL>.
+ *
+ *            Input formats that can be read this way are Pfam,
+ *            Stockholm, and aligned FASTA. Stockholm input has to be
+ *            a single block (which is what Pfam format guarantees):
+ *            interleaved multiblock Stockholm is a parse error, with
+ *            a message suggesting conversion to Pfam format.
+ *            
+ * Args:      afp  - open alignment input
+ *            row  - row to read into; created by <esl_msafile_row_Create()>,
+ *                   and used for all reads from <afp>.
+ *
+ * Returns:   <eslOK> on success; <row> contains the next sequence.
+ *
+ *            <eslEOD> at the end of an alignment.
+ *
+ *            <eslEOF> if there are no more alignments in <afp>.
+ *
+ *            <eslEFORMAT> on a parse error, or if <afp> is in a
+ *            format that can't be read row by row. <afp->errmsg>
+ *            is set as for <esl_msafile_Read()>, so <afp> and the
+ *            status can be passed to <esl_msafile_ReadFailure()>.
+ *
+ * Throws:    <eslEMEM> - an allocation failed.
+ *            <eslESYS> - a system call such as fread() failed
+ *            <eslEINCONCEIVABLE> - "impossible" corruption 
+ */
+int
+esl_msafile_ReadRow(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row)
+{
+  switch (afp->format) {
+  case eslMSAFILE_AFA:          return esl_msafile_afa_ReadRow      (afp, row);
+  case eslMSAFILE_PFAM:         return esl_msafile_stockholm_ReadRow(afp, row);
+  case eslMSAFILE_STOCKHOLM:    return esl_msafile_stockholm_ReadRow(afp, row);
+  default:                      ESL_FAIL(eslEFORMAT, afp->errmsg, "%s format can't be read one sequence at a time; convert to Pfam or aligned FASTA", esl_msafile_DecodeFormat(afp->format));
+  }
+}
+
+
+/* Function:  esl_msafile_row_Create()
+ * Synopsis:  Create a new <ESL_MSAFILE_ROW>.
+ *
+ * Purpose:   Create a new, empty <ESL_MSAFILE_ROW> object, for reading
+ *            an alignment one sequence at a time with
+ *            <esl_msafile_ReadRow()>. Its allocations grow as needed.
+ *
+ * Returns:   pointer to the new row.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_MSAFILE_ROW *
+esl_msafile_row_Create(void)
+{
+  ESL_MSAFILE_ROW *row = NULL;
+  int              status;
+
+  ESL_ALLOC(row, sizeof(ESL_MSAFILE_ROW));
+  row->name      = NULL;
+  row->aseq      = NULL;
+  row->ax        = NULL;
+  row->ss        = NULL;
+  row->pp        = NULL;
+  row->idx       = -1;
+  row->alen      = -1;
+  row->n         = 0;
+  row->msa       = NULL;
+  row->nseq      = 0;
+  row->in_msa    = FALSE;
+  row->blockdone = FALSE;
+  row->seqmem    = NULL;
+  row->ssmem     = NULL;
+  row->ppmem     = NULL;
+  row->salloc    = 0;
+  row->nalloc    = 0;
+
+  ESL_ALLOC(row->name, sizeof(char) * 32);
+  row->nalloc  = 32;
+  row->name[0] = '\0';
+  return row;
+
+ ERROR:
+  esl_msafile_row_Destroy(row);
+  return NULL;
+}
+
+
+/* Function:  esl_msafile_row_Destroy()
+ * Synopsis:  Free an <ESL_MSAFILE_ROW>.
+ */
+void
+esl_msafile_row_Destroy(ESL_MSAFILE_ROW *row)
+{
+  if (row)
+    {
+      free(row->name);
+      free(row->seqmem);
+      free(row->ssmem);
+      free(row->ppmem);
+      esl_msa_Destroy(row->msa);
+      free(row);
+    }
+}
 /*------------ end, reading MSA from ESL_MSAFILE ---------------*/
 
 
@@ -1264,6 +1412,180 @@ esl_msafile_PutLine(ESL_MSAFILE *afp)
   return eslOK;
 }
 
+
+
+/* Function:  esl_msafile_row_Begin()
+ * Synopsis:  Start reading a new alignment row by row.
+ *
+ * Purpose:   Used by format-specific <ReadRow()> parsers when they
+ *            find the start of a new alignment. Reset <row> for a new
+ *            alignment, and create its new (empty) per-alignment
+ *            annotation <row->msa>, digital if <afp> is.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_msafile_row_Begin(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row)
+{
+  esl_msa_Destroy(row->msa);
+  if (afp->abc) row->msa = esl_msa_CreateDigital(afp->abc, 16, -1);
+  else          row->msa = esl_msa_Create(16, -1);
+  if (! row->msa) return eslEMEM;
+
+  row->name[0]   = '\0';
+  row->aseq      = NULL;
+  row->ax        = NULL;
+  row->ss        = NULL;
+  row->pp        = NULL;
+  row->idx       = -1;
+  row->alen      = -1;
+  row->n         = 0;
+  row->nseq      = 0;
+  row->in_msa    = TRUE;
+  row->blockdone = FALSE;
+  return eslOK;
+}
+
+/* Function:  esl_msafile_row_SetName()
+ * Synopsis:  Start a new row, with name <p>,<n>.
+ *
+ * Purpose:   Used by format-specific <ReadRow()> parsers: start
+ *            a new sequence in <row>, named <p>,<n>. Clears the
+ *            sequence and its annotation, and sets <row->idx>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_msafile_row_SetName(ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n)
+{
+  int status;
+
+  if (n+1 > row->nalloc) {
+    ESL_REALLOC(row->name, sizeof(char) * (n+1));
+    row->nalloc = n+1;
+  }
+  memcpy(row->name, p, n);
+  row->name[n] = '\0';
+
+  row->aseq = NULL;
+  row->ax   = NULL;
+  row->ss   = NULL;
+  row->pp   = NULL;
+  row->n    = 0;
+  row->idx  = row->nseq;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* row_grow()
+ * Make sure <row> can hold at least <n> aligned columns, plus
+ * sentinels/NUL; keeping any current contents.
+ */
+static int
+row_grow(ESL_MSAFILE_ROW *row, int64_t n)
+{
+  int64_t newalloc;
+  int     status;
+
+  if (n + 2 <= row->salloc) return eslOK;
+  newalloc = ESL_MAX(n + 2, 2 * row->salloc);
+  ESL_REALLOC(row->seqmem, sizeof(char) * newalloc);
+  ESL_REALLOC(row->ssmem,  sizeof(char) * newalloc);
+  ESL_REALLOC(row->ppmem,  sizeof(char) * newalloc);
+  row->salloc = newalloc;
+
+  if (row->aseq) row->aseq = row->seqmem;
+  if (row->ax)   row->ax   = (ESL_DSQ *) row->seqmem;
+  if (row->ss)   row->ss   = row->ssmem;
+  if (row->pp)   row->pp   = row->ppmem;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  esl_msafile_row_AppendSeq()
+ * Synopsis:  Append aligned sequence text to current row.
+ *
+ * Purpose:   Used by format-specific <ReadRow()> parsers: map aligned
+ *            sequence text <p>,<n> through the input map of <afp> and
+ *            append it to the current sequence in <row>: to
+ *            <row->ax> in digital mode, else <row->aseq>. <row->n> is
+ *            incremented by <n>.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslEINVAL> if <p> contains an invalid character; caller
+ *            turns this into a parse error.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_msafile_row_AppendSeq(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n)
+{
+  int status;
+
+  if ((status = row_grow(row, row->n + n)) != eslOK) return status;
+  if (afp->abc)
+    {
+      row->ax = (ESL_DSQ *) row->seqmem;
+      if (row->n == 0) row->ax[0] = eslDSQ_SENTINEL;
+      return esl_abc_dsqcat_noalloc(afp->inmap, row->ax, &(row->n), p, n);
+    }
+  else
+    {
+      row->aseq = row->seqmem;
+      if (row->n == 0) row->aseq[0] = '\0';
+      return esl_strmapcat_noalloc(afp->inmap, row->aseq, &(row->n), p, n);
+    }
+}
+
+/* Function:  esl_msafile_row_SetSS()
+ * Synopsis:  Set #=GR SS annotation of current row.
+ *
+ * Purpose:   Used by format-specific <ReadRow()> parsers: set the
+ *            secondary structure annotation of the current sequence
+ *            in <row> to <p>,<n>. Caller has checked that <n> is the
+ *            alignment length.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+esl_msafile_row_SetSS(ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n)
+{
+  int status;
+
+  if ((status = row_grow(row, n)) != eslOK) return status;
+  memcpy(row->ssmem, p, n);
+  row->ssmem[n] = '\0';
+  row->ss       = row->ssmem;
+  return eslOK;
+}
+
+/* Function:  esl_msafile_row_SetPP()
+ * Synopsis:  Set #=GR PP annotation of current row.
+ *
+ * Purpose:   Same as <esl_msafile_row_SetSS()>, but for posterior
+ *            probability annotation.
+ */
+int
+esl_msafile_row_SetPP(ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n)
+{
+  int status;
+
+  if ((status = row_grow(row, n)) != eslOK) return status;
+  memcpy(row->ppmem, p, n);
+  row->ppmem[n] = '\0';
+  row->pp       = row->ppmem;
+  return eslOK;
+}
 /*--------------- end, parser utilities -------------------------*/
 
 
@@ -1382,6 +1704,141 @@ seq2    ACDEFGHIKLMNPQRSTVWYacdefghiklmnpqrstvwyACDEFGHIKLMNPQRSTVWYacdefghiklmn
   esl_alphabet_Destroy(abc);
   esl_alphabet_Destroy(abc2);
 }
+
+/* utest_readrow()
+ * Write a couple of sampled alignments in <fmt> (Pfam or AFA), then
+ * read them back one row at a time with esl_msafile_ReadRow(), in
+ * digital and text mode, and check each row against esl_msafile_Read().
+ */
+static void
+utest_readrow(ESL_RANDOMNESS *rng, int fmt)
+{
+  char             msg[]       = "esl_msafile: readrow unit test failed";
+  char             tmpfile[32] = "esltmpXXXXXX";
+  ESL_ALPHABET    *abc         = esl_alphabet_Create(eslAMINO);
+  int              nali        = (fmt == eslMSAFILE_AFA ? 1 : 3); /* AFA can only hold one alignment per file */
+  ESL_MSA         *msa         = NULL;
+  ESL_MSAFILE     *afp1        = NULL;
+  ESL_MSAFILE     *afp2        = NULL;
+  ESL_MSAFILE_ROW *row         = esl_msafile_row_Create();
+  FILE            *ofp         = NULL;
+  int              do_text;
+  int              a, i;
+
+  if (! row)                                   esl_fatal(msg);
+  if (esl_tmpfile_named(tmpfile, &ofp) != eslOK) esl_fatal(msg);
+  for (a = 0; a < nali; a++)
+    {
+      if (esl_msa_Sample(rng, abc, 20, 100, &msa) != eslOK) esl_fatal(msg);
+      if (esl_msafile_Write(ofp, msa, fmt)       != eslOK) esl_fatal(msg);
+      esl_msa_Destroy(msa);
+    }
+  fclose(ofp);
+
+  for (do_text = 0; do_text <= 1; do_text++)
+    {
+      if (esl_msafile_Open( (do_text ? NULL : &abc), tmpfile, NULL, fmt, NULL, &afp1) != eslOK) esl_fatal(msg);
+      if (esl_msafile_Open( (do_text ? NULL : &abc), tmpfile, NULL, fmt, NULL, &afp2) != eslOK) esl_fatal(msg);
+
+      for (a = 0; a < nali; a++)
+        {
+          if (esl_msafile_Read(afp1, &msa) != eslOK) esl_fatal(msg);
+          for (i = 0; i < msa->nseq; i++)
+            {
+              if (esl_msafile_ReadRow(afp2, row) != eslOK)   esl_fatal(msg);
+              if (row->idx != i || row->alen != msa->alen)   esl_fatal(msg);
+              if (strcmp(row->name, msa->sqname[i]) != 0)    esl_fatal(msg);
+              if (do_text) { if (row->ax || strcmp(row->aseq, msa->aseq[i]) != 0)                                     esl_fatal(msg); }
+              else         { if (row->aseq || memcmp(row->ax, msa->ax[i], sizeof(ESL_DSQ) * (msa->alen+2)) != 0)       esl_fatal(msg); }
+            }
+          if (esl_msafile_ReadRow(afp2, row) != eslEOD)               esl_fatal(msg);
+          if (row->nseq != msa->nseq || row->msa->alen != msa->alen)  esl_fatal(msg);
+          if (fmt == eslMSAFILE_PFAM && esl_strcmp(row->msa->rf, msa->rf) != 0) esl_fatal(msg);
+          esl_msa_Destroy(msa);
+        }
+      if (esl_msafile_Read(afp1, &msa)   != eslEOF) esl_fatal(msg);
+      if (esl_msafile_ReadRow(afp2, row) != eslEOF) esl_fatal(msg);
+
+      esl_msafile_Close(afp1);
+      esl_msafile_Close(afp2);
+    }
+
+  remove(tmpfile);
+  esl_msafile_row_Destroy(row);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_readrow_annotation()
+ * Row reading of a small Pfam-format alignment with per-sequence and
+ * per-column annotation; and the expected parse errors for
+ * interleaved Stockholm and for formats that can't be read by row.
+ */
+static void
+utest_readrow_annotation(void)
+{
+  char             msg[]   = "esl_msafile: readrow annotation unit test failed";
+  ESL_MSAFILE     *afp     = NULL;
+  ESL_MSAFILE_ROW *row     = esl_msafile_row_Create();
+  ESL_MSA         *msa     = NULL;
+  char            *pfamstr = "\
+# STOCKHOLM 1.0\n\
+#=GF ID   test\n\
+#=GS seq1 DE the first seq\n\
+seq1          ACDEFGHIKL\n\
+#=GR seq1 PP  9876543210\n\
+seq2          ACDEF--IKL\n\
+#=GR seq2 SS  <<<...>>>.\n\
+#=GR seq2 XX  abcdefghij\n\
+#=GC SS_cons  <<<...>>>.\n\
+#=GC RF       xxxxx..xxx\n\
+//\n";
+  char            *interleaved = "\
+# STOCKHOLM 1.0\n\
+seq1  ACDEF\n\
+seq2  ACDEF\n\
+\n\
+seq1  GHIKL\n\
+seq2  GHIKL\n\
+//\n";
+  char            *clustal = "\
+CLUSTAL W (1.83) multiple sequence alignment\n\
+\n\
+seq1  ACDEFGHIKL\n\
+seq2  ACDEFGHIKL\n";
+
+  if (! row) esl_fatal(msg);
+
+  if (esl_msafile_OpenMem(NULL, pfamstr, strlen(pfamstr), eslMSAFILE_PFAM, NULL, &afp) != eslOK) esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslOK)                                  esl_fatal(msg);
+  if (strcmp(row->name, "seq1") != 0 || strcmp(row->aseq, "ACDEFGHIKL") != 0) esl_fatal(msg);
+  if (row->ss != NULL || row->pp == NULL || strcmp(row->pp, "9876543210") != 0) esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslOK)                                  esl_fatal(msg);
+  if (strcmp(row->name, "seq2") != 0 || strcmp(row->aseq, "ACDEF--IKL") != 0) esl_fatal(msg);
+  if (row->pp != NULL || row->ss == NULL || strcmp(row->ss, "<<<...>>>.") != 0) esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslEOD)                                 esl_fatal(msg);
+  if (row->nseq != 2 || row->alen != 10)                                       esl_fatal(msg);
+  msa = row->msa;  row->msa = NULL;  /* caller can take the per-alignment annotation */
+  if (esl_strcmp(msa->name,    "test")       != 0)                             esl_fatal(msg);
+  if (esl_strcmp(msa->ss_cons, "<<<...>>>.") != 0)                             esl_fatal(msg);
+  if (esl_strcmp(msa->rf,      "xxxxx..xxx") != 0)                             esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslEOF)                                 esl_fatal(msg);
+  esl_msafile_Close(afp);
+  esl_msa_Destroy(msa);
+
+  if (esl_msafile_OpenMem(NULL, interleaved, strlen(interleaved), eslMSAFILE_STOCKHOLM, NULL, &afp) != eslOK) esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslOK)      esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslOK)      esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslEFORMAT) esl_fatal(msg);
+  if (strstr(afp->errmsg, "interleaved") == NULL)  esl_fatal(msg);
+  if (afp->linenumber != 5)                        esl_fatal(msg);
+  esl_msafile_Close(afp);
+
+  if (esl_msafile_OpenMem(NULL, clustal, strlen(clustal), eslMSAFILE_CLUSTAL, NULL, &afp) != eslOK) esl_fatal(msg);
+  if (esl_msafile_ReadRow(afp, row) != eslEFORMAT) esl_fatal(msg);
+  esl_msafile_Close(afp);
+
+  esl_msafile_row_Destroy(row);
+}
 #endif /*eslMSAFILE_TESTDRIVE*/
 /*----------------- end, unit tests -----------------------------*/
 
@@ -1402,10 +1859,12 @@ seq2    ACDEFGHIKLMNPQRSTVWYacdefghiklmnpqrstvwyACDEFGHIKLMNPQRSTVWYacdefghiklmn
 #include "easel.h"
 #include "esl_getopts.h"
 #include "esl_msafile.h"
+#include "esl_random.h"
 
 static ESL_OPTIONS options[] = {
    /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
   {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                            0},
+  {"-s",  eslARG_INT,       "0", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",                  0},
   { 0,0,0,0,0,0,0,0,0,0},
 };
 static char usage[]  = "[-options]";
@@ -1415,12 +1874,22 @@ int
 main(int argc, char **argv)
 {
   ESL_GETOPTS    *go          = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng         = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
   int fmt1, fmt2;
   
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
+
   for (fmt1 = eslMSAFILE_STOCKHOLM; fmt1 <= eslMSAFILE_PHYLIPS; fmt1++)
     for (fmt2 = eslMSAFILE_STOCKHOLM; fmt2 <= eslMSAFILE_PHYLIPS; fmt2++)
       utest_format2format(fmt1, fmt2);
 
+  utest_readrow(rng, eslMSAFILE_PFAM);
+  utest_readrow(rng, eslMSAFILE_AFA);
+  utest_readrow_annotation();
+
+  fprintf(stderr, "#  status = ok\n");
+  esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
   exit(0);
 }
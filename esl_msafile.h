@@ -1,7 +1,9 @@
 /* Multiple sequence alignment file i/o
  *
  * See also: esl_msafile2.[ch], which contains a legacy ESL_MSAFILE2 interface
- * that includes support for --small option in various tools.
+ * that includes support for --small option in various tools. For
+ * reading big alignments in bounded memory, the preferred interface
+ * is now esl_msafile_ReadRow(), below.
  */
 #ifndef eslMSAFILE_INCLUDED
 #define eslMSAFILE_INCLUDED
@@ -71,6 +73,41 @@ typedef struct {
 } ESL_MSAFILE;
 
 
+/* Object: ESL_MSAFILE_ROW
+ * 
+ * One aligned sequence at a time, read from an alignment that may be
+ * too big to hold in memory, by <esl_msafile_ReadRow()>. Only
+ * formats with one contiguous record per sequence can be read this
+ * way: Pfam (and single-block Stockholm), and aligned FASTA.
+ *
+ * The per-sequence fields are reused for each row. <msa> collects the
+ * per-alignment annotation (name, accession, #=GF, #=GC, comments)
+ * but no sequences; it's only complete when the end of the alignment
+ * is reached.
+ */
+typedef struct {
+  char    *name;      /* name of current seq, NUL-terminated                                    */
+  char    *aseq;      /* text mode: aligned seq [0..alen-1], NUL-terminated; NULL in digital mode */
+  ESL_DSQ *ax;        /* digital mode: aligned seq [1..alen], with sentinels; NULL in text mode  */
+  char    *ss;        /* #=GR SS annotation [0..alen-1], NUL-terminated; NULL if seq has none    */
+  char    *pp;        /* #=GR PP annotation [0..alen-1], NUL-terminated; NULL if seq has none    */
+  int      idx;       /* index of current seq in its alignment, 0..nseq-1                        */
+  int64_t  alen;      /* alignment length, same for all rows of an alignment; -1 until known     */
+  int64_t  n;         /* length of current row so far, while it's being parsed                   */
+
+  ESL_MSA *msa;       /* per-alignment annotation; no seqs. Owned by the row, unless caller takes it */
+  int      nseq;      /* number of rows read so far in current alignment                         */
+  int      in_msa;    /* TRUE while we're in the middle of an alignment                          */
+  int      blockdone; /* Stockholm: TRUE once the block of seq lines has ended                   */
+
+  char    *seqmem;    /* allocation for <aseq> or <ax>                                          */
+  char    *ssmem;     /* allocation for <ss>                                                    */
+  char    *ppmem;     /* allocation for <pp>                                                    */
+  int64_t  salloc;    /* allocated size of seqmem, ssmem, ppmem, in bytes                       */
+  int      nalloc;    /* allocated size of <name>                                               */
+} ESL_MSAFILE_ROW;
+
+
 /* Alignment file format codes.
  * Must coexist with sqio unaligned file format codes.
  * Rules:
@@ -118,6 +155,9 @@ extern int esl_msafile_PositionByKey(ESL_MSAFILE *afp, const char *key);
 /* 6. Reading an MSA from an ESL_MSAFILE */
 extern int  esl_msafile_Read(ESL_MSAFILE *afp, ESL_MSA **ret_msa);
 extern void esl_msafile_ReadFailure(ESL_MSAFILE *afp, int status);
+extern int  esl_msafile_ReadRow(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row);
+extern ESL_MSAFILE_ROW *esl_msafile_row_Create(void);
+extern void             esl_msafile_row_Destroy(ESL_MSAFILE_ROW *row);
 
 /* 7. Writing an MSA to a stream */
 extern int esl_msafile_Write(FILE *fp, ESL_MSA *msa, int fmt);
@@ -125,6 +165,11 @@ extern int esl_msafile_Write(FILE *fp, ESL_MSA *msa, int fmt);
 /* 8. Utilities for specific parsers */
 extern int esl_msafile_GetLine(ESL_MSAFILE *afp, char **opt_p, esl_pos_t *opt_n);
 extern int esl_msafile_PutLine(ESL_MSAFILE *afp);
+extern int esl_msafile_row_Begin    (ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row);
+extern int esl_msafile_row_SetName  (ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n);
+extern int esl_msafile_row_AppendSeq(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n);
+extern int esl_msafile_row_SetSS    (ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n);
+extern int esl_msafile_row_SetPP    (ESL_MSAFILE_ROW *row, const char *p, esl_pos_t n);
 
 #include "esl_msafile_a2m.h"
 #include "esl_msafile_afa.h"
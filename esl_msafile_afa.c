@@ -253,6 +253,68 @@ esl_msafile_afa_Read(ESL_MSAFILE *afp, ESL_MSA **ret_msa)
 
 }
 
+/* Function:  esl_msafile_afa_ReadRow()
+ * Synopsis:  Read next aligned sequence from aligned FASTA input.
+ *
+ * Purpose:   Read the next aligned sequence from open aligned FASTA
+ *            input <afp> into <row>, without storing the rest of the
+ *            alignment. See <esl_msafile_ReadRow()> for the protocol.
+ *            Sequence descriptions are skipped.
+ *
+ * Returns:   <eslOK> on success, with the next sequence in <row>.
+ *            <eslEOD> at the end of the alignment.
+ *            <eslEOF> if no more alignment data are found.
+ *            <eslEFORMAT> on a parse error, with <afp->errmsg>,
+ *            <afp->linenumber>, etc. set as for <esl_msafile_afa_Read()>.
+ *
+ * Throws:    <eslEMEM> - an allocation failed.
+ *            <eslESYS> - a system call such as fread() failed
+ *            <eslEINCONCEIVABLE> - "impossible" corruption 
+ */
+int
+esl_msafile_afa_ReadRow(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row)
+{
+  char     *p, *tok;
+  esl_pos_t n, ntok;
+  int       status;
+
+  ESL_DASSERT1( (afp->format == eslMSAFILE_AFA) );
+
+  afp->errmsg[0] = '\0';
+
+  /* skip blank lines; at the start of an alignment, EOF is normal */
+  while ( (status = esl_msafile_GetLine(afp, &p, &n)) == eslOK && esl_memspn(afp->line, afp->n, " \t") == afp->n) ;
+  if (status == eslEOF && row->in_msa) { row->msa->alen = row->alen; row->in_msa = FALSE; return eslEOD; }
+  if (status != eslOK) return status;   /* includes normal EOF */
+  if (! row->in_msa && (status = esl_msafile_row_Begin(afp, row)) != eslOK) return status;
+
+  while (n && isspace(*p)) { p++; n--; }    
+  if (n <= 1 || *p != '>') ESL_FAIL(eslEFORMAT, afp->errmsg, "expected aligned FASTA name/desc line starting with >");    
+  p++; n--;			/* advance past > */
+
+  if ( (status = esl_memtok(&p, &n, " \t", &tok, &ntok))   != eslOK) ESL_FAIL(eslEFORMAT, afp->errmsg, "no name found for aligned FASTA record");
+  if ( (status = esl_msafile_row_SetName(row, tok, ntok)) != eslOK) return status;
+
+  while ((status = esl_msafile_GetLine(afp, &p, &n)) == eslOK)
+    {
+      while (n && isspace(*p)) { p++; n--; } /* tolerate and skip leading whitespace on line */
+      if (n  == 0)   continue;	       /* tolerate and skip blank lines */
+      if (*p == '>') { if ((status = esl_msafile_PutLine(afp)) != eslOK) return status; break; }
+
+      status = esl_msafile_row_AppendSeq(afp, row, p, n);
+      if      (status == eslEINVAL) ESL_FAIL(eslEFORMAT, afp->errmsg, "one or more invalid sequence characters");
+      else if (status != eslOK)     return status;
+    }
+  if (status != eslOK && status != eslEOF) return status;
+
+  if (row->n == 0)                          ESL_FAIL(eslEFORMAT, afp->errmsg, "sequence %s has alen %" PRId64 , row->name, row->n);
+  if (row->alen != -1 && row->alen != row->n) ESL_FAIL(eslEFORMAT, afp->errmsg, "sequence %s has alen %" PRId64 "; expected %" PRId64, row->name, row->n, row->alen);
+
+  row->alen = row->n;
+  row->nseq++;
+  return eslOK;
+}
+
 /* Function:  esl_msafile_afa_Write()
  * Synopsis:  Write an aligned FASTA format alignment file to a stream.
  *
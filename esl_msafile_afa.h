@@ -10,6 +10,7 @@
 extern int esl_msafile_afa_SetInmap     (ESL_MSAFILE *afp);
 extern int esl_msafile_afa_GuessAlphabet(ESL_MSAFILE *afp, int *ret_type);
 extern int esl_msafile_afa_Read         (ESL_MSAFILE *afp, ESL_MSA **ret_msa);
+extern int esl_msafile_afa_ReadRow      (ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row);
 extern int esl_msafile_afa_Write        (FILE *fp, const ESL_MSA *msa);
 
 #endif /* eslMSAFILE_AFA_INCLUDED */
@@ -0,0 +1,702 @@
+/* Parallel reading of multi-MSA Stockholm/Pfam files.
+ *
+ * Pfam and Rfam distribute each database as one big Stockholm file
+ * holding tens of thousands of alignments. Parsing is the expensive
+ * part of reading them, and records are independent, so we can parse
+ * several at once: one loader thread scans for '//' record
+ * terminators and hands each record's text to one of a pool of
+ * parser threads, which parse it with the usual Stockholm parser as
+ * if it were a string opened with esl_msafile_OpenMem(). The caller
+ * gets the ESL_MSAs back in file order.
+ *
+ * Contents:
+ *    1. ESL_MSAFILE_PARALLEL: the threaded reader.
+ *    2. Internal functions: loader and parser threads.
+ *    3. Unit tests.
+ *    4. Test driver.
+ *    5. Example.
+ */
+#include "esl_config.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "easel.h"
+#include "esl_buffer.h"
+#include "esl_mem.h"
+#include "esl_msa.h"
+#include "esl_msafile.h"
+
+#include "esl_msafile_parallel.h"
+
+static void *parallel_loader_thread(void *p);
+static void *parallel_parser_thread(void *p);
+static int   parallel_load (ESL_MSAFILE_PARALLEL *pafp, ESL_MSAFILE_PARALLEL_CHUNK *c);
+static void  parallel_parse(ESL_MSAFILE_PARALLEL *pafp, ESL_MSAFILE_PARALLEL_CHUNK *c);
+static void  parallel_stop (ESL_MSAFILE_PARALLEL *pafp);
+
+
+/*****************************************************************
+ *# 1. ESL_MSAFILE_PARALLEL: the threaded reader.
+ *****************************************************************/
+
+/* Function:  esl_msafile_parallel_Create()
+ * Synopsis:  Start a multithreaded reader on an open MSA file.
+ *
+ * Purpose:   Given an <ESL_MSAFILE> <afp> that the caller has opened
+ *            as usual with <esl_msafile_Open()> (including format and
+ *            alphabet guessing, if needed), create a reader that
+ *            parses its alignments with <nworkers> parser threads
+ *            (plus one loader thread), and return it in <*ret_pafp>.
+ *            Then read alignments with <esl_msafile_parallel_Read()>
+ *            instead of <esl_msafile_Read()>.
+ *
+ *            Only the multi-record Stockholm and Pfam formats are
+ *            parsed in parallel. For any other format, or if
+ *            <nworkers> is 0, the reader just passes calls through
+ *            to <esl_msafile_Read()>, without starting any threads;
+ *            so the caller doesn't need to special-case them.
+ *            <nworkers> larger than
+ *            <eslMSAFILE_PARALLEL_MAXWORKERS> is capped.
+ *
+ *            Alignments are returned in the same order, with the same
+ *            contents (including <msa->offset>) as <esl_msafile_Read()>
+ *            would give. Line numbers in parse error diagnostics
+ *            refer to the original input.
+ *
+ *            The caller still owns <afp>, and is responsible for
+ *            closing it, after destroying the reader. While the
+ *            reader exists, the caller must not use <afp> itself.
+ *
+ * Args:      afp      - open MSA input
+ *            nworkers - number of parser threads; 0 for serial reading
+ *            ret_pafp - RETURN: new reader
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *            <eslESYS> if a pthread call fails.
+ *            On exceptions, <*ret_pafp> is <NULL>.
+ */
+int
+esl_msafile_parallel_Create(ESL_MSAFILE *afp, int nworkers, ESL_MSAFILE_PARALLEL **ret_pafp)
+{
+  ESL_MSAFILE_PARALLEL *pafp = NULL;
+  int                   i;
+  int                   status;
+
+  ESL_ALLOC(pafp, sizeof(ESL_MSAFILE_PARALLEL));
+  pafp->afp           = afp;
+  pafp->abc           = (ESL_ALPHABET *) afp->abc;  // parsers pass it to esl_msafile_OpenMem() as a provided alphabet, which is not modified
+  pafp->is_serial     = (nworkers <= 0 || (afp->format != eslMSAFILE_STOCKHOLM && afp->format != eslMSAFILE_PFAM));
+  pafp->nworkers      = (pafp->is_serial ? 0 : ESL_MIN(nworkers, eslMSAFILE_PARALLEL_MAXWORKERS));
+  pafp->nchunks       = 2 * pafp->nworkers;
+  pafp->chunk         = NULL;
+  pafp->nloaded       = 0;
+  pafp->nclaimed      = 0;
+  pafp->nreturned     = 0;
+  pafp->loader_done   = FALSE;
+  pafp->loader_status = eslOK;
+  pafp->do_stop       = FALSE;
+  pafp->nthreads      = 0;
+  pafp->err_linenumber= -1;
+  pafp->errmsg[0]     = '\0';
+
+  if (pafp->is_serial) { *ret_pafp = pafp; return eslOK; }
+
+  ESL_ALLOC(pafp->chunk, sizeof(ESL_MSAFILE_PARALLEL_CHUNK) * pafp->nchunks);
+  for (i = 0; i < pafp->nchunks; i++)
+    {
+      pafp->chunk[i].p              = NULL;
+      pafp->chunk[i].n              = 0;
+      pafp->chunk[i].buf            = NULL;
+      pafp->chunk[i].balloc         = 0;
+      pafp->chunk[i].offset         = 0;
+      pafp->chunk[i].linenumber     = 0;
+      pafp->chunk[i].msa            = NULL;
+      pafp->chunk[i].status         = eslOK;
+      pafp->chunk[i].err_linenumber = -1;
+      pafp->chunk[i].errmsg[0]      = '\0';
+      pafp->chunk[i].state          = eslMSAFILE_PARALLEL_EMPTY;
+    }
+
+  if ( pthread_mutex_init(&pafp->mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+  if ( pthread_cond_init (&pafp->cv,    NULL) != 0) { pthread_mutex_destroy(&pafp->mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+
+  if ( pthread_create(&pafp->loader_t, NULL, parallel_loader_thread, pafp) != 0) { status = eslESYS; goto THREADFAIL; }
+  pafp->nthreads++;
+  for (i = 0; i < pafp->nworkers; i++)
+    {
+      if ( pthread_create(&(pafp->worker_t[i]), NULL, parallel_parser_thread, pafp) != 0) { status = eslESYS; goto THREADFAIL; }
+      pafp->nthreads++;
+    }
+
+  *ret_pafp = pafp;
+  return eslOK;
+
+ THREADFAIL:
+  esl_msafile_parallel_Destroy(pafp);
+  *ret_pafp = NULL;
+  ESL_EXCEPTION(eslESYS, "pthread_create() failed");
+
+ ERROR:
+  if (pafp) { free(pafp->chunk); free(pafp); }
+  *ret_pafp = NULL;
+  return status;
+}
+
+
+/* Function:  esl_msafile_parallel_Read()
+ * Synopsis:  Read next MSA, from a multithreaded reader.
+ *
+ * Purpose:   Return the next alignment from the input of <pafp> in
+ *            <*ret_msa>. Same as <esl_msafile_Read()>, except for
+ *            where error information goes, below.
+ *
+ * Returns:   <eslOK> on success; <*ret_msa> is the next MSA.
+ *
+ *            <eslEOF> if no more alignments are found.
+ *
+ *            <eslEFORMAT> on a parse error. <pafp->errmsg> is a
+ *            user-directed error message, and <pafp->err_linenumber>
+ *            the line number. Pass <pafp> and the status to
+ *            <esl_msafile_parallel_ReadFailure()> to print them and
+ *            exit. Parsing may continue with the next alignment.
+ *
+ *            In each case, <*ret_msa> is <NULL> if no MSA is returned.
+ *
+ * Throws:    <eslEMEM>, <eslESYS>, <eslEINCONCEIVABLE>, as for
+ *            <esl_msafile_Read()>.
+ */
+int
+esl_msafile_parallel_Read(ESL_MSAFILE_PARALLEL *pafp, ESL_MSA **ret_msa)
+{
+  ESL_MSAFILE_PARALLEL_CHUNK *c;
+  int                         status;
+
+  pafp->errmsg[0]      = '\0';
+  pafp->err_linenumber = -1;
+
+  if (pafp->is_serial)
+    {
+      status = esl_msafile_Read(pafp->afp, ret_msa);
+      if (status == eslEFORMAT) { strcpy(pafp->errmsg, pafp->afp->errmsg); pafp->err_linenumber = pafp->afp->linenumber; }
+      return status;
+    }
+
+  if ( pthread_mutex_lock(&pafp->mutex) != 0) ESL_EXCEPTION(eslESYS, "pthread_mutex_lock() failed");
+  c = &(pafp->chunk[pafp->nreturned % pafp->nchunks]);
+  while (! (pafp->nreturned < pafp->nloaded && c->state == eslMSAFILE_PARALLEL_DONE) &&
+	 ! (pafp->loader_done && pafp->nreturned == pafp->nloaded))
+    if ( pthread_cond_wait(&pafp->cv, &pafp->mutex) != 0) ESL_EXCEPTION(eslESYS, "pthread_cond_wait() failed");
+
+  if (pafp->nreturned == pafp->nloaded)  // loader is done and we've returned everything it loaded
+    {
+      status = (pafp->loader_status == eslOK ? eslEOF : pafp->loader_status);
+      pthread_mutex_unlock(&pafp->mutex);
+      *ret_msa = NULL;
+      return status;
+    }
+
+  status   = c->status;
+  *ret_msa = c->msa;
+  if (status == eslEFORMAT) { strcpy(pafp->errmsg, c->errmsg); pafp->err_linenumber = c->err_linenumber; }
+
+  c->msa   = NULL;
+  c->state = eslMSAFILE_PARALLEL_EMPTY;
+  pafp->nreturned++;
+  if ( pthread_cond_broadcast(&pafp->cv)   != 0) ESL_EXCEPTION(eslESYS, "pthread_cond_broadcast() failed");
+  if ( pthread_mutex_unlock(&pafp->mutex)  != 0) ESL_EXCEPTION(eslESYS, "pthread_mutex_unlock() failed");
+  return status;
+}
+
+
+/* Function:  esl_msafile_parallel_ReadFailure()
+ * Synopsis:  Report diagnostics of a normal parse error, and exit.
+ *
+ * Purpose:   The equivalent of <esl_msafile_ReadFailure()> for a
+ *            multithreaded reader. Stop the reader's threads, print
+ *            diagnostics for the error <status> returned by
+ *            <esl_msafile_parallel_Read()>, and exit with <status>.
+ */
+void
+esl_msafile_parallel_ReadFailure(ESL_MSAFILE_PARALLEL *pafp, int status)
+{
+  ESL_MSAFILE *afp = pafp->afp;
+
+  parallel_stop(pafp);
+  strcpy(afp->errmsg, pafp->errmsg);
+  afp->linenumber = pafp->err_linenumber;
+  esl_msafile_ReadFailure(afp, status);
+}
+
+
+/* Function:  esl_msafile_parallel_Destroy()
+ * Synopsis:  Stop and free a multithreaded MSA reader.
+ *
+ * Purpose:   Stop the reader's threads, and free it, including any
+ *            parsed alignments that weren't read yet. The underlying
+ *            <ESL_MSAFILE> remains open; the caller closes it. Its
+ *            position in the input is wherever the loader stopped
+ *            reading, not after the last MSA that was returned.
+ *
+ *            If the input is a stream, stopping may have to wait
+ *            until the loader thread's current read returns.
+ */
+void
+esl_msafile_parallel_Destroy(ESL_MSAFILE_PARALLEL *pafp)
+{
+  int i;
+
+  if (pafp)
+    {
+      if (! pafp->is_serial)
+	{
+	  parallel_stop(pafp);
+	  pthread_cond_destroy(&pafp->cv);
+	  pthread_mutex_destroy(&pafp->mutex);
+	  for (i = 0; i < pafp->nchunks; i++)
+	    {
+	      free(pafp->chunk[i].buf);
+	      esl_msa_Destroy(pafp->chunk[i].msa);
+	    }
+	  free(pafp->chunk);
+	}
+      free(pafp);
+    }
+}
+/*------------- end, ESL_MSAFILE_PARALLEL -----------------------*/
+
+
+
+/*****************************************************************
+ * 2. Internal functions: loader and parser threads.
+ *****************************************************************/
+
+/* parallel_loader_thread()
+ * Load records into chunks, in input order, as chunks become free.
+ */
+static void *
+parallel_loader_thread(void *p)
+{
+  ESL_MSAFILE_PARALLEL       *pafp   = (ESL_MSAFILE_PARALLEL *) p;
+  ESL_MSAFILE_PARALLEL_CHUNK *c;
+  int                         status = eslOK;
+
+  pthread_mutex_lock(&pafp->mutex);
+  while (! pafp->do_stop)
+    {
+      c = &(pafp->chunk[pafp->nloaded % pafp->nchunks]);
+      if (c->state != eslMSAFILE_PARALLEL_EMPTY) { pthread_cond_wait(&pafp->cv, &pafp->mutex); continue; }
+      pthread_mutex_unlock(&pafp->mutex);
+
+      status = parallel_load(pafp, c);  // an EMPTY chunk belongs to the loader, so we can fill it unlocked
+
+      pthread_mutex_lock(&pafp->mutex);
+      if (status != eslOK) break;
+      c->state = eslMSAFILE_PARALLEL_LOADED;
+      pafp->nloaded++;
+      pthread_cond_broadcast(&pafp->cv);
+    }
+  pafp->loader_status = (status == eslEOF ? eslOK : status);
+  pafp->loader_done   = TRUE;
+  pthread_cond_broadcast(&pafp->cv);
+  pthread_mutex_unlock(&pafp->mutex);
+  return NULL;
+}
+
+
+/* parallel_parser_thread()
+ * Claim loaded records in order, and parse them.
+ */
+static void *
+parallel_parser_thread(void *p)
+{
+  ESL_MSAFILE_PARALLEL       *pafp = (ESL_MSAFILE_PARALLEL *) p;
+  ESL_MSAFILE_PARALLEL_CHUNK *c;
+
+  pthread_mutex_lock(&pafp->mutex);
+  while (1)
+    {
+      while (! pafp->do_stop && pafp->nclaimed == pafp->nloaded && ! pafp->loader_done)
+	pthread_cond_wait(&pafp->cv, &pafp->mutex);
+      if (pafp->do_stop || pafp->nclaimed == pafp->nloaded) break;
+
+      c = &(pafp->chunk[pafp->nclaimed % pafp->nchunks]);
+      c->state = eslMSAFILE_PARALLEL_PARSING;
+      pafp->nclaimed++;
+      pthread_mutex_unlock(&pafp->mutex);
+
+      parallel_parse(pafp, c);
+
+      pthread_mutex_lock(&pafp->mutex);
+      c->state = eslMSAFILE_PARALLEL_DONE;
+      pthread_cond_broadcast(&pafp->cv);
+    }
+  pthread_mutex_unlock(&pafp->mutex);
+  return NULL;
+}
+
+
+/* parallel_load()
+ * Read the next record from <pafp->afp> into chunk <c>: everything
+ * from the current position through the next line that starts with
+ * '//' (after optional leading whitespace, same as the Stockholm
+ * parser's test), or through EOF.
+ *
+ * If the input is entirely in memory (a slurped or mmap()'ed file, or
+ * a string), <c->p> just points into it. Otherwise we anchor the
+ * record in the buffer while we read it, then copy it to <c->buf>.
+ *
+ * Returns <eslOK> on success; <eslEOF> if there's no input left.
+ * Throws  <eslEMEM>, <eslESYS>, <eslEINCONCEIVABLE> on buffer errors.
+ */
+static int
+parallel_load(ESL_MSAFILE_PARALLEL *pafp, ESL_MSAFILE_PARALLEL_CHUNK *c)
+{
+  ESL_MSAFILE *afp   = pafp->afp;
+  ESL_BUFFER  *bf    = afp->bf;
+  esl_pos_t    start = esl_buffer_GetOffset(bf);
+  esl_pos_t    n;
+  char        *p;
+  int          status;
+
+  c->offset     = start;
+  c->linenumber = afp->linenumber + 1;
+
+  if ((status = esl_buffer_SetAnchor(bf, start)) != eslOK) return status;
+  while ((status = esl_msafile_GetLine(afp, &p, &n)) == eslOK)
+    {
+      while (n && (*p == ' ' || *p == '\t')) { p++; n--; }
+      if (esl_memstrpfx(p, n, "//")) break;
+    }
+  if (status != eslOK && status != eslEOF) goto ERROR;
+
+  c->n = esl_buffer_GetOffset(bf) - start;
+  if (c->n == 0) { status = eslEOF; goto ERROR; }
+
+  /* the anchor guarantees that bytes start..start+n-1 are in bf->mem */
+  p = bf->mem + (start - bf->baseoffset);
+  if (bf->mode_is == eslBUFFER_ALLFILE || bf->mode_is == eslBUFFER_MMAP || bf->mode_is == eslBUFFER_STRING)
+    c->p = p;
+  else
+    {
+      if (c->n > c->balloc) { ESL_REALLOC(c->buf, sizeof(char) * c->n); c->balloc = c->n; }
+      memcpy(c->buf, p, c->n);
+      c->p = c->buf;
+    }
+  esl_buffer_RaiseAnchor(bf, start);
+  return eslOK;
+
+ ERROR:
+  esl_buffer_RaiseAnchor(bf, start);
+  c->p = NULL;
+  c->n = 0;
+  return status;
+}
+
+
+/* parallel_parse()
+ * Parse the record in chunk <c> as a string input, and store the
+ * result in the chunk: <c->msa> and <c->status>, and on a format
+ * error, the message and (input-relative) line number.
+ */
+static void
+parallel_parse(ESL_MSAFILE_PARALLEL *pafp, ESL_MSAFILE_PARALLEL_CHUNK *c)
+{
+  ESL_MSAFILE  *wafp = NULL;
+  ESL_ALPHABET *abc  = pafp->abc;
+  int           status;
+
+  c->msa            = NULL;
+  c->err_linenumber = -1;
+  c->errmsg[0]      = '\0';
+
+  status = esl_msafile_OpenMem( (abc ? &abc : NULL), c->p, c->n, pafp->afp->format, &(pafp->afp->fmtd), &wafp);
+  if (status == eslOK)
+    {
+      wafp->linenumber = c->linenumber - 1;   // so error line numbers refer to the original input
+      status = esl_msafile_Read(wafp, &(c->msa));
+      if      (status == eslOK)      c->msa->offset += c->offset;
+      else if (status == eslEFORMAT) { strcpy(c->errmsg, wafp->errmsg); c->err_linenumber = wafp->linenumber; }
+    }
+  else if (wafp) strcpy(c->errmsg, wafp->errmsg);
+
+  esl_msafile_Close(wafp);
+  c->status = status;
+}
+
+
+/* parallel_stop()
+ * Tell all threads to stop, and wait for them.
+ */
+static void
+parallel_stop(ESL_MSAFILE_PARALLEL *pafp)
+{
+  int i;
+
+  if (pafp->is_serial || pafp->nthreads == 0) return;
+
+  pthread_mutex_lock(&pafp->mutex);
+  pafp->do_stop = TRUE;
+  pthread_cond_broadcast(&pafp->cv);
+  pthread_mutex_unlock(&pafp->mutex);
+
+  if (pafp->nthreads > 0) pthread_join(pafp->loader_t, NULL);
+  for (i = 0; i < pafp->nthreads-1; i++)
+    pthread_join(pafp->worker_t[i], NULL);
+  pafp->nthreads = 0;
+}
+/*-------------- end, internal functions ------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef eslMSAFILE_PARALLEL_TESTDRIVE
+
+#include "esl_random.h"
+
+/* utest_readorder()
+ * Write a bunch of random MSAs to a Stockholm file, separated by
+ * varying amounts of blank lines and comments. Read them with
+ * esl_msafile_Read(); then read them again with <nworkers> parser
+ * threads, from a file and from a stream, and with a serial
+ * pass-through reader. Check that we get identical MSAs, with the
+ * same offsets, in the same order.
+ */
+static void
+utest_readorder(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int nali, int nworkers)
+{
+  char                  msg[]       = "esl_msafile_parallel readorder unit test failed";
+  char                  tmpfile[32] = "esltmpXXXXXX";
+  FILE                 *fp          = NULL;
+  ESL_MSA             **msa         = NULL;
+  ESL_MSA              *msa2        = NULL;
+  ESL_MSAFILE          *afp         = NULL;
+  ESL_MSAFILE_PARALLEL *pafp        = NULL;
+  ESL_BUFFER           *bf          = NULL;
+  ESL_ALPHABET         *abc2        = NULL;
+  int                   i, mode;
+  int                   status;
+
+  if ((msa = malloc(sizeof(ESL_MSA *) * nali)) == NULL) esl_fatal(msg);
+  if (esl_tmpfile_named(tmpfile, &fp)          != eslOK) esl_fatal(msg);
+  for (i = 0; i < nali; i++)
+    {
+      if (esl_msa_Sample(rng, abc, 20, 100, &msa2) != eslOK) esl_fatal(msg);
+      if (esl_rnd_Roll(rng, 2))      fprintf(fp, "\n");
+      if (esl_rnd_Roll(rng, 4) == 0) fprintf(fp, "# a comment between records\n");
+      if (esl_msafile_Write(fp, msa2, esl_rnd_Roll(rng, 2) ? eslMSAFILE_STOCKHOLM : eslMSAFILE_PFAM) != eslOK) esl_fatal(msg);
+      esl_msa_Destroy(msa2);
+    }
+  if (esl_rnd_Roll(rng, 2)) fprintf(fp, "\n\n");
+  fclose(fp);
+
+  if (esl_msafile_Open(&abc2, tmpfile, NULL, eslMSAFILE_STOCKHOLM, NULL, &afp) != eslOK) esl_fatal(msg);
+  for (i = 0; i < nali; i++)
+    if (esl_msafile_Read(afp, &(msa[i])) != eslOK) esl_fatal(msg);
+  if (esl_msafile_Read(afp, &msa2) != eslEOF) esl_fatal(msg);
+  esl_msafile_Close(afp);
+
+  for (mode = 0; mode < 3; mode++)
+    {
+      switch (mode) {
+      case 0: // file, in parallel
+      case 2: // file, serial pass-through
+	if (esl_msafile_Open(&abc2, tmpfile, NULL, eslMSAFILE_STOCKHOLM, NULL, &afp) != eslOK) esl_fatal(msg);
+	break;
+      case 1: // stream, in parallel
+	if ((fp = fopen(tmpfile, "r"))                                        == NULL)  esl_fatal(msg);
+	if (esl_buffer_OpenStream(fp, &bf)                                    != eslOK) esl_fatal(msg);
+	if (esl_msafile_OpenBuffer(&abc2, bf, eslMSAFILE_STOCKHOLM, NULL, &afp) != eslOK) esl_fatal(msg);
+	break;
+      }
+      if (esl_msafile_parallel_Create(afp, (mode == 2 ? 0 : nworkers), &pafp) != eslOK) esl_fatal(msg);
+
+      for (i = 0; (status = esl_msafile_parallel_Read(pafp, &msa2)) == eslOK; i++)
+	{
+	  if (i >= nali)                           esl_fatal(msg);
+	  if (esl_msa_Compare(msa[i], msa2) != eslOK) esl_fatal(msg);
+	  if (msa[i]->offset != msa2->offset)        esl_fatal(msg);
+	  esl_msa_Destroy(msa2);
+	}
+      if (status != eslEOF || i != nali) esl_fatal(msg);
+
+      esl_msafile_parallel_Destroy(pafp);
+      esl_msafile_Close(afp);
+      if (mode == 1) fclose(fp);
+    }
+
+  for (i = 0; i < nali; i++) esl_msa_Destroy(msa[i]);
+  free(msa);
+  esl_alphabet_Destroy(abc2);
+  remove(tmpfile);
+}
+
+
+/* utest_format_error()
+ * A parse error in one record in the middle of the file is reported
+ * in order, with the line number in the original input; the records
+ * around it are still read correctly.
+ */
+static void
+utest_format_error(int nworkers)
+{
+  char                  msg[]  = "esl_msafile_parallel format error unit test failed";
+  char                  buf[]  = "# STOCKHOLM 1.0\nseq1 ACGU\nseq2 ACGU\n//\n"
+                                 "# STOCKHOLM 1.0\nseq1 ACGU\nseq2 ACG\n//\n"        // line 7: seq2 too short
+                                 "# STOCKHOLM 1.0\nseq1 ACGU\n//\n";
+  ESL_ALPHABET         *abc    = esl_alphabet_Create(eslRNA);
+  ESL_MSAFILE          *afp    = NULL;
+  ESL_MSAFILE_PARALLEL *pafp   = NULL;
+  ESL_MSA              *msa    = NULL;
+
+  if (esl_msafile_OpenMem(&abc, buf, -1, eslMSAFILE_STOCKHOLM, NULL, &afp) != eslOK)      esl_fatal(msg);
+  if (esl_msafile_parallel_Create(afp, nworkers, &pafp)                   != eslOK)      esl_fatal(msg);
+  if (esl_msafile_parallel_Read(pafp, &msa) != eslOK      || msa == NULL || msa->nseq != 2) esl_fatal(msg);
+  if (msa->offset != 0)                                                                     esl_fatal(msg);
+  esl_msa_Destroy(msa);
+  if (esl_msafile_parallel_Read(pafp, &msa) != eslEFORMAT || msa != NULL)                   esl_fatal(msg);
+  if (pafp->err_linenumber != 7 || pafp->errmsg[0] == '\0')                                 esl_fatal(msg);
+  if (esl_msafile_parallel_Read(pafp, &msa) != eslOK      || msa == NULL || msa->nseq != 1) esl_fatal(msg);
+  if (msa->offset != 77)                                                                    esl_fatal(msg);
+  esl_msa_Destroy(msa);
+  if (esl_msafile_parallel_Read(pafp, &msa) != eslEOF     || msa != NULL)                   esl_fatal(msg);
+
+  esl_msafile_parallel_Destroy(pafp);
+  esl_msafile_Close(afp);
+  esl_alphabet_Destroy(abc);
+}
+#endif /*eslMSAFILE_PARALLEL_TESTDRIVE*/
+/*------------------- end, unit tests ---------------------------*/
+#endif /*HAVE_PTHREAD*/
+
+
+
+/*****************************************************************
+ * 4. Test driver.
+ *****************************************************************/
+#ifdef eslMSAFILE_PARALLEL_TESTDRIVE
+/* compile: gcc -g -Wall -I. -L. -o esl_msafile_parallel_utest -DeslMSAFILE_PARALLEL_TESTDRIVE esl_msafile_parallel.c -leasel -lm -lpthread
+ * run:     ./esl_msafile_parallel_utest
+ */
+#include "esl_config.h"
+
+#include <stdio.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_msafile_parallel.h"
+
+static ESL_OPTIONS options[] = {
+   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
+  {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                 0},
+  {"-s",  eslARG_INT,       "0", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",       0},
+  {"-N",  eslARG_INT,      "50", NULL, NULL, NULL, NULL, NULL, "number of alignments in test file",   0},
+  {"-W",  eslARG_INT,       "4", NULL, NULL, NULL, NULL, NULL, "number of parser threads",            0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for msafile_parallel module";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go       = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng      = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+#ifdef HAVE_PTHREAD
+  ESL_ALPHABET   *abc      = esl_alphabet_Create(eslAMINO);
+  int             nali     = esl_opt_GetInteger(go, "-N");
+  int             nworkers = esl_opt_GetInteger(go, "-W");
+#endif
+
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
+
+#ifdef HAVE_PTHREAD
+  utest_readorder(rng, abc, nali, nworkers);
+  utest_readorder(rng, abc, nali, 1);
+  utest_format_error(nworkers);
+
+  esl_alphabet_Destroy(abc);
+#else
+  fprintf(stderr, "#  built without pthreads; nothing to test\n");
+#endif
+
+  fprintf(stderr, "#  status = ok\n");
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*eslMSAFILE_PARALLEL_TESTDRIVE*/
+/*------------------- end, test driver --------------------------*/
+
+
+
+/*****************************************************************
+ * 5. Example.
+ *****************************************************************/
+#if defined(eslMSAFILE_PARALLEL_EXAMPLE) && defined(HAVE_PTHREAD)
+/* compile: gcc -g -Wall -I. -L. -o esl_msafile_parallel_example -DeslMSAFILE_PARALLEL_EXAMPLE esl_msafile_parallel.c -leasel -lm -lpthread
+ * run:     ./esl_msafile_parallel_example -n 4 Pfam-A.seed
+ */
+#include "esl_config.h"
+
+#include <stdio.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_msa.h"
+#include "esl_msafile.h"
+#include "esl_msafile_parallel.h"
+
+static ESL_OPTIONS options[] = {
+   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
+  {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",            0},
+  {"-n",  eslARG_INT,       "4", NULL, "n>=0",NULL,NULL, NULL, "number of parser threads",       0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options] <msafile>";
+static char banner[] = "example of reading a multi-MSA file with parser threads";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS          *go      = esl_getopts_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char                 *msafile = esl_opt_GetArg(go, 1);
+  ESL_ALPHABET         *abc     = NULL;
+  ESL_MSAFILE          *afp     = NULL;
+  ESL_MSAFILE_PARALLEL *pafp    = NULL;
+  ESL_MSA              *msa     = NULL;
+  int                   nali    = 0;
+  int                   status;
+
+  if ((status = esl_msafile_Open(&abc, msafile, NULL, eslMSAFILE_UNKNOWN, NULL, &afp)) != eslOK)
+    esl_msafile_OpenFailure(afp, status);
+  if ((status = esl_msafile_parallel_Create(afp, esl_opt_GetInteger(go, "-n"), &pafp)) != eslOK)
+    esl_fatal("failed to start parallel reader");
+
+  while ((status = esl_msafile_parallel_Read(pafp, &msa)) == eslOK)
+    {
+      nali++;
+      printf("%-6d %-20s %6d seqs %6" PRId64 " columns\n", nali, msa->name ? msa->name : "(unnamed)", msa->nseq, msa->alen);
+      esl_msa_Destroy(msa);
+    }
+  if (nali == 0 || status != eslEOF) esl_msafile_parallel_ReadFailure(pafp, status);
+
+  esl_msafile_parallel_Destroy(pafp);
+  esl_msafile_Close(afp);
+  esl_alphabet_Destroy(abc);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*eslMSAFILE_PARALLEL_EXAMPLE && HAVE_PTHREAD*/
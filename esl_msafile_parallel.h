@@ -0,0 +1,84 @@
+/* Parallel reading of multi-MSA Stockholm/Pfam files.
+ */
+#ifndef eslMSAFILE_PARALLEL_INCLUDED
+#define eslMSAFILE_PARALLEL_INCLUDED
+#include "esl_config.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+#include "esl_msa.h"
+#include "esl_msafile.h"
+
+#define eslMSAFILE_PARALLEL_MAXWORKERS 64   // max number of parser threads
+
+/* ESL_MSAFILE_PARALLEL_CHUNK
+ * One alignment record, as it moves through the reader's pipeline:
+ * the loader copies (or points to) its text, a parser thread turns
+ * it into an ESL_MSA, and esl_msafile_parallel_Read() returns it.
+ */
+enum esl_msafile_parallel_state_e {
+  eslMSAFILE_PARALLEL_EMPTY   = 0,   // available to the loader
+  eslMSAFILE_PARALLEL_LOADED  = 1,   // has record text; waiting for a parser
+  eslMSAFILE_PARALLEL_PARSING = 2,   // a parser thread owns it
+  eslMSAFILE_PARALLEL_DONE    = 3    // parsed (or failed); waiting for Read()
+};
+
+typedef struct {
+  const char *p;                     // record text p[0..n-1]: points into afp->bf->mem, or to <buf>
+  esl_pos_t   n;
+  char       *buf;                   // private copy of record text, when input is a stream; else unused
+  esl_pos_t   balloc;                // current allocation of <buf>
+  esl_pos_t   offset;                // offset of p[0] in the input
+  int64_t     linenumber;            // input line number of p[0]; 1..
+
+  ESL_MSA    *msa;                   // parsed MSA, when DONE and status is eslOK
+  int         status;                // parse result: eslOK, eslEOF, eslEFORMAT, or an exception code
+  int64_t     err_linenumber;        // on eslEFORMAT: line number of the error, in input coords
+  char        errmsg[eslERRBUFSIZE]; // on eslEFORMAT: user-directed error message
+
+  enum esl_msafile_parallel_state_e state;
+} ESL_MSAFILE_PARALLEL_CHUNK;
+
+
+/* ESL_MSAFILE_PARALLEL
+ * A multithreaded reader wrapped around an open ESL_MSAFILE. One
+ * loader thread splits the input into records at '//' lines;
+ * <nworkers> parser threads parse records concurrently; Read()
+ * returns them in input order. At most <nchunks> records are
+ * in flight at once.
+ */
+typedef struct {
+  ESL_MSAFILE                *afp;         // open input. Only the loader thread touches it while threads run.
+  ESL_ALPHABET               *abc;         // copy of ptr to afp->abc (digital mode), or NULL (text)
+  int                         is_serial;   // TRUE if we're just passing calls through to esl_msafile_Read()
+
+  int                         nworkers;    // number of parser threads
+  int                         nchunks;     // number of records in flight
+  ESL_MSAFILE_PARALLEL_CHUNK *chunk;       // chunk[0..nchunks-1]; record i uses chunk[i % nchunks]
+
+  int64_t                     nloaded;     // # of records loaded so far
+  int64_t                     nclaimed;    // # of records claimed by parsers so far
+  int64_t                     nreturned;   // # of records returned by Read() so far
+  int                         loader_done; // TRUE when loader has reached end of input (or failed)
+  int                         loader_status; // eslOK, or exception code if the loader failed
+  int                         do_stop;     // TRUE when _Destroy() wants all threads to quit
+
+  pthread_mutex_t             mutex;       // protects all the counters, flags, and chunk states above
+  pthread_cond_t              cv;          // broadcast on any state change
+  pthread_t                   loader_t;
+  pthread_t                   worker_t[eslMSAFILE_PARALLEL_MAXWORKERS];
+  int                         nthreads;    // # of threads actually started (loader + workers)
+
+  char                        errmsg[eslERRBUFSIZE]; // user-directed message for last normal read error
+  int64_t                     err_linenumber;        // input line number of last normal read error
+} ESL_MSAFILE_PARALLEL;
+
+
+extern int  esl_msafile_parallel_Create(ESL_MSAFILE *afp, int nworkers, ESL_MSAFILE_PARALLEL **ret_pafp);
+extern int  esl_msafile_parallel_Read(ESL_MSAFILE_PARALLEL *pafp, ESL_MSA **ret_msa);
+extern void esl_msafile_parallel_ReadFailure(ESL_MSAFILE_PARALLEL *pafp, int status);
+extern void esl_msafile_parallel_Destroy(ESL_MSAFILE_PARALLEL *pafp);
+
+#endif /*HAVE_PTHREAD*/
+#endif /*eslMSAFILE_PARALLEL_INCLUDED*/
@@ -83,6 +83,9 @@ static int stockholm_parse_gc(ESL_MSAFILE *afp, ESL_STOCKHOLM_PARSEDATA *pd, ESL
 static int stockholm_parse_gr(ESL_MSAFILE *afp, ESL_STOCKHOLM_PARSEDATA *pd, ESL_MSA *msa, char *p, esl_pos_t n);
 static int stockholm_parse_sq(ESL_MSAFILE *afp, ESL_STOCKHOLM_PARSEDATA *pd, ESL_MSA *msa, char *p, esl_pos_t n);
 static int stockholm_parse_comment(ESL_MSA *msa, char *p, esl_pos_t n);
+static int stockholm_row_parse_gc(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, char *p, esl_pos_t n);
+static int stockholm_row_parse_gr(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, int has_row, char *p, esl_pos_t n);
+static int stockholm_row_parse_sq(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, char *p, esl_pos_t n);
 
 static int stockholm_get_seqidx   (ESL_MSA *msa, ESL_STOCKHOLM_PARSEDATA *pd, char *name, esl_pos_t n,      int *ret_idx);
 static int stockholm_get_gr_tagidx(ESL_MSA *msa, ESL_STOCKHOLM_PARSEDATA *pd, char *tag,  esl_pos_t taglen, int *ret_tagidx);
@@ -332,6 +335,105 @@ esl_msafile_stockholm_Read(ESL_MSAFILE *afp, ESL_MSA **ret_msa)
 }
 
 
+/* Function:  esl_msafile_stockholm_ReadRow()
+ * Synopsis:  Read next aligned sequence from Pfam/Stockholm input.
+ *
+ * Purpose:   Read the next aligned sequence from open Pfam or
+ *            Stockholm format input <afp> into <row>, without storing
+ *            the rest of the alignment. See <esl_msafile_ReadRow()>
+ *            for the protocol.
+ *
+ *            The alignment must be in one block, one line per
+ *            sequence, as Pfam format is; any <#=GR> lines for a
+ *            sequence must immediately follow it. <#=GS> lines, and
+ *            <#=GR> tags other than SS and PP, are skipped.
+ *
+ * Returns:   <eslOK> on success, with the next sequence in <row>.
+ *            <eslEOD> at the end of an alignment; <row->msa> now has
+ *            all its per-alignment annotation.
+ *            <eslEOF> if no more alignments are found.
+ *            <eslEFORMAT> on a parse error, with <afp->errmsg>,
+ *            <afp->linenumber>, etc. set as for
+ *            <esl_msafile_stockholm_Read()>. Interleaved (multiblock)
+ *            Stockholm input gets a parse error here too.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslESYS> if a system call fails, such as fread().
+ */
+int
+esl_msafile_stockholm_ReadRow(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row)
+{
+  char      *p;
+  esl_pos_t  n;
+  int        has_row = FALSE;   // TRUE once we've parsed this call's seq line; we return it when the next non-#=GR line shows up
+  int        status;
+
+  ESL_DASSERT1( (afp->format == eslMSAFILE_PFAM || afp->format == eslMSAFILE_STOCKHOLM) );
+
+  afp->errmsg[0] = '\0';
+
+  if (! row->in_msa)
+    {
+      /* Skip leading blank lines and comments; EOF here is a normal EOF return. */
+      do {
+	if ( ( status = esl_msafile_GetLine(afp, &p, &n)) != eslOK) return status;  /* (eslEOF) [eslEMEM|eslESYS] */
+      } while (esl_memspn(afp->line, afp->n, " \t") == afp->n ||
+	       (esl_memstrpfx(afp->line, afp->n, "#") && ! esl_memstrpfx(afp->line, afp->n, "# STOCKHOLM")));
+
+      if (! esl_memstrpfx(afp->line, afp->n, "# STOCKHOLM 1."))  ESL_FAIL(eslEFORMAT, afp->errmsg, "missing Stockholm header");
+      if ((status = esl_msafile_row_Begin(afp, row)) != eslOK) return status;
+    }
+
+  while ( (status = esl_msafile_GetLine(afp, &p, &n)) == eslOK) /* (eslEOF) [eslEMEM|eslESYS] */
+    {
+      while (n && ( *p == ' ' || *p == '\t')) { p++; n--; } /* skip leading whitespace */
+
+      if (! n) 
+	{ 
+	  if (row->nseq) row->blockdone = TRUE;
+	  continue;
+	}
+
+      if (esl_memstrpfx(p, n, "#=GR")) 
+	{
+	  if ((status = stockholm_row_parse_gr(afp, row, has_row, p, n)) != eslOK) return status;
+	  continue;
+	}
+
+      /* Any other line ends the current row, if we have one: put the line back, return the row */
+      if (has_row) 
+	{
+	  if ((status = esl_msafile_PutLine(afp)) != eslOK) return status;
+	  return eslOK;
+	}
+
+      if (esl_memstrpfx(p, n, "//"))
+	{
+	  if (row->nseq == 0) ESL_FAIL(eslEFORMAT, afp->errmsg, "no alignment data followed Stockholm header");
+	  row->msa->alen = row->alen;
+	  row->in_msa    = FALSE;
+	  return eslEOD;
+	}
+
+      if (*p == '#') 
+	{
+	  if      (esl_memstrpfx(p, n, "#=GF")) { if ((status = stockholm_parse_gf    (afp, NULL, row->msa, p, n)) != eslOK) return status; }
+	  else if (esl_memstrpfx(p, n, "#=GS")) { continue; }
+	  else if (esl_memstrpfx(p, n, "#=GC")) { if ((status = stockholm_row_parse_gc(afp, row, p, n))            != eslOK) return status; }
+	  else if (esl_memstrcmp(p, n, "# STOCKHOLM 1.0")) ESL_FAIL(eslEFORMAT, afp->errmsg, "two # STOCKHOLM 1.0 headers in a row?");
+	  else                                  { if ((status = stockholm_parse_comment(row->msa, p, n))           != eslOK) return status; }
+	}
+      else
+	{
+	  if ((status = stockholm_row_parse_sq(afp, row, p, n)) != eslOK) return status;
+	  has_row = TRUE;
+	}
+    }
+  if      (status == eslEOF) ESL_FAIL(eslEFORMAT, afp->errmsg, "missing // terminator after MSA");
+  return status;
+}
+
+
 /* Function:  esl_msafile_stockholm_Write()
  * Synopsis:  Write a Stockholm format alignment to a stream.
  *
@@ -926,6 +1028,108 @@ stockholm_parse_comment(ESL_MSA *msa, char *p, esl_pos_t n)
 
   return esl_msa_AddComment(msa, p, n);
 }
+
+/* stockholm_row_parse_sq()
+ * A sequence line, when reading row by row. Starts the next row.
+ */
+static int
+stockholm_row_parse_sq(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, char *p, esl_pos_t n)
+{
+  char     *seqname;
+  esl_pos_t seqnamelen;
+  int       status;
+
+  if (esl_memtok(&p, &n, " \t", &seqname, &seqnamelen) != eslOK) ESL_EXCEPTION(eslEINCONCEIVABLE, "EOL can't happen here.");
+  while (n && strchr(" \t", p[n-1])) n--; /* skip backwards from eol, to delimit aligned text without going through it */
+
+  if (! n)           ESL_FAIL(eslEFORMAT, afp->errmsg, "sequence line with no sequence?");
+  if (row->blockdone) ESL_FAIL(eslEFORMAT, afp->errmsg, "alignment has more than one block; interleaved Stockholm can't be read one sequence at a time (reformat to Pfam)");
+  if (row->alen != -1 && n != row->alen) ESL_FAIL(eslEFORMAT, afp->errmsg, "unexpected number of aligned residues parsed on line");
+
+  if ((status = esl_msafile_row_SetName(row, seqname, seqnamelen)) != eslOK) return status;
+  status = esl_msafile_row_AppendSeq(afp, row, p, n);
+  if      (status == eslEINVAL) ESL_FAIL(eslEFORMAT, afp->errmsg, "invalid sequence character(s) on line");
+  else if (status != eslOK)     return status;
+  if (row->n != n)              ESL_EXCEPTION(eslEINCONCEIVABLE, "implementation assumes that no symbols are ignored in inmap; else GR, GC text annotations are messed up");
+
+  row->alen = n;
+  row->nseq++;
+  return eslOK;
+}
+
+/* stockholm_row_parse_gr()
+ * A #=GR line, when reading row by row. Must annotate the current
+ * row (<has_row> is TRUE), immediately following its sequence line.
+ */
+static int
+stockholm_row_parse_gr(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, int has_row, char *p, esl_pos_t n)
+{
+  char      *gr,   *name,    *tag;
+  esl_pos_t  grlen, namelen,  taglen;
+
+  if (esl_memtok(&p, &n, " \t", &gr,   &grlen)    != eslOK) ESL_EXCEPTION(eslEINCONCEIVABLE, "EOL can't happen here.");
+  if (esl_memtok(&p, &n, " \t", &name, &namelen)  != eslOK) ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GR line missing <seqname>, <tag>, annotation");
+  if (esl_memtok(&p, &n, " \t", &tag,  &taglen)   != eslOK) ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GR line missing <tag>, annotation");
+  while (n && strchr(" \t", p[n-1])) n--;
+
+  if (! esl_memstrcmp(gr, grlen, "#=GR")) ESL_FAIL(eslEFORMAT, afp->errmsg, "faux #=GR line?");
+  if (! n)                                ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GR line missing annotation?");
+  if (! has_row || ! esl_memstrcmp(name, namelen, row->name)) 
+    ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GR %.*s line doesn't follow its sequence; can't read alignment one sequence at a time", (int) namelen, name);
+  if (n != row->alen)                     ESL_FAIL(eslEFORMAT, afp->errmsg, "unexpected # of aligned annotation in #=GR %.*s %.*s line", (int) namelen, name, (int) taglen, tag); 
+
+  if (esl_memstrcmp(tag, taglen, "SS"))
+    {
+      if (row->ss) ESL_FAIL(eslEFORMAT, afp->errmsg, "more than one #=GR %.*s SS line", (int) namelen, name);
+      return esl_msafile_row_SetSS(row, p, n);
+    }
+  else if (esl_memstrcmp(tag, taglen, "PP"))
+    {
+      if (row->pp) ESL_FAIL(eslEFORMAT, afp->errmsg, "more than one #=GR %.*s PP line", (int) namelen, name);
+      return esl_msafile_row_SetPP(row, p, n);
+    }
+  return eslOK;
+}
+
+/* stockholm_row_parse_gc()
+ * A #=GC line, when reading row by row: store it in <row->msa>.
+ * Without ESL_STOCKHOLM_PARSEDATA, since there's only one block: 
+ * each tag can only appear once.
+ */
+static int
+stockholm_row_parse_gc(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, char *p, esl_pos_t n)
+{
+  ESL_MSA   *msa   = row->msa;
+  char     **dest  = NULL;
+  char      *gc,   *tag;
+  esl_pos_t  gclen, taglen;
+  int        tagidx;
+  int        status;
+
+  if (esl_memtok(&p, &n, " \t", &gc,   &gclen)    != eslOK) ESL_EXCEPTION(eslEINCONCEIVABLE, "EOL can't happen here.");
+  if (esl_memtok(&p, &n, " \t", &tag,  &taglen)   != eslOK) ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GC line missing <tag>, annotation");
+  while (n && strchr(" \t", p[n-1])) n--;
+
+  if (! esl_memstrcmp(gc, gclen, "#=GC")) ESL_FAIL(eslEFORMAT, afp->errmsg, "faux #=GC line?");
+  if (! n)                                ESL_FAIL(eslEFORMAT, afp->errmsg, "#=GC line missing annotation?");
+  if (row->alen != -1 && n != row->alen)  ESL_FAIL(eslEFORMAT, afp->errmsg, "unexpected # of aligned annotation in #=GC %.*s line", (int) taglen, tag); 
+
+  if      (esl_memstrcmp(tag, taglen, "SS_cons"))  dest = &(msa->ss_cons);
+  else if (esl_memstrcmp(tag, taglen, "SA_cons"))  dest = &(msa->sa_cons);
+  else if (esl_memstrcmp(tag, taglen, "PP_cons"))  dest = &(msa->pp_cons);
+  else if (esl_memstrcmp(tag, taglen, "RF"))       dest = &(msa->rf);
+  else if (esl_memstrcmp(tag, taglen, "MM"))       dest = &(msa->mm);
+  else 
+    {
+      if ((status = stockholm_get_gc_tagidx(msa, NULL, tag, taglen, &tagidx)) != eslOK) return status;
+      dest = &(msa->gc[tagidx]);
+    }
+
+  if (*dest) ESL_FAIL(eslEFORMAT, afp->errmsg, "more than one #=GC %.*s line", (int) taglen, tag);
+  if ((status = esl_memstrdup(p, n, dest)) != eslOK) return status;
+  row->alen = n;
+  return eslOK;
+}
 /*------------- end, parsing Stockholm line types ---------------*/  
 
 
@@ -1039,10 +1243,12 @@ stockholm_get_gc_tagidx(ESL_MSA *msa, ESL_STOCKHOLM_PARSEDATA *pd, char *tag, es
   /* if we get here, this is a new tag we're adding. */
   ESL_REALLOC(msa->gc_tag, sizeof(char *)  * (msa->ngc+1)); /* +1, we're allocated one new tag at a time, as needed */
   ESL_REALLOC(msa->gc,     sizeof(char *)  * (msa->ngc+1));
-  ESL_REALLOC(pd->ogc_len, sizeof(int64_t) * (msa->ngc+1));
   msa->gc_tag[tagidx] = NULL;
   msa->gc[tagidx]     = NULL;
-  pd->ogc_len[tagidx] = 0;
+  if (pd) {			/* <pd> is NULL when we're reading row by row */
+    ESL_REALLOC(pd->ogc_len, sizeof(int64_t) * (msa->ngc+1));
+    pd->ogc_len[tagidx] = 0;
+  }
 
   if ( (status = esl_memstrdup(tag, taglen, &(msa->gc_tag[tagidx]))) != eslOK) return status; /* eslEMEM */
   msa->ngc++;
@@ -11,6 +11,7 @@
 extern int esl_msafile_stockholm_SetInmap     (ESL_MSAFILE *afp);
 extern int esl_msafile_stockholm_GuessAlphabet(ESL_MSAFILE *afp, int *ret_type);
 extern int esl_msafile_stockholm_Read         (ESL_MSAFILE *afp, ESL_MSA **ret_msa);
+extern int esl_msafile_stockholm_ReadRow      (ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row);
 extern int esl_msafile_stockholm_Write        (FILE *fp, const ESL_MSA *msa, int fmt);
 
 #endif /*eslMSAFILE_STOCKHOLM_INCLUDED*/
@@ -0,0 +1,537 @@
+/* esl_msapack : packed 4/5-bit storage of digital alignments
+ *
+ * A digital ESL_MSA stores one byte per aligned residue, with one
+ * allocation per sequence. For deep alignments (10^6 seqs x 10^4
+ * columns) that's 10GB. An ESL_MSAPACK holds the same residue codes
+ * at 4 or 5 bits each, in a single allocation: 2x or 1.6x smaller,
+ * and friendlier to the allocator. Names and annotation stay in
+ * the ESL_MSA; only the <ax> residue matrix is packed.
+ *
+ * Some common whole-alignment operations (fragment marking, column
+ * counting, and PB weighting in esl_msaweight) work directly on the
+ * packed form without unpacking it.
+ *
+ * Contents:
+ *   1. ESL_MSAPACK
+ *   2. Operations on packed alignments
+ *   3. Unit tests
+ *   4. Test driver
+ */
+#include "esl_config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_bitfield.h"
+#include "esl_msa.h"
+#include "esl_msapack.h"
+
+
+/*****************************************************************
+ * 1. ESL_MSAPACK
+ *****************************************************************/
+
+/* Function:  esl_msapack_Create()
+ * Synopsis:  Create a new packed alignment.
+ *
+ * Purpose:   Create a new packed alignment of <nseq> sequences by
+ *            <alen> columns, for digital alphabet <abc>, using
+ *            <nbits> = 4 or 5 bits per residue code. All codes are
+ *            initialized to 0.
+ *
+ *            Usually you'd create one from an MSA with
+ *            <esl_msapack_Pack()> instead.
+ *
+ * Returns:   pointer to the new <ESL_MSAPACK>.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_MSAPACK *
+esl_msapack_Create(const ESL_ALPHABET *abc, int nseq, int64_t alen, int nbits)
+{
+  ESL_MSAPACK *mp = NULL;
+  int          status;
+
+  ESL_DASSERT1(( nbits == 4 || nbits == 5 ));
+  ESL_DASSERT1(( nseq >= 1 && alen >= 0 ));
+
+  ESL_ALLOC(mp, sizeof(ESL_MSAPACK));
+  mp->abc   = abc;
+  mp->nseq  = nseq;
+  mp->alen  = alen;
+  mp->nbits = nbits;
+  mp->per   = 64 / nbits;
+  mp->mask  = (1ull << nbits) - 1;
+  mp->W     = ESL_MAX(1, (alen + mp->per - 1) / mp->per);   // at least 1, to avoid zero malloc on alen=0
+  mp->px    = NULL;
+
+  ESL_ALLOC(mp->px, sizeof(uint64_t) * nseq * mp->W);
+  memset(mp->px, 0, sizeof(uint64_t) * nseq * mp->W);
+  return mp;
+
+ ERROR:
+  esl_msapack_Destroy(mp);
+  return NULL;
+}
+
+
+/* Function:  esl_msapack_Pack()
+ * Synopsis:  Pack the residues of a digital MSA.
+ *
+ * Purpose:   Create a packed copy of the aligned residues in digital
+ *            alignment <msa>, and return it in <*ret_mp>. Uses 4 bits
+ *            per code if all codes in <msa> are < 16, else 5 bits.
+ *            Caller can then free <msa->ax> or the whole <msa>, if it
+ *            only needs the packed residues.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEINCOMPAT> if <msa> uses residue codes that don't fit
+ *            in 5 bits (only possible with large nonstandard
+ *            alphabets). <*ret_mp> is <NULL>.
+ *
+ * Throws:    <eslEINVAL> if <msa> isn't digital.
+ *            <eslEMEM> on allocation failure.
+ */
+int
+esl_msapack_Pack(const ESL_MSA *msa, ESL_MSAPACK **ret_mp)
+{
+  ESL_MSAPACK *mp    = NULL;
+  ESL_DSQ      maxx  = 0;
+  int          idx;
+  int64_t      apos;
+  int          status;
+
+  if (! (msa->flags & eslMSA_DIGITAL)) ESL_XEXCEPTION(eslEINVAL, "esl_msapack_Pack() needs a digital MSA");
+
+  for (idx = 0; idx < msa->nseq; idx++)
+    for (apos = 1; apos <= msa->alen; apos++)
+      maxx = ESL_MAX(maxx, msa->ax[idx][apos]);
+  if (maxx >= 32) { status = eslEINCOMPAT; goto ERROR; }
+
+  if ((mp = esl_msapack_Create(msa->abc, msa->nseq, msa->alen, (maxx < 16 ? 4 : 5))) == NULL) { status = eslEMEM; goto ERROR; }
+  for (idx = 0; idx < msa->nseq; idx++)
+    esl_msapack_SetRow(mp, idx, msa->ax[idx]);
+
+  *ret_mp = mp;
+  return eslOK;
+
+ ERROR:
+  esl_msapack_Destroy(mp);
+  *ret_mp = NULL;
+  return status;
+}
+
+
+/* Function:  esl_msapack_Unpack()
+ * Synopsis:  Unpack residues into a digital MSA.
+ *
+ * Purpose:   Copy the residues of packed alignment <mp> into the
+ *            <ax> rows of digital alignment <msa>, which must have
+ *            the same <nseq> and <alen> (for example, the <msa> that
+ *            <mp> was packed from, or a new one from
+ *            <esl_msa_CreateDigital(mp->abc, mp->nseq, mp->alen)>).
+ *            Sentinels are set at <ax[idx][0]> and <ax[idx][alen+1]>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <msa> isn't digital, or its dimensions
+ *            don't match <mp>.
+ */
+int
+esl_msapack_Unpack(const ESL_MSAPACK *mp, ESL_MSA *msa)
+{
+  int idx;
+
+  if (! (msa->flags & eslMSA_DIGITAL))                    ESL_EXCEPTION(eslEINVAL, "esl_msapack_Unpack() needs a digital MSA");
+  if (msa->nseq != mp->nseq || msa->alen != mp->alen)     ESL_EXCEPTION(eslEINVAL, "esl_msapack_Unpack(): MSA and packed MSA dimensions differ");
+
+  for (idx = 0; idx < mp->nseq; idx++)
+    esl_msapack_GetRow(mp, idx, msa->ax[idx]);
+  return eslOK;
+}
+
+
+/* Function:  esl_msapack_SetRow()
+ * Synopsis:  Pack one aligned digital sequence.
+ *
+ * Purpose:   Set row <idx> of <mp> to aligned digital sequence
+ *            <ax[1..alen]>. Codes must fit in <mp->nbits> bits.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+esl_msapack_SetRow(ESL_MSAPACK *mp, int idx, const ESL_DSQ *ax)
+{
+  uint64_t *row  = mp->px + idx * mp->W;
+  int64_t   apos = 1;
+  int64_t   q;
+  int       r;
+  uint64_t  w;
+
+  for (q = 0; q < mp->W; q++)
+    {
+      w = 0;
+      for (r = 0; r < mp->per && apos <= mp->alen; r++, apos++)
+        {
+          ESL_DASSERT1(( ax[apos] <= mp->mask ));
+          w |= (uint64_t) ax[apos] << (r * mp->nbits);
+        }
+      row[q] = w;
+    }
+  return eslOK;
+}
+
+
+/* Function:  esl_msapack_GetRow()
+ * Synopsis:  Unpack one aligned digital sequence.
+ *
+ * Purpose:   Unpack row <idx> of <mp> into caller-provided digital
+ *            sequence <ax>, allocated for at least <mp->alen+2>
+ *            residues: <ax[1..alen]> are the residue codes, and
+ *            <ax[0]> and <ax[alen+1]> are sentinels.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+esl_msapack_GetRow(const ESL_MSAPACK *mp, int idx, ESL_DSQ *ax)
+{
+  const uint64_t *row  = mp->px + idx * mp->W;
+  int64_t         apos = 1;
+  int64_t         q;
+  int             r;
+  uint64_t        w;
+
+  ax[0] = eslDSQ_SENTINEL;
+  for (q = 0; q < mp->W; q++)
+    for (w = row[q], r = 0; r < mp->per && apos <= mp->alen; r++, apos++, w >>= mp->nbits)
+      ax[apos] = (ESL_DSQ) (w & mp->mask);
+  ax[mp->alen+1] = eslDSQ_SENTINEL;
+  return eslOK;
+}
+
+
+/* Function:  esl_msapack_Sizeof()
+ * Synopsis:  Returns size of an <ESL_MSAPACK>, in bytes.
+ */
+size_t
+esl_msapack_Sizeof(const ESL_MSAPACK *mp)
+{
+  return sizeof(ESL_MSAPACK) + sizeof(uint64_t) * mp->nseq * mp->W;
+}
+
+
+/* Function:  esl_msapack_Destroy()
+ * Synopsis:  Frees an <ESL_MSAPACK>.
+ */
+void
+esl_msapack_Destroy(ESL_MSAPACK *mp)
+{
+  if (mp) free(mp->px);
+  free(mp);
+}
+/*------------------ end, ESL_MSAPACK ---------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Operations on packed alignments
+ *****************************************************************/
+
+/* residue_flags()
+ * Bit x of the result is set if digital code x is a residue
+ * (canonical or degenerate), as in <esl_abc_XIsResidue()>.
+ */
+static uint32_t
+residue_flags(const ESL_ALPHABET *abc)
+{
+  uint32_t flags = 0;
+  int      x;
+
+  for (x = 0; x < abc->Kp && x < 32; x++)
+    if (esl_abc_XIsResidue(abc, x)) flags |= (1u << x);
+  return flags;
+}
+
+
+/* Function:  esl_msapack_ResidueSpan()
+ * Synopsis:  Find first and last aligned residue of a packed row.
+ *
+ * Purpose:   Find the leftmost and rightmost columns <1..alen> that
+ *            have a residue (canonical or degenerate) in row <idx> of
+ *            <mp>, and return them in <*ret_lpos>, <*ret_rpos>. If
+ *            the row has no residues, <*ret_lpos> is <alen+1> and
+ *            <*ret_rpos> is 0, so <rpos-lpos+1 <= 0>; same
+ *            convention as the unpacked loops in <esl_msa> and
+ *            <esl_msaweight>.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+esl_msapack_ResidueSpan(const ESL_MSAPACK *mp, int idx, int64_t *ret_lpos, int64_t *ret_rpos)
+{
+  const uint64_t *row   = mp->px + idx * mp->W;
+  uint32_t        isres = residue_flags(mp->abc);
+  int64_t         lpos  = mp->alen+1;
+  int64_t         rpos  = 0;
+  int64_t         q, apos;
+  int             r;
+  uint64_t        w;
+
+  /* leftmost: scan words left to right */
+  for (q = 0; q < mp->W && lpos > mp->alen; q++)
+    for (w = row[q], r = 0, apos = q*mp->per+1; r < mp->per && apos <= mp->alen; r++, apos++, w >>= mp->nbits)
+      if (isres & (1u << (w & mp->mask))) { lpos = apos; break; }
+
+  /* rightmost: scan words right to left, remembering the last residue seen in each word */
+  if (lpos <= mp->alen)
+    for (q = mp->W-1; q >= 0 && rpos == 0; q--)
+      for (w = row[q], r = 0, apos = q*mp->per+1; r < mp->per && apos <= mp->alen; r++, apos++, w >>= mp->nbits)
+        if (isres & (1u << (w & mp->mask))) rpos = apos;
+
+  *ret_lpos = lpos;
+  *ret_rpos = rpos;
+  return eslOK;
+}
+
+
+/* Function:  esl_msapack_MarkFragments()
+ * Synopsis:  Heuristic definition of sequence fragments, packed version.
+ *
+ * Purpose:   Same as <esl_msa_MarkFragments()> for a digital MSA, but
+ *            on packed alignment <mp>: set bit <i> in <fragassign> if
+ *            seq <i> is a fragment, with aligned span from first to
+ *            last residue < <fragthresh> * <alen>.
+ *
+ *            <fragassign> is allocated here; caller frees.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ */
+int
+esl_msapack_MarkFragments(const ESL_MSAPACK *mp, float fragthresh, ESL_BITFIELD **ret_fragassign)
+{
+  ESL_BITFIELD *fragassign = NULL;
+  int64_t       minspan    = (int64_t) ceil(fragthresh * (float) mp->alen);
+  int64_t       lpos, rpos;
+  int           idx;
+  int           status;
+
+  if (( fragassign = esl_bitfield_Create(mp->nseq)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (idx = 0; idx < mp->nseq; idx++)
+    {
+      esl_msapack_ResidueSpan(mp, idx, &lpos, &rpos);
+      if (rpos-lpos+1 < minspan) esl_bitfield_Set(fragassign, idx);
+    }
+
+  *ret_fragassign = fragassign;
+  return eslOK;
+
+ ERROR:
+  esl_bitfield_Destroy(fragassign);
+  *ret_fragassign = NULL;
+  return status;
+}
+
+
+/* Function:  esl_msapack_ColumnCounts()
+ * Synopsis:  Count residue codes in each column of a packed alignment.
+ *
+ * Purpose:   Count the occurrences of each digital code in each column
+ *            of packed alignment <mp>, over all sequences, in
+ *            caller-provided matrix <ct[apos=(0).1..alen][x=0..Kp-1]>
+ *            (for example, from <esl_mat_ICreate(alen+1, abc->Kp)>).
+ *            <ct> is zeroed first; row <ct[0]> is unused and stays 0.
+ *
+ *            Rows are decoded a word at a time, streaming through the
+ *            packed matrix in memory order.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+esl_msapack_ColumnCounts(const ESL_MSAPACK *mp, int **ct)
+{
+  const uint64_t *row;
+  int64_t         q, apos;
+  int             idx, r;
+  uint64_t        w;
+
+  for (apos = 0; apos <= mp->alen; apos++)
+    memset(ct[apos], 0, sizeof(int) * mp->abc->Kp);
+
+  for (idx = 0; idx < mp->nseq; idx++)
+    {
+      row = mp->px + idx * mp->W;
+      for (q = 0; q < mp->W; q++)
+        for (w = row[q], r = 0, apos = q*mp->per+1; r < mp->per && apos <= mp->alen; r++, apos++, w >>= mp->nbits)
+          ct[apos][w & mp->mask]++;
+    }
+  return eslOK;
+}
+/*------------ end, operations on packed alignments -------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests
+ *****************************************************************/
+#ifdef eslMSAPACK_TESTDRIVE
+
+#include "esl_matrixops.h"
+#include "esl_random.h"
+
+/* utest_roundtrip()
+ * Pack and unpack a sampled MSA; check the residues, and the packed
+ * versions of fragment marking and column counting, against the
+ * unpacked MSA.
+ */
+static void
+utest_roundtrip(ESL_RANDOMNESS *rng, int abctype)
+{
+  char          msg[]      = "esl_msapack roundtrip unit test failed";
+  ESL_ALPHABET *abc        = esl_alphabet_Create(abctype);
+  ESL_MSA      *msa        = NULL;
+  ESL_MSA      *msa2       = NULL;
+  ESL_MSAPACK  *mp         = NULL;
+  ESL_BITFIELD *frag1      = NULL;
+  ESL_BITFIELD *frag2      = NULL;
+  int         **ct1        = NULL;
+  int         **ct2        = NULL;
+  float         fragthresh = esl_random(rng);
+  ESL_DSQ       maxx       = 0;
+  int           idx, x;
+  int64_t       apos;
+
+  if (esl_msa_Sample(rng, abc, 50, 100, &msa) != eslOK) esl_fatal(msg);
+
+  /* make some fragments, with leading/trailing gaps */
+  for (idx = 0; idx < msa->nseq; idx += 3)
+    for (apos = 1; apos <= msa->alen; apos++)
+      if (apos < msa->alen/3 || apos > 2*msa->alen/3) msa->ax[idx][apos] = abc->K;
+
+  for (idx = 0; idx < msa->nseq; idx++)
+    for (apos = 1; apos <= msa->alen; apos++)
+      maxx = ESL_MAX(maxx, msa->ax[idx][apos]);
+
+  if (esl_msapack_Pack(msa, &mp)   != eslOK)          esl_fatal(msg);
+  if (mp->nbits != (maxx < 16 ? 4 : 5))               esl_fatal(msg);
+  if (mp->nseq != msa->nseq || mp->alen != msa->alen) esl_fatal(msg);
+
+  for (idx = 0; idx < msa->nseq; idx++)
+    for (apos = 1; apos <= msa->alen; apos++)
+      if (esl_msapack_Get(mp, idx, apos) != msa->ax[idx][apos]) esl_fatal(msg);
+
+  if ((msa2 = esl_msa_CreateDigital(abc, msa->nseq, msa->alen)) == NULL) esl_fatal(msg);
+  if (esl_msapack_Unpack(mp, msa2) != eslOK)                             esl_fatal(msg);
+  for (idx = 0; idx < msa->nseq; idx++)
+    if (memcmp(msa->ax[idx], msa2->ax[idx], sizeof(ESL_DSQ) * (msa->alen+2)) != 0) esl_fatal(msg);
+
+  /* Set() one code in each row, check that its neighbors are untouched */
+  for (idx = 0; idx < msa->nseq; idx++)
+    {
+      apos = 1 + esl_rnd_Roll(rng, msa->alen);
+      x    = esl_rnd_Roll(rng, abc->K);
+      esl_msapack_Set(mp, idx, apos, x);
+      msa->ax[idx][apos] = x;
+    }
+  for (idx = 0; idx < msa->nseq; idx++)
+    for (apos = 1; apos <= msa->alen; apos++)
+      if (esl_msapack_Get(mp, idx, apos) != msa->ax[idx][apos]) esl_fatal(msg);
+
+  if (esl_msa_MarkFragments    (msa, fragthresh, &frag1) != eslOK) esl_fatal(msg);
+  if (esl_msapack_MarkFragments(mp,  fragthresh, &frag2) != eslOK) esl_fatal(msg);
+  for (idx = 0; idx < msa->nseq; idx++)
+    if (esl_bitfield_IsSet(frag1, idx) != esl_bitfield_IsSet(frag2, idx)) esl_fatal(msg);
+
+  ct1 = esl_mat_ICreate(msa->alen+1, abc->Kp);
+  ct2 = esl_mat_ICreate(msa->alen+1, abc->Kp);
+  esl_mat_ISet(ct1, msa->alen+1, abc->Kp, 0);
+  for (idx = 0; idx < msa->nseq; idx++)
+    for (apos = 1; apos <= msa->alen; apos++)
+      ct1[apos][msa->ax[idx][apos]]++;
+  if (esl_msapack_ColumnCounts(mp, ct2) != eslOK)                esl_fatal(msg);
+  if (esl_mat_ICompare(ct1, ct2, msa->alen+1, abc->Kp) != eslOK) esl_fatal(msg);
+
+  esl_mat_IDestroy(ct1);
+  esl_mat_IDestroy(ct2);
+  esl_bitfield_Destroy(frag1);
+  esl_bitfield_Destroy(frag2);
+  esl_msapack_Destroy(mp);
+  esl_msa_Destroy(msa2);
+  esl_msa_Destroy(msa);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_nbits()
+ * Nucleic alignments with '*' or '~' need 5 bits.
+ */
+static void
+utest_nbits(ESL_RANDOMNESS *rng)
+{
+  char          msg[] = "esl_msapack nbits unit test failed";
+  ESL_ALPHABET *abc   = esl_alphabet_Create(eslDNA);
+  ESL_MSA      *msa   = NULL;
+  ESL_MSAPACK  *mp    = NULL;
+
+  if (esl_msa_Sample(rng, abc, 10, 50, &msa) != eslOK) esl_fatal(msg);
+  msa->ax[0][1] = esl_abc_XGetMissing(abc);
+
+  if (esl_msapack_Pack(msa, &mp) != eslOK)                  esl_fatal(msg);
+  if (mp->nbits != 5)                                       esl_fatal(msg);
+  if (esl_msapack_Get(mp, 0, 1) != esl_abc_XGetMissing(abc)) esl_fatal(msg);
+
+  esl_msapack_Destroy(mp);
+  esl_msa_Destroy(msa);
+  esl_alphabet_Destroy(abc);
+}
+#endif /*eslMSAPACK_TESTDRIVE*/
+/*------------------- end, unit tests ---------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef eslMSAPACK_TESTDRIVE
+
+#include "esl_getopts.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                             docgroup*/
+  { "-h",  eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",    0 },
+  { "-s",  eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for packed MSA module";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng  = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  int             i;
+
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
+
+  for (i = 0; i < 10; i++)
+    {
+      utest_roundtrip(rng, eslAMINO);
+      utest_roundtrip(rng, eslDNA);
+      utest_roundtrip(rng, eslRNA);
+    }
+  utest_nbits(rng);
+
+  fprintf(stderr, "#  status = ok\n");
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*eslMSAPACK_TESTDRIVE*/
+/*------------------ end, test driver ---------------------------*/
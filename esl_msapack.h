@@ -0,0 +1,70 @@
+/* esl_msapack : packed 4/5-bit storage of digital alignments
+ */
+#ifndef eslMSAPACK_INCLUDED
+#define eslMSAPACK_INCLUDED
+#include "esl_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_bitfield.h"
+#include "esl_msa.h"
+
+/* ESL_MSAPACK
+ * The aligned digital sequences of an MSA, packed <nbits> per
+ * residue code into 64-bit words: 4 bits (16 codes per word) when
+ * all codes in the alignment are < 16, as for nucleic alphabets
+ * without '*' or '~'; else 5 bits (12 codes per word), enough for
+ * all codes of the amino alphabet. Row <idx> is <W> words,
+ * <px[idx*W..idx*W+W-1]>, all in one allocation; unused high bits of
+ * each word are 0.
+ *
+ * Columns are indexed 1..alen, same as <msa->ax[idx][apos]>.
+ */
+typedef struct {
+  const ESL_ALPHABET *abc;   // digital alphabet (a copy of the ptr, not the alphabet itself)
+  int       nseq;            // number of sequences (rows)
+  int64_t   alen;            // number of columns
+  int       nbits;           // bits per code: 4 or 5
+  int       per;             // codes per 64-bit word: 16 or 12
+  uint64_t  mask;            // (1 << nbits) - 1
+  int64_t   W;               // words per row: ceil(alen / per)
+  uint64_t *px;              // packed rows, px[0..nseq*W-1]
+} ESL_MSAPACK;
+
+/* esl_msapack_Get()
+ * Return residue code at column <apos> (1..alen) of seq <idx>.
+ */
+static inline ESL_DSQ
+esl_msapack_Get(const ESL_MSAPACK *mp, int idx, int64_t apos)
+{
+  int64_t q = (apos-1) / mp->per;
+  int     r = (int) ((apos-1) - q * mp->per);
+  return (ESL_DSQ) ((mp->px[idx * mp->W + q] >> (r * mp->nbits)) & mp->mask);
+}
+
+/* esl_msapack_Set()
+ * Set residue code <x> at column <apos> (1..alen) of seq <idx>.
+ * <x> must fit in <nbits>.
+ */
+static inline void
+esl_msapack_Set(ESL_MSAPACK *mp, int idx, int64_t apos, ESL_DSQ x)
+{
+  int64_t   q = (apos-1) / mp->per;
+  int       r = (int) ((apos-1) - q * mp->per);
+  uint64_t *w = mp->px + idx * mp->W + q;
+  *w = (*w & ~(mp->mask << (r * mp->nbits))) | ((uint64_t) x << (r * mp->nbits));
+}
+
+extern ESL_MSAPACK *esl_msapack_Create (const ESL_ALPHABET *abc, int nseq, int64_t alen, int nbits);
+extern int          esl_msapack_Pack   (const ESL_MSA *msa, ESL_MSAPACK **ret_mp);
+extern int          esl_msapack_Unpack (const ESL_MSAPACK *mp, ESL_MSA *msa);
+extern int          esl_msapack_SetRow (ESL_MSAPACK *mp, int idx, const ESL_DSQ *ax);
+extern int          esl_msapack_GetRow (const ESL_MSAPACK *mp, int idx, ESL_DSQ *ax);
+extern size_t       esl_msapack_Sizeof (const ESL_MSAPACK *mp);
+extern void         esl_msapack_Destroy(ESL_MSAPACK *mp);
+
+extern int          esl_msapack_ResidueSpan  (const ESL_MSAPACK *mp, int idx, int64_t *ret_lpos, int64_t *ret_rpos);
+extern int          esl_msapack_MarkFragments(const ESL_MSAPACK *mp, float fragthresh, ESL_BITFIELD **ret_fragassign);
+extern int          esl_msapack_ColumnCounts (const ESL_MSAPACK *mp, int **ct);
+
+#endif /*eslMSAPACK_INCLUDED*/
@@ -17,7 +17,7 @@
  * Contents:
  *   1. Position-based (PB) weighting
  *   2. Optional config, stats collection for advanced PB weighting
- *   3. Other weighting algorithms (GSC, BLOSUM)
+ *   3. Other weighting algorithms (GSC, incremental GSC, BLOSUM)
  *   4. %id filtering
  *   5. Benchmark
  *   6. Stats driver
@@ -30,6 +30,9 @@
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "easel.h"
 #include "esl_alphabet.h"
@@ -38,7 +41,11 @@
 #include "esl_matrixops.h"
 #include "esl_msa.h"
 #include "esl_msacluster.h"
+#include "esl_msapack.h"
 #include "esl_quicksort.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
 #include "esl_tree.h"
 #include "esl_vectorops.h"
 
@@ -56,12 +63,65 @@
  *   mode alignments; text mode PB algorithm remains as it was.
  */
 
-static int  consensus_by_rf    (const ESL_MSA *msa, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
-static int  consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
-static int  consensus_by_all   (const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
-static int  collect_counts     (const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, const int *conscols, int ncons, int **ct, ESL_MSAWEIGHT_DAT *dat);
+/* PB_ALI
+ * The residues that PB weighting reads: a digital ESL_MSA, or an
+ * ESL_MSAPACK, which is read without unpacking it. Everything goes
+ * through pb_ali_Get() and pb_ali_Span(), so the same code weights
+ * either one.
+ */
+typedef struct {
+  const ESL_ALPHABET *abc;
+  int                 nseq;
+  int64_t             alen;
+  const ESL_MSA      *msa;      // digital MSA, or NULL if <mp>
+  const ESL_MSAPACK  *mp;       // packed MSA, or NULL if <msa>
+} PB_ALI;
+
+static void pb_ali_Init(PB_ALI *ali, const ESL_MSA *msa, const ESL_MSAPACK *mp);
+static void pb_ali_Span(const PB_ALI *ali, int idx, int64_t *ret_lpos, int64_t *ret_rpos);
+
+/* pb_ali_Get()
+ * Return the residue code at column <apos> (1..alen) of seq <idx>.
+ */
+static inline ESL_DSQ
+pb_ali_Get(const PB_ALI *ali, int idx, int64_t apos)
+{
+  return (ali->msa ? ali->msa->ax[idx][apos] : esl_msapack_Get(ali->mp, idx, apos));
+}
+
+static int  pb_weights         (const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, const char *rf, double *wgt, ESL_MSAWEIGHT_DAT *dat);
+static int  consensus_by_rf    (const ESL_ALPHABET *abc, const char *rf, int64_t alen, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
+static int  consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
+static int  consensus_by_all   (const ESL_MSAWEIGHT_CFG *cfg, const ESL_ALPHABET *abc, int64_t alen, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat);
+static int  collect_counts     (const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, const int *conscols, int ncons, int **ct, ESL_MSAWEIGHT_DAT *dat);
 static int  msaweight_PB_txt(ESL_MSA *msa);
 
+/* PB_WORK
+ * A range of sequences for one of PB weighting's two passes over the
+ * alignment: collecting symbol counts per column, then summing each
+ * sequence's weight. <pb_run()> does a pass in the caller's thread,
+ * or divides the sequences among worker threads (<cfg->ncpu>).
+ */
+#define PB_COUNTS  0
+#define PB_WEIGHTS 1
+#define PB_MINSEQ  1024		/* minimum # of seqs per worker thread */
+
+typedef struct {
+  int                phase;     // PB_COUNTS | PB_WEIGHTS
+  const PB_ALI      *ali;       // alignment being weighted
+  float              fragthresh;// PB_COUNTS: fragment definition
+  const int         *conscols;  // consensus columns [0..ncons-1]; PB_COUNTS can have ncons = 0, to count all columns
+  int                ncons;
+  int                idx0, idx1;// seqs idx0..idx1-1 are in this range
+  int              **ct;        // PB_COUNTS: counts for this range, ct[apos=(0).1..alen][a=0..Kp-1]; PB_WEIGHTS: total counts
+  int                nfrag;     // PB_COUNTS: # of fragments in this range
+  const int         *r;         // PB_WEIGHTS: # of different canonical residues in each consensus column [0..ncons-1]
+  double            *wgt;       // PB_WEIGHTS: weights, [idx0..idx1-1] set here
+} PB_WORK;
+
+static void pb_rows(PB_WORK *wk);
+static int  pb_run (const ESL_MSAWEIGHT_CFG *cfg, PB_WORK *wk);
+
 /* Function:  esl_msaweight_PB()
  * Synopsis:  PB (position-based) weights.
  *
@@ -167,6 +227,15 @@ esl_msaweight_PB(ESL_MSA *msa)
  *            MSAs, and can optionally take customized parameters
  *            <cfg>, and optionally collect data about the computation
  *            in <dat>.
+ *
+ *            If <cfg->ncpu> is $> 1$ (and Easel was built with
+ *            POSIX threads), the two passes over the sequences
+ *            (counting residues in each column, then summing each
+ *            sequence's weight) are divided among up to <cfg->ncpu>
+ *            worker threads, each taking a contiguous range of at
+ *            least 1024 sequences and keeping its own column counts.
+ *            The weights are identical to the serial calculation.
+ *            Each thread's counts take $O(LK)$ memory.
  *            
  * Args:      cfg - optional customized parameters, or NULL to use defaults.
  *            msa - MSA to weight; weights stored in msa->wgt[]
@@ -177,10 +246,32 @@ esl_msaweight_PB(ESL_MSA *msa)
  *            <msa->flags>.  <dat>, if provided, contains data about
  *            stuff that happened during the weight computation.
  *
- * Throws:    (no abnormal error conditions)
+ * Throws:    <eslEMEM> on allocation error.
  */
 int
 esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_DAT *dat)
+{
+  PB_ALI ali;
+  int    status;
+
+  /* Contract checks & bailouts */
+  ESL_DASSERT1(( msa->nseq >= 1 && msa->alen >= 1));
+  ESL_DASSERT1(( msa->flags & eslMSA_DIGITAL ));
+  if (msa->nseq == 1) { msa->wgt[0] = 1.0; return eslOK; }
+
+  pb_ali_Init(&ali, msa, NULL);
+  if ((status = pb_weights(cfg, &ali, msa->rf, msa->wgt, dat)) != eslOK) return status;
+  msa->flags |= eslMSA_HASWGTS;
+  return eslOK;
+}
+
+/* pb_weights()
+ * The PB weighting calculation of esl_msaweight_PB_adv() and
+ * esl_msaweight_PB_packed(), for alignment <ali> of >= 2 seqs with
+ * optional RF annotation <rf>. Weights go in <wgt[0..nseq-1]>.
+ */
+static int
+pb_weights(const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, const char *rf, double *wgt, ESL_MSAWEIGHT_DAT *dat)
 {
   int   ignore_rf   = (cfg? cfg->ignore_rf  : eslMSAWEIGHT_IGNORE_RF);      // default is FALSE: use RF annotation as consensus definition, if RF is present
   int   allow_samp  = (cfg? cfg->allow_samp : eslMSAWEIGHT_ALLOW_SAMP);     // default is TRUE: allow subsampling speed optimization
@@ -189,34 +280,29 @@ esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_D
   int  *r           = NULL;     // number of different canonical residues used in each consensus column. r[j=0..ncons-1]
   int  *conscols    = NULL;     // list of consensus column indices [0..ncons-1]
   int   ncons       = 0;        // number of consensus column indices in <conscols> list
-  int   idx, apos, j, a;        // indices over sequences, original columns, consensus columns, symbols
-  int   rlen;                   // number of canonical residues in a seq; used for first PB normalization
+  PB_WORK wk;                   // pass over all seqs, to weight them
+  int   apos, j, a;             // indices over original columns, consensus columns, symbols
   int   status = eslOK;
 
-  /* Contract checks & bailouts */
-  ESL_DASSERT1(( msa->nseq >= 1 && msa->alen >= 1));
-  ESL_DASSERT1(( msa->flags & eslMSA_DIGITAL ));
-  if (msa->nseq == 1) { msa->wgt[0] = 1.0; return eslOK; }
-
   /* Allocations */
-  ct = esl_mat_ICreate( msa->alen+1, msa->abc->Kp );      // (0).1..alen; 0..Kp-1
-  ESL_ALLOC(conscols, sizeof(int) * msa->alen);
+  ct = esl_mat_ICreate( ali->alen+1, ali->abc->Kp );      // (0).1..alen; 0..Kp-1
+  ESL_ALLOC(conscols, sizeof(int) * ali->alen);
 
   /* Determine consensus columns early if we can. (ncons stays = 0 if neither way gets used.) */
-  if      (! ignore_rf && msa->rf)                consensus_by_rf(msa, conscols, &ncons, dat);
-  else if (allow_samp  && msa->nseq > sampthresh) consensus_by_sample(cfg, msa, ct, conscols, &ncons, dat);
+  if      (! ignore_rf && rf)                      consensus_by_rf(ali->abc, rf, ali->alen, conscols, &ncons, dat);
+  else if (allow_samp  && ali->nseq > sampthresh) consensus_by_sample(cfg, ali, ct, conscols, &ncons, dat);
 
   /* Collect count matrix ct[apos][a]  (either all columns, or if we have consensus already, only consensus columns) */
-  collect_counts(cfg, msa, conscols, ncons, ct, dat);
+  if ((status = collect_counts(cfg, ali, conscols, ncons, ct, dat)) != eslOK) goto ERROR;
 
   /* If we still haven't determined consensus columns yet, do it now, using <ct> */
-  if (! ncons) consensus_by_all(cfg, msa, ct, conscols, &ncons, dat);
+  if (! ncons) consensus_by_all(cfg, ali->abc, ali->alen, ct, conscols, &ncons, dat);
 
   /* If we *still* have no consensus columns, that's pretty pathological -- use 'em all */
   if (! ncons)
     {
-      for (apos = 1; apos <= msa->alen; apos++) conscols[apos-1] = apos; 
-      ncons = msa->alen; 
+      for (apos = 1; apos <= ali->alen; apos++) conscols[apos-1] = apos; 
+      ncons = ali->alen; 
       if (dat) dat->cons_allcols = TRUE;
     }
   
@@ -226,29 +312,24 @@ esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_D
   for (j = 0; j < ncons; j++)
     {
       apos = conscols[j];
-      for (a = 0; a < msa->abc->K; a++)
+      for (a = 0; a < ali->abc->K; a++)
 	if (ct[apos][a] > 0) r[j]++;
     }
 
   /* Bump sequence weights using PB weighting rule */
-  esl_vec_DSet(msa->wgt, msa->nseq, 0.0);
-  for (idx = 0; idx < msa->nseq; idx++)
-    {
-      rlen = 0;
-      for (j = 0; j < ncons; j++)
-	{
-	  apos = conscols[j];
-	  a    = msa->ax[idx][apos];
-	  msa->wgt[idx] += (a >= msa->abc->K ? 0. : 1. / (double) (r[j] * ct[apos][a])); // <= This is the PB weight rule.
-	  rlen          += (a >= msa->abc->K ? 0  : 1);                                  //    (ternary is faster than an if)
-	}
-      if (rlen > 0) msa->wgt[idx] /= (double) rlen;  // first normalization, by unaligned seq length
-    }
+  memset(&wk, 0, sizeof(PB_WORK));
+  wk.phase    = PB_WEIGHTS;
+  wk.ali      = ali;
+  wk.conscols = conscols;
+  wk.ncons    = ncons;
+  wk.ct       = ct;
+  wk.r        = r;
+  wk.wgt      = wgt;
+  if ((status = pb_run(cfg, &wk)) != eslOK) goto ERROR;
 
   /* Normalize weights to sum to N */
-  esl_vec_DNorm(msa->wgt, msa->nseq);
-  esl_vec_DScale(msa->wgt, msa->nseq, (double) msa->nseq);
-  msa->flags |= eslMSA_HASWGTS;
+  esl_vec_DNorm(wgt, ali->nseq);
+  esl_vec_DScale(wgt, ali->nseq, (double) ali->nseq);
 
  ERROR: 
   esl_mat_IDestroy(ct);
@@ -259,9 +340,9 @@ esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_D
 }
 
 /* consensus_by_rf()
- * Use RF annotation to define consensus columns.
+ * Use RF annotation <rf[0..alen-1]> to define consensus columns.
  *
- * <conscols> is allocated for up to <msa->alen> indices of consensus columns.
+ * <conscols> is allocated for up to <alen> indices of consensus columns.
  * Upon return, it contains a list of indices, each 1..alen, and 
  * <ret_ncons> is the length of the list (the number of consensus cols).
  * (1-based, not 0-, because it's a consensus for a digital mode alignment).
@@ -269,14 +350,14 @@ esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_D
  * Returns <eslOK> on success.
  */
 static int
-consensus_by_rf(const ESL_MSA *msa, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
+consensus_by_rf(const ESL_ALPHABET *abc, const char *rf, int64_t alen, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
 {
   int ncons = 0;
   int apos;
 
-  for (apos = 1; apos <= msa->alen; apos++)
+  for (apos = 1; apos <= alen; apos++)
     {
-      if (esl_abc_CIsGap(msa->abc, msa->rf[apos-1])) continue;
+      if (esl_abc_CIsGap(abc, rf[apos-1])) continue;
       conscols[ncons] = apos;
       ncons++;
     }
@@ -303,7 +384,7 @@ consensus_by_rf(const ESL_MSA *msa, int *conscols, int *ret_ncons, ESL_MSAWEIGHT
  * sequences instead.
  * 
  * In:   cfg      - optional configuration options, or NULL to use all defaults
- *       msa      - MSA to determine consensus for
+ *       ali      - alignment to determine consensus for
  *       ct       - allocated space for [(0).1..alen][0..Kp-1] observed symbol counts; contents irrelevant
  *       conscols - allocated space for up to <alen> consensus column indices
  *       
@@ -319,7 +400,7 @@ consensus_by_rf(const ESL_MSA *msa, int *conscols, int *ret_ncons, ESL_MSAWEIGHT
  * Throws <eslEMEM> on allocation failure.
  */     
 static int
-consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
+consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
 {
   float       fragthresh  = (cfg? cfg->fragthresh : eslMSAWEIGHT_FRAGTHRESH);
   float       symfrac     = (cfg? cfg->symfrac    : eslMSAWEIGHT_SYMFRAC);
@@ -331,38 +412,36 @@ consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct,
   int         ncons       = 0;        // number of consensus columns defined
   int         tot;                    // total # of residues+gaps in a column
   int         minspan;                 
-  int         apos, a;
-  int         lpos, rpos;
-  int         i, idx;
+  int64_t     lpos, rpos, apos;
+  int         a, i, idx;
   int         status      = eslOK;
 
   ESL_ALLOC(sampidx, sizeof(int64_t) * nsamp);
-  esl_mat_ISet(ct, msa->alen+1, msa->abc->Kp, 0);
+  esl_mat_ISet(ct, ali->alen+1, ali->abc->Kp, 0);
   if (dat) dat->seed = esl_rand64_GetSeed(rng);
 
-  esl_rand64_Deal(rng, nsamp, (int64_t) msa->nseq, sampidx);  // <sampidx> is now an ordered list of <nsamp> indices in range 0..nseq-1
+  esl_rand64_Deal(rng, nsamp, (int64_t) ali->nseq, sampidx);  // <sampidx> is now an ordered list of <nsamp> indices in range 0..nseq-1
 
-  minspan = (int) ceil( fragthresh * (float) msa->alen );     // define alispan as aligned length from first to last non-gap. If alispan < minspan, define seq as a fragment
+  minspan = (int) ceil( fragthresh * (float) ali->alen );     // define alispan as aligned length from first to last non-gap. If alispan < minspan, define seq as a fragment
   for (i = 0; i < nsamp; i++)
     {
       idx = (int) sampidx[i];
 
-      for (lpos = 1;         lpos <= msa->alen; lpos++) if (esl_abc_XIsResidue(msa->abc, msa->ax[idx][lpos])) break;
-      for (rpos = msa->alen; rpos >= 1;         rpos--) if (esl_abc_XIsResidue(msa->abc, msa->ax[idx][rpos])) break;
-      if  (rpos - lpos + 1 < minspan) nfrag++; else { lpos = 1; rpos = msa->alen; }   
+      pb_ali_Span(ali, idx, &lpos, &rpos);
+      if  (rpos - lpos + 1 < minspan) nfrag++; else { lpos = 1; rpos = ali->alen; }   
 
       for (apos = lpos; apos <= rpos; apos++)
-	ct[apos][msa->ax[idx][apos]]++;
+	ct[apos][pb_ali_Get(ali, idx, apos)]++;
     }
 
   if (dat) dat->samp_nfrag = nfrag;
 
   if (nfrag <= maxfrag)
     {
-      for (apos = 1; apos <= msa->alen; apos++)
+      for (apos = 1; apos <= ali->alen; apos++)
 	{
-	  for (tot = 0, a = 0; a < msa->abc->Kp-2; a++) tot += ct[apos][a];  // i.e. <tot> symbols over esl_abc_XIsResidue() || esl_abc_XIsGap(); inclusive of degeneracies, exclusive of missing | nonresidue.
-	  if ( ((float) ct[apos][msa->abc->K] / (float) tot) < symfrac)      // This is the rule for determining a consensus column: if the frequency of residues/(residues+gaps) >= symfrac 
+	  for (tot = 0, a = 0; a < ali->abc->Kp-2; a++) tot += ct[apos][a];  // i.e. <tot> symbols over esl_abc_XIsResidue() || esl_abc_XIsGap(); inclusive of degeneracies, exclusive of missing | nonresidue.
+	  if ( ((float) ct[apos][ali->abc->K] / (float) tot) < symfrac)      // This is the rule for determining a consensus column: if the frequency of residues/(residues+gaps) >= symfrac 
 	    conscols[ncons++] = apos;
 	}
       if (dat) dat->cons_by_sample = TRUE;
@@ -388,8 +467,9 @@ consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct,
  * counts in just those columns, then we had to collect observed
  * counts on all columns, and now we define the consensus.
  * 
- * Because we do this from counts, not the MSA, <msa> here is only
- * used for dimensions <alen> and <Kp>.
+ * Because we do this from counts, not the MSA, we only need the
+ * alphabet <abc> and alignment length <alen>. That way this works for
+ * packed alignments too.
  * 
  * Returns <eslOK> on success.
  *
@@ -398,7 +478,7 @@ consensus_by_sample(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct,
  * is arcane and confusing with double indirection. 
  */
 static int
-consensus_by_all(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
+consensus_by_all(const ESL_MSAWEIGHT_CFG *cfg, const ESL_ALPHABET *abc, int64_t alen, int **ct, int *conscols, int *ret_ncons, ESL_MSAWEIGHT_DAT *dat)
 {
   float symfrac = (cfg? cfg->symfrac : eslMSAWEIGHT_SYMFRAC);
   int   ncons   = 0;
@@ -406,12 +486,12 @@ consensus_by_all(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int
   int   tot;
   int   a;
 
-  for (apos = 1; apos <= msa->alen; apos++)
+  for (apos = 1; apos <= alen; apos++)
     {
       tot = 0;
-      for (a = 0; a < msa->abc->Kp-2; a++)  // i.e. over esl_abc_XIsResidue() || esl_abc_XIsGap()
+      for (a = 0; a < abc->Kp-2; a++)  // i.e. over esl_abc_XIsResidue() || esl_abc_XIsGap()
 	tot += ct[apos][a];
-      if ( ((float) ct[apos][msa->abc->K] / (float) tot) < symfrac)
+      if ( ((float) ct[apos][abc->K] / (float) tot) < symfrac)
 	conscols[ncons++] = apos;
     }      
   if (dat) dat->cons_by_all = TRUE;
@@ -432,42 +512,256 @@ consensus_by_all(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, int **ct, int
   *     leaving counts in nonconsensus columns zero. This is a time optimization.
   */
 static int
-collect_counts(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, const int *conscols, int ncons, int **ct, ESL_MSAWEIGHT_DAT *dat)
+collect_counts(const ESL_MSAWEIGHT_CFG *cfg, const PB_ALI *ali, const int *conscols, int ncons, int **ct, ESL_MSAWEIGHT_DAT *dat)
 {
-  float fragthresh  = (cfg? cfg->fragthresh : eslMSAWEIGHT_FRAGTHRESH);     // seq is fragment if (length from 1st to last aligned residue)/alen < fragthresh (i.e. span < minspan)
-  int   minspan     = (int) ceil( fragthresh * (float) msa->alen );         // precalculated span length threshold using <fragthresh>
-  int   lpos, rpos;     // leftmost, rightmost aligned residue (1..alen)
-  int   idx, apos, j;        
+  PB_WORK wk;
+  int     status;
+
+  memset(&wk, 0, sizeof(PB_WORK));
+  wk.phase      = PB_COUNTS;
+  wk.ali        = ali;
+  wk.fragthresh = (cfg? cfg->fragthresh : eslMSAWEIGHT_FRAGTHRESH);
+  wk.conscols   = conscols;
+  wk.ncons      = ncons;
+  wk.ct         = ct;
+  if ((status = pb_run(cfg, &wk)) != eslOK) return status;
+  if (dat) dat->all_nfrag += wk.nfrag;
+  return eslOK;
+}
 
 
-  esl_mat_ISet(ct, msa->alen+1, msa->abc->Kp, 0);
-  for (idx = 0; idx < msa->nseq; idx++)
+/* pb_rows()
+ * One pass of PB weighting over seqs <wk->idx0..idx1-1>.
+ *
+ * PB_COUNTS: count symbols in each column, in <wk->ct>, and the
+ * number of fragments in <wk->nfrag>. This is <collect_counts()>'s
+ * work. The all-columns count reads digital rows directly and packed
+ * rows a word at a time; everything else goes through pb_ali_Get().
+ * 
+ * PB_WEIGHTS: set <wk->wgt[idx]> to the sum of the PB weight rule
+ * over the consensus columns, divided by the number of canonical
+ * residues in them (the first of PB's two normalizations).
+ */
+static void
+pb_rows(PB_WORK *wk)
+{
+  const PB_ALI       *ali = wk->ali;
+  const ESL_ALPHABET *abc = ali->abc;
+  const ESL_MSAPACK  *mp  = ali->mp;
+  int64_t         alen    = ali->alen;
+  int             minspan = (int) ceil( wk->fragthresh * (float) alen );     // precalculated span length threshold using <fragthresh>
+  const uint64_t *row;
+  uint64_t        w;
+  int64_t         lpos, rpos;   // leftmost, rightmost aligned residue (1..alen)
+  int64_t         apos, q;
+  int             idx, j, a, k;
+  int             rlen;         // number of canonical residues in a seq; used for first PB normalization
+
+  if (wk->phase == PB_COUNTS)
     {
-      // HMMER mark_fragments() rule. Count "span" from first to last aligned residue. If alispan/alen < fragthresh, it's a fragment.
-      for (lpos = 1;         lpos <= msa->alen; lpos++) if (esl_abc_XIsResidue(msa->abc, msa->ax[idx][lpos])) break;
-      for (rpos = msa->alen; rpos >= 1;         rpos--) if (esl_abc_XIsResidue(msa->abc, msa->ax[idx][rpos])) break;
-      // L=0 seq or alen=0? then lpos == msa->alen+1, rpos == 0 => lpos > rpos. rpos-lpos-1 <= 0 but test below still works.
-      if (rpos - lpos + 1 >= minspan) { lpos = 1; rpos = msa->alen; } else if (dat) dat->all_nfrag++;   // full len seqs count cols 1..alen; fragments only count lpos..rpos.
+      esl_mat_ISet(wk->ct, alen+1, abc->Kp, 0);
+      wk->nfrag = 0;
+      for (idx = wk->idx0; idx < wk->idx1; idx++)
+	{
+	  // HMMER mark_fragments() rule. Count "span" from first to last aligned residue. If alispan/alen < fragthresh, it's a fragment.
+	  pb_ali_Span(ali, idx, &lpos, &rpos);
+	  // L=0 seq or alen=0? then lpos == alen+1, rpos == 0 => lpos > rpos. rpos-lpos-1 <= 0 but test below still works.
+	  if (rpos - lpos + 1 >= minspan) { lpos = 1; rpos = alen; } else wk->nfrag++;   // full len seqs count cols 1..alen; fragments only count lpos..rpos.
 
-      if (ncons) // if we have consensus columns already, only count symbols in those columns (faster)...
+	  if (wk->ncons) // if we have consensus columns already, only count symbols in those columns (faster)...
+	    {
+	      for (j = 0; j < wk->ncons && wk->conscols[j] <= rpos; j++)
+		{
+		  apos = wk->conscols[j];
+		  if (apos < lpos) continue;
+		  wk->ct[apos][pb_ali_Get(ali, idx, apos)]++;
+		}
+	    }
+	  else if (ali->msa) // ... else, count symbols in all columns.
+	    {
+	      for (apos = lpos; apos <= rpos; apos++)
+		wk->ct[apos][ali->msa->ax[idx][apos]]++;
+	    }
+	  else if (lpos <= rpos) // ... decoding a packed row a 64-bit word at a time, over the words that overlap the span
+	    {
+	      row = mp->px + idx * mp->W;
+	      for (q = (lpos-1) / mp->per; q <= (rpos-1) / mp->per; q++)
+		for (w = row[q], k = 0, apos = q*mp->per+1; k < mp->per && apos <= rpos; k++, apos++, w >>= mp->nbits)
+		  if (apos >= lpos) wk->ct[apos][w & mp->mask]++;
+	    }
+	}
+    }
+  else
+    {
+      for (idx = wk->idx0; idx < wk->idx1; idx++)
 	{
-	  for (j = 0; j < ncons && conscols[j] <= rpos; j++)
+	  wk->wgt[idx] = 0.;
+	  rlen         = 0;
+	  for (j = 0; j < wk->ncons; j++)
 	    {
-	      apos = conscols[j];
-	      if (apos < lpos) continue;
-	      ct[apos][msa->ax[idx][apos]]++;
+	      apos = wk->conscols[j];
+	      a    = pb_ali_Get(ali, idx, apos);
+	      wk->wgt[idx] += (a >= abc->K ? 0. : 1. / (double) (wk->r[j] * wk->ct[apos][a])); // <= This is the PB weight rule.
+	      rlen         += (a >= abc->K ? 0  : 1);                                        //    (ternary is faster than an if)
 	    }
+	  if (rlen > 0) wk->wgt[idx] /= (double) rlen;  // first normalization, by unaligned seq length
+	}
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static void
+pb_thread(void *arg)
+{
+  ESL_THREADS *thr = (ESL_THREADS *) arg;
+  int          w;
+
+  esl_threads_Started(thr, &w);
+  pb_rows((PB_WORK *) esl_threads_GetData(thr, w));
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+/* pb_run()
+ * Do one pass <wk> over all the seqs of alignment <wk->ali>. With
+ * <cfg->ncpu> > 1 and enough seqs, divide the seqs into contiguous
+ * ranges, one per worker thread. For PB_COUNTS each worker counts in
+ * its own matrix, and the matrices are summed into <wk->ct> at the
+ * end. Each seq's weight is calculated the same way whoever does it,
+ * and counts are integers, so the weights don't depend on the number
+ * of threads.
+ */
+static int
+pb_run(const ESL_MSAWEIGHT_CFG *cfg, PB_WORK *wk)
+{
+  int          nseq    = wk->ali->nseq;
+#ifdef HAVE_PTHREAD
+  int64_t      alen    = wk->ali->alen;
+  int          Kp      = wk->ali->abc->Kp;
+  int          ncpu    = (cfg? cfg->ncpu : eslMSAWEIGHT_NCPU);
+  int          nworker = ESL_MIN(ncpu, nseq / PB_MINSEQ);
+  PB_WORK     *wt      = NULL;
+  ESL_THREADS *thr     = NULL;
+  int          w, nthr;
+  int          status;
+#endif
+
+  wk->idx0 = 0;
+  wk->idx1 = nseq;
+
+#ifdef HAVE_PTHREAD
+  if (nworker > 1)
+    {
+      ESL_ALLOC(wt, sizeof(PB_WORK) * nworker);
+      for (w = 0; w < nworker; w++)
+	{
+	  wt[w]      = *wk;
+	  wt[w].idx0 = (int) ((int64_t) nseq * w     / nworker);
+	  wt[w].idx1 = (int) ((int64_t) nseq * (w+1) / nworker);
+	  if (wk->phase == PB_COUNTS && w > 0) wt[w].ct = NULL;
 	}
-      else      // ... else, count symbols in all columns.
+      for (w = 1; wk->phase == PB_COUNTS && w < nworker; w++)
+	if ((wt[w].ct = esl_mat_ICreate(alen+1, Kp)) == NULL) { status = eslEMEM; goto ERROR; }
+
+      /* If we get fewer threads than we asked for, do the rest of the ranges ourselves. */
+      nthr = 0;
+      if ((thr = esl_threads_Create(&pb_thread)) != NULL)
+	for (nthr = 0; nthr < nworker; nthr++)
+	  if (esl_threads_AddThread(thr, &wt[nthr]) != eslOK) break;
+      if (nthr > 0) esl_threads_WaitForStart(thr);
+      for (w = nthr; w < nworker; w++) pb_rows(&wt[w]);
+      if (nthr > 0) esl_threads_WaitForFinish(thr);
+      if (thr)      esl_threads_Destroy(thr);
+
+      wk->nfrag = 0;
+      for (w = 0; w < nworker; w++)
 	{
-	  for (apos = lpos; apos <= rpos; apos++)
-	    ct[apos][msa->ax[idx][apos]]++;
+	  wk->nfrag += wt[w].nfrag;
+	  if (wk->phase == PB_COUNTS && w > 0) esl_vec_IAdd(wk->ct[0], wt[w].ct[0], (int) ((alen+1) * Kp));
 	}
+
+      for (w = 1; wk->phase == PB_COUNTS && w < nworker; w++) esl_mat_IDestroy(wt[w].ct);
+      free(wt);
+      return eslOK;
+
+    ERROR:
+      for (w = 1; wk->phase == PB_COUNTS && w < nworker; w++) esl_mat_IDestroy(wt[w].ct);
+      free(wt);
+      return status;
     }
+#endif /*HAVE_PTHREAD*/
+
+  pb_rows(wk);
   return eslOK;
 }
 
 
+/* Function:  esl_msaweight_PB_packed()
+ * Synopsis:  PB weights on a packed alignment.
+ *
+ * Purpose:   Same as <esl_msaweight_PB_adv()>, but for the residues
+ *            of a digital alignment packed in <mp>, without unpacking
+ *            them. Because <mp> only holds residues, the optional
+ *            RF consensus annotation is passed separately as <rf>
+ *            (<rf[0..alen-1]>, or <NULL>), and weights are returned
+ *            in caller-allocated <wgt[0..nseq-1]>. Weights are
+ *            identical to those <esl_msaweight_PB_adv()> calculates
+ *            for the unpacked alignment with the same <cfg>.
+ *
+ * Args:      cfg - optional customized parameters, or NULL to use defaults.
+ *            mp  - packed alignment to weight
+ *            rf  - optional RF annotation [0..alen-1], or NULL
+ *            wgt - RETURN: weights [0..nseq-1]; caller allocates
+ *            dat - optional data collection, or NULL.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ */
+int
+esl_msaweight_PB_packed(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSAPACK *mp, const char *rf, double *wgt, ESL_MSAWEIGHT_DAT *dat)
+{
+  PB_ALI ali;
+
+  ESL_DASSERT1(( mp->nseq >= 1 && mp->alen >= 1));
+  if (mp->nseq == 1) { wgt[0] = 1.0; return eslOK; }
+
+  pb_ali_Init(&ali, NULL, mp);
+  return pb_weights(cfg, &ali, rf, wgt, dat);
+}
+
+/* pb_ali_Init()
+ * Initialize <ali> to read digital alignment <msa>, or (if <msa> is
+ * NULL) packed alignment <mp>.
+ */
+static void
+pb_ali_Init(PB_ALI *ali, const ESL_MSA *msa, const ESL_MSAPACK *mp)
+{
+  ali->abc  = (msa ? msa->abc  : mp->abc);
+  ali->nseq = (msa ? msa->nseq : mp->nseq);
+  ali->alen = (msa ? msa->alen : mp->alen);
+  ali->msa  = msa;
+  ali->mp   = mp;
+}
+
+/* pb_ali_Span()
+ * Return the leftmost and rightmost residue (1..alen) of seq <idx>
+ * in <*ret_lpos>, <*ret_rpos>; alen+1, 0 if it has none.
+ */
+static void
+pb_ali_Span(const PB_ALI *ali, int idx, int64_t *ret_lpos, int64_t *ret_rpos)
+{
+  int64_t lpos, rpos;
+
+  if (ali->mp) { esl_msapack_ResidueSpan(ali->mp, idx, ret_lpos, ret_rpos); return; }
+
+  for (lpos = 1;         lpos <= ali->alen; lpos++) if (esl_abc_XIsResidue(ali->abc, ali->msa->ax[idx][lpos])) break;
+  for (rpos = ali->alen; rpos >= 1;         rpos--) if (esl_abc_XIsResidue(ali->abc, ali->msa->ax[idx][rpos])) break;
+  *ret_lpos = lpos;
+  *ret_rpos = rpos;
+}
+
+
 /* msaweight_PB_txt()
  * PB weighting for text-mode alignment.
  * 
@@ -569,6 +863,13 @@ esl_msaweight_cfg_Create(void)
   cfg->maxfrag    = eslMSAWEIGHT_MAXFRAG;
   cfg->seed       = eslMSAWEIGHT_RNGSEED;          
   cfg->filterpref = eslMSAWEIGHT_FILT_CONSCOVER;
+  cfg->ncpu       = eslMSAWEIGHT_NCPU;
+
+  cfg->sketch        = eslMSAWEIGHT_SKETCH;
+  cfg->sketch_k      = eslMSAWEIGHT_SKETCH_K;
+  cfg->sketch_nband  = eslMSAWEIGHT_SKETCH_NBAND;
+  cfg->sketch_nrow   = eslMSAWEIGHT_SKETCH_NROW;
+  cfg->sketch_recall = eslMSAWEIGHT_SKETCH_RECALL;
 
  ERROR:
   return cfg;
@@ -653,6 +954,9 @@ esl_msaweight_dat_Destroy(ESL_MSAWEIGHT_DAT *dat)
  * 3. Other weighting algorithms
  *****************************************************************/
 
+static int gsc_tree_weights(ESL_DMATRIX *D, double *wgt);
+static int gsc_grow(ESL_MSAWEIGHT_GSC *gsc);
+
 /* Function:  esl_msaweight_GSC()
  * Synopsis:  GSC weights.
  * Incept:    SRE, Fri Nov  3 13:31:14 2006 [Janelia]
@@ -712,11 +1016,6 @@ int
 esl_msaweight_GSC(ESL_MSA *msa)
 {
   ESL_DMATRIX *D = NULL;     /* distance matrix */
-  ESL_TREE    *T = NULL;     /* UPGMA tree */
-  double      *x = NULL;     /* storage per node, 0..N-2 */
-  double       lw, rw;       /* total branchlen on left, right subtrees */
-  double       lx, rx;	     /* distribution of weight to left, right side */
-  int i;		     /* counter over nodes */
   int status;
   
   /* Contract checks
@@ -739,6 +1038,41 @@ esl_msaweight_GSC(ESL_MSA *msa)
       if ((status = esl_dst_XDiffMx(msa->abc, msa->ax, msa->nseq, &D)) != eslOK) goto ERROR;
     }
 
+  if ((status = gsc_tree_weights(D, msa->wgt)) != eslOK) goto ERROR;
+  msa->flags |= eslMSA_HASWGTS;
+
+  esl_dmatrix_Destroy(D);
+  return eslOK;
+
+ ERROR:
+  if (D != NULL) esl_dmatrix_Destroy(D);
+  return status;
+}
+
+
+/* gsc_tree_weights()
+ * The part of GSC weighting after the distance matrix: build a tree
+ * from the <D->n> x <D->n> fractional difference matrix <D>, and
+ * apportion its branch lengths to <wgt[0..D->n-1]>, normalized to
+ * sum to <D->n>. Shared by <esl_msaweight_GSC()> and the incremental
+ * <ESL_MSAWEIGHT_GSC> object.
+ *
+ * Returns <eslOK> on success. Throws <eslEMEM> on allocation
+ * failure; <wgt> is only touched after all allocations have
+ * succeeded, so it's unmodified on any exception.
+ */
+static int
+gsc_tree_weights(ESL_DMATRIX *D, double *wgt)
+{
+  ESL_TREE    *T = NULL;     /* UPGMA tree */
+  double      *x = NULL;     /* storage per node, 0..N-2 */
+  double       lw, rw;       /* total branchlen on left, right subtrees */
+  double       lx, rx;	     /* distribution of weight to left, right side */
+  int i;		     /* counter over nodes */
+  int status;
+
+  if (D->n == 1) { wgt[0] = 1.0; return eslOK; }
+
   /* oi, look out here.  UPGMA is correct, but old squid library uses
    * single linkage, so for regression tests ONLY, we use single link. 
    */
@@ -769,7 +1103,7 @@ esl_msaweight_GSC(ESL_MSA *msa)
    * total branch length.
    *
    * Because the API guarantees that msa is returned unmodified in case
-   * of an exception, and we're touching msa->wgt here, no exceptions
+   * of an exception, and we're touching wgt here, no exceptions
    * may be thrown from now on in this function.
    */
   x[0] = 0;			/* initialize: no branch to the root. */
@@ -796,28 +1130,290 @@ esl_msaweight_GSC(ESL_MSA *msa)
 	  rx = x[i] * rw/(lw+rw);
 	}
       
-      if (T->left[i]  <= 0) msa->wgt[-(T->left[i])] = lx + T->ld[i];
+      if (T->left[i]  <= 0) wgt[-(T->left[i])] = lx + T->ld[i];
       else                  x[T->left[i]] = lx + T->ld[i];
 
-      if (T->right[i] <= 0) msa->wgt[-(T->right[i])] = rx + T->rd[i];
+      if (T->right[i] <= 0) wgt[-(T->right[i])] = rx + T->rd[i];
       else                  x[T->right[i]] = rx + T->rd[i];
     } 
 
   /* Renormalize weights to sum to N.
    */
-  esl_vec_DNorm(msa->wgt, msa->nseq);
-  esl_vec_DScale(msa->wgt, msa->nseq, (double) msa->nseq);
-  msa->flags |= eslMSA_HASWGTS;
+  esl_vec_DNorm(wgt, D->n);
+  esl_vec_DScale(wgt, D->n, (double) D->n);
 
   free(x);
   esl_tree_Destroy(T);
-  esl_dmatrix_Destroy(D);
   return eslOK;
 
  ERROR:
   if (x != NULL) free(x);
   if (T != NULL) esl_tree_Destroy(T);
-  if (D != NULL) esl_dmatrix_Destroy(D);
+  return status;
+}
+
+
+
+/* Function:  esl_msaweight_gsc_Create()
+ * Synopsis:  Create cached GSC weighting state for an alignment.
+ *
+ * Purpose:   Create an <ESL_MSAWEIGHT_GSC> object for the digital
+ *            alignment <msa>, for a caller that will add and remove
+ *            sequences and recalculate GSC weights many times, as in
+ *            curating a seed alignment. The object caches the
+ *            pairwise fractional difference matrix, so a change only
+ *            costs the distances it affects: $O(LN)$ for
+ *            <esl_msaweight_gsc_Add()>, $O(N^2)$ for
+ *            <esl_msaweight_gsc_Remove()>, instead of the $O(LN^2)$
+ *            of a new matrix in <esl_msaweight_GSC()>.
+ *
+ *            The object keeps its own copies of the aligned
+ *            sequences, so the caller may modify or free <msa>
+ *            afterwards. It keeps a pointer to <msa->abc>, so the
+ *            alphabet must stay valid while the object exists.
+ *
+ *            Sequences are indexed <0..gsc->N-1>, starting in the
+ *            order of <msa>; see <esl_msaweight_gsc_Add()> and
+ *            <esl_msaweight_gsc_Remove()> for how indices change.
+ *
+ * Args:      msa     - digital alignment to start from
+ *            ret_gsc - RETURN: new <ESL_MSAWEIGHT_GSC>
+ *
+ * Returns:   <eslOK> on success, and <*ret_gsc> is the new object.
+ *
+ * Throws:    <eslEINVAL> if <msa> isn't digital, or if a distance
+ *            can't be calculated. <eslEMEM> on allocation failure.
+ *            <*ret_gsc> is <NULL> on any exception.
+ */
+int
+esl_msaweight_gsc_Create(const ESL_MSA *msa, ESL_MSAWEIGHT_GSC **ret_gsc)
+{
+  ESL_MSAWEIGHT_GSC *gsc = NULL;
+  ESL_DMATRIX       *D   = NULL;
+  int                idx;
+  int                status;
+
+  if (! (msa->flags & eslMSA_DIGITAL)) ESL_XEXCEPTION(eslEINVAL, "incremental GSC weighting needs a digital alignment");
+
+  ESL_ALLOC(gsc, sizeof(ESL_MSAWEIGHT_GSC));
+  gsc->abc     = msa->abc;
+  gsc->alen    = msa->alen;
+  gsc->N       = 0;
+  gsc->nalloc  = ESL_MAX(16, msa->nseq);
+  gsc->ax      = NULL;
+  gsc->D       = NULL;
+  gsc->wgt     = NULL;
+  gsc->has_wgt = FALSE;
+
+  ESL_ALLOC(gsc->ax,  sizeof(ESL_DSQ *) * gsc->nalloc);
+  ESL_ALLOC(gsc->wgt, sizeof(double)    * gsc->nalloc);
+  for (idx = 0; idx < gsc->nalloc; idx++) gsc->ax[idx] = NULL;
+  if ((gsc->D = esl_dmatrix_Create(gsc->nalloc, gsc->nalloc)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (idx = 0; idx < msa->nseq; idx++)
+    if ((status = esl_abc_dsqdup(msa->ax[idx], msa->alen, &(gsc->ax[idx]))) != eslOK) goto ERROR;
+  gsc->N = msa->nseq;
+
+  if (gsc->N > 0)
+    {
+      if ((status = esl_dst_XDiffMx(gsc->abc, gsc->ax, gsc->N, &D)) != eslOK) goto ERROR;
+      for (idx = 0; idx < gsc->N; idx++)
+	esl_vec_DCopy(D->mx[idx], gsc->N, gsc->D->mx[idx]);
+      esl_dmatrix_Destroy(D);
+    }
+
+  *ret_gsc = gsc;
+  return eslOK;
+
+ ERROR:
+  esl_msaweight_gsc_Destroy(gsc);
+  *ret_gsc = NULL;
+  return status;
+}
+
+
+/* Function:  esl_msaweight_gsc_Add()
+ * Synopsis:  Add one aligned sequence to cached GSC state.
+ *
+ * Purpose:   Add the aligned digital sequence <ax> (<ax[1..alen]>,
+ *            same alphabet and aligned length as the alignment
+ *            <gsc> was created from) as the new last sequence,
+ *            index <gsc->N-1>. Only its row of distances is
+ *            calculated, in $O(LN)$ time. A copy of <ax> is made.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ax> isn't <alen> long. <eslEMEM> on
+ *            allocation failure. In either case, <gsc> is unchanged.
+ */
+int
+esl_msaweight_gsc_Add(ESL_MSAWEIGHT_GSC *gsc, const ESL_DSQ *ax)
+{
+  ESL_DSQ *dup = NULL;
+  double   pid;
+  int      i, j;
+  int      status;
+
+  if (esl_abc_dsqlen(ax) != gsc->alen) ESL_EXCEPTION(eslEINVAL, "sequence isn't aligned: length %" PRId64 ", not %" PRId64, esl_abc_dsqlen(ax), gsc->alen);
+  if (gsc->N == gsc->nalloc && (status = gsc_grow(gsc))                != eslOK) return status;
+  if ((status = esl_abc_dsqdup(ax, gsc->alen, &dup))                    != eslOK) return status;
+
+  /* Row <i> is past the <N> rows in use, so we can fill it before we
+   * know all the distances succeed; column <i> is mirrored after.
+   */
+  i = gsc->N;
+  for (j = 0; j < i; j++)
+    {
+      if ((status = esl_dst_XPairIdL(gsc->abc, gsc->ax[j], dup, gsc->alen, &pid, NULL, NULL)) != eslOK) goto ERROR;
+      gsc->D->mx[i][j] = 1. - pid;
+    }
+  for (j = 0; j < i; j++) gsc->D->mx[j][i] = gsc->D->mx[i][j];
+  gsc->D->mx[i][i] = 0.;
+
+  gsc->ax[i]   = dup;
+  gsc->N++;
+  gsc->has_wgt = FALSE;
+  return eslOK;
+
+ ERROR:
+  free(dup);
+  return status;
+}
+
+
+/* Function:  esl_msaweight_gsc_Remove()
+ * Synopsis:  Remove one sequence from cached GSC state.
+ *
+ * Purpose:   Remove sequence <idx> (<0..gsc->N-1>). Sequences after it
+ *            move down one index, keeping their order, as they would
+ *            in an alignment with that row removed. No distances are
+ *            recalculated; the cached matrix is compacted in $O(N^2)$.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <idx> is out of range.
+ */
+int
+esl_msaweight_gsc_Remove(ESL_MSAWEIGHT_GSC *gsc, int idx)
+{
+  int i, r;
+
+  if (idx < 0 || idx >= gsc->N) ESL_EXCEPTION(eslEINVAL, "no sequence %d to remove; have %d", idx, gsc->N);
+
+  /* Rows are compacted in increasing order, so each source row is
+   * read before any row is written over it.
+   */
+  for (i = 0; i < gsc->N; i++)
+    {
+      if (i == idx) continue;
+      r = (i < idx ? i : i-1);
+      memmove(gsc->D->mx[r],       gsc->D->mx[i],         sizeof(double) * idx);
+      memmove(gsc->D->mx[r] + idx, gsc->D->mx[i] + idx+1, sizeof(double) * (gsc->N - idx - 1));
+    }
+
+  free(gsc->ax[idx]);
+  memmove(gsc->ax + idx, gsc->ax + idx + 1, sizeof(ESL_DSQ *) * (gsc->N - idx - 1));
+  gsc->N--;
+  gsc->ax[gsc->N] = NULL;
+  gsc->has_wgt    = FALSE;
+  return eslOK;
+}
+
+
+/* Function:  esl_msaweight_gsc_Weights()
+ * Synopsis:  GSC weights for the current sequences.
+ *
+ * Purpose:   Calculate GSC weights for the <gsc->N> sequences now in
+ *            <gsc>, and store them in <wgt[0..gsc->N-1]>, which the
+ *            caller provides; for example, <msa->wgt> of an
+ *            alignment with the same rows in the same order. The
+ *            weights are identical to what <esl_msaweight_GSC()>
+ *            would calculate for that alignment.
+ *
+ *            The UPGMA tree is rebuilt from the cached distances,
+ *            because adding or removing one sequence can change
+ *            any of its joins. That takes $O(N^2)$ time in typical
+ *            cases. Weights are cached too, so calling this again
+ *            with no changes in between just copies them.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <wgt> is unchanged.
+ */
+int
+esl_msaweight_gsc_Weights(ESL_MSAWEIGHT_GSC *gsc, double *wgt)
+{
+  ESL_DMATRIX *D = NULL;
+  int          i;
+  int          status;
+
+  if (! gsc->has_wgt && gsc->N > 0)
+    {
+      if ((D = esl_dmatrix_Create(gsc->N, gsc->N)) == NULL) { status = eslEMEM; goto ERROR; }
+      for (i = 0; i < gsc->N; i++)
+	esl_vec_DCopy(gsc->D->mx[i], gsc->N, D->mx[i]);
+      if ((status = gsc_tree_weights(D, gsc->wgt)) != eslOK) goto ERROR;
+      esl_dmatrix_Destroy(D);
+      gsc->has_wgt = TRUE;
+    }
+  esl_vec_DCopy(gsc->wgt, gsc->N, wgt);
+  return eslOK;
+
+ ERROR:
+  esl_dmatrix_Destroy(D);
+  return status;
+}
+
+
+/* Function:  esl_msaweight_gsc_Destroy()
+ * Synopsis:  Free an <ESL_MSAWEIGHT_GSC>.
+ */
+void
+esl_msaweight_gsc_Destroy(ESL_MSAWEIGHT_GSC *gsc)
+{
+  int idx;
+
+  if (gsc)
+    {
+      if (gsc->ax)
+	{
+	  for (idx = 0; idx < gsc->nalloc; idx++) free(gsc->ax[idx]);
+	  free(gsc->ax);
+	}
+      esl_dmatrix_Destroy(gsc->D);
+      free(gsc->wgt);
+      free(gsc);
+    }
+}
+
+
+/* gsc_grow()
+ * Double the allocated number of sequences in <gsc>.
+ * Throws <eslEMEM> on allocation failure; <gsc> is unchanged.
+ */
+static int
+gsc_grow(ESL_MSAWEIGHT_GSC *gsc)
+{
+  ESL_DMATRIX *D      = NULL;
+  int          nalloc = gsc->nalloc * 2;
+  void        *p;
+  int          i;
+  int          status;
+
+  if ((D = esl_dmatrix_Create(nalloc, nalloc)) == NULL) { status = eslEMEM; goto ERROR; }
+  ESL_RALLOC(gsc->ax,  p, sizeof(ESL_DSQ *) * nalloc);
+  ESL_RALLOC(gsc->wgt, p, sizeof(double)    * nalloc);
+  for (i = gsc->nalloc; i < nalloc; i++) gsc->ax[i] = NULL;
+  for (i = 0; i < gsc->N; i++)
+    esl_vec_DCopy(gsc->D->mx[i], gsc->N, D->mx[i]);
+
+  esl_dmatrix_Destroy(gsc->D);
+  gsc->D      = D;
+  gsc->nalloc = nalloc;
+  return eslOK;
+
+ ERROR:
+  esl_dmatrix_Destroy(D);
   return status;
 }
 
@@ -860,6 +1456,31 @@ esl_msaweight_GSC(ESL_MSA *msa)
 int
 esl_msaweight_BLOSUM(ESL_MSA *msa, double maxid)
 {
+  return esl_msaweight_BLOSUM_adv(NULL, msa, maxid);
+}
+
+/* Function:  esl_msaweight_BLOSUM_adv()
+ * Synopsis:  BLOSUM weights, with optional configuration.
+ *
+ * Purpose:   Same as <esl_msaweight_BLOSUM()>, with optional
+ *            configuration in <cfg>. The only setting that affects
+ *            BLOSUM weights is <cfg->ncpu>, the number of worker
+ *            threads used to cluster a digital <msa>; see
+ *            <esl_msacluster_SingleLinkage_adv()>. The weights are the
+ *            same for any <ncpu>. If <cfg> is <NULL>, use defaults.
+ *
+ * Returns:   <eslOK> on success, and the weights inside <msa> have been
+ *            modified. 
+ *
+ * Throws:    <eslEMEM> on allocation error. <eslESYS> if threads can't
+ *            be started. <eslEINVAL> if a pairwise identity calculation
+ *            fails because of corrupted sequence data. In any case,
+ *            the <msa> is unmodified.
+ */
+int
+esl_msaweight_BLOSUM_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, double maxid)
+{
+  int   ncpu = (cfg ? cfg->ncpu : eslMSAWEIGHT_NCPU);
   int  *c    = NULL; /* cluster assignments for each sequence */
   int  *nmem = NULL; /* number of seqs in each cluster */
   int   nc;	     /* number of clusters  */
@@ -873,7 +1494,7 @@ esl_msaweight_BLOSUM(ESL_MSA *msa, double maxid)
   ESL_DASSERT1( (msa->alen >= 1) );
   if (msa->nseq == 1) { msa->wgt[0] = 1.0; return eslOK; }
 
-  if ((status = esl_msacluster_SingleLinkage(msa, maxid, &c, NULL, &nc)) != eslOK) goto ERROR;
+  if ((status = esl_msacluster_SingleLinkage_adv(msa, maxid, ncpu, &c, NULL, &nc)) != eslOK) goto ERROR;
   ESL_ALLOC(nmem, sizeof(int) * nc);
   esl_vec_ISet(nmem, nc, 0);
   for (i = 0; i < msa->nseq; i++) nmem[c[i]]++;
@@ -912,6 +1533,10 @@ static int set_preference_conscover(const ESL_MSA *msa, const int *conscols, int
 static int set_preference_randomly(const ESL_MSAWEIGHT_CFG *cfg, int nseq, double *sortwgt);
 static int set_preference_origorder(int nseq, double *sortwgt);
 static int msaweight_IDFilter_txt(const ESL_MSA *msa, double maxid, ESL_MSA **ret_newmsa);
+static int idfilter_select(const ESL_MSA *msa, double maxid, int ncpu, const int *ranked_at, int *list, int *useme, int *ret_nnew);
+static int idfilter_sketch(const ESL_MSA *msa, double maxid, int k, int nband, int nrow, double recall,
+			   const int *ranked_at, int *list, int *useme, int *ret_nnew);
+static int idfilter_sketch_kmax(const ESL_ALPHABET *abc);
 
 /* Function:  esl_msaweight_IDFilter()
  * Synopsis:  Filter by %ID.
@@ -981,6 +1606,33 @@ esl_msaweight_IDFilter(const ESL_MSA *msa, double maxid, ESL_MSA **ret_newmsa)
  *            
  *            For the "conscover" rule, consensus column determination
  *            can be customized the same way as in PB weighting.
+ *
+ *            <cfg->ncpu> worker threads can be used to compare
+ *            candidate sequences against the kept list in parallel.
+ *            The result is the same for any number of threads.
+ *
+ *            For huge alignments, <cfg->sketch> TRUE selects a fast
+ *            approximate filter. Instead of comparing each sequence
+ *            to every kept sequence, it only compares it to kept
+ *            sequences that MinHash sketches of their unaligned
+ *            k-mers suggest are near-duplicates. Every sequence that
+ *            is removed is still verified to be $\geq$ <maxid>
+ *            identical to a kept one, but some that the exact filter
+ *            would remove may be kept. <cfg->sketch_recall> is the
+ *            target probability of finding a pair at exactly <maxid>
+ *            identity (higher identities are found more reliably),
+ *            used to choose the k-mer length unless <cfg->sketch_k>
+ *            sets it. <cfg->sketch_nband> and <cfg->sketch_nrow> set
+ *            the locality-sensitive hashing: more bands raise recall
+ *            and cost, more values per band lower both. The sketch
+ *            filter doesn't use threads. Sketches work least well
+ *            for fragments, whose k-mers are a small subset of a
+ *            full-length sequence's.
+ *
+ * Throws:    <eslEINVAL> if <cfg->sketch> is TRUE and
+ *            <cfg->sketch_nband> or <cfg->sketch_nrow> is $< 1$, or
+ *            <cfg->sketch_k> is negative or too long for k-mer codes
+ *            to fit in 64 bits (31 for DNA/RNA, 13 for protein).
  */
 int
 esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, double maxid, ESL_MSA **ret_newmsa)
@@ -989,6 +1641,9 @@ esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, dou
   int     allow_samp  = (cfg? cfg->allow_samp : eslMSAWEIGHT_ALLOW_SAMP);     // default is TRUE: allow subsampling speed optimization
   int     sampthresh  = (cfg? cfg->sampthresh : eslMSAWEIGHT_SAMPTHRESH);     // if nseq > sampthresh, try to determine consensus on a subsample of seqs
   int     filterpref  = (cfg? cfg->filterpref : eslMSAWEIGHT_FILT_CONSCOVER); // default preference rule is "conscover"
+  int     ncpu        = (cfg? cfg->ncpu       : eslMSAWEIGHT_NCPU);           // default is 0: no worker threads
+  int     sketch      = (cfg? cfg->sketch     : eslMSAWEIGHT_SKETCH);         // default is FALSE: exact filtering
+  PB_ALI  ali;                    // <msa>, for consensus determination
   int   **ct          = NULL;     // matrix of symbol counts in each column. ct[apos=(0).1..alen][a=0..Kp-1]
   int    *conscols    = NULL;     // list of consensus column indices [0..ncons-1]
   double *sortwgt     = NULL;     // when pair of seqs is >= maxid, retain seq w/ higher <sortwgt>
@@ -997,13 +1652,20 @@ esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, dou
   int    *useme       = NULL;     // useme[i] is TRUE if seq[i] is kept in new msa 
   int     ncons       = 0;        // number of consensus column indices in <conscols> list
   int     nnew        = 0;        // how many seqs have been added to <list> and <useme> so far
-  int     apos, r, i;             // index over columns, ranked seq indices, seqs in <list>
-  double  ident;                  // pairwise fractional id (0..1)
+  int     apos;                   // index over columns
   int     status      = eslOK;
 
   ESL_DASSERT1(( msa->nseq >= 1 && msa->alen >= 1));
   ESL_DASSERT1(( msa->flags & eslMSA_DIGITAL ));
 
+  if (sketch)
+    {
+      if (cfg->sketch_nband < 1 || cfg->sketch_nrow < 1)
+	ESL_EXCEPTION(eslEINVAL, "sketch needs >= 1 band and >= 1 value per band; got %d, %d", cfg->sketch_nband, cfg->sketch_nrow);
+      if (cfg->sketch_k < 0 || cfg->sketch_k > idfilter_sketch_kmax(msa->abc))
+	ESL_EXCEPTION(eslEINVAL, "sketch k-mer length %d out of range; max is %d for this alphabet", cfg->sketch_k, idfilter_sketch_kmax(msa->abc));
+    }
+
   /* Allocations that we always need*/
   ESL_ALLOC(sortwgt,   sizeof(double) * msa->nseq);
   ESL_ALLOC(ranked_at, sizeof(double) * msa->nseq);
@@ -1026,14 +1688,15 @@ esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, dou
   if (filterpref == eslMSAWEIGHT_FILT_CONSCOVER)
     {
       /* allocations only needed for consensus determination */
+      pb_ali_Init(&ali, msa, NULL);
       ct = esl_mat_ICreate( msa->alen+1, msa->abc->Kp );      // (0).1..alen; 0..Kp-1
       ESL_ALLOC(conscols,  sizeof(int)    * msa->alen);
 
-      if      (! ignore_rf && msa->rf)                consensus_by_rf(msa, conscols, &ncons, NULL);
-      else if (allow_samp  && msa->nseq > sampthresh) consensus_by_sample(cfg, msa, ct, conscols, &ncons, NULL);
+      if      (! ignore_rf && msa->rf)                consensus_by_rf(msa->abc, msa->rf, msa->alen, conscols, &ncons, NULL);
+      else if (allow_samp  && msa->nseq > sampthresh) consensus_by_sample(cfg, &ali, ct, conscols, &ncons, NULL);
       else {
-	collect_counts(cfg, msa, conscols, ncons, ct, NULL);
-	consensus_by_all(cfg, msa, ct, conscols, &ncons, NULL);
+	if ((status = collect_counts(cfg, &ali, conscols, ncons, ct, NULL)) != eslOK) goto ERROR;
+	consensus_by_all(cfg, msa->abc, msa->alen, ct, conscols, &ncons, NULL);
       }
       if (!ncons) {
 	for (apos = 1; apos <= msa->alen; apos++) conscols[apos-1] = apos; 
@@ -1056,20 +1719,9 @@ esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, dou
 
   /* Determine which seqs will be kept, favoring highest ranked ones.
    */
-  for (r = 0; r < msa->nseq; r++)  // Try to include each sequence, starting with highest ranked ones
-    {
-      for (i = 0; i < nnew; i++)   // Test it against all the seqs we've already put in the list.
-	{
-	  if ((status = esl_dst_XPairId(msa->abc, msa->ax[ranked_at[r]], msa->ax[list[i]], &ident, NULL, NULL)) != eslOK) goto ERROR;
-	  if (ident >= maxid) break;
-	}
-
-      if (i == nnew)  // if the seq made it past comparisons with all <nnew> current seqs in the list...
-	{
-	  list[nnew++]        = ranked_at[r];  // ... add it to the growing list.
-	  useme[ranked_at[r]] = TRUE;
-	}
-    }
+  if (sketch) status = idfilter_sketch(msa, maxid, cfg->sketch_k, cfg->sketch_nband, cfg->sketch_nrow, cfg->sketch_recall, ranked_at, list, useme, &nnew);
+  else        status = idfilter_select(msa, maxid, ncpu, ranked_at, list, useme, &nnew);
+  if (status != eslOK) goto ERROR;
 
   /* Filter the input MSA.
    */
@@ -1162,6 +1814,556 @@ set_preference_origorder(int nseq, double *sortwgt)
 }
 
 
+/* idfilter_select()
+ * The greedy selection step of digital %id filtering.
+ *
+ * Go through the seqs in preference order <ranked_at[0..nseq-1]>, and
+ * keep each one that is < <maxid> identical to every seq kept so far.
+ * Kept seq indices are put in <list[0..nnew-1]> in the order they're
+ * kept, and <useme[idx]> is set TRUE for each. <nnew> is returned in
+ * <*ret_nnew>.
+ *
+ * Two accelerations, neither of which changes the result:
+ *
+ * Pruning: the identity of seqs a,b is nid/MIN(na,nb), for na,nb
+ * canonical residues in each. Identities can only occur where both
+ * seqs have canonical residues, so nid is at most the overlap of the
+ * spans from their first to last canonical residue. If that bound is
+ * already < maxid, we don't need the full comparison.
+ *
+ * Threads: with <ncpu> > 1, candidates are taken in batches. A pool
+ * of workers compares each candidate in the batch to the kept list as
+ * it stood at the start of the batch; then we go through the batch's
+ * survivors in rank order, comparing each to the seqs kept earlier in
+ * the same batch. Each candidate is compared to the same kept seqs as
+ * in the serial algorithm, so the same seqs are kept.
+ */
+typedef struct {
+  const ESL_MSA *msa;
+  double         maxid;
+  int           *nres;     // number of canonical residues in each seq [0..nseq-1]
+  int64_t       *lpos;     // column of first canonical residue (1..alen); alen+1 if none
+  int64_t       *rpos;     // column of last canonical residue; 0 if none
+  const int     *list;     // seqs kept so far
+
+  /* Batch of candidates, for worker threads: */
+  const int     *cand;     // candidate seq indices [0..ncand-1]
+  int            ncand;
+  int            nkept;    // compare candidates to list[0..nkept-1]
+  int           *reject;   // reject[k] TRUE if cand[k] is >= maxid to a kept seq
+  int            next;     // next candidate to claim
+  int            nbusy;    // number of workers still on this batch
+  int            batch;    // batch number; workers wake up when it changes
+  int            done;     // TRUE when workers should exit
+  int            status;   // eslOK, or first error from a worker
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mutex;
+  pthread_cond_t  cv;
+#endif
+} IDFILTER_DATA;
+
+/* idfilter_data_init()
+ * Set up the parts of <d> that all %id filters use: the canonical
+ * residue count and span of each seq, and the kept list <list>.
+ * On failure, what was allocated is left in <d> for the caller to
+ * free.
+ */
+static int
+idfilter_data_init(IDFILTER_DATA *d, const ESL_MSA *msa, double maxid, const int *list)
+{
+  int     idx;
+  int64_t apos;
+  int     status;
+
+  d->msa    = msa;
+  d->maxid  = maxid;
+  d->nres   = NULL;
+  d->lpos   = NULL;
+  d->rpos   = NULL;
+  d->list   = list;
+  d->reject = NULL;
+  d->status = eslOK;
+
+  ESL_ALLOC(d->nres, sizeof(int)     * msa->nseq);
+  ESL_ALLOC(d->lpos, sizeof(int64_t) * msa->nseq);
+  ESL_ALLOC(d->rpos, sizeof(int64_t) * msa->nseq);
+  for (idx = 0; idx < msa->nseq; idx++)
+    {
+      d->nres[idx] = 0;
+      d->lpos[idx] = msa->alen+1;
+      d->rpos[idx] = 0;
+      for (apos = 1; apos <= msa->alen; apos++)
+	if (esl_abc_XIsCanonical(msa->abc, msa->ax[idx][apos]))
+	  {
+	    if (d->nres[idx]++ == 0) d->lpos[idx] = apos;
+	    d->rpos[idx] = apos;
+	  }
+    }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* idfilter_test()
+ * Is seq <idx> >= <d->maxid> identical to any of kept seqs
+ * <klist[0..n-1]>? Set <*ret_reject> TRUE if so.
+ */
+static int
+idfilter_test(const IDFILTER_DATA *d, int idx, const int *klist, int n, int *ret_reject)
+{
+  int     i, k, len;
+  int64_t ovl;
+  double  ident;
+  int     status;
+
+  for (i = 0; i < n; i++)
+    {
+      k   = klist[i];
+      len = ESL_MIN(d->nres[idx], d->nres[k]);
+      if (len > 0)
+	{
+	  ovl = ESL_MAX(0, ESL_MIN(d->rpos[idx], d->rpos[k]) - ESL_MAX(d->lpos[idx], d->lpos[k]) + 1);
+	  if (ovl < len && (double) ovl / (double) len < d->maxid) continue;
+	}
+
+      if ((status = esl_dst_XPairIdL(d->msa->abc, d->msa->ax[idx], d->msa->ax[k], d->msa->alen, &ident, NULL, NULL)) != eslOK) return status;
+      if (ident >= d->maxid) { *ret_reject = TRUE; return eslOK; }
+    }
+  *ret_reject = FALSE;
+  return eslOK;
+}
+
+#ifdef HAVE_PTHREAD
+static void
+idfilter_thread(void *arg)
+{
+  ESL_THREADS   *thr = (ESL_THREADS *) arg;
+  IDFILTER_DATA *d;
+  int            w, k, reject, status;
+  int            seen = 0;
+
+  esl_threads_Started(thr, &w);
+  d = (IDFILTER_DATA *) esl_threads_GetData(thr, w);
+
+  pthread_mutex_lock(&d->mutex);
+  while (1)
+    {
+      while (d->batch == seen && ! d->done) pthread_cond_wait(&d->cv, &d->mutex);
+      if (d->done) break;
+      seen = d->batch;
+
+      while (d->next < d->ncand)
+	{
+	  k = d->next++;
+	  pthread_mutex_unlock(&d->mutex);
+	  status = idfilter_test(d, d->cand[k], d->list, d->nkept, &reject);
+	  pthread_mutex_lock(&d->mutex);
+	  d->reject[k] = reject;
+	  if (status != eslOK && d->status == eslOK) d->status = status;
+	}
+      if (--d->nbusy == 0) pthread_cond_broadcast(&d->cv);
+    }
+  pthread_mutex_unlock(&d->mutex);
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+static int
+idfilter_select(const ESL_MSA *msa, double maxid, int ncpu, const int *ranked_at, int *list, int *useme, int *ret_nnew)
+{
+  IDFILTER_DATA d;
+#ifdef HAVE_PTHREAD
+  ESL_THREADS  *thr     = NULL;
+  int           nworker = 0;
+  int           bsize   = 64 * ncpu;  // candidates per batch
+  int           r1, k;
+#endif
+  int           nnew    = 0;
+  int           r, reject;
+  int           status;
+
+  if ((status = idfilter_data_init(&d, msa, maxid, list)) != eslOK) goto ERROR;
+
+#ifdef HAVE_PTHREAD
+  if (ncpu > 1 && msa->nseq > bsize)
+    {
+      ESL_ALLOC(d.reject, sizeof(int) * bsize);
+      d.done  = FALSE;
+      d.batch = 0;
+      if (pthread_mutex_init(&d.mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+      if (pthread_cond_init (&d.cv,    NULL) != 0) { pthread_mutex_destroy(&d.mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+      if ((thr = esl_threads_Create(&idfilter_thread)) == NULL) { status = eslEMEM; goto THREADFAIL; }
+      for (nworker = 0; nworker < ncpu; nworker++)
+	if (esl_threads_AddThread(thr, &d) != eslOK) break;
+      if (nworker == 0) { status = eslESYS; goto THREADFAIL; }
+      esl_threads_WaitForStart(thr);
+
+      for (r = 0; r < msa->nseq; r = r1)
+	{
+	  r1 = ESL_MIN(msa->nseq, r + bsize);
+
+	  /* Workers compare the batch to the kept list... */
+	  pthread_mutex_lock(&d.mutex);
+	  d.cand  = ranked_at + r;
+	  d.ncand = r1 - r;
+	  d.nkept = nnew;
+	  d.next  = 0;
+	  d.nbusy = nworker;
+	  d.batch++;
+	  pthread_cond_broadcast(&d.cv);
+	  while (d.nbusy > 0) pthread_cond_wait(&d.cv, &d.mutex);
+	  pthread_mutex_unlock(&d.mutex);
+	  if (d.status != eslOK) { status = d.status; break; }
+
+	  /* ... then survivors are compared to seqs kept earlier in the batch. */
+	  for (k = 0; k < r1 - r; k++)
+	    {
+	      if (d.reject[k]) continue;
+	      if ((status = idfilter_test(&d, ranked_at[r+k], list + d.nkept, nnew - d.nkept, &reject)) != eslOK) break;
+	      if (! reject)
+		{
+		  list[nnew++]           = ranked_at[r+k];
+		  useme[ranked_at[r+k]] = TRUE;
+		}
+	    }
+	  if (status != eslOK) break;
+	}
+
+      pthread_mutex_lock(&d.mutex);
+      d.done = TRUE;
+      pthread_cond_broadcast(&d.cv);
+      pthread_mutex_unlock(&d.mutex);
+      esl_threads_WaitForFinish(thr);
+      esl_threads_Destroy(thr);
+      pthread_cond_destroy(&d.cv);
+      pthread_mutex_destroy(&d.mutex);
+      if (status != eslOK) goto ERROR;
+    }
+  else
+#endif /*HAVE_PTHREAD*/
+    {
+      for (r = 0; r < msa->nseq; r++)
+	{
+	  if ((status = idfilter_test(&d, ranked_at[r], list, nnew, &reject)) != eslOK) goto ERROR;
+	  if (! reject)
+	    {
+	      list[nnew++]        = ranked_at[r];
+	      useme[ranked_at[r]] = TRUE;
+	    }
+	}
+    }
+
+  free(d.reject);
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  *ret_nnew = nnew;
+  return eslOK;
+
+#ifdef HAVE_PTHREAD
+ THREADFAIL:
+  if (thr) esl_threads_Destroy(thr);
+  pthread_cond_destroy(&d.cv);
+  pthread_mutex_destroy(&d.mutex);
+#endif
+ ERROR:
+  free(d.reject);
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  *ret_nnew = nnew;
+  return status;
+}
+
+
+/* idfilter_sketch()
+ * Approximate version of idfilter_select(), for huge alignments:
+ * instead of comparing each candidate to every kept seq, compare it
+ * only to kept seqs that a MinHash sketch of the k-mers in their
+ * unaligned residues suggests could be near-duplicates.
+ *
+ * Each seq's k-mers (runs of <k> canonical residues, skipping gaps)
+ * are hashed once, and the hashes are spread over <nband*nrow> bins
+ * keeping the minimum in each bin (one-permutation MinHash; empty
+ * bins borrow from the next nonempty one). Two seqs agree in a bin
+ * with probability about equal to the Jaccard similarity J of their
+ * k-mer sets. Bins are grouped into <nband> bands of <nrow>; kept
+ * seqs are indexed by each band's values, and a candidate is compared
+ * (exactly, by idfilter_test()) to the kept seqs that share at least
+ * one band with it. A pair with similarity J is found with
+ * probability 1-(1-J^nrow)^nband.
+ *
+ * Seqs that are too short to have a k-mer have no sketch; they are
+ * compared to all kept seqs, and all candidates are compared to them.
+ *
+ * A seq is only rejected after an exact identity check, so every
+ * removed seq is >= maxid identical to a kept one; sketch misses only
+ * keep some seqs that the exact filter would have removed.
+ */
+typedef struct {
+  int       nbucket;   // number of hash chains (a power of 2)
+  int      *head;      // head[b]: first entry in chain b, or -1
+  uint64_t *key;       // key[e]: band signature of entry e
+  int      *who;       // who[e]:  seq index
+  int      *nxt;       // nxt[e]:  next entry in chain, or -1
+  int       n;         // number of entries
+  int       nalloc;    // entries allocated
+} IDFILTER_SKETCHTBL;
+
+/* idfilter_mix()
+ * 64-bit hash finalizer (splitmix64's). 
+ */
+static inline uint64_t
+idfilter_mix(uint64_t x)
+{
+  x ^= x >> 30;  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/* idfilter_sketch_kmax()
+ * Return the longest k-mer length whose codes idfilter_sketch_one()
+ * can roll in a uint64_t: it calculates code * K + x, up to
+ * K^(k+1) - 1, so that has to fit. 31 for DNA, 13 for protein.
+ */
+static int
+idfilter_sketch_kmax(const ESL_ALPHABET *abc)
+{
+  uint64_t q = abc->K - 1;	// K^(k+1) - 1
+  int      k = 0;
+
+  while (q <= (UINT64_MAX - (abc->K - 1)) / abc->K) { q = q * abc->K + (abc->K - 1); k++; }
+  return k;
+}
+
+/* idfilter_sketch_k()
+ * Choose a k-mer length. Seqs with fractional identity p share
+ * roughly p^k of their k-mers, for a Jaccard similarity of
+ * J = p^k / (2-p^k). Take the longest k (for the fewest chance
+ * k-mer matches between unrelated seqs), up to a limit for the
+ * alphabet, that still finds a pair at identity <maxid> with
+ * probability >= <recall>. Shorter k-mers than <kmin> match too
+ * often by chance to be selective, so at low <maxid> we settle for
+ * less recall.
+ */
+static int
+idfilter_sketch_k(const ESL_ALPHABET *abc, double maxid, int nband, int nrow, double recall)
+{
+  int    kmax = (abc->K >= 20 ? 5 : 12);
+  int    kmin = (abc->K >= 20 ? 3 :  6);
+  int    k;
+  double pk, J;
+
+  for (k = kmax; k > kmin; k--)
+    {
+      pk = pow(maxid, (double) k);
+      J  = pk / (2. - pk);
+      if (1. - pow(1. - pow(J, (double) nrow), (double) nband) >= recall) break;
+    }
+  return k;
+}
+
+/* idfilter_sketch_one()
+ * Calculate the <nbin> MinHash values <mh> for seq <idx>. Return
+ * FALSE if it has no k-mers (and thus no sketch), else TRUE.
+ */
+static int
+idfilter_sketch_one(const ESL_MSA *msa, int idx, int k, uint32_t *mh, int nbin)
+{
+  const ESL_DSQ *ax    = msa->ax[idx];
+  uint64_t       kmod  = 1;
+  uint64_t       code  = 0;
+  uint64_t       h;
+  int            run   = 0;
+  int            nfill = 0;
+  int64_t        apos;
+  int            b, t;
+
+  for (t = 0; t < k; t++) kmod *= msa->abc->K;
+  for (b = 0; b < nbin; b++) mh[b] = UINT32_MAX;
+
+  for (apos = 1; apos <= msa->alen; apos++)
+    {
+      if (esl_abc_XIsGap(msa->abc, ax[apos]) || esl_abc_XIsMissing(msa->abc, ax[apos])) continue;
+      if (! esl_abc_XIsCanonical(msa->abc, ax[apos])) { run = 0; code = 0; continue; }
+
+      code = (code * msa->abc->K + ax[apos]) % kmod;
+      if (++run < k) continue;
+
+      h = idfilter_mix(code);
+      b = (int) (((h >> 32) * (uint64_t) nbin) >> 32);
+      if ((uint32_t) h < mh[b]) { if (mh[b] == UINT32_MAX) nfill++; mh[b] = (uint32_t) h; }
+    }
+  if (nfill == 0) return FALSE;
+
+  /* Densify: an empty bin takes the value of the next nonempty bin,
+   * perturbed by how far away that was. 
+   */
+  for (b = 0; b < nbin; b++)
+    if (mh[b] == UINT32_MAX)
+      {
+	for (t = 1; mh[(b+t) % nbin] == UINT32_MAX; t++) ;
+	mh[b] = (uint32_t) idfilter_mix(((uint64_t) t << 32) | mh[(b+t) % nbin]);
+      }
+  return TRUE;
+}
+
+/* idfilter_sketchtbl_add()
+ * Add seq <who> to table <tbl> with band signature <key>,
+ * doubling the table's allocation and number of chains as needed.
+ */
+static int
+idfilter_sketchtbl_add(IDFILTER_SKETCHTBL *tbl, uint64_t key, int who)
+{
+  int e, b;
+  int status;
+
+  if (tbl->n == tbl->nalloc)
+    {
+      tbl->nalloc *= 2;
+      ESL_REALLOC(tbl->key, sizeof(uint64_t) * tbl->nalloc);
+      ESL_REALLOC(tbl->who, sizeof(int)      * tbl->nalloc);
+      ESL_REALLOC(tbl->nxt, sizeof(int)      * tbl->nalloc);
+    }
+  if (tbl->n >= tbl->nbucket)
+    {
+      tbl->nbucket *= 2;
+      ESL_REALLOC(tbl->head, sizeof(int) * tbl->nbucket);
+      for (b = 0; b < tbl->nbucket; b++) tbl->head[b] = -1;
+      for (e = 0; e < tbl->n; e++)
+	{
+	  b            = (int) (tbl->key[e] & (tbl->nbucket-1));
+	  tbl->nxt[e]  = tbl->head[b];
+	  tbl->head[b] = e;
+	}
+    }
+
+  e            = tbl->n++;
+  b            = (int) (key & (tbl->nbucket-1));
+  tbl->key[e]  = key;
+  tbl->who[e]  = who;
+  tbl->nxt[e]  = tbl->head[b];
+  tbl->head[b] = e;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+static int
+idfilter_sketch(const ESL_MSA *msa, double maxid, int k, int nband, int nrow, double recall,
+		const int *ranked_at, int *list, int *useme, int *ret_nnew)
+{
+  IDFILTER_DATA      d;
+  IDFILTER_SKETCHTBL tbl;
+  int                nbin    = nband * nrow;
+  uint32_t          *mh      = NULL;   // MinHash bins of current candidate [0..nbin-1]
+  uint64_t          *sig     = NULL;   // band signatures of current candidate [0..nband-1]
+  int               *cand    = NULL;   // kept seqs to compare candidate to
+  int               *stamp   = NULL;   // stamp[idx] = r if kept seq idx is already in <cand> for candidate r
+  int               *nosk    = NULL;   // kept seqs with no sketch
+  int                ncand, nnosk;
+  int                nnew    = 0;
+  int                r, idx, band, t, e, reject, has_sketch;
+  uint64_t           h;
+  int                status;
+
+  tbl.head = NULL;
+  tbl.key  = NULL;
+  tbl.who  = NULL;
+  tbl.nxt  = NULL;
+  if ((status = idfilter_data_init(&d, msa, maxid, list)) != eslOK) goto ERROR;
+  if (k <= 0) k = idfilter_sketch_k(msa->abc, maxid, nband, nrow, recall);
+
+  ESL_ALLOC(mh,    sizeof(uint32_t) * nbin);
+  ESL_ALLOC(sig,   sizeof(uint64_t) * nband);
+  ESL_ALLOC(cand,  sizeof(int)      * msa->nseq);
+  ESL_ALLOC(stamp, sizeof(int)      * msa->nseq);
+  ESL_ALLOC(nosk,  sizeof(int)      * msa->nseq);
+  for (idx = 0; idx < msa->nseq; idx++) stamp[idx] = -1;
+  nnosk = 0;
+
+  tbl.nbucket = 1024;
+  tbl.nalloc  = 1024;
+  tbl.n       = 0;
+  ESL_ALLOC(tbl.head, sizeof(int)      * tbl.nbucket);
+  ESL_ALLOC(tbl.key,  sizeof(uint64_t) * tbl.nalloc);
+  ESL_ALLOC(tbl.who,  sizeof(int)      * tbl.nalloc);
+  ESL_ALLOC(tbl.nxt,  sizeof(int)      * tbl.nalloc);
+  for (t = 0; t < tbl.nbucket; t++) tbl.head[t] = -1;
+
+  for (r = 0; r < msa->nseq; r++)
+    {
+      idx        = ranked_at[r];
+      has_sketch = idfilter_sketch_one(msa, idx, k, mh, nbin);
+
+      /* Collect candidates: kept seqs without sketches, plus any
+       * sharing a band with this one (or all kept seqs, if this one
+       * has no sketch).
+       */
+      if (has_sketch)
+	{
+	  esl_vec_ICopy(nosk, nnosk, cand);
+	  ncand = nnosk;
+	  for (band = 0; band < nband; band++)
+	    {
+	      h = (uint64_t) band;
+	      for (t = 0; t < nrow; t++) h = idfilter_mix(h ^ ((uint64_t) mh[band*nrow + t] << 16));
+	      sig[band] = h;
+	      for (e = tbl.head[h & (tbl.nbucket-1)]; e != -1; e = tbl.nxt[e])
+		if (tbl.key[e] == h && stamp[tbl.who[e]] != r)
+		  {
+		    stamp[tbl.who[e]] = r;
+		    cand[ncand++]     = tbl.who[e];
+		  }
+	    }
+	  if ((status = idfilter_test(&d, idx, cand, ncand, &reject)) != eslOK) goto ERROR;
+	}
+      else if ((status = idfilter_test(&d, idx, list, nnew, &reject)) != eslOK) goto ERROR;
+      if (reject) continue;
+
+      list[nnew++] = idx;
+      useme[idx]   = TRUE;
+      if (has_sketch) {
+	for (band = 0; band < nband; band++)
+	  if ((status = idfilter_sketchtbl_add(&tbl, sig[band], idx)) != eslOK) goto ERROR;
+      } else nosk[nnosk++] = idx;
+    }
+
+  free(tbl.head);
+  free(tbl.key);
+  free(tbl.who);
+  free(tbl.nxt);
+  free(mh);
+  free(sig);
+  free(cand);
+  free(stamp);
+  free(nosk);
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  *ret_nnew = nnew;
+  return eslOK;
+
+ ERROR:
+  free(tbl.head);
+  free(tbl.key);
+  free(tbl.who);
+  free(tbl.nxt);
+  free(mh);
+  free(sig);
+  free(cand);
+  free(stamp);
+  free(nosk);
+  free(d.nres);
+  free(d.lpos);
+  free(d.rpos);
+  return status;
+}
+
+
 /* msaweight_IDFilter_txt()
  * %id filtering for text-mode MSAs.
  */
@@ -1685,6 +2887,430 @@ utest_idfilter(void)
   esl_alphabet_Destroy(abc);
   esl_msa_Destroy(msa);
 }
+
+/* PB weights on a packed alignment are identical to PB weights on
+ * the unpacked one: with RF consensus, our own consensus, and
+ * consensus from a subsample.
+ */
+static void
+utest_pb_packed(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[] = "PB packed test failed";
+  ESL_ALPHABET      *abc   = esl_alphabet_Create(abctype);
+  ESL_MSAWEIGHT_CFG *cfg   = esl_msaweight_cfg_Create();
+  ESL_MSA           *msa   = NULL;
+  ESL_MSAPACK       *mp    = NULL;
+  double            *wgt   = NULL;
+  int                idx, apos, cfgtype;
+  int                status;
+
+  if (esl_msa_Sample(rng, abc, 100, 80, &msa) != eslOK) esl_fatal(msg);
+  for (idx = 0; idx < msa->nseq; idx += 4)             // some fragments
+    for (apos = 1; apos <= msa->alen; apos++)
+      if (apos <= msa->alen/2) msa->ax[idx][apos] = abc->K;
+  if (esl_msapack_Pack(msa, &mp) != eslOK) esl_fatal(msg);
+  ESL_ALLOC(wgt, sizeof(double) * msa->nseq);
+
+  for (cfgtype = 0; cfgtype < 3; cfgtype++)
+    {
+      cfg->ignore_rf  = (cfgtype >= 1);
+      cfg->sampthresh = (cfgtype == 2 ? msa->nseq / 2       : eslMSAWEIGHT_SAMPTHRESH);
+      cfg->nsamp      = (cfgtype == 2 ? msa->nseq / 2 + 1   : eslMSAWEIGHT_NSAMP);
+
+      if (esl_msaweight_PB_adv   (cfg, msa, NULL)           != eslOK) esl_fatal(msg);
+      if (esl_msaweight_PB_packed(cfg, mp, msa->rf, wgt, NULL) != eslOK) esl_fatal(msg);
+      if (esl_vec_DCompare(msa->wgt, wgt, msa->nseq, 1e-9)  != eslOK) esl_fatal(msg);
+    }
+
+  free(wgt);
+  esl_msapack_Destroy(mp);
+  esl_msa_Destroy(msa);
+  esl_msaweight_cfg_Destroy(cfg);
+  esl_alphabet_Destroy(abc);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+/* utest_family_msa()
+ * Sample a digital alignment of <nseq> seqs named seq<idx>, <alen>
+ * columns: seqs <0..ntmpl-1> are random templates, and each later
+ * seq <idx> is a copy of template <idx % ntmpl>, with each position
+ * mutated (to a residue, degeneracy, or gap) with probability
+ * 1/<nmut>; <nmut> = 0 means no mutations. With <do_ragged>, each
+ * end of a seq is gapped out up to alen/2 with probability 1/3.
+ */
+static ESL_MSA *
+utest_family_msa(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, int nseq, int alen, int ntmpl, int nmut, int do_ragged)
+{
+  ESL_MSA *msa = esl_msa_CreateDigital(abc, nseq, alen);
+  int      idx, apos;
+  int      lpos = 1;
+  int      rpos = alen;
+  char     name[32];
+
+  if (! msa) esl_fatal("utest_family_msa() failed");
+  for (idx = 0; idx < nseq; idx++)
+    {
+      if (do_ragged)
+	{
+	  lpos = 1    + (esl_rnd_Roll(rng, 3) == 0 ? esl_rnd_Roll(rng, alen/2) : 0);
+	  rpos = alen - (esl_rnd_Roll(rng, 3) == 0 ? esl_rnd_Roll(rng, alen/2) : 0);
+	}
+      for (apos = 1; apos <= alen; apos++)
+	{
+	  if      (apos < lpos || apos > rpos)              msa->ax[idx][apos] = abc->K;  // gap
+	  else if (idx < ntmpl)                             msa->ax[idx][apos] = esl_rnd_Roll(rng, abc->K);
+	  else if (nmut && esl_rnd_Roll(rng, nmut) == 0)    msa->ax[idx][apos] = esl_rnd_Roll(rng, abc->Kp - 2);
+	  else                                              msa->ax[idx][apos] = msa->ax[idx % ntmpl][apos];
+	}
+      snprintf(name, 32, "seq%d", idx);
+      esl_msa_SetSeqName(msa, idx, name, -1);
+    }
+  return msa;
+}
+
+/* utest_idfilter_threads()
+ * %id filtering with worker threads and span pruning must keep
+ * exactly the same seqs as the plain greedy algorithm. Use an
+ * alignment of mutated copies of a few templates, with ragged ends,
+ * so there's plenty of redundancy to filter and plenty of pairs to
+ * prune; big enough to span several thread batches.
+ */
+static void
+utest_idfilter_threads(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[]  = "idfilter threads test failed";
+  ESL_ALPHABET      *abc    = esl_alphabet_Create(abctype);
+  ESL_MSAWEIGHT_CFG *cfg    = esl_msaweight_cfg_Create();
+  int                nseq   = 700;
+  int                alen   = 120;
+  int                ntmpl  = 12;
+  ESL_MSA           *msa    = utest_family_msa(rng, abc, nseq, alen, ntmpl, 5, TRUE);
+  ESL_MSA           *msa1   = NULL;
+  ESL_MSA           *msa2   = NULL;
+  int               *useme  = malloc(sizeof(int) * nseq);
+  int               *list   = malloc(sizeof(int) * nseq);
+  double             maxid  = 0.7;
+  int                idx, i, nnew;
+  double             ident;
+
+  if (!abc || !cfg || !useme || !list) esl_fatal(msg);
+
+  /* Reference: plain greedy filter in original order, no pruning */
+  nnew = 0;
+  for (idx = 0; idx < nseq; idx++)
+    {
+      for (i = 0; i < nnew; i++)
+	{
+	  if (esl_dst_XPairId(abc, msa->ax[idx], msa->ax[list[i]], &ident, NULL, NULL) != eslOK) esl_fatal(msg);
+	  if (ident >= maxid) break;
+	}
+      useme[idx] = (i == nnew);
+      if (useme[idx]) list[nnew++] = idx;
+    }
+  if (nnew == nseq || nnew < ntmpl) esl_fatal(msg);
+
+  cfg->filterpref = eslMSAWEIGHT_FILT_ORIGORDER;
+  for (cfg->ncpu = 0; cfg->ncpu <= 4; cfg->ncpu += 2)
+    {
+      if (esl_msaweight_IDFilter_adv(cfg, msa, maxid, &msa1) != eslOK) esl_fatal(msg);
+      if (msa1->nseq != nnew) esl_fatal(msg);
+      for (i = 0; i < nnew; i++)
+	if (strcmp(msa1->sqname[i], msa->sqname[list[i]]) != 0) esl_fatal(msg);
+      esl_msa_Destroy(msa1);
+    }
+
+  /* Default conscover rule: same result with and without threads */
+  cfg->filterpref = eslMSAWEIGHT_FILT_CONSCOVER;
+  cfg->ncpu       = 0;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, maxid, &msa1) != eslOK) esl_fatal(msg);
+  cfg->ncpu       = 3;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, maxid, &msa2) != eslOK) esl_fatal(msg);
+  if (msa1->nseq != msa2->nseq) esl_fatal(msg);
+  for (i = 0; i < msa1->nseq; i++)
+    if (strcmp(msa1->sqname[i], msa2->sqname[i]) != 0) esl_fatal(msg);
+
+  esl_msa_Destroy(msa1);
+  esl_msa_Destroy(msa2);
+  esl_msa_Destroy(msa);
+  free(useme);
+  free(list);
+  esl_msaweight_cfg_Destroy(cfg);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_idfilter_sketch()
+ * The approximate sketch filter must only remove seqs that are >=
+ * maxid identical to a kept seq; it must always remove exact
+ * duplicates; and with near-duplicates well above maxid, it should
+ * find almost all of what the exact filter does. Include a few seqs
+ * too short to have a k-mer, which take the no-sketch path.
+ */
+static void
+utest_idfilter_sketch(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[]  = "idfilter sketch test failed";
+  ESL_ALPHABET      *abc    = esl_alphabet_Create(abctype);
+  ESL_MSAWEIGHT_CFG *cfg    = esl_msaweight_cfg_Create();
+  int                nseq   = 600;
+  int                alen   = 150;
+  int                ntmpl  = 40;
+  int                ndup   = 10;
+  int                nshort = 3;
+  ESL_MSA           *msa    = utest_family_msa(rng, abc, nseq, alen, ntmpl, 10, FALSE);
+  ESL_MSA           *msa1   = NULL;
+  ESL_MSA           *msa2   = NULL;
+  int               *kept   = malloc(sizeof(int) * nseq);
+  double             maxid  = 0.8;
+  int                idx, apos, i, j;
+  double             ident;
+  char               name[32];
+
+  if (!abc || !cfg || !kept) esl_fatal(msg);
+
+  /* The last <ndup> + <nshort> seqs: exact duplicates of seq0, then seqs of one residue */
+  for (idx = nseq-nshort-ndup; idx < nseq; idx++)
+    {
+      for (apos = 1; apos <= alen; apos++)
+	{
+	  if (idx >= nseq-nshort) msa->ax[idx][apos] = (apos == idx % alen + 1 ? esl_rnd_Roll(rng, abc->K) : abc->K);
+	  else                    msa->ax[idx][apos] = msa->ax[0][apos];
+	}
+      if (idx < nseq-nshort) { snprintf(name, 32, "dup%d", idx); esl_msa_SetSeqName(msa, idx, name, -1); }
+    }
+
+  cfg->filterpref = eslMSAWEIGHT_FILT_ORIGORDER;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, maxid, &msa1) != eslOK) esl_fatal(msg);
+  cfg->sketch = TRUE;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, maxid, &msa2) != eslOK) esl_fatal(msg);
+
+  if (msa2->nseq < msa1->nseq || msa2->nseq > msa1->nseq + nseq/20) esl_fatal(msg);
+
+  /* Map kept seqs back to their indices; they're in original order. */
+  for (i = 0, idx = 0; i < msa2->nseq; i++, idx++)
+    {
+      while (idx < nseq && strcmp(msa->sqname[idx], msa2->sqname[i]) != 0) idx++;
+      if (idx == nseq)                          esl_fatal(msg);
+      if (strncmp(msa2->sqname[i], "dup", 3) == 0) esl_fatal(msg);
+      kept[i] = idx;
+    }
+  for (i = 0, idx = 0; idx < nseq; idx++)
+    {
+      if (i < msa2->nseq && kept[i] == idx) { i++; continue; }
+      for (j = 0; j < msa2->nseq; j++)
+	{
+	  if (esl_dst_XPairId(abc, msa->ax[idx], msa->ax[kept[j]], &ident, NULL, NULL) != eslOK) esl_fatal(msg);
+	  if (ident >= maxid) break;
+	}
+      if (j == msa2->nseq) esl_fatal(msg);
+    }
+
+  esl_msa_Destroy(msa1);
+  esl_msa_Destroy(msa2);
+  esl_msa_Destroy(msa);
+  free(kept);
+  esl_msaweight_cfg_Destroy(cfg);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_idfilter_sketch_limits()
+ * The longest k-mer length whose codes fit in 64 bits (31 for DNA,
+ * 13 for protein) works; one longer, a negative k, or an empty band
+ * layout is rejected with eslEINVAL.
+ */
+static void
+utest_idfilter_sketch_limits(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[] = "idfilter sketch limits test failed";
+  ESL_ALPHABET      *abc   = esl_alphabet_Create(abctype);
+  ESL_MSAWEIGHT_CFG *cfg   = esl_msaweight_cfg_Create();
+  ESL_MSA           *msa   = utest_family_msa(rng, abc, 20, 100, 1, 0, FALSE);   // 20 identical seqs
+  ESL_MSA           *msa2  = NULL;
+  int                kmax  = (abctype == eslAMINO ? 13 : 31);
+
+  cfg->sketch   = TRUE;
+  cfg->sketch_k = kmax;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, 0.9, &msa2) != eslOK) esl_fatal(msg);
+  if (msa2->nseq < 1 || msa2->nseq >= msa->nseq)                  esl_fatal(msg);
+  esl_msa_Destroy(msa2);
+
+#ifdef eslTEST_THROWING
+  esl_exception_SetHandler(&esl_nonfatal_handler);
+  cfg->sketch_k = kmax+1;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, 0.9, &msa2) != eslEINVAL) esl_fatal(msg);
+  cfg->sketch_k = -1;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, 0.9, &msa2) != eslEINVAL) esl_fatal(msg);
+  cfg->sketch_k     = 0;
+  cfg->sketch_nband = 0;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, 0.9, &msa2) != eslEINVAL) esl_fatal(msg);
+  cfg->sketch_nband = eslMSAWEIGHT_SKETCH_NBAND;
+  cfg->sketch_nrow  = 0;
+  if (esl_msaweight_IDFilter_adv(cfg, msa, 0.9, &msa2) != eslEINVAL) esl_fatal(msg);
+  esl_exception_ResetDefaultHandler();
+#endif
+
+  esl_msa_Destroy(msa);
+  esl_msaweight_cfg_Destroy(cfg);
+  esl_alphabet_Destroy(abc);
+}
+
+/* utest_gsc_incremental()
+ * Weights from an ESL_MSAWEIGHT_GSC must be identical to
+ * esl_msaweight_GSC() on the same rows, through a random series of
+ * additions and removals. The first <ngrow> operations are all
+ * additions, which makes it grow past its initial allocation of 16
+ * rows whatever the random walk does afterwards. Some seqs are
+ * duplicates, for zero-length branches.
+ */
+static void
+utest_gsc_incremental(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[] = "incremental GSC test failed";
+  ESL_ALPHABET      *abc   = esl_alphabet_Create(abctype);
+  ESL_MSA           *pool  = NULL;
+  ESL_MSA           *msa   = NULL;
+  ESL_MSAWEIGHT_GSC *gsc   = NULL;
+  double            *wgt   = NULL;
+  int               *list  = NULL;   // rows of <gsc>, as indices into <pool>
+  int                npool = 80;
+  int                alen  = 50;
+  int                ntmpl = 6;
+  int                nops  = 60;
+  int                ngrow = 10;
+  int                n     = 10;
+  int                idx, op;
+  int                status;
+
+  pool = utest_family_msa(rng, abc, npool, alen, ntmpl, 5, FALSE);
+  for (idx = ntmpl; idx < npool; idx++)
+    if (idx % 9 == 0) esl_abc_dsqcpy(pool->ax[idx-1], alen, pool->ax[idx]);
+  ESL_ALLOC(wgt,  sizeof(double) * (npool + nops));
+  ESL_ALLOC(list, sizeof(int)    * (npool + nops));
+
+  if ((msa = esl_msa_CreateDigital(abc, n, alen)) == NULL) esl_fatal(msg);
+  for (idx = 0; idx < n; idx++) { list[idx] = idx; esl_abc_dsqcpy(pool->ax[idx], alen, msa->ax[idx]); }
+  if (esl_msaweight_gsc_Create(msa, &gsc) != eslOK) esl_fatal(msg);
+  esl_msa_Destroy(msa);
+
+  for (op = 0; op < nops; op++)
+    {
+      if (op >= ngrow && n > 1 && esl_rnd_Roll(rng, 3) == 0)
+	{
+	  idx = esl_rnd_Roll(rng, n);
+	  if (esl_msaweight_gsc_Remove(gsc, idx) != eslOK) esl_fatal(msg);
+	  memmove(list + idx, list + idx + 1, sizeof(int) * (n - idx - 1));
+	  n--;
+	}
+      else
+	{
+	  list[n] = esl_rnd_Roll(rng, npool);
+	  if (esl_msaweight_gsc_Add(gsc, pool->ax[list[n]]) != eslOK) esl_fatal(msg);
+	  n++;
+	}
+      if (gsc->N != n)                              esl_fatal(msg);
+      if (op == ngrow-1 && gsc->nalloc <= 16)       esl_fatal(msg);
+
+      if ((msa = esl_msa_CreateDigital(abc, n, alen)) == NULL) esl_fatal(msg);
+      for (idx = 0; idx < n; idx++) esl_abc_dsqcpy(pool->ax[list[idx]], alen, msa->ax[idx]);
+      if (esl_msaweight_GSC(msa)                != eslOK) esl_fatal(msg);
+      if (esl_msaweight_gsc_Weights(gsc, wgt)   != eslOK) esl_fatal(msg);
+      for (idx = 0; idx < n; idx++)
+	if (wgt[idx] != msa->wgt[idx]) esl_fatal(msg);
+      if (esl_msaweight_gsc_Weights(gsc, wgt)   != eslOK) esl_fatal(msg);  // cached weights
+      for (idx = 0; idx < n; idx++)
+	if (wgt[idx] != msa->wgt[idx]) esl_fatal(msg);
+      esl_msa_Destroy(msa);
+    }
+
+  free(list);
+  free(wgt);
+  esl_msaweight_gsc_Destroy(gsc);
+  esl_msa_Destroy(pool);
+  esl_alphabet_Destroy(abc);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+/* utest_pb_threads()
+ * PB weights, and the number of fragments counted, must be identical
+ * with and without worker threads, with consensus columns found
+ * either by counting all seqs or by sampling; for digital and packed
+ * alignments.
+ */
+static void
+utest_pb_threads(ESL_RANDOMNESS *rng, int abctype)
+{
+  char               msg[] = "PB threads test failed";
+  ESL_ALPHABET      *abc   = esl_alphabet_Create(abctype);
+  ESL_MSAWEIGHT_CFG *cfg   = esl_msaweight_cfg_Create();
+  ESL_MSAWEIGHT_DAT *dat   = esl_msaweight_dat_Create();
+  ESL_MSA           *msa   = NULL;
+  ESL_MSAPACK       *mp    = NULL;
+  double            *wgt0  = NULL;
+  double            *wgt1  = NULL;
+  double            *pwgt  = NULL;
+  int                nseq  = 4 * PB_MINSEQ + 17;
+  int                alen  = 60;
+  int                ntmpl = 8;
+  int                nfrag0, ncpu, idx, apos, cfgtype;
+  int                status;
+
+  /* mutated copies of a few templates; some with gappy columns, some fragments */
+  msa = utest_family_msa(rng, abc, nseq, alen, ntmpl, 4, FALSE);
+  for (idx = 0; idx < nseq; idx++)
+    for (apos = 1; apos <= alen; apos++)
+      if ((idx % 3 == 0 && apos <= alen/2) || (apos % 7 == 0 && idx % 2)) msa->ax[idx][apos] = abc->K;
+  if (esl_msapack_Pack(msa, &mp) != eslOK) esl_fatal(msg);
+  ESL_ALLOC(wgt0, sizeof(double) * nseq);
+  ESL_ALLOC(wgt1, sizeof(double) * nseq);
+  ESL_ALLOC(pwgt, sizeof(double) * nseq);
+
+  cfg->ignore_rf = TRUE;
+  for (cfgtype = 0; cfgtype < 2; cfgtype++)
+    {
+      cfg->sampthresh = (cfgtype == 1 ? nseq / 2     : eslMSAWEIGHT_SAMPTHRESH);
+      cfg->nsamp      = (cfgtype == 1 ? nseq / 2 + 1 : eslMSAWEIGHT_NSAMP);
+
+      cfg->ncpu = 0;
+      esl_msaweight_dat_Reuse(dat);
+      if (esl_msaweight_PB_adv(cfg, msa, dat) != eslOK) esl_fatal(msg);
+      esl_vec_DCopy(msa->wgt, nseq, wgt0);
+      nfrag0 = dat->all_nfrag;
+
+      for (ncpu = 2; ncpu <= 5; ncpu += 3)
+	{
+	  cfg->ncpu = ncpu;
+	  esl_msaweight_dat_Reuse(dat);
+	  if (esl_msaweight_PB_adv(cfg, msa, dat) != eslOK) esl_fatal(msg);
+	  if (dat->all_nfrag != nfrag0)                   esl_fatal(msg);
+	  for (idx = 0; idx < nseq; idx++)
+	    if (msa->wgt[idx] != wgt0[idx]) esl_fatal(msg);
+
+	  if (esl_msaweight_PB_packed(cfg, mp, NULL, pwgt, NULL) != eslOK) esl_fatal(msg);
+	  cfg->ncpu = 0;
+	  if (esl_msaweight_PB_packed(cfg, mp, NULL, wgt1, NULL) != eslOK) esl_fatal(msg);
+	  for (idx = 0; idx < nseq; idx++)
+	    if (pwgt[idx] != wgt1[idx]) esl_fatal(msg);
+	}
+    }
+
+  free(wgt0);
+  free(wgt1);
+  free(pwgt);
+  esl_msapack_Destroy(mp);
+  esl_msa_Destroy(msa);
+  esl_msaweight_dat_Destroy(dat);
+  esl_msaweight_cfg_Destroy(cfg);
+  esl_alphabet_Destroy(abc);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
   
 #endif /*eslMSAWEIGHT_TESTDRIVE*/
 /*-------------------- end, unit tests  -------------------------*/
@@ -1701,10 +3327,12 @@ utest_idfilter(void)
 #include "esl_msa.h"
 #include "esl_msafile.h"
 #include "esl_msaweight.h"
+#include "esl_random.h"
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
   { "-h",        eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options]";
@@ -1713,9 +3341,12 @@ static char banner[] = "test driver for msaweight module";
 int
 main(int argc, char **argv)
 {
-  ESL_GETOPTS  *go   = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_GETOPTS    *go   = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng  = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  int             i;
   
   fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
   utest_identical_seqs();
   utest_henikoff_contrived();
@@ -1724,9 +3355,26 @@ main(int argc, char **argv)
   utest_pathologs();
 
   utest_idfilter();
+  utest_idfilter_threads(rng, eslAMINO);
+  utest_idfilter_threads(rng, eslDNA);
+  utest_idfilter_sketch(rng, eslAMINO);
+  utest_idfilter_sketch(rng, eslDNA);
+  utest_idfilter_sketch_limits(rng, eslAMINO);
+  utest_idfilter_sketch_limits(rng, eslDNA);
+
+  for (i = 0; i < 10; i++)
+    {
+      utest_pb_packed(rng, eslAMINO);
+      utest_pb_packed(rng, eslDNA);
+    }
+  utest_pb_threads(rng, eslAMINO);
+  utest_pb_threads(rng, eslDNA);
+  utest_gsc_incremental(rng, eslAMINO);
+  utest_gsc_incremental(rng, eslDNA);
 
   fprintf(stderr, "#  status = ok\n");
 
+  esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
   exit(0);
 }
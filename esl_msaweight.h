@@ -6,11 +6,14 @@
 #define eslMSAWEIGHT_INCLUDED
 #include "esl_config.h"
 
+#include "esl_dmatrix.h"
 #include "esl_msa.h"
+#include "esl_msapack.h"
 #include "esl_rand64.h"
 
 /* ESL_MSAWEIGHT_CFG
- * optional configuration/customization of PB weighting and %id filtering.
+ * optional configuration/customization of PB weighting, %id filtering,
+ * and BLOSUM weighting (<ncpu> only).
  */
 typedef struct {
   float fragthresh;     // seq is a fragment if (length from 1st to last aligned residue)/alen < fragthresh (i.e. span < minspan)
@@ -24,6 +27,15 @@ typedef struct {
 
   /* Only affects %id filtering: */
   int   filterpref;     // eslMSAWEIGHT_FILT_CONSCOVER | eslMSAWEIGHT_FILT_RANDOM | eslMSAWEIGHT_FILT_ORIGORDER
+
+  int   ncpu;           // number of worker threads; 0 = do everything in the caller's thread
+
+  /* Approximate %id filtering by k-mer MinHash sketches: */
+  int    sketch;        // TRUE to compare only candidate pairs found by sketches
+  int    sketch_k;      // k-mer length; 0 = choose from maxid, alphabet, and sketch_recall
+  int    sketch_nband;  // number of LSH bands
+  int    sketch_nrow;   // MinHash values per band
+  double sketch_recall; // target probability of finding a pair at maxid identity (for choosing k)
 } ESL_MSAWEIGHT_CFG;
 
 /* Default parameters for ESL_MSAWEIGHT_CFG */
@@ -35,6 +47,12 @@ typedef struct {
 #define  eslMSAWEIGHT_NSAMP       10000
 #define  eslMSAWEIGHT_MAXFRAG     5000
 #define  eslMSAWEIGHT_RNGSEED     42
+#define  eslMSAWEIGHT_NCPU        0
+#define  eslMSAWEIGHT_SKETCH          FALSE
+#define  eslMSAWEIGHT_SKETCH_K        0
+#define  eslMSAWEIGHT_SKETCH_NBAND    32
+#define  eslMSAWEIGHT_SKETCH_NROW     2
+#define  eslMSAWEIGHT_SKETCH_RECALL   0.99
 
 /* Exclusive settings for seq preference rule in %id filter */
 #define  eslMSAWEIGHT_FILT_CONSCOVER 1
@@ -61,9 +79,25 @@ typedef struct {
   int  samp_nfrag;       // if <cons_by_sample>, number of fragments defined in subsample
 } ESL_MSAWEIGHT_DAT;
 
+/* ESL_MSAWEIGHT_GSC
+ * cached state for recalculating GSC weights as sequences are
+ * added to and removed from an alignment.
+ */
+typedef struct {
+  const ESL_ALPHABET *abc;  // digital alphabet (a copy of the ptr, not the alphabet itself)
+  int64_t      alen;        // aligned length of all seqs
+  int          N;           // number of seqs now held
+  int          nalloc;      // allocated number of seqs
+  ESL_DSQ    **ax;          // copies of the aligned seqs, ax[0..N-1][1..alen]; ax[N..nalloc-1] are NULL
+  ESL_DMATRIX *D;           // fractional differences, nalloc x nalloc; only [0..N-1][0..N-1] valid
+  double      *wgt;         // GSC weights [0..N-1], if <has_wgt>
+  int          has_wgt;     // TRUE if <wgt> is up to date with the seqs
+} ESL_MSAWEIGHT_GSC;
+
 
 extern int esl_msaweight_PB(ESL_MSA *msa);
 extern int esl_msaweight_PB_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, ESL_MSAWEIGHT_DAT *dat);
+extern int esl_msaweight_PB_packed(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSAPACK *mp, const char *rf, double *wgt, ESL_MSAWEIGHT_DAT *dat);
 
 extern ESL_MSAWEIGHT_CFG *esl_msaweight_cfg_Create(void);
 extern void               esl_msaweight_cfg_Destroy(ESL_MSAWEIGHT_CFG *cfg);
@@ -72,7 +106,13 @@ extern int                esl_msaweight_dat_Reuse  (ESL_MSAWEIGHT_DAT *dat);
 extern void               esl_msaweight_dat_Destroy(ESL_MSAWEIGHT_DAT *dat);
 
 extern int esl_msaweight_GSC(ESL_MSA *msa);
+extern int  esl_msaweight_gsc_Create (const ESL_MSA *msa, ESL_MSAWEIGHT_GSC **ret_gsc);
+extern int  esl_msaweight_gsc_Add    (ESL_MSAWEIGHT_GSC *gsc, const ESL_DSQ *ax);
+extern int  esl_msaweight_gsc_Remove (ESL_MSAWEIGHT_GSC *gsc, int idx);
+extern int  esl_msaweight_gsc_Weights(ESL_MSAWEIGHT_GSC *gsc, double *wgt);
+extern void esl_msaweight_gsc_Destroy(ESL_MSAWEIGHT_GSC *gsc);
 extern int esl_msaweight_BLOSUM(ESL_MSA *msa, double maxid);
+extern int esl_msaweight_BLOSUM_adv(const ESL_MSAWEIGHT_CFG *cfg, ESL_MSA *msa, double maxid);
 
 extern int esl_msaweight_IDFilter(const ESL_MSA *msa, double maxid, ESL_MSA **ret_newmsa);
 extern int esl_msaweight_IDFilter_adv(const ESL_MSAWEIGHT_CFG *cfg, const ESL_MSA *msa, double maxid, ESL_MSA **ret_newmsa);
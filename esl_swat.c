@@ -1,20 +1,72 @@
-/* This module is unfinished; don't try to use it for anything! */
-
-
-/* Standard Smith/Waterman sequence alignment
+/* Smith/Waterman local sequence alignment.
  * 
  * Contents:
- *   
- * 
+ *   1. Reference implementation: esl_swat_Score()
+ *   2. ESL_SWAT_PROFILE: striped query profiles
+ *   3. ESL_SWAT_WORKSPACE: reusable DP memory
+ *   4. Striped scoring
+ *   5. Alignment, with traceback in linear memory
+ *   6. Banded and X-drop alignment
+ *   7. ESL_SWAT_BATCH: scoring a query against many targets
+ *   8. Stats driver
+ *   9. Benchmark driver
+ *  10. Unit tests
+ *  11. Test driver
  */
 #include "esl_config.h"
 
+#include <string.h>
+
 #include "easel.h"
+#include "esl_alloc.h"
 #include "esl_composition.h"
+#include "esl_cpu.h"
+#include "esl_dsqdata.h"
+#include "esl_heap.h"
 #include "esl_scorematrix.h"
+#include "esl_sq.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
+#include "esl_vectorops.h"
+
+#include "esl_swat.h"
 
 #define eslSWAT_PROHIBIT -999999999
 
+/* DP states, in alignment traceback */
+#define eslSWAT_STM  0     // M:  query residue aligned to target residue
+#define eslSWAT_STX  1     // IX: query residue against a gap
+#define eslSWAT_STY  2     // IY: target residue against a gap
+
+/* swat_band() mode, besides eslSWAT_LOCAL and eslSWAT_GLOBAL: an
+ * extension anchored at a seed, for esl_swat_XDrop()
+ */
+#define eslSWAT_EXTEND 2
+
+static ESL_SWAT_PROFILE *swat_profile_create(const ESL_SCOREMATRIX *S, const ESL_DSQ *x, int L, int gop, int gex, int simd);
+static ESL_SWAT_PROFILE *swat_profile_alloc (const ESL_ALPHABET *abc, int L, int Kp, int gop, int gex, int simd);
+static int               swat_profile_stripe(ESL_SWAT_PROFILE *prof);
+static int               swat_striped(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j);
+static int               swat_serial (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j);
+static void              swat_ali_clear(ESL_SWAT_ALI *ali);
+static void              swat_dc       (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int *rows, ESL_SWAT_ALI *ali, int i1, int j1, int s1, int i2, int j2, int s2);
+static int               swat_band     (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int i0, int j0, int dir, int Mi, int Lj,
+					int dlo, int dhi, int mode, int xdrop, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j);
+static int               swat_batch_grow   (ESL_SWAT_BATCH *bat, int n);
+static int               swat_batch_score  (ESL_SWAT_BATCH *bat, int *opt_sc);
+static int               swat_batch_range  (ESL_SWAT_BATCH *bat, ESL_SWAT_WORKSPACE *ws, int i0, int i1);
+static int               swat_batch_hit    (ESL_SWAT_BATCH *bat, int64_t idx, int sc);
+static void              swat_batch_compact(ESL_SWAT_BATCH *bat);
+#ifdef HAVE_PTHREAD
+static void              swat_batch_thread (void *arg);
+#endif
+
+
+/*****************************************************************
+ * 1. Reference implementation: esl_swat_Score()
+ *****************************************************************/
+
 /* Function:  esl_swat_Score()
  * Incept:    SRE, Fri Apr 13 16:40:15 2007 [Janelia]
  *
@@ -50,7 +102,8 @@ esl_swat_Score(ESL_DSQ *x, int L, ESL_DSQ *y, int M, ESL_SCOREMATRIX *S, int gop
 
   /* Allocation; 
    * we need two rows of length (L+1) for each of three matrices, M, IX, IY. 
-   * in the future, optimize by providing this from the caller. 
+   * To score one query against many targets without this allocation
+   * per call, use an ESL_SWAT_PROFILE and ESL_SWAT_WORKSPACE instead.
    */
   ESL_ALLOC(rowmem,    sizeof(int *) * 6); 
   rowmem[0] = NULL;
@@ -113,107 +166,2453 @@ esl_swat_Score(ESL_DSQ *x, int L, ESL_DSQ *y, int M, ESL_SCOREMATRIX *S, int gop
 
 
 /*****************************************************************
- * Stats driver.
+ * 2. ESL_SWAT_PROFILE: striped query profiles
  *****************************************************************/
 
-/* 
-    gcc -I. -L. -g -Wall -DeslSWAT_STATS -o stats esl_swat.c -leasel -lm 
-    ./stats
-*/
-#ifdef eslSWAT_STATS
+/* Function:  esl_swat_profile_Create()
+ * Synopsis:  Create a query profile for fast Smith/Waterman scoring.
+ *
+ * Purpose:   Create a profile of query sequence <x[1..L]> with score
+ *            matrix <S> and gap scores <gop>, <gex> (same meanings
+ *            as in <esl_swat_Score()>), for scoring many targets
+ *            with <esl_swat_StripedScore()>.
+ *
+ *            The profile is striped for the widest vector
+ *            instruction set that was compiled in and that the
+ *            processor supports; or, if none, it holds only the
+ *            serial per-residue score rows. 
+ *
+ *            The profile keeps a pointer to the alphabet of <S>,
+ *            which the caller must keep. It does not keep <S> or
+ *            <x>.
+ *
+ *            A profile is read-only once created. One profile can be
+ *            shared by any number of threads, each with its own
+ *            <ESL_SWAT_WORKSPACE>.
+ *
+ * Returns:   ptr to the new profile.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_SWAT_PROFILE *
+esl_swat_profile_Create(const ESL_SCOREMATRIX *S, const ESL_DSQ *x, int L, int gop, int gex)
+{
+  int simd = eslSWAT_SERIAL;
 
-#include "easel.h"
-#include "esl_getopts.h"
-#include "esl_fileparser.h"
-#include "esl_scorematrix.h"
-#include "esl_random.h"
-#include "esl_randomseq.h"
-#include "esl_histogram.h"
+#ifdef eslENABLE_SSE
+  if (esl_cpu_has_sse())    simd = eslSWAT_SSE;
+#endif
+#ifdef eslENABLE_AVX
+  if (esl_cpu_has_avx())    simd = eslSWAT_AVX;
+#endif
+#ifdef eslENABLE_AVX512
+  if (esl_cpu_has_avx512()) simd = eslSWAT_AVX512;
+#endif
+  return swat_profile_create(S, x, L, gop, gex, simd);
+}
 
-int
-main(int argc, char **argv)
+
+/* Function:  esl_swat_profile_Sizeof()
+ * Synopsis:  Returns the allocated size of an <ESL_SWAT_PROFILE>, in bytes.
+ */
+size_t
+esl_swat_profile_Sizeof(const ESL_SWAT_PROFILE *prof)
 {
-  int status;
-  ESL_RANDOMNESS  *r   = esl_randomness_Create(0);
-  ESL_ALPHABET    *abc = esl_alphabet_Create(eslAMINO);
-  ESL_SCOREMATRIX *S   = NULL;
-  ESL_DSQ         *x   = NULL;	/* iid query */
-  ESL_DSQ         *y   = NULL;	/* iid target */
-  double    lambda;
-  double    bg[20];		/* iid background probabilities */
-  int       L;			/* query length */
-  int       M;			/* target length */
-  int       nseq;		/* number of target seqs to simulate */
-  int       i;
-  int       gop; 
-  int       gex;
-  char     *mxfile     = "PMX";
-  int       raw_sc;
+  size_t n = sizeof(ESL_SWAT_PROFILE);
 
-  /* Configuration 
-   */
-  L = 400;			/* query length */
-  M = 400;			/* target length */
-  nseq = 50000;
-  gop = -11;
-  gex = -1;
-  lambda = 0.3207;
+  n += sizeof(int *) * prof->Kp;
+  n += sizeof(int)   * prof->Kp * (prof->L+1);
+  n += (size_t) prof->Kp * (prof->Q8 + prof->Q16 + prof->Q32) * prof->V;
+  if (prof->x)   n += sizeof(ESL_DSQ) * (prof->L+2);
+  if (prof->s16) n += sizeof(int16_t) * prof->Kp * 32;
+  return n;
+}
 
-  ESL_ALLOC(x, sizeof(ESL_DSQ) * (L+2));
-  ESL_ALLOC(y, sizeof(ESL_DSQ) * (M+2));
 
-  /* Input an amino acid score matrix from a file. */
-  if (mxfile != NULL) {
-    ESL_FILEPARSER  *efp = NULL;
-    if ( esl_fileparser_Open(mxfile, NULL, &efp)  != eslOK) esl_fatal("failed to open score file %s", mxfile);
-    if ( esl_scorematrix_Read(efp, abc, &S)               != eslOK) esl_fatal("failed to read matrix from %s", mxfile);
-    esl_fileparser_Close(efp);
-  } else {			/* default = BLOSUM62 */
-    S = esl_scorematrix_Create(abc);
-    esl_scorematrix_Set("BLOSUM62", S);
-  }
-  esl_composition_BL62(bg);
+/* Function:  esl_swat_profile_Destroy()
+ * Synopsis:  Free an <ESL_SWAT_PROFILE>.
+ */
+void
+esl_swat_profile_Destroy(ESL_SWAT_PROFILE *prof)
+{
+  if (prof)
+    {
+      if (prof->sc) { free(prof->sc[0]); free(prof->sc); }
+      esl_alloc_free(prof->p8);
+      esl_alloc_free(prof->p16);
+      esl_alloc_free(prof->p32);
+      free(prof->x);
+      free(prof->s16);
+      free(prof);
+    }
+}
 
-  esl_rsq_xIID(r, bg, 20, L, x);
-  
-  for (i = 0; i < nseq; i++)
+
+/* swat_profile_create()
+ * Create a profile striped for the implementation <simd>: one of
+ * eslSWAT_SERIAL, eslSWAT_SSE, eslSWAT_AVX, eslSWAT_AVX512. The unit
+ * tests use this to test each implementation the processor supports.
+ */
+static ESL_SWAT_PROFILE *
+swat_profile_create(const ESL_SCOREMATRIX *S, const ESL_DSQ *x, int L, int gop, int gex, int simd)
+{
+  ESL_SWAT_PROFILE *prof = NULL;
+  int               Kp   = S->Kp;
+  int               a, b, j;
+  int               status;
+
+  if ((prof = swat_profile_alloc(S->abc_r, L, Kp, gop, gex, simd)) == NULL) return NULL;
+
+  for (a = 0; a < Kp; a++)
+    for (j = 1; j <= L; j++)
+      prof->sc[a][j] = S->s[x[j]][a];
+  if ((status = swat_profile_stripe(prof)) != eslOK) goto ERROR;
+
+  if (prof->Q16 && Kp < 32)
     {
-      esl_rsq_xIID(r, bg, 20, M, y);
-      esl_swat_Score(x, L, y, M, S, gop, gex, &raw_sc);
-      printf("%d\n", raw_sc);
+      ESL_ALLOC(prof->x,   sizeof(ESL_DSQ) * (L+2));
+      ESL_ALLOC(prof->s16, sizeof(int16_t) * Kp * 32);
+      memcpy(prof->x, x, sizeof(ESL_DSQ) * (L+2));
+      for (a = 0; a < Kp; a++)
+	for (b = 0; b < 32; b++)
+	  prof->s16[a*32 + b] = (int16_t) (b < Kp ? ESL_MAX(-32768, ESL_MIN(32767, S->s[a][b])) : -32768);
     }
-  
-  free(x);
-  free(y);
-  esl_scorematrix_Destroy(S);
-  esl_alphabet_Destroy(abc);
-  esl_randomness_Destroy(r);
-  exit(0);
+  return prof;
 
  ERROR:
-  exit(status);
+  esl_swat_profile_Destroy(prof);
+  return NULL;
 }
-  
-  
 
 
+/* swat_profile_alloc()
+ * Allocate a profile of length <L> for <Kp> target residue codes,
+ * with its rows <sc[a][0..L]> zeroed and no stripings. The caller
+ * fills in <sc[a][1..L]>, then stripes them with
+ * swat_profile_stripe().
+ */
+static ESL_SWAT_PROFILE *
+swat_profile_alloc(const ESL_ALPHABET *abc, int L, int Kp, int gop, int gex, int simd)
+{
+  ESL_SWAT_PROFILE *prof = NULL;
+  int               a;
+  int               status;
+
+  ESL_ALLOC(prof, sizeof(ESL_SWAT_PROFILE));
+  prof->abc  = abc;
+  prof->L    = L;
+  prof->Kp   = Kp;
+  prof->gop  = gop;
+  prof->gex  = gex;
+  prof->sc   = NULL;
+  prof->simd = simd;
+  prof->V    = (simd == eslSWAT_AVX512 ? 64 : simd == eslSWAT_AVX ? 32 : simd == eslSWAT_SSE ? 16 : 0);
+  prof->Q8   = prof->Q16 = prof->Q32 = 0;
+  prof->bias = 0;
+  prof->p8   = NULL;
+  prof->p16  = NULL;
+  prof->p32  = NULL;
+  prof->x    = NULL;
+  prof->s16  = NULL;
 
+  ESL_ALLOC(prof->sc,    sizeof(int *) * Kp);
+  prof->sc[0] = NULL;
+  ESL_ALLOC(prof->sc[0], sizeof(int)   * Kp * (L+1));
+  for (a = 1; a < Kp; a++) prof->sc[a] = prof->sc[0] + a * (L+1);
+  esl_vec_ISet(prof->sc[0], Kp * (L+1), 0);
+  return prof;
+
+ ERROR:
+  esl_swat_profile_Destroy(prof);
+  return NULL;
+}
+
+
+/* swat_profile_stripe()
+ * Make the vector stripings of <prof>'s rows <sc>, for its <simd>.
+ *
+ * An 8-bit striping needs every biased score <s + bias> and each gap
+ * penalty to fit in 0..255; a 16-bit one, in -32768..32767. Gap
+ * scores > 0 don't work with the floor at 0 that the vector code
+ * uses, so they force the serial implementation.
+ */
+static int
+swat_profile_stripe(ESL_SWAT_PROFILE *prof)
+{
+  int L  = prof->L;
+  int Kp = prof->Kp;
+  int a, j, q, k, n;
+  int lanes, Q;
+  int minsc, maxsc, maxgap;
+
+  if (prof->V == 0 || L == 0 || prof->gop > 0 || prof->gex > 0) return eslOK;
+
+  minsc = maxsc = 0;
+  for (a = 0; a < Kp; a++)
+    for (j = 1; j <= L; j++)
+      {
+	minsc = ESL_MIN(minsc, prof->sc[a][j]);
+	maxsc = ESL_MAX(maxsc, prof->sc[a][j]);
+      }
+  maxgap = ESL_MAX(-prof->gop, -prof->gex);
+
+  if (maxsc - minsc <= 255 && -minsc < 255 && maxgap <= 255)
+    {
+      lanes      = prof->V;
+      prof->Q8   = Q = (L + lanes - 1) / lanes;
+      prof->bias = (uint8_t) (-minsc);
+      if ((prof->p8 = esl_alloc_aligned((size_t) Kp * Q * prof->V, prof->V)) == NULL) ESL_EXCEPTION(eslEMEM, "allocation failed");
+      for (a = 0, n = 0; a < Kp; a++)
+	for (q = 0; q < Q; q++)
+	  for (k = 0; k < lanes; k++, n++)
+	    {
+	      j = k * Q + q + 1;
+	      prof->p8[n] = (uint8_t) ((j <= L ? prof->sc[a][j] : 0) + prof->bias);
+	    }
+    }
+
+  if (minsc >= -32768 && maxsc <= 32767 && maxgap <= 32767)
+    {
+      lanes     = prof->V / 2;
+      prof->Q16 = Q = (L + lanes - 1) / lanes;
+      if ((prof->p16 = esl_alloc_aligned((size_t) Kp * Q * prof->V, prof->V)) == NULL) ESL_EXCEPTION(eslEMEM, "allocation failed");
+      for (a = 0, n = 0; a < Kp; a++)
+	for (q = 0; q < Q; q++)
+	  for (k = 0; k < lanes; k++, n++)
+	    {
+	      j = k * Q + q + 1;
+	      prof->p16[n] = (int16_t) (j <= L ? prof->sc[a][j] : 0);
+	    }
+    }
+
+  lanes     = prof->V / 4;
+  prof->Q32 = Q = (L + lanes - 1) / lanes;
+  if ((prof->p32 = esl_alloc_aligned((size_t) Kp * Q * prof->V, prof->V)) == NULL) ESL_EXCEPTION(eslEMEM, "allocation failed");
+  for (a = 0, n = 0; a < Kp; a++)
+    for (q = 0; q < Q; q++)
+      for (k = 0; k < lanes; k++, n++)
+	{
+	  j = k * Q + q + 1;
+	  prof->p32[n] = (j <= L ? prof->sc[a][j] : 0);
+	}
+  return eslOK;
+}
 
-#endif /*eslSWAT_STATS*/
 
 
 /*****************************************************************
- * Unit tests
+ * 3. ESL_SWAT_WORKSPACE: reusable DP memory
  *****************************************************************/
 
+/* Function:  esl_swat_workspace_Create()
+ * Synopsis:  Create a DP workspace for Smith/Waterman scoring.
+ *
+ * Purpose:   Create an empty workspace for <esl_swat_StripedScore()>.
+ *            It grows as needed, to fit the largest profile it's
+ *            used with; thereafter, scoring against profiles that
+ *            size or smaller does no allocation. Use
+ *            <esl_swat_workspace_Grow()> to size it in advance.
+ *
+ *            A workspace isn't tied to one profile, but it can only
+ *            be used by one thread at a time.
+ *
+ * Returns:   ptr to the new workspace.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_SWAT_WORKSPACE *
+esl_swat_workspace_Create(void)
+{
+  ESL_SWAT_WORKSPACE *ws = NULL;
+  int                 status;
+
+  ESL_ALLOC(ws, sizeof(ESL_SWAT_WORKSPACE));
+  ws->dp       = NULL;
+  ws->dpalloc  = 0;
+  ws->rows     = NULL;
+  ws->rowalloc = 0;
+  ws->adiag    = NULL;
+  ws->adalloc  = 0;
+  return ws;
+
+ ERROR:
+  return NULL;
+}
+
+
+/* Function:  esl_swat_workspace_Grow()
+ * Synopsis:  Make sure a workspace is big enough for a profile.
+ *
+ * Purpose:   Reallocate <ws>, if needed, so it can be used to score
+ *            targets against profile <prof>. Never shrinks <ws>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure. <ws> is still valid,
+ *            at no less than its original size.
+ */
+int
+esl_swat_workspace_Grow(ESL_SWAT_WORKSPACE *ws, const ESL_SWAT_PROFILE *prof)
+{
+  size_t dpneed = (size_t) 4 * prof->Q32 * prof->V;   // Q8 <= Q16 <= Q32, so this fits all three widths
+  void  *dp;
+  int    status;
+
+  if (prof->s16) dpneed = ESL_MAX(dpneed, (size_t) (3 * (prof->L+1) + prof->Kp) * prof->V);  // inter-sequence kernels
+
+  if (dpneed > ws->dpalloc)
+    {
+      if ((dp = esl_alloc_aligned(dpneed, 64)) == NULL) ESL_EXCEPTION(eslEMEM, "allocation failed");
+      esl_alloc_free(ws->dp);
+      ws->dp      = dp;
+      ws->dpalloc = dpneed;
+    }
+
+  if (prof->L+1 > ws->rowalloc)
+    {
+      ESL_REALLOC(ws->rows, sizeof(int) * 6 * (prof->L+1));
+      ws->rowalloc = prof->L+1;
+    }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  esl_swat_workspace_Sizeof()
+ * Synopsis:  Returns the allocated size of an <ESL_SWAT_WORKSPACE>, in bytes.
+ */
+size_t
+esl_swat_workspace_Sizeof(const ESL_SWAT_WORKSPACE *ws)
+{
+  return sizeof(ESL_SWAT_WORKSPACE) + ws->dpalloc + sizeof(int) * 6 * ws->rowalloc + sizeof(int) * ws->adalloc;
+}
+
+
+/* Function:  esl_swat_workspace_Destroy()
+ * Synopsis:  Free an <ESL_SWAT_WORKSPACE>.
+ */
 void
-utest_Score(char *s1, char *s2, ESL_SCOREMATRIX *S, int gop, int gex, int expect_score)
+esl_swat_workspace_Destroy(ESL_SWAT_WORKSPACE *ws)
+{
+  if (ws)
+    {
+      esl_alloc_free(ws->dp);
+      free(ws->rows);
+      free(ws->adiag);
+      free(ws);
+    }
+}
+
+
+
+/*****************************************************************
+ * 4. Striped scoring
+ *****************************************************************/
+
+/* Function:  esl_swat_StripedScore()
+ * Synopsis:  Fast Smith/Waterman score of a target against a query profile.
+ *
+ * Purpose:   Calculate the Smith/Waterman local alignment score of
+ *            target sequence <y[1..M]> against query profile <prof>,
+ *            using DP workspace <ws>, and return it in <*ret_sc>.
+ *            <ws> is grown if it's too small for <prof>. If <ws> is
+ *            <NULL>, a temporary workspace is allocated and freed.
+ *            The score is identical to
+ *            <esl_swat_Score()>'s for the same query, target, and
+ *            scoring system.
+ *
+ *            The striped vector implementation (Farrar 2007) that
+ *            <prof> was made for runs first with 8-bit scores. If
+ *            the score overflows, it is recalculated with 16-bit
+ *            scores, then 32-bit. Scoring systems too wide for a
+ *            width skip it. Without a vector implementation, a
+ *            serial one is used.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *
+ * Xref:      Farrar, Bioinformatics 23:156-161, 2007.
+ */
+int
+esl_swat_StripedScore(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc)
+{
+  ESL_SWAT_WORKSPACE *tmpws = NULL;
+  int     status;
+
+  if (ws == NULL && (ws = tmpws = esl_swat_workspace_Create()) == NULL) { *ret_sc = 0; return eslEMEM; }
+  status = swat_striped(prof, y, M, ws, ret_sc, NULL, NULL);
+  esl_swat_workspace_Destroy(tmpws);
+  return status;
+}
+
+
+/* swat_striped()
+ * esl_swat_StripedScore(), using workspace <ws> (not optional here);
+ * and if <opt_i> is non-NULL, also returning the end <*opt_i>,<*opt_j>
+ * of the best alignment, in the first row of <y> that reaches the
+ * optimal score; or 0,0 if the score is 0.
+ */
+static int
+swat_striped(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int   (*k8) (const ESL_SWAT_PROFILE *, const ESL_DSQ *, int, void *, int *, int *, int *) = NULL;
+  int   (*k16)(const ESL_SWAT_PROFILE *, const ESL_DSQ *, int, void *, int *, int *, int *) = NULL;
+  int   (*k32)(const ESL_SWAT_PROFILE *, const ESL_DSQ *, int, void *, int *, int *, int *) = NULL;
+  int     status;
+
+  *ret_sc = 0;
+  if (opt_i) { *opt_i = 0; *opt_j = 0; }
+  if (prof->L == 0 || M == 0) return eslOK;
+  if ((status = esl_swat_workspace_Grow(ws, prof)) != eslOK) return status;
+
+  switch (prof->simd) {
+#ifdef eslENABLE_SSE
+  case eslSWAT_SSE:
+    k8  = esl_swat_striped8_sse;
+    k16 = esl_swat_striped16_sse;
+#ifdef eslENABLE_SSE4
+    if (esl_cpu_has_sse4()) k32 = esl_swat_striped32_sse;
+#endif
+    break;
+#endif
+#ifdef eslENABLE_AVX
+  case eslSWAT_AVX:
+    k8  = esl_swat_striped8_avx;
+    k16 = esl_swat_striped16_avx;
+    k32 = esl_swat_striped32_avx;
+    break;
+#endif
+#ifdef eslENABLE_AVX512
+  case eslSWAT_AVX512:
+    k8  = esl_swat_striped8_avx512;
+    k16 = esl_swat_striped16_avx512;
+    k32 = esl_swat_striped32_avx512;
+    break;
+#endif
+  default: break;
+  }
+  /* Widen 8 -> 16 -> 32 bits while a kernel overflows (eslERANGE),
+   * using each width that has both a kernel and a striping. The
+   * serial code catches the rest: a profile with no stripings, or an
+   * SSE build on a host without SSE4.1, which has no 32-bit kernel.
+   */
+  status = eslERANGE;
+  if (k8  &&                         prof->Q8)  status = (*k8) (prof, y, M, ws->dp, ret_sc, opt_i, opt_j);
+  if (k16 && status == eslERANGE && prof->Q16) status = (*k16)(prof, y, M, ws->dp, ret_sc, opt_i, opt_j);
+  if (k32 && status == eslERANGE && prof->Q32) status = (*k32)(prof, y, M, ws->dp, ret_sc, opt_i, opt_j);
+  if (       status == eslERANGE)              status = swat_serial(prof, y, M, ws, ret_sc, opt_i, opt_j);
+  return status;
+}
+
+
+/* swat_serial()
+ * Serial implementation of swat_striped(), for profiles with no
+ * vector striping: the same recursion as esl_swat_Score(), with
+ * scores from the profile's rows.
+ */
+static int
+swat_serial(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int        L      = prof->L;
+  int       *mc, *mp, *ixc, *ixp, *iyc, *iyp, *tmp;
+  const int *sc;
+  int        i, j;
+  int        maxsc  = 0;
+  int        bi     = 0, bj = 0;
+
+  mp = ws->rows;  ixp = mp  + (L+1);  iyp = ixp + (L+1);
+  mc = iyp + (L+1);  ixc = mc + (L+1);  iyc = ixc + (L+1);
+  for (j = 0; j <= L; j++) { mp[j] = 0; ixp[j] = iyp[j] = eslSWAT_PROHIBIT; }
+  mc[0] = 0; ixc[0] = iyc[0] = eslSWAT_PROHIBIT;
+
+  for (i = 1; i <= M; i++)
+    {
+      sc = prof->sc[y[i]];
+      for (j = 1; j <= L; j++)
+	{
+	  mc[j] = ESL_MAX(0, ESL_MAX(mp[j-1], ESL_MAX(ixp[j-1], iyp[j-1]))) + sc[j];
+	  if (mc[j] > maxsc) { maxsc = mc[j]; bi = i; bj = j; }
+	  ixc[j] = ESL_MAX(mc[j-1] + prof->gop, ixc[j-1] + prof->gex);
+	  iyc[j] = ESL_MAX(mp[j]   + prof->gop, iyp[j]   + prof->gex);
+	}
+      tmp = mp;  mp  = mc;  mc  = tmp;
+      tmp = ixp; ixp = ixc; ixc = tmp;
+      tmp = iyp; iyp = iyc; iyc = tmp;
+    }
+
+  *ret_sc = maxsc;
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+
+/*****************************************************************
+ * 5. Alignment, with traceback in linear memory
+ *****************************************************************/
+
+/* Function:  esl_swat_ali_Create()
+ * Synopsis:  Create an <ESL_SWAT_ALI>.
+ *
+ * Purpose:   Create an empty <ESL_SWAT_ALI>, to be filled in by
+ *            <esl_swat_Align()>, and reused for as many alignments
+ *            as the caller likes.
+ *
+ * Returns:   ptr to the new object.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_SWAT_ALI *
+esl_swat_ali_Create(void)
 {
+  ESL_SWAT_ALI *ali = NULL;
+  int           status;
+
+  ESL_ALLOC(ali, sizeof(ESL_SWAT_ALI));
+  ali->path   = NULL;
+  ali->cigar  = NULL;
+  ali->nalloc = 64;
+  ESL_ALLOC(ali->path,  sizeof(char) * ali->nalloc);
+  ESL_ALLOC(ali->cigar, sizeof(char) * ali->nalloc * 2);
+  swat_ali_clear(ali);
+  return ali;
 
+ ERROR:
+  esl_swat_ali_Destroy(ali);
+  return NULL;
+}
+
+
+/* Function:  esl_swat_ali_Destroy()
+ * Synopsis:  Free an <ESL_SWAT_ALI>.
+ */
+void
+esl_swat_ali_Destroy(ESL_SWAT_ALI *ali)
+{
+  if (ali)
+    {
+      free(ali->path);
+      free(ali->cigar);
+      free(ali);
+    }
 }
 
 
+/* Function:  esl_swat_Align()
+ * Synopsis:  Optimal Smith/Waterman local alignment, in linear memory.
+ *
+ * Purpose:   Find an optimal local alignment of target sequence
+ *            <y[1..M]> to query profile <prof>, using DP workspace
+ *            <ws> (or a temporary one, if <ws> is <NULL>), and
+ *            return it in <ali>: its score (identical to
+ *            <esl_swat_StripedScore()>'s), its coordinates on the
+ *            query and the target, and its path, both column by
+ *            column and as a CIGAR string. If the score is 0, the
+ *            alignment is empty, with coordinates and <n> all 0.
+ *
+ *            Memory is O(L) plus the size of the alignment, not
+ *            O(LM). It takes three passes. The striped scoring pass
+ *            finds the score and the alignment's end, <(tto,qto)>.
+ *            A second striped pass, on both sequences reversed from
+ *            that end and a profile that scores 1 extra for starting
+ *            the alignment right at it, finds the alignment's start
+ *            <(tfrom,qfrom)>. Last, a divide and conquer global
+ *            alignment of the rectangle between the two (Hirschberg
+ *            1975; Myers and Miller 1988) recovers the path, in time
+ *            about twice that rectangle's area.
+ *
+ *            If more than one alignment is optimal, the one returned
+ *            ends in the earliest target row that reaches the score.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *
+ * Xref:      Myers and Miller, CABIOS 4:11-17, 1988.
+ */
+int
+esl_swat_Align(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, ESL_SWAT_ALI *ali)
+{
+  ESL_SWAT_WORKSPACE *tmpws = NULL;
+  ESL_SWAT_PROFILE   *rev   = NULL;
+  ESL_DSQ            *ry    = NULL;
+  int                 Kp    = prof->Kp;
+  int                 sc, iend, jend, rsc, ri, rj;
+  int                 i, j, a, n;
+  int                 status;
+
+  swat_ali_clear(ali);
+  if (ws == NULL && (ws = tmpws = esl_swat_workspace_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+
+  /* Score, and the end of the alignment. */
+  if ((status = swat_striped(prof, y, M, ws, &sc, &iend, &jend)) != eslOK) goto ERROR;
+  if (sc == 0) { esl_swat_workspace_Destroy(tmpws); return eslOK; }
+
+  /* The start: the end of the best alignment of the sequences reversed
+   * from (iend,jend), in which target residue y[iend] gets a code of
+   * its own, Kp, scoring 1 extra against x[jend]. Only alignments that
+   * start at (iend,jend) score sc+1.
+   */
+  if ((rev = swat_profile_alloc(prof->abc, jend, Kp+1, prof->gop, prof->gex, prof->simd)) == NULL) { status = eslEMEM; goto ERROR; }
+  for (a = 0; a < Kp; a++)
+    for (j = 1; j <= jend; j++)
+      rev->sc[a][j] = prof->sc[a][jend-j+1];
+  for (j = 1; j <= jend; j++)
+    rev->sc[Kp][j] = prof->sc[y[iend]][jend-j+1];
+  rev->sc[Kp][1] += 1;
+  if ((status = swat_profile_stripe(rev)) != eslOK) goto ERROR;
+
+  ESL_ALLOC(ry, sizeof(ESL_DSQ) * (iend+2));
+  ry[0] = ry[iend+1] = eslDSQ_SENTINEL;
+  ry[1] = (ESL_DSQ) Kp;
+  for (i = 2; i <= iend; i++) ry[i] = y[iend-i+1];
+
+  if ((status = swat_striped(rev, ry, iend, ws, &rsc, &ri, &rj)) != eslOK) goto ERROR;
+  if (rsc != sc+1) ESL_XEXCEPTION(eslEINCONCEIVABLE, "reverse pass found score %d, expected %d", rsc, sc+1);
 
+  ali->sc    = sc;
+  ali->tfrom = iend - ri + 1;  ali->tto = iend;
+  ali->qfrom = jend - rj + 1;  ali->qto = jend;
 
+  /* The path. */
+  n = (ali->tto - ali->tfrom + 1) + (ali->qto - ali->qfrom + 1);
+  if (n+1 > ali->nalloc)
+    {
+      ESL_REALLOC(ali->path,  sizeof(char) * (n+1));
+      ESL_REALLOC(ali->cigar, sizeof(char) * (n+1) * 2);
+      ali->nalloc = n+1;
+    }
+  ali->path[ali->n++] = 'M';
+  if (ali->tfrom < ali->tto || ali->qfrom < ali->qto)
+    swat_dc(prof, y, ws->rows, ali, ali->tfrom, ali->qfrom, eslSWAT_STM, ali->tto, ali->qto, eslSWAT_STM);
+  ali->path[ali->n] = '\0';
+
+  for (i = 0, n = 0; i < ali->n; i = j)
+    {
+      for (j = i+1; j < ali->n && ali->path[j] == ali->path[i]; j++) ;
+      n += snprintf(ali->cigar + n, (size_t) (ali->nalloc * 2 - n), "%d%c", j-i, ali->path[i]);
+    }
+  ali->cigar[n] = '\0';
 
+  esl_swat_profile_Destroy(rev);
+  esl_swat_workspace_Destroy(tmpws);
+  free(ry);
+  return eslOK;
 
+ ERROR:
+  swat_ali_clear(ali);
+  esl_swat_profile_Destroy(rev);
+  esl_swat_workspace_Destroy(tmpws);
+  free(ry);
+  return status;
+}
+
+
+/* swat_ali_clear()
+ * Make <ali> an empty alignment.
+ */
+static void
+swat_ali_clear(ESL_SWAT_ALI *ali)
+{
+  ali->sc       = 0;
+  ali->qfrom    = ali->qto = 0;
+  ali->tfrom    = ali->tto = 0;
+  ali->n        = 0;
+  ali->path[0]  = '\0';
+  ali->cigar[0] = '\0';
+}
+
+
+/* swat_add()
+ * Add score <b> to <a>, where <a> may be eslSWAT_PROHIBIT, which
+ * stays put instead of drifting toward underflow.
+ */
+static inline int
+swat_add(int a, int b)
+{
+  return (a == eslSWAT_PROHIBIT ? eslSWAT_PROHIBIT : a + b);
+}
+
+
+/* swat_dc()
+ * Append to <ali->path> the optimal global path from cell (i1,j1)
+ * in state <s1> to cell (i2,j2) in state <s2>, not including the
+ * column for (i1,j1) itself, by divide and conquer in linear memory:
+ * scores to each cell of the middle row <mid> from the start,
+ * and from each cell of row <mid+1> to the end, find where the
+ * optimal path crosses between the two rows; then recurse on the
+ * two halves. States are eslSWAT_ST{M,X,Y} for M, IX, IY, scored
+ * as in esl_swat_Score(). <rows> has room for 6 rows of j2-j1+1.
+ */
+static void
+swat_dc(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int *rows, ESL_SWAT_ALI *ali, int i1, int j1, int s1, int i2, int j2, int s2)
+{
+  int        n   = j2 - j1 + 1;
+  int       *fm  = rows;
+  int       *fx  = fm + n;
+  int       *fy  = fx + n;
+  int       *bm  = fy + n;
+  int       *bx  = bm + n;
+  int       *by  = bx + n;
+  int        gop = prof->gop;
+  int        gex = prof->gex;
+  const int *sc;
+  int        mid, i, c;
+  int        h, hd, d, dn, v;
+  int        best, bc, bs, bt;
+
+  if (i1 == i2)                 // one row: from (i1,j1) to (i1,j2) can only be IX
+    {
+      for (c = 1; c < n; c++) ali->path[ali->n++] = 'I';
+      return;
+    }
+  mid = (i1 + i2) / 2;
+
+  /* Forward, from (i1,j1,s1) to each cell in row mid. */
+  for (c = 0; c < n; c++) fm[c] = fx[c] = fy[c] = eslSWAT_PROHIBIT;
+  if      (s1 == eslSWAT_STM) fm[0] = 0;
+  else if (s1 == eslSWAT_STX) fx[0] = 0;
+  else                        fy[0] = 0;
+  for (c = 1; c < n; c++) fx[c] = ESL_MAX(swat_add(fm[c-1], gop), swat_add(fx[c-1], gex));
+  for (i = i1+1; i <= mid; i++)
+    {
+      sc = prof->sc[y[i]] + j1;
+      hd = eslSWAT_PROHIBIT;
+      for (c = 0; c < n; c++)
+	{
+	  h     = ESL_MAX(fm[c], ESL_MAX(fx[c], fy[c]));
+	  fy[c] = ESL_MAX(swat_add(fm[c], gop), swat_add(fy[c], gex));
+	  fm[c] = swat_add(hd, sc[c]);
+	  fx[c] = (c == 0 ? eslSWAT_PROHIBIT : ESL_MAX(swat_add(fm[c-1], gop), swat_add(fx[c-1], gex)));
+	  hd    = h;
+	}
+    }
+
+  /* Backward, from each cell in row mid+1 to (i2,j2,s2). A cell's
+   * score includes its transitions out, not in.
+   */
+  for (c = 0; c < n; c++) bm[c] = bx[c] = by[c] = eslSWAT_PROHIBIT;
+  if      (s2 == eslSWAT_STM) bm[n-1] = 0;
+  else if (s2 == eslSWAT_STX) bx[n-1] = 0;
+  else                        by[n-1] = 0;
+  for (c = n-2; c >= 0; c--)
+    {
+      bm[c] = swat_add(bx[c+1], gop);
+      bx[c] = swat_add(bx[c+1], gex);
+    }
+  for (i = i2-1; i > mid; i--)
+    {
+      sc = prof->sc[y[i+1]] + j1;
+      dn = eslSWAT_PROHIBIT;    // to M(i+1,j+1), from cell j
+      for (c = n-1; c >= 0; c--)
+	{
+	  d     = dn;
+	  dn    = swat_add(bm[c], sc[c]);
+	  bm[c] = ESL_MAX(d, ESL_MAX(swat_add(by[c], gop), (c < n-1 ? swat_add(bx[c+1], gop) : eslSWAT_PROHIBIT)));
+	  bx[c] = ESL_MAX(d, (c < n-1 ? swat_add(bx[c+1], gex) : eslSWAT_PROHIBIT));
+	  by[c] = ESL_MAX(d, swat_add(by[c], gex));
+	}
+    }
+
+  /* The crossing from row mid to mid+1: diagonally into M, or down
+   * into IY from M or IY.
+   */
+  sc   = prof->sc[y[mid+1]] + j1;
+  best = eslSWAT_PROHIBIT;
+  bc   = bs = bt = 0;
+  for (c = 0; c < n; c++)
+    {
+      if (c < n-1)
+	{
+	  h = ESL_MAX(fm[c], ESL_MAX(fx[c], fy[c]));
+	  v = swat_add(swat_add(h, sc[c+1]), bm[c+1]);
+	  if (v > best) { best = v; bc = c; bt = eslSWAT_STM; bs = (h == fm[c] ? eslSWAT_STM : h == fx[c] ? eslSWAT_STX : eslSWAT_STY); }
+	}
+      v = swat_add(swat_add(fm[c], gop), by[c]);
+      if (v > best) { best = v; bc = c; bt = eslSWAT_STY; bs = eslSWAT_STM; }
+      v = swat_add(swat_add(fy[c], gex), by[c]);
+      if (v > best) { best = v; bc = c; bt = eslSWAT_STY; bs = eslSWAT_STY; }
+    }
+
+  swat_dc(prof, y, rows, ali, i1, j1, s1, mid, j1+bc, bs);
+  if (bt == eslSWAT_STM) { ali->path[ali->n++] = 'M'; swat_dc(prof, y, rows, ali, mid+1, j1+bc+1, eslSWAT_STM, i2, j2, s2); }
+  else                   { ali->path[ali->n++] = 'D'; swat_dc(prof, y, rows, ali, mid+1, j1+bc,   eslSWAT_STY, i2, j2, s2); }
+}
+
+
+
+/*****************************************************************
+ * 6. Banded and X-drop alignment
+ *****************************************************************/
+
+/* Function:  esl_swat_BandedScore()
+ * Synopsis:  Smith/Waterman or global alignment score, within a band.
+ *
+ * Purpose:   Score target <y[1..M]> against query profile <prof>,
+ *            allowing only alignments that stay within diagonals
+ *            <d-w..d+w>, where the diagonal of cell (i,j), for
+ *            target residue i and query residue j, is <j-i>. With
+ *            <mode> <eslSWAT_LOCAL>, this is the Smith/Waterman
+ *            local score within the band; with <eslSWAT_GLOBAL>, the
+ *            score of the best alignment of all of both sequences,
+ *            for which the band must include both diagonal 0 and
+ *            <L-M>. Return the score in <*ret_sc>.
+ *
+ *            Time is O(L w) instead of the O(LM) of the full
+ *            recursion; memory O(L+w). <ws> is grown if needed; if
+ *            it's <NULL>, a temporary workspace is used.
+ *
+ *            With a band wide enough to hold every cell, the local
+ *            score is the same as <esl_swat_StripedScore()>'s.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <w> is negative, <mode> isn't one of the
+ *            above, or a global band doesn't include both ends.
+ *            <eslEMEM> on allocation failure.
+ */
+int
+esl_swat_BandedScore(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, int d, int w, int mode, ESL_SWAT_WORKSPACE *ws, int *ret_sc)
+{
+  ESL_SWAT_WORKSPACE *tmpws = NULL;
+  int                 status;
+
+  *ret_sc = 0;
+  if (w < 0)                                              ESL_EXCEPTION(eslEINVAL, "band width can't be negative");
+  if (mode != eslSWAT_LOCAL && mode != eslSWAT_GLOBAL)    ESL_EXCEPTION(eslEINVAL, "no such banded alignment mode");
+  if (mode == eslSWAT_GLOBAL && (d-w > 0 || d+w < 0 || d-w > prof->L - M || d+w < prof->L - M))
+    ESL_EXCEPTION(eslEINVAL, "band doesn't include both ends of a global alignment");
+
+  if (ws == NULL && (ws = tmpws = esl_swat_workspace_Create()) == NULL) return eslEMEM;
+  status = swat_band(prof, y, 0, 0, 1, M, prof->L, d-w, d+w, mode, 0, ws, ret_sc, NULL, NULL);
+  esl_swat_workspace_Destroy(tmpws);
+  return status;
+}
+
+
+/* Function:  esl_swat_XDrop()
+ * Synopsis:  Extend a seed into a gapped alignment, with an X-drop cutoff.
+ *
+ * Purpose:   Extend a seed at cell <(i0,j0)>, target residue <y[i0]>
+ *            aligned to query residue <x[j0]>, in both directions
+ *            into a gapped alignment to query profile <prof>, as in
+ *            BLAST. Each direction's extension stops when the scores
+ *            of every cell on an anti-diagonal have fallen more than
+ *            <xdrop> below the best it has seen, and never leaves
+ *            diagonals <w> either side of the seed's. Return the
+ *            score of the extended alignment, including the seed
+ *            cell's, in <*ret_sc>; and optionally, the extents of the
+ *            alignment on the target <*opt_tfrom..*opt_tto> and the
+ *            query <*opt_qfrom..*opt_qto>.
+ *
+ *            <ws> is grown if needed; if it's <NULL>, a temporary
+ *            workspace is used.
+ *
+ * Args:      prof   - query profile
+ *            y      - target sequence, y[1..M]
+ *            M      - length of <y>
+ *            i0,j0  - seed cell: 1 <= i0 <= M, 1 <= j0 <= prof->L
+ *            w      - band half-width, >= 0
+ *            xdrop  - X-drop cutoff, >= 0
+ *            ws     - DP workspace, or NULL
+ *            ret_sc      - RETURN: score
+ *            opt_tfrom, opt_tto - optRETURN: target extent
+ *            opt_qfrom, opt_qto - optRETURN: query extent
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if the seed is out of range, or <w> or
+ *            <xdrop> is negative. <eslEMEM> on allocation failure.
+ */
+int
+esl_swat_XDrop(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, int i0, int j0, int w, int xdrop, ESL_SWAT_WORKSPACE *ws,
+	       int *ret_sc, int *opt_tfrom, int *opt_tto, int *opt_qfrom, int *opt_qto)
+{
+  ESL_SWAT_WORKSPACE *tmpws = NULL;
+  int                 fsc, fi, fj, bsc, bi, bj;
+  int                 status;
+
+  *ret_sc = 0;
+  if (i0 < 1 || i0 > M || j0 < 1 || j0 > prof->L) ESL_EXCEPTION(eslEINVAL, "seed cell (%d,%d) out of range", i0, j0);
+  if (w < 0 || xdrop < 0)                         ESL_EXCEPTION(eslEINVAL, "band width and X-drop can't be negative");
+
+  if (ws == NULL && (ws = tmpws = esl_swat_workspace_Create()) == NULL) return eslEMEM;
+  if ((status = swat_band(prof, y, i0, j0,  1, M - i0,     prof->L - j0, -w, w, eslSWAT_EXTEND, xdrop, ws, &fsc, &fi, &fj)) != eslOK) goto ERROR;
+  if ((status = swat_band(prof, y, i0, j0, -1, i0 - 1,     j0 - 1,       -w, w, eslSWAT_EXTEND, xdrop, ws, &bsc, &bi, &bj)) != eslOK) goto ERROR;
+
+  *ret_sc = prof->sc[y[i0]][j0] + fsc + bsc;
+  if (opt_tfrom) *opt_tfrom = i0 - bi;
+  if (opt_tto)   *opt_tto   = i0 + fi;
+  if (opt_qfrom) *opt_qfrom = j0 - bj;
+  if (opt_qto)   *opt_qto   = j0 + fj;
+  esl_swat_workspace_Destroy(tmpws);
+  return eslOK;
+
+ ERROR:
+  esl_swat_workspace_Destroy(tmpws);
+  return status;
+}
+
+
+/* swat_band()
+ * Banded DP, by anti-diagonals, for esl_swat_BandedScore() and
+ * esl_swat_XDrop().
+ *
+ * Cell (i,j), i=0..Mi, j=0..Lj, scores target residue y[i0 + dir*i]
+ * against query residue x[j0 + dir*j]: <dir> is 1 to go forward from
+ * (i0,j0), -1 to go back from it. Only diagonals <j-i> from <dlo> to
+ * <dhi> are computed. <mode> is eslSWAT_LOCAL (floor at 0; best M
+ * anywhere), eslSWAT_GLOBAL (from (0,0) to (Mi,Lj)), or
+ * eslSWAT_EXTEND (from (0,0) in M, scoring 0; best M anywhere,
+ * including (0,0); cells more than <xdrop> under the best so far are
+ * dropped, and the DP stops when two anti-diagonals in a row are
+ * gone). Returns the score in <*ret_sc>, and optionally its cell in
+ * <*opt_i>,<*opt_j>.
+ *
+ * Cells on anti-diagonal t = i+j depend only on t-1 (IX, IY) and t-2
+ * (M), never on each other, so the inner loop has no dependencies
+ * across its iterations: it's vectorized, by the esl_swat_adiag_*()
+ * kernel for the profile's <simd>, if there is one. Arrays are
+ * indexed by row i, so IX(i,j) reads index i, and IY and M read i-1.
+ * Scores along an anti-diagonal are gathered into <s> first.
+ */
+static int
+swat_band(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int i0, int j0, int dir, int Mi, int Lj,
+	  int dlo, int dhi, int mode, int xdrop, ESL_SWAT_WORKSPACE *ws, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int   imax  = ESL_MIN(Mi, Lj - dlo);                          // last row with a cell in the band
+  int   n     = imax + 3;                                       // each array holds rows -1..imax+1
+  int   mmin  = (mode == eslSWAT_LOCAL ? 0 : eslSWAT_PROHIBIT);    // floor on M(i-1,j-1) before adding s(i,j)
+  int   gop   = prof->gop;
+  int   gex   = prof->gex;
+  int   best  = (mode == eslSWAT_GLOBAL ? eslSWAT_PROHIBIT : 0);
+  int   bi    = 0, bj = 0;
+  void (*kad)(const int *, const int *, const int *, const int *, const int *, int *, int *, int *, int *, int, int, int, int, int) = NULL;
+  int  *mp, *xp, *yp, *mc, *xc, *yc, *hpp, *hp, *hc, *s, *tmp;
+  const ESL_DSQ *yi;
+  int   t, t0, t1, i, lo, hi, ilo, ihi, jt, m, xv, yv, v, thresh;
+  int   alive, palive = TRUE;
+  int   status;
+
+  if (imax < 0 || dlo > dhi || dlo > Lj || dhi < -Mi) { *ret_sc = (mode == eslSWAT_GLOBAL ? eslSWAT_PROHIBIT : 0); goto DONE; }
+
+  if (10 * n > ws->adalloc)
+    {
+      ESL_REALLOC(ws->adiag, sizeof(int) * 10 * n);
+      ws->adalloc = 10 * n;
+    }
+  esl_vec_ISet(ws->adiag, 10 * n, eslSWAT_PROHIBIT);
+  mp  = ws->adiag + 1;  xp = mp + n;  yp = xp + n;
+  mc  = yp + n;         xc = mc + n;  yc = xc + n;
+  hpp = yc + n;         hp = hpp + n; hc = hp + n;
+  s   = hc + n;
+
+  switch (prof->simd) {
+#ifdef eslENABLE_SSE4
+  case eslSWAT_SSE:    if (esl_cpu_has_sse4()) kad = esl_swat_adiag_sse; break;
+#endif
+#ifdef eslENABLE_AVX
+  case eslSWAT_AVX:    kad = esl_swat_adiag_avx;    break;
+#endif
+#ifdef eslENABLE_AVX512
+  case eslSWAT_AVX512: kad = esl_swat_adiag_avx512; break;
+#endif
+  default: break;
+  }
+
+  /* first and last anti-diagonals with cells in the band */
+  t0 = (dlo > 0 ? dlo : dhi < 0 ? -dhi : 0);
+  t1 = (Lj - Mi > dhi ? 2*Mi + dhi : Lj - Mi < dlo ? 2*Lj - dlo : Mi + Lj);
+
+  for (t = t0; t <= t1; t++)
+    {
+      lo = ESL_MAX(ESL_MAX(0, t - Lj), (t - dhi + 1) / 2);     // rows i of the cells on t in the band
+      hi = ESL_MIN(ESL_MIN(t, Mi), (t - dlo) / 2);              // (t >= t0 keeps both divisions on t-dlo >= 0)
+      mc[lo-1] = xc[lo-1] = yc[lo-1] = hc[lo-1] = eslSWAT_PROHIBIT;
+      mc[hi+1] = xc[hi+1] = yc[hi+1] = hc[hi+1] = eslSWAT_PROHIBIT;
+
+      /* scores, for cells off row and column 0; those are set below */
+      ilo = ESL_MAX(lo, 1);
+      ihi = ESL_MIN(hi, t-1);
+      if (dir == 1) { yi = y + i0; jt = j0 + t; for (i = ilo; i <= ihi; i++) s[i] = prof->sc[yi[i]][jt-i]; }
+      else          { yi = y + i0; jt = j0 - t; for (i = ilo; i <= ihi; i++) s[i] = prof->sc[yi[-i]][jt+i]; }
+
+      if (kad) (*kad)(hpp, mp, xp, yp, s, mc, xc, yc, hc, lo, hi, mmin, gop, gex);
+      else
+	for (i = lo; i <= hi; i++)
+	  {
+	    m     = ESL_MAX(hpp[i-1], mmin) + s[i];
+	    xv    = ESL_MAX(mp[i]   + gop, xp[i]   + gex);
+	    yv    = ESL_MAX(mp[i-1] + gop, yp[i-1] + gex);
+	    mc[i] = m;
+	    xc[i] = xv;
+	    yc[i] = yv;
+	    hc[i] = ESL_MAX(m, ESL_MAX(xv, yv));
+	  }
+
+      /* row 0 and column 0: only (0,0) starts a global or extension alignment */
+      if (lo == 0)         { mc[0] = (mode == eslSWAT_LOCAL || t == 0 ? 0 : eslSWAT_PROHIBIT); hc[0] = ESL_MAX(mc[0], ESL_MAX(xc[0], yc[0])); }
+      if (hi == t && t > 0) { mc[t] = (mode == eslSWAT_LOCAL ? 0 : eslSWAT_PROHIBIT);           hc[t] = ESL_MAX(mc[t], ESL_MAX(xc[t], yc[t])); }
+
+      if (mode == eslSWAT_GLOBAL)
+	{
+	  if (t == Mi + Lj) { best = hc[Mi]; bi = Mi; bj = Lj; }
+	}
+      else if (lo <= hi)
+	{
+	  for (v = mc[lo], i = lo+1; i <= hi; i++) v = ESL_MAX(v, mc[i]);
+	  if (v > best)
+	    {
+	      for (i = lo; mc[i] != v; i++) ;
+	      best = v; bi = i; bj = t - i;
+	    }
+	}
+
+      if (mode == eslSWAT_EXTEND)
+	{
+	  thresh = best - xdrop;
+	  alive  = FALSE;
+	  for (i = lo; i <= hi; i++)
+	    if (hc[i] < thresh) mc[i] = xc[i] = yc[i] = hc[i] = eslSWAT_PROHIBIT;
+	    else                alive = TRUE;
+	  if (! alive && ! palive) break;
+	  palive = alive;
+	}
+
+      tmp = hpp; hpp = hp; hp = hc; hc = tmp;
+      tmp = mp;  mp  = mc; mc = tmp;
+      tmp = xp;  xp  = xc; xc = tmp;
+      tmp = yp;  yp  = yc; yc = tmp;
+    }
+  *ret_sc = best;
+
+ DONE:
+  if (opt_i) *opt_i = bi;
+  if (opt_j) *opt_j = bj;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+
+/*****************************************************************
+ * 7. ESL_SWAT_BATCH: scoring a query against many targets
+ *****************************************************************/
+
+/* Function:  esl_swat_batch_Create()
+ * Synopsis:  Create an engine to score a query against many targets.
+ *
+ * Purpose:   Create an engine for scoring query profile <prof>
+ *            against a database, given as a stream of
+ *            <ESL_SQ_BLOCK>s (<esl_swat_batch_ScoreBlock()>) or
+ *            <ESL_DSQDATA_CHUNK>s (<esl_swat_batch_ScoreChunk()>),
+ *            keeping the <K> best scores. <K> may be 0, if the
+ *            caller only wants the scores themselves.
+ *
+ *            <ncpu> worker threads are started, and persist until
+ *            the engine is destroyed. With <ncpu> 0, or without
+ *            POSIX threads, targets are scored in the caller's
+ *            thread.
+ *
+ *            Targets of length up to <bat->maxshort> (default
+ *            <eslSWAT_BATCH_MAXSHORT>) are scored several at a time,
+ *            one per vector lane; longer ones, one at a time with
+ *            the striped kernels. The caller may change
+ *            <bat->maxshort> between blocks; 0 turns inter-sequence
+ *            scoring off.
+ *
+ *            The engine keeps a pointer to <prof>, which the caller
+ *            must keep until the engine is destroyed.
+ *
+ * Returns:   ptr to the new engine.
+ *
+ * Throws:    <NULL> on allocation or thread creation failure.
+ */
+ESL_SWAT_BATCH *
+esl_swat_batch_Create(const ESL_SWAT_PROFILE *prof, int K, int ncpu)
+{
+  ESL_SWAT_BATCH *bat = NULL;
+  int             w;
+  int             status;
+
+#ifndef HAVE_PTHREAD
+  ncpu = 0;
+#endif
+
+  ESL_ALLOC(bat, sizeof(ESL_SWAT_BATCH));
+  bat->prof     = prof;
+  bat->ncpu     = ncpu;
+  bat->maxshort = eslSWAT_BATCH_MAXSHORT;
+  bat->ntargets = 0;
+  bat->K        = K;
+  bat->heap     = NULL;
+  bat->hit      = NULL;
+  bat->nhit     = 0;
+  bat->halloc   = 0;
+  bat->dsq      = NULL;
+  bat->M        = NULL;
+  bat->sc       = NULL;
+  bat->n        = 0;
+  bat->talloc   = 0;
+  bat->ws       = NULL;
+#ifdef HAVE_PTHREAD
+  bat->thr      = NULL;
+  bat->next     = 0;
+  bat->nbusy    = 0;
+  bat->block    = 0;
+  bat->done     = FALSE;
+  bat->status   = eslOK;
+#endif
+
+  if (K > 0)
+    {
+      if ((bat->heap = esl_heap_ICreate(eslHEAP_MIN)) == NULL) { status = eslEMEM; goto ERROR; }
+      ESL_ALLOC(bat->hit, sizeof(ESL_SWAT_HIT) * 2 * K);
+      bat->halloc = 2 * K;
+    }
+
+  ESL_ALLOC(bat->ws, sizeof(ESL_SWAT_WORKSPACE *) * (ncpu+1));
+  for (w = 0; w <= ncpu; w++) bat->ws[w] = NULL;
+  for (w = 0; w <= ncpu; w++)
+    {
+      if ((bat->ws[w] = esl_swat_workspace_Create())         == NULL)  { status = eslEMEM; goto ERROR; }
+      if ((status = esl_swat_workspace_Grow(bat->ws[w], prof)) != eslOK) goto ERROR;
+    }
+
+#ifdef HAVE_PTHREAD
+  if (ncpu > 0)
+    {
+      if (pthread_mutex_init(&bat->mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+      if (pthread_cond_init (&bat->cv,    NULL) != 0) { pthread_mutex_destroy(&bat->mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+      if ((bat->thr = esl_threads_Create(&swat_batch_thread)) == NULL) { status = eslEMEM; goto ERROR; }
+      for (w = 0; w < ncpu; w++)
+	if ((status = esl_threads_AddThread(bat->thr, bat)) != eslOK) goto ERROR;
+      esl_threads_WaitForStart(bat->thr);
+    }
+#endif
+  return bat;
+
+ ERROR:
+  esl_swat_batch_Destroy(bat);
+  return NULL;
+}
+
+
+/* Function:  esl_swat_batch_ScoreBlock()
+ * Synopsis:  Score a block of targets, from an <ESL_SQ_BLOCK>.
+ *
+ * Purpose:   Score all <sqblock->count> digital sequences in
+ *            <sqblock> against the batch's query, and update its
+ *            top hits. If <opt_sc> is non-<NULL>, also return the
+ *            scores in <opt_sc[0..sqblock->count-1]>, allocated by
+ *            the caller.
+ *
+ *            The targets are numbered, for <esl_swat_batch_GetTopHits()>,
+ *            in the order the batch sees them: the first target of
+ *            this block is number <bat->ntargets> before the call.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <sqblock> isn't digital.
+ *            <eslEMEM> on allocation failure; <eslESYS> on a thread
+ *            failure. The block's scores are then undefined.
+ */
+int
+esl_swat_batch_ScoreBlock(ESL_SWAT_BATCH *bat, const ESL_SQ_BLOCK *sqblock, int *opt_sc)
+{
+  int i;
+  int status;
+
+  if ((status = swat_batch_grow(bat, sqblock->count)) != eslOK) return status;
+  for (i = 0; i < sqblock->count; i++)
+    {
+      if (sqblock->list[i].dsq == NULL) ESL_EXCEPTION(eslEINVAL, "sequence block must be digital");
+      bat->dsq[i] = sqblock->list[i].dsq;
+      bat->M[i]   = (int) sqblock->list[i].n;
+    }
+  bat->n = sqblock->count;
+  return swat_batch_score(bat, opt_sc);
+}
+
+
+/* Function:  esl_swat_batch_ScoreChunk()
+ * Synopsis:  Score a block of targets, from an <ESL_DSQDATA_CHUNK>.
+ *
+ * Purpose:   Same as <esl_swat_batch_ScoreBlock()>, for the
+ *            <chu->N> sequences in <ESL_DSQDATA> chunk <chu>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> on a thread
+ *            failure.
+ */
+int
+esl_swat_batch_ScoreChunk(ESL_SWAT_BATCH *bat, const ESL_DSQDATA_CHUNK *chu, int *opt_sc)
+{
+  int i;
+  int status;
+
+  if ((status = swat_batch_grow(bat, chu->N)) != eslOK) return status;
+  for (i = 0; i < chu->N; i++)
+    {
+      bat->dsq[i] = chu->dsq[i];
+      bat->M[i]   = (int) chu->L[i];
+    }
+  bat->n = chu->N;
+  return swat_batch_score(bat, opt_sc);
+}
+
+
+/* Function:  esl_swat_batch_GetTopHits()
+ * Synopsis:  Get the top K hits scored so far.
+ *
+ * Purpose:   Copy the best <K> hits the batch has scored so far (or
+ *            all of them, if fewer than <K> targets have been
+ *            scored) into <hit>, allocated by the caller for at least
+ *            <bat->K> hits, best score first. Ties are broken in
+ *            favor of the lowest target index. Return the number of
+ *            hits in <*ret_n>.
+ *
+ *            The batch may continue scoring more targets after this.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_swat_batch_GetTopHits(ESL_SWAT_BATCH *bat, ESL_SWAT_HIT *hit, int *ret_n)
+{
+  swat_batch_compact(bat);
+  if (bat->nhit) memcpy(hit, bat->hit, sizeof(ESL_SWAT_HIT) * bat->nhit);
+  *ret_n = bat->nhit;
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_batch_Reuse()
+ * Synopsis:  Reinitialize a batch, to score a new database.
+ *
+ * Purpose:   Forget all scores and top hits, and restart target
+ *            numbering at 0, keeping the query profile, the worker
+ *            threads, and all allocations.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_swat_batch_Reuse(ESL_SWAT_BATCH *bat)
+{
+  bat->ntargets = 0;
+  bat->nhit     = 0;
+  bat->n        = 0;
+  if (bat->heap) esl_heap_Reuse(bat->heap);
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_batch_Destroy()
+ * Synopsis:  Stop the worker threads and free an <ESL_SWAT_BATCH>.
+ */
+void
+esl_swat_batch_Destroy(ESL_SWAT_BATCH *bat)
+{
+  int w;
+
+  if (bat)
+    {
+#ifdef HAVE_PTHREAD
+      if (bat->thr)
+	{
+	  pthread_mutex_lock(&bat->mutex);
+	  bat->done = TRUE;
+	  pthread_cond_broadcast(&bat->cv);
+	  pthread_mutex_unlock(&bat->mutex);
+	  esl_threads_WaitForFinish(bat->thr);
+	  esl_threads_Destroy(bat->thr);
+	  pthread_cond_destroy(&bat->cv);
+	  pthread_mutex_destroy(&bat->mutex);
+	}
+#endif
+      if (bat->ws)
+	for (w = 0; w <= bat->ncpu; w++) esl_swat_workspace_Destroy(bat->ws[w]);
+      free(bat->ws);
+      free(bat->dsq);
+      free(bat->M);
+      free(bat->sc);
+      free(bat->hit);
+      esl_heap_Destroy(bat->heap);
+      free(bat);
+    }
+}
+
+
+/* swat_batch_grow()
+ * Make room for <n> targets in the batch's current block.
+ */
+static int
+swat_batch_grow(ESL_SWAT_BATCH *bat, int n)
+{
+  int status;
+
+  if (n > bat->talloc)
+    {
+      ESL_REALLOC(bat->dsq, sizeof(ESL_DSQ *) * n);
+      ESL_REALLOC(bat->M,   sizeof(int)       * n);
+      ESL_REALLOC(bat->sc,  sizeof(int)       * n);
+      bat->talloc = n;
+    }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* swat_batch_score()
+ * Score the batch's current block of <bat->n> targets, by worker
+ * threads if there are any and the block is big enough to share;
+ * then update the top hits and target count, and copy the scores to
+ * <opt_sc>, if it's non-NULL.
+ */
+static int
+swat_batch_score(ESL_SWAT_BATCH *bat, int *opt_sc)
+{
+  int i;
+  int status;
+
+#ifdef HAVE_PTHREAD
+  if (bat->thr && bat->n > eslSWAT_BATCH_B)
+    {
+      pthread_mutex_lock(&bat->mutex);
+      bat->next   = 0;
+      bat->nbusy  = bat->ncpu;
+      bat->status = eslOK;
+      bat->block++;
+      pthread_cond_broadcast(&bat->cv);
+      while (bat->nbusy > 0) pthread_cond_wait(&bat->cv, &bat->mutex);
+      status = bat->status;
+      pthread_mutex_unlock(&bat->mutex);
+      if (status != eslOK) return status;
+    }
+  else
+#endif
+    {
+      if ((status = swat_batch_range(bat, bat->ws[bat->ncpu], 0, bat->n)) != eslOK) return status;
+    }
+
+  for (i = 0; i < bat->n; i++)
+    if ((status = swat_batch_hit(bat, bat->ntargets + i, bat->sc[i])) != eslOK) return status;
+  if (opt_sc) memcpy(opt_sc, bat->sc, sizeof(int) * bat->n);
+  bat->ntargets += bat->n;
+  return eslOK;
+}
+
+
+/* swat_batch_range()
+ * Score targets <i0..i1-1> of the current block, using workspace <ws>.
+ * Short targets are collected and scored a vector's worth at a time
+ * by an inter-sequence kernel, if the profile has one; scores that
+ * may have saturated its 16 bits are redone by the striped kernels.
+ */
+static int
+swat_batch_range(ESL_SWAT_BATCH *bat, ESL_SWAT_WORKSPACE *ws, int i0, int i1)
+{
+  const ESL_SWAT_PROFILE *prof = bat->prof;
+  int           (*kinter)(const ESL_SWAT_PROFILE *, const ESL_DSQ **, const int *, int, void *, int *) = NULL;
+  const ESL_DSQ  *y[64];
+  int             yM[64], ysc[64], yi[64];
+  int             lanes = 0;
+  int             i, k, n;
+  int             status;
+
+  if (prof->s16 && bat->maxshort > 0)
+    switch (prof->simd) {
+#ifdef eslENABLE_SSE
+    case eslSWAT_SSE:    kinter = esl_swat_inter16_sse;    lanes = 8;  break;
+#endif
+#ifdef eslENABLE_AVX
+    case eslSWAT_AVX:    kinter = esl_swat_inter16_avx;    lanes = 16; break;
+#endif
+#ifdef eslENABLE_AVX512
+    case eslSWAT_AVX512: kinter = esl_swat_inter16_avx512; lanes = 32; break;
+#endif
+    default: break;
+    }
+
+  for (i = i0, n = 0; i < i1; i++)
+    {
+      if (kinter && bat->M[i] <= bat->maxshort)
+	{
+	  y[n] = bat->dsq[i];  yM[n] = bat->M[i];  yi[n] = i;
+	  n++;
+	}
+      else if ((status = esl_swat_StripedScore(prof, bat->dsq[i], bat->M[i], ws, &(bat->sc[i]))) != eslOK) return status;
+
+      if (n > 0 && (n == lanes || i == i1-1))
+	{
+	  (*kinter)(prof, y, yM, n, ws->dp, ysc);
+	  for (k = 0; k < n; k++)
+	    {
+	      if (ysc[k] < 32767) bat->sc[yi[k]] = ysc[k];
+	      else if ((status = esl_swat_StripedScore(prof, y[k], yM[k], ws, &(bat->sc[yi[k]]))) != eslOK) return status;
+	    }
+	  n = 0;
+	}
+    }
+  return eslOK;
+}
+
+
+/* swat_batch_hit()
+ * Consider target number <idx>, with score <sc>, for the top K.
+ * The heap holds the K best scores so far; a target gets into the
+ * candidate list if it beats or ties the worst of them. When the
+ * list fills, it's sorted and cut back to K.
+ */
+static int
+swat_batch_hit(ESL_SWAT_BATCH *bat, int64_t idx, int sc)
+{
+  int status;
+
+  if (bat->K == 0) return eslOK;
+
+  if (esl_heap_GetCount(bat->heap) < bat->K)
+    {
+      if ((status = esl_heap_IInsert(bat->heap, sc)) != eslOK) return status;
+    }
+  else if (sc > esl_heap_IGetTopVal(bat->heap))
+    {
+      esl_heap_IExtractTop(bat->heap, NULL);
+      if ((status = esl_heap_IInsert(bat->heap, sc)) != eslOK) return status;
+    }
+  else if (sc < esl_heap_IGetTopVal(bat->heap)) return eslOK;
+
+  if (bat->nhit == bat->halloc) swat_batch_compact(bat);
+  bat->hit[bat->nhit].idx = idx;
+  bat->hit[bat->nhit].sc  = sc;
+  bat->nhit++;
+  return eslOK;
+}
+
+static int
+swat_hit_sorter(const void *v1, const void *v2)
+{
+  const ESL_SWAT_HIT *h1 = (const ESL_SWAT_HIT *) v1;
+  const ESL_SWAT_HIT *h2 = (const ESL_SWAT_HIT *) v2;
+
+  if      (h1->sc  > h2->sc)  return -1;
+  else if (h1->sc  < h2->sc)  return  1;
+  else if (h1->idx < h2->idx) return -1;
+  else if (h1->idx > h2->idx) return  1;
+  else                        return  0;
+}
+
+/* swat_batch_compact()
+ * Sort the top-K candidates, best first, and keep only the top K.
+ */
+static void
+swat_batch_compact(ESL_SWAT_BATCH *bat)
+{
+  if (bat->nhit > 1) qsort(bat->hit, bat->nhit, sizeof(ESL_SWAT_HIT), swat_hit_sorter);
+  bat->nhit = ESL_MIN(bat->nhit, bat->K);
+}
+
+
+#ifdef HAVE_PTHREAD
+/* swat_batch_thread()
+ * A worker: waits for a new block, then takes eslSWAT_BATCH_B targets
+ * at a time from it until it's all taken.
+ */
+static void
+swat_batch_thread(void *arg)
+{
+  ESL_THREADS    *thr  = (ESL_THREADS *) arg;
+  ESL_SWAT_BATCH *bat;
+  int             w, i0, i1, status;
+  int             seen = 0;
+
+  esl_threads_Started(thr, &w);
+  bat = (ESL_SWAT_BATCH *) esl_threads_GetData(thr, w);
+
+  pthread_mutex_lock(&bat->mutex);
+  while (1)
+    {
+      while (bat->block == seen && ! bat->done) pthread_cond_wait(&bat->cv, &bat->mutex);
+      if (bat->done) break;
+      seen = bat->block;
+
+      while (bat->next < bat->n && bat->status == eslOK)
+	{
+	  i0        = bat->next;
+	  i1        = ESL_MIN(bat->n, i0 + eslSWAT_BATCH_B);
+	  bat->next = i1;
+	  pthread_mutex_unlock(&bat->mutex);
+	  status = swat_batch_range(bat, bat->ws[w], i0, i1);
+	  pthread_mutex_lock(&bat->mutex);
+	  if (status != eslOK && bat->status == eslOK) bat->status = status;
+	}
+      if (--bat->nbusy == 0) pthread_cond_broadcast(&bat->cv);
+    }
+  pthread_mutex_unlock(&bat->mutex);
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+
+
+/*****************************************************************
+ * 8. Stats driver
+ *****************************************************************/
+
+/* 
+    gcc -I. -L. -g -Wall -DeslSWAT_STATS -o stats esl_swat.c -leasel -lm 
+    ./stats
+*/
+#ifdef eslSWAT_STATS
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_fileparser.h"
+#include "esl_scorematrix.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_histogram.h"
+
+int
+main(int argc, char **argv)
+{
+  int status;
+  ESL_RANDOMNESS  *r   = esl_randomness_Create(0);
+  ESL_ALPHABET    *abc = esl_alphabet_Create(eslAMINO);
+  ESL_SCOREMATRIX *S   = NULL;
+  ESL_DSQ         *x   = NULL;	/* iid query */
+  ESL_DSQ         *y   = NULL;	/* iid target */
+  ESL_SWAT_PROFILE   *prof = NULL;
+  ESL_SWAT_WORKSPACE *ws   = NULL;
+  double    lambda;
+  double    bg[20];		/* iid background probabilities */
+  int       L;			/* query length */
+  int       M;			/* target length */
+  int       nseq;		/* number of target seqs to simulate */
+  int       i;
+  int       gop; 
+  int       gex;
+  char     *mxfile     = "PMX";
+  int       raw_sc;
+
+  /* Configuration 
+   */
+  L = 400;			/* query length */
+  M = 400;			/* target length */
+  nseq = 50000;
+  gop = -11;
+  gex = -1;
+  lambda = 0.3207;
+
+  ESL_ALLOC(x, sizeof(ESL_DSQ) * (L+2));
+  ESL_ALLOC(y, sizeof(ESL_DSQ) * (M+2));
+
+  /* Input an amino acid score matrix from a file. */
+  if (mxfile != NULL) {
+    ESL_FILEPARSER  *efp = NULL;
+    if ( esl_fileparser_Open(mxfile, NULL, &efp)  != eslOK) esl_fatal("failed to open score file %s", mxfile);
+    if ( esl_scorematrix_Read(efp, abc, &S)               != eslOK) esl_fatal("failed to read matrix from %s", mxfile);
+    esl_fileparser_Close(efp);
+  } else {			/* default = BLOSUM62 */
+    S = esl_scorematrix_Create(abc);
+    esl_scorematrix_Set("BLOSUM62", S);
+  }
+  esl_composition_BL62(bg);
+
+  esl_rsq_xIID(r, bg, 20, L, x);
+  if ((prof = esl_swat_profile_Create(S, x, L, gop, gex)) == NULL) esl_fatal("failed to create query profile");
+  if ((ws   = esl_swat_workspace_Create())                == NULL) esl_fatal("failed to create workspace");
+  
+  for (i = 0; i < nseq; i++)
+    {
+      esl_rsq_xIID(r, bg, 20, M, y);
+      esl_swat_StripedScore(prof, y, M, ws, &raw_sc);
+      printf("%d\n", raw_sc);
+    }
+  
+  esl_swat_workspace_Destroy(ws);
+  esl_swat_profile_Destroy(prof);
+  free(x);
+  free(y);
+  esl_scorematrix_Destroy(S);
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(r);
+  exit(0);
+
+ ERROR:
+  exit(status);
+}
+  
+  
+
+
+
+
+#endif /*eslSWAT_STATS*/
+
+
+/*****************************************************************
+ * 9. Benchmark driver
+ *****************************************************************/
+#ifdef eslSWAT_BENCHMARK
+/* 
+   gcc -O3 -I. -L. -o esl_swat_benchmark -DeslSWAT_BENCHMARK esl_swat.c -leasel -lm
+   ./esl_swat_benchmark
+ */
+#include "esl_config.h"
+
+#include <stdio.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_composition.h"
+#include "esl_dsqdata.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_scorematrix.h"
+#include "esl_stopwatch.h"
+
+#include "esl_swat.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-L",        eslARG_INT,    "400",  NULL,"n>0",  NULL,  NULL, NULL, "length of query",                                  0 },
+  { "-M",        eslARG_INT,    "400",  NULL,"n>0",  NULL,  NULL, NULL, "length of targets",                                0 },
+  { "-N",        eslARG_INT,   "2000",  NULL,"n>0",  NULL,  NULL, NULL, "number of targets",                                0 },
+  { "--cpu",     eslARG_INT,      "0",  NULL,"n>=0", NULL,  NULL, NULL, "number of worker threads for batch scoring",       0 },
+  { "--maxshort",eslARG_INT,     NULL,  NULL,"n>=0", NULL,  NULL, NULL, "set batch's max inter-sequence target length to <n>", 0 },
+  { "-w",        eslARG_INT,     "16",  NULL,"n>=0", NULL,  NULL, NULL, "band half-width for banded scoring",               0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "benchmark driver for Smith/Waterman module";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS      *go   = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS   *rng  = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET     *abc  = esl_alphabet_Create(eslAMINO);
+  ESL_SCOREMATRIX  *S    = esl_scorematrix_Create(abc);
+  ESL_STOPWATCH    *w    = esl_stopwatch_Create();
+  ESL_SWAT_PROFILE *prof = NULL;
+  ESL_SWAT_WORKSPACE *ws = esl_swat_workspace_Create();
+  ESL_SWAT_BATCH   *bat  = NULL;
+  ESL_SWAT_ALI     *ali  = NULL;
+  ESL_DSQDATA_CHUNK chu;
+  int               L    = esl_opt_GetInteger(go, "-L");
+  int               M    = esl_opt_GetInteger(go, "-M");
+  int               N    = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ          *x    = malloc(sizeof(ESL_DSQ) * (L+2));
+  ESL_DSQ         **y    = malloc(sizeof(ESL_DSQ *) * N);
+  double            bg[20];
+  double            ncells = (double) L * (double) M * (double) N;
+  int64_t           sum1 = 0, sum2 = 0, sum3 = 0, sum4 = 0;
+  int              *sc3;
+  int               i, sc;
+
+  esl_scorematrix_Set("BLOSUM62", S);
+  esl_composition_BL62(bg);
+  esl_rsq_xIID(rng, bg, 20, L, x);
+  for (i = 0; i < N; i++)
+    {
+      y[i] = malloc(sizeof(ESL_DSQ) * (M+2));
+      esl_rsq_xIID(rng, bg, 20, M, y[i]);
+    }
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) { esl_swat_Score(x, L, y[i], M, S, -11, -1, &sc); sum1 += sc; }
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# reference: ");
+  printf("# reference: %.1f Mcells/s\n", ncells / 1e6 / w->elapsed);
+
+  esl_stopwatch_Start(w);
+  prof = esl_swat_profile_Create(S, x, L, -11, -1);
+  for (i = 0; i < N; i++) { esl_swat_StripedScore(prof, y[i], M, ws, &sc); sum2 += sc; }
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# striped:   ");
+  printf("# striped:   %.1f Mcells/s (simd %d)\n", ncells / 1e6 / w->elapsed, prof->simd);
+
+  chu.N   = N;
+  chu.dsq = y;
+  chu.L   = malloc(sizeof(int64_t) * N);
+  sc3     = malloc(sizeof(int)     * N);
+  for (i = 0; i < N; i++) chu.L[i] = M;
+
+  esl_stopwatch_Start(w);
+  bat = esl_swat_batch_Create(prof, 10, esl_opt_GetInteger(go, "--cpu"));
+  if (esl_opt_IsOn(go, "--maxshort")) bat->maxshort = esl_opt_GetInteger(go, "--maxshort");
+  esl_swat_batch_ScoreChunk(bat, &chu, sc3);
+  for (i = 0; i < N; i++) sum3 += sc3[i];
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# batch:     ");
+  printf("# batch:     %.1f Mcells/s\n", ncells / 1e6 / w->elapsed);
+
+  esl_stopwatch_Start(w);
+  ali = esl_swat_ali_Create();
+  for (i = 0; i < N; i++) { esl_swat_Align(prof, y[i], M, ws, ali); sum4 += ali->sc; }
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# align:     ");
+  printf("# align:     %.1f Mcells/s\n", ncells / 1e6 / w->elapsed);
+
+  if (sum1 != sum2 || sum1 != sum3 || sum1 != sum4) esl_fatal("scores differ");
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) esl_swat_BandedScore(prof, y[i], M, 0, esl_opt_GetInteger(go, "-w"), eslSWAT_LOCAL, ws, &sc);
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# banded:    ");
+  printf("# banded:    %.1f Mcells/s, in full-matrix cells\n", ncells / 1e6 / w->elapsed);
+
+  esl_swat_ali_Destroy(ali);
+  esl_swat_batch_Destroy(bat);
+  free(chu.L);
+  free(sc3);
+
+  for (i = 0; i < N; i++) free(y[i]);
+  free(y);
+  free(x);
+  esl_swat_profile_Destroy(prof);
+  esl_swat_workspace_Destroy(ws);
+  esl_stopwatch_Destroy(w);
+  esl_scorematrix_Destroy(S);
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*eslSWAT_BENCHMARK*/
+
+
+
+/*****************************************************************
+ * 10. Unit tests
+ *****************************************************************/
+#ifdef eslSWAT_TESTDRIVE
+
+#include <ctype.h>
+
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* swat_is_available()
+ * TRUE if we can run the <simd> implementation on this processor.
+ */
+static int
+swat_is_available(int simd)
+{
+  switch (simd) {
+  case eslSWAT_SERIAL: return TRUE;
+  case eslSWAT_SSE:    return esl_cpu_has_sse();
+  case eslSWAT_AVX:    return esl_cpu_has_avx();
+  case eslSWAT_AVX512: return esl_cpu_has_avx512();
+  }
+  return FALSE;
+}
+
+/* utest_Score()
+ * Two hand-calculated BLOSUM62 scores, for the reference and for
+ * each striped implementation: an ungapped self-score, and an
+ * alignment that has to take a 5-residue gap.
+ */
+static void
+utest_Score(ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char              msg[] = "esl_swat_Score unit test failed";
+  char             *s1[2] = { "ACDEFGHIKLMNPQRSTVWY", "WWWWWCCCCCWWWWW" };
+  char             *s2[2] = { "ACDEFGHIKLMNPQRSTVWY", "WWWWWWWWWW"      };
+  int               expect[2] = { 116, 95 };
+  ESL_DSQ          *x     = NULL;
+  ESL_DSQ          *y     = NULL;
+  ESL_SWAT_PROFILE *prof  = NULL;
+  int               L, M, t, simd, sc;
+
+  for (t = 0; t < 2; t++)
+    {
+      L = strlen(s1[t]);
+      M = strlen(s2[t]);
+      if (esl_abc_CreateDsq(abc, s1[t], &x)              != eslOK) esl_fatal(msg);
+      if (esl_abc_CreateDsq(abc, s2[t], &y)              != eslOK) esl_fatal(msg);
+      if (esl_swat_Score(x, L, y, M, S, -11, -1, &sc)   != eslOK) esl_fatal(msg);
+      if (sc != expect[t])                                          esl_fatal(msg);
+
+      for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+	if (swat_is_available(simd))
+	  {
+	    if ((prof = swat_profile_create(S, x, L, -11, -1, simd)) == NULL) esl_fatal(msg);
+	    if (esl_swat_StripedScore(prof, y, M, NULL, &sc) != eslOK)         esl_fatal(msg);
+	    if (sc != expect[t])                                               esl_fatal(msg);
+	    esl_swat_profile_Destroy(prof);
+	  }
+      free(x);
+      free(y);
+    }
+}
+
+/* sample_seq(), sample_homolog()
+ * Random digital seqs, with occasional degenerate residues; and
+ * homologs of them, with substitutions and indels.
+ */
+static void
+sample_seq(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, int L, ESL_DSQ *x)
+{
+  int j;
+
+  x[0] = x[L+1] = eslDSQ_SENTINEL;
+  for (j = 1; j <= L; j++)
+    x[j] = (esl_rnd_Roll(rng, 20) ? esl_rnd_Roll(rng, abc->K) : abc->K + 1 + esl_rnd_Roll(rng, abc->Kp - abc->K - 3));
+}
+
+static int
+sample_homolog(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, const ESL_DSQ *x, int L, ESL_DSQ *y, int maxM)
+{
+  int i = 0, j = 1;
+  int r;
+
+  y[0] = eslDSQ_SENTINEL;
+  while (j <= L && i < maxM)
+    {
+      r = esl_rnd_Roll(rng, 100);
+      if      (r < 4)  j++;                                       // deletion
+      else if (r < 8)  y[++i] = esl_rnd_Roll(rng, abc->K);        // insertion
+      else if (r < 20) { y[++i] = esl_rnd_Roll(rng, abc->K); j++; }
+      else             { y[++i] = x[j++]; }
+    }
+  y[i+1] = eslDSQ_SENTINEL;
+  return i;
+}
+
+/* utest_striped()
+ * Each striped implementation the processor supports must give the
+ * same score as esl_swat_Score(), for random and homologous pairs of
+ * many lengths (including ones shorter than a vector, and exact
+ * multiples of the stripe widths), random gap scores, and scores
+ * that overflow 8- and 16-bit widths.
+ */
+static void
+utest_striped(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char              msg[]  = "striped Smith/Waterman unit test failed";
+  ESL_SCOREMATRIX  *S4     = esl_scorematrix_Clone(S);
+  ESL_SWAT_PROFILE *prof   = NULL;
+  ESL_SWAT_WORKSPACE *ws   = esl_swat_workspace_Create();
+  ESL_DSQ          *x      = NULL;
+  ESL_DSQ          *y      = NULL;
+  int               maxL   = 2000;
+  int               ntrials = 200;
+  int               Lset[] = { 1, 2, 15, 16, 17, 31, 32, 33, 64, 65, 128, 129 };
+  int               nL     = sizeof(Lset) / sizeof(int);
+  int               t, L, M, gop, gex, simd, a, b;
+  int               sc0, sc;
+  int               saw8 = FALSE, saw16 = FALSE, saw32 = FALSE;
+  int               status;
+
+  ESL_ALLOC(x, sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(y, sizeof(ESL_DSQ) * (maxL+2));
+  for (a = 0; a < S4->Kp; a++)
+    for (b = 0; b < S4->Kp; b++)
+      S4->s[a][b] *= 4;
+
+  for (t = 0; t < ntrials + 4; t++)
+    {
+      gop = -1 - esl_rnd_Roll(rng, 15);
+      gex = -1 - esl_rnd_Roll(rng, 5);
+      if (t < ntrials)
+	{
+	  L = (t < nL ? Lset[t] : 1 + esl_rnd_Roll(rng, 300));
+	  sample_seq(rng, abc, L, x);
+	  if (esl_rnd_Roll(rng, 2)) { M = 1 + esl_rnd_Roll(rng, 300); sample_seq(rng, abc, M, y); }
+	  else                        M = sample_homolog(rng, abc, x, L, y, maxL);
+	}
+      else /* long homologs: with S4, overflows 16 bits; gop -300 can't stripe 8 bits */
+	{
+	  L = maxL;
+	  sample_seq(rng, abc, L, x);
+	  M = sample_homolog(rng, abc, x, L, y, maxL);
+	  if (t == ntrials + 3) gop = -300;
+	}
+      if (M == 0) continue;
+
+      if (esl_swat_Score(x, L, y, M, (t < ntrials ? S : S4), gop, gex, &sc0) != eslOK) esl_fatal(msg);
+      if      (sc0 >= 32767)      saw32 = TRUE;
+      else if (sc0 >= 255 - 16)   saw16 = TRUE;
+      else                        saw8  = TRUE;
+
+      for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+	if (swat_is_available(simd))
+	  {
+	    if ((prof = swat_profile_create((t < ntrials ? S : S4), x, L, gop, gex, simd)) == NULL) esl_fatal(msg);
+	    if (simd != eslSWAT_SERIAL && (prof->Q16 == 0 || prof->Q32 == 0))                      esl_fatal(msg);
+	    if (simd != eslSWAT_SERIAL && (prof->Q8 == 0) != (gop == -300))                         esl_fatal(msg);
+	    if (esl_swat_StripedScore(prof, y, M, ws, &sc) != eslOK)                               esl_fatal(msg);
+	    if (sc != sc0)                                                                          esl_fatal("%s: simd %d, L=%d M=%d gop=%d gex=%d: %d != %d", msg, simd, L, M, gop, gex, sc, sc0);
+	    esl_swat_profile_Destroy(prof);
+	  }
+    }
+  if (! saw8 || ! saw16 || ! saw32) esl_fatal(msg);
+
+  free(x);
+  free(y);
+  esl_swat_workspace_Destroy(ws);
+  esl_scorematrix_Destroy(S4);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+/* utest_workspace()
+ * A workspace grows to fit the largest profile it's used with, and
+ * after that, scoring against that profile or smaller ones reuses
+ * its memory without reallocating it.
+ */
+static void
+utest_workspace(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char                msg[] = "esl_swat workspace unit test failed";
+  ESL_SWAT_WORKSPACE *ws    = esl_swat_workspace_Create();
+  ESL_SWAT_PROFILE   *prof  = NULL;
+  ESL_DSQ            *x     = NULL;
+  ESL_DSQ            *y     = NULL;
+  int                 maxL  = 500;
+  int                 ntrials = 50;
+  void               *dp;
+  int                *rows;
+  size_t              n;
+  int                 t, L, M, simd, sc0, sc;
+  int                 status;
+
+  ESL_ALLOC(x, sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(y, sizeof(ESL_DSQ) * (maxL+2));
+  if (ws == NULL) esl_fatal(msg);
+
+  for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+    if (swat_is_available(simd))
+      {
+	sample_seq(rng, abc, maxL, x);
+	if ((prof = swat_profile_create(S, x, maxL, -11, -1, simd)) == NULL) esl_fatal(msg);
+	if (esl_swat_workspace_Grow(ws, prof) != eslOK)                     esl_fatal(msg);
+	esl_swat_profile_Destroy(prof);
+      }
+  dp   = ws->dp;
+  rows = ws->rows;
+  n    = esl_swat_workspace_Sizeof(ws);
+  if (n <= sizeof(ESL_SWAT_WORKSPACE)) esl_fatal(msg);
+
+  for (t = 0; t < ntrials; t++)
+    {
+      L = 1 + esl_rnd_Roll(rng, maxL);
+      M = 1 + esl_rnd_Roll(rng, maxL);
+      sample_seq(rng, abc, L, x);
+      sample_seq(rng, abc, M, y);
+      if (esl_swat_Score(x, L, y, M, S, -11, -1, &sc0) != eslOK) esl_fatal(msg);
+
+      for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+	if (swat_is_available(simd))
+	  {
+	    if ((prof = swat_profile_create(S, x, L, -11, -1, simd)) == NULL) esl_fatal(msg);
+	    if (esl_swat_StripedScore(prof, y, M, ws, &sc) != eslOK)        esl_fatal(msg);
+	    if (sc != sc0)                                                   esl_fatal(msg);
+	    esl_swat_profile_Destroy(prof);
+	  }
+    }
+  if (ws->dp != dp || ws->rows != rows)        esl_fatal(msg);
+  if (esl_swat_workspace_Sizeof(ws) != n)      esl_fatal(msg);
+
+  free(x);
+  free(y);
+  esl_swat_workspace_Destroy(ws);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+/* utest_align()
+ * Alignments from esl_swat_Align(), in each implementation, have the
+ * same score as esl_swat_Score(); their paths rescore to it, agree
+ * with their coordinates and CIGAR strings, and are the same path
+ * in every implementation.
+ */
+static void
+utest_align(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char                msg[]   = "Smith/Waterman alignment unit test failed";
+  ESL_SCOREMATRIX    *S4      = esl_scorematrix_Clone(S);
+  ESL_SCOREMATRIX    *Su      = NULL;
+  ESL_SWAT_PROFILE   *prof    = NULL;
+  ESL_SWAT_WORKSPACE *ws      = esl_swat_workspace_Create();
+  ESL_SWAT_ALI       *ali     = esl_swat_ali_Create();
+  ESL_DSQ            *x       = NULL;
+  ESL_DSQ            *y       = NULL;
+  char               *cigar0  = NULL;
+  int                 maxL    = 1000;
+  int                 ntrials = 100;
+  int                 t, L, M, gop, gex, simd, a, b;
+  int                 i, j, k, n, sc0, sc, len;
+  char               *s;
+  int                 status;
+
+  ESL_ALLOC(x,      sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(y,      sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(cigar0, sizeof(char)    * (4 * maxL + 1));
+  for (a = 0; a < S4->Kp; a++)
+    for (b = 0; b < S4->Kp; b++)
+      S4->s[a][b] *= 4;
+
+  for (t = 0; t < ntrials; t++)
+    {
+      Su  = (t < ntrials-2 ? S : S4);
+      gop = -1 - esl_rnd_Roll(rng, 15);
+      gex = -1 - esl_rnd_Roll(rng, 5);
+      L   = (t < ntrials-2 ? 1 + esl_rnd_Roll(rng, 200) : maxL);
+      sample_seq(rng, abc, L, x);
+      if (t % 4 == 0) { M = 1 + esl_rnd_Roll(rng, 200); sample_seq(rng, abc, M, y); }
+      else              M = sample_homolog(rng, abc, x, L, y, maxL);
+      if (M == 0) continue;
+      if (esl_swat_Score(x, L, y, M, Su, gop, gex, &sc0) != eslOK) esl_fatal(msg);
+
+      for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+	if (swat_is_available(simd))
+	  {
+	    if ((prof = swat_profile_create(Su, x, L, gop, gex, simd)) == NULL) esl_fatal(msg);
+	    if (esl_swat_Align(prof, y, M, (t % 2 ? ws : NULL), ali)  != eslOK) esl_fatal(msg);
+	    if (ali->sc != sc0) esl_fatal("%s: simd %d, L=%d M=%d: %d != %d", msg, simd, L, M, ali->sc, sc0);
+
+	    if (sc0 == 0)
+	      {
+		if (ali->n || ali->qfrom || ali->qto || ali->tfrom || ali->tto || ali->cigar[0]) esl_fatal(msg);
+	      }
+	    else
+	      {
+		if (ali->qfrom < 1 || ali->qto > L || ali->qfrom > ali->qto) esl_fatal(msg);
+		if (ali->tfrom < 1 || ali->tto > M || ali->tfrom > ali->tto) esl_fatal(msg);
+		if (ali->path[0] != 'M' || ali->path[ali->n-1] != 'M')     esl_fatal(msg);
+		if (strlen(ali->path) != ali->n)                             esl_fatal(msg);
+
+		/* walk the path, rescoring it */
+		i  = ali->tfrom;
+		j  = ali->qfrom;
+		sc = Su->s[x[j]][y[i]];
+		for (k = 1; k < ali->n; k++)
+		  switch (ali->path[k]) {
+		  case 'M': i++; j++; sc += Su->s[x[j]][y[i]];                      break;
+		  case 'I': j++;      sc += (ali->path[k-1] == 'I' ? gex : gop);
+		                      if (ali->path[k-1] == 'D') esl_fatal(msg);
+		                      break;
+		  case 'D': i++;      sc += (ali->path[k-1] == 'D' ? gex : gop);
+		                      if (ali->path[k-1] == 'I') esl_fatal(msg);
+		                      break;
+		  default:  esl_fatal(msg);
+		  }
+		if (i != ali->tto || j != ali->qto) esl_fatal(msg);
+		if (sc != sc0)                       esl_fatal("%s: simd %d, path rescores to %d, not %d", msg, simd, sc, sc0);
+
+		/* the CIGAR string is the path */
+		for (s = ali->cigar, k = 0; *s; s++)
+		  {
+		    for (len = 0; isdigit(*s); s++) len = len * 10 + (*s - '0');
+		    for (n = 0; n < len; n++, k++)
+		      if (k >= ali->n || ali->path[k] != *s) esl_fatal(msg);
+		    if (len == 0 || (*s != 'M' && *s != 'I' && *s != 'D')) esl_fatal(msg);
+		  }
+		if (k != ali->n) esl_fatal(msg);
+	      }
+
+	    if (simd == eslSWAT_SERIAL) strcpy(cigar0, ali->cigar);
+	    else if (strcmp(cigar0, ali->cigar) != 0) esl_fatal("%s: simd %d path differs from serial", msg, simd);
+	    esl_swat_profile_Destroy(prof);
+	  }
+    }
+
+  free(cigar0);
+  free(x);
+  free(y);
+  esl_swat_ali_Destroy(ali);
+  esl_swat_workspace_Destroy(ws);
+  esl_scorematrix_Destroy(S4);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+
+/* band_oracle()
+ * Full O(LM) version of swat_band()'s recursions, with cells off
+ * diagonals <dlo..dhi> prohibited: the banded scores by brute force.
+ */
+static int
+band_oracle(const ESL_DSQ *x, int L, const ESL_DSQ *y, int M, const ESL_SCOREMATRIX *S, int gop, int gex, int dlo, int dhi, int mode)
+{
+  int  NEG  = eslSWAT_PROHIBIT;
+  int *mx   = malloc(sizeof(int) * 3 * (L+1) * (M+1));
+  int *ix   = mx + (L+1) * (M+1);
+  int *iy   = ix + (L+1) * (M+1);
+  int  best = (mode == eslSWAT_GLOBAL ? NEG : 0);
+  int  i, j, c, h;
+
+  for (i = 0; i <= M; i++)
+    for (j = 0; j <= L; j++)
+      {
+	c = i * (L+1) + j;
+	mx[c] = ix[c] = iy[c] = NEG;
+	if (j - i < dlo || j - i > dhi) continue;
+
+	if (i == 0 || j == 0) mx[c] = (mode == eslSWAT_LOCAL || (i == 0 && j == 0) ? 0 : NEG);
+	else
+	  {
+	    h = ESL_MAX(mx[c-L-2], ESL_MAX(ix[c-L-2], iy[c-L-2]));
+	    if (mode == eslSWAT_LOCAL) h = ESL_MAX(h, 0);
+	    if (h > NEG) mx[c] = h + S->s[x[j]][y[i]];
+	  }
+	if (j > 0 && ESL_MAX(mx[c-1], ix[c-1]) > NEG)          ix[c] = ESL_MAX(mx[c-1] + gop, ix[c-1] + gex);
+	if (i > 0 && ESL_MAX(mx[c-L-1], iy[c-L-1]) > NEG)      iy[c] = ESL_MAX(mx[c-L-1] + gop, iy[c-L-1] + gex);
+	if (mode != eslSWAT_GLOBAL && i > 0 && j > 0) best = ESL_MAX(best, mx[c]);
+      }
+  if (mode == eslSWAT_GLOBAL)
+    {
+      c    = M * (L+1) + L;
+      best = ESL_MAX(mx[c], ESL_MAX(ix[c], iy[c]));
+    }
+  free(mx);
+  return best;
+}
+
+/* utest_banded()
+ * esl_swat_BandedScore() and esl_swat_XDrop(), in each
+ * implementation, agree with brute force; and a band that covers
+ * every cell gives the same local score as esl_swat_Score().
+ */
+static void
+utest_banded(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char                msg[]   = "banded Smith/Waterman unit test failed";
+  ESL_SWAT_PROFILE   *prof    = NULL;
+  ESL_SWAT_WORKSPACE *ws      = esl_swat_workspace_Create();
+  ESL_DSQ            *x       = NULL;
+  ESL_DSQ            *y       = NULL;
+  ESL_DSQ            *xr      = NULL;
+  ESL_DSQ            *yr      = NULL;
+  int                 maxL    = 300;
+  int                 ntrials = 100;
+  int                 t, L, M, gop, gex, simd, d, w, gw, i0, j0, xdrop, k;
+  int                 sc0, sc, fsc, bsc, tfrom, tto, qfrom, qto;
+  int                 status;
+
+  ESL_ALLOC(x,  sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(y,  sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(xr, sizeof(ESL_DSQ) * (maxL+2));
+  ESL_ALLOC(yr, sizeof(ESL_DSQ) * (maxL+2));
+
+  for (t = 0; t < ntrials; t++)
+    {
+      gop = -1 - esl_rnd_Roll(rng, 15);
+      gex = -1 - esl_rnd_Roll(rng, 5);
+      L   = 1 + esl_rnd_Roll(rng, 150);
+      sample_seq(rng, abc, L, x);
+      if (t % 4 == 0) { M = 1 + esl_rnd_Roll(rng, 150); sample_seq(rng, abc, M, y); }
+      else              M = sample_homolog(rng, abc, x, L, y, maxL);
+      if (M == 0) continue;
+
+      d     = esl_rnd_Roll(rng, L+M+1) - M;     // any diagonal from -M..L
+      w     = esl_rnd_Roll(rng, 40);
+      i0    = 1 + esl_rnd_Roll(rng, M);
+      j0    = 1 + esl_rnd_Roll(rng, L);
+      xdrop = esl_rnd_Roll(rng, 60);
+
+      /* reversed prefixes before the seed, for the oracle's backward extension */
+      for (k = 1; k < i0; k++) yr[k] = y[i0-k];
+      for (k = 1; k < j0; k++) xr[k] = x[j0-k];
+
+      for (simd = eslSWAT_SERIAL; simd <= eslSWAT_AVX512; simd++)
+	if (swat_is_available(simd))
+	  {
+	    if ((prof = swat_profile_create(S, x, L, gop, gex, simd)) == NULL) esl_fatal(msg);
+
+	    /* local: full band; random band */
+	    if (esl_swat_Score(x, L, y, M, S, gop, gex, &sc0)                              != eslOK) esl_fatal(msg);
+	    if (esl_swat_BandedScore(prof, y, M, 0, ESL_MAX(L, M), eslSWAT_LOCAL, ws, &sc) != eslOK) esl_fatal(msg);
+	    if (sc != sc0) esl_fatal("%s: simd %d, full band local %d != %d", msg, simd, sc, sc0);
+	    if (esl_swat_BandedScore(prof, y, M, d, w, eslSWAT_LOCAL, (t % 2 ? ws : NULL), &sc) != eslOK) esl_fatal(msg);
+	    if (sc != band_oracle(x, L, y, M, S, gop, gex, d-w, d+w, eslSWAT_LOCAL)) esl_fatal("%s: simd %d, banded local", msg, simd);
+
+	    /* global: the narrowest band that holds both ends, plus w */
+	    gw = abs(L-M)/2 + 1 + w;
+	    if (esl_swat_BandedScore(prof, y, M, (L-M)/2, gw, eslSWAT_GLOBAL, ws, &sc) != eslOK) esl_fatal(msg);
+	    if (sc != band_oracle(x, L, y, M, S, gop, gex, (L-M)/2 - gw, (L-M)/2 + gw, eslSWAT_GLOBAL)) esl_fatal("%s: simd %d, banded global", msg, simd);
+
+	    /* X-drop: with no drop, it's two anchored extensions from the seed */
+	    if (esl_swat_XDrop(prof, y, M, i0, j0, w, 1000000, ws, &sc, &tfrom, &tto, &qfrom, &qto) != eslOK) esl_fatal(msg);
+	    fsc = band_oracle(x+j0, L-j0, y+i0, M-i0, S, gop, gex, -w, w, eslSWAT_EXTEND);
+	    bsc = band_oracle(xr,   j0-1, yr,   i0-1, S, gop, gex, -w, w, eslSWAT_EXTEND);
+	    if (sc != S->s[x[j0]][y[i0]] + fsc + bsc) esl_fatal("%s: simd %d, X-drop extension", msg, simd);
+	    if (tfrom < 1 || tfrom > i0 || tto < i0 || tto > M) esl_fatal(msg);
+	    if (qfrom < 1 || qfrom > j0 || qto < j0 || qto > L) esl_fatal(msg);
+
+	    /* with a drop, no better, and no worse than the seed */
+	    if (esl_swat_XDrop(prof, y, M, i0, j0, w, xdrop, NULL, &sc0, NULL, NULL, NULL, NULL) != eslOK) esl_fatal(msg);
+	    if (sc0 > sc || sc0 < S->s[x[j0]][y[i0]]) esl_fatal(msg);
+
+	    esl_swat_profile_Destroy(prof);
+	  }
+    }
+
+  free(x);
+  free(y);
+  free(xr);
+  free(yr);
+  esl_swat_workspace_Destroy(ws);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+
+/* utest_inter()
+ * Each inter-sequence kernel the processor supports gives the same
+ * scores as esl_swat_Score(), for any number of targets up to its
+ * number of lanes, of different lengths, including 0.
+ */
+static void
+utest_inter(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S)
+{
+  char                msg[]   = "inter-sequence Smith/Waterman unit test failed";
+  ESL_SWAT_WORKSPACE *ws      = esl_swat_workspace_Create();
+  ESL_SWAT_PROFILE   *prof    = NULL;
+  ESL_DSQ            *x       = NULL;
+  ESL_DSQ            *y[32];
+  int                 M[32], sc[32];
+  int                 maxL    = 150;
+  int                 ntrials = 20;
+  int                 lanes, simd, t, k, n, L, gop, gex, sc0;
+  int                 status;
+
+  ESL_ALLOC(x, sizeof(ESL_DSQ) * (maxL+2));
+  for (k = 0; k < 32; k++) y[k] = NULL;
+  for (k = 0; k < 32; k++) ESL_ALLOC(y[k], sizeof(ESL_DSQ) * (maxL+2));
+
+  for (simd = eslSWAT_SSE; simd <= eslSWAT_AVX512; simd++)
+    {
+      if (! swat_is_available(simd)) continue;
+      lanes = (simd == eslSWAT_AVX512 ? 32 : simd == eslSWAT_AVX ? 16 : 8);
+
+      for (t = 0; t < ntrials; t++)
+	{
+	  L   = 1 + esl_rnd_Roll(rng, maxL);
+	  n   = 1 + esl_rnd_Roll(rng, lanes);
+	  gop = -1 - esl_rnd_Roll(rng, 15);
+	  gex = -1 - esl_rnd_Roll(rng, 5);
+	  sample_seq(rng, abc, L, x);
+	  for (k = 0; k < n; k++)
+	    {
+	      if (esl_rnd_Roll(rng, 2)) { M[k] = esl_rnd_Roll(rng, maxL+1); sample_seq(rng, abc, M[k], y[k]); }
+	      else                        M[k] = sample_homolog(rng, abc, x, L, y[k], maxL);
+	    }
+
+	  if ((prof = swat_profile_create(S, x, L, gop, gex, simd)) == NULL) esl_fatal(msg);
+	  if (esl_swat_workspace_Grow(ws, prof) != eslOK)                     esl_fatal(msg);
+	  switch (simd) {
+#ifdef eslENABLE_SSE
+	  case eslSWAT_SSE:    status = esl_swat_inter16_sse   (prof, (const ESL_DSQ **) y, M, n, ws->dp, sc); break;
+#endif
+#ifdef eslENABLE_AVX
+	  case eslSWAT_AVX:    status = esl_swat_inter16_avx   (prof, (const ESL_DSQ **) y, M, n, ws->dp, sc); break;
+#endif
+#ifdef eslENABLE_AVX512
+	  case eslSWAT_AVX512: status = esl_swat_inter16_avx512(prof, (const ESL_DSQ **) y, M, n, ws->dp, sc); break;
+#endif
+	  default: esl_fatal(msg);
+	  }
+	  if (status != eslOK) esl_fatal(msg);
+
+	  for (k = 0; k < n; k++)
+	    {
+	      if (esl_swat_Score(x, L, y[k], M[k], S, gop, gex, &sc0) != eslOK) esl_fatal(msg);
+	      if (sc[k] != sc0) esl_fatal("%s: simd %d, L=%d M=%d: %d != %d", msg, simd, L, M[k], sc[k], sc0);
+	    }
+	  esl_swat_profile_Destroy(prof);
+	}
+    }
+
+  free(x);
+  for (k = 0; k < 32; k++) free(y[k]);
+  esl_swat_workspace_Destroy(ws);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+
+/* utest_batch()
+ * Score a few blocks of targets with an ESL_SWAT_BATCH with <ncpu>
+ * workers, given alternately as ESL_SQ_BLOCKs and ESL_DSQDATA_CHUNKs.
+ * Scores must match esl_swat_Score(), and the top K must match a
+ * sort of all of them.
+ *
+ * The blocks mix short and long targets, and some copies of the
+ * query. With scores scaled up 100x, the copies overflow 16 bits,
+ * and the batch has to rescore them after the inter-sequence and
+ * striped 16-bit kernels saturate.
+ */
+static void
+utest_batch(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, ESL_SCOREMATRIX *S, int ncpu)
+{
+  char               msg[]   = "esl_swat batch unit test failed";
+  ESL_SCOREMATRIX   *S100    = esl_scorematrix_Clone(S);
+  ESL_SWAT_PROFILE  *prof    = NULL;
+  ESL_SWAT_BATCH    *bat     = NULL;
+  ESL_SQ_BLOCK      *sqblock = NULL;
+  ESL_DSQDATA_CHUNK  chu;
+  ESL_SWAT_HIT      *hit     = NULL;
+  ESL_SWAT_HIT      *all     = NULL;
+  ESL_DSQ           *x       = NULL;
+  int               *sc      = NULL;
+  int                L       = 100;
+  int                N       = 700;      // > eslSWAT_BATCH_B, so workers share blocks
+  int                nblocks = 3;
+  int                K       = 20;
+  int                b, i, nhit, scale, sc0;
+  int                status;
+
+  if (S100 == NULL) esl_fatal(msg);
+  for (i = 0; i < S->Kp * S->Kp; i++) S100->s[0][i] *= 100;
+
+  ESL_ALLOC(x,        sizeof(ESL_DSQ)      * (L+2));
+  ESL_ALLOC(sc,       sizeof(int)          * N);
+  ESL_ALLOC(hit,      sizeof(ESL_SWAT_HIT) * K);
+  ESL_ALLOC(all,      sizeof(ESL_SWAT_HIT) * N * nblocks);
+  ESL_ALLOC(chu.dsq,  sizeof(ESL_DSQ *)    * N);
+  ESL_ALLOC(chu.L,    sizeof(int64_t)      * N);
+  if ((sqblock = esl_sq_CreateDigitalBlock(N, abc)) == NULL) esl_fatal(msg);
+
+  for (scale = 1; scale <= 100; scale *= 100)
+    {
+      sample_seq(rng, abc, L, x);
+      if ((prof = esl_swat_profile_Create((scale == 1 ? S : S100), x, L, -11*scale, -1*scale)) == NULL) esl_fatal(msg);
+      if ((bat  = esl_swat_batch_Create(prof, K, ncpu))                                         == NULL) esl_fatal(msg);
+
+      for (b = 0; b < nblocks; b++)
+	{
+	  for (i = 0; i < N; i++)
+	    {
+	      ESL_SQ *sq = &(sqblock->list[i]);
+	      int     M  = (esl_rnd_Roll(rng, 2) ? esl_rnd_Roll(rng, 2*eslSWAT_BATCH_MAXSHORT) : esl_rnd_Roll(rng, 10));
+
+	      if (esl_sq_GrowTo(sq, 2*eslSWAT_BATCH_MAXSHORT) != eslOK) esl_fatal(msg);
+	      if (esl_rnd_Roll(rng, 50) == 0) { memcpy(sq->dsq, x, sizeof(ESL_DSQ) * (L+2)); M = L; }
+	      else if (esl_rnd_Roll(rng, 3))  M = sample_homolog(rng, abc, x, L, sq->dsq, 2*eslSWAT_BATCH_MAXSHORT-1);
+	      else                            sample_seq(rng, abc, M, sq->dsq);
+	      sq->n = M;
+
+	      chu.dsq[i] = sq->dsq;
+	      chu.L[i]   = M;
+	    }
+	  sqblock->count = chu.N = N;
+
+	  if (b == 2) bat->maxshort = 0;
+	  if (b % 2 == 0) { if (esl_swat_batch_ScoreBlock(bat, sqblock, sc) != eslOK) esl_fatal(msg); }
+	  else            { if (esl_swat_batch_ScoreChunk(bat, &chu,    sc) != eslOK) esl_fatal(msg); }
+
+	  for (i = 0; i < N; i++)
+	    {
+	      if (esl_swat_Score(x, L, sqblock->list[i].dsq, sqblock->list[i].n, (scale == 1 ? S : S100), -11*scale, -1*scale, &sc0) != eslOK) esl_fatal(msg);
+	      if (sc[i] != sc0) esl_fatal("%s: target %d: %d != %d", msg, i, sc[i], sc0);
+	      all[b*N + i].idx = b*N + i;
+	      all[b*N + i].sc  = sc0;
+	    }
+	}
+      if (bat->ntargets != N * nblocks) esl_fatal(msg);
+
+      qsort(all, N * nblocks, sizeof(ESL_SWAT_HIT), swat_hit_sorter);
+      if (esl_swat_batch_GetTopHits(bat, hit, &nhit) != eslOK) esl_fatal(msg);
+      if (nhit != K) esl_fatal(msg);
+      for (i = 0; i < K; i++)
+	if (hit[i].idx != all[i].idx || hit[i].sc != all[i].sc) esl_fatal(msg);
+      if (scale == 100 && hit[0].sc < 32767) esl_fatal(msg);
+
+      esl_swat_batch_Reuse(bat);
+      if (esl_swat_batch_GetTopHits(bat, hit, &nhit) != eslOK || nhit != 0) esl_fatal(msg);
+
+      esl_swat_batch_Destroy(bat);
+      esl_swat_profile_Destroy(prof);
+    }
+
+  sqblock->count = N;
+  esl_sq_DestroyBlock(sqblock);
+  free(chu.dsq);
+  free(chu.L);
+  free(all);
+  free(hit);
+  free(sc);
+  free(x);
+  esl_scorematrix_Destroy(S100);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+#endif /*eslSWAT_TESTDRIVE*/
+
+
+
+/*****************************************************************
+ * 11. Test driver
+ *****************************************************************/
+#ifdef eslSWAT_TESTDRIVE
+
+#include "esl_getopts.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                             docgroup*/
+  { "-h",  eslARG_NONE,   FALSE,  NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",    0 },
+  { "-s",  eslARG_INT,      "0",  NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for Smith/Waterman module";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS     *go   = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS  *rng  = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET    *abc  = esl_alphabet_Create(eslAMINO);
+  ESL_SCOREMATRIX *S    = esl_scorematrix_Create(abc);
+
+  fprintf(stderr, "## %s\n", argv[0]);
+  fprintf(stderr, "#  rng seed = %" PRIu32 "\n", esl_randomness_GetSeed(rng));
+
+  if (esl_scorematrix_Set("BLOSUM62", S) != eslOK) esl_fatal("failed to set BLOSUM62");
+
+  utest_Score(abc, S);
+  utest_striped(rng, abc, S);
+  utest_workspace(rng, abc, S);
+  utest_align(rng, abc, S);
+  utest_banded(rng, abc, S);
+  utest_inter(rng, abc, S);
+  utest_batch(rng, abc, S, 0);
+#ifdef HAVE_PTHREAD
+  utest_batch(rng, abc, S, 3);
+#endif
+
+  fprintf(stderr, "#  status = ok\n");
+
+  esl_scorematrix_Destroy(S);
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*eslSWAT_TESTDRIVE*/
@@ -0,0 +1,226 @@
+/* Smith/Waterman local sequence alignment.
+ */
+#ifndef eslSWAT_INCLUDED
+#define eslSWAT_INCLUDED
+#include "esl_config.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "easel.h"
+#include "esl_dsqdata.h"
+#include "esl_heap.h"
+#include "esl_scorematrix.h"
+#include "esl_sq.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
+
+/* Which implementation an ESL_SWAT_PROFILE is striped for:
+ * ESL_SWAT_PROFILE.simd
+ */
+#define eslSWAT_SERIAL   0
+#define eslSWAT_SSE      1
+#define eslSWAT_AVX      2
+#define eslSWAT_AVX512   3
+
+/* Banded alignment modes, for esl_swat_BandedScore() */
+#define eslSWAT_LOCAL    0
+#define eslSWAT_GLOBAL   1
+
+/* ESL_SWAT_PROFILE
+ * A query sequence and scoring system, with the query's scores
+ * pre-arranged per target residue type, for repeated local alignment
+ * scoring against many targets.
+ *
+ * <sc[a][1..L]> are the scores of each query residue against target
+ * residue code <a> (0..Kp-1), for the serial implementation.
+ *
+ * For the vector implementations, the same scores are striped
+ * (Farrar 2007) into <V>-byte vectors: query position j=1..L goes to
+ * segment <(j-1) % Q>, lane <(j-1) / Q>, for Q segments per target
+ * residue. There are three stripings, for 8-bit (Q8 segments of V
+ * lanes), 16-bit (Q16 of V/2), and 32-bit (Q32 of V/4) scores. Unused
+ * lanes past the end of the query score 0. 8-bit scores are unsigned,
+ * offset by <bias>. A striping that can't hold the scoring system has
+ * Q=0, and a score that overflows one width is recalculated in the
+ * next.
+ *
+ * For inter-sequence scoring (one target per lane), <x> is a copy of
+ * the query, and <s16> the scores of query residue a against target
+ * residue b, <s16[a*32 + b]>, in rows of 32 padded with -32768, so
+ * target code 31 can pad a lane. These are only made if Q16 > 0 and
+ * Kp < 32.
+ */
+typedef struct {
+  const ESL_ALPHABET *abc;  // digital alphabet (a copy of the ptr to S->abc_r)
+  int       L;              // query length
+  int       Kp;             // number of target residue codes, abc->Kp
+  int       gop;            // gap-open score (<= 0): a gap of k residues scores gop + (k-1) gex
+  int       gex;            // gap-extend score (<= 0)
+  int     **sc;             // sc[a][1..L]; sc[a][0] unused
+
+  int       simd;           // eslSWAT_SERIAL | eslSWAT_SSE | eslSWAT_AVX | eslSWAT_AVX512
+  int       V;              // vector width in bytes (16, 32, 64), or 0 for eslSWAT_SERIAL
+  int       Q8, Q16, Q32;   // segments per striped row; 0 if that width can't be used
+  uint8_t   bias;           // offset added to 8-bit scores, -(min score)
+  uint8_t  *p8;             // 8-bit striping,  [a][q][lane], Kp * Q8  * V bytes
+  int16_t  *p16;            // 16-bit striping, [a][q][lane], Kp * Q16 * V bytes
+  int32_t  *p32;            // 32-bit striping, [a][q][lane], Kp * Q32 * V bytes
+  ESL_DSQ  *x;              // copy of the query, x[1..L], with sentinels; or NULL
+  int16_t  *s16;            // 16-bit scores, [a][b], Kp * 32; or NULL
+} ESL_SWAT_PROFILE;
+
+/* ESL_SWAT_WORKSPACE
+ * DP memory for scoring targets against profiles, kept across calls
+ * so that scoring many targets allocates nothing per target. Grows
+ * as needed to fit the largest profile it has been used with.
+ */
+typedef struct {
+  void     *dp;             // striped DP vectors, aligned to 64 bytes
+  size_t    dpalloc;        // allocated size of <dp>, in bytes
+  int      *rows;           // six serial DP rows, for profiles without striping
+  int       rowalloc;       // allocated length of each row (>= L+1)
+  int      *adiag;          // anti-diagonal DP arrays, for banded alignment
+  int       adalloc;        // allocated length of <adiag>
+} ESL_SWAT_WORKSPACE;
+
+/* ESL_SWAT_ALI
+ * An optimal local alignment of a target to a query profile, from
+ * esl_swat_Align(). Reusable, for aligning many targets.
+ *
+ * The path has one character per alignment column: 'M' for a query
+ * residue aligned to a target residue, 'I' for a query residue
+ * against a gap, 'D' for a target residue against a gap. <cigar> is
+ * the same path, run-length encoded: "12M2I7M1D5M".
+ */
+typedef struct {
+  int       sc;             // local alignment score
+  int       qfrom, qto;     // alignment is of query x[qfrom..qto] (1..L)...
+  int       tfrom, tto;     //   ... to target y[tfrom..tto] (1..M); all 0 if sc == 0, an empty alignment
+  char     *path;           // path[0..n-1], 'M' | 'I' | 'D'; \0-terminated
+  int       n;              // length of the path, in alignment columns
+  char     *cigar;          // run-length encoded path; \0-terminated
+  int       nalloc;         // allocated length of <path>; <cigar> has 2x that
+} ESL_SWAT_ALI;
+
+/* ESL_SWAT_HIT
+ * One target's score, in a batch's top-K list.
+ */
+typedef struct {
+  int64_t   idx;            // index of the target, 0..ntargets-1, in the order the batch was given them
+  int       sc;             // its score
+} ESL_SWAT_HIT;
+
+/* ESL_SWAT_BATCH
+ * Scores one query profile against a stream of targets, given in
+ * blocks (ESL_SQ_BLOCK or ESL_DSQDATA_CHUNK), across a pool of
+ * worker threads; and keeps the top K scores.
+ *
+ * Targets of length <= <maxshort> are scored inter-sequence (one
+ * target per vector lane); longer ones, by the striped kernels.
+ */
+#define eslSWAT_BATCH_MAXSHORT  128   // default <maxshort>
+#define eslSWAT_BATCH_B         256   // number of targets a worker takes at a time
+
+typedef struct {
+  const ESL_SWAT_PROFILE *prof;  // query profile (a copy of the ptr)
+  int       ncpu;                // number of worker threads; 0 = do everything in the caller's thread
+  int       maxshort;            // score targets this long or shorter inter-sequence; 0 = never
+  int64_t   ntargets;            // number of targets scored so far
+
+  /* top K hits */
+  int            K;              // number of top hits to keep; 0 = none
+  ESL_HEAP      *heap;           // min-heap of the K best scores so far: the top is the threshold to get in
+  ESL_SWAT_HIT  *hit;            // candidates for the top K, [0..nhit-1]; ties with the threshold included
+  int            nhit;           // number of candidates
+  int            halloc;         // allocation of <hit>, 2K
+
+  /* targets in the block being scored */
+  const ESL_DSQ **dsq;           // dsq[0..n-1][1..M[i]]
+  int           *M;              // lengths [0..n-1]
+  int           *sc;             // scores [0..n-1]
+  int            n;              // number of targets in the block
+  int            talloc;         // allocation of <dsq>, <M>, <sc>
+
+  ESL_SWAT_WORKSPACE **ws;       // ws[0..ncpu-1] for workers; ws[ncpu] for the caller
+#ifdef HAVE_PTHREAD
+  ESL_THREADS     *thr;          // worker pool; NULL if ncpu == 0
+  pthread_mutex_t  mutex;        // protects the rest of these:
+  pthread_cond_t   cv;           // signals a new block, or finished workers
+  int              next;         // next target for a worker to take
+  int              nbusy;        // number of workers still on this block
+  int              block;        // block number, so workers know there's a new one
+  int              done;         // TRUE when workers should exit
+  int              status;       // first error status from a worker, or eslOK
+#endif
+} ESL_SWAT_BATCH;
+
+
+extern int  esl_swat_Score(ESL_DSQ *x, int L, ESL_DSQ *y, int M, ESL_SCOREMATRIX *S, int gop, int gex, int *ret_sc);
+
+extern ESL_SWAT_PROFILE *esl_swat_profile_Create(const ESL_SCOREMATRIX *S, const ESL_DSQ *x, int L, int gop, int gex);
+extern void              esl_swat_profile_Destroy(ESL_SWAT_PROFILE *prof);
+extern size_t            esl_swat_profile_Sizeof(const ESL_SWAT_PROFILE *prof);
+
+extern ESL_SWAT_WORKSPACE *esl_swat_workspace_Create(void);
+extern int                 esl_swat_workspace_Grow(ESL_SWAT_WORKSPACE *ws, const ESL_SWAT_PROFILE *prof);
+extern size_t              esl_swat_workspace_Sizeof(const ESL_SWAT_WORKSPACE *ws);
+extern void                esl_swat_workspace_Destroy(ESL_SWAT_WORKSPACE *ws);
+
+extern int esl_swat_StripedScore(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, int *ret_sc);
+
+extern ESL_SWAT_ALI *esl_swat_ali_Create(void);
+extern void          esl_swat_ali_Destroy(ESL_SWAT_ALI *ali);
+extern int           esl_swat_Align(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, ESL_SWAT_WORKSPACE *ws, ESL_SWAT_ALI *ali);
+
+extern int esl_swat_BandedScore(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, int d, int w, int mode, ESL_SWAT_WORKSPACE *ws, int *ret_sc);
+extern int esl_swat_XDrop(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, int i0, int j0, int w, int xdrop, ESL_SWAT_WORKSPACE *ws,
+			  int *ret_sc, int *opt_tfrom, int *opt_tto, int *opt_qfrom, int *opt_qto);
+
+extern ESL_SWAT_BATCH *esl_swat_batch_Create(const ESL_SWAT_PROFILE *prof, int K, int ncpu);
+extern int             esl_swat_batch_ScoreBlock(ESL_SWAT_BATCH *bat, const ESL_SQ_BLOCK *sqblock, int *opt_sc);
+extern int             esl_swat_batch_ScoreChunk(ESL_SWAT_BATCH *bat, const ESL_DSQDATA_CHUNK *chu, int *opt_sc);
+extern int             esl_swat_batch_GetTopHits(ESL_SWAT_BATCH *bat, ESL_SWAT_HIT *hit, int *ret_n);
+extern int             esl_swat_batch_Reuse(ESL_SWAT_BATCH *bat);
+extern void            esl_swat_batch_Destroy(ESL_SWAT_BATCH *bat);
+
+/* Striped kernels, one per instruction set and score width:
+ * esl_swat_{sse,avx,avx512}.c. Each scores target <y[1..M]> using
+ * <dp>, 4*Q vectors of DP workspace, aligned for the instruction set.
+ * They return <eslERANGE> if the score overflows the width. If
+ * <opt_i> is non-NULL, they also return in <*opt_i>,<*opt_j> the end
+ * of the best local alignment: the first target row i reaching the
+ * optimal score, and in it, the smallest query position j.
+ * The inter16 kernels score one target per 16-bit lane. The adiag
+ * kernels compute one anti-diagonal of banded DP.
+ */
+#ifdef eslENABLE_SSE
+extern int esl_swat_inter16_sse    (const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc);
+extern int esl_swat_striped8_sse   (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern int esl_swat_striped16_sse  (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+#endif
+#ifdef eslENABLE_SSE4
+extern int esl_swat_striped32_sse  (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern void esl_swat_adiag_sse(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                               int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex);
+#endif
+#ifdef eslENABLE_AVX
+extern int esl_swat_inter16_avx    (const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc);
+extern int esl_swat_striped8_avx   (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern int esl_swat_striped16_avx  (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern int esl_swat_striped32_avx  (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern void esl_swat_adiag_avx(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                               int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex);
+#endif
+#ifdef eslENABLE_AVX512
+extern int esl_swat_inter16_avx512  (const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc);
+extern int esl_swat_striped8_avx512 (const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern int esl_swat_striped16_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern int esl_swat_striped32_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j);
+extern void esl_swat_adiag_avx512(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                                  int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex);
+#endif
+
+#endif /*eslSWAT_INCLUDED*/
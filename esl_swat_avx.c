@@ -0,0 +1,416 @@
+/* Striped Smith/Waterman scoring: AVX2 implementation.
+ *
+ * esl_swat_StripedScore() calls these for an ESL_SWAT_PROFILE that
+ * was striped for AVX2 (32-byte vectors). See esl_swat_sse.c for
+ * notes on the algorithm; this is the same code, twice as wide.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_avx.h"
+#include "esl_swat.h"
+
+/* rightshift_int32()
+ * Shift int32 vector elements to the right, shifting <neginfmask[0]> on.
+ */
+static inline __m256i
+rightshift_int32(__m256i v, __m256i neginfmask)
+{
+  return _mm256_or_si256(_mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, _MM_SHUFFLE(0,0,3,0)), 12), neginfmask);
+}
+
+
+/* first_j_*()
+ * Return the smallest query position j whose match score in striped
+ * row <Mp> (Q segments) is <v>, or 0 if none. <vv> is <v> in every
+ * lane. Used to find the end of the best alignment.
+ */
+static int
+first_j_epu8(const __m256i *Mp, int Q, __m256i vv, int v)
+{
+  const uint8_t *m = (const uint8_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(Mp[q], vv)))
+      for (k = 0; k < 32; k++)
+	if (m[q*32 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi16(const __m256i *Mp, int Q, __m256i vv, int v)
+{
+  const int16_t *m = (const int16_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(Mp[q], vv)))
+      for (k = 0; k < 16; k++)
+	if (m[q*16 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi32(const __m256i *Mp, int Q, __m256i vv, int v)
+{
+  const int32_t *m = (const int32_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(Mp[q], vv)))
+      for (k = 0; k < 8; k++)
+	if (m[q*8 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+/* hmax_epi32()
+ * Return the max of the eight int32 elements of <v>.
+ */
+static inline int
+hmax_epi32(__m256i v)
+{
+  __m128i h = _mm_max_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  h = _mm_max_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1,0,3,2)));
+  h = _mm_max_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(h);
+}
+
+
+/* Function:  esl_swat_striped8_avx()
+ * Synopsis:  Striped Smith/Waterman score, 8-bit AVX2 version.
+ *
+ * Purpose:   Same as <esl_swat_striped8_sse()>, 32 lanes at a time.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches <255 - prof->bias>.
+ */
+int
+esl_swat_striped8_avx(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q      = prof->Q8;
+  __m256i       *Hp     = (__m256i *) dp;
+  __m256i       *Mp     = Hp  + Q;
+  __m256i       *IYp    = Mp  + Q;
+  __m256i       *IX     = IYp + Q;
+  __m256i        vgo    = _mm256_set1_epi8((char) (-prof->gop));
+  __m256i        vge    = _mm256_set1_epi8((char) (-prof->gex));
+  __m256i        vbias  = _mm256_set1_epi8((char) prof->bias);
+  __m256i        vlimit = _mm256_set1_epi8((char) (254 - prof->bias));
+  __m256i        vzero  = _mm256_setzero_si256();
+  __m256i        vmax   = vzero;
+  __m256i        vbest  = vzero;
+  __m256i        vH, vM, vIY, vIX, vHd;
+  const __m256i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m256i *) (prof->p8 + (size_t) y[i] * Q * 32);
+      vHd = esl_avx_rightshift_int8(Hp[Q-1], vzero);
+      vIX = vzero;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm256_subs_epu8(_mm256_adds_epu8(vHd, sv[q]), vbias);
+	  vIY   = _mm256_max_epu8(_mm256_subs_epu8(Mp[q], vgo), _mm256_subs_epu8(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm256_max_epu8(_mm256_max_epu8(vM, vIY), vIX);
+	  vmax  = _mm256_max_epu8(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm256_max_epu8(_mm256_subs_epu8(vM, vgo), _mm256_subs_epu8(vIX, vge));
+	}
+
+      vIX = esl_avx_rightshift_int8(vIX, vzero);
+      q   = 0;
+      while (esl_avx_any_gt_epu8(vIX, IX[q]))
+	{
+	  IX[q] = _mm256_max_epu8(IX[q], vIX);
+	  Hp[q] = _mm256_max_epu8(Hp[q], vIX);
+	  vIX   = _mm256_subs_epu8(vIX, vge);
+	  if (++q == Q) { vIX = esl_avx_rightshift_int8(vIX, vzero); q = 0; }
+	}
+
+      if (esl_avx_any_gt_epu8(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && esl_avx_any_gt_epu8(vmax, vbest))
+	{
+	  best  = esl_avx_hmax_epu8(vmax);
+	  vbest = _mm256_set1_epi8((char) best);
+	  bi    = i;
+	  bj    = first_j_epu8(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_avx_hmax_epu8(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_striped16_avx()
+ * Synopsis:  Striped Smith/Waterman score, 16-bit AVX2 version.
+ *
+ * Purpose:   Same as <esl_swat_striped16_sse()>, 16 lanes at a time.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches 32767.
+ */
+int
+esl_swat_striped16_avx(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q16;
+  __m256i       *Hp      = (__m256i *) dp;
+  __m256i       *Mp      = Hp  + Q;
+  __m256i       *IYp     = Mp  + Q;
+  __m256i       *IX      = IYp + Q;
+  __m256i        vgo     = _mm256_set1_epi16((int16_t) (-prof->gop));
+  __m256i        vge     = _mm256_set1_epi16((int16_t) (-prof->gex));
+  __m256i        vlimit  = _mm256_set1_epi16(32766);
+  __m256i        vneginf = _mm256_set1_epi16(-32768);
+  __m256i        vinfmsk = _mm256_insert_epi16(_mm256_setzero_si256(), -32768, 0);
+  __m256i        vzero   = _mm256_setzero_si256();
+  __m256i        vmax    = vzero;
+  __m256i        vbest   = vzero;
+  __m256i        vH, vM, vIY, vIX, vHd;
+  const __m256i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m256i *) (prof->p16 + (size_t) y[i] * Q * 16);
+      vHd = esl_avx_rightshift_int16(Hp[Q-1], vzero);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm256_max_epi16(_mm256_adds_epi16(vHd, sv[q]), vzero);
+	  vIY   = _mm256_max_epi16(_mm256_subs_epi16(Mp[q], vgo), _mm256_subs_epi16(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm256_max_epi16(_mm256_max_epi16(vM, vIY), vIX);
+	  vmax  = _mm256_max_epi16(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm256_max_epi16(_mm256_subs_epi16(vM, vgo), _mm256_subs_epi16(vIX, vge));
+	}
+
+      vIX = esl_avx_rightshift_int16(vIX, vinfmsk);
+      q   = 0;
+      while (esl_avx_any_gt_epi16(vIX, IX[q]))
+	{
+	  IX[q] = _mm256_max_epi16(IX[q], vIX);
+	  Hp[q] = _mm256_max_epi16(Hp[q], vIX);
+	  vIX   = _mm256_subs_epi16(vIX, vge);
+	  if (++q == Q) { vIX = esl_avx_rightshift_int16(vIX, vinfmsk); q = 0; }
+	}
+
+      if (esl_avx_any_gt_epi16(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && esl_avx_any_gt_epi16(vmax, vbest))
+	{
+	  best  = esl_avx_hmax_epi16(vmax);
+	  vbest = _mm256_set1_epi16((int16_t) best);
+	  bi    = i;
+	  bj    = first_j_epi16(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_avx_hmax_epi16(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_striped32_avx()
+ * Synopsis:  Striped Smith/Waterman score, 32-bit AVX2 version.
+ *
+ * Purpose:   Same as <esl_swat_striped32_sse()>, 8 lanes at a time.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_swat_striped32_avx(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q32;
+  __m256i       *Hp      = (__m256i *) dp;
+  __m256i       *Mp      = Hp  + Q;
+  __m256i       *IYp     = Mp  + Q;
+  __m256i       *IX      = IYp + Q;
+  __m256i        vgo     = _mm256_set1_epi32(-prof->gop);
+  __m256i        vge     = _mm256_set1_epi32(-prof->gex);
+  __m256i        vneginf = _mm256_set1_epi32(-(1 << 30));
+  __m256i        vinfmsk = _mm256_insert_epi32(_mm256_setzero_si256(), -(1 << 30), 0);
+  __m256i        vzero   = _mm256_setzero_si256();
+  __m256i        vmax    = vzero;
+  __m256i        vbest   = vzero;
+  __m256i        vH, vM, vIY, vIX, vHd;
+  const __m256i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m256i *) (prof->p32 + (size_t) y[i] * Q * 8);
+      vHd = rightshift_int32(Hp[Q-1], vzero);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm256_max_epi32(_mm256_add_epi32(vHd, sv[q]), vzero);
+	  vIY   = _mm256_max_epi32(_mm256_sub_epi32(Mp[q], vgo), _mm256_sub_epi32(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm256_max_epi32(_mm256_max_epi32(vM, vIY), vIX);
+	  vmax  = _mm256_max_epi32(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm256_max_epi32(_mm256_sub_epi32(vM, vgo), _mm256_sub_epi32(vIX, vge));
+	}
+
+      vIX = rightshift_int32(vIX, vinfmsk);
+      q   = 0;
+      while (_mm256_movemask_epi8(_mm256_cmpgt_epi32(vIX, IX[q])))
+	{
+	  IX[q] = _mm256_max_epi32(IX[q], vIX);
+	  Hp[q] = _mm256_max_epi32(Hp[q], vIX);
+	  vIX   = _mm256_sub_epi32(vIX, vge);
+	  if (++q == Q) { vIX = rightshift_int32(vIX, vinfmsk); q = 0; }
+	}
+
+      if (opt_i && _mm256_movemask_epi8(_mm256_cmpgt_epi32(vmax, vbest)))
+	{
+	  best  = hmax_epi32(vmax);
+	  vbest = _mm256_set1_epi32(best);
+	  bi    = i;
+	  bj    = first_j_epi32(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = hmax_epi32(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_inter16_avx()
+ * Synopsis:  Smith/Waterman scores of 16 targets at once, 16-bit AVX2.
+ *
+ * Purpose:   Same as <esl_swat_inter16_sse()>, 16 targets at a time.
+ *
+ * Returns:   <eslOK>. A score of 32767 may have saturated; caller
+ *            must rescore that target with a wider implementation.
+ */
+int
+esl_swat_inter16_avx(const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc)
+{
+  int            L       = prof->L;
+  int            Kp      = prof->Kp;
+  __m256i       *Hp      = (__m256i *) dp;
+  __m256i       *Mp      = Hp  + (L+1);
+  __m256i       *IYp     = Mp  + (L+1);
+  __m256i       *T       = IYp + (L+1);
+  int16_t       *t       = (int16_t *) T;
+  __m256i        vgo     = _mm256_set1_epi16((int16_t) (-prof->gop));
+  __m256i        vge     = _mm256_set1_epi16((int16_t) (-prof->gex));
+  __m256i        vneginf = _mm256_set1_epi16(-32768);
+  __m256i        vzero   = _mm256_setzero_si256();
+  __m256i        vmax    = vzero;
+  __m256i        vH, vM, vIY, vIX, vHd;
+  union { __m256i v; int16_t x[16]; } u;
+  int16_t        yk[16];
+  const int16_t *row;
+  int            maxM    = 0;
+  int            i, j, k, a;
+
+  for (k = 0; k < n; k++) maxM = ESL_MAX(maxM, M[k]);
+  for (j = 0; j <= L; j++) Hp[j] = Mp[j] = IYp[j] = vzero;
+
+  for (i = 1; i <= maxM; i++)
+    {
+      for (k = 0; k < 16; k++) yk[k] = (k < n && i <= M[k] ? y[k][i] : 31);
+      for (a = 0; a < Kp; a++)
+	{
+	  row = prof->s16 + a*32;
+	  for (k = 0; k < 16; k++) t[a*16 + k] = row[yk[k]];
+	}
+
+      vHd = vzero;
+      vIX = vneginf;
+      for (j = 1; j <= L; j++)
+	{
+	  vM     = _mm256_max_epi16(_mm256_adds_epi16(vHd, T[prof->x[j]]), vzero);
+	  vIY    = _mm256_max_epi16(_mm256_subs_epi16(Mp[j], vgo), _mm256_subs_epi16(IYp[j], vge));
+	  vHd    = Hp[j];
+	  vH     = _mm256_max_epi16(_mm256_max_epi16(vM, vIY), vIX);
+	  vmax   = _mm256_max_epi16(vmax, vM);
+	  Hp[j]  = vH;  Mp[j] = vM;  IYp[j] = vIY;
+	  vIX    = _mm256_max_epi16(_mm256_subs_epi16(vM, vgo), _mm256_subs_epi16(vIX, vge));
+	}
+    }
+
+  u.v = vmax;
+  for (k = 0; k < n; k++) sc[k] = u.x[k];
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_adiag_avx()
+ * Synopsis:  One anti-diagonal of banded DP, AVX2 version.
+ *
+ * Purpose:   Compute cells <lo..hi> of an anti-diagonal for
+ *            <swat_band()> in esl_swat.c, 8 at a time: given
+ *            the previous anti-diagonal's <mp>, <xp>, <yp>, the
+ *            one before's <hpp>, and the gathered scores <s>, set
+ *            <mc>, <xc>, <yc>, and their max <hc>. Rows are the
+ *            array indices; <mmin> is the floor on M(i-1,j-1).
+ *            Cells past the last whole vector are done serially,
+ *            so nothing outside <lo..hi> is written.
+ */
+void
+esl_swat_adiag_avx(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                   int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex)
+{
+  __m256i vmin = _mm256_set1_epi32(mmin);
+  __m256i vgo  = _mm256_set1_epi32(gop);
+  __m256i vge  = _mm256_set1_epi32(gex);
+  __m256i vM, vX, vY;
+  int     i, m, x, y;
+
+  for (i = lo; i + 8 <= hi + 1; i += 8)
+    {
+      vM = _mm256_add_epi32(_mm256_max_epi32(_mm256_loadu_si256((const __m256i *) (hpp + i - 1)), vmin), _mm256_loadu_si256((const __m256i *) (s + i)));
+      vX = _mm256_max_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (mp + i)),     vgo), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (xp + i)),     vge));
+      vY = _mm256_max_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (mp + i - 1)), vgo), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (yp + i - 1)), vge));
+      _mm256_storeu_si256((__m256i *) (mc + i), vM);
+      _mm256_storeu_si256((__m256i *) (xc + i), vX);
+      _mm256_storeu_si256((__m256i *) (yc + i), vY);
+      _mm256_storeu_si256((__m256i *) (hc + i), _mm256_max_epi32(vM, _mm256_max_epi32(vX, vY)));
+    }
+  for (; i <= hi; i++)
+    {
+      m     = ESL_MAX(hpp[i-1], mmin) + s[i];
+      x     = ESL_MAX(mp[i]   + gop, xp[i]   + gex);
+      y     = ESL_MAX(mp[i-1] + gop, yp[i-1] + gex);
+      mc[i] = m;
+      xc[i] = x;
+      yc[i] = y;
+      hc[i] = ESL_MAX(m, ESL_MAX(x, y));
+    }
+}
+
+#else // ! eslENABLE_AVX
+void esl_swat_avx_silence_hack(void) { return; }
+#endif // eslENABLE_AVX or not
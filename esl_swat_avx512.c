@@ -0,0 +1,403 @@
+/* Striped Smith/Waterman scoring: AVX-512 implementation.
+ *
+ * esl_swat_StripedScore() calls these for an ESL_SWAT_PROFILE that
+ * was striped for AVX-512 (64-byte vectors). See esl_swat_sse.c for
+ * notes on the algorithm; this is the same code, four times as wide.
+ * Needs AVX-512BW, for 8- and 16-bit operations.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX512
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_avx512.h"
+#include "esl_swat.h"
+
+/* rightshift_int32()
+ * Shift int32 vector elements to the right, shifting <neginfmask[0]> on.
+ */
+static inline __m512i
+rightshift_int32(__m512i v, __m512i neginfmask)
+{
+  v = _mm512_alignr_epi8(v, _mm512_maskz_shuffle_i32x4(0xfff0, v, v, 0x90), 12);
+  return _mm512_or_si512(v, neginfmask);
+}
+
+
+/* first_j_*()
+ * Return the smallest query position j whose match score in striped
+ * row <Mp> (Q segments) is <v>, or 0 if none. <vv> is <v> in every
+ * lane. Used to find the end of the best alignment.
+ */
+static int
+first_j_epu8(const __m512i *Mp, int Q, __m512i vv, int v)
+{
+  const uint8_t *m = (const uint8_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm512_cmpeq_epi8_mask(Mp[q], vv))
+      for (k = 0; k < 64; k++)
+	if (m[q*64 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi16(const __m512i *Mp, int Q, __m512i vv, int v)
+{
+  const int16_t *m = (const int16_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm512_cmpeq_epi16_mask(Mp[q], vv))
+      for (k = 0; k < 32; k++)
+	if (m[q*32 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi32(const __m512i *Mp, int Q, __m512i vv, int v)
+{
+  const int32_t *m = (const int32_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm512_cmpeq_epi32_mask(Mp[q], vv))
+      for (k = 0; k < 16; k++)
+	if (m[q*16 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+
+/* Function:  esl_swat_striped8_avx512()
+ * Synopsis:  Striped Smith/Waterman score, 8-bit AVX-512 version.
+ *
+ * Purpose:   Same as <esl_swat_striped8_sse()>, 64 lanes at a time.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches <255 - prof->bias>.
+ */
+int
+esl_swat_striped8_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q      = prof->Q8;
+  __m512i       *Hp     = (__m512i *) dp;
+  __m512i       *Mp     = Hp  + Q;
+  __m512i       *IYp    = Mp  + Q;
+  __m512i       *IX     = IYp + Q;
+  __m512i        vgo    = _mm512_set1_epi8((char) (-prof->gop));
+  __m512i        vge    = _mm512_set1_epi8((char) (-prof->gex));
+  __m512i        vbias  = _mm512_set1_epi8((char) prof->bias);
+  __m512i        vlimit = _mm512_set1_epi8((char) (254 - prof->bias));
+  __m512i        vzero  = _mm512_setzero_si512();
+  __m512i        vmax   = vzero;
+  __m512i        vbest  = vzero;
+  __m512i        vH, vM, vIY, vIX, vHd;
+  const __m512i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m512i *) (prof->p8 + (size_t) y[i] * Q * 64);
+      vHd = esl_avx512_rightshift_int8(Hp[Q-1], vzero);
+      vIX = vzero;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm512_subs_epu8(_mm512_adds_epu8(vHd, sv[q]), vbias);
+	  vIY   = _mm512_max_epu8(_mm512_subs_epu8(Mp[q], vgo), _mm512_subs_epu8(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm512_max_epu8(_mm512_max_epu8(vM, vIY), vIX);
+	  vmax  = _mm512_max_epu8(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm512_max_epu8(_mm512_subs_epu8(vM, vgo), _mm512_subs_epu8(vIX, vge));
+	}
+
+      vIX = esl_avx512_rightshift_int8(vIX, vzero);
+      q   = 0;
+      while (_mm512_cmpgt_epu8_mask(vIX, IX[q]))
+	{
+	  IX[q] = _mm512_max_epu8(IX[q], vIX);
+	  Hp[q] = _mm512_max_epu8(Hp[q], vIX);
+	  vIX   = _mm512_subs_epu8(vIX, vge);
+	  if (++q == Q) { vIX = esl_avx512_rightshift_int8(vIX, vzero); q = 0; }
+	}
+
+      if (_mm512_cmpgt_epu8_mask(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && _mm512_cmpgt_epu8_mask(vmax, vbest))
+	{
+	  best  = esl_avx512_hmax_epu8(vmax);
+	  vbest = _mm512_set1_epi8((char) best);
+	  bi    = i;
+	  bj    = first_j_epu8(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_avx512_hmax_epu8(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_striped16_avx512()
+ * Synopsis:  Striped Smith/Waterman score, 16-bit AVX-512 version.
+ *
+ * Purpose:   Same as <esl_swat_striped16_sse()>, 32 lanes at a time.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches 32767.
+ */
+int
+esl_swat_striped16_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q16;
+  __m512i       *Hp      = (__m512i *) dp;
+  __m512i       *Mp      = Hp  + Q;
+  __m512i       *IYp     = Mp  + Q;
+  __m512i       *IX      = IYp + Q;
+  __m512i        vgo     = _mm512_set1_epi16((int16_t) (-prof->gop));
+  __m512i        vge     = _mm512_set1_epi16((int16_t) (-prof->gex));
+  __m512i        vlimit  = _mm512_set1_epi16(32766);
+  __m512i        vneginf = _mm512_set1_epi16(-32768);
+  __m512i        vinfmsk = _mm512_maskz_set1_epi16(1, -32768);
+  __m512i        vzero   = _mm512_setzero_si512();
+  __m512i        vmax    = vzero;
+  __m512i        vbest   = vzero;
+  __m512i        vH, vM, vIY, vIX, vHd;
+  const __m512i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m512i *) (prof->p16 + (size_t) y[i] * Q * 32);
+      vHd = esl_avx512_rightshift_int16(Hp[Q-1], vzero);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm512_max_epi16(_mm512_adds_epi16(vHd, sv[q]), vzero);
+	  vIY   = _mm512_max_epi16(_mm512_subs_epi16(Mp[q], vgo), _mm512_subs_epi16(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm512_max_epi16(_mm512_max_epi16(vM, vIY), vIX);
+	  vmax  = _mm512_max_epi16(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm512_max_epi16(_mm512_subs_epi16(vM, vgo), _mm512_subs_epi16(vIX, vge));
+	}
+
+      vIX = esl_avx512_rightshift_int16(vIX, vinfmsk);
+      q   = 0;
+      while (_mm512_cmpgt_epi16_mask(vIX, IX[q]))
+	{
+	  IX[q] = _mm512_max_epi16(IX[q], vIX);
+	  Hp[q] = _mm512_max_epi16(Hp[q], vIX);
+	  vIX   = _mm512_subs_epi16(vIX, vge);
+	  if (++q == Q) { vIX = esl_avx512_rightshift_int16(vIX, vinfmsk); q = 0; }
+	}
+
+      if (_mm512_cmpgt_epi16_mask(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && _mm512_cmpgt_epi16_mask(vmax, vbest))
+	{
+	  best  = esl_avx512_hmax_epi16(vmax);
+	  vbest = _mm512_set1_epi16((int16_t) best);
+	  bi    = i;
+	  bj    = first_j_epi16(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_avx512_hmax_epi16(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_striped32_avx512()
+ * Synopsis:  Striped Smith/Waterman score, 32-bit AVX-512 version.
+ *
+ * Purpose:   Same as <esl_swat_striped32_sse()>, 16 lanes at a time.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_swat_striped32_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q32;
+  __m512i       *Hp      = (__m512i *) dp;
+  __m512i       *Mp      = Hp  + Q;
+  __m512i       *IYp     = Mp  + Q;
+  __m512i       *IX      = IYp + Q;
+  __m512i        vgo     = _mm512_set1_epi32(-prof->gop);
+  __m512i        vge     = _mm512_set1_epi32(-prof->gex);
+  __m512i        vneginf = _mm512_set1_epi32(-(1 << 30));
+  __m512i        vinfmsk = _mm512_maskz_set1_epi32(1, -(1 << 30));
+  __m512i        vzero   = _mm512_setzero_si512();
+  __m512i        vmax    = vzero;
+  __m512i        vbest   = vzero;
+  __m512i        vH, vM, vIY, vIX, vHd;
+  const __m512i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m512i *) (prof->p32 + (size_t) y[i] * Q * 16);
+      vHd = rightshift_int32(Hp[Q-1], vzero);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm512_max_epi32(_mm512_add_epi32(vHd, sv[q]), vzero);
+	  vIY   = _mm512_max_epi32(_mm512_sub_epi32(Mp[q], vgo), _mm512_sub_epi32(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm512_max_epi32(_mm512_max_epi32(vM, vIY), vIX);
+	  vmax  = _mm512_max_epi32(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm512_max_epi32(_mm512_sub_epi32(vM, vgo), _mm512_sub_epi32(vIX, vge));
+	}
+
+      vIX = rightshift_int32(vIX, vinfmsk);
+      q   = 0;
+      while (_mm512_cmpgt_epi32_mask(vIX, IX[q]))
+	{
+	  IX[q] = _mm512_max_epi32(IX[q], vIX);
+	  Hp[q] = _mm512_max_epi32(Hp[q], vIX);
+	  vIX   = _mm512_sub_epi32(vIX, vge);
+	  if (++q == Q) { vIX = rightshift_int32(vIX, vinfmsk); q = 0; }
+	}
+
+      if (opt_i && _mm512_cmpgt_epi32_mask(vmax, vbest))
+	{
+	  best  = _mm512_reduce_max_epi32(vmax);
+	  vbest = _mm512_set1_epi32(best);
+	  bi    = i;
+	  bj    = first_j_epi32(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = _mm512_reduce_max_epi32(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_inter16_avx512()
+ * Synopsis:  Smith/Waterman scores of 32 targets at once, 16-bit AVX-512.
+ *
+ * Purpose:   Same as <esl_swat_inter16_sse()>, 32 targets at a time.
+ *            Each row's score table is made by 16-bit permutes of
+ *            the profile's 32-wide score rows (AVX-512BW).
+ *
+ * Returns:   <eslOK>. A score of 32767 may have saturated; caller
+ *            must rescore that target with a wider implementation.
+ */
+int
+esl_swat_inter16_avx512(const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc)
+{
+  int            L       = prof->L;
+  int            Kp      = prof->Kp;
+  __m512i       *Hp      = (__m512i *) dp;
+  __m512i       *Mp      = Hp  + (L+1);
+  __m512i       *IYp     = Mp  + (L+1);
+  __m512i       *T       = IYp + (L+1);
+  __m512i        vgo     = _mm512_set1_epi16((int16_t) (-prof->gop));
+  __m512i        vge     = _mm512_set1_epi16((int16_t) (-prof->gex));
+  __m512i        vneginf = _mm512_set1_epi16(-32768);
+  __m512i        vzero   = _mm512_setzero_si512();
+  __m512i        vmax    = vzero;
+  __m512i        vH, vM, vIY, vIX, vHd;
+  union { __m512i v; int16_t x[32]; } u;
+  union { __m512i v; int16_t x[32]; } yk;
+  int            maxM    = 0;
+  int            i, j, k, a;
+
+  for (k = 0; k < n; k++) maxM = ESL_MAX(maxM, M[k]);
+  for (j = 0; j <= L; j++) Hp[j] = Mp[j] = IYp[j] = vzero;
+
+  for (i = 1; i <= maxM; i++)
+    {
+      for (k = 0; k < 32; k++) yk.x[k] = (k < n && i <= M[k] ? y[k][i] : 31);
+      for (a = 0; a < Kp; a++)
+	T[a] = _mm512_permutexvar_epi16(yk.v, _mm512_loadu_si512((const void *) (prof->s16 + a*32)));
+
+      vHd = vzero;
+      vIX = vneginf;
+      for (j = 1; j <= L; j++)
+	{
+	  vM     = _mm512_max_epi16(_mm512_adds_epi16(vHd, T[prof->x[j]]), vzero);
+	  vIY    = _mm512_max_epi16(_mm512_subs_epi16(Mp[j], vgo), _mm512_subs_epi16(IYp[j], vge));
+	  vHd    = Hp[j];
+	  vH     = _mm512_max_epi16(_mm512_max_epi16(vM, vIY), vIX);
+	  vmax   = _mm512_max_epi16(vmax, vM);
+	  Hp[j]  = vH;  Mp[j] = vM;  IYp[j] = vIY;
+	  vIX    = _mm512_max_epi16(_mm512_subs_epi16(vM, vgo), _mm512_subs_epi16(vIX, vge));
+	}
+    }
+
+  u.v = vmax;
+  for (k = 0; k < n; k++) sc[k] = u.x[k];
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_adiag_avx512()
+ * Synopsis:  One anti-diagonal of banded DP, AVX-512 version.
+ *
+ * Purpose:   Compute cells <lo..hi> of an anti-diagonal for
+ *            <swat_band()> in esl_swat.c, 16 at a time: given
+ *            the previous anti-diagonal's <mp>, <xp>, <yp>, the
+ *            one before's <hpp>, and the gathered scores <s>, set
+ *            <mc>, <xc>, <yc>, and their max <hc>. Rows are the
+ *            array indices; <mmin> is the floor on M(i-1,j-1).
+ *            Cells past the last whole vector are done serially,
+ *            so nothing outside <lo..hi> is written.
+ */
+void
+esl_swat_adiag_avx512(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                      int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex)
+{
+  __m512i vmin = _mm512_set1_epi32(mmin);
+  __m512i vgo  = _mm512_set1_epi32(gop);
+  __m512i vge  = _mm512_set1_epi32(gex);
+  __m512i vM, vX, vY;
+  int     i, m, x, y;
+
+  for (i = lo; i + 16 <= hi + 1; i += 16)
+    {
+      vM = _mm512_add_epi32(_mm512_max_epi32(_mm512_loadu_si512((const void *) (hpp + i - 1)), vmin), _mm512_loadu_si512((const void *) (s + i)));
+      vX = _mm512_max_epi32(_mm512_add_epi32(_mm512_loadu_si512((const void *) (mp + i)),     vgo), _mm512_add_epi32(_mm512_loadu_si512((const void *) (xp + i)),     vge));
+      vY = _mm512_max_epi32(_mm512_add_epi32(_mm512_loadu_si512((const void *) (mp + i - 1)), vgo), _mm512_add_epi32(_mm512_loadu_si512((const void *) (yp + i - 1)), vge));
+      _mm512_storeu_si512((void *) (mc + i), vM);
+      _mm512_storeu_si512((void *) (xc + i), vX);
+      _mm512_storeu_si512((void *) (yc + i), vY);
+      _mm512_storeu_si512((void *) (hc + i), _mm512_max_epi32(vM, _mm512_max_epi32(vX, vY)));
+    }
+  for (; i <= hi; i++)
+    {
+      m     = ESL_MAX(hpp[i-1], mmin) + s[i];
+      x     = ESL_MAX(mp[i]   + gop, xp[i]   + gex);
+      y     = ESL_MAX(mp[i-1] + gop, yp[i-1] + gex);
+      mc[i] = m;
+      xc[i] = x;
+      yc[i] = y;
+      hc[i] = ESL_MAX(m, ESL_MAX(x, y));
+    }
+}
+
+#else // ! eslENABLE_AVX512
+void esl_swat_avx512_silence_hack(void) { return; }
+#endif // eslENABLE_AVX512 or not
@@ -0,0 +1,453 @@
+/* Striped Smith/Waterman scoring: SSE implementation.
+ *
+ * esl_swat_StripedScore() calls these for an ESL_SWAT_PROFILE that
+ * was striped for SSE (16-byte vectors), trying 8-bit scores first,
+ * then 16-bit, then 32-bit if the score overflows. Also, the
+ * anti-diagonal inner loop of banded alignment, for swat_band().
+ *
+ * This code is conditionally compiled, only when <eslENABLE_SSE> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_SSE
+
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_sse.h"
+#include "esl_swat.h"
+
+/* first_j_*()
+ * Return the smallest query position j whose match score in striped
+ * row <Mp> (Q segments) is <v>, or 0 if none. <vv> is <v> in every
+ * lane. Used to find the end of the best alignment.
+ */
+static int
+first_j_epu8(const __m128i *Mp, int Q, __m128i vv, int v)
+{
+  const uint8_t *m = (const uint8_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(Mp[q], vv)))
+      for (k = 0; k < 16; k++)
+	if (m[q*16 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi16(const __m128i *Mp, int Q, __m128i vv, int v)
+{
+  const int16_t *m = (const int16_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(Mp[q], vv)))
+      for (k = 0; k < 8; k++)
+	if (m[q*8 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+static int
+first_j_epi32(const __m128i *Mp, int Q, __m128i vv, int v)
+{
+  const int32_t *m = (const int32_t *) Mp;
+  int q, k;
+  int j = 0;
+
+  for (q = 0; q < Q; q++)
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(Mp[q], vv)))
+      for (k = 0; k < 4; k++)
+	if (m[q*4 + k] == v) { if (j == 0 || k*Q + q + 1 < j) j = k*Q + q + 1; break; }
+  return j;
+}
+
+/* hmax_epi32()
+ * Return the max of the four int32 elements of <v>.
+ */
+static inline int
+hmax_epi32(__m128i v)
+{
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+
+/* Function:  esl_swat_striped8_sse()
+ * Synopsis:  Striped Smith/Waterman score, 8-bit SSE version.
+ *
+ * Purpose:   Score target <y[1..M]> against the query profile <prof>,
+ *            in 16 lanes of unsigned 8-bit saturated scores, using
+ *            <dp> as workspace: 4*<prof->Q8> aligned <__m128i>.
+ *            Return the score in <*ret_sc>.
+ *
+ *            The recursion is that of <esl_swat_Score()>. Every
+ *            value is floored at 0, which changes none that matter:
+ *            a negative cell can't start or extend an alignment
+ *            better than a new start at 0 does. Gaps open from
+ *            match cells only.
+ *
+ *            The query's striping follows Farrar (2007). Gaps along
+ *            the target, which come from the previous row, are
+ *            vectorized directly. Gaps along the query are run
+ *            through the segments once, then their carry from each
+ *            lane into the next is propagated in a "lazy-F" loop
+ *            that stops as soon as it can no longer improve any
+ *            cell.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches <255 - prof->bias>,
+ *            where it may have saturated; caller should try again
+ *            with wider scores.
+ *
+ * Xref:      Farrar, Bioinformatics 23:156-161, 2007.
+ */
+int
+esl_swat_striped8_sse(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q      = prof->Q8;
+  __m128i       *Hp     = (__m128i *) dp;  // max(M,IX,IY) of the previous row; after the row, this one
+  __m128i       *Mp     = Hp  + Q;         // match scores of the previous row
+  __m128i       *IYp    = Mp  + Q;         // target-gap scores of the previous row
+  __m128i       *IX     = IYp + Q;         // query-gap scores of this row
+  __m128i        vgo    = _mm_set1_epi8((char) (-prof->gop));
+  __m128i        vge    = _mm_set1_epi8((char) (-prof->gex));
+  __m128i        vbias  = _mm_set1_epi8((char) prof->bias);
+  __m128i        vlimit = _mm_set1_epi8((char) (254 - prof->bias));
+  __m128i        vzero  = _mm_setzero_si128();
+  __m128i        vmax   = vzero;
+  __m128i        vbest  = vzero;
+  __m128i        vH, vM, vIY, vIX, vHd;
+  const __m128i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m128i *) (prof->p8 + (size_t) y[i] * Q * 16);
+      vHd = esl_sse_rightshift_int8(Hp[Q-1], vzero);
+      vIX = vzero;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm_subs_epu8(_mm_adds_epu8(vHd, sv[q]), vbias);
+	  vIY   = _mm_max_epu8(_mm_subs_epu8(Mp[q], vgo), _mm_subs_epu8(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm_max_epu8(_mm_max_epu8(vM, vIY), vIX);
+	  vmax  = _mm_max_epu8(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm_max_epu8(_mm_subs_epu8(vM, vgo), _mm_subs_epu8(vIX, vge));
+	}
+
+      /* lazy-F: carry query gaps across lanes until they stop helping */
+      vIX = esl_sse_rightshift_int8(vIX, vzero);
+      q   = 0;
+      while (esl_sse_any_gt_epu8(vIX, IX[q]))
+	{
+	  IX[q] = _mm_max_epu8(IX[q], vIX);
+	  Hp[q] = _mm_max_epu8(Hp[q], vIX);
+	  vIX   = _mm_subs_epu8(vIX, vge);
+	  if (++q == Q) { vIX = esl_sse_rightshift_int8(vIX, vzero); q = 0; }
+	}
+
+      if (esl_sse_any_gt_epu8(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && esl_sse_any_gt_epu8(vmax, vbest))
+	{
+	  best  = esl_sse_hmax_epu8(vmax);
+	  vbest = _mm_set1_epi8((char) best);
+	  bi    = i;
+	  bj    = first_j_epu8(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_sse_hmax_epu8(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_striped16_sse()
+ * Synopsis:  Striped Smith/Waterman score, 16-bit SSE version.
+ *
+ * Purpose:   Same as <esl_swat_striped8_sse()>, in 8 lanes of signed
+ *            16-bit saturated scores, with no bias. Gap scores may go
+ *            negative here, so the query-gap carry shifts -inf, not
+ *            0, into its first lane.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score reaches 32767.
+ */
+int
+esl_swat_striped16_sse(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q16;
+  __m128i       *Hp      = (__m128i *) dp;
+  __m128i       *Mp      = Hp  + Q;
+  __m128i       *IYp     = Mp  + Q;
+  __m128i       *IX      = IYp + Q;
+  __m128i        vgo     = _mm_set1_epi16((int16_t) (-prof->gop));
+  __m128i        vge     = _mm_set1_epi16((int16_t) (-prof->gex));
+  __m128i        vlimit  = _mm_set1_epi16(32766);
+  __m128i        vneginf = _mm_set1_epi16(-32768);
+  __m128i        vinfmsk = _mm_insert_epi16(_mm_setzero_si128(), -32768, 0);
+  __m128i        vzero   = _mm_setzero_si128();
+  __m128i        vmax    = vzero;
+  __m128i        vbest   = vzero;
+  __m128i        vH, vM, vIY, vIX, vHd;
+  const __m128i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m128i *) (prof->p16 + (size_t) y[i] * Q * 8);
+      vHd = esl_sse_rightshift_int16(Hp[Q-1], vzero);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm_max_epi16(_mm_adds_epi16(vHd, sv[q]), vzero);
+	  vIY   = _mm_max_epi16(_mm_subs_epi16(Mp[q], vgo), _mm_subs_epi16(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm_max_epi16(_mm_max_epi16(vM, vIY), vIX);
+	  vmax  = _mm_max_epi16(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm_max_epi16(_mm_subs_epi16(vM, vgo), _mm_subs_epi16(vIX, vge));
+	}
+
+      vIX = esl_sse_rightshift_int16(vIX, vinfmsk);
+      q   = 0;
+      while (esl_sse_any_gt_epi16(vIX, IX[q]))
+	{
+	  IX[q] = _mm_max_epi16(IX[q], vIX);
+	  Hp[q] = _mm_max_epi16(Hp[q], vIX);
+	  vIX   = _mm_subs_epi16(vIX, vge);
+	  if (++q == Q) { vIX = esl_sse_rightshift_int16(vIX, vinfmsk); q = 0; }
+	}
+
+      if (esl_sse_any_gt_epi16(vmax, vlimit)) { *ret_sc = 0; return eslERANGE; }
+
+      if (opt_i && esl_sse_any_gt_epi16(vmax, vbest))
+	{
+	  best  = esl_sse_hmax_epi16(vmax);
+	  vbest = _mm_set1_epi16((int16_t) best);
+	  bi    = i;
+	  bj    = first_j_epi16(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = esl_sse_hmax_epi16(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_inter16_sse()
+ * Synopsis:  Smith/Waterman scores of 8 targets at once, 16-bit SSE.
+ *
+ * Purpose:   Score up to 8 targets <y[0..n-1]>, of lengths
+ *            <M[0..n-1]>, against query profile <prof>, one target
+ *            per 16-bit lane (Rognes 2011), using <dp> as workspace:
+ *            3*(<prof->L>+1) + <prof->Kp> aligned <__m128i>. Return
+ *            the scores in <sc[0..n-1]>.
+ *
+ *            The query runs through the DP in order, so there are no
+ *            lane-to-lane carries; this beats striping when targets
+ *            are short, when the striped setup per target dominates.
+ *            Each target row builds a table of scores of the 8 target
+ *            residues against each query residue type. Lanes past the
+ *            end of their target use padding code 31, which scores
+ *            -32768 against everything, and that zeroes them.
+ *
+ *            Needs <prof->s16>, which the profile only has if the
+ *            scoring system fits 16 bits.
+ *
+ * Returns:   <eslOK>. A score of 32767 may have saturated; caller
+ *            must rescore that target with a wider implementation.
+ *
+ * Xref:      Rognes, BMC Bioinformatics 12:221, 2011.
+ */
+int
+esl_swat_inter16_sse(const ESL_SWAT_PROFILE *prof, const ESL_DSQ **y, const int *M, int n, void *dp, int *sc)
+{
+  int            L       = prof->L;
+  int            Kp      = prof->Kp;
+  __m128i       *Hp      = (__m128i *) dp;
+  __m128i       *Mp      = Hp  + (L+1);
+  __m128i       *IYp     = Mp  + (L+1);
+  __m128i       *T       = IYp + (L+1);
+  int16_t       *t       = (int16_t *) T;
+  __m128i        vgo     = _mm_set1_epi16((int16_t) (-prof->gop));
+  __m128i        vge     = _mm_set1_epi16((int16_t) (-prof->gex));
+  __m128i        vneginf = _mm_set1_epi16(-32768);
+  __m128i        vzero   = _mm_setzero_si128();
+  __m128i        vmax    = vzero;
+  __m128i        vH, vM, vIY, vIX, vHd;
+  union { __m128i v; int16_t x[8]; } u;
+  int16_t        yk[8];
+  const int16_t *row;
+  int            maxM    = 0;
+  int            i, j, k, a;
+
+  for (k = 0; k < n; k++) maxM = ESL_MAX(maxM, M[k]);
+  for (j = 0; j <= L; j++) Hp[j] = Mp[j] = IYp[j] = vzero;
+
+  for (i = 1; i <= maxM; i++)
+    {
+      for (k = 0; k < 8; k++) yk[k] = (k < n && i <= M[k] ? y[k][i] : 31);
+      for (a = 0; a < Kp; a++)
+	{
+	  row = prof->s16 + a*32;
+	  for (k = 0; k < 8; k++) t[a*8 + k] = row[yk[k]];
+	}
+
+      vHd = vzero;
+      vIX = vneginf;
+      for (j = 1; j <= L; j++)
+	{
+	  vM     = _mm_max_epi16(_mm_adds_epi16(vHd, T[prof->x[j]]), vzero);
+	  vIY    = _mm_max_epi16(_mm_subs_epi16(Mp[j], vgo), _mm_subs_epi16(IYp[j], vge));
+	  vHd    = Hp[j];
+	  vH     = _mm_max_epi16(_mm_max_epi16(vM, vIY), vIX);
+	  vmax   = _mm_max_epi16(vmax, vM);
+	  Hp[j]  = vH;  Mp[j] = vM;  IYp[j] = vIY;
+	  vIX    = _mm_max_epi16(_mm_subs_epi16(vM, vgo), _mm_subs_epi16(vIX, vge));
+	}
+    }
+
+  u.v = vmax;
+  for (k = 0; k < n; k++) sc[k] = u.x[k];
+  return eslOK;
+}
+
+
+#ifdef eslENABLE_SSE4
+/* Function:  esl_swat_striped32_sse()
+ * Synopsis:  Striped Smith/Waterman score, 32-bit SSE4.1 version.
+ *
+ * Purpose:   Same as <esl_swat_striped16_sse()>, in 4 lanes of 32-bit
+ *            scores, which are assumed not to overflow. Needs
+ *            SSE4.1, for <_mm_max_epi32()>.
+ *
+ * Returns:   <eslOK>.
+ */
+int
+esl_swat_striped32_sse(const ESL_SWAT_PROFILE *prof, const ESL_DSQ *y, int M, void *dp, int *ret_sc, int *opt_i, int *opt_j)
+{
+  int            Q       = prof->Q32;
+  __m128i       *Hp      = (__m128i *) dp;
+  __m128i       *Mp      = Hp  + Q;
+  __m128i       *IYp     = Mp  + Q;
+  __m128i       *IX      = IYp + Q;
+  __m128i        vgo     = _mm_set1_epi32(-prof->gop);
+  __m128i        vge     = _mm_set1_epi32(-prof->gex);
+  __m128i        vneginf = _mm_set1_epi32(-(1 << 30));
+  __m128i        vinfmsk = _mm_insert_epi32(_mm_setzero_si128(), -(1 << 30), 0);
+  __m128i        vzero   = _mm_setzero_si128();
+  __m128i        vmax    = vzero;
+  __m128i        vbest   = vzero;
+  __m128i        vH, vM, vIY, vIX, vHd;
+  const __m128i *sv;
+  int            best = 0, bi = 0, bj = 0;
+  int            i, q;
+
+  for (q = 0; q < Q; q++) Hp[q] = Mp[q] = IYp[q] = vzero;
+
+  for (i = 1; i <= M; i++)
+    {
+      sv  = (const __m128i *) (prof->p32 + (size_t) y[i] * Q * 4);
+      vHd = _mm_slli_si128(Hp[Q-1], 4);
+      vIX = vneginf;
+      for (q = 0; q < Q; q++)
+	{
+	  vM    = _mm_max_epi32(_mm_add_epi32(vHd, sv[q]), vzero);
+	  vIY   = _mm_max_epi32(_mm_sub_epi32(Mp[q], vgo), _mm_sub_epi32(IYp[q], vge));
+	  vHd   = Hp[q];
+	  vH    = _mm_max_epi32(_mm_max_epi32(vM, vIY), vIX);
+	  vmax  = _mm_max_epi32(vmax, vM);
+	  Hp[q] = vH;  Mp[q] = vM;  IYp[q] = vIY;  IX[q] = vIX;
+	  vIX   = _mm_max_epi32(_mm_sub_epi32(vM, vgo), _mm_sub_epi32(vIX, vge));
+	}
+
+      vIX = _mm_or_si128(_mm_slli_si128(vIX, 4), vinfmsk);
+      q   = 0;
+      while (_mm_movemask_epi8(_mm_cmpgt_epi32(vIX, IX[q])))
+	{
+	  IX[q] = _mm_max_epi32(IX[q], vIX);
+	  Hp[q] = _mm_max_epi32(Hp[q], vIX);
+	  vIX   = _mm_sub_epi32(vIX, vge);
+	  if (++q == Q) { vIX = _mm_or_si128(_mm_slli_si128(vIX, 4), vinfmsk); q = 0; }
+	}
+
+      if (opt_i && _mm_movemask_epi8(_mm_cmpgt_epi32(vmax, vbest)))
+	{
+	  best  = hmax_epi32(vmax);
+	  vbest = _mm_set1_epi32(best);
+	  bi    = i;
+	  bj    = first_j_epi32(Mp, Q, vbest, best);
+	}
+    }
+
+  *ret_sc = hmax_epi32(vmax);
+  if (opt_i) { *opt_i = bi; *opt_j = bj; }
+  return eslOK;
+}
+
+
+/* Function:  esl_swat_adiag_sse()
+ * Synopsis:  One anti-diagonal of banded DP, SSE4.1 version.
+ *
+ * Purpose:   Compute cells <lo..hi> of an anti-diagonal for
+ *            <swat_band()> in esl_swat.c, 4 at a time: given
+ *            the previous anti-diagonal's <mp>, <xp>, <yp>, the
+ *            one before's <hpp>, and the gathered scores <s>, set
+ *            <mc>, <xc>, <yc>, and their max <hc>. Rows are the
+ *            array indices; <mmin> is the floor on M(i-1,j-1).
+ *            Cells past the last whole vector are done serially,
+ *            so nothing outside <lo..hi> is written.
+ */
+void
+esl_swat_adiag_sse(const int *hpp, const int *mp, const int *xp, const int *yp, const int *s,
+                   int *mc, int *xc, int *yc, int *hc, int lo, int hi, int mmin, int gop, int gex)
+{
+  __m128i vmin = _mm_set1_epi32(mmin);
+  __m128i vgo  = _mm_set1_epi32(gop);
+  __m128i vge  = _mm_set1_epi32(gex);
+  __m128i vM, vX, vY;
+  int     i, m, x, y;
+
+  for (i = lo; i + 4 <= hi + 1; i += 4)
+    {
+      vM = _mm_add_epi32(_mm_max_epi32(_mm_loadu_si128((const __m128i *) (hpp + i - 1)), vmin), _mm_loadu_si128((const __m128i *) (s + i)));
+      vX = _mm_max_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *) (mp + i)),     vgo), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (xp + i)),     vge));
+      vY = _mm_max_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *) (mp + i - 1)), vgo), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (yp + i - 1)), vge));
+      _mm_storeu_si128((__m128i *) (mc + i), vM);
+      _mm_storeu_si128((__m128i *) (xc + i), vX);
+      _mm_storeu_si128((__m128i *) (yc + i), vY);
+      _mm_storeu_si128((__m128i *) (hc + i), _mm_max_epi32(vM, _mm_max_epi32(vX, vY)));
+    }
+  for (; i <= hi; i++)
+    {
+      m     = ESL_MAX(hpp[i-1], mmin) + s[i];
+      x     = ESL_MAX(mp[i]   + gop, xp[i]   + gex);
+      y     = ESL_MAX(mp[i-1] + gop, yp[i-1] + gex);
+      mc[i] = m;
+      xc[i] = x;
+      yc[i] = y;
+      hc[i] = ESL_MAX(m, ESL_MAX(x, y));
+    }
+}
+#endif // eslENABLE_SSE4
+
+
+#else // ! eslENABLE_SSE
+void esl_swat_sse_silence_hack(void) { return; }
+#endif // eslENABLE_SSE or not
@@ -16,12 +16,19 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "easel.h"
 #include "esl_arr2.h"
 #include "esl_dmatrix.h"
+#include "esl_keyhash.h"
 #include "esl_random.h"
 #include "esl_stack.h"
+#ifdef HAVE_PTHREAD
+#include "esl_threads.h"
+#endif
 #include "esl_vectorops.h"
 
 #include "esl_tree.h"
@@ -1418,6 +1425,56 @@ esl_tree_ReadNewick(FILE *fp, char *errbuf, ESL_TREE **ret_T)
  * 3. Tree comparison algorithms
  *****************************************************************/
 
+/* tree_map_taxa()
+ * Set <Mgt[a]> to the index of the taxon in <T2> that's equivalent
+ * to taxon <a> in <T1>: by taxon label, using a keyhash of <T2>'s
+ * labels (O(N) expected), if both trees are labeled; else by
+ * index. Throws <eslEINVAL> if the taxa can't be mapped one to one.
+ */
+static int
+tree_map_taxa(ESL_TREE *T1, ESL_TREE *T2, int *Mgt)
+{
+  ESL_KEYHASH *kh   = NULL;
+  char        *used = NULL;
+  int          a;
+  int          status;
+
+  if (T1->taxonlabel != NULL && T2->taxonlabel != NULL)
+    {
+      if ((kh = esl_keyhash_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+      ESL_ALLOC(used, sizeof(char) * T2->N);
+      for (a = 0; a < T2->N; a++)
+	{
+	  status = esl_keyhash_Store(kh, T2->taxonlabel[a], -1, NULL);
+	  if      (status == eslEDUP) ESL_XEXCEPTION(eslEINVAL, "taxon labels aren't unique");
+	  else if (status != eslOK)   goto ERROR;
+	  used[a] = FALSE;
+	}
+      for (a = 0; a < T1->N; a++)
+	{
+	  if (esl_keyhash_Lookup(kh, T1->taxonlabel[a], -1, &(Mgt[a])) != eslOK || used[Mgt[a]])
+	    ESL_XEXCEPTION(eslEINVAL, "couldn't map taxa");
+	  used[Mgt[a]] = TRUE;
+	}
+    }
+  else if (T1->taxonlabel == NULL && T2->taxonlabel == NULL)
+    {
+      for (a = 0; a < T1->N; a++)
+	Mgt[a] = a;
+    }
+  else
+    ESL_XEXCEPTION(eslEINVAL, "either both trees must have taxon labels, or neither");      
+
+  esl_keyhash_Destroy(kh);
+  free(used);
+  return eslOK;
+
+ ERROR:
+  esl_keyhash_Destroy(kh);
+  free(used);
+  return status;
+}
+
 /* Function:  esl_tree_Compare()
  *
  * Purpose:   Given two trees <T1> and <T2> for the same
@@ -1474,33 +1531,12 @@ esl_tree_Compare(ESL_TREE *T1, ESL_TREE *T2)
    *
    * For the taxa, Mgt[g] for taxon g in T1 is the index of the
    * corresponding taxon in T2. If neither tree has taxon labels
-   * Mgt[g] = g for all g. Otherwise we have to compare labels. Right
-   * now, we do this by brute force, which is O(N^2); if this ever
-   * becomes rate limiting, replace it with a keyhash to make it O(N)
-   * (and in fact, the keyhash of taxon names could even become part
-   * of the ESL_TREE).
+   * Mgt[g] = g for all g. Otherwise we look up T1's labels in a
+   * keyhash of T2's labels.
    */
   ESL_ALLOC(Mg,  sizeof(int) * (T1->N-1));  
   ESL_ALLOC(Mgt, sizeof(int) * (T1->N));
-  if (T1->taxonlabel != NULL && T2->taxonlabel != NULL)
-    {
-      esl_vec_ISet(Mgt, T1->N, -1);	/* flags for "unset" */
-      for (a = 0; a < T1->N; a++)
-	{
-	  for (b = 0; b < T1->N; b++)
-	    if (strcmp(T1->taxonlabel[a], T2->taxonlabel[b]) == 0) 
-	      { Mgt[a] = b; break; }
-	}
-      for (a = 0; a < T1->N; a++)
-	if (Mgt[a] == -1) ESL_XEXCEPTION(eslEINVAL, "couldn't map taxa");
-    }
-  else if (T1->taxonlabel == NULL && T2->taxonlabel == NULL)
-    {
-      for (a = 0; a < T1->N; a++)
-	Mgt[a] = a;
-    }
-  else
-    ESL_XEXCEPTION(eslEINVAL, "either both trees must have taxon labels, or neither");      
+  if ((status = tree_map_taxa(T1, T2, Mgt)) != eslOK) goto ERROR;
 
   /* Finally, we use the SDI algorithm [ZmasekEddy01] to construct
    * M(g) for internal nodes, by postorder traversal of T1.
@@ -1530,6 +1566,188 @@ esl_tree_Compare(ESL_TREE *T1, ESL_TREE *T2)
   return status;
 }
 
+
+/* tree_mix()
+ * 64-bit finalizer (splitmix64), for giving taxa random-looking keys.
+ */
+static uint64_t
+tree_mix(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/* tree_splits()
+ * Collect the nontrivial splits (bipartitions, each with >= 2 taxa
+ * on both sides) of <T> as 64-bit keys in <split>, which has room
+ * for at least N-3 of them; return their number in <*ret_nsplit>.
+ *
+ * Taxon <a> of <T> has random key <tkey[a]>; a set of taxa is keyed
+ * by the XOR of its members' keys, so a clade's key is the XOR of its
+ * children's, in one postorder pass. Each split is keyed by its side
+ * that doesn't contain taxon <ref>, which makes the key independent
+ * of where <T> is rooted. The two branches at the root of <T> are one
+ * branch of the unrooted tree; count their split once.
+ *
+ * Two different splits get the same key with probability 2^-64, so
+ * comparing keys compares splits, for any practical number of trees.
+ */
+static int
+tree_splits(ESL_TREE *T, const uint64_t *tkey, int ref, uint64_t *split, int *ret_nsplit)
+{
+  uint64_t *h    = NULL;	/* key of clade under each node [0..N-2] */
+  int      *sz   = NULL;	/* # of taxa in it */
+  char     *hasr = NULL;	/* TRUE if it contains taxon <ref> */
+  uint64_t  all  = 0;
+  int       nsplit = 0;
+  int       g, c, side, k;
+  int       status;
+
+  ESL_ALLOC(h,    sizeof(uint64_t) * (T->N-1));
+  ESL_ALLOC(sz,   sizeof(int)      * (T->N-1));
+  ESL_ALLOC(hasr, sizeof(char)     * (T->N-1));
+  for (c = 0; c < T->N; c++) all ^= tkey[c];
+
+  for (g = T->N-2; g >= 0; g--)	/* preorder numbering: children come after their parent */
+    {
+      h[g] = 0; sz[g] = 0; hasr[g] = FALSE;
+      for (side = 0; side < 2; side++)
+	{
+	  c = (side == 0 ? T->left[g] : T->right[g]);
+	  if (c <= 0) { h[g] ^= tkey[-c]; sz[g] += 1;     if (-c == ref) hasr[g] = TRUE; }
+	  else        { h[g] ^= h[c];     sz[g] += sz[c]; if (hasr[c])   hasr[g] = TRUE; }
+	}
+
+      if (g == 0) continue;
+      if (T->parent[g] == 0 && T->right[0] == g && T->left[0] > 0) continue; /* same split as the root's left child */
+      k = (hasr[g] ? T->N - sz[g] : sz[g]);
+      if (k < 2 || k > T->N-2) continue;
+      split[nsplit++] = (hasr[g] ? h[g] ^ all : h[g]);
+    }
+
+  free(h);
+  free(sz);
+  free(hasr);
+  *ret_nsplit = nsplit;
+  return eslOK;
+
+ ERROR:
+  free(h);
+  free(sz);
+  free(hasr);
+  *ret_nsplit = 0;
+  return status;
+}
+
+
+/* Function:  esl_tree_RobinsonFoulds()
+ * Synopsis:  Robinson-Foulds distance between two trees.
+ *
+ * Purpose:   Calculate the Robinson-Foulds distance between the
+ *            unrooted topologies of trees <T1> and <T2> for the same
+ *            <N> taxa: the number of nontrivial splits (bipartitions
+ *            of the taxa, induced by cutting one internal branch)
+ *            that are in one tree but not the other. Where either
+ *            tree is rooted doesn't matter, and neither do branch
+ *            lengths. Return the distance in <*ret_rf>. 
+ *            
+ *            Optionally, return in <*opt_maxrf> the total number of
+ *            nontrivial splits in the two trees, which is the
+ *            largest the distance can be; <2(N-3)> if both trees
+ *            are fully resolved. <*ret_rf / *opt_maxrf> is the
+ *            normalized RF distance, in [0,1].
+ *
+ *            Taxa in the two trees are matched as in
+ *            <esl_tree_Compare()>: by their labels if both trees
+ *            have them, else by their indices.
+ *
+ *            Splits are compared by hashing (each taxon gets a
+ *            random 64-bit key, a set of taxa is keyed by XOR of its
+ *            members), so the comparison is $O(N)$ expected time,
+ *            and so fast enough for comparing many bootstrap trees
+ *            of large families. In principle two different splits
+ *            can share a key, but the probability is $2^{-64}$ per
+ *            pair of splits.
+ *
+ * Args:      T1, T2    - trees to compare
+ *            ret_rf    - RETURN: Robinson-Foulds distance
+ *            opt_maxrf - optRETURN: total # of nontrivial splits in T1, T2
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error. <eslEINVAL> if the trees
+ *            have different numbers of taxa, or if the taxa can't
+ *            be mapped uniquely and completely to each other (see
+ *            <esl_tree_Compare()>).
+ */
+int
+esl_tree_RobinsonFoulds(ESL_TREE *T1, ESL_TREE *T2, int *ret_rf, int *opt_maxrf)
+{
+  int      *Mgt    = NULL;	/* taxon a in T1 is taxon Mgt[a] in T2 */
+  uint64_t *tkey1  = NULL;	/* random key for each taxon, T1 indexing [0..N-1] */
+  uint64_t *tkey2  = NULL;	/* same keys, T2 indexing */
+  uint64_t *split1 = NULL;
+  uint64_t *split2 = NULL;
+  uint64_t *tbl    = NULL;	/* open-addressing hash table of T1's splits */
+  char     *occ    = NULL;	/* TRUE for the occupied slots of <tbl> */
+  uint64_t  tblmask;
+  int       n1, n2, ncommon;
+  int       a, i;
+  uint64_t  x;
+  int       status;
+
+  if (T1->N != T2->N) ESL_EXCEPTION(eslEINVAL, "trees don't have the same # of taxa");
+
+  ESL_ALLOC(Mgt,    sizeof(int)      * T1->N);
+  ESL_ALLOC(tkey1,  sizeof(uint64_t) * T1->N);
+  ESL_ALLOC(tkey2,  sizeof(uint64_t) * T1->N);
+  ESL_ALLOC(split1, sizeof(uint64_t) * T1->N);
+  ESL_ALLOC(split2, sizeof(uint64_t) * T1->N);
+  if ((status = tree_map_taxa(T1, T2, Mgt)) != eslOK) goto ERROR;
+
+  for (a = 0; a < T1->N; a++)
+    {
+      tkey1[a]      = tree_mix((uint64_t) a);
+      tkey2[Mgt[a]] = tkey1[a];
+    }
+  if ((status = tree_splits(T1, tkey1, 0,      split1, &n1)) != eslOK) goto ERROR;
+  if ((status = tree_splits(T2, tkey2, Mgt[0], split2, &n2)) != eslOK) goto ERROR;
+
+  /* Split keys are already random: use their low bits to index the table. */
+  for (tblmask = 15; tblmask < 2 * (uint64_t) n1; tblmask = (tblmask << 1) | 1) ;
+  ESL_ALLOC(tbl, sizeof(uint64_t) * (tblmask+1));
+  ESL_ALLOC(occ, sizeof(char)     * (tblmask+1));
+  memset(occ, 0, sizeof(char) * (tblmask+1));
+  for (i = 0; i < n1; i++)
+    {
+      for (x = split1[i] & tblmask; occ[x]; x = (x+1) & tblmask) ;
+      tbl[x] = split1[i];
+      occ[x] = TRUE;
+    }
+
+  ncommon = 0;
+  for (i = 0; i < n2; i++)
+    for (x = split2[i] & tblmask; occ[x]; x = (x+1) & tblmask)
+      if (tbl[x] == split2[i]) { ncommon++; break; }
+
+  *ret_rf = (n1 - ncommon) + (n2 - ncommon);
+  if (opt_maxrf) *opt_maxrf = n1 + n2;
+  free(Mgt);  free(tkey1);  free(tkey2);
+  free(split1); free(split2);
+  free(tbl);  free(occ);
+  return eslOK;
+
+ ERROR:
+  free(Mgt);  free(tkey1);  free(tkey2);
+  free(split1); free(split2);
+  free(tbl);  free(occ);
+  *ret_rf = 0;
+  if (opt_maxrf) *opt_maxrf = 0;
+  return status;
+}
+
 /*----------------- end, tree comparison  -----------------------*/
 
 
@@ -1541,6 +1759,25 @@ esl_tree_Compare(ESL_TREE *T1, ESL_TREE *T2)
  * 4. Clustering algorithms for tree construction.
  *****************************************************************/
 
+/* cluster_nn()
+ * Find the nearest neighbor of <row> among columns row+1..N-1 of the
+ * current NxN matrix <D>: the first minimum, as in a row-major scan.
+ */
+static void
+cluster_nn(ESL_DMATRIX *D, int N, int row, int *nn, double *nnd)
+{
+  int col;
+
+  nn[row]  = row+1;
+  nnd[row] = D->mx[row][row+1];
+  for (col = row+2; col < N; col++)
+    if (D->mx[row][col] < nnd[row])
+      {
+	nn[row]  = col;
+	nnd[row] = D->mx[row][col];
+      }
+}
+
 /* cluster_engine()
  * 
  * Implements four clustering algorithms for tree construction:
@@ -1561,17 +1798,28 @@ esl_tree_Compare(ESL_TREE *T1, ESL_TREE *T2)
  * 
  * Throws <eslEMEM> on allocation failure.
  * 
- * Complexity: O(N^2) in memory, O(N^3) in time.
- * 
- * This function can be optimized. Memory usage is at least
- * 4x more than necessary. First, we don't need to make a copy of D
- * if the caller doesn't mind it being consumed. Second, D only
- * needs to be lower- or upper-triangular, because it's symmetric,
- * but that requires changing dmatrix module. In time,
- * O(N^2 log N) if not O(N^2) should be possible, by being more
- * sophisticated about identifying the minimum element; 
- * see Gronau and Moran (2006).
- * 
+ * Complexity: O(N^2) in memory, O(N^2) in time in practice.
+ *
+ * Each row of the current matrix caches its nearest neighbor among
+ * the columns to its right (<nn>, <nnd>), so finding the minimum is
+ * an O(N) scan of the cache instead of an O(N^2) scan of the matrix.
+ * After each join, only rows whose cached neighbor was one of the
+ * joined clusters, or was moved to the left of them by the row/col
+ * swaps, are rescanned; all other rows just compare their cache to
+ * the (at most three) columns whose contents changed. The worst case
+ * remains O(N^3), when most rows have to be rescanned every time,
+ * but typical distance matrices need only a few rescans per join.
+ *
+ * The cache breaks ties exactly as the full scan does (the first
+ * minimum in row-major order of the current, swapped matrix), and
+ * the swaps and merge arithmetic are unchanged, so the trees are
+ * identical to those of the O(N^3) implementation. <D> must not
+ * contain NaN's, which would leave the order of elements undefined.
+ *
+ * Memory usage is at least 4x more than necessary. First, we don't
+ * need to make a copy of D if the caller doesn't mind it being
+ * consumed. Second, D only needs to be lower- or upper-triangular,
+ * because it's symmetric, but that requires changing dmatrix module.
  */
 static int
 cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
@@ -1581,9 +1829,13 @@ cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
   double      *height = NULL;	/* height of internal nodes  [0..N-2]          */
   int         *idx    = NULL;	/* taxa or node index of row/col in D [0..N-1] */
   int         *nin    = NULL;	/* # of taxa in clade in row/col in D [0..N-1] */
+  int         *nn     = NULL;	/* nearest neighbor col > row of each row [0..N-2] */
+  double      *nnd    = NULL;	/* distance to that neighbor              [0..N-2] */
   int          N;
   int          i = 0, j = 0;
+  int          i0, j0;		/* rows/cols joined, before they're moved to N-2,N-1 */
   int          row,col;
+  int          c, m;
   double       minD;
   int          status;
 
@@ -1610,9 +1862,12 @@ cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
   ESL_ALLOC(idx,    sizeof(int)    *  D->n);
   ESL_ALLOC(nin,    sizeof(int)    *  D->n);
   ESL_ALLOC(height, sizeof(double) * (D->n-1));
+  ESL_ALLOC(nn,     sizeof(int)    * (D->n-1));
+  ESL_ALLOC(nnd,    sizeof(double) * (D->n-1));
   for (i = 0; i < D->n;   i++) idx[i]    = -i; /* assign taxa indices to row/col coords */
   for (i = 0; i < D->n;   i++) nin[i ]   = 1;  /* each cluster starts as 1  */
   for (i = 0; i < D->n-1; i++) height[i] = 0.; 
+  for (i = 0; i < D->n-1; i++) cluster_nn(D, D->n, i, nn, nnd);
 
   /* If we're doing either single linkage or complete linkage clustering,
    * we will construct a "linkage tree", where ld[v], rd[v] "branch lengths"
@@ -1626,19 +1881,20 @@ cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
 
   for (N = D->n; N >= 2; N--)
     {
-      /* Find minimum in our current N x N matrix.
+      /* Find minimum in our current N x N matrix, from the row caches.
        * (Don't init minD to -infinity; linkage trees use sparse distance matrices 
        * with -infinity representing unlinked.)
        */
-      minD = D->mx[0][1]; i = 0; j = 1;	/* init with: if nothing else, try to link 0-1 */
-      for (row = 0; row < N; row++)
-	for (col = row+1; col < N; col++)
-	  if (D->mx[row][col] < minD)
-	    {
-	      minD = D->mx[row][col];
-	      i    = row;
-	      j    = col;
-	    }
+      minD = nnd[0]; i = 0; j = nn[0];	/* init with: if nothing else, try to link 0 to its neighbor */
+      for (row = 1; row < N-1; row++)
+	if (nnd[row] < minD)
+	  {
+	    minD = nnd[row];
+	    i    = row;
+	    j    = nn[row];
+	  }
+      i0 = i;
+      j0 = j;
 
       /* We're joining node at row/col i with node at row/col j.
        * Add node (index = N-2) to the tree at height minD/2.
@@ -1710,12 +1966,48 @@ cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
        */
       nin[i] += nin[j];
       idx[i]  = N-2;
+
+      /* 4. Update the row caches for the N-1 x N-1 matrix. Follow
+       *    each cached column through the two swaps. Rescan rows
+       *    that moved (i0, j0), rows whose neighbor was joined (now
+       *    at N-2 or N-1), and rows whose neighbor moved to their
+       *    left. Other rows only need to look at the columns that
+       *    changed: the new cluster at N-2, and the ones moved to
+       *    i0 and j0, which may now win a tie by being further left.
+       */
+      for (row = 0; row < N-2; row++)
+	{
+	  c = nn[row];
+	  if      (c == j0)  c = N-1;
+	  else if (c == N-1) c = j0;
+	  if      (c == i0)  c = N-2;
+	  else if (c == N-2) c = i0;
+
+	  if (row == i0 || row == j0 || c >= N-2 || c <= row)
+	    cluster_nn(D, N-1, row, nn, nnd);
+	  else
+	    {
+	      nn[row] = c;
+	      for (m = 0; m < 3; m++)
+		{
+		  col = (m == 0 ? i0 : (m == 1 ? j0 : N-2));
+		  if (col <= row || col > N-2) continue;
+		  if (D->mx[row][col] < nnd[row] || (D->mx[row][col] == nnd[row] && col < nn[row]))
+		    {
+		      nn[row]  = col;
+		      nnd[row] = D->mx[row][col];
+		    }
+		}
+	    }
+	}
     }  
 
   esl_dmatrix_Destroy(D);
   free(height);
   free(idx);
   free(nin);
+  free(nn);
+  free(nnd);
   if (ret_T != NULL) *ret_T = T;
   return eslOK;
 
@@ -1725,6 +2017,8 @@ cluster_engine(ESL_DMATRIX *D_original, int mode, ESL_TREE **ret_T)
   if (height != NULL) free(height);
   if (idx    != NULL) free(idx);
   if (nin    != NULL) free(nin);
+  if (nn     != NULL) free(nn);
+  if (nnd    != NULL) free(nnd);
   if (ret_T != NULL) *ret_T = NULL;
   return status;
 }
@@ -1793,6 +2087,320 @@ esl_tree_CompleteLinkage(ESL_DMATRIX *D, ESL_TREE **ret_T)
 {
   return cluster_engine(D, eslCOMPLETE_LINKAGE, ret_T);
 }
+
+
+/* Neighbor-joining.
+ *
+ * Each join takes an O(N^2) scan of the current matrix for the pair
+ * with the smallest Q value (Saitou and Nei, 1987; Studier and
+ * Keppler, 1988), so the whole tree costs O(N^3). Worker threads
+ * split the rows of that scan, interleaved so each gets a fair share
+ * of the triangle, and report their own best pair; the best of those
+ * is the same pair a serial scan finds, so the tree doesn't depend
+ * on the number of threads. Small matrices are scanned in the
+ * caller's thread, because the scan doesn't pay for a thread
+ * handoff.
+ */
+#define TREE_NJ_MINTHREAD 256
+
+typedef struct {
+  ESL_DMATRIX *D;        // working copy of distances; current clusters are rows/cols 0..n-1
+  double      *r;        // row sums of current D [0..n-1]
+  int          n;        // current number of clusters
+
+  /* Each worker's best pair [0..nworker-1]: */
+  double      *bestq;    // smallest Q found
+  int         *besti;    // its row i (< j), or -1 if no rows
+  int         *bestj;    // its col j
+
+  /* Worker threads: */
+  int          nworker;  // number of workers (1, if no threads)
+  int          nbusy;    // number of workers still scanning
+  int          batch;    // join number; workers wake up when it changes
+  int          done;     // TRUE when workers should exit
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mutex;
+  pthread_cond_t  cv;
+#endif
+} TREE_NJ_DATA;
+
+/* tree_nj_scan()
+ * Scan rows w, w+nw, w+2nw... of the current matrix for the pair
+ * i<j with the smallest Q = (n-2) D_ij - r_i - r_j, breaking ties by
+ * the first in row-major order; leave it in <bestq>, <besti>,
+ * <bestj> for worker <w>.
+ */
+static void
+tree_nj_scan(TREE_NJ_DATA *d, int w, int nw)
+{
+  double  n2   = (double) (d->n - 2);
+  double  best = 0.;
+  double *Drow;
+  double  q;
+  int     bi   = -1;
+  int     bj   = -1;
+  int     row, col;
+
+  for (row = w; row < d->n-1; row += nw)
+    {
+      Drow = d->D->mx[row];
+      for (col = row+1; col < d->n; col++)
+	{
+	  q = n2 * Drow[col] - d->r[row] - d->r[col];
+	  if (bi == -1 || q < best) { best = q; bi = row; bj = col; }
+	}
+    }
+  d->bestq[w] = best;
+  d->besti[w] = bi;
+  d->bestj[w] = bj;
+}
+
+#ifdef HAVE_PTHREAD
+static void
+tree_nj_thread(void *arg)
+{
+  ESL_THREADS  *thr  = (ESL_THREADS *) arg;
+  TREE_NJ_DATA *d;
+  int           w;
+  int           seen = 0;
+
+  esl_threads_Started(thr, &w);
+  d = (TREE_NJ_DATA *) esl_threads_GetData(thr, w);
+
+  pthread_mutex_lock(&d->mutex);
+  while (1)
+    {
+      while (d->batch == seen && ! d->done) pthread_cond_wait(&d->cv, &d->mutex);
+      if (d->done) break;
+      seen = d->batch;
+
+      pthread_mutex_unlock(&d->mutex);
+      tree_nj_scan(d, w, d->nworker);
+      pthread_mutex_lock(&d->mutex);
+      if (--d->nbusy == 0) pthread_cond_broadcast(&d->cv);
+    }
+  pthread_mutex_unlock(&d->mutex);
+  esl_threads_Finished(thr, w);
+}
+#endif /*HAVE_PTHREAD*/
+
+
+/* Function:  esl_tree_NJ()
+ * Synopsis:  Neighbor-joining tree from a distance matrix.
+ *
+ * Purpose:   Given distance matrix <D>, use the neighbor-joining
+ *            algorithm to construct a tree <T>. 
+ *            
+ *            Neighbor-joining produces an unrooted tree; <T> is
+ *            rooted on the last branch joined, with half its length
+ *            on each side of the root. Branch lengths that come out
+ *            negative are set to 0, because <ESL_TREE> requires them
+ *            to be $\geq 0$. If <D> is additive (the pairwise path
+ *            lengths of some tree with positive branch lengths),
+ *            <T> reproduces it exactly, up to roundoff.
+ *
+ *            Same as <esl_tree_NJ_adv(D, 0, ret_T)>.
+ *
+ * Returns:   <eslOK> on success; the tree is returned in <ret_T>,
+ *            and must be freed by the caller with <esl_tree_Destroy()>.
+ *
+ * Throws:    <eslEMEM> on allocation problem, and <ret_T> is set <NULL>.
+ */
+int
+esl_tree_NJ(ESL_DMATRIX *D, ESL_TREE **ret_T)
+{
+  return esl_tree_NJ_adv(D, 0, ret_T);
+}
+
+
+/* Function:  esl_tree_NJ_adv()
+ * Synopsis:  Neighbor-joining tree, with optional worker threads.
+ *
+ * Purpose:   Same as <esl_tree_NJ()>, but the $O(N^2)$ scan for the
+ *            pair to join at each step is divided among <ncpu>
+ *            worker threads, if Easel was built with POSIX threads
+ *            and <ncpu> $> 1$. <ncpu> $\leq 1$ does all the work
+ *            in the caller's thread. The tree is the same regardless
+ *            of <ncpu>.
+ *
+ * Args:      D     - symmetric distance matrix, >= 2 taxa
+ *            ncpu  - number of worker threads to use, or 0
+ *            ret_T - RETURN: the tree
+ *
+ * Returns:   <eslOK> on success; the tree is returned in <ret_T>,
+ *            and must be freed by the caller with <esl_tree_Destroy()>.
+ *
+ * Throws:    <eslEMEM> on allocation problem; <eslESYS> if threads
+ *            can't be created. Now <ret_T> is set <NULL>.
+ */
+int
+esl_tree_NJ_adv(ESL_DMATRIX *D_original, int ncpu, ESL_TREE **ret_T)
+{
+  TREE_NJ_DATA d;
+  ESL_TREE    *T   = NULL;
+  int         *idx = NULL;	/* taxa or node index of row/col in D [0..N-1] */
+#ifdef HAVE_PTHREAD
+  ESL_THREADS *thr = NULL;
+#endif
+  int          n, w;
+  int          i, j, k;
+  double       q, dij, dk, li;
+  int          status;
+
+  ESL_DASSERT1((D_original != NULL));               /* matrix exists      */
+  ESL_DASSERT1((D_original->n == D_original->m));   /* D is NxN square    */
+  ESL_DASSERT1((D_original->n >= 2));               /* >= 2 taxa          */
+
+  d.D       = NULL;
+  d.r       = NULL;
+  d.bestq   = NULL;
+  d.besti   = NULL;
+  d.bestj   = NULL;
+  d.nworker = 1;
+  d.n       = D_original->n;
+#ifdef HAVE_PTHREAD
+  if (ncpu > 1 && d.n > TREE_NJ_MINTHREAD) d.nworker = ncpu;
+#endif
+
+  if ((d.D = esl_dmatrix_Clone(D_original)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((T   = esl_tree_Create(d.n))          == NULL) { status = eslEMEM; goto ERROR; }
+  ESL_ALLOC(idx,     sizeof(int)    * d.n);
+  ESL_ALLOC(d.r,     sizeof(double) * d.n);
+  ESL_ALLOC(d.bestq, sizeof(double) * d.nworker);
+  ESL_ALLOC(d.besti, sizeof(int)    * d.nworker);
+  ESL_ALLOC(d.bestj, sizeof(int)    * d.nworker);
+  for (i = 0; i < d.n; i++)
+    {
+      idx[i] = -i;
+      d.r[i] = 0.;
+      for (k = 0; k < d.n; k++) if (k != i) d.r[i] += d.D->mx[i][k];
+    }
+
+#ifdef HAVE_PTHREAD
+  if (d.nworker > 1)
+    {
+      d.nbusy = 0;
+      d.batch = 0;
+      d.done  = FALSE;
+      if (pthread_mutex_init(&d.mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "pthread_mutex_init() failed");
+      if (pthread_cond_init (&d.cv,    NULL) != 0) { pthread_mutex_destroy(&d.mutex); ESL_XEXCEPTION(eslESYS, "pthread_cond_init() failed"); }
+      if ((thr = esl_threads_Create(&tree_nj_thread)) == NULL) { status = eslEMEM; goto THREADFAIL; }
+      for (w = 0; w < d.nworker; w++)
+	if (esl_threads_AddThread(thr, &d) != eslOK) break;
+      if (w == 0) { status = eslESYS; goto THREADFAIL; }
+      d.nworker = w;
+      esl_threads_WaitForStart(thr);
+    }
+#endif
+
+  for (n = d.n; n > 2; n--)
+    {
+      d.n = n;
+
+      /* Find the pair i<j to join, from the workers' best pairs. */
+#ifdef HAVE_PTHREAD
+      if (d.nworker > 1 && n > TREE_NJ_MINTHREAD)
+	{
+	  pthread_mutex_lock(&d.mutex);
+	  d.nbusy = d.nworker;
+	  d.batch++;
+	  pthread_cond_broadcast(&d.cv);
+	  while (d.nbusy > 0) pthread_cond_wait(&d.cv, &d.mutex);
+	  pthread_mutex_unlock(&d.mutex);
+	}
+      else
+#endif
+	for (w = 0; w < d.nworker; w++) tree_nj_scan(&d, w, d.nworker);
+
+      i = j = -1;
+      q = 0.;
+      for (w = 0; w < d.nworker; w++)
+	if (d.besti[w] != -1 && (i == -1 || d.bestq[w] < q || (d.bestq[w] == q && d.besti[w] < i)))
+	  {
+	    q = d.bestq[w];
+	    i = d.besti[w];
+	    j = d.bestj[w];
+	  }
+
+      /* Add node n-2 to the tree, joining i and j. */
+      dij = d.D->mx[i][j];
+      li  = 0.5 * dij + (d.r[i] - d.r[j]) / (2. * (double) (n-2));
+      T->left[n-2]  = idx[i];
+      T->right[n-2] = idx[j];
+      T->ld[n-2]    = ESL_MAX(0., li);
+      T->rd[n-2]    = ESL_MAX(0., dij - li);
+      if (idx[i] > 0) T->parent[idx[i]] = n-2;
+      if (idx[j] > 0) T->parent[idx[j]] = n-2;
+
+      /* The new cluster replaces i; update the distances and row sums. */
+      d.r[i] = 0.;
+      for (k = 0; k < n; k++)
+	{
+	  if (k == i || k == j) continue;
+	  dk      = 0.5 * (d.D->mx[i][k] + d.D->mx[j][k] - dij);
+	  d.r[k] += dk - d.D->mx[i][k] - d.D->mx[j][k];
+	  d.r[i] += dk;
+	  d.D->mx[i][k] = d.D->mx[k][i] = dk;
+	}
+      idx[i] = n-2;
+
+      /* Move j to n-1 (unless it's already there), where it falls away. */
+      if (j != n-1)
+	{
+	  for (k = 0; k < n; k++) ESL_SWAP(d.D->mx[k][n-1], d.D->mx[k][j], double);
+	  for (k = 0; k < n; k++) ESL_SWAP(d.D->mx[n-1][k], d.D->mx[j][k], double);
+	  ESL_SWAP(d.r[j], d.r[n-1], double);
+	  ESL_SWAP(idx[j], idx[n-1], int);
+	}
+    }
+
+  /* The root joins the last two clusters, splitting the branch between them. */
+  T->left[0]  = idx[0];
+  T->right[0] = idx[1];
+  T->ld[0]    = T->rd[0] = ESL_MAX(0., 0.5 * d.D->mx[0][1]);
+  if (idx[0] > 0) T->parent[idx[0]] = 0;
+  if (idx[1] > 0) T->parent[idx[1]] = 0;
+
+#ifdef HAVE_PTHREAD
+  if (thr)
+    {
+      pthread_mutex_lock(&d.mutex);
+      d.done = TRUE;
+      pthread_cond_broadcast(&d.cv);
+      pthread_mutex_unlock(&d.mutex);
+      esl_threads_WaitForFinish(thr);
+      esl_threads_Destroy(thr);
+      pthread_cond_destroy(&d.cv);
+      pthread_mutex_destroy(&d.mutex);
+    }
+#endif
+
+  esl_dmatrix_Destroy(d.D);
+  free(idx);
+  free(d.r);
+  free(d.bestq);
+  free(d.besti);
+  free(d.bestj);
+  *ret_T = T;
+  return eslOK;
+
+#ifdef HAVE_PTHREAD
+ THREADFAIL:
+  if (thr) esl_threads_Destroy(thr);
+  pthread_cond_destroy(&d.cv);
+  pthread_mutex_destroy(&d.mutex);
+#endif
+ ERROR:
+  if (d.D) esl_dmatrix_Destroy(d.D);
+  if (T)   esl_tree_Destroy(T);
+  free(idx);
+  free(d.r);
+  free(d.bestq);
+  free(d.besti);
+  free(d.bestj);
+  *ret_T = NULL;
+  return status;
+}
 /*----------------- end, clustering algorithms  ----------------*/
 
 
@@ -2001,6 +2609,7 @@ esl_tree_ToDistanceMatrix(ESL_TREE *T, ESL_DMATRIX **ret_D)
  * 6. Unit tests
  *****************************************************************/
 #ifdef eslTREE_TESTDRIVE
+#include "esl_matrixops.h"
 
 static void
 utest_OptionalInformation(ESL_RANDOMNESS *r, int ntaxa)
@@ -2074,6 +2683,278 @@ utest_UPGMA(ESL_RANDOMNESS *r, int ntaxa)
   return;
 }
 
+/* utest_rf_splits()
+ * Brute force: nontrivial splits of <T> as strings of 0/1 per taxon,
+ * with taxon 0 always on the 0 side.
+ */
+static void
+utest_rf_splits(ESL_TREE *T, char **split, int *ret_n)
+{
+  char      *msg = "RF splits failed";
+  ESL_STACK *ns  = esl_stack_ICreate();
+  int        n   = 0;
+  int        g, v, c, i, side, k;
+
+  if (ns == NULL) esl_fatal(msg);
+  for (g = 1; g < T->N-1; g++)
+    {
+      for (i = 0; i < T->N; i++) split[n][i] = '0';
+      split[n][T->N] = '\0';
+      esl_stack_IPush(ns, g);
+      while (esl_stack_IPop(ns, &v) == eslOK)
+	for (side = 0; side < 2; side++)
+	  {
+	    c = (side == 0 ? T->left[v] : T->right[v]);
+	    if (c <= 0) split[n][-c] = '1';
+	    else        esl_stack_IPush(ns, c);
+	  }
+      if (split[n][0] == '1')
+	for (i = 0; i < T->N; i++) split[n][i] = (split[n][i] == '1' ? '0' : '1');
+      for (k = 0, i = 0; i < T->N; i++) if (split[n][i] == '1') k++;
+      if (k < 2 || k > T->N-2) continue;
+      for (i = 0; i < n; i++) if (strcmp(split[i], split[n]) == 0) break;
+      if (i == n) n++;
+    }
+  esl_stack_Destroy(ns);
+  *ret_n = n;
+}
+
+/* utest_RobinsonFoulds()
+ * RF distance agrees with a brute force comparison of splits; is 0
+ * between a tree and its neighbor-joining reconstruction (the same
+ * unrooted tree, rooted elsewhere); and maps taxa by their labels.
+ */
+static void
+utest_RobinsonFoulds(ESL_RANDOMNESS *r, int ntaxa)
+{
+  char        *msg     = "esl_tree_RobinsonFoulds unit test failed";
+  char         tmpfile[32] = "esltmpXXXXXX";
+  FILE        *fp      = NULL;
+  ESL_TREE    *T1      = NULL;
+  ESL_TREE    *T2      = NULL;
+  ESL_DMATRIX *D       = NULL;
+  char       **s1      = NULL;
+  char       **s2      = NULL;
+  int          ntrials = 10;
+  int          trial, n1, n2, ncommon, i, j;
+  int          rf, maxrf;
+  char         errbuf[eslERRBUFSIZE];
+
+  if ((s1 = esl_mat_CCreate(ntaxa, ntaxa+1)) == NULL) esl_fatal(msg);
+  if ((s2 = esl_mat_CCreate(ntaxa, ntaxa+1)) == NULL) esl_fatal(msg);
+
+  for (trial = 0; trial < ntrials; trial++)
+    {
+      if (esl_tree_Simulate(r, ntaxa, &T1) != eslOK) esl_fatal(msg);
+      if (esl_tree_Simulate(r, ntaxa, &T2) != eslOK) esl_fatal(msg);
+      if (esl_tree_RobinsonFoulds(T1, T2, &rf, &maxrf) != eslOK) esl_fatal(msg);
+
+      utest_rf_splits(T1, s1, &n1);
+      utest_rf_splits(T2, s2, &n2);
+      for (ncommon = 0, i = 0; i < n1; i++)
+	for (j = 0; j < n2; j++)
+	  if (strcmp(s1[i], s2[j]) == 0) { ncommon++; break; }
+      if (maxrf != 2 * (ntaxa-3))            esl_fatal(msg);
+      if (maxrf != n1 + n2)                  esl_fatal(msg);
+      if (rf    != n1 + n2 - 2 * ncommon)    esl_fatal(msg);
+      esl_tree_Destroy(T2);
+
+      if (esl_tree_ToDistanceMatrix(T1, &D)          != eslOK) esl_fatal(msg);
+      if (esl_tree_NJ(D, &T2)                        != eslOK) esl_fatal(msg);
+      if (esl_tree_RobinsonFoulds(T1, T2, &rf, NULL) != eslOK) esl_fatal(msg);
+      if (rf != 0) esl_fatal(msg);
+      esl_tree_Destroy(T1);
+      esl_tree_Destroy(T2);
+      esl_dmatrix_Destroy(D);
+    }
+
+  /* Newick i/o numbers taxa in the order they appear in the string */
+  if (esl_tmpfile(tmpfile, &fp)                   != eslOK) esl_fatal(msg);
+  if (esl_tree_Simulate(r, ntaxa, &T1)            != eslOK) esl_fatal(msg);
+  if (esl_tree_SetTaxonlabels(T1, NULL)           != eslOK) esl_fatal(msg);
+  if (esl_tree_WriteNewick(fp, T1)                != eslOK) esl_fatal(msg);
+  rewind(fp);
+  if (esl_tree_ReadNewick(fp, errbuf, &T2)        != eslOK) esl_fatal(msg);
+  if (esl_tree_RobinsonFoulds(T1, T2, &rf, NULL)  != eslOK) esl_fatal(msg);
+  if (rf != 0) esl_fatal(msg);
+  fclose(fp);
+
+  esl_tree_Destroy(T1);
+  esl_tree_Destroy(T2);
+  esl_mat_CDestroy(s1);
+  esl_mat_CDestroy(s2);
+}
+
+/* utest_cluster_reference()
+ * The original O(N^3) cluster_engine(): a full scan for the minimum
+ * at each join. The nearest-neighbor caching version must produce
+ * exactly the same trees.
+ */
+static void
+utest_cluster_reference(ESL_DMATRIX *D0, int mode, ESL_TREE **ret_T)
+{
+  char        *msg    = "cluster reference failed";
+  ESL_DMATRIX *D      = esl_dmatrix_Clone(D0);
+  ESL_TREE    *T      = esl_tree_Create(D0->n);
+  int         *idx    = malloc(sizeof(int)    * D0->n);
+  int         *nin    = malloc(sizeof(int)    * D0->n);
+  double      *height = malloc(sizeof(double) * D0->n);
+  int          N, i, j, row, col;
+  double       minD;
+
+  if (!D || !T || !idx || !nin || !height) esl_fatal(msg);
+  for (i = 0; i < D->n; i++) { idx[i] = -i; nin[i] = 1; height[i] = 0.; }
+  if (mode == eslSINGLE_LINKAGE || mode == eslCOMPLETE_LINKAGE) T->is_linkage_tree = TRUE;
+
+  for (N = D->n; N >= 2; N--)
+    {
+      minD = D->mx[0][1]; i = 0; j = 1;
+      for (row = 0; row < N; row++)
+	for (col = row+1; col < N; col++)
+	  if (D->mx[row][col] < minD) { minD = D->mx[row][col]; i = row; j = col; }
+
+      T->left[N-2]  = idx[i];
+      T->right[N-2] = idx[j];
+      height[N-2]   = (T->is_linkage_tree ? minD : minD / 2.);
+      T->ld[N-2]    = T->rd[N-2] = height[N-2];
+      if (! T->is_linkage_tree) {
+	if (idx[i] > 0) T->ld[N-2] = ESL_MAX(0., T->ld[N-2] - height[idx[i]]);
+	if (idx[j] > 0) T->rd[N-2] = ESL_MAX(0., T->rd[N-2] - height[idx[j]]);
+      }
+      if (idx[i] > 0) T->parent[idx[i]] = N-2;
+      if (idx[j] > 0) T->parent[idx[j]] = N-2;
+
+      if (j != N-1) {
+	for (row = 0; row < N; row++) ESL_SWAP(D->mx[row][N-1], D->mx[row][j], double);
+	for (col = 0; col < N; col++) ESL_SWAP(D->mx[N-1][col], D->mx[j][col], double);
+	ESL_SWAP(idx[j], idx[N-1], int);
+	ESL_SWAP(nin[j], nin[N-1], int);
+      }
+      if (i != N-2) {
+	for (row = 0; row < N; row++) ESL_SWAP(D->mx[row][N-2], D->mx[row][i], double);
+	for (col = 0; col < N; col++) ESL_SWAP(D->mx[N-2][col], D->mx[i][col], double);
+	ESL_SWAP(idx[i], idx[N-2], int);
+	ESL_SWAP(nin[i], nin[N-2], int);
+      }
+      i = N-2;
+      j = N-1;
+      for (col = 0; col < N; col++)
+	{
+	  switch (mode) {
+	  case eslUPGMA:            D->mx[i][col] = (nin[i] * D->mx[i][col] + nin[j] * D->mx[j][col]) / (double) (nin[i] + nin[j]); break;
+	  case eslWPGMA:            D->mx[i][col] = (D->mx[i][col] + D->mx[j][col]) / 2.;  break;
+	  case eslSINGLE_LINKAGE:   D->mx[i][col] = ESL_MIN(D->mx[i][col], D->mx[j][col]); break;
+	  case eslCOMPLETE_LINKAGE: D->mx[i][col] = ESL_MAX(D->mx[i][col], D->mx[j][col]); break;
+	  }
+	  D->mx[col][i] = D->mx[i][col];
+	}
+      nin[i] += nin[j];
+      idx[i]  = N-2;
+    }
+
+  esl_dmatrix_Destroy(D);
+  free(idx);
+  free(nin);
+  free(height);
+  *ret_T = T;
+}
+
+/* utest_cluster_engine()
+ * Random distance matrices, some with many ties (small integer
+ * distances), must give bit-identical trees in all four clustering
+ * modes.
+ */
+static void
+utest_cluster_engine(ESL_RANDOMNESS *r, int ntaxa)
+{
+  char        *msg = "cluster_engine unit test failed";
+  ESL_DMATRIX *D   = esl_dmatrix_Create(ntaxa, ntaxa);
+  ESL_TREE    *T1  = NULL;
+  ESL_TREE    *T2  = NULL;
+  int          ntrials = 20;
+  int          trial, mode, i, j;
+
+  for (trial = 0; trial < ntrials; trial++)
+    {
+      for (i = 0; i < ntaxa; i++)
+	{
+	  D->mx[i][i] = 0.;
+	  for (j = i+1; j < ntaxa; j++)
+	    D->mx[i][j] = D->mx[j][i] = (trial % 2 ? esl_random(r) : (double) esl_rnd_Roll(r, 4));
+	}
+
+      for (mode = eslUPGMA; mode <= eslCOMPLETE_LINKAGE; mode++)
+	{
+	  if (cluster_engine(D, mode, &T1) != eslOK) esl_fatal(msg);
+	  utest_cluster_reference(D, mode, &T2);
+
+	  if (esl_tree_Validate(T1, NULL) != eslOK)            esl_fatal(msg);
+	  if (T1->is_linkage_tree != T2->is_linkage_tree)       esl_fatal(msg);
+	  for (i = 0; i < ntaxa-1; i++)
+	    {
+	      if (T1->parent[i] != T2->parent[i]) esl_fatal(msg);
+	      if (T1->left[i]   != T2->left[i])   esl_fatal(msg);
+	      if (T1->right[i]  != T2->right[i])  esl_fatal(msg);
+	      if (T1->ld[i]     != T2->ld[i])     esl_fatal(msg);
+	      if (T1->rd[i]     != T2->rd[i])     esl_fatal(msg);
+	    }
+	  esl_tree_Destroy(T1);
+	  esl_tree_Destroy(T2);
+	}
+    }
+  esl_dmatrix_Destroy(D);
+}
+
+/* utest_NJ()
+ * Neighbor-joining reproduces an additive distance matrix, and
+ * gives the same tree with or without worker threads.
+ */
+static void
+utest_NJ(ESL_RANDOMNESS *r, int ntaxa)
+{
+  char        *msg = "esl_tree_NJ unit test failed";
+  ESL_TREE    *T0  = NULL;
+  ESL_TREE    *T1  = NULL;
+  ESL_TREE    *T2  = NULL;
+  ESL_DMATRIX *D0  = NULL;
+  ESL_DMATRIX *D1  = NULL;
+  int          nbig = 300;	/* > TREE_NJ_MINTHREAD, to use the threads */
+  int          i, j;
+
+  if (esl_tree_Simulate(r, ntaxa, &T0)   != eslOK) esl_fatal(msg);
+  if (esl_tree_ToDistanceMatrix(T0, &D0) != eslOK) esl_fatal(msg);
+  if (esl_tree_NJ(D0, &T1)               != eslOK) esl_fatal(msg);
+  if (esl_tree_Validate(T1, NULL)        != eslOK) esl_fatal(msg);
+  if (esl_tree_ToDistanceMatrix(T1, &D1) != eslOK) esl_fatal(msg);
+  if (esl_dmatrix_CompareAbs(D0, D1, 1e-9) != eslOK) esl_fatal(msg);
+  esl_tree_Destroy(T0);
+  esl_tree_Destroy(T1);
+  esl_dmatrix_Destroy(D0);
+  esl_dmatrix_Destroy(D1);
+
+  if ((D0 = esl_dmatrix_Create(nbig, nbig)) == NULL) esl_fatal(msg);
+  for (i = 0; i < nbig; i++)
+    {
+      D0->mx[i][i] = 0.;
+      for (j = i+1; j < nbig; j++)
+	D0->mx[i][j] = D0->mx[j][i] = (double) esl_rnd_Roll(r, 10);
+    }
+  if (esl_tree_NJ_adv(D0, 0, &T1) != eslOK) esl_fatal(msg);
+  if (esl_tree_NJ_adv(D0, 3, &T2) != eslOK) esl_fatal(msg);
+  if (esl_tree_Validate(T1, NULL) != eslOK) esl_fatal(msg);
+  for (i = 0; i < nbig-1; i++)
+    {
+      if (T1->parent[i] != T2->parent[i]) esl_fatal(msg);
+      if (T1->left[i]   != T2->left[i])   esl_fatal(msg);
+      if (T1->right[i]  != T2->right[i])  esl_fatal(msg);
+      if (T1->ld[i]     != T2->ld[i])     esl_fatal(msg);
+      if (T1->rd[i]     != T2->rd[i])     esl_fatal(msg);
+    }
+  esl_tree_Destroy(T1);
+  esl_tree_Destroy(T2);
+  esl_dmatrix_Destroy(D0);
+}
+
 #endif /*eslTREE_TESTDRIVE*/
 /*-------------------- end, unit tests  -------------------------*/
 
@@ -2104,6 +2985,10 @@ main(int argc, char **argv)
   utest_OptionalInformation(r, ntaxa); /* SetTaxaparents(), SetCladesizes() */
   utest_WriteNewick(r, ntaxa);
   utest_UPGMA(r, ntaxa);
+  utest_cluster_engine(r, ntaxa);
+  utest_cluster_engine(r, 200);
+  utest_NJ(r, ntaxa);
+  utest_RobinsonFoulds(r, ntaxa);
 
   esl_randomness_Destroy(r);
   return eslOK;
@@ -101,6 +101,7 @@ extern int  esl_tree_ReadNewick(FILE *fp, char *errbuf, ESL_TREE **ret_T);
 /* 3. Tree comparison algorithms.
  */
 extern int esl_tree_Compare(ESL_TREE *T1, ESL_TREE *T2);
+extern int esl_tree_RobinsonFoulds(ESL_TREE *T1, ESL_TREE *T2, int *ret_rf, int *opt_maxrf);
 
 /* 4. Clustering algorithms for distance-based tree construction.
  */
@@ -108,6 +109,8 @@ extern int esl_tree_UPGMA(ESL_DMATRIX *D, ESL_TREE **ret_T);
 extern int esl_tree_WPGMA(ESL_DMATRIX *D, ESL_TREE **ret_T);
 extern int esl_tree_SingleLinkage(ESL_DMATRIX *D, ESL_TREE **ret_T);
 extern int esl_tree_CompleteLinkage(ESL_DMATRIX *D, ESL_TREE **ret_T);
+extern int esl_tree_NJ(ESL_DMATRIX *D, ESL_TREE **ret_T);
+extern int esl_tree_NJ_adv(ESL_DMATRIX *D, int ncpu, ESL_TREE **ret_T);
 
 /* 5. Generating simulated trees.
  */
@@ -3,12 +3,23 @@
  * Can operate on vectors of doubles, floats, or integers - appropriate
  * routine is prefixed with D, F, or I. For example, esl_vec_DSet() is
  * the Set routine for a vector of doubles; esl_vec_ISet() is for integers.
+ *
+ * The most heavily used D, F, and I operations (Sum, Dot, Max, Min,
+ * ArgMax, ArgMin, Scale, AddScaled; F LogSum and Entropy) also have
+ * SSE, AVX, and AVX-512 implementations, in
+ * esl_vectorops_{sse,avx,avx512}.c. The first call selects the
+ * widest one the processor supports; the serial code here is the
+ * reference they're tested against. Floating point sums are then
+ * taken in a different order, so they can differ from the serial
+ * result by roundoff.
  * 
  * Contents:
  *    1. The vectorops API.
- *    2. Unit tests.
- *    3. Test driver.
- *    4. Examples.
+ *    2. Serial implementations; runtime dispatch.
+ *    3. Unit tests.
+ *    4. Test driver.
+ *    5. Benchmark.
+ *    6. Examples.
  */                      
 #include "esl_config.h"
 
@@ -16,10 +27,53 @@
 #include <float.h>
 
 #include "easel.h"
+#include "esl_cpu.h"
 #include "esl_random.h"
 
 #include "esl_vectorops.h"
 
+/* struct vec_kernels
+ * One implementation of each of the operations that have vectorized
+ * versions: the serial reference code in this file, or the SSE, AVX,
+ * or AVX-512 code in esl_vectorops_{sse,avx,avx512}.c. vec_kernels()
+ * returns the one to use.
+ */
+struct vec_kernels {
+  const char *name;
+  double (*DSum)      (const double *vec, int n);
+  float  (*FSum)      (const float  *vec, int n);
+  int    (*ISum)      (const int    *vec, int n);
+  double (*DDot)      (const double *vec1, const double *vec2, int n);
+  float  (*FDot)      (const float  *vec1, const float  *vec2, int n);
+  int    (*IDot)      (const int    *vec1, const int    *vec2, int n);
+  double (*DMax)      (const double *vec, int n);
+  float  (*FMax)      (const float  *vec, int n);
+  int    (*IMax)      (const int    *vec, int n);
+  double (*DMin)      (const double *vec, int n);
+  float  (*FMin)      (const float  *vec, int n);
+  int    (*IMin)      (const int    *vec, int n);
+  int    (*DArgMax)   (const double *vec, int n);
+  int    (*FArgMax)   (const float  *vec, int n);
+  int    (*IArgMax)   (const int    *vec, int n);
+  int    (*DArgMin)   (const double *vec, int n);
+  int    (*FArgMin)   (const float  *vec, int n);
+  int    (*IArgMin)   (const int    *vec, int n);
+  void   (*DScale)    (double *vec, int n, double scale);
+  void   (*FScale)    (float  *vec, int n, float  scale);
+  void   (*IScale)    (int    *vec, int n, int    scale);
+  void   (*DAddScaled)(double *vec1, const double *vec2, double a, int n);
+  void   (*FAddScaled)(float  *vec1, const float  *vec2, float  a, int n);
+  void   (*IAddScaled)(int    *vec1, const int    *vec2, int    a, int n);
+  float  (*FLogSum)   (const float *vec, int n);
+  float  (*FEntropy)  (const float *p,   int n);
+};
+static const struct vec_kernels *vec_kernels(void);
+
+
+/*****************************************************************
+ * 1. The vectorops API.
+ *****************************************************************/
+
 /* Function:  esl_vec_{DFIL}Set()
  * Synopsis:  Set all items in vector to scalar value.
  *            
@@ -59,20 +113,17 @@ esl_vec_LSet(int64_t *vec, int n, int64_t value)
 void
 esl_vec_DScale(double *vec, int n, double scale)
 {
-  int i;
-  for (i = 0; i < n; i++) vec[i] *= scale;
+  vec_kernels()->DScale(vec, n, scale);
 }
 void
 esl_vec_FScale(float *vec, int n, float scale)
 {
-  int i;
-  for (i = 0; i < n; i++) vec[i] *= scale;
+  vec_kernels()->FScale(vec, n, scale);
 }
 void
 esl_vec_IScale(int *vec, int n, int scale)
 {
-  int i;
-  for (i = 0; i < n; i++) vec[i] *= scale;
+  vec_kernels()->IScale(vec, n, scale);
 }
 void
 esl_vec_LScale(int64_t *vec, int n, int64_t scale)
@@ -156,20 +207,17 @@ esl_vec_LAdd(int64_t *vec1, const int64_t *vec2, int n)
 void
 esl_vec_DAddScaled(double *vec1, const double *vec2, double a, int n)
 {
-  int i;
-  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+  vec_kernels()->DAddScaled(vec1, vec2, a, n);
 }
 void
 esl_vec_FAddScaled(float *vec1, const float *vec2, float a, int n)
 {
-  int i;
-  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+  vec_kernels()->FAddScaled(vec1, vec2, a, n);
 }
 void
 esl_vec_IAddScaled(int *vec1, const int *vec2, int a, int n)
 {
-  int i;
-  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+  vec_kernels()->IAddScaled(vec1, vec2, a, n);
 }
 void
 esl_vec_LAddScaled(int64_t *vec1, const int64_t *vec2, int64_t a, int n)
@@ -192,39 +240,20 @@ esl_vec_LAddScaled(int64_t *vec1, const int64_t *vec2, int64_t a, int n)
  *            small to large, so you may consider sorting <vec> before
  *            summing it.
  */
-double 
+double
 esl_vec_DSum(const double *vec, int n)
 {
-  double sum = 0.;
-  double y,t,c; 
-  int    i;
-
-  c = 0.0;
-  for (i = 0; i < n; i++) {
-    y = vec[i] - c; t = sum + y; c = (t-sum)-y; sum = t; 
-  }
-  return sum;
+  return vec_kernels()->DSum(vec, n);
 }
-float 
+float
 esl_vec_FSum(const float *vec, int n)
 {
-  float sum = 0.;
-  float y,t,c;
-  int   i;
-
-  c = 0.0;
-  for (i = 0; i < n; i++) {
-    y = vec[i] - c; t = sum + y; c = (t-sum)-y; sum = t; 
-  }
-  return sum;
+  return vec_kernels()->FSum(vec, n);
 }
 int
 esl_vec_ISum(const int *vec, int n)
 {
-  int sum = 0;
-  int i;
-  for (i = 0; i < n; i++) sum += vec[i];
-  return sum;
+  return vec_kernels()->ISum(vec, n);
 }
 int64_t
 esl_vec_LSum(const int64_t *vec, int n)
@@ -245,26 +274,17 @@ esl_vec_LSum(const int64_t *vec, int n)
 double
 esl_vec_DDot(const double *vec1, const double *vec2, int n)
 {
-  double result = 0.;
-  int    i;
-  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
-  return result;
+  return vec_kernels()->DDot(vec1, vec2, n);
 }
 float
 esl_vec_FDot(const float *vec1, const float *vec2, int n)
 {
-  float result = 0.;
-  int   i;
-  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
-  return result;
+  return vec_kernels()->FDot(vec1, vec2, n);
 }
 int
 esl_vec_IDot(const int *vec1, const int *vec2, int n)
 {
-  int result = 0;
-  int i;
-  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
-  return result;
+  return vec_kernels()->IDot(vec1, vec2, n);
 }
 int64_t
 esl_vec_LDot(const int64_t *vec1, const int64_t *vec2, int n)
@@ -286,32 +306,17 @@ esl_vec_LDot(const int64_t *vec1, const int64_t *vec2, int n)
 double
 esl_vec_DMax(const double *vec, int n)
 {
-  double best;
-  int    i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] > best) best = vec[i];
-  return best;
+  return vec_kernels()->DMax(vec, n);
 }
 float
 esl_vec_FMax(const float *vec, int n)
 {
-  float best;
-  int   i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] > best) best = vec[i];
-  return best;
+  return vec_kernels()->FMax(vec, n);
 }
 int
 esl_vec_IMax(const int *vec, int n)
 {
-  int   best;
-  int   i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] > best) best = vec[i];
-  return best;
+  return vec_kernels()->IMax(vec, n);
 }
 int64_t
 esl_vec_LMax(const int64_t *vec, int n)
@@ -335,32 +340,17 @@ esl_vec_LMax(const int64_t *vec, int n)
 double
 esl_vec_DMin(const double *vec, int n)
 {
-  double best;
-  int    i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] < best) best = vec[i];
-  return best;
+  return vec_kernels()->DMin(vec, n);
 }
 float
 esl_vec_FMin(const float *vec, int n)
 {
-  float best;
-  int   i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] < best) best = vec[i];
-  return best;
+  return vec_kernels()->FMin(vec, n);
 }
 int
 esl_vec_IMin(const int *vec, int n)
 {
-  int   best;
-  int   i;
-  best = vec[0];
-  for (i = 1; i < n; i++)
-    if (vec[i] < best) best = vec[i];
-  return best;
+  return vec_kernels()->IMin(vec, n);
 }
 int64_t
 esl_vec_LMin(const int64_t *vec, int n)
@@ -390,32 +380,17 @@ esl_vec_LMin(const int64_t *vec, int n)
 int
 esl_vec_DArgMax(const double *vec, int n)
 {
-  int i;
-  int best = 0;
-
-  for (i = 1; i < n; i++)
-    if (vec[i] > vec[best]) best = i;
-  return best;
+  return vec_kernels()->DArgMax(vec, n);
 }
 int
 esl_vec_FArgMax(const float *vec, int n)
 {
-  int i;
-  int best = 0;
-
-  for (i = 1; i < n; i++)
-    if (vec[i] > vec[best]) best = i;
-  return best;
+  return vec_kernels()->FArgMax(vec, n);
 }
 int
 esl_vec_IArgMax(const int *vec, int n)
 {
-  int i;
-  int best = 0;
-
-  for (i = 1; i < n; i++)
-    if (vec[i] > vec[best]) best = i;
-  return best;
+  return vec_kernels()->IArgMax(vec, n);
 }
 int
 esl_vec_LArgMax(const int64_t *vec, int n)
@@ -437,31 +412,17 @@ esl_vec_LArgMax(const int64_t *vec, int n)
 int
 esl_vec_DArgMin(const double *vec, int n)
 {
-  int i;
-  int best = 0;
-  for (i = 1; i < n; i++)
-    if (vec[i] < vec[best]) best = i;
-  return best;
+  return vec_kernels()->DArgMin(vec, n);
 }
 int
 esl_vec_FArgMin(const float *vec, int n)
 {
-  int   i;
-  int   best = 0;
-
-  for (i = 1; i < n; i++)
-    if (vec[i] < vec[best]) best = i;
-  return best;
+  return vec_kernels()->FArgMin(vec, n);
 }
 int
 esl_vec_IArgMin(const int *vec, int n)
 {
-  int   i;
-  int   best = 0;
-
-  for (i = 1; i < n; i++)
-    if (vec[i] < vec[best]) best = i;
-  return best;
+  return vec_kernels()->IArgMin(vec, n);
 }
 int
 esl_vec_LArgMin(const int64_t *vec, int n)
@@ -1247,17 +1208,7 @@ esl_vec_DLogSum(const double *vec, int n)
 float
 esl_vec_FLogSum(const float *vec, int n)
 {
-  int i;
-  float max, sum;
-  
-  max = esl_vec_FMax(vec, n);
-  if (max == eslINFINITY) return eslINFINITY; 
-  sum = 0.0;
-  for (i = 0; i < n; i++)
-    if (vec[i] > max - 50.)      // FLT_EPSILON ~ 1.19e-7; FLT_MIN ~ 1.17e-38; log() ~ -16, -87
-      sum += expf(vec[i] - max);
-  sum = logf(sum) + max;
-  return sum;
+  return vec_kernels()->FLogSum(vec, n);
 }
 double
 esl_vec_DLog2Sum(const double *vec, int n)
@@ -1313,12 +1264,7 @@ esl_vec_DEntropy(const double *p, int n)
 float
 esl_vec_FEntropy(const float *p, int n)
 {
-  float  H = 0.;
-  int    i;
-
-  for (i = 0; i < n; i++)
-    if (p[i] > 0.) H -= p[i] * log2f(p[i]);
-  return H;
+  return vec_kernels()->FEntropy(p, n);
 }
 
 /* Function:  esl_vec_{DF}RelEntropy()
@@ -1580,10 +1526,448 @@ esl_vec_FLog2Validate(const float *vec, int n, float tol, char *errbuf)
 
 
 /*****************************************************************
- * 2. Unit tests
+ * 2. Serial implementations; runtime dispatch.
+ *****************************************************************/
+
+/* The serial reference implementations of the operations in struct
+ * vec_kernels. These are the definitions; the vector implementations
+ * are tested against them.
+ */
+static double
+vec_DSum_serial(const double *vec, int n)
+{
+  double sum = 0.;
+  double y,t,c; 
+  int    i;
+
+  c = 0.0;
+  for (i = 0; i < n; i++) {
+    y = vec[i] - c; t = sum + y; c = (t-sum)-y; sum = t; 
+  }
+  return sum;
+}
+
+static float
+vec_FSum_serial(const float *vec, int n)
+{
+  float sum = 0.;
+  float y,t,c;
+  int   i;
+
+  c = 0.0;
+  for (i = 0; i < n; i++) {
+    y = vec[i] - c; t = sum + y; c = (t-sum)-y; sum = t; 
+  }
+  return sum;
+}
+
+static int
+vec_ISum_serial(const int *vec, int n)
+{
+  int sum = 0;
+  int i;
+  for (i = 0; i < n; i++) sum += vec[i];
+  return sum;
+}
+
+static double
+vec_DDot_serial(const double *vec1, const double *vec2, int n)
+{
+  double result = 0.;
+  int    i;
+  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+static float
+vec_FDot_serial(const float *vec1, const float *vec2, int n)
+{
+  float result = 0.;
+  int   i;
+  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+static int
+vec_IDot_serial(const int *vec1, const int *vec2, int n)
+{
+  int result = 0;
+  int i;
+  for (i = 0; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+static double
+vec_DMax_serial(const double *vec, int n)
+{
+  double best;
+  int    i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+static float
+vec_FMax_serial(const float *vec, int n)
+{
+  float best;
+  int   i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+static int
+vec_IMax_serial(const int *vec, int n)
+{
+  int   best;
+  int   i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+static double
+vec_DMin_serial(const double *vec, int n)
+{
+  double best;
+  int    i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+static float
+vec_FMin_serial(const float *vec, int n)
+{
+  float best;
+  int   i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+static int
+vec_IMin_serial(const int *vec, int n)
+{
+  int   best;
+  int   i;
+  best = vec[0];
+  for (i = 1; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+static int
+vec_DArgMax_serial(const double *vec, int n)
+{
+  int i;
+  int best = 0;
+
+  for (i = 1; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+static int
+vec_FArgMax_serial(const float *vec, int n)
+{
+  int i;
+  int best = 0;
+
+  for (i = 1; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+static int
+vec_IArgMax_serial(const int *vec, int n)
+{
+  int i;
+  int best = 0;
+
+  for (i = 1; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+static int
+vec_DArgMin_serial(const double *vec, int n)
+{
+  int i;
+  int best = 0;
+  for (i = 1; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+static int
+vec_FArgMin_serial(const float *vec, int n)
+{
+  int   i;
+  int   best = 0;
+
+  for (i = 1; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+static int
+vec_IArgMin_serial(const int *vec, int n)
+{
+  int   i;
+  int   best = 0;
+
+  for (i = 1; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+static void
+vec_DScale_serial(double *vec, int n, double scale)
+{
+  int i;
+  for (i = 0; i < n; i++) vec[i] *= scale;
+}
+
+static void
+vec_FScale_serial(float *vec, int n, float scale)
+{
+  int i;
+  for (i = 0; i < n; i++) vec[i] *= scale;
+}
+
+static void
+vec_IScale_serial(int *vec, int n, int scale)
+{
+  int i;
+  for (i = 0; i < n; i++) vec[i] *= scale;
+}
+
+static void
+vec_DAddScaled_serial(double *vec1, const double *vec2, double a, int n)
+{
+  int i;
+  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+static void
+vec_FAddScaled_serial(float *vec1, const float *vec2, float a, int n)
+{
+  int i;
+  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+static void
+vec_IAddScaled_serial(int *vec1, const int *vec2, int a, int n)
+{
+  int i;
+  for (i = 0; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+static float
+vec_FLogSum_serial(const float *vec, int n)
+{
+  int i;
+  float max, sum;
+  
+  max = vec_FMax_serial(vec, n);
+  if (max == eslINFINITY) return eslINFINITY; 
+  sum = 0.0;
+  for (i = 0; i < n; i++)
+    if (vec[i] > max - 50.)      // FLT_EPSILON ~ 1.19e-7; FLT_MIN ~ 1.17e-38; log() ~ -16, -87
+      sum += expf(vec[i] - max);
+  sum = logf(sum) + max;
+  return sum;
+}
+
+static float
+vec_FEntropy_serial(const float *p, int n)
+{
+  float  H = 0.;
+  int    i;
+
+  for (i = 0; i < n; i++)
+    if (p[i] > 0.) H -= p[i] * log2f(p[i]);
+  return H;
+}
+
+
+static const struct vec_kernels vec_serial = {
+  .name = "serial",
+  .DSum       = vec_DSum_serial,
+  .FSum       = vec_FSum_serial,
+  .ISum       = vec_ISum_serial,
+  .DDot       = vec_DDot_serial,
+  .FDot       = vec_FDot_serial,
+  .IDot       = vec_IDot_serial,
+  .DMax       = vec_DMax_serial,
+  .FMax       = vec_FMax_serial,
+  .IMax       = vec_IMax_serial,
+  .DMin       = vec_DMin_serial,
+  .FMin       = vec_FMin_serial,
+  .IMin       = vec_IMin_serial,
+  .DArgMax    = vec_DArgMax_serial,
+  .FArgMax    = vec_FArgMax_serial,
+  .IArgMax    = vec_IArgMax_serial,
+  .DArgMin    = vec_DArgMin_serial,
+  .FArgMin    = vec_FArgMin_serial,
+  .IArgMin    = vec_IArgMin_serial,
+  .DScale     = vec_DScale_serial,
+  .FScale     = vec_FScale_serial,
+  .IScale     = vec_IScale_serial,
+  .DAddScaled = vec_DAddScaled_serial,
+  .FAddScaled = vec_FAddScaled_serial,
+  .IAddScaled = vec_IAddScaled_serial,
+  .FLogSum    = vec_FLogSum_serial,
+  .FEntropy   = vec_FEntropy_serial,
+};
+#if defined(eslENABLE_SSE) && defined(eslENABLE_SSE4)
+static const struct vec_kernels vec_sse = {
+  .name = "sse",
+  .DSum       = esl_vec_DSum_sse,
+  .FSum       = esl_vec_FSum_sse,
+  .ISum       = esl_vec_ISum_sse,
+  .DDot       = esl_vec_DDot_sse,
+  .FDot       = esl_vec_FDot_sse,
+  .IDot       = esl_vec_IDot_sse,
+  .DMax       = esl_vec_DMax_sse,
+  .FMax       = esl_vec_FMax_sse,
+  .IMax       = esl_vec_IMax_sse,
+  .DMin       = esl_vec_DMin_sse,
+  .FMin       = esl_vec_FMin_sse,
+  .IMin       = esl_vec_IMin_sse,
+  .DArgMax    = esl_vec_DArgMax_sse,
+  .FArgMax    = esl_vec_FArgMax_sse,
+  .IArgMax    = esl_vec_IArgMax_sse,
+  .DArgMin    = esl_vec_DArgMin_sse,
+  .FArgMin    = esl_vec_FArgMin_sse,
+  .IArgMin    = esl_vec_IArgMin_sse,
+  .DScale     = esl_vec_DScale_sse,
+  .FScale     = esl_vec_FScale_sse,
+  .IScale     = esl_vec_IScale_sse,
+  .DAddScaled = esl_vec_DAddScaled_sse,
+  .FAddScaled = esl_vec_FAddScaled_sse,
+  .IAddScaled = esl_vec_IAddScaled_sse,
+  .FLogSum    = esl_vec_FLogSum_sse,
+  .FEntropy   = esl_vec_FEntropy_sse,
+};
+#endif
+#ifdef eslENABLE_AVX
+static const struct vec_kernels vec_avx = {
+  .name = "avx",
+  .DSum       = esl_vec_DSum_avx,
+  .FSum       = esl_vec_FSum_avx,
+  .ISum       = esl_vec_ISum_avx,
+  .DDot       = esl_vec_DDot_avx,
+  .FDot       = esl_vec_FDot_avx,
+  .IDot       = esl_vec_IDot_avx,
+  .DMax       = esl_vec_DMax_avx,
+  .FMax       = esl_vec_FMax_avx,
+  .IMax       = esl_vec_IMax_avx,
+  .DMin       = esl_vec_DMin_avx,
+  .FMin       = esl_vec_FMin_avx,
+  .IMin       = esl_vec_IMin_avx,
+  .DArgMax    = esl_vec_DArgMax_avx,
+  .FArgMax    = esl_vec_FArgMax_avx,
+  .IArgMax    = esl_vec_IArgMax_avx,
+  .DArgMin    = esl_vec_DArgMin_avx,
+  .FArgMin    = esl_vec_FArgMin_avx,
+  .IArgMin    = esl_vec_IArgMin_avx,
+  .DScale     = esl_vec_DScale_avx,
+  .FScale     = esl_vec_FScale_avx,
+  .IScale     = esl_vec_IScale_avx,
+  .DAddScaled = esl_vec_DAddScaled_avx,
+  .FAddScaled = esl_vec_FAddScaled_avx,
+  .IAddScaled = esl_vec_IAddScaled_avx,
+  .FLogSum    = esl_vec_FLogSum_avx,
+  .FEntropy   = esl_vec_FEntropy_avx,
+};
+#endif
+#ifdef eslENABLE_AVX512
+static const struct vec_kernels vec_avx512 = {
+  .name = "avx512",
+  .DSum       = esl_vec_DSum_avx512,
+  .FSum       = esl_vec_FSum_avx512,
+  .ISum       = esl_vec_ISum_avx512,
+  .DDot       = esl_vec_DDot_avx512,
+  .FDot       = esl_vec_FDot_avx512,
+  .IDot       = esl_vec_IDot_avx512,
+  .DMax       = esl_vec_DMax_avx512,
+  .FMax       = esl_vec_FMax_avx512,
+  .IMax       = esl_vec_IMax_avx512,
+  .DMin       = esl_vec_DMin_avx512,
+  .FMin       = esl_vec_FMin_avx512,
+  .IMin       = esl_vec_IMin_avx512,
+  .DArgMax    = esl_vec_DArgMax_avx512,
+  .FArgMax    = esl_vec_FArgMax_avx512,
+  .IArgMax    = esl_vec_IArgMax_avx512,
+  .DArgMin    = esl_vec_DArgMin_avx512,
+  .FArgMin    = esl_vec_FArgMin_avx512,
+  .IArgMin    = esl_vec_IArgMin_avx512,
+  .DScale     = esl_vec_DScale_avx512,
+  .FScale     = esl_vec_FScale_avx512,
+  .IScale     = esl_vec_IScale_avx512,
+  .DAddScaled = esl_vec_DAddScaled_avx512,
+  .FAddScaled = esl_vec_FAddScaled_avx512,
+  .IAddScaled = esl_vec_IAddScaled_avx512,
+  .FLogSum    = esl_vec_FLogSum_avx512,
+  .FEntropy   = esl_vec_FEntropy_avx512,
+};
+#endif
+
+
+/* vec_supported()
+ * Put the implementations that are compiled in and that this
+ * processor supports in <impl>, in order of increasing vector width,
+ * starting with the serial one; return how many there are (1..4).
+ */
+static int
+vec_supported(const struct vec_kernels **impl)
+{
+  int n = 0;
+
+  impl[n++] = &vec_serial;
+#if defined(eslENABLE_SSE) && defined(eslENABLE_SSE4)
+  if (esl_cpu_has_sse4())   impl[n++] = &vec_sse;
+#endif
+#ifdef eslENABLE_AVX
+  if (esl_cpu_has_avx())    impl[n++] = &vec_avx;
+#endif
+#ifdef eslENABLE_AVX512
+  if (esl_cpu_has_avx512()) impl[n++] = &vec_avx512;
+#endif
+  return n;
+}
+
+/* vec_kernels()
+ * Return the implementation the vectorops API calls: the widest one
+ * the processor supports. It's selected on the first call. (Threads
+ * racing on that first call all store the same value.)
+ */
+static const struct vec_kernels *
+vec_kernels(void)
+{
+  static const struct vec_kernels *vk = NULL;
+  const struct vec_kernels        *impl[4];
+
+  if (! vk) vk = impl[vec_supported(impl) - 1];
+  return vk;
+}
+
+
+/*****************************************************************
+ * 3. Unit tests
  *****************************************************************/ 
 #ifdef eslVECTOROPS_TESTDRIVE
 
+#include <string.h>
+
 #include "esl_random.h"
 
 /* utest_ivectors
@@ -1827,11 +2211,218 @@ utest_pvectors(void)
 
   return;
 }
+
+
+/* utest_dkernels
+ * Compares each vector implementation of the D operations that the
+ * processor supports to the serial reference, for all lengths n up
+ * to 100. Half the vectors are whole numbers 0..9, so there are ties
+ * that ArgMax and ArgMin have to break the same way. Max, Min, ArgMax,
+ * ArgMin, and Scale must agree exactly; sums up to roundoff, and
+ * AddScaled to within an absolute tolerance, because AVX-512 code may
+ * use fused multiply-adds, and values can cancel to near zero. Also
+ * checks that a NaN in vec[0] is returned by Max, and other NaNs are
+ * skipped, as in the serial code.
+ */
+static void
+utest_dkernels(ESL_RANDOMNESS *rng)
+{
+  char    msg[] = "esl_vectorops dkernels test failed";
+  const struct vec_kernels *impl[4];
+  int     nimpl = vec_supported(impl);
+  int     nmax  = 100;
+  double *v1    = malloc(sizeof(double) * nmax);
+  double *v2    = malloc(sizeof(double) * nmax);
+  double *w1    = malloc(sizeof(double) * nmax);
+  double *w2    = malloc(sizeof(double) * nmax);
+  const struct vec_kernels *vk;
+  int     ties;
+  int     n, i, k;
+
+  for (k = 1; k < nimpl; k++)
+    {
+      vk = impl[k];
+      for (n = 0; n <= nmax; n++)
+        {
+          ties = esl_rnd_Roll(rng, 2);
+          for (i = 0; i < n; i++)
+            {
+              v1[i] = (ties ? (double) esl_rnd_Roll(rng, 10) : esl_random(rng));
+              v2[i] = esl_random(rng);
+            }
+
+          if (esl_DCompare(vk->DSum(v1, n),     vec_serial.DSum(v1, n),     1e-12) != eslOK) esl_fatal(msg);
+          if (esl_DCompare(vk->DDot(v1, v2, n), vec_serial.DDot(v1, v2, n), 1e-12) != eslOK) esl_fatal(msg);
+          if (vk->DArgMax(v1, n) != vec_serial.DArgMax(v1, n))                             esl_fatal(msg);
+          if (vk->DArgMin(v1, n) != vec_serial.DArgMin(v1, n))                             esl_fatal(msg);
+          if (n > 0 && vk->DMax(v1, n) != vec_serial.DMax(v1, n))                          esl_fatal(msg);
+          if (n > 0 && vk->DMin(v1, n) != vec_serial.DMin(v1, n))                          esl_fatal(msg);
+
+          esl_vec_DCopy(v1, n, w1);
+          esl_vec_DCopy(v1, n, w2);
+          vec_serial.DScale(w1, n, 0.3);
+          vk->DScale(w2, n, 0.3);
+          if (memcmp(w1, w2, sizeof(double) * n) != 0)             esl_fatal(msg);
+          vec_serial.DAddScaled(w1, v2, -0.7, n);
+          vk->DAddScaled(w2, v2, -0.7, n);
+          for (i = 0; i < n; i++)
+            if (esl_DCompareAbs(w1[i], w2[i], 1e-12) != eslOK)     esl_fatal(msg);
+        }
+
+      v1[nmax/2] = eslNaN;
+      if (vk->DMax(v1, nmax)    != vec_serial.DMax(v1, nmax))      esl_fatal(msg);
+      if (vk->DArgMin(v1, nmax) != vec_serial.DArgMin(v1, nmax))   esl_fatal(msg);
+      v1[0] = eslNaN;
+      if (! isnan(vk->DMax(v1, nmax)))                             esl_fatal(msg);
+      if (! isnan(vk->DMin(v1, nmax)))                             esl_fatal(msg);
+      if (vk->DArgMax(v1, nmax) != 0)                              esl_fatal(msg);
+    }
+
+  free(v1);
+  free(v2);
+  free(w1);
+  free(w2);
+}
+
+
+/* utest_fkernels
+ * Same as utest_dkernels(), for the F operations, plus LogSum (of
+ * log probabilities, some of them -inf) and Entropy (of probability
+ * vectors, some elements zero), which use vectorized logf(), expf()
+ * and are compared to within an absolute 1e-5.
+ */
+static void
+utest_fkernels(ESL_RANDOMNESS *rng)
+{
+  char   msg[] = "esl_vectorops fkernels test failed";
+  const struct vec_kernels *impl[4];
+  int    nimpl = vec_supported(impl);
+  int    nmax  = 100;
+  float *v1    = malloc(sizeof(float) * nmax);
+  float *v2    = malloc(sizeof(float) * nmax);
+  float *w1    = malloc(sizeof(float) * nmax);
+  float *w2    = malloc(sizeof(float) * nmax);
+  const struct vec_kernels *vk;
+  int    ties;
+  int    n, i, k;
+
+  for (k = 1; k < nimpl; k++)
+    {
+      vk = impl[k];
+      for (n = 0; n <= nmax; n++)
+        {
+          ties = esl_rnd_Roll(rng, 2);
+          for (i = 0; i < n; i++)
+            {
+              v1[i] = (ties ? (float) esl_rnd_Roll(rng, 10) : esl_random(rng));
+              v2[i] = esl_random(rng);
+            }
+
+          if (esl_FCompare(vk->FSum(v1, n),     vec_serial.FSum(v1, n),     1e-6) != eslOK) esl_fatal(msg);
+          if (esl_FCompare(vk->FDot(v1, v2, n), vec_serial.FDot(v1, v2, n), 1e-5) != eslOK) esl_fatal(msg);
+          if (vk->FArgMax(v1, n) != vec_serial.FArgMax(v1, n))                            esl_fatal(msg);
+          if (vk->FArgMin(v1, n) != vec_serial.FArgMin(v1, n))                            esl_fatal(msg);
+          if (n > 0 && vk->FMax(v1, n) != vec_serial.FMax(v1, n))                         esl_fatal(msg);
+          if (n > 0 && vk->FMin(v1, n) != vec_serial.FMin(v1, n))                         esl_fatal(msg);
+
+          esl_vec_FCopy(v1, n, w1);
+          esl_vec_FCopy(v1, n, w2);
+          vec_serial.FScale(w1, n, 0.3);
+          vk->FScale(w2, n, 0.3);
+          if (memcmp(w1, w2, sizeof(float) * n) != 0)             esl_fatal(msg);
+          vec_serial.FAddScaled(w1, v2, -0.7, n);
+          vk->FAddScaled(w2, v2, -0.7, n);
+          for (i = 0; i < n; i++)
+            if (esl_FCompareAbs(w1[i], w2[i], 1e-6) != eslOK)     esl_fatal(msg);
+
+          /* p-vector with some zeros; log p-vector with some -inf */
+          for (i = 0; i < n; i++) w1[i] = (esl_rnd_Roll(rng, 10) == 0 ? 0. : esl_random(rng));
+          esl_vec_FNorm(w1, n);
+          if (esl_FCompareAbs(vk->FEntropy(w1, n), vec_serial.FEntropy(w1, n), 1e-5) != eslOK) esl_fatal(msg);
+          for (i = 0; i < n; i++) w1[i] = (w1[i] > 0. ? 20. * (esl_random(rng) - 1.) : -eslINFINITY);
+          if (n > 0 && esl_FCompareAbs(vk->FLogSum(w1, n), vec_serial.FLogSum(w1, n), 1e-5) != eslOK) esl_fatal(msg);
+        }
+
+      esl_vec_FSet(w1, nmax, -eslINFINITY);
+      if (vk->FLogSum(w1, nmax) != -eslINFINITY)                  esl_fatal(msg);
+      w1[nmax-1] = eslINFINITY;
+      if (vk->FLogSum(w1, nmax) != eslINFINITY)                   esl_fatal(msg);
+
+      v1[nmax/2] = eslNaN;
+      if (vk->FMax(v1, nmax)    != vec_serial.FMax(v1, nmax))     esl_fatal(msg);
+      if (vk->FArgMin(v1, nmax) != vec_serial.FArgMin(v1, nmax))  esl_fatal(msg);
+      v1[0] = eslNaN;
+      if (! isnan(vk->FMax(v1, nmax)))                            esl_fatal(msg);
+      if (! isnan(vk->FMin(v1, nmax)))                            esl_fatal(msg);
+      if (vk->FArgMax(v1, nmax) != 0)                             esl_fatal(msg);
+    }
+
+  free(v1);
+  free(v2);
+  free(w1);
+  free(w2);
+}
+
+
+/* utest_ikernels
+ * Same as utest_dkernels(), for the I operations, which must all
+ * agree exactly.
+ */
+static void
+utest_ikernels(ESL_RANDOMNESS *rng)
+{
+  char msg[] = "esl_vectorops ikernels test failed";
+  const struct vec_kernels *impl[4];
+  int  nimpl = vec_supported(impl);
+  int  nmax  = 100;
+  int *v1    = malloc(sizeof(int) * nmax);
+  int *v2    = malloc(sizeof(int) * nmax);
+  int *w1    = malloc(sizeof(int) * nmax);
+  int *w2    = malloc(sizeof(int) * nmax);
+  const struct vec_kernels *vk;
+  int  range;
+  int  n, i, k;
+
+  for (k = 1; k < nimpl; k++)
+    {
+      vk = impl[k];
+      for (n = 0; n <= nmax; n++)
+        {
+          range = (esl_rnd_Roll(rng, 2) ? 10 : 2001);
+          for (i = 0; i < n; i++)
+            {
+              v1[i] = esl_rnd_Roll(rng, range) - range/2;
+              v2[i] = esl_rnd_Roll(rng, 2001)  - 1000;
+            }
+
+          if (vk->ISum(v1, n)     != vec_serial.ISum(v1, n))             esl_fatal(msg);
+          if (vk->IDot(v1, v2, n) != vec_serial.IDot(v1, v2, n))         esl_fatal(msg);
+          if (vk->IArgMax(v1, n)  != vec_serial.IArgMax(v1, n))          esl_fatal(msg);
+          if (vk->IArgMin(v1, n)  != vec_serial.IArgMin(v1, n))          esl_fatal(msg);
+          if (n > 0 && vk->IMax(v1, n) != vec_serial.IMax(v1, n))        esl_fatal(msg);
+          if (n > 0 && vk->IMin(v1, n) != vec_serial.IMin(v1, n))        esl_fatal(msg);
+
+          esl_vec_ICopy(v1, n, w1);
+          esl_vec_ICopy(v1, n, w2);
+          vec_serial.IScale(w1, n, -3);
+          vk->IScale(w2, n, -3);
+          if (esl_vec_ICompare(w1, w2, n) != eslOK)                      esl_fatal(msg);
+          vec_serial.IAddScaled(w1, v2, 7, n);
+          vk->IAddScaled(w2, v2, 7, n);
+          if (esl_vec_ICompare(w1, w2, n) != eslOK)                      esl_fatal(msg);
+        }
+    }
+
+  free(v1);
+  free(v2);
+  free(w1);
+  free(w2);
+}
 #endif /*eslVECTOROPS_TESTDRIVE*/
 
 
 /*****************************************************************
- * 3. Test driver
+ * 4. Test driver
  *****************************************************************/ 
 #ifdef eslVECTOROPS_TESTDRIVE
 
@@ -1862,6 +2453,9 @@ main(int argc, char **argv)
   utest_fvectors(rng);
   utest_dvectors(rng);
   utest_pvectors();
+  utest_dkernels(rng);
+  utest_fkernels(rng);
+  utest_ikernels(rng);
 
   fprintf(stderr, "#  status = ok\n");
 
@@ -1872,12 +2466,166 @@ main(int argc, char **argv)
 #endif /*eslVECTOROPS_TESTDRIVE*/
 
 /*****************************************************************
- * 4. Examples
+ * 5. Benchmark.
+ *****************************************************************/
+#ifdef eslVECTOROPS_BENCHMARK
+/* gcc -O3 -I. -L. -o esl_vectorops_benchmark -DeslVECTOROPS_BENCHMARK esl_vectorops.c -leasel -lm
+ * ./esl_vectorops_benchmark            # n = 4, 20, 100, 1000, 10000
+ * ./esl_vectorops_benchmark -n 400     # just n = 400
+ *
+ * Times each vectorized operation, serial and each vector
+ * implementation the processor supports, on vectors of length n,
+ * calling it N/n times. Reports millions of elements per second,
+ * and the speedup over the serial version.
+ */
+#include "esl_config.h"
+
+#include <stdio.h>
+
+#include "easel.h"
+#include "esl_cpu.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_stopwatch.h"
+#include "esl_vectorops.h"
+
+static ESL_OPTIONS options[] = {
+  /* name  type         default    env   range  togs  reqs  incomp  help                                  docgrp */
+  {"-h",  eslARG_NONE,      FALSE, NULL, NULL,  NULL, NULL, NULL, "show help and usage",                      0},
+  {"-n",  eslARG_INT,         "0", NULL, "n>=0",NULL, NULL, NULL, "time only length <n>, not 4..10000",       0},
+  {"-s",  eslARG_INT,        "42", NULL, NULL,  NULL, NULL, NULL, "set random number seed to <n>",            0},
+  {"-N",  eslARG_INT,  "10000000", NULL, "n>0", NULL, NULL, NULL, "number of elements per timing",            0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options]";
+static char banner[] = "benchmark driver for vectorops module";
+
+/* The operations, in the order of struct vec_kernels */
+static const char *opname[] = { "DSum",    "FSum",    "ISum",    "DDot",    "FDot",       "IDot",       "DMax",       "FMax",    "IMax",
+                                "DMin",    "FMin",    "IMin",    "DArgMax", "FArgMax",    "IArgMax",    "DArgMin",    "FArgMin", "IArgMin",
+                                "DScale",  "FScale",  "IScale",  "DAddScaled", "FAddScaled", "IAddScaled", "FLogSum", "FEntropy" };
+
+/* bench_op()
+ * Call operation <op> of <vk> <reps> times on vectors of length <n>,
+ * and return the elapsed time. <vk> goes through a volatile so the
+ * compiler can't inline a serial operation and hoist it out of the
+ * loop. Scale and AddScaled are by 1 and 0, so the data don't drift.
+ */
+static double
+bench_op(ESL_STOPWATCH *w, const struct vec_kernels *vk, int op, int n, int reps,
+         double *dv1, double *dv2, float *fv1, float *fv2, int *iv1, int *iv2, double *sink)
+{
+  const struct vec_kernels * volatile vkv = vk;
+  const struct vec_kernels *k = vkv;
+  double s = 0.;
+  int    r;
+
+  esl_stopwatch_Start(w);
+  switch (op) {
+  case  0: for (r = 0; r < reps; r++) s += k->DSum(dv1, n);             break;
+  case  1: for (r = 0; r < reps; r++) s += k->FSum(fv1, n);             break;
+  case  2: for (r = 0; r < reps; r++) s += k->ISum(iv1, n);             break;
+  case  3: for (r = 0; r < reps; r++) s += k->DDot(dv1, dv2, n);        break;
+  case  4: for (r = 0; r < reps; r++) s += k->FDot(fv1, fv2, n);        break;
+  case  5: for (r = 0; r < reps; r++) s += k->IDot(iv1, iv2, n);        break;
+  case  6: for (r = 0; r < reps; r++) s += k->DMax(dv1, n);             break;
+  case  7: for (r = 0; r < reps; r++) s += k->FMax(fv1, n);             break;
+  case  8: for (r = 0; r < reps; r++) s += k->IMax(iv1, n);             break;
+  case  9: for (r = 0; r < reps; r++) s += k->DMin(dv1, n);             break;
+  case 10: for (r = 0; r < reps; r++) s += k->FMin(fv1, n);             break;
+  case 11: for (r = 0; r < reps; r++) s += k->IMin(iv1, n);             break;
+  case 12: for (r = 0; r < reps; r++) s += k->DArgMax(dv1, n);          break;
+  case 13: for (r = 0; r < reps; r++) s += k->FArgMax(fv1, n);          break;
+  case 14: for (r = 0; r < reps; r++) s += k->IArgMax(iv1, n);          break;
+  case 15: for (r = 0; r < reps; r++) s += k->DArgMin(dv1, n);          break;
+  case 16: for (r = 0; r < reps; r++) s += k->FArgMin(fv1, n);          break;
+  case 17: for (r = 0; r < reps; r++) s += k->IArgMin(iv1, n);          break;
+  case 18: for (r = 0; r < reps; r++) k->DScale(dv2, n, 1.);            break;
+  case 19: for (r = 0; r < reps; r++) k->FScale(fv2, n, 1.);            break;
+  case 20: for (r = 0; r < reps; r++) k->IScale(iv2, n, 1);             break;
+  case 21: for (r = 0; r < reps; r++) k->DAddScaled(dv2, dv1, 0., n);   break;
+  case 22: for (r = 0; r < reps; r++) k->FAddScaled(fv2, fv1, 0., n);   break;
+  case 23: for (r = 0; r < reps; r++) k->IAddScaled(iv2, iv1, 0, n);    break;
+  case 24: for (r = 0; r < reps; r++) s += k->FLogSum(fv1, n);          break;
+  case 25: for (r = 0; r < reps; r++) s += k->FEntropy(fv1, n);         break;
+  }
+  esl_stopwatch_Stop(w);
+  *sink += s;
+  return w->elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng     = esl_randomness_Create(esl_opt_GetInteger(go, "-s"));
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  int             N       = esl_opt_GetInteger(go, "-N");
+  int             len[]   = { 4, 20, 100, 1000, 10000 };
+  int             nlen    = 5;
+  const struct vec_kernels *impl[4];
+  int             nimpl   = vec_supported(impl);
+  int             maxn, n, reps;
+  double         *dv1, *dv2;
+  float          *fv1, *fv2;
+  int            *iv1, *iv2;
+  double          t0, t, sink = 0.;
+  int             a, op, k, i;
+
+  if (esl_opt_GetInteger(go, "-n") > 0) { len[0] = esl_opt_GetInteger(go, "-n"); nlen = 1; }
+  maxn = esl_vec_IMax(len, nlen);
+  dv1  = malloc(sizeof(double) * maxn);  dv2 = malloc(sizeof(double) * maxn);
+  fv1  = malloc(sizeof(float)  * maxn);  fv2 = malloc(sizeof(float)  * maxn);
+  iv1  = malloc(sizeof(int)    * maxn);  iv2 = malloc(sizeof(int)    * maxn);
+  for (i = 0; i < maxn; i++)
+    {
+      dv1[i] = esl_random(rng);  dv2[i] = esl_random(rng);
+      fv1[i] = esl_random(rng);  fv2[i] = esl_random(rng);
+      iv1[i] = esl_rnd_Roll(rng, 1000);  iv2[i] = esl_rnd_Roll(rng, 1000);
+    }
+
+  printf("# %s; best vector implementation: %s\n", esl_cpu_Get(), impl[nimpl-1]->name);
+  printf("# Melem/s, and speedup over serial, for %d elements per timing\n", N);
+  printf("# %-10s %6s %9s", "op", "n", "serial");
+  for (k = 1; k < nimpl; k++) printf(" %17s", impl[k]->name);
+  printf("\n");
+
+  for (a = 0; a < nlen; a++)
+    {
+      n    = len[a];
+      reps = ESL_MAX(1, N / ESL_MAX(1, n));
+      for (op = 0; op < 26; op++)
+        {
+          t0 = bench_op(w, impl[0], op, n, reps, dv1, dv2, fv1, fv2, iv1, iv2, &sink);
+          printf("  %-10s %6d %9.1f", opname[op], n, (double) n * reps / 1e6 / t0);
+          for (k = 1; k < nimpl; k++)
+            {
+              t = bench_op(w, impl[k], op, n, reps, dv1, dv2, fv1, fv2, iv1, iv2, &sink);
+              printf(" %9.1f (%4.1fx)", (double) n * reps / 1e6 / t, t0 / t);
+            }
+          printf("\n");
+        }
+    }
+  if (sink == 42.) printf("#\n");  // use the results
+
+  free(dv1); free(dv2);
+  free(fv1); free(fv2);
+  free(iv1); free(iv2);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*eslVECTOROPS_BENCHMARK*/
+
+
+/*****************************************************************
+ * 6. Examples
  *****************************************************************/ 
 
 #ifdef eslVECTOROPS_EXAMPLE
 /*::cexcerpt::vectorops_example::begin::*/
-/*   gcc -g -Wall -o example -I. -DeslVECTOROPS_EXAMPLE esl_vectorops.c easel.c -lm   */
+/*   gcc -g -Wall -o example -I. -DeslVECTOROPS_EXAMPLE esl_vectorops.c -L. -leasel -lm   */
 #include "easel.h"
 #include "esl_vectorops.h"
 
@@ -149,5 +149,93 @@ extern int    esl_vec_FLogValidate (const float  *vec, int n, float  tol, char *
 extern int    esl_vec_DLog2Validate(const double *vec, int n, double tol, char *errbuf);
 extern int    esl_vec_FLog2Validate(const float  *vec, int n, float  tol, char *errbuf);
 
+/* Vectorized implementations, in esl_vectorops_{sse,avx,avx512}.c.
+ * esl_vectorops.c selects one set at runtime, with esl_cpu.
+ */
+#if defined(eslENABLE_SSE) && defined(eslENABLE_SSE4)
+extern double esl_vec_DSum_sse      (const double *vec, int n);
+extern float  esl_vec_FSum_sse      (const float  *vec, int n);
+extern int    esl_vec_ISum_sse      (const int    *vec, int n);
+extern double esl_vec_DDot_sse      (const double *vec1, const double *vec2, int n);
+extern float  esl_vec_FDot_sse      (const float  *vec1, const float  *vec2, int n);
+extern int    esl_vec_IDot_sse      (const int    *vec1, const int    *vec2, int n);
+extern double esl_vec_DMax_sse      (const double *vec, int n);
+extern float  esl_vec_FMax_sse      (const float  *vec, int n);
+extern int    esl_vec_IMax_sse      (const int    *vec, int n);
+extern double esl_vec_DMin_sse      (const double *vec, int n);
+extern float  esl_vec_FMin_sse      (const float  *vec, int n);
+extern int    esl_vec_IMin_sse      (const int    *vec, int n);
+extern int    esl_vec_DArgMax_sse   (const double *vec, int n);
+extern int    esl_vec_FArgMax_sse   (const float  *vec, int n);
+extern int    esl_vec_IArgMax_sse   (const int    *vec, int n);
+extern int    esl_vec_DArgMin_sse   (const double *vec, int n);
+extern int    esl_vec_FArgMin_sse   (const float  *vec, int n);
+extern int    esl_vec_IArgMin_sse   (const int    *vec, int n);
+extern void   esl_vec_DScale_sse    (double *vec, int n, double scale);
+extern void   esl_vec_FScale_sse    (float  *vec, int n, float  scale);
+extern void   esl_vec_IScale_sse    (int    *vec, int n, int    scale);
+extern void   esl_vec_DAddScaled_sse(double *vec1, const double *vec2, double a, int n);
+extern void   esl_vec_FAddScaled_sse(float  *vec1, const float  *vec2, float  a, int n);
+extern void   esl_vec_IAddScaled_sse(int    *vec1, const int    *vec2, int    a, int n);
+extern float  esl_vec_FLogSum_sse   (const float *vec, int n);
+extern float  esl_vec_FEntropy_sse  (const float *p,   int n);
+#endif
+#ifdef eslENABLE_AVX
+extern double esl_vec_DSum_avx      (const double *vec, int n);
+extern float  esl_vec_FSum_avx      (const float  *vec, int n);
+extern int    esl_vec_ISum_avx      (const int    *vec, int n);
+extern double esl_vec_DDot_avx      (const double *vec1, const double *vec2, int n);
+extern float  esl_vec_FDot_avx      (const float  *vec1, const float  *vec2, int n);
+extern int    esl_vec_IDot_avx      (const int    *vec1, const int    *vec2, int n);
+extern double esl_vec_DMax_avx      (const double *vec, int n);
+extern float  esl_vec_FMax_avx      (const float  *vec, int n);
+extern int    esl_vec_IMax_avx      (const int    *vec, int n);
+extern double esl_vec_DMin_avx      (const double *vec, int n);
+extern float  esl_vec_FMin_avx      (const float  *vec, int n);
+extern int    esl_vec_IMin_avx      (const int    *vec, int n);
+extern int    esl_vec_DArgMax_avx   (const double *vec, int n);
+extern int    esl_vec_FArgMax_avx   (const float  *vec, int n);
+extern int    esl_vec_IArgMax_avx   (const int    *vec, int n);
+extern int    esl_vec_DArgMin_avx   (const double *vec, int n);
+extern int    esl_vec_FArgMin_avx   (const float  *vec, int n);
+extern int    esl_vec_IArgMin_avx   (const int    *vec, int n);
+extern void   esl_vec_DScale_avx    (double *vec, int n, double scale);
+extern void   esl_vec_FScale_avx    (float  *vec, int n, float  scale);
+extern void   esl_vec_IScale_avx    (int    *vec, int n, int    scale);
+extern void   esl_vec_DAddScaled_avx(double *vec1, const double *vec2, double a, int n);
+extern void   esl_vec_FAddScaled_avx(float  *vec1, const float  *vec2, float  a, int n);
+extern void   esl_vec_IAddScaled_avx(int    *vec1, const int    *vec2, int    a, int n);
+extern float  esl_vec_FLogSum_avx   (const float *vec, int n);
+extern float  esl_vec_FEntropy_avx  (const float *p,   int n);
+#endif
+#ifdef eslENABLE_AVX512
+extern double esl_vec_DSum_avx512      (const double *vec, int n);
+extern float  esl_vec_FSum_avx512      (const float  *vec, int n);
+extern int    esl_vec_ISum_avx512      (const int    *vec, int n);
+extern double esl_vec_DDot_avx512      (const double *vec1, const double *vec2, int n);
+extern float  esl_vec_FDot_avx512      (const float  *vec1, const float  *vec2, int n);
+extern int    esl_vec_IDot_avx512      (const int    *vec1, const int    *vec2, int n);
+extern double esl_vec_DMax_avx512      (const double *vec, int n);
+extern float  esl_vec_FMax_avx512      (const float  *vec, int n);
+extern int    esl_vec_IMax_avx512      (const int    *vec, int n);
+extern double esl_vec_DMin_avx512      (const double *vec, int n);
+extern float  esl_vec_FMin_avx512      (const float  *vec, int n);
+extern int    esl_vec_IMin_avx512      (const int    *vec, int n);
+extern int    esl_vec_DArgMax_avx512   (const double *vec, int n);
+extern int    esl_vec_FArgMax_avx512   (const float  *vec, int n);
+extern int    esl_vec_IArgMax_avx512   (const int    *vec, int n);
+extern int    esl_vec_DArgMin_avx512   (const double *vec, int n);
+extern int    esl_vec_FArgMin_avx512   (const float  *vec, int n);
+extern int    esl_vec_IArgMin_avx512   (const int    *vec, int n);
+extern void   esl_vec_DScale_avx512    (double *vec, int n, double scale);
+extern void   esl_vec_FScale_avx512    (float  *vec, int n, float  scale);
+extern void   esl_vec_IScale_avx512    (int    *vec, int n, int    scale);
+extern void   esl_vec_DAddScaled_avx512(double *vec1, const double *vec2, double a, int n);
+extern void   esl_vec_FAddScaled_avx512(float  *vec1, const float  *vec2, float  a, int n);
+extern void   esl_vec_IAddScaled_avx512(int    *vec1, const int    *vec2, int    a, int n);
+extern float  esl_vec_FLogSum_avx512   (const float *vec, int n);
+extern float  esl_vec_FEntropy_avx512  (const float *p,   int n);
+#endif
+
 #endif /* eslVECTOROPS_INCLUDED */
 
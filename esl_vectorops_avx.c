@@ -0,0 +1,739 @@
+/* Vector operations: AVX implementations.
+ *
+ * esl_vectorops.c dispatches the D, F, and I versions of Sum, Dot,
+ * Max, Min, ArgMax, ArgMin, Scale, AddScaled, and the F versions of
+ * LogSum and Entropy to these when the processor supports AVX2.
+ *
+ * Same algorithms as esl_vectorops_sse.c, eight floats or ints, or
+ * four doubles, at a time.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX> was
+ * set in <esl_config.h> by the configure script. Otherwise we include
+ * dummy code to silence compiler and ranlib warnings about empty
+ * translation units.
+ *
+ * Contents:
+ *    1. Horizontal reductions and Kahan summation.
+ *    2. Sum, Dot.
+ *    3. Max, Min, ArgMax, ArgMin.
+ *    4. Scale, AddScaled.
+ *    5. LogSum, Entropy.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX
+
+#include <limits.h>
+#include <math.h>
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_avx.h"
+#include "esl_vectorops.h"
+
+
+/*****************************************************************
+ * 1. Horizontal reductions and Kahan summation.
+ *****************************************************************/
+
+static inline double
+hsum_pd(__m256d a)
+{
+  __m128d b = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(b, _mm_unpackhi_pd(b, b)));
+}
+
+static inline double
+hmax_pd(__m256d a)
+{
+  __m128d b = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+  return _mm_cvtsd_f64(_mm_max_sd(b, _mm_unpackhi_pd(b, b)));
+}
+
+static inline double
+hmin_pd(__m256d a)
+{
+  __m128d b = _mm_min_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+  return _mm_cvtsd_f64(_mm_min_sd(b, _mm_unpackhi_pd(b, b)));
+}
+
+static inline int
+hsum_epi32(__m256i a)
+{
+  __m128i b = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  b = _mm_add_epi32(b, _mm_shuffle_epi32(b, 0x4e));
+  b = _mm_add_epi32(b, _mm_shuffle_epi32(b, 0xb1));
+  return _mm_cvtsi128_si32(b);
+}
+
+static inline int
+hmax_epi32(__m256i a)
+{
+  __m128i b = _mm_max_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  b = _mm_max_epi32(b, _mm_shuffle_epi32(b, 0x4e));
+  b = _mm_max_epi32(b, _mm_shuffle_epi32(b, 0xb1));
+  return _mm_cvtsi128_si32(b);
+}
+
+static inline int
+hmin_epi32(__m256i a)
+{
+  __m128i b = _mm_min_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  b = _mm_min_epi32(b, _mm_shuffle_epi32(b, 0x4e));
+  b = _mm_min_epi32(b, _mm_shuffle_epi32(b, 0xb1));
+  return _mm_cvtsi128_si32(b);
+}
+
+/* kahan_d(), kahan_f()
+ * Add <x> to the compensated sum <*sum>, with running compensation
+ * <*c>, as in esl_vec_{DF}Sum().
+ */
+static inline void
+kahan_d(double *sum, double *c, double x)
+{
+  double y = x - *c;
+  double t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+static inline void
+kahan_f(float *sum, float *c, float x)
+{
+  float y = x - *c;
+  float t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+/* kahan_fold_pd(), kahan_fold_ps()
+ * Reduce per-lane compensated sums <s>, compensations <c> to one
+ * sum and compensation, <*ret_sum>, <*ret_c>: fold the upper half of
+ * the lanes into the lower half by Kahan-adding their (s - c), until
+ * one lane is left.
+ */
+static inline void
+kahan_merge_pd(__m128d *s, __m128d *c, __m128d s2, __m128d c2)
+{
+  __m128d y = _mm_sub_pd(_mm_sub_pd(s2, c2), *c);
+  __m128d t = _mm_add_pd(*s, y);
+  *c = _mm_sub_pd(_mm_sub_pd(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_merge_ps(__m128 *s, __m128 *c, __m128 s2, __m128 c2)
+{
+  __m128 y = _mm_sub_ps(_mm_sub_ps(s2, c2), *c);
+  __m128 t = _mm_add_ps(*s, y);
+  *c = _mm_sub_ps(_mm_sub_ps(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_fold_pd(__m256d s4, __m256d c4, double *ret_sum, double *ret_c)
+{
+  __m128d s = _mm256_castpd256_pd128(s4);
+  __m128d c = _mm256_castpd256_pd128(c4);
+
+  kahan_merge_pd(&s, &c, _mm256_extractf128_pd(s4, 1), _mm256_extractf128_pd(c4, 1));
+  kahan_merge_pd(&s, &c, _mm_unpackhi_pd(s, s), _mm_unpackhi_pd(c, c));
+  *ret_sum = _mm_cvtsd_f64(s);
+  *ret_c   = _mm_cvtsd_f64(c);
+}
+
+static inline void
+kahan_fold_ps(__m256 s8, __m256 c8, float *ret_sum, float *ret_c)
+{
+  __m128 s = _mm256_castps256_ps128(s8);
+  __m128 c = _mm256_castps256_ps128(c8);
+
+  kahan_merge_ps(&s, &c, _mm256_extractf128_ps(s8, 1), _mm256_extractf128_ps(c8, 1));
+  kahan_merge_ps(&s, &c, _mm_movehl_ps(s, s), _mm_movehl_ps(c, c));
+  kahan_merge_ps(&s, &c, _mm_shuffle_ps(s, s, 0x1), _mm_shuffle_ps(c, c, 0x1));
+  *ret_sum = _mm_cvtss_f32(s);
+  *ret_c   = _mm_cvtss_f32(c);
+}
+
+
+/*****************************************************************
+ * 2. Sum, Dot.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Sum_avx()
+ * Synopsis:  AVX version of esl_vec_{DFI}Sum().
+ */
+double
+esl_vec_DSum_avx(const double *vec, int n)
+{
+  __m256d sv, cv, yv, tv;
+  double  sum = 0., c = 0.;
+  int     i   = 0;
+
+  if (n >= 4)
+    {
+      sv = cv = _mm256_setzero_pd();
+      for ( ; i + 4 <= n; i += 4)
+        {
+          yv = _mm256_sub_pd(_mm256_loadu_pd(vec+i), cv);
+          tv = _mm256_add_pd(sv, yv);
+          cv = _mm256_sub_pd(_mm256_sub_pd(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_pd(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_d(&sum, &c, vec[i]);
+  return sum;
+}
+float
+esl_vec_FSum_avx(const float *vec, int n)
+{
+  __m256 sv, cv, yv, tv;
+  float  sum = 0., c = 0.;
+  int    i   = 0;
+
+  if (n >= 8)
+    {
+      sv = cv = _mm256_setzero_ps();
+      for ( ; i + 8 <= n; i += 8)
+        {
+          yv = _mm256_sub_ps(_mm256_loadu_ps(vec+i), cv);
+          tv = _mm256_add_ps(sv, yv);
+          cv = _mm256_sub_ps(_mm256_sub_ps(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_ps(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_f(&sum, &c, vec[i]);
+  return sum;
+}
+int
+esl_vec_ISum_avx(const int *vec, int n)
+{
+  __m256i sv;
+  int     sum = 0;
+  int     i   = 0;
+
+  if (n >= 8)
+    {
+      sv = _mm256_setzero_si256();
+      for ( ; i + 8 <= n; i += 8)
+        sv = _mm256_add_epi32(sv, _mm256_loadu_si256((const __m256i *) (vec+i)));
+      sum = hsum_epi32(sv);
+    }
+  for ( ; i < n; i++) sum += vec[i];
+  return sum;
+}
+
+
+/* Function:  esl_vec_{DFI}Dot_avx()
+ * Synopsis:  AVX version of esl_vec_{DFI}Dot().
+ */
+double
+esl_vec_DDot_avx(const double *vec1, const double *vec2, int n)
+{
+  __m256d rv;
+  double  result = 0.;
+  int     i      = 0;
+
+  if (n >= 4)
+    {
+      rv = _mm256_setzero_pd();
+      for ( ; i + 4 <= n; i += 4)
+        rv = _mm256_add_pd(rv, _mm256_mul_pd(_mm256_loadu_pd(vec1+i), _mm256_loadu_pd(vec2+i)));
+      result = hsum_pd(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+float
+esl_vec_FDot_avx(const float *vec1, const float *vec2, int n)
+{
+  __m256 rv;
+  float  result = 0.;
+  int    i      = 0;
+
+  if (n >= 8)
+    {
+      rv = _mm256_setzero_ps();
+      for ( ; i + 8 <= n; i += 8)
+        rv = _mm256_add_ps(rv, _mm256_mul_ps(_mm256_loadu_ps(vec1+i), _mm256_loadu_ps(vec2+i)));
+      esl_avx_hsum_ps(rv, &result);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+int
+esl_vec_IDot_avx(const int *vec1, const int *vec2, int n)
+{
+  __m256i rv;
+  int     result = 0;
+  int     i      = 0;
+
+  if (n >= 8)
+    {
+      rv = _mm256_setzero_si256();
+      for ( ; i + 8 <= n; i += 8)
+        rv = _mm256_add_epi32(rv, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) (vec1+i)), _mm256_loadu_si256((const __m256i *) (vec2+i))));
+      result = hsum_epi32(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+
+
+/*****************************************************************
+ * 3. Max, Min, ArgMax, ArgMin.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Max_avx(), esl_vec_{DFI}Min_avx()
+ * Synopsis:  AVX versions of esl_vec_{DFI}Max(), esl_vec_{DFI}Min().
+ *
+ * Purpose:   NaN handling is the same as the serial version; see
+ *            esl_vectorops_sse.c.
+ */
+double
+esl_vec_DMax_avx(const double *vec, int n)
+{
+  __m256d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm256_set1_pd(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm256_max_pd(_mm256_loadu_pd(vec+i), bv);
+      best = hmax_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMax_avx(const float *vec, int n)
+{
+  __m256 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_ps(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm256_max_ps(_mm256_loadu_ps(vec+i), bv);
+      esl_avx_hmax_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMax_avx(const int *vec, int n)
+{
+  __m256i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_epi32(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm256_max_epi32(bv, _mm256_loadu_si256((const __m256i *) (vec+i)));
+      best = hmax_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+double
+esl_vec_DMin_avx(const double *vec, int n)
+{
+  __m256d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm256_set1_pd(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm256_min_pd(_mm256_loadu_pd(vec+i), bv);
+      best = hmin_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMin_avx(const float *vec, int n)
+{
+  __m256 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_ps(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm256_min_ps(_mm256_loadu_ps(vec+i), bv);
+      esl_avx_hmin_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMin_avx(const int *vec, int n)
+{
+  __m256i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_epi32(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm256_min_epi32(bv, _mm256_loadu_si256((const __m256i *) (vec+i)));
+      best = hmin_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+
+/* Function:  esl_vec_{DFI}ArgMax_avx(), esl_vec_{DFI}ArgMin_avx()
+ * Synopsis:  AVX versions of esl_vec_{DFI}ArgMax(), esl_vec_{DFI}ArgMin().
+ *
+ * Purpose:   Per-lane best values and indices, reduced with ties
+ *            going to the smaller index; see esl_vectorops_sse.c.
+ *            For float and int, lanes not holding the overall best
+ *            value get INT_MAX, and a horizontal min picks the index.
+ *            All lanes are NaN only when <vec[0]> is NaN; the answer
+ *            is then 0.
+ */
+int
+esl_vec_DArgMax_avx(const double *vec, int n)
+{
+  __m256d bv, xv, m;
+  __m256i bi, xi;
+  int64_t k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm256_set1_pd(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi64x(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm256_loadu_pd(vec+i);
+          m  = _mm256_cmp_pd(xv, bv, _CMP_GT_OQ);
+          bv = _mm256_blendv_pd(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, _mm256_castpd_si256(m));
+          xi = _mm256_add_epi64(xi, _mm256_set1_epi64x(4));
+        }
+      _mm256_storeu_si256((__m256i *) k, bi);
+      best = (int) k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] > vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = (int) k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMax_avx(const float *vec, int n)
+{
+  __m256  bv, xv, m;
+  __m256i bi, xi;
+  float   mx;
+  int     best = 0;
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_ps(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm256_loadu_ps(vec+i);
+          m  = _mm256_cmp_ps(xv, bv, _CMP_GT_OQ);
+          bv = _mm256_blendv_ps(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, _mm256_castps_si256(m));
+          xi = _mm256_add_epi32(xi, _mm256_set1_epi32(8));
+        }
+      esl_avx_hmax_ps(bv, &mx);
+      m    = _mm256_cmp_ps(bv, _mm256_set1_ps(mx), _CMP_EQ_OQ);
+      best = _mm256_movemask_ps(m) ? hmin_epi32(_mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), bi, _mm256_castps_si256(m))) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMax_avx(const int *vec, int n)
+{
+  __m256i bv, xv, m;
+  __m256i bi, xi;
+  int     best = 0;
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_epi32(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm256_loadu_si256((const __m256i *) (vec+i));
+          m  = _mm256_cmpgt_epi32(xv, bv);
+          bv = _mm256_blendv_epi8(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, m);
+          xi = _mm256_add_epi32(xi, _mm256_set1_epi32(8));
+        }
+      m    = _mm256_cmpeq_epi32(bv, _mm256_set1_epi32(hmax_epi32(bv)));
+      best = hmin_epi32(_mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), bi, m));
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+int
+esl_vec_DArgMin_avx(const double *vec, int n)
+{
+  __m256d bv, xv, m;
+  __m256i bi, xi;
+  int64_t k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm256_set1_pd(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi64x(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm256_loadu_pd(vec+i);
+          m  = _mm256_cmp_pd(xv, bv, _CMP_LT_OQ);
+          bv = _mm256_blendv_pd(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, _mm256_castpd_si256(m));
+          xi = _mm256_add_epi64(xi, _mm256_set1_epi64x(4));
+        }
+      _mm256_storeu_si256((__m256i *) k, bi);
+      best = (int) k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] < vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = (int) k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMin_avx(const float *vec, int n)
+{
+  __m256  bv, xv, m;
+  __m256i bi, xi;
+  float   mx;
+  int     best = 0;
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_ps(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm256_loadu_ps(vec+i);
+          m  = _mm256_cmp_ps(xv, bv, _CMP_LT_OQ);
+          bv = _mm256_blendv_ps(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, _mm256_castps_si256(m));
+          xi = _mm256_add_epi32(xi, _mm256_set1_epi32(8));
+        }
+      esl_avx_hmin_ps(bv, &mx);
+      m    = _mm256_cmp_ps(bv, _mm256_set1_ps(mx), _CMP_EQ_OQ);
+      best = _mm256_movemask_ps(m) ? hmin_epi32(_mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), bi, _mm256_castps_si256(m))) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMin_avx(const int *vec, int n)
+{
+  __m256i bv, xv, m;
+  __m256i bi, xi;
+  int     best = 0;
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm256_set1_epi32(vec[0]);
+      bi = _mm256_setzero_si256();
+      xi = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm256_loadu_si256((const __m256i *) (vec+i));
+          m  = _mm256_cmpgt_epi32(bv, xv);
+          bv = _mm256_blendv_epi8(bv, xv, m);
+          bi = _mm256_blendv_epi8(bi, xi, m);
+          xi = _mm256_add_epi32(xi, _mm256_set1_epi32(8));
+        }
+      m    = _mm256_cmpeq_epi32(bv, _mm256_set1_epi32(hmin_epi32(bv)));
+      best = hmin_epi32(_mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), bi, m));
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+
+
+/*****************************************************************
+ * 4. Scale, AddScaled.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Scale_avx()
+ * Synopsis:  AVX version of esl_vec_{DFI}Scale().
+ */
+void
+esl_vec_DScale_avx(double *vec, int n, double scale)
+{
+  __m256d sv = _mm256_set1_pd(scale);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(vec+i, _mm256_mul_pd(_mm256_loadu_pd(vec+i), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_FScale_avx(float *vec, int n, float scale)
+{
+  __m256 sv = _mm256_set1_ps(scale);
+  int    i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(vec+i, _mm256_mul_ps(_mm256_loadu_ps(vec+i), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_IScale_avx(int *vec, int n, int scale)
+{
+  __m256i sv = _mm256_set1_epi32(scale);
+  int     i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i *) (vec+i), _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) (vec+i)), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+
+
+/* Function:  esl_vec_{DFI}AddScaled_avx()
+ * Synopsis:  AVX version of esl_vec_{DFI}AddScaled().
+ */
+void
+esl_vec_DAddScaled_avx(double *vec1, const double *vec2, double a, int n)
+{
+  __m256d av = _mm256_set1_pd(a);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(vec1+i, _mm256_add_pd(_mm256_loadu_pd(vec1+i), _mm256_mul_pd(_mm256_loadu_pd(vec2+i), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_FAddScaled_avx(float *vec1, const float *vec2, float a, int n)
+{
+  __m256 av = _mm256_set1_ps(a);
+  int    i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(vec1+i, _mm256_add_ps(_mm256_loadu_ps(vec1+i), _mm256_mul_ps(_mm256_loadu_ps(vec2+i), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_IAddScaled_avx(int *vec1, const int *vec2, int a, int n)
+{
+  __m256i av = _mm256_set1_epi32(a);
+  int     i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i *) (vec1+i),
+                        _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (vec1+i)),
+                                         _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) (vec2+i)), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+
+
+/*****************************************************************
+ * 5. LogSum, Entropy.
+ *****************************************************************/
+
+/* Function:  esl_vec_FLogSum_avx()
+ * Synopsis:  AVX version of esl_vec_FLogSum().
+ */
+float
+esl_vec_FLogSum_avx(const float *vec, int n)
+{
+  float  max = esl_vec_FMax_avx(vec, n);
+  __m256 mv, tv, sv, xv;
+  float  sum = 0.;
+  int    i   = 0;
+
+  if (max == eslINFINITY) return eslINFINITY;
+  if (n >= 8)
+    {
+      mv = _mm256_set1_ps(max);
+      tv = _mm256_set1_ps(max - 50.);
+      sv = _mm256_setzero_ps();
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm256_loadu_ps(vec+i);
+          sv = _mm256_add_ps(sv, _mm256_and_ps(_mm256_cmp_ps(xv, tv, _CMP_GT_OQ), esl_avx_expf(_mm256_sub_ps(xv, mv))));
+        }
+      esl_avx_hsum_ps(sv, &sum);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > max - 50.) sum += expf(vec[i] - max);
+  return logf(sum) + max;
+}
+
+
+/* Function:  esl_vec_FEntropy_avx()
+ * Synopsis:  AVX version of esl_vec_FEntropy().
+ */
+float
+esl_vec_FEntropy_avx(const float *p, int n)
+{
+  __m256 hv, pv;
+  float  H = 0.;
+  int    i = 0;
+
+  if (n >= 8)
+    {
+      hv = _mm256_setzero_ps();
+      for ( ; i + 8 <= n; i += 8)
+        {
+          pv = _mm256_loadu_ps(p+i);
+          hv = _mm256_add_ps(hv, _mm256_and_ps(_mm256_cmp_ps(pv, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_mul_ps(pv, esl_avx_logf(pv))));
+        }
+      esl_avx_hsum_ps(hv, &H);
+    }
+  for ( ; i < n; i++)
+    if (p[i] > 0.) H += p[i] * logf(p[i]);
+  return -H * eslCONST_LOG2R;
+}
+
+
+#else // ! eslENABLE_AVX
+void esl_vectorops_avx_silence_hack(void) { return; }
+#endif // eslENABLE_AVX or not
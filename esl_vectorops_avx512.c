@@ -0,0 +1,712 @@
+/* Vector operations: AVX-512 implementations.
+ *
+ * esl_vectorops.c dispatches the D, F, and I versions of Sum, Dot,
+ * Max, Min, ArgMax, ArgMin, Scale, AddScaled, and the F versions of
+ * LogSum and Entropy to these when the processor supports AVX-512.
+ *
+ * Same algorithms as esl_vectorops_sse.c, sixteen floats or ints, or
+ * eight doubles, at a time, with compare masks in place of blends.
+ * AVX-512 compiler flags enable FMA, so the compiler may fuse the
+ * multiplies and adds in Dot and AddScaled; those can differ from
+ * the serial versions by roundoff too.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_AVX512>
+ * was set in <esl_config.h> by the configure script. Otherwise we
+ * include dummy code to silence compiler and ranlib warnings about
+ * empty translation units.
+ *
+ * Contents:
+ *    1. Kahan summation.
+ *    2. Sum, Dot.
+ *    3. Max, Min, ArgMax, ArgMin.
+ *    4. Scale, AddScaled.
+ *    5. LogSum, Entropy.
+ */
+#include "esl_config.h"
+#ifdef eslENABLE_AVX512
+
+#include <math.h>
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_avx512.h"
+#include "esl_vectorops.h"
+
+
+/*****************************************************************
+ * 1. Kahan summation.
+ *****************************************************************/
+
+/* kahan_d(), kahan_f()
+ * Add <x> to the compensated sum <*sum>, with running compensation
+ * <*c>, as in esl_vec_{DF}Sum().
+ */
+static inline void
+kahan_d(double *sum, double *c, double x)
+{
+  double y = x - *c;
+  double t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+static inline void
+kahan_f(float *sum, float *c, float x)
+{
+  float y = x - *c;
+  float t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+/* kahan_fold_pd(), kahan_fold_ps()
+ * Reduce per-lane compensated sums <s>, compensations <c> to one
+ * sum and compensation, <*ret_sum>, <*ret_c>: fold the upper half of
+ * the lanes into the lower half by Kahan-adding their (s - c), until
+ * one lane is left.
+ */
+static inline void
+kahan_merge_pd(__m128d *s, __m128d *c, __m128d s2, __m128d c2)
+{
+  __m128d y = _mm_sub_pd(_mm_sub_pd(s2, c2), *c);
+  __m128d t = _mm_add_pd(*s, y);
+  *c = _mm_sub_pd(_mm_sub_pd(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_merge_ps(__m128 *s, __m128 *c, __m128 s2, __m128 c2)
+{
+  __m128 y = _mm_sub_ps(_mm_sub_ps(s2, c2), *c);
+  __m128 t = _mm_add_ps(*s, y);
+  *c = _mm_sub_ps(_mm_sub_ps(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_merge_pd256(__m256d *s, __m256d *c, __m256d s2, __m256d c2)
+{
+  __m256d y = _mm256_sub_pd(_mm256_sub_pd(s2, c2), *c);
+  __m256d t = _mm256_add_pd(*s, y);
+  *c = _mm256_sub_pd(_mm256_sub_pd(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_merge_ps256(__m256 *s, __m256 *c, __m256 s2, __m256 c2)
+{
+  __m256 y = _mm256_sub_ps(_mm256_sub_ps(s2, c2), *c);
+  __m256 t = _mm256_add_ps(*s, y);
+  *c = _mm256_sub_ps(_mm256_sub_ps(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_fold_pd(__m512d s8, __m512d c8, double *ret_sum, double *ret_c)
+{
+  __m256d s4 = _mm512_castpd512_pd256(s8);
+  __m256d c4 = _mm512_castpd512_pd256(c8);
+  __m128d s, c;
+
+  kahan_merge_pd256(&s4, &c4, _mm512_extractf64x4_pd(s8, 1), _mm512_extractf64x4_pd(c8, 1));
+  s = _mm256_castpd256_pd128(s4);
+  c = _mm256_castpd256_pd128(c4);
+  kahan_merge_pd(&s, &c, _mm256_extractf128_pd(s4, 1), _mm256_extractf128_pd(c4, 1));
+  kahan_merge_pd(&s, &c, _mm_unpackhi_pd(s, s), _mm_unpackhi_pd(c, c));
+  *ret_sum = _mm_cvtsd_f64(s);
+  *ret_c   = _mm_cvtsd_f64(c);
+}
+
+static inline void
+kahan_fold_ps(__m512 s16, __m512 c16, float *ret_sum, float *ret_c)
+{
+  __m256 s8 = _mm512_castps512_ps256(s16);
+  __m256 c8 = _mm512_castps512_ps256(c16);
+  __m128 s, c;
+
+  kahan_merge_ps256(&s8, &c8, _mm512_extractf32x8_ps(s16, 1), _mm512_extractf32x8_ps(c16, 1));
+  s = _mm256_castps256_ps128(s8);
+  c = _mm256_castps256_ps128(c8);
+  kahan_merge_ps(&s, &c, _mm256_extractf128_ps(s8, 1), _mm256_extractf128_ps(c8, 1));
+  kahan_merge_ps(&s, &c, _mm_movehl_ps(s, s), _mm_movehl_ps(c, c));
+  kahan_merge_ps(&s, &c, _mm_shuffle_ps(s, s, 0x1), _mm_shuffle_ps(c, c, 0x1));
+  *ret_sum = _mm_cvtss_f32(s);
+  *ret_c   = _mm_cvtss_f32(c);
+}
+
+
+/*****************************************************************
+ * 2. Sum, Dot.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Sum_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_{DFI}Sum().
+ */
+double
+esl_vec_DSum_avx512(const double *vec, int n)
+{
+  __m512d sv, cv, yv, tv;
+  double  sum = 0., c = 0.;
+  int     i   = 0;
+
+  if (n >= 8)
+    {
+      sv = cv = _mm512_setzero_pd();
+      for ( ; i + 8 <= n; i += 8)
+        {
+          yv = _mm512_sub_pd(_mm512_loadu_pd(vec+i), cv);
+          tv = _mm512_add_pd(sv, yv);
+          cv = _mm512_sub_pd(_mm512_sub_pd(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_pd(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_d(&sum, &c, vec[i]);
+  return sum;
+}
+float
+esl_vec_FSum_avx512(const float *vec, int n)
+{
+  __m512 sv, cv, yv, tv;
+  float  sum = 0., c = 0.;
+  int    i   = 0;
+
+  if (n >= 16)
+    {
+      sv = cv = _mm512_setzero_ps();
+      for ( ; i + 16 <= n; i += 16)
+        {
+          yv = _mm512_sub_ps(_mm512_loadu_ps(vec+i), cv);
+          tv = _mm512_add_ps(sv, yv);
+          cv = _mm512_sub_ps(_mm512_sub_ps(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_ps(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_f(&sum, &c, vec[i]);
+  return sum;
+}
+int
+esl_vec_ISum_avx512(const int *vec, int n)
+{
+  __m512i sv;
+  int     sum = 0;
+  int     i   = 0;
+
+  if (n >= 16)
+    {
+      sv = _mm512_setzero_si512();
+      for ( ; i + 16 <= n; i += 16)
+        sv = _mm512_add_epi32(sv, _mm512_loadu_si512((const void *) (vec+i)));
+      sum = _mm512_reduce_add_epi32(sv);
+    }
+  for ( ; i < n; i++) sum += vec[i];
+  return sum;
+}
+
+
+/* Function:  esl_vec_{DFI}Dot_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_{DFI}Dot().
+ */
+double
+esl_vec_DDot_avx512(const double *vec1, const double *vec2, int n)
+{
+  __m512d rv;
+  double  result = 0.;
+  int     i      = 0;
+
+  if (n >= 8)
+    {
+      rv = _mm512_setzero_pd();
+      for ( ; i + 8 <= n; i += 8)
+        rv = _mm512_add_pd(rv, _mm512_mul_pd(_mm512_loadu_pd(vec1+i), _mm512_loadu_pd(vec2+i)));
+      result = _mm512_reduce_add_pd(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+float
+esl_vec_FDot_avx512(const float *vec1, const float *vec2, int n)
+{
+  __m512 rv;
+  float  result = 0.;
+  int    i      = 0;
+
+  if (n >= 16)
+    {
+      rv = _mm512_setzero_ps();
+      for ( ; i + 16 <= n; i += 16)
+        rv = _mm512_add_ps(rv, _mm512_mul_ps(_mm512_loadu_ps(vec1+i), _mm512_loadu_ps(vec2+i)));
+      esl_avx512_hsum_ps(rv, &result);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+int
+esl_vec_IDot_avx512(const int *vec1, const int *vec2, int n)
+{
+  __m512i rv;
+  int     result = 0;
+  int     i      = 0;
+
+  if (n >= 16)
+    {
+      rv = _mm512_setzero_si512();
+      for ( ; i + 16 <= n; i += 16)
+        rv = _mm512_add_epi32(rv, _mm512_mullo_epi32(_mm512_loadu_si512((const void *) (vec1+i)), _mm512_loadu_si512((const void *) (vec2+i))));
+      result = _mm512_reduce_add_epi32(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+
+
+/*****************************************************************
+ * 3. Max, Min, ArgMax, ArgMin.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Max_avx512(), esl_vec_{DFI}Min_avx512()
+ * Synopsis:  AVX-512 versions of esl_vec_{DFI}Max(), esl_vec_{DFI}Min().
+ *
+ * Purpose:   NaN handling is the same as the serial version; see
+ *            esl_vectorops_sse.c.
+ */
+double
+esl_vec_DMax_avx512(const double *vec, int n)
+{
+  __m512d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm512_set1_pd(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm512_max_pd(_mm512_loadu_pd(vec+i), bv);
+      best = _mm512_reduce_max_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMax_avx512(const float *vec, int n)
+{
+  __m512 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_ps(vec[0]);
+      for ( ; i + 16 <= n; i += 16)
+        bv = _mm512_max_ps(_mm512_loadu_ps(vec+i), bv);
+      esl_avx512_hmax_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMax_avx512(const int *vec, int n)
+{
+  __m512i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_epi32(vec[0]);
+      for ( ; i + 16 <= n; i += 16)
+        bv = _mm512_max_epi32(bv, _mm512_loadu_si512((const void *) (vec+i)));
+      best = _mm512_reduce_max_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+double
+esl_vec_DMin_avx512(const double *vec, int n)
+{
+  __m512d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm512_set1_pd(vec[0]);
+      for ( ; i + 8 <= n; i += 8)
+        bv = _mm512_min_pd(_mm512_loadu_pd(vec+i), bv);
+      best = _mm512_reduce_min_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMin_avx512(const float *vec, int n)
+{
+  __m512 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_ps(vec[0]);
+      for ( ; i + 16 <= n; i += 16)
+        bv = _mm512_min_ps(_mm512_loadu_ps(vec+i), bv);
+      esl_avx512_hmin_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMin_avx512(const int *vec, int n)
+{
+  __m512i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_epi32(vec[0]);
+      for ( ; i + 16 <= n; i += 16)
+        bv = _mm512_min_epi32(bv, _mm512_loadu_si512((const void *) (vec+i)));
+      best = _mm512_reduce_min_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+
+/* Function:  esl_vec_{DFI}ArgMax_avx512(), esl_vec_{DFI}ArgMin_avx512()
+ * Synopsis:  AVX-512 versions of esl_vec_{DFI}ArgMax(), esl_vec_{DFI}ArgMin().
+ *
+ * Purpose:   Per-lane best values and indices. The lanes holding
+ *            the overall best value are masked, and the smallest
+ *            index among them wins, as in the serial version. Lane
+ *            values are all NaN only when <vec[0]> is NaN; then the
+ *            mask is empty and the answer is 0.
+ */
+int
+esl_vec_DArgMax_avx512(const double *vec, int n)
+{
+  __m512d   bv, xv;
+  __m512i   bi, xi;
+  __mmask8  m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm512_set1_pd(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm512_loadu_pd(vec+i);
+          m  = _mm512_cmp_pd_mask(xv, bv, _CMP_GT_OQ);
+          bv = _mm512_mask_mov_pd(bv, m, xv);
+          bi = _mm512_mask_mov_epi64(bi, m, xi);
+          xi = _mm512_add_epi64(xi, _mm512_set1_epi64(8));
+        }
+      m    = _mm512_cmp_pd_mask(bv, _mm512_set1_pd(_mm512_reduce_max_pd(bv)), _CMP_EQ_OQ);
+      best = m ? (int) _mm512_mask_reduce_min_epi64(m, bi) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMax_avx512(const float *vec, int n)
+{
+  __m512    bv, xv;
+  __m512i   bi, xi;
+  __mmask16 m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_ps(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 16 <= n; i += 16)
+        {
+          xv = _mm512_loadu_ps(vec+i);
+          m  = _mm512_cmp_ps_mask(xv, bv, _CMP_GT_OQ);
+          bv = _mm512_mask_mov_ps(bv, m, xv);
+          bi = _mm512_mask_mov_epi32(bi, m, xi);
+          xi = _mm512_add_epi32(xi, _mm512_set1_epi32(16));
+        }
+      m    = _mm512_cmp_ps_mask(bv, _mm512_set1_ps(_mm512_reduce_max_ps(bv)), _CMP_EQ_OQ);
+      best = m ? _mm512_mask_reduce_min_epi32(m, bi) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMax_avx512(const int *vec, int n)
+{
+  __m512i   bv, xv;
+  __m512i   bi, xi;
+  __mmask16 m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_epi32(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 16 <= n; i += 16)
+        {
+          xv = _mm512_loadu_si512((const void *) (vec+i));
+          m  = _mm512_cmpgt_epi32_mask(xv, bv);
+          bv = _mm512_mask_mov_epi32(bv, m, xv);
+          bi = _mm512_mask_mov_epi32(bi, m, xi);
+          xi = _mm512_add_epi32(xi, _mm512_set1_epi32(16));
+        }
+      m    = _mm512_cmpeq_epi32_mask(bv, _mm512_set1_epi32(_mm512_reduce_max_epi32(bv)));
+      best = _mm512_mask_reduce_min_epi32(m, bi);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+int
+esl_vec_DArgMin_avx512(const double *vec, int n)
+{
+  __m512d   bv, xv;
+  __m512i   bi, xi;
+  __mmask8  m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 8)
+    {
+      bv = _mm512_set1_pd(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 8 <= n; i += 8)
+        {
+          xv = _mm512_loadu_pd(vec+i);
+          m  = _mm512_cmp_pd_mask(xv, bv, _CMP_LT_OQ);
+          bv = _mm512_mask_mov_pd(bv, m, xv);
+          bi = _mm512_mask_mov_epi64(bi, m, xi);
+          xi = _mm512_add_epi64(xi, _mm512_set1_epi64(8));
+        }
+      m    = _mm512_cmp_pd_mask(bv, _mm512_set1_pd(_mm512_reduce_min_pd(bv)), _CMP_EQ_OQ);
+      best = m ? (int) _mm512_mask_reduce_min_epi64(m, bi) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMin_avx512(const float *vec, int n)
+{
+  __m512    bv, xv;
+  __m512i   bi, xi;
+  __mmask16 m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_ps(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 16 <= n; i += 16)
+        {
+          xv = _mm512_loadu_ps(vec+i);
+          m  = _mm512_cmp_ps_mask(xv, bv, _CMP_LT_OQ);
+          bv = _mm512_mask_mov_ps(bv, m, xv);
+          bi = _mm512_mask_mov_epi32(bi, m, xi);
+          xi = _mm512_add_epi32(xi, _mm512_set1_epi32(16));
+        }
+      m    = _mm512_cmp_ps_mask(bv, _mm512_set1_ps(_mm512_reduce_min_ps(bv)), _CMP_EQ_OQ);
+      best = m ? _mm512_mask_reduce_min_epi32(m, bi) : 0;
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMin_avx512(const int *vec, int n)
+{
+  __m512i   bv, xv;
+  __m512i   bi, xi;
+  __mmask16 m;
+  int       best = 0;
+  int       i    = 0;
+
+  if (n >= 16)
+    {
+      bv = _mm512_set1_epi32(vec[0]);
+      bi = _mm512_setzero_si512();
+      xi = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for ( ; i + 16 <= n; i += 16)
+        {
+          xv = _mm512_loadu_si512((const void *) (vec+i));
+          m  = _mm512_cmplt_epi32_mask(xv, bv);
+          bv = _mm512_mask_mov_epi32(bv, m, xv);
+          bi = _mm512_mask_mov_epi32(bi, m, xi);
+          xi = _mm512_add_epi32(xi, _mm512_set1_epi32(16));
+        }
+      m    = _mm512_cmpeq_epi32_mask(bv, _mm512_set1_epi32(_mm512_reduce_min_epi32(bv)));
+      best = _mm512_mask_reduce_min_epi32(m, bi);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+
+
+/*****************************************************************
+ * 4. Scale, AddScaled.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Scale_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_{DFI}Scale().
+ */
+void
+esl_vec_DScale_avx512(double *vec, int n, double scale)
+{
+  __m512d sv = _mm512_set1_pd(scale);
+  int     i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(vec+i, _mm512_mul_pd(_mm512_loadu_pd(vec+i), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_FScale_avx512(float *vec, int n, float scale)
+{
+  __m512 sv = _mm512_set1_ps(scale);
+  int    i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(vec+i, _mm512_mul_ps(_mm512_loadu_ps(vec+i), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_IScale_avx512(int *vec, int n, int scale)
+{
+  __m512i sv = _mm512_set1_epi32(scale);
+  int     i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_si512((void *) (vec+i), _mm512_mullo_epi32(_mm512_loadu_si512((const void *) (vec+i)), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+
+
+/* Function:  esl_vec_{DFI}AddScaled_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_{DFI}AddScaled().
+ */
+void
+esl_vec_DAddScaled_avx512(double *vec1, const double *vec2, double a, int n)
+{
+  __m512d av = _mm512_set1_pd(a);
+  int     i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(vec1+i, _mm512_add_pd(_mm512_loadu_pd(vec1+i), _mm512_mul_pd(_mm512_loadu_pd(vec2+i), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_FAddScaled_avx512(float *vec1, const float *vec2, float a, int n)
+{
+  __m512 av = _mm512_set1_ps(a);
+  int    i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(vec1+i, _mm512_add_ps(_mm512_loadu_ps(vec1+i), _mm512_mul_ps(_mm512_loadu_ps(vec2+i), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_IAddScaled_avx512(int *vec1, const int *vec2, int a, int n)
+{
+  __m512i av = _mm512_set1_epi32(a);
+  int     i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_si512((void *) (vec1+i),
+                        _mm512_add_epi32(_mm512_loadu_si512((const void *) (vec1+i)),
+                                         _mm512_mullo_epi32(_mm512_loadu_si512((const void *) (vec2+i)), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+
+
+/*****************************************************************
+ * 5. LogSum, Entropy.
+ *****************************************************************/
+
+/* Function:  esl_vec_FLogSum_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_FLogSum().
+ */
+float
+esl_vec_FLogSum_avx512(const float *vec, int n)
+{
+  float  max = esl_vec_FMax_avx512(vec, n);
+  __m512 mv, tv, sv, xv;
+  float  sum = 0.;
+  int    i   = 0;
+
+  if (max == eslINFINITY) return eslINFINITY;
+  if (n >= 16)
+    {
+      mv = _mm512_set1_ps(max);
+      tv = _mm512_set1_ps(max - 50.);
+      sv = _mm512_setzero_ps();
+      for ( ; i + 16 <= n; i += 16)
+        {
+          xv = _mm512_loadu_ps(vec+i);
+          sv = _mm512_mask_add_ps(sv, _mm512_cmp_ps_mask(xv, tv, _CMP_GT_OQ), sv, esl_avx512_expf(_mm512_sub_ps(xv, mv)));
+        }
+      esl_avx512_hsum_ps(sv, &sum);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > max - 50.) sum += expf(vec[i] - max);
+  return logf(sum) + max;
+}
+
+
+/* Function:  esl_vec_FEntropy_avx512()
+ * Synopsis:  AVX-512 version of esl_vec_FEntropy().
+ */
+float
+esl_vec_FEntropy_avx512(const float *p, int n)
+{
+  __m512 hv, pv;
+  float  H = 0.;
+  int    i = 0;
+
+  if (n >= 16)
+    {
+      hv = _mm512_setzero_ps();
+      for ( ; i + 16 <= n; i += 16)
+        {
+          pv = _mm512_loadu_ps(p+i);
+          hv = _mm512_mask_add_ps(hv, _mm512_cmp_ps_mask(pv, _mm512_setzero_ps(), _CMP_GT_OQ), hv, _mm512_mul_ps(pv, esl_avx512_logf(pv)));
+        }
+      esl_avx512_hsum_ps(hv, &H);
+    }
+  for ( ; i < n; i++)
+    if (p[i] > 0.) H += p[i] * logf(p[i]);
+  return -H * eslCONST_LOG2R;
+}
+
+
+#else // ! eslENABLE_AVX512
+void esl_vectorops_avx512_silence_hack(void) { return; }
+#endif // eslENABLE_AVX512 or not
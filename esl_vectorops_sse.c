@@ -0,0 +1,768 @@
+/* Vector operations: SSE implementations.
+ *
+ * esl_vectorops.c dispatches the D, F, and I versions of Sum, Dot,
+ * Max, Min, ArgMax, ArgMin, Scale, AddScaled, and the F versions of
+ * LogSum and Entropy to these when the processor supports SSE4.1.
+ *
+ * Each routine works on four floats or ints, or two doubles, at a
+ * time, with unaligned loads, and finishes the last <n % 4> (or
+ * <n % 2>) elements serially. Results agree with the serial versions
+ * except for floating point roundoff in the sums, which are taken in
+ * a different order: Sum is a Kahan summation within each vector
+ * lane, then across lanes. Max, Min, ArgMax, and ArgMin return
+ * exactly what the serial versions do, including the smallest index
+ * on ties.
+ *
+ * This code is conditionally compiled, only when <eslENABLE_SSE> and
+ * <eslENABLE_SSE4> were set in <esl_config.h> by the configure
+ * script. Otherwise we include dummy code to silence compiler and
+ * ranlib warnings about empty translation units.
+ *
+ * Contents:
+ *    1. Horizontal reductions and Kahan summation.
+ *    2. Sum, Dot.
+ *    3. Max, Min, ArgMax, ArgMin.
+ *    4. Scale, AddScaled.
+ *    5. LogSum, Entropy.
+ */
+#include "esl_config.h"
+#if defined(eslENABLE_SSE) && defined(eslENABLE_SSE4)
+
+#include <math.h>
+#include <x86intrin.h>
+
+#include "easel.h"
+#include "esl_sse.h"
+#include "esl_vectorops.h"
+
+
+/*****************************************************************
+ * 1. Horizontal reductions and Kahan summation.
+ *****************************************************************/
+
+static inline double
+hsum_pd(__m128d a)
+{
+  return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+static inline double
+hmax_pd(__m128d a)
+{
+  return _mm_cvtsd_f64(_mm_max_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+static inline double
+hmin_pd(__m128d a)
+{
+  return _mm_cvtsd_f64(_mm_min_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+static inline int
+hsum_epi32(__m128i a)
+{
+  a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0x4e));
+  a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0xb1));
+  return _mm_cvtsi128_si32(a);
+}
+
+static inline int
+hmax_epi32(__m128i a)
+{
+  a = _mm_max_epi32(a, _mm_shuffle_epi32(a, 0x4e));
+  a = _mm_max_epi32(a, _mm_shuffle_epi32(a, 0xb1));
+  return _mm_cvtsi128_si32(a);
+}
+
+static inline int
+hmin_epi32(__m128i a)
+{
+  a = _mm_min_epi32(a, _mm_shuffle_epi32(a, 0x4e));
+  a = _mm_min_epi32(a, _mm_shuffle_epi32(a, 0xb1));
+  return _mm_cvtsi128_si32(a);
+}
+
+/* kahan_d(), kahan_f()
+ * Add <x> to the compensated sum <*sum>, with running compensation
+ * <*c>, as in esl_vec_{DF}Sum().
+ */
+static inline void
+kahan_d(double *sum, double *c, double x)
+{
+  double y = x - *c;
+  double t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+static inline void
+kahan_f(float *sum, float *c, float x)
+{
+  float y = x - *c;
+  float t = *sum + y;
+  *c   = (t - *sum) - y;
+  *sum = t;
+}
+
+/* kahan_fold_pd(), kahan_fold_ps()
+ * Reduce per-lane compensated sums <s>, compensations <c> to one
+ * sum and compensation, <*ret_sum>, <*ret_c>: fold the upper half of
+ * the lanes into the lower half by Kahan-adding their (s - c), until
+ * one lane is left.
+ */
+static inline void
+kahan_merge_pd(__m128d *s, __m128d *c, __m128d s2, __m128d c2)
+{
+  __m128d y = _mm_sub_pd(_mm_sub_pd(s2, c2), *c);
+  __m128d t = _mm_add_pd(*s, y);
+  *c = _mm_sub_pd(_mm_sub_pd(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_merge_ps(__m128 *s, __m128 *c, __m128 s2, __m128 c2)
+{
+  __m128 y = _mm_sub_ps(_mm_sub_ps(s2, c2), *c);
+  __m128 t = _mm_add_ps(*s, y);
+  *c = _mm_sub_ps(_mm_sub_ps(t, *s), y);
+  *s = t;
+}
+
+static inline void
+kahan_fold_pd(__m128d s, __m128d c, double *ret_sum, double *ret_c)
+{
+  kahan_merge_pd(&s, &c, _mm_unpackhi_pd(s, s), _mm_unpackhi_pd(c, c));
+  *ret_sum = _mm_cvtsd_f64(s);
+  *ret_c   = _mm_cvtsd_f64(c);
+}
+
+static inline void
+kahan_fold_ps(__m128 s, __m128 c, float *ret_sum, float *ret_c)
+{
+  kahan_merge_ps(&s, &c, _mm_movehl_ps(s, s), _mm_movehl_ps(c, c));
+  kahan_merge_ps(&s, &c, _mm_shuffle_ps(s, s, 0x1), _mm_shuffle_ps(c, c, 0x1));
+  *ret_sum = _mm_cvtss_f32(s);
+  *ret_c   = _mm_cvtss_f32(c);
+}
+
+
+/*****************************************************************
+ * 2. Sum, Dot.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Sum_sse()
+ * Synopsis:  SSE version of esl_vec_{DFI}Sum().
+ */
+double
+esl_vec_DSum_sse(const double *vec, int n)
+{
+  __m128d sv, cv, yv, tv;
+  double  sum = 0., c = 0.;
+  int     i   = 0;
+
+  if (n >= 2)
+    {
+      sv = cv = _mm_setzero_pd();
+      for ( ; i + 2 <= n; i += 2)
+        {
+          yv = _mm_sub_pd(_mm_loadu_pd(vec+i), cv);
+          tv = _mm_add_pd(sv, yv);
+          cv = _mm_sub_pd(_mm_sub_pd(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_pd(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_d(&sum, &c, vec[i]);
+  return sum;
+}
+float
+esl_vec_FSum_sse(const float *vec, int n)
+{
+  __m128 sv, cv, yv, tv;
+  float  sum = 0., c = 0.;
+  int    i   = 0;
+
+  if (n >= 4)
+    {
+      sv = cv = _mm_setzero_ps();
+      for ( ; i + 4 <= n; i += 4)
+        {
+          yv = _mm_sub_ps(_mm_loadu_ps(vec+i), cv);
+          tv = _mm_add_ps(sv, yv);
+          cv = _mm_sub_ps(_mm_sub_ps(tv, sv), yv);
+          sv = tv;
+        }
+      kahan_fold_ps(sv, cv, &sum, &c);
+    }
+  for ( ; i < n; i++) kahan_f(&sum, &c, vec[i]);
+  return sum;
+}
+int
+esl_vec_ISum_sse(const int *vec, int n)
+{
+  __m128i sv;
+  int     sum = 0;
+  int     i   = 0;
+
+  if (n >= 4)
+    {
+      sv = _mm_setzero_si128();
+      for ( ; i + 4 <= n; i += 4)
+        sv = _mm_add_epi32(sv, _mm_loadu_si128((const __m128i *) (vec+i)));
+      sum = hsum_epi32(sv);
+    }
+  for ( ; i < n; i++) sum += vec[i];
+  return sum;
+}
+
+
+/* Function:  esl_vec_{DFI}Dot_sse()
+ * Synopsis:  SSE version of esl_vec_{DFI}Dot().
+ */
+double
+esl_vec_DDot_sse(const double *vec1, const double *vec2, int n)
+{
+  __m128d rv;
+  double  result = 0.;
+  int     i      = 0;
+
+  if (n >= 2)
+    {
+      rv = _mm_setzero_pd();
+      for ( ; i + 2 <= n; i += 2)
+        rv = _mm_add_pd(rv, _mm_mul_pd(_mm_loadu_pd(vec1+i), _mm_loadu_pd(vec2+i)));
+      result = hsum_pd(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+float
+esl_vec_FDot_sse(const float *vec1, const float *vec2, int n)
+{
+  __m128 rv;
+  float  result = 0.;
+  int    i      = 0;
+
+  if (n >= 4)
+    {
+      rv = _mm_setzero_ps();
+      for ( ; i + 4 <= n; i += 4)
+        rv = _mm_add_ps(rv, _mm_mul_ps(_mm_loadu_ps(vec1+i), _mm_loadu_ps(vec2+i)));
+      esl_sse_hsum_ps(rv, &result);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+int
+esl_vec_IDot_sse(const int *vec1, const int *vec2, int n)
+{
+  __m128i rv;
+  int     result = 0;
+  int     i      = 0;
+
+  if (n >= 4)
+    {
+      rv = _mm_setzero_si128();
+      for ( ; i + 4 <= n; i += 4)
+        rv = _mm_add_epi32(rv, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *) (vec1+i)), _mm_loadu_si128((const __m128i *) (vec2+i))));
+      result = hsum_epi32(rv);
+    }
+  for ( ; i < n; i++) result += vec1[i] * vec2[i];
+  return result;
+}
+
+
+
+/*****************************************************************
+ * 3. Max, Min, ArgMax, ArgMin.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Max_sse(), esl_vec_{DFI}Min_sse()
+ * Synopsis:  SSE versions of esl_vec_{DFI}Max(), esl_vec_{DFI}Min().
+ *
+ * Purpose:   Each lane starts at <vec[0]>. New values are the first
+ *            operand of max/min, which return the second operand
+ *            when either is NaN: as in the serial version, a NaN in
+ *            <vec[0]> is returned, and any other NaN is ignored.
+ */
+double
+esl_vec_DMax_sse(const double *vec, int n)
+{
+  __m128d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 2)
+    {
+      bv = _mm_set1_pd(vec[0]);
+      for ( ; i + 2 <= n; i += 2)
+        bv = _mm_max_pd(_mm_loadu_pd(vec+i), bv);
+      best = hmax_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMax_sse(const float *vec, int n)
+{
+  __m128 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_ps(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm_max_ps(_mm_loadu_ps(vec+i), bv);
+      esl_sse_hmax_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMax_sse(const int *vec, int n)
+{
+  __m128i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_epi32(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm_max_epi32(bv, _mm_loadu_si128((const __m128i *) (vec+i)));
+      best = hmax_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > best) best = vec[i];
+  return best;
+}
+
+double
+esl_vec_DMin_sse(const double *vec, int n)
+{
+  __m128d bv;
+  double  best = vec[0];
+  int     i    = 0;
+
+  if (n >= 2)
+    {
+      bv = _mm_set1_pd(vec[0]);
+      for ( ; i + 2 <= n; i += 2)
+        bv = _mm_min_pd(_mm_loadu_pd(vec+i), bv);
+      best = hmin_pd(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+float
+esl_vec_FMin_sse(const float *vec, int n)
+{
+  __m128 bv;
+  float  best = vec[0];
+  int    i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_ps(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm_min_ps(_mm_loadu_ps(vec+i), bv);
+      esl_sse_hmin_ps(bv, &best);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+int
+esl_vec_IMin_sse(const int *vec, int n)
+{
+  __m128i bv;
+  int     best = vec[0];
+  int     i    = 0;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_epi32(vec[0]);
+      for ( ; i + 4 <= n; i += 4)
+        bv = _mm_min_epi32(bv, _mm_loadu_si128((const __m128i *) (vec+i)));
+      best = hmin_epi32(bv);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < best) best = vec[i];
+  return best;
+}
+
+
+/* Function:  esl_vec_{DFI}ArgMax_sse(), esl_vec_{DFI}ArgMin_sse()
+ * Synopsis:  SSE versions of esl_vec_{DFI}ArgMax(), esl_vec_{DFI}ArgMin().
+ *
+ * Purpose:   Each lane keeps its best value and the index it came
+ *            from, replacing them only on a strict improvement, so a
+ *            lane holds the smallest index of its best value. Lanes
+ *            are then reduced with ties going to the smaller index,
+ *            and the tail is done serially; the result is the same
+ *            index the serial version returns.
+ */
+int
+esl_vec_DArgMax_sse(const double *vec, int n)
+{
+  __m128d bv, xv, m;
+  __m128i bi, xi;
+  int64_t k[2];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 2)
+    {
+      bv = _mm_set1_pd(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi64x(1, 0);
+      for ( ; i + 2 <= n; i += 2)
+        {
+          xv = _mm_loadu_pd(vec+i);
+          m  = _mm_cmpgt_pd(xv, bv);
+          bv = _mm_blendv_pd(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, _mm_castpd_si128(m));
+          xi = _mm_add_epi64(xi, _mm_set1_epi64x(2));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = (int) k[0];
+      for (z = 1; z < 2; z++)
+        if (vec[k[z]] > vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = (int) k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMax_sse(const float *vec, int n)
+{
+  __m128  bv, xv, m;
+  __m128i bi, xi;
+  int     k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_ps(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi32(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm_loadu_ps(vec+i);
+          m  = _mm_cmpgt_ps(xv, bv);
+          bv = _mm_blendv_ps(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, _mm_castps_si128(m));
+          xi = _mm_add_epi32(xi, _mm_set1_epi32(4));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] > vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMax_sse(const int *vec, int n)
+{
+  __m128i bv, xv, m;
+  __m128i bi, xi;
+  int     k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_epi32(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi32(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm_loadu_si128((const __m128i *) (vec+i));
+          m  = _mm_cmpgt_epi32(xv, bv);
+          bv = _mm_blendv_epi8(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, m);
+          xi = _mm_add_epi32(xi, _mm_set1_epi32(4));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] > vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > vec[best]) best = i;
+  return best;
+}
+
+int
+esl_vec_DArgMin_sse(const double *vec, int n)
+{
+  __m128d bv, xv, m;
+  __m128i bi, xi;
+  int64_t k[2];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 2)
+    {
+      bv = _mm_set1_pd(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi64x(1, 0);
+      for ( ; i + 2 <= n; i += 2)
+        {
+          xv = _mm_loadu_pd(vec+i);
+          m  = _mm_cmplt_pd(xv, bv);
+          bv = _mm_blendv_pd(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, _mm_castpd_si128(m));
+          xi = _mm_add_epi64(xi, _mm_set1_epi64x(2));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = (int) k[0];
+      for (z = 1; z < 2; z++)
+        if (vec[k[z]] < vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = (int) k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_FArgMin_sse(const float *vec, int n)
+{
+  __m128  bv, xv, m;
+  __m128i bi, xi;
+  int     k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_ps(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi32(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm_loadu_ps(vec+i);
+          m  = _mm_cmplt_ps(xv, bv);
+          bv = _mm_blendv_ps(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, _mm_castps_si128(m));
+          xi = _mm_add_epi32(xi, _mm_set1_epi32(4));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] < vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+int
+esl_vec_IArgMin_sse(const int *vec, int n)
+{
+  __m128i bv, xv, m;
+  __m128i bi, xi;
+  int     k[4];
+  int     best = 0;
+  int     i    = 0;
+  int     z;
+
+  if (n >= 4)
+    {
+      bv = _mm_set1_epi32(vec[0]);
+      bi = _mm_setzero_si128();
+      xi = _mm_set_epi32(3, 2, 1, 0);
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm_loadu_si128((const __m128i *) (vec+i));
+          m  = _mm_cmplt_epi32(xv, bv);
+          bv = _mm_blendv_epi8(bv, xv, m);
+          bi = _mm_blendv_epi8(bi, xi, m);
+          xi = _mm_add_epi32(xi, _mm_set1_epi32(4));
+        }
+      _mm_storeu_si128((__m128i *) k, bi);
+      best = k[0];
+      for (z = 1; z < 4; z++)
+        if (vec[k[z]] < vec[best] || (vec[k[z]] == vec[best] && k[z] < best)) best = k[z];
+    }
+  for ( ; i < n; i++)
+    if (vec[i] < vec[best]) best = i;
+  return best;
+}
+
+
+
+/*****************************************************************
+ * 4. Scale, AddScaled.
+ *****************************************************************/
+
+/* Function:  esl_vec_{DFI}Scale_sse()
+ * Synopsis:  SSE version of esl_vec_{DFI}Scale().
+ *
+ * Note:      gcc already vectorizes the serial D and F loops with
+ *            SSE2, so these gain little; two vectors per iteration
+ *            keep them from losing to it on loop overhead and code
+ *            alignment.
+ */
+void
+esl_vec_DScale_sse(double *vec, int n, double scale)
+{
+  __m128d sv = _mm_set1_pd(scale);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      _mm_storeu_pd(vec+i,   _mm_mul_pd(_mm_loadu_pd(vec+i),   sv));
+      _mm_storeu_pd(vec+i+2, _mm_mul_pd(_mm_loadu_pd(vec+i+2), sv));
+    }
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_FScale_sse(float *vec, int n, float scale)
+{
+  __m128 sv = _mm_set1_ps(scale);
+  int    i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      _mm_storeu_ps(vec+i,   _mm_mul_ps(_mm_loadu_ps(vec+i),   sv));
+      _mm_storeu_ps(vec+i+4, _mm_mul_ps(_mm_loadu_ps(vec+i+4), sv));
+    }
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+void
+esl_vec_IScale_sse(int *vec, int n, int scale)
+{
+  __m128i sv = _mm_set1_epi32(scale);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i *) (vec+i), _mm_mullo_epi32(_mm_loadu_si128((const __m128i *) (vec+i)), sv));
+  for ( ; i < n; i++) vec[i] *= scale;
+}
+
+
+/* Function:  esl_vec_{DFI}AddScaled_sse()
+ * Synopsis:  SSE version of esl_vec_{DFI}AddScaled().
+ */
+void
+esl_vec_DAddScaled_sse(double *vec1, const double *vec2, double a, int n)
+{
+  __m128d av = _mm_set1_pd(a);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      _mm_storeu_pd(vec1+i,   _mm_add_pd(_mm_loadu_pd(vec1+i),   _mm_mul_pd(_mm_loadu_pd(vec2+i),   av)));
+      _mm_storeu_pd(vec1+i+2, _mm_add_pd(_mm_loadu_pd(vec1+i+2), _mm_mul_pd(_mm_loadu_pd(vec2+i+2), av)));
+    }
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_FAddScaled_sse(float *vec1, const float *vec2, float a, int n)
+{
+  __m128 av = _mm_set1_ps(a);
+  int    i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      _mm_storeu_ps(vec1+i,   _mm_add_ps(_mm_loadu_ps(vec1+i),   _mm_mul_ps(_mm_loadu_ps(vec2+i),   av)));
+      _mm_storeu_ps(vec1+i+4, _mm_add_ps(_mm_loadu_ps(vec1+i+4), _mm_mul_ps(_mm_loadu_ps(vec2+i+4), av)));
+    }
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+void
+esl_vec_IAddScaled_sse(int *vec1, const int *vec2, int a, int n)
+{
+  __m128i av = _mm_set1_epi32(a);
+  int     i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i *) (vec1+i),
+                     _mm_add_epi32(_mm_loadu_si128((const __m128i *) (vec1+i)),
+                                   _mm_mullo_epi32(_mm_loadu_si128((const __m128i *) (vec2+i)), av)));
+  for ( ; i < n; i++) vec1[i] += vec2[i] * a;
+}
+
+
+
+/*****************************************************************
+ * 5. LogSum, Entropy.
+ *****************************************************************/
+
+/* Function:  esl_vec_FLogSum_sse()
+ * Synopsis:  SSE version of esl_vec_FLogSum().
+ *
+ * Purpose:   Exponentials are <esl_sse_expf()>, accurate to a few
+ *            ulp; terms more than 50 nats below the max are skipped,
+ *            as in the serial version.
+ */
+float
+esl_vec_FLogSum_sse(const float *vec, int n)
+{
+  float  max = esl_vec_FMax_sse(vec, n);
+  __m128 mv, tv, sv, xv;
+  float  sum = 0.;
+  int    i   = 0;
+
+  if (max == eslINFINITY) return eslINFINITY;
+  if (n >= 4)
+    {
+      mv = _mm_set1_ps(max);
+      tv = _mm_set1_ps(max - 50.);
+      sv = _mm_setzero_ps();
+      for ( ; i + 4 <= n; i += 4)
+        {
+          xv = _mm_loadu_ps(vec+i);
+          sv = _mm_add_ps(sv, _mm_and_ps(_mm_cmpgt_ps(xv, tv), esl_sse_expf(_mm_sub_ps(xv, mv))));
+        }
+      esl_sse_hsum_ps(sv, &sum);
+    }
+  for ( ; i < n; i++)
+    if (vec[i] > max - 50.) sum += expf(vec[i] - max);
+  return logf(sum) + max;
+}
+
+
+/* Function:  esl_vec_FEntropy_sse()
+ * Synopsis:  SSE version of esl_vec_FEntropy().
+ *
+ * Purpose:   Sums $p_i \log p_i$ in nats with <esl_sse_logf()>, over
+ *            $p_i > 0$, and converts the total to bits.
+ */
+float
+esl_vec_FEntropy_sse(const float *p, int n)
+{
+  __m128 hv, pv;
+  float  H = 0.;
+  int    i = 0;
+
+  if (n >= 4)
+    {
+      hv = _mm_setzero_ps();
+      for ( ; i + 4 <= n; i += 4)
+        {
+          pv = _mm_loadu_ps(p+i);
+          hv = _mm_add_ps(hv, _mm_and_ps(_mm_cmpgt_ps(pv, _mm_setzero_ps()), _mm_mul_ps(pv, esl_sse_logf(pv))));
+        }
+      esl_sse_hsum_ps(hv, &H);
+    }
+  for ( ; i < n; i++)
+    if (p[i] > 0.) H += p[i] * logf(p[i]);
+  return -H * eslCONST_LOG2R;
+}
+
+
+#else // ! (eslENABLE_SSE && eslENABLE_SSE4)
+void esl_vectorops_sse_silence_hack(void) { return; }
+#endif // eslENABLE_SSE && eslENABLE_SSE4 or not
@@ -6,6 +6,9 @@
 #include "esl_getopts.h"
 #include "esl_msa.h"
 #include "esl_msafile.h"
+#ifdef HAVE_PTHREAD
+#include "esl_msafile_parallel.h"
+#endif
 #include "esl_msaweight.h"
 #include "esl_subcmd.h"
 
@@ -20,6 +23,7 @@ static ESL_OPTIONS cmd_options[] = {
   { "--dna",         eslARG_NONE,   FALSE,                            NULL, NULL,       NULL,  NULL, NULL,            "specify that input MSA is DNA (don't autodetect)",          1 },
   { "--rna",         eslARG_NONE,   FALSE,                            NULL, NULL,       NULL,  NULL, NULL,            " ... that input MSA is RNA",                                1 },
   { "--amino",       eslARG_NONE,   FALSE,                            NULL, NULL,       NULL,  NULL, NULL,            " ... that input MSA is protein",                            1 },
+  { "--cpu",         eslARG_INT,      "0",                            NULL, "n>=0",     NULL,  NULL, NULL,            "parse Stockholm input with <n> threads (0 = serial)",       1 },
 
   { "--ignore-rf",   eslARG_NONE,   eslMSAWEIGHT_IGNORE_RF,           NULL, NULL,       NULL,  NULL, NULL,            "ignore any RF line; always determine our own consensus",    2 },
   { "--fragthresh",  eslARG_REAL,   ESL_STR(eslMSAWEIGHT_FRAGTHRESH), NULL, "0<=x<=1",  NULL,  NULL, NULL,            "seq is fragment if aspan/alen < fragthresh",                2 },	// 0.0 = no fragments; 1.0 = everything is a frag except 100% full-span aseq 
@@ -34,6 +38,12 @@ static ESL_OPTIONS cmd_options[] = {
   { "--conscover",   eslARG_NONE,"default",                           NULL, NULL,   PREFOPTS,  NULL, NULL,            "keep seq whose alispan has better consensus coverage",      4 },
   { "--randorder",   eslARG_NONE,    NULL,                            NULL, NULL,   PREFOPTS,  NULL, NULL,            " ... or with random preference",                            4 },
   { "--origorder",   eslARG_NONE,    NULL,                            NULL, NULL,   PREFOPTS,  NULL, NULL,            " ... or prefer seq that comes first in order",              4 },
+
+  { "--sketch",      eslARG_NONE,   FALSE,                            NULL, NULL,       NULL,  NULL, NULL,            "fast approximate filtering: find candidates by k-mer sketch", 5 },
+  { "--recall",      eslARG_REAL,   ESL_STR(eslMSAWEIGHT_SKETCH_RECALL), NULL, "0<x<1", NULL,  "--sketch", NULL,      "target recall of pairs at <maxid>, for choosing k",          5 },
+  { "--kmer",        eslARG_INT,    ESL_STR(eslMSAWEIGHT_SKETCH_K),   NULL, "0<=n<=31", NULL,  "--sketch", NULL,      "set k-mer length to <n> (0 = choose from --recall)",        5 },
+  { "--nband",       eslARG_INT,    ESL_STR(eslMSAWEIGHT_SKETCH_NBAND), NULL, "n>=1",   NULL,  "--sketch", NULL,      "number of sketch bands",                                     5 },
+  { "--nrow",        eslARG_INT,    ESL_STR(eslMSAWEIGHT_SKETCH_NROW), NULL, "n>=1",    NULL,  "--sketch", NULL,      "number of MinHash values per band",                          5 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 
@@ -53,6 +63,9 @@ esl_cmd_filter(const char *topcmd, const ESL_SUBCMD *sub, int argc, char **argv)
   FILE           *ofp     = NULL;
   ESL_MSAWEIGHT_CFG *cfg  = esl_msaweight_cfg_Create();
   ESL_MSAFILE    *afp     = NULL;
+#ifdef HAVE_PTHREAD
+  ESL_MSAFILE_PARALLEL *pafp = NULL;
+#endif
   ESL_MSA        *msa     = NULL;
   ESL_MSA        *msa2    = NULL;
   int             nali    = 0;
@@ -82,6 +95,12 @@ esl_cmd_filter(const char *topcmd, const ESL_SUBCMD *sub, int argc, char **argv)
   else if (esl_opt_GetBoolean(go, "--randorder")) cfg->filterpref = eslMSAWEIGHT_FILT_RANDOM;
   else if (esl_opt_GetBoolean(go, "--origorder")) cfg->filterpref = eslMSAWEIGHT_FILT_ORIGORDER;
 
+  cfg->sketch        = esl_opt_GetBoolean(go, "--sketch");
+  cfg->sketch_recall = esl_opt_GetReal   (go, "--recall");
+  cfg->sketch_k      = esl_opt_GetInteger(go, "--kmer");
+  cfg->sketch_nband  = esl_opt_GetInteger(go, "--nband");
+  cfg->sketch_nrow   = esl_opt_GetInteger(go, "--nrow");
+
   if ((status = esl_msafile_Open(&abc, msafile, NULL, infmt, NULL, &afp)) != eslOK)
     esl_msafile_OpenFailure(afp, status);
  
@@ -93,7 +112,14 @@ esl_cmd_filter(const char *topcmd, const ESL_SUBCMD *sub, int argc, char **argv)
   ofp = (esl_opt_GetString (go, "-o") == NULL ? stdout : fopen(esl_opt_GetString(go, "-o"), "w"));
   if (! ofp)  esl_fatal("Failed to open output file %s\n", esl_opt_GetString(go, "-o"));
 
-  while ((status = esl_msafile_Read(afp, &msa)) == eslOK)
+#ifdef HAVE_PTHREAD
+  if ((status = esl_msafile_parallel_Create(afp, esl_opt_GetInteger(go, "--cpu"), &pafp)) != eslOK)
+    esl_fatal("failed to start MSA reader threads");
+
+  while ((status = esl_msafile_parallel_Read(pafp, &msa)) == eslOK)
+#else
+  while ((status = esl_msafile_Read(afp, &msa)) == eslOK)            // without threads, --cpu is ignored
+#endif
     {
       nali++;
 
@@ -106,11 +132,18 @@ esl_cmd_filter(const char *topcmd, const ESL_SUBCMD *sub, int argc, char **argv)
       esl_msa_Destroy(msa);
       esl_msa_Destroy(msa2);
     }
-  if (nali == 0 || status != eslEOF) esl_msafile_ReadFailure(afp, status); /* a convenience, like esl_msafile_OpenFailure() */
+#ifdef HAVE_PTHREAD
+  if (nali == 0 || status != eslEOF) esl_msafile_parallel_ReadFailure(pafp, status); /* a convenience, like esl_msafile_OpenFailure() */
+#else
+  if (nali == 0 || status != eslEOF) esl_msafile_ReadFailure(afp, status);
+#endif
 
   if (ofp != stdout) fclose(ofp);
   esl_msaweight_cfg_Destroy(cfg);
   esl_alphabet_Destroy(abc);
+#ifdef HAVE_PTHREAD
+  esl_msafile_parallel_Destroy(pafp);
+#endif
   esl_msafile_Close(afp);
   esl_getopts_Destroy(go);
   return eslOK;
@@ -149,6 +182,8 @@ process_cmdline(const char *topcmd, const ESL_SUBCMD *sub, const ESL_OPTIONS *su
       if ( esl_opt_DisplayHelp(stdout, go, 3, 2, 80)                                    != eslOK) goto ERROR; 
       if ( esl_printf("\noptions for sequence preference:\n")                           != eslOK) goto ERROR;
       if ( esl_opt_DisplayHelp(stdout, go, 4, 2, 80)                                    != eslOK) goto ERROR; 
+      if ( esl_printf("\noptions for approximate filtering (on huge MSAs):\n")          != eslOK) goto ERROR;
+      if ( esl_opt_DisplayHelp(stdout, go, 5, 2, 80)                                    != eslOK) goto ERROR; 
       exit(0);
     }
   if (esl_opt_ArgNumber(go) != sub->nargs) 
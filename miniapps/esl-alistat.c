@@ -12,7 +12,6 @@
 #include "esl_getopts.h"
 #include "esl_msa.h"
 #include "esl_msafile.h"
-#include "esl_msafile2.h"
 #include "esl_distance.h"
 #include "esl_vectorops.h"
 #include "esl_wuss.h"
@@ -28,8 +27,9 @@ static int  dump_insert_info(FILE *fp, ESL_MSA *msa, int use_weights, int nali,
 static int  dump_column_residue_counts(FILE *fp, ESL_ALPHABET *abc, double **abc_ct, int do_ambig, int use_weights, int nali, int64_t alen, int nseq, char *msa_name, char *alifile, char *errbuf);
 static int  dump_basepair_counts(FILE *fp, ESL_MSA *msa, ESL_ALPHABET *abc, double ***bp_ct, int use_weights, int nali, int nseq, char *msa_name, char *alifile, char *errbuf);
 static int  map_rfpos_to_apos(ESL_MSA *msa, ESL_ALPHABET *abc, char *errbuf, int64_t alen, int **ret_i_am_rf, int **ret_rf2a_map, int *ret_rflen);
-static int  get_pp_idx(ESL_ALPHABET *abc, char ppchar);
+static int  get_pp_idx(const ESL_ALPHABET *abc, char ppchar);
 static int  count_msa(ESL_MSA *msa, char *errbuf, int nali, int no_ambig, int use_weights, double ***ret_abc_ct, double ****ret_bp_ct, double ***ret_pp_ct);
+static int  count_msa_small(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, FILE *listfp, int no_ambig, ESL_MSA **ret_msa, int *ret_nseq, int64_t *ret_alen, double ***ret_abc_ct, double ***ret_pp_ct);
 static int  check_msa_weights(ESL_MSA *msa);
 
 static ESL_OPTIONS options[] = {
@@ -40,7 +40,7 @@ static ESL_OPTIONS options[] = {
   { "--amino",    eslARG_NONE,    FALSE, NULL, NULL, NULL,NULL,"--dna,--rna",    "<msafile> contains protein alignments",                   1 },
   { "--dna",      eslARG_NONE,    FALSE, NULL, NULL, NULL,NULL,"--amino,--rna",  "<msafile> contains DNA alignments",                       1 },
   { "--rna",      eslARG_NONE,    FALSE, NULL, NULL, NULL,NULL,"--amino,--dna",  "<msafile> contains RNA alignments",                       1 },
-  { "--small",    eslARG_NONE,    FALSE, NULL, NULL, NULL,NULL, NULL,            "use minimal RAM (RAM usage will be independent of aln size)", 2 },
+  { "--small",    eslARG_NONE,    FALSE, NULL, NULL, NULL,NULL, NULL,            "use minimal RAM (RAM usage independent of # of seqs)",    2 },
   /* options for optional output files */
   { "--list",      eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, NULL,        "output list of sequence names in alignment(s) to file <f>",      3 },
   { "--icinfo",    eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, NULL,        "print info on information content alignment column",             3 },
@@ -49,7 +49,7 @@ static ESL_OPTIONS options[] = {
   { "--psinfo",    eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, "--small",   "print per-sequence posterior probability info to <f>",           3 },
   { "--iinfo",     eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, "--small",   "print info on # of insertions b/t all non-gap RF cols to <f>",   3 },
   { "--cinfo",     eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, NULL,        "print per-column residue counts to <f>",                         3 },
-  { "--noambig",   eslARG_NONE,   NULL, NULL, NULL,      NULL,NULL, "--small",   "with --cinfo, do not count ambiguous residues",                  3 },
+  { "--noambig",   eslARG_NONE,   NULL, NULL, NULL,      NULL,NULL, NULL,        "with --cinfo, do not count ambiguous residues",                  3 },
   { "--bpinfo",    eslARG_OUTFILE,NULL, NULL, NULL,      NULL,NULL, "--small",   "print per-column base-pair counts to <f>",                       3 },
   { "--weight",    eslARG_NONE,   NULL, NULL, NULL,      NULL,NULL, "--small",   "with --*info files, weight counts using WT annotation from msa", 3 },
   { "--stall",    eslARG_NONE,  FALSE, NULL, NULL, NULL,NULL, NULL,            "arrest after start: for debugging under gdb",            99 },  
@@ -64,7 +64,7 @@ main(int argc, char **argv)
   char         *alifile = NULL;	               /* alignment file name             */
   int           fmt     = eslMSAFILE_UNKNOWN;  /* format code for alifile         */
   ESL_MSAFILE  *afp     = NULL;		       /* open msa file                   */
-  ESL_MSAFILE2 *old_afp = NULL;	               /* open msa file, legacy (--small) */
+  ESL_MSAFILE_ROW *row = NULL;	               /* one aligned seq at a time (--small) */
   ESL_MSA      *msa     = NULL;	               /* one multiple sequence alignment */
   int           nali;		               /* number of alignments read       */
   int           i;		               /* counter over seqs               */
@@ -121,7 +121,7 @@ main(int argc, char **argv)
       esl_usage (stdout, argv[0], usage);
       puts("\n where options are:");
       esl_opt_DisplayHelp(stdout, go, 1, 2, 80);
-      puts("\n small memory mode, requires --amino,--dna, or --rna and --informat pfam:");
+      puts("\n small memory mode, for Pfam, single-block Stockholm, or aligned FASTA:");
       esl_opt_DisplayHelp(stdout, go, 2, 2, 80);
       puts("\n optional output files:");
       esl_opt_DisplayHelp(stdout, go, 3, 2, 80);
@@ -142,7 +142,6 @@ main(int argc, char **argv)
       (fmt = esl_msafile_EncodeFormat(esl_opt_GetString(go, "--informat"))) == eslMSAFILE_UNKNOWN)
     esl_fatal("%s is not a valid input sequence file format for --informat", esl_opt_GetString(go, "--informat")); 
     
-  if (esl_opt_GetBoolean(go, "--small") && fmt != eslMSAFILE_PFAM) esl_fatal("--small requires --informat pfam\n"); 
 
   max_comparisons = 1000;
 
@@ -157,26 +156,11 @@ main(int argc, char **argv)
   else if (esl_opt_GetBoolean(go, "--dna"))     abc = esl_alphabet_Create(eslDNA);
   else if (esl_opt_GetBoolean(go, "--rna"))     abc = esl_alphabet_Create(eslRNA);
 
-  /* We'd like to get rid of the legacy msafile interface, but it
-   * includes small memory functionality for Pfam format which we have
-   * to replace first. For now, use both interfaces, new and legacy
-   */
-  if ( esl_opt_GetBoolean(go, "--small") )
-    {
-      if (! abc) esl_fatal("--small requires one of --amino, --dna, --rna be specified.");
+  if ( (status = esl_msafile_Open(&abc, alifile, NULL, fmt, NULL, &afp)) != eslOK)
+    esl_msafile_OpenFailure(afp, status);
 
-      status = esl_msafile2_OpenDigital(abc, alifile, NULL, &old_afp);
-      if      (status == eslENOTFOUND) esl_fatal("Alignment file %s doesn't exist or is not readable\n", alifile);
-      else if (status == eslEFORMAT)   esl_fatal("Couldn't determine format of alignment %s\n", alifile);
-      else if (status != eslOK)        esl_fatal("Alignment file open failed with error %d\n", status);
-    }
-  else
-    {
-      if ( (status = esl_msafile_Open(&abc, alifile, NULL, fmt, NULL, &afp)) != eslOK)
-	esl_msafile_OpenFailure(afp, status);
-    }
-
-  
+  /* --small reads one aligned sequence at a time, keeping only per-column counts */
+  if ( esl_opt_GetBoolean(go, "--small") && (row = esl_msafile_row_Create()) == NULL) esl_fatal("allocation failed");
 
   /**************************************
    * Open optional output files, as nec *
@@ -233,11 +217,11 @@ main(int argc, char **argv)
 
   nali = 0;
   
-  fmt = (esl_opt_GetBoolean(go, "--small") ? old_afp->format : afp->format);
+  fmt = afp->format;
 
   while ( (status = ( esl_opt_GetBoolean(go, "--small") ? 
-		      esl_msafile2_ReadInfoPfam(old_afp, listfp, abc, -1, NULL, NULL, &msa, &nseq, &alen, NULL, NULL, NULL, NULL, NULL, &abc_ct, &pp_ct, NULL, NULL, NULL) :
-		      esl_msafile_Read        (afp, &msa))) == eslOK)
+		      count_msa_small(afp, row, listfp, esl_opt_GetBoolean(go, "--noambig"), &msa, &nseq, &alen, &abc_ct, &pp_ct) :
+		      esl_msafile_Read(afp, &msa))) == eslOK)
     { 
       nali++;
       nres = 0;
@@ -303,7 +287,7 @@ main(int argc, char **argv)
       /* Dump data to optional output files, if nec */
       if(esl_opt_IsOn(go, "--list")) {
 	if(! esl_opt_GetBoolean(go, "--small")) { 
-	    /* only print sequence name to list file if ! --small, else we already have in esl_msafile2_ReadInfoPfam() */
+	    /* only print sequence name to list file if ! --small, else we already have in count_msa_small() */
 	    for(i = 0; i < msa->nseq; i++) fprintf(listfp, "%s\n", msa->sqname[i]);
 	}
       }
@@ -368,18 +352,8 @@ main(int argc, char **argv)
     }
   
   /* If an msa read failed, we've dropped out to here with an informative status code. 
-   * we have to handle failures from new vs. legacy msa parsing differently 
    */
-  if (esl_opt_GetBoolean(go, "--small")) 
-    {
-      if      (status == eslEFORMAT)  esl_fatal("Alignment file parse error, line %d of file %s:\n%s\nOffending line is:\n%s\n", old_afp->linenumber, old_afp->fname, old_afp->errbuf, old_afp->buf);	
-      else if (status != eslEOF)      esl_fatal("Alignment file read failed with error code %d\n", status);
-      else if (nali   == 0)           esl_fatal("No alignments found in file %s\n", alifile);
-    }
-  else
-    {
-      if (nali == 0 || status != eslEOF) esl_msafile_ReadFailure(afp, status);
-    }
+  if (nali == 0 || status != eslEOF) esl_msafile_ReadFailure(afp, status);
 
   /* Cleanup, normal return
    */
@@ -418,7 +392,7 @@ main(int argc, char **argv)
 
 
   if (afp)     esl_msafile_Close(afp);
-  if (old_afp) esl_msafile2_Close(old_afp);
+  esl_msafile_row_Destroy(row);
   esl_alphabet_Destroy(abc);
   esl_getopts_Destroy(go);
   return 0;
@@ -560,6 +534,84 @@ static int count_msa(ESL_MSA *msa, char *errbuf, int nali, int no_ambig, int use
 }
 
 
+/* count_msa_small()
+ *
+ * The --small version of reading an MSA and calling count_msa():
+ * read the next alignment one aligned sequence at a time with
+ * esl_msafile_ReadRow(), so memory doesn't depend on the number of
+ * sequences. Collect per-column residue counts in <ret_abc_ct> and
+ * posterior probability counts in <ret_pp_ct> (same layout as
+ * count_msa(); <ret_pp_ct> is NULL if no sequence has PP
+ * annotation), and print sequence names to <listfp>, if non-NULL.
+ *
+ * <ret_msa> gets the per-alignment annotation but no sequences, so
+ * the number of seqs and alignment length come back in <ret_nseq>
+ * and <ret_alen>.
+ *
+ * Returns eslOK on success; eslEOF if no alignments remain; or an
+ * error code from esl_msafile_ReadRow(), with <afp->errmsg> set, for
+ * esl_msafile_ReadFailure().
+ */
+static int count_msa_small(ESL_MSAFILE *afp, ESL_MSAFILE_ROW *row, FILE *listfp, int no_ambig, ESL_MSA **ret_msa, int *ret_nseq, int64_t *ret_alen, double ***ret_abc_ct, double ***ret_pp_ct)
+{
+  const ESL_ALPHABET *abc     = afp->abc;
+  double            **abc_ct  = NULL;
+  double            **pp_ct   = NULL;
+  int                 nppvals = 12;     /* '0'-'9' = 0-9, '*' = 10, gap = '11' */
+  int64_t             alen    = 0;
+  int                 apos, ppidx;
+  int                 status;
+
+  while ((status = esl_msafile_ReadRow(afp, row)) == eslOK)
+    {
+      if (row->idx == 0) { /* first seq: now we know alen */
+	alen = row->alen;
+	ESL_ALLOC(abc_ct, sizeof(double *) * alen); 
+	for(apos = 0; apos < alen; apos++) { 
+	  ESL_ALLOC(abc_ct[apos], sizeof(double) * (abc->K+1));
+	  esl_vec_DSet(abc_ct[apos], (abc->K+1), 0.);
+	}
+      }
+      if (row->pp && pp_ct == NULL) {
+	ESL_ALLOC(pp_ct, sizeof(double *) * alen);
+	for(apos = 0; apos < alen; apos++) { 
+	  ESL_ALLOC(pp_ct[apos], sizeof(double) * nppvals);
+	  esl_vec_DSet(pp_ct[apos], nppvals, 0.);
+	}
+      }
+
+      if (listfp) fprintf(listfp, "%s\n", row->name);
+
+      for(apos = 0; apos < alen; apos++) { /* careful, ax ranges from 1..alen (but abc_ct is 0..alen-1) */
+	if (no_ambig && esl_abc_XIsDegenerate(abc, row->ax[apos+1])) continue;
+	if ((status = esl_abc_DCount(abc, abc_ct[apos], row->ax[apos+1], 1.0)) != eslOK) 
+	  ESL_XFAIL(eslEFORMAT, afp->errmsg, "problem counting residue %d of seq %s", apos+1, row->name);
+	if (row->pp) {
+	  if ((ppidx = get_pp_idx(abc, row->pp[apos])) == -1) ESL_XFAIL(eslEFORMAT, afp->errmsg, "bad #=GR PP char: %c", row->pp[apos]);
+	  pp_ct[apos][ppidx] += 1.;
+	}
+      }
+    }
+  if (status != eslEOD) goto ERROR;   /* normal EOF, or an error */
+
+  *ret_msa    = row->msa;   row->msa = NULL;  /* we take the per-alignment annotation */
+  *ret_nseq   = row->nseq;
+  *ret_alen   = alen;
+  *ret_abc_ct = abc_ct;
+  *ret_pp_ct  = pp_ct;
+  return eslOK;
+
+ ERROR:
+  esl_arr2_Destroy((void **) abc_ct, alen);
+  esl_arr2_Destroy((void **) pp_ct,  alen);
+  *ret_msa    = NULL;
+  *ret_nseq   = 0;
+  *ret_alen   = 0;
+  *ret_abc_ct = NULL;
+  *ret_pp_ct  = NULL;
+  return status;
+}
+
 /* get_pp_idx
  *                   
  * Given a #=GR PP or #=GC PP_cons character, return the appropriate index
@@ -579,7 +631,7 @@ static int count_msa(ESL_MSA *msa, char *errbuf, int nali, int no_ambig, int use
  * 
  * Anything else (including missing or nonresidue) return -1;
  */
-static int get_pp_idx(ESL_ALPHABET *abc, char ppchar)
+static int get_pp_idx(const ESL_ALPHABET *abc, char ppchar)
 {
   if(esl_abc_CIsGap(abc, ppchar)) return 11;
   if(ppchar == '*')               return 10;
@@ -25,6 +25,7 @@ static ESL_OPTIONS options[] = {
   { "-o",         eslARG_OUTFILE, NULL, NULL,     NULL,   NULL,NULL,   NULL,          "send output to file <f>, not stdout",         1 },
   { "--id",       eslARG_REAL,  "0.62", NULL,"0<=x<=1",   NULL,"-b",   NULL,          "for -b: set identity cutoff",                 1 },
   { "--idf",      eslARG_REAL,  "0.80", NULL,"0<=x<=1",   NULL,"-f",   NULL,          "for -f: set identity cutoff",                 1 },
+  { "--cpu",      eslARG_INT,      "0", NULL,   "n>=0",   NULL,NULL,   NULL,          "for -p, -b, -f: number of worker threads",    1 },
   { "--informat", eslARG_STRING, FALSE, NULL,     NULL,   NULL,NULL,   NULL,          "specify that input file is in format <s>",    1 },
   { "--amino",    eslARG_NONE,   FALSE, NULL,     NULL,   NULL,NULL,"--dna,--rna",    "<msa file> contains protein alignments",      1 },
   { "--dna",      eslARG_NONE,   FALSE, NULL,     NULL,   NULL,NULL,"--amino,--rna",  "<msa file> contains DNA alignments",          1 },
@@ -68,6 +69,7 @@ main(int argc, char **argv)
   ESL_ALPHABET   *abc      = NULL;
   ESL_MSAFILE    *afp      = NULL;
   ESL_MSA        *msa      = NULL;
+  ESL_MSAWEIGHT_CFG *cfg   = NULL;
   int             status;
   FILE           *ofp;	   /* output stream       */
 
@@ -91,6 +93,9 @@ main(int argc, char **argv)
   else if (esl_opt_GetBoolean(go, "--dna"))     abc = esl_alphabet_Create(eslDNA);
   else if (esl_opt_GetBoolean(go, "--rna"))     abc = esl_alphabet_Create(eslRNA);
   
+  if ((cfg = esl_msaweight_cfg_Create()) == NULL) esl_fatal("allocation failed");
+  cfg->ncpu = esl_opt_GetInteger(go, "--cpu");
+
   if ((status = esl_msafile_Open(&abc, msafile, NULL, fmt, NULL, &afp)) != eslOK)
     esl_msafile_OpenFailure(afp, status);
 
@@ -102,7 +107,7 @@ main(int argc, char **argv)
       if       (esl_opt_GetBoolean(go, "-f")) 
 	{
 	  ESL_MSA *fmsa;
-	  status = esl_msaweight_IDFilter(msa, esl_opt_GetReal(go, "--idf"), &fmsa);
+	  status = esl_msaweight_IDFilter_adv(cfg, msa, esl_opt_GetReal(go, "--idf"), &fmsa);
 	  esl_msafile_Write(ofp, fmsa, eslMSAFILE_STOCKHOLM); 
 	  if (fmsa != NULL) esl_msa_Destroy(fmsa);
 	}
@@ -113,12 +118,13 @@ main(int argc, char **argv)
 	} 
       else if  (esl_opt_GetBoolean(go, "-p")) 
 	{
-	  status = esl_msaweight_PB(msa);                                  
+	  if (msa->flags & eslMSA_DIGITAL) status = esl_msaweight_PB_adv(cfg, msa, NULL);
+	  else                             status = esl_msaweight_PB(msa);
 	  esl_msafile_Write(ofp, msa, eslMSAFILE_STOCKHOLM);
 	} 
       else if  (esl_opt_GetBoolean(go, "-b"))
 	{ 
-	  status = esl_msaweight_BLOSUM(msa, esl_opt_GetReal(go, "--id")); 
+	  status = esl_msaweight_BLOSUM_adv(cfg, msa, esl_opt_GetReal(go, "--id")); 
  	  esl_msafile_Write(ofp, msa, eslMSAFILE_STOCKHOLM);
 	} 
      else     esl_fatal("internal error: no weighting algorithm selected");
@@ -127,6 +133,7 @@ main(int argc, char **argv)
       esl_msa_Destroy(msa);
     }
 
+  esl_msaweight_cfg_Destroy(cfg);
   esl_alphabet_Destroy(abc);
   esl_msafile_Close(afp);
   if (ofp != stdout) fclose(ofp); 